@@ -7,6 +7,9 @@ ifdef CONFIG_AUDIO_BOARD_CUSTOM
 COMPONENT_ADD_INCLUDEDIRS += ./my_codec_driver
 COMPONENT_SRCDIRS += ./my_codec_driver
 
+COMPONENT_ADD_INCLUDEDIRS += ./my_key_driver
+COMPONENT_SRCDIRS += ./my_key_driver
+
 COMPONENT_ADD_INCLUDEDIRS += ./my_board_v1_0
 COMPONENT_SRCDIRS += ./my_board_v1_0
 endif
\ No newline at end of file
@@ -0,0 +1,195 @@
+/*
+ * ESPRESSIF MIT License
+ *
+ * Copyright (c) 2020 <ESPRESSIF SYSTEMS (SHANGHAI) CO., LTD>
+ *
+ * Permission is hereby granted for use on all ESPRESSIF SYSTEMS products, in which case,
+ * it is free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#include <stdbool.h>
+#include <string.h>
+#include "esp_log.h"
+#include "audio_mem.h"
+#include "audio_error.h"
+#include "codec_regmap.h"
+
+static const char *TAG = "CODEC_REGMAP";
+
+#define REGMAP_MAX_REGS (256)
+
+struct codec_regmap {
+    codec_bus_t bus;
+    int num_regs;
+    uint8_t chip[REGMAP_MAX_REGS];      // what the chip holds, where known
+    uint8_t staged[REGMAP_MAX_REGS];
+    uint8_t known[REGMAP_MAX_REGS / 8];
+    uint8_t is_staged[REGMAP_MAX_REGS / 8];
+    uint8_t order[REGMAP_MAX_REGS];     // staged registers, in the order first staged
+    int num_staged;
+    codec_regmap_stats_t stats;
+};
+
+static inline bool bit_get(const uint8_t *bits, uint8_t reg)
+{
+    return bits[reg >> 3] & (1 << (reg & 7));
+}
+
+static inline void bit_set(uint8_t *bits, uint8_t reg, bool on)
+{
+    if (on) {
+        bits[reg >> 3] |= 1 << (reg & 7);
+    } else {
+        bits[reg >> 3] &= ~(1 << (reg & 7));
+    }
+}
+
+codec_regmap_handle_t codec_regmap_create(const codec_bus_t *bus, int num_regs)
+{
+    AUDIO_NULL_CHECK(TAG, bus, return NULL);
+    if (!bus->write || !bus->read || num_regs <= 0 || num_regs > REGMAP_MAX_REGS) {
+        ESP_LOGE(TAG, "invalid bus or %d registers", num_regs);
+        return NULL;
+    }
+    codec_regmap_handle_t map = audio_calloc(1, sizeof(struct codec_regmap));
+    AUDIO_MEM_CHECK(TAG, map, return NULL);
+    map->bus = *bus;
+    map->num_regs = num_regs;
+    return map;
+}
+
+void codec_regmap_destroy(codec_regmap_handle_t map)
+{
+    audio_free(map);
+}
+
+static esp_err_t current(codec_regmap_handle_t map, uint8_t reg, uint8_t *val)
+{
+    if (bit_get(map->is_staged, reg)) {
+        *val = map->staged[reg];
+        return ESP_OK;
+    }
+    if (!bit_get(map->known, reg)) {
+        map->stats.reads++;
+        esp_err_t ret = map->bus.read(map->bus.ctx, reg, &map->chip[reg]);
+        if (ret != ESP_OK) {
+            ESP_LOGE(TAG, "read of register 0x%02x failed", reg);
+            map->stats.errors++;
+            return ret;
+        }
+        bit_set(map->known, reg, true);
+    }
+    *val = map->chip[reg];
+    return ESP_OK;
+}
+
+esp_err_t codec_regmap_write(codec_regmap_handle_t map, uint8_t reg, uint8_t val)
+{
+    AUDIO_NULL_CHECK(TAG, map, return ESP_ERR_INVALID_ARG);
+    if (reg >= map->num_regs) {
+        ESP_LOGE(TAG, "no register 0x%02x", reg);
+        return ESP_ERR_INVALID_ARG;
+    }
+    map->stats.staged++;
+    if (!bit_get(map->is_staged, reg)) {
+        bit_set(map->is_staged, reg, true);
+        map->order[map->num_staged++] = reg;
+    }
+    map->staged[reg] = val;
+    return ESP_OK;
+}
+
+esp_err_t codec_regmap_update_bits(codec_regmap_handle_t map, uint8_t reg, uint8_t mask, uint8_t val)
+{
+    AUDIO_NULL_CHECK(TAG, map, return ESP_ERR_INVALID_ARG);
+    if (reg >= map->num_regs) {
+        ESP_LOGE(TAG, "no register 0x%02x", reg);
+        return ESP_ERR_INVALID_ARG;
+    }
+    uint8_t old = 0;
+    if (mask != 0xff) {
+        esp_err_t ret = current(map, reg, &old);
+        if (ret != ESP_OK) {
+            return ret;
+        }
+    }
+    return codec_regmap_write(map, reg, (old & ~mask) | (val & mask));
+}
+
+esp_err_t codec_regmap_read(codec_regmap_handle_t map, uint8_t reg, uint8_t *val)
+{
+    AUDIO_NULL_CHECK(TAG, map, return ESP_ERR_INVALID_ARG);
+    AUDIO_NULL_CHECK(TAG, val, return ESP_ERR_INVALID_ARG);
+    if (reg >= map->num_regs) {
+        ESP_LOGE(TAG, "no register 0x%02x", reg);
+        return ESP_ERR_INVALID_ARG;
+    }
+    return current(map, reg, val);
+}
+
+esp_err_t codec_regmap_sync(codec_regmap_handle_t map)
+{
+    AUDIO_NULL_CHECK(TAG, map, return ESP_ERR_INVALID_ARG);
+    uint8_t regs[REGMAP_MAX_REGS];
+    uint8_t vals[REGMAP_MAX_REGS];
+    int n = 0;
+    int skipped = 0;
+    for (int i = 0; i < map->num_staged; i++) {
+        uint8_t reg = map->order[i];
+        if (bit_get(map->known, reg) && map->chip[reg] == map->staged[reg]) {
+            skipped++;
+            continue;
+        }
+        regs[n] = reg;
+        vals[n++] = map->staged[reg];
+    }
+    if (n) {
+        map->stats.transactions++;
+        esp_err_t ret = map->bus.write(map->bus.ctx, regs, vals, n);
+        if (ret != ESP_OK) {
+            ESP_LOGE(TAG, "write of %d registers failed", n);
+            map->stats.errors++;
+            return ret;
+        }
+        map->stats.written += n;
+        for (int i = 0; i < n; i++) {
+            map->chip[regs[i]] = vals[i];
+            bit_set(map->known, regs[i], true);
+        }
+    }
+    map->stats.skipped += skipped;
+    for (int i = 0; i < map->num_staged; i++) {
+        bit_set(map->is_staged, map->order[i], false);
+    }
+    map->num_staged = 0;
+    return ESP_OK;
+}
+
+void codec_regmap_invalidate(codec_regmap_handle_t map)
+{
+    if (map) {
+        memset(map->known, 0, sizeof(map->known));
+    }
+}
+
+void codec_regmap_get_stats(codec_regmap_handle_t map, codec_regmap_stats_t *stats)
+{
+    if (map && stats) {
+        *stats = map->stats;
+    }
+}
@@ -0,0 +1,127 @@
+/*
+ * ESPRESSIF MIT License
+ *
+ * Copyright (c) 2020 <ESPRESSIF SYSTEMS (SHANGHAI) CO., LTD>
+ *
+ * Permission is hereby granted for use on all ESPRESSIF SYSTEMS products, in which case,
+ * it is free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#ifndef __CODEC_REGMAP_H__
+#define __CODEC_REGMAP_H__
+
+#include <stdint.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Register access of a codec on a control bus
+ */
+typedef struct {
+    /**
+     * Write n registers in one bus transaction, in the order given; either
+     * all of them are written or the call fails
+     */
+    esp_err_t (*write)(void *ctx, const uint8_t *regs, const uint8_t *vals, int n);
+    esp_err_t (*read)(void *ctx, uint8_t reg, uint8_t *val);   /*!< Read one register */
+    void *ctx;                                                  /*!< Context of write and read */
+} codec_bus_t;
+
+/**
+ * @brief Bus traffic of a register map, counted since codec_regmap_create()
+ */
+typedef struct {
+    uint32_t staged;        /*!< Register writes the driver asked for */
+    uint32_t skipped;       /*!< Of those, writes of the value the chip already holds */
+    uint32_t written;       /*!< Registers written on the bus */
+    uint32_t transactions;  /*!< Write transactions, one per codec_regmap_sync() with changes */
+    uint32_t reads;         /*!< Registers read on the bus */
+    uint32_t errors;        /*!< Failed transactions */
+} codec_regmap_stats_t;
+
+typedef struct codec_regmap *codec_regmap_handle_t;
+
+/**
+ * @brief Create a shadow of registers 0 to num_regs - 1 of a codec
+ *
+ * The shadow starts out unknown: a register is read from the chip the first
+ * time a partial update needs it, and is known from then on, as is every
+ * register written. Callers serialise access, audio_hal holds its lock
+ * around every codec call.
+ *
+ * @param bus      Bus of the codec, copied
+ * @param num_regs Registers of the codec, at most 256
+ *
+ * @return The register map, NULL on error
+ */
+codec_regmap_handle_t codec_regmap_create(const codec_bus_t *bus, int num_regs);
+
+/**
+ * @brief Free the register map
+ */
+void codec_regmap_destroy(codec_regmap_handle_t map);
+
+/**
+ * @brief Stage a register write for the next codec_regmap_sync()
+ *
+ * Staging a register again replaces the value and keeps its place in the
+ * order.
+ */
+esp_err_t codec_regmap_write(codec_regmap_handle_t map, uint8_t reg, uint8_t val);
+
+/**
+ * @brief Stage a write of the bits in mask, keeping the others
+ *
+ * Reads the register from the chip only if it has never been read or
+ * written.
+ */
+esp_err_t codec_regmap_update_bits(codec_regmap_handle_t map, uint8_t reg, uint8_t mask, uint8_t val);
+
+/**
+ * @brief Value of a register with the staged writes applied, reading the chip only if unknown
+ */
+esp_err_t codec_regmap_read(codec_regmap_handle_t map, uint8_t reg, uint8_t *val);
+
+/**
+ * @brief Write the staged registers that differ from the chip, in one bus transaction
+ *
+ * Without any such register there is no bus traffic at all. On error the
+ * staged writes are kept, and the next sync tries them again.
+ */
+esp_err_t codec_regmap_sync(codec_regmap_handle_t map);
+
+/**
+ * @brief Forget what the chip holds, e.g. after a reset or power loss
+ *
+ * Staged writes are kept and are all written by the next sync.
+ */
+void codec_regmap_invalidate(codec_regmap_handle_t map);
+
+/**
+ * @brief Bus traffic so far
+ */
+void codec_regmap_get_stats(codec_regmap_handle_t map, codec_regmap_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
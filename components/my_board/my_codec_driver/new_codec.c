@@ -24,15 +24,65 @@
 
 #include <string.h>
 #include "esp_log.h"
-#include "driver/i2c.h"
-#include "driver/gpio.h"
 #include "board.h"
 
 #include "new_codec.h"
+#include "new_codec_i2c.h"
 
 static const char *TAG = "new_codec";
 
+/* ES8388 registers */
+#define REG_CONTROL1        0x00
+#define REG_CONTROL2        0x01
+#define REG_CHIPPOWER       0x02
+#define REG_ADCPOWER        0x03
+#define REG_DACPOWER        0x04
+#define REG_MASTERMODE      0x08
+#define REG_ADCCONTROL1     0x09
+#define REG_ADCCONTROL2     0x0a
+#define REG_ADCCONTROL3     0x0b
+#define REG_ADCCONTROL4     0x0c
+#define REG_ADCCONTROL5     0x0d
+#define REG_ADCCONTROL8     0x10
+#define REG_ADCCONTROL9     0x11
+#define REG_DACCONTROL1     0x17
+#define REG_DACCONTROL2     0x18
+#define REG_DACCONTROL3     0x19
+#define REG_DACCONTROL4     0x1a
+#define REG_DACCONTROL5     0x1b
+#define REG_DACCONTROL16    0x26
+#define REG_DACCONTROL17    0x27
+#define REG_DACCONTROL20    0x2a
+#define REG_DACCONTROL21    0x2b
+#define REG_DACCONTROL23    0x2d
+#define REG_DACCONTROL24    0x2e
+#define REG_DACCONTROL27    0x31
+#define NUM_REGS            0x35
+
+#define DACCONTROL3_SOFT_RAMP   0x20    // volume and mute changes ramp at 0.5 dB per 4 LRCK
+#define DACCONTROL3_MUTE        0x04
+#define DAC_OUTPUT_LOUT1        0x04
+#define DAC_OUTPUT_LOUT2        0x08
+#define DAC_OUTPUT_ROUT1        0x10
+#define DAC_OUTPUT_ROUT2        0x20
+#define DAC_POWER_DOWN          0xc0
+#define ADC_POWER_DOWN          0xff
+#define ADC_INPUT_LINE1         0x00
+#define ADC_INPUT_LINE2         0x50
+#define ADC_INPUT_DIFFERENCE    0xf0
+#define DAC_VOL_MUTE            0xc0    // -96 dB, 0.5 dB steps from 0 dB
+#define OUT_VOL_0DB             0x1e
+#define VOLUME_RANGE_HALF_DB    100     // volume 1 is -50 dB, as sw_gain's
+
 static bool codec_init_flag;
+static bool codec_absent;           // init found no chip, the driver runs without one
+static codec_regmap_handle_t regmap;
+static uint8_t dac_outputs;
+static bool dac_running;
+static int codec_volume = 70;
+static bool codec_mute;
+static new_codec_volume_cb_t volume_cb;
+static void *volume_cb_ctx;
 
 audio_hal_func_t AUDIO_NEW_CODEC_DEFAULT_HANDLE = {
     .audio_codec_initialize = new_codec_init,
@@ -44,43 +94,245 @@ audio_hal_func_t AUDIO_NEW_CODEC_DEFAULT_HANDLE = {
     .audio_codec_get_volume = new_codec_get_voice_volume,
 };
 
-bool new_codec_initialized()
+bool new_codec_initialized(void)
 {
     return codec_init_flag;
 }
 
+/**
+ * Stage the DAC volume and mute bit for the current state: with a volume
+ * listener the DAC stays at 0 dB and only mutes while stopped.
+ */
+static esp_err_t stage_output(void)
+{
+    uint8_t att = 0;
+    if (!volume_cb) {
+        att = codec_volume <= 0 ? DAC_VOL_MUTE : (100 - codec_volume) * VOLUME_RANGE_HALF_DB / 99;
+    }
+    bool mute = !dac_running || (codec_mute && !volume_cb);
+    esp_err_t ret = codec_regmap_write(regmap, REG_DACCONTROL4, att);
+    ret |= codec_regmap_write(regmap, REG_DACCONTROL5, att);
+    ret |= codec_regmap_update_bits(regmap, REG_DACCONTROL3, DACCONTROL3_MUTE, mute ? DACCONTROL3_MUTE : 0);
+    return ret;
+}
+
+static uint8_t iface_bits(audio_hal_iface_bits_t bits)
+{
+    switch (bits) {
+        case AUDIO_HAL_BIT_LENGTH_24BITS:
+            return 0x00;
+        case AUDIO_HAL_BIT_LENGTH_32BITS:
+            return 0x04;
+        default:
+            return 0x03;
+    }
+}
+
 esp_err_t new_codec_init(audio_hal_codec_config_t *cfg)
 {
     ESP_LOGI(TAG, "new_codec init");
+    if (codec_init_flag) {
+        return ESP_OK;
+    }
+    codec_absent = false;
+    codec_bus_t bus;
+    if (new_codec_i2c_open(&bus) != ESP_OK) {
+        return ESP_FAIL;
+    }
+    regmap = codec_regmap_create(&bus, NUM_REGS);
+    if (!regmap) {
+        new_codec_i2c_close();
+        return ESP_FAIL;
+    }
+    if (cfg->dac_output == AUDIO_HAL_DAC_OUTPUT_LINE1) {
+        dac_outputs = DAC_OUTPUT_LOUT2 | DAC_OUTPUT_ROUT2;
+    } else if (cfg->dac_output == AUDIO_HAL_DAC_OUTPUT_LINE2) {
+        dac_outputs = DAC_OUTPUT_LOUT1 | DAC_OUTPUT_ROUT1;
+    } else {
+        dac_outputs = DAC_OUTPUT_LOUT1 | DAC_OUTPUT_LOUT2 | DAC_OUTPUT_ROUT1 | DAC_OUTPUT_ROUT2;
+    }
+    uint8_t adc_input = ADC_INPUT_DIFFERENCE;
+    if (cfg->adc_input == AUDIO_HAL_ADC_INPUT_LINE1) {
+        adc_input = ADC_INPUT_LINE1;
+    } else if (cfg->adc_input == AUDIO_HAL_ADC_INPUT_LINE2) {
+        adc_input = ADC_INPUT_LINE2;
+    }
+    dac_running = false;
+
+    // the chip keeps its registers over a warm reset, so the shadow starts
+    // unknown and all of this goes out, in this order, in one transaction
+    esp_err_t ret = codec_regmap_write(regmap, REG_DACCONTROL3, DACCONTROL3_SOFT_RAMP | DACCONTROL3_MUTE);
+    ret |= codec_regmap_write(regmap, REG_CONTROL2, 0x50);
+    ret |= codec_regmap_write(regmap, REG_CHIPPOWER, 0x00);                 // chip state machine on
+    ret |= codec_regmap_write(regmap, REG_MASTERMODE, cfg->i2s_iface.mode);
+    ret |= codec_regmap_write(regmap, REG_DACPOWER, DAC_POWER_DOWN);        // until started
+    ret |= codec_regmap_write(regmap, REG_ADCPOWER, ADC_POWER_DOWN);
+    ret |= codec_regmap_write(regmap, REG_CONTROL1, 0x12);                  // play and record mode
+    ret |= codec_regmap_write(regmap, REG_DACCONTROL1, iface_bits(cfg->i2s_iface.bits) << 3 | cfg->i2s_iface.fmt << 1);
+    ret |= codec_regmap_write(regmap, REG_DACCONTROL2, 0x02);               // single speed, MCLK 256 fs
+    ret |= codec_regmap_write(regmap, REG_DACCONTROL16, 0x00);              // LIN1 and RIN1 to the mixers
+    ret |= codec_regmap_write(regmap, REG_DACCONTROL17, 0x90);              // left DAC to left mixer, 0 dB
+    ret |= codec_regmap_write(regmap, REG_DACCONTROL20, 0x90);              // right DAC to right mixer, 0 dB
+    ret |= codec_regmap_write(regmap, REG_DACCONTROL21, 0x80);              // ADC and DAC share LRCK
+    ret |= codec_regmap_write(regmap, REG_DACCONTROL23, 0x00);
+    for (uint8_t reg = REG_DACCONTROL24; reg <= REG_DACCONTROL27; reg++) {
+        ret |= codec_regmap_write(regmap, reg, OUT_VOL_0DB);
+    }
+    ret |= codec_regmap_write(regmap, REG_ADCCONTROL1, 0xbb);               // PGA +24 dB
+    ret |= codec_regmap_write(regmap, REG_ADCCONTROL2, adc_input);
+    ret |= codec_regmap_write(regmap, REG_ADCCONTROL3, 0x02);
+    ret |= codec_regmap_write(regmap, REG_ADCCONTROL4, iface_bits(cfg->i2s_iface.bits) << 2 | cfg->i2s_iface.fmt);
+    ret |= codec_regmap_write(regmap, REG_ADCCONTROL5, 0x02);
+    ret |= codec_regmap_write(regmap, REG_ADCCONTROL8, 0x00);
+    ret |= codec_regmap_write(regmap, REG_ADCCONTROL9, 0x00);
+    ret |= stage_output();
+    ret |= codec_regmap_sync(regmap);
+    if (ret != ESP_OK) {
+        // a codec-less board: audio_hal stays up so volume and mute still reach the listener
+        ESP_LOGW(TAG, "no answer from a codec at 0x%02x, running without one", NEW_CODEC_I2C_ADDR);
+        codec_regmap_destroy(regmap);
+        regmap = NULL;
+        new_codec_i2c_close();
+        codec_absent = true;
+        return ESP_OK;
+    }
+    codec_init_flag = true;
     return ESP_OK;
 }
 
 esp_err_t new_codec_deinit(void)
 {
-    return ESP_OK;
+    codec_absent = false;
+    if (!codec_init_flag) {
+        return ESP_OK;
+    }
+    // mute and power down, in one transaction
+    dac_running = false;
+    esp_err_t ret = stage_output();
+    ret |= codec_regmap_write(regmap, REG_DACPOWER, DAC_POWER_DOWN);
+    ret |= codec_regmap_write(regmap, REG_ADCPOWER, ADC_POWER_DOWN);
+    ret |= codec_regmap_sync(regmap);
+    codec_regmap_destroy(regmap);
+    regmap = NULL;
+    new_codec_i2c_close();
+    codec_init_flag = false;
+    return ret == ESP_OK ? ESP_OK : ESP_FAIL;
 }
 
 esp_err_t new_codec_ctrl_state(audio_hal_codec_mode_t mode, audio_hal_ctrl_t ctrl_state)
 {
-    return ESP_OK;
+    if (!codec_init_flag) {
+        if (codec_absent) {
+            return ESP_OK;
+        }
+        ESP_LOGE(TAG, "codec not initialized");
+        return ESP_FAIL;
+    }
+    bool start = ctrl_state == AUDIO_HAL_CTRL_START;
+    esp_err_t ret = ESP_OK;
+    if (mode == AUDIO_HAL_CODEC_MODE_DECODE || mode == AUDIO_HAL_CODEC_MODE_BOTH
+        || mode == AUDIO_HAL_CODEC_MODE_LINE_IN) {
+        dac_running = start;
+        // mute before the outputs go down, after they come up
+        if (start) {
+            ret |= codec_regmap_write(regmap, REG_DACPOWER, dac_outputs);
+            ret |= stage_output();
+        } else {
+            ret |= stage_output();
+            ret |= codec_regmap_write(regmap, REG_DACPOWER, DAC_POWER_DOWN);
+        }
+    }
+    if (mode == AUDIO_HAL_CODEC_MODE_ENCODE || mode == AUDIO_HAL_CODEC_MODE_BOTH
+        || mode == AUDIO_HAL_CODEC_MODE_LINE_IN) {
+        ret |= codec_regmap_write(regmap, REG_ADCPOWER, start ? 0x00 : ADC_POWER_DOWN);
+    }
+    ret |= codec_regmap_sync(regmap);
+    return ret == ESP_OK ? ESP_OK : ESP_FAIL;
 }
 
 esp_err_t new_codec_config_i2s(audio_hal_codec_mode_t mode, audio_hal_codec_i2s_iface_t *iface)
 {
-    return ESP_OK;
+    if (!iface) {
+        return ESP_FAIL;
+    }
+    if (!codec_init_flag) {
+        return codec_absent ? ESP_OK : ESP_FAIL;
+    }
+    uint8_t bits = iface_bits(iface->bits);
+    esp_err_t ret = codec_regmap_write(regmap, REG_MASTERMODE, iface->mode);
+    if (mode == AUDIO_HAL_CODEC_MODE_DECODE || mode == AUDIO_HAL_CODEC_MODE_BOTH) {
+        ret |= codec_regmap_update_bits(regmap, REG_DACCONTROL1, 0x3e, bits << 3 | iface->fmt << 1);
+    }
+    if (mode == AUDIO_HAL_CODEC_MODE_ENCODE || mode == AUDIO_HAL_CODEC_MODE_BOTH) {
+        ret |= codec_regmap_update_bits(regmap, REG_ADCCONTROL4, 0x1f, bits << 2 | iface->fmt);
+    }
+    ret |= codec_regmap_sync(regmap);
+    return ret == ESP_OK ? ESP_OK : ESP_FAIL;
 }
 
 esp_err_t new_codec_set_voice_mute(bool mute)
 {
-    return ESP_OK;
+    codec_mute = mute;
+    if (volume_cb) {
+        volume_cb(codec_volume, codec_mute, volume_cb_ctx);
+    }
+    if (!codec_init_flag) {
+        return ESP_OK;
+    }
+    esp_err_t ret = stage_output();
+    ret |= codec_regmap_sync(regmap);
+    return ret == ESP_OK ? ESP_OK : ESP_FAIL;
 }
 
 esp_err_t new_codec_set_voice_volume(int volume)
 {
-    return ESP_OK;
+    if (volume < 0) {
+        volume = 0;
+    } else if (volume > 100) {
+        volume = 100;
+    }
+    codec_volume = volume;
+    if (volume_cb) {
+        volume_cb(codec_volume, codec_mute, volume_cb_ctx);
+    }
+    if (!codec_init_flag) {
+        return ESP_OK;
+    }
+    esp_err_t ret = stage_output();
+    ret |= codec_regmap_sync(regmap);
+    return ret == ESP_OK ? ESP_OK : ESP_FAIL;
 }
 
 esp_err_t new_codec_get_voice_volume(int *volume)
 {
+    if (!volume) {
+        return ESP_FAIL;
+    }
+    *volume = codec_volume;
+    return ESP_OK;
+}
+
+esp_err_t new_codec_set_volume_cb(new_codec_volume_cb_t cb, void *ctx)
+{
+    volume_cb = cb;
+    volume_cb_ctx = ctx;
+    if (cb) {
+        cb(codec_volume, codec_mute, ctx);
+    }
+    if (!codec_init_flag) {
+        return ESP_OK;
+    }
+    // the DAC goes to 0 dB with a listener, back to the volume without
+    esp_err_t ret = stage_output();
+    ret |= codec_regmap_sync(regmap);
+    return ret == ESP_OK ? ESP_OK : ESP_FAIL;
+}
+
+esp_err_t new_codec_get_bus_stats(codec_regmap_stats_t *stats)
+{
+    if (!codec_init_flag || !stats) {
+        return ESP_FAIL;
+    }
+    codec_regmap_get_stats(regmap, stats);
     return ESP_OK;
 }
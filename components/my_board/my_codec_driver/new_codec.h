@@ -26,19 +26,34 @@
 #define __NEW_CODEC_H__
 
 #include "audio_hal.h"
+#include "codec_regmap.h"
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+/**
+ * @brief Volume listener, see new_codec_set_volume_cb()
+ *
+ * @param volume voice volume (0~100)
+ * @param mute   true if muted
+ * @param ctx    user context
+ */
+typedef void (*new_codec_volume_cb_t)(int volume, bool mute, void *ctx);
+
 /**
  * @brief Initialize new_codec chip
  *
+ * A board without the chip (nothing answers at NEW_CODEC_I2C_ADDR) is not an
+ * error: the driver runs without it, the other calls succeed and put nothing
+ * on the bus, and volume and mute still reach the listener
+ * (new_codec_set_volume_cb()). new_codec_initialized() tells the two apart.
+ *
  * @param cfg configuration of new_codec
  *
  * @return
  *     - ESP_OK
- *     - ESP_FAIL
+ *     - ESP_FAIL the I2C bus could not be set up
  */
 esp_err_t new_codec_init(audio_hal_codec_config_t *cfg);
 
@@ -52,12 +67,19 @@ esp_err_t new_codec_init(audio_hal_codec_config_t *cfg);
 esp_err_t new_codec_deinit(void);
 
 /**
- * The functions new_codec_ctrl_state and new_codec_config_i2s are not used by this driver.
- * They are kept here to maintain the uniformity and convenience of the interface
- * of the ADF project.
- * These settings for new_codec are burned in firmware and configuration files.
- * Default i2s configuration: 48000Hz, 16bit, Left-Right channels.
- * Use resampling to be compatible with different file types.
+ * @brief Whether the chip answered at new_codec_init()
+ *
+ * @return
+ *     - true  the chip is driven
+ *     - false not initialized, or running without a chip
+ */
+bool new_codec_initialized(void);
+
+/**
+ * The codec is an ES8388 on the I2C pins of get_i2c_pins(). The driver keeps
+ * a shadow of its registers (codec_regmap.h): a call that changes nothing
+ * puts nothing on the bus, and one that changes several registers writes
+ * them in a single transaction.
  *
  * @brief Control new_codec chip
  *
@@ -115,6 +137,34 @@ esp_err_t new_codec_set_voice_volume(int volume);
  */
 esp_err_t new_codec_get_voice_volume(int *volume);
 
+/**
+ * @brief Apply the volume in software
+ *
+ * The volume and mute set through audio_hal are passed to cb, which is
+ * called at once with the current setting and then on every change, in the
+ * task setting it. While a listener is set the DAC stays at 0 dB and
+ * unmuted, so a volume change costs no I2C traffic; without one the DAC
+ * volume registers follow the volume.
+ *
+ * @param cb  listener, NULL to remove it
+ * @param ctx user context of cb
+ *
+ * @return
+ *     - ESP_OK
+ */
+esp_err_t new_codec_set_volume_cb(new_codec_volume_cb_t cb, void *ctx);
+
+/**
+ * @brief I2C traffic since new_codec_init()
+ *
+ * @param[out] stats register writes asked for, skipped and written, and transactions
+ *
+ * @return
+ *     - ESP_OK
+ *     - ESP_FAIL not initialized
+ */
+esp_err_t new_codec_get_bus_stats(codec_regmap_stats_t *stats);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,101 @@
+/*
+ * ESPRESSIF MIT License
+ *
+ * Copyright (c) 2020 <ESPRESSIF SYSTEMS (SHANGHAI) CO., LTD>
+ *
+ * Permission is hereby granted for use on all ESPRESSIF SYSTEMS products, in which case,
+ * it is free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#include "esp_log.h"
+#include "driver/i2c.h"
+#include "board.h"
+#include "new_codec_i2c.h"
+
+static const char *TAG = "new_codec_i2c";
+
+#define CODEC_I2C_PORT      I2C_NUM_0
+#define CODEC_I2C_TIMEOUT   (100 / portTICK_RATE_MS)
+
+static esp_err_t codec_i2c_write(void *ctx, const uint8_t *regs, const uint8_t *vals, int n)
+{
+    i2c_cmd_handle_t cmd = i2c_cmd_link_create();
+    if (!cmd) {
+        return ESP_ERR_NO_MEM;
+    }
+    esp_err_t ret = ESP_OK;
+    for (int i = 0; i < n; i++) {
+        ret |= i2c_master_start(cmd);
+        ret |= i2c_master_write_byte(cmd, (NEW_CODEC_I2C_ADDR << 1) | I2C_MASTER_WRITE, true);
+        ret |= i2c_master_write_byte(cmd, regs[i], true);
+        ret |= i2c_master_write_byte(cmd, vals[i], true);
+    }
+    ret |= i2c_master_stop(cmd);
+    if (ret == ESP_OK) {
+        ret = i2c_master_cmd_begin(CODEC_I2C_PORT, cmd, CODEC_I2C_TIMEOUT);
+    }
+    i2c_cmd_link_delete(cmd);
+    return ret;
+}
+
+static esp_err_t codec_i2c_read(void *ctx, uint8_t reg, uint8_t *val)
+{
+    i2c_cmd_handle_t cmd = i2c_cmd_link_create();
+    if (!cmd) {
+        return ESP_ERR_NO_MEM;
+    }
+    esp_err_t ret = ESP_OK;
+    ret |= i2c_master_start(cmd);
+    ret |= i2c_master_write_byte(cmd, (NEW_CODEC_I2C_ADDR << 1) | I2C_MASTER_WRITE, true);
+    ret |= i2c_master_write_byte(cmd, reg, true);
+    ret |= i2c_master_start(cmd);
+    ret |= i2c_master_write_byte(cmd, (NEW_CODEC_I2C_ADDR << 1) | I2C_MASTER_READ, true);
+    ret |= i2c_master_read_byte(cmd, val, I2C_MASTER_NACK);
+    ret |= i2c_master_stop(cmd);
+    if (ret == ESP_OK) {
+        ret = i2c_master_cmd_begin(CODEC_I2C_PORT, cmd, CODEC_I2C_TIMEOUT);
+    }
+    i2c_cmd_link_delete(cmd);
+    return ret;
+}
+
+esp_err_t new_codec_i2c_open(codec_bus_t *bus)
+{
+    i2c_config_t i2c_cfg = {
+        .mode = I2C_MODE_MASTER,
+        .sda_pullup_en = GPIO_PULLUP_ENABLE,
+        .scl_pullup_en = GPIO_PULLUP_ENABLE,
+        .master.clk_speed = NEW_CODEC_I2C_SPEED,
+    };
+    esp_err_t ret = get_i2c_pins(CODEC_I2C_PORT, &i2c_cfg);
+    ret |= i2c_param_config(CODEC_I2C_PORT, &i2c_cfg);
+    ret |= i2c_driver_install(CODEC_I2C_PORT, i2c_cfg.mode, 0, 0, 0);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "i2c master on port %d failed", CODEC_I2C_PORT);
+        return ESP_FAIL;
+    }
+    bus->write = codec_i2c_write;
+    bus->read = codec_i2c_read;
+    bus->ctx = NULL;
+    return ESP_OK;
+}
+
+void new_codec_i2c_close(void)
+{
+    i2c_driver_delete(CODEC_I2C_PORT);
+}
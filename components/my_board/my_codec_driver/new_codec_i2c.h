@@ -0,0 +1,61 @@
+/*
+ * ESPRESSIF MIT License
+ *
+ * Copyright (c) 2020 <ESPRESSIF SYSTEMS (SHANGHAI) CO., LTD>
+ *
+ * Permission is hereby granted for use on all ESPRESSIF SYSTEMS products, in which case,
+ * it is free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#ifndef __NEW_CODEC_I2C_H__
+#define __NEW_CODEC_I2C_H__
+
+#include "codec_regmap.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define NEW_CODEC_I2C_ADDR      (0x10)      /*!< 7 bit address of the codec, CE low */
+#define NEW_CODEC_I2C_SPEED     (100000)
+
+/**
+ * @brief Install the I2C master on the board's codec pins (get_i2c_pins()) and return its bus
+ *
+ * A write of several registers is one command list, one i2c_master_cmd_begin():
+ * a (repeated) START, the address, the register and the value for each, and
+ * a single STOP.
+ *
+ * @param[out] bus The codec bus
+ *
+ * @return
+ *     - ESP_OK
+ *     - ESP_FAIL
+ */
+esp_err_t new_codec_i2c_open(codec_bus_t *bus);
+
+/**
+ * @brief Uninstall the I2C master
+ */
+void new_codec_i2c_close(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,180 @@
+/*
+ * ESPRESSIF MIT License
+ *
+ * Copyright (c) 2020 <ESPRESSIF SYSTEMS (SHANGHAI) CO., LTD>
+ *
+ * Permission is hereby granted for use on all ESPRESSIF SYSTEMS products, in which case,
+ * it is free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#include <string.h>
+#include "esp_log.h"
+#include "audio_mem.h"
+#include "audio_error.h"
+#include "adc_key_classifier.h"
+
+static const char *TAG = "ADC_KEY";
+
+#define FILTER_FRAC_BITS    (4)
+#define UNSURE              (-2)    // between bands, or the raw sample and the filter disagree
+
+struct adc_key_classifier {
+    adc_key_classifier_cfg_t cfg;
+    bool primed;
+    int filtered;           // mV << FILTER_FRAC_BITS
+    int raw;
+    int key;                // pressed, ADC_KEY_NONE for none
+    int candidate;          // key being timed for a press
+    uint32_t candidate_ms;
+    bool away;              // the pressed key is not read, being timed for the release
+    uint32_t away_ms;
+    uint32_t pressed_ms;
+    bool long_sent;
+};
+
+adc_key_classifier_handle_t adc_key_classifier_create(const adc_key_classifier_cfg_t *cfg)
+{
+    AUDIO_NULL_CHECK(TAG, cfg, return NULL);
+    if (cfg->num_keys <= 0 || cfg->num_keys > ADC_KEY_MAX_KEYS || cfg->sample_ms <= 0 || cfg->idle_sample_ms <= 0) {
+        ESP_LOGE(TAG, "%d keys, at most %d, or no sample period", cfg->num_keys, ADC_KEY_MAX_KEYS);
+        return NULL;
+    }
+    for (int i = 0; i < cfg->num_keys; i++) {
+        if (cfg->levels[i + 1] - cfg->levels[i] <= 2 * cfg->hysteresis_mv) {
+            ESP_LOGE(TAG, "key %d: %d to %d mV, narrower than the hysteresis", i, cfg->levels[i], cfg->levels[i + 1]);
+            return NULL;
+        }
+    }
+    adc_key_classifier_handle_t cls = audio_calloc(1, sizeof(struct adc_key_classifier));
+    AUDIO_MEM_CHECK(TAG, cls, return NULL);
+    cls->cfg = *cfg;
+    adc_key_classifier_reset(cls);
+    return cls;
+}
+
+void adc_key_classifier_destroy(adc_key_classifier_handle_t cls)
+{
+    audio_free(cls);
+}
+
+void adc_key_classifier_reset(adc_key_classifier_handle_t cls)
+{
+    cls->primed = false;
+    cls->key = ADC_KEY_NONE;
+    cls->candidate = ADC_KEY_NONE;
+    cls->away = false;
+}
+
+/**
+ * @brief The key a value reads: the pressed one while it is within hysteresis outside its band, another one
+ *        only well inside its band
+ */
+static int band(const adc_key_classifier_cfg_t *cfg, int mv, int pressed)
+{
+    const int *l = cfg->levels;
+    int h = cfg->hysteresis_mv;
+    if (pressed >= 0 && mv >= l[pressed] - h && mv < l[pressed + 1] + h) {
+        return pressed;
+    }
+    if (mv < l[0] - h || mv >= l[cfg->num_keys] + h) {
+        return ADC_KEY_NONE;
+    }
+    for (int i = 0; i < cfg->num_keys; i++) {
+        if (mv >= l[i] + h && mv < l[i + 1] - h) {
+            return i;
+        }
+    }
+    return UNSURE;
+}
+
+adc_key_event_t adc_key_classifier_feed(adc_key_classifier_handle_t cls, uint32_t now_ms, int mv, int *key)
+{
+    const adc_key_classifier_cfg_t *cfg = &cls->cfg;
+    if (!cls->primed) {
+        cls->filtered = mv << FILTER_FRAC_BITS;
+        cls->primed = true;
+    } else {
+        int d = (mv << FILTER_FRAC_BITS) - cls->filtered;
+        cls->filtered += d >= 0 ? d >> cfg->filter_shift : -(-d >> cfg->filter_shift);
+    }
+    cls->raw = mv;
+    int raw_key = band(cfg, mv, cls->key);
+    int read = raw_key == band(cfg, cls->filtered >> FILTER_FRAC_BITS, cls->key) ? raw_key : UNSURE;
+
+    if (cls->key == ADC_KEY_NONE) {
+        if (read < 0) {
+            cls->candidate = ADC_KEY_NONE;
+            return ADC_KEY_EVENT_NONE;
+        }
+        if (read != cls->candidate) {
+            cls->candidate = read;
+            cls->candidate_ms = now_ms;
+        }
+        if (now_ms - cls->candidate_ms < cfg->press_ms) {
+            return ADC_KEY_EVENT_NONE;
+        }
+        cls->key = read;
+        cls->candidate = ADC_KEY_NONE;
+        cls->away = false;
+        cls->pressed_ms = now_ms;
+        cls->long_sent = false;
+        *key = read;
+        return ADC_KEY_EVENT_PRESSED;
+    }
+
+    // either one still reading the key keeps it down
+    if (raw_key == cls->key || band(cfg, cls->filtered >> FILTER_FRAC_BITS, cls->key) == cls->key) {
+        cls->away = false;
+        if (!cls->long_sent && now_ms - cls->pressed_ms >= cfg->long_press_ms) {
+            cls->long_sent = true;
+            *key = cls->key;
+            return ADC_KEY_EVENT_LONG_PRESSED;
+        }
+        return ADC_KEY_EVENT_NONE;
+    }
+    if (!cls->away) {
+        cls->away = true;
+        cls->away_ms = now_ms;
+    }
+    if (now_ms - cls->away_ms < cfg->release_ms) {
+        return ADC_KEY_EVENT_NONE;
+    }
+    *key = cls->key;
+    cls->key = ADC_KEY_NONE;
+    cls->away = false;
+    return cls->long_sent ? ADC_KEY_EVENT_LONG_RELEASED : ADC_KEY_EVENT_RELEASED;
+}
+
+int adc_key_classifier_period_ms(adc_key_classifier_handle_t cls)
+{
+    const adc_key_classifier_cfg_t *cfg = &cls->cfg;
+    if (!cls->primed || cls->candidate != ADC_KEY_NONE || cls->away) {
+        return cfg->sample_ms;
+    }
+    // a press or release that has just started reads as a step the filter has not caught up with yet
+    int lag = cls->raw - (cls->filtered >> FILTER_FRAC_BITS);
+    if (lag > cfg->hysteresis_mv || lag < -cfg->hysteresis_mv || band(cfg, cls->raw, cls->key) != cls->key) {
+        return cfg->sample_ms;
+    }
+    return cfg->idle_sample_ms;
+}
+
+int adc_key_classifier_key(adc_key_classifier_handle_t cls)
+{
+    return cls->key;
+}
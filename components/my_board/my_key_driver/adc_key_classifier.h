@@ -0,0 +1,131 @@
+/*
+ * ESPRESSIF MIT License
+ *
+ * Copyright (c) 2020 <ESPRESSIF SYSTEMS (SHANGHAI) CO., LTD>
+ *
+ * Permission is hereby granted for use on all ESPRESSIF SYSTEMS products, in which case,
+ * it is free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#ifndef __ADC_KEY_CLASSIFIER_H__
+#define __ADC_KEY_CLASSIFIER_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define ADC_KEY_MAX_KEYS    (8)
+#define ADC_KEY_NONE        (-1)
+
+/**
+ * @brief What a sample changed; the values are those of periph_adc_button's events
+ */
+typedef enum {
+    ADC_KEY_EVENT_NONE = 0,
+    ADC_KEY_EVENT_PRESSED,
+    ADC_KEY_EVENT_RELEASED,
+    ADC_KEY_EVENT_LONG_PRESSED,
+    ADC_KEY_EVENT_LONG_RELEASED,
+} adc_key_event_t;
+
+/**
+ * @brief Keys on one resistor ladder, read in mV
+ */
+typedef struct {
+    int levels[ADC_KEY_MAX_KEYS + 1];   /*!< Ascending, key i reads from levels[i] up to levels[i + 1]; below
+                                             the first and above the last no key is pressed */
+    int num_keys;
+    int sample_ms;          /*!< Sample period while the input moves */
+    int idle_sample_ms;     /*!< Sample period while the input is steady, with or without a key down */
+    int filter_shift;       /*!< The IIR filter moves 1 / 2^filter_shift of the way to each sample */
+    int hysteresis_mv;      /*!< A key is entered this far inside its band and left this far outside it */
+    int press_ms;           /*!< A key reads steady this long before it is pressed */
+    int release_ms;         /*!< The pressed key is gone this long before it is released */
+    int long_press_ms;      /*!< Held this long from the press, a long press */
+} adc_key_classifier_cfg_t;
+
+/**
+ * The levels of the board's periph_adc_button table. Steady, it samples as
+ * often as a 20 ms poller; worst case a press is reported idle_sample_ms +
+ * press_ms + a few samples of filter settling after the contact, a release
+ * likewise with release_ms.
+ */
+#define ADC_KEY_CLASSIFIER_CFG_DEFAULT() {          \
+    .levels = {200, 1355, 1820, 2280, 2930},        \
+    .num_keys = 4,                                  \
+    .sample_ms = 4,                                 \
+    .idle_sample_ms = 20,                           \
+    .filter_shift = 1,                              \
+    .hysteresis_mv = 40,                            \
+    .press_ms = 12,                                 \
+    .release_ms = 12,                               \
+    .long_press_ms = 2000,                          \
+}
+
+typedef struct adc_key_classifier *adc_key_classifier_handle_t;
+
+/**
+ * @brief Create a classifier, the config is copied
+ *
+ * @return The classifier, NULL if the levels are not ascending or there are too many keys
+ */
+adc_key_classifier_handle_t adc_key_classifier_create(const adc_key_classifier_cfg_t *cfg);
+
+void adc_key_classifier_destroy(adc_key_classifier_handle_t cls);
+
+/**
+ * @brief Feed one sample
+ *
+ * A key is pressed once the raw sample and the filtered value both read it
+ * for press_ms. It is released once neither the raw sample nor the filtered
+ * value has read it, with hysteresis, for release_ms; a noise spike restarts
+ * either wait rather than producing an event.
+ *
+ * @param cls    The classifier
+ * @param now_ms Time of the sample
+ * @param mv     The sample
+ * @param key    The key of the event, left alone without one
+ *
+ * @return The event, ADC_KEY_EVENT_NONE for most samples
+ */
+adc_key_event_t adc_key_classifier_feed(adc_key_classifier_handle_t cls, uint32_t now_ms, int mv, int *key);
+
+/**
+ * @brief When to take the next sample: idle_sample_ms while the input is steady, sample_ms while it moves
+ */
+int adc_key_classifier_period_ms(adc_key_classifier_handle_t cls);
+
+/**
+ * @brief The key that is down, ADC_KEY_NONE for none
+ */
+int adc_key_classifier_key(adc_key_classifier_handle_t cls);
+
+/**
+ * @brief Forget the input and any key that is down, without events
+ */
+void adc_key_classifier_reset(adc_key_classifier_handle_t cls);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
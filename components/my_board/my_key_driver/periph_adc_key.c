@@ -0,0 +1,133 @@
+/*
+ * ESPRESSIF MIT License
+ *
+ * Copyright (c) 2020 <ESPRESSIF SYSTEMS (SHANGHAI) CO., LTD>
+ *
+ * Permission is hereby granted for use on all ESPRESSIF SYSTEMS products, in which case,
+ * it is free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#include <string.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_adc_cal.h"
+#include "audio_mem.h"
+#include "audio_error.h"
+#include "periph_adc_button.h"
+#include "periph_adc_key.h"
+
+static const char *TAG = "PERIPH_ADC_KEY";
+
+#define ADC_KEY_VREF_MV     (1100)  // used only without eFuse calibration
+
+typedef struct {
+    adc1_channel_t channel;
+    adc_key_classifier_handle_t classifier;
+    esp_adc_cal_characteristics_t cal;
+    esp_timer_handle_t timer;
+    bool running;
+} periph_adc_key_t;
+
+static const int event_cmd[] = {
+    [ADC_KEY_EVENT_PRESSED] = PERIPH_ADC_BUTTON_PRESSED,
+    [ADC_KEY_EVENT_RELEASED] = PERIPH_ADC_BUTTON_RELEASE,
+    [ADC_KEY_EVENT_LONG_PRESSED] = PERIPH_ADC_BUTTON_LONG_PRESSED,
+    [ADC_KEY_EVENT_LONG_RELEASED] = PERIPH_ADC_BUTTON_LONG_RELEASE,
+};
+
+/**
+ * @brief One sample, in the esp_timer task; schedules the next one
+ */
+static void adc_key_sample(void *arg)
+{
+    esp_periph_handle_t self = (esp_periph_handle_t)arg;
+    periph_adc_key_t *adc_key = esp_periph_get_data(self);
+    if (!adc_key->running) {
+        return;
+    }
+    int mv = esp_adc_cal_raw_to_voltage(adc1_get_raw(adc_key->channel), &adc_key->cal);
+    int key = ADC_KEY_NONE;
+    adc_key_event_t event = adc_key_classifier_feed(adc_key->classifier, esp_timer_get_time() / 1000, mv, &key);
+    if (event != ADC_KEY_EVENT_NONE) {
+        ESP_LOGD(TAG, "key %d event %d at %d mV", key, event, mv);
+        esp_periph_send_event(self, event_cmd[event], (void *)(intptr_t)key, 0);
+    }
+    esp_timer_start_once(adc_key->timer, adc_key_classifier_period_ms(adc_key->classifier) * 1000);
+}
+
+static esp_err_t _adc_key_init(esp_periph_handle_t self)
+{
+    periph_adc_key_t *adc_key = esp_periph_get_data(self);
+    adc1_config_width(ADC_WIDTH_BIT_12);
+    adc1_config_channel_atten(adc_key->channel, ADC_ATTEN_DB_11);
+    esp_adc_cal_characterize(ADC_UNIT_1, ADC_ATTEN_DB_11, ADC_WIDTH_BIT_12, ADC_KEY_VREF_MV, &adc_key->cal);
+    adc_key_classifier_reset(adc_key->classifier);
+    esp_timer_create_args_t timer_args = {
+        .callback = adc_key_sample,
+        .arg = self,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name = "adc_key",
+    };
+    esp_err_t ret = esp_timer_create(&timer_args, &adc_key->timer);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "esp_timer_create failed, %s", esp_err_to_name(ret));
+        return ret;
+    }
+    adc_key->running = true;
+    return esp_timer_start_once(adc_key->timer, adc_key_classifier_period_ms(adc_key->classifier) * 1000);
+}
+
+static esp_err_t _adc_key_run(esp_periph_handle_t self, audio_event_iface_msg_t *msg)
+{
+    return ESP_OK;
+}
+
+static esp_err_t _adc_key_destroy(esp_periph_handle_t self)
+{
+    periph_adc_key_t *adc_key = esp_periph_get_data(self);
+    adc_key->running = false;
+    if (adc_key->timer) {
+        esp_timer_stop(adc_key->timer);
+        esp_timer_delete(adc_key->timer);
+    }
+    adc_key_classifier_destroy(adc_key->classifier);
+    audio_free(adc_key);
+    return ESP_OK;
+}
+
+esp_periph_handle_t periph_adc_key_init(const periph_adc_key_cfg_t *cfg)
+{
+    AUDIO_NULL_CHECK(TAG, cfg, return NULL);
+    periph_adc_key_t *adc_key = audio_calloc(1, sizeof(periph_adc_key_t));
+    AUDIO_MEM_CHECK(TAG, adc_key, return NULL);
+    adc_key->channel = cfg->channel;
+    adc_key->classifier = adc_key_classifier_create(&cfg->classifier);
+    if (!adc_key->classifier) {
+        audio_free(adc_key);
+        return NULL;
+    }
+    esp_periph_handle_t periph = esp_periph_create(PERIPH_ID_ADC_BTN, "periph_adc_key");
+    if (!periph) {
+        adc_key_classifier_destroy(adc_key->classifier);
+        audio_free(adc_key);
+        return NULL;
+    }
+    esp_periph_set_data(periph, adc_key);
+    esp_periph_set_function(periph, _adc_key_init, _adc_key_run, _adc_key_destroy);
+    return periph;
+}
@@ -0,0 +1,69 @@
+/*
+ * ESPRESSIF MIT License
+ *
+ * Copyright (c) 2020 <ESPRESSIF SYSTEMS (SHANGHAI) CO., LTD>
+ *
+ * Permission is hereby granted for use on all ESPRESSIF SYSTEMS products, in which case,
+ * it is free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#ifndef __PERIPH_ADC_KEY_H__
+#define __PERIPH_ADC_KEY_H__
+
+#include "driver/adc.h"
+#include "esp_peripherals.h"
+#include "adc_key_classifier.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Keys on a resistor ladder on one ADC1 channel
+ */
+typedef struct {
+    adc1_channel_t              channel;
+    adc_key_classifier_cfg_t    classifier;
+} periph_adc_key_cfg_t;
+
+#define PERIPH_ADC_KEY_DEFAULT_CONFIG() {                   \
+    .channel = ADC1_CHANNEL_0,                              \
+    .classifier = ADC_KEY_CLASSIFIER_CFG_DEFAULT(),         \
+}
+
+/**
+ * @brief Create the ADC key peripheral, a drop-in for periph_adc_button
+ *
+ * It samples the channel from an esp_timer, every sample_ms while the input
+ * moves and every idle_sample_ms while it is steady, and classifies
+ * the samples with adc_key_classifier. Its events look like
+ * periph_adc_button's: source type PERIPH_ID_ADC_BTN, cmd one of
+ * PERIPH_ADC_BUTTON_PRESSED, _RELEASE, _LONG_PRESSED, _LONG_RELEASE, data
+ * the key index.
+ *
+ * @param cfg The config
+ *
+ * @return The peripheral handle, NULL on error
+ */
+esp_periph_handle_t periph_adc_key_init(const periph_adc_key_cfg_t *cfg);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,236 @@
+/* Output latency against underruns, fixed decoder buffer depths vs. the adaptive depth
+
+   A decoder that needs 8 ms per 26 ms mp3 frame feeds a ring buffer that an
+   i2s writer with 70 ms of DMA drains in real time, on the simulated clock.
+   The decoder's input stalls as it does when the FAT worker holds the flash:
+   short stalls now and then, and busy phases with frequent stalls of up to
+   400 ms, drawn from a fixed seed so every run sees the same ten minutes.
+
+   Each fixed depth caps the fill of the ring buffer at that many bytes; the
+   adaptive one caps it at adaptive_buffer_sample()'s target, fed the
+   underruns the DMA model counts, for a few quiet_ms. For every run the
+   underruns, the silence they left and the latency (audio queued in the ring
+   buffer and the DMA, what a pause or volume change waits behind) are
+   printed: the trade-off curve.
+
+   Checks, exit status 1 if any fails:
+   - the adaptive target stays within its bounds, grows in the busy phases
+     and shrinks back in the quiet ones;
+   - with the default config it has fewer underruns than the smallest fixed
+     depth and less latency than the largest;
+   - no fixed depth has both fewer underruns and less latency than it.
+
+   Usage: bench_adaptive_buffer
+*/
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "adaptive_buffer.h"
+
+#define BYTE_RATE       (44100 * 4)
+#define FRAME_BYTES     (1152 * 4)
+#define DECODE_US       8000
+#define I2S_READ        3600
+#define DMA_US          69659
+#define RUN_S           600
+#define MAX_STALLS      2048
+#define MAX_BYTES       (96 * 1024)
+
+typedef struct {
+    int64_t at_us;
+    int64_t for_us;
+} stall_t;
+
+static stall_t stalls[MAX_STALLS];
+static int num_stalls;
+static uint32_t seed = 12345;
+
+static uint32_t rnd(void) {
+    seed = seed * 1103515245 + 12345;
+    return seed >> 8;
+}
+
+static double uniform(void) {
+    return (rnd() & 0xffff) / 65536.0;
+}
+
+/**
+ * @brief Quiet minutes with a short stall every few seconds, busy phases of 40 s every 150 s from 60 s on with long ones
+ */
+static void make_stalls(void) {
+    int64_t t = 1000000;
+    while (t < RUN_S * 1000000LL && num_stalls < MAX_STALLS) {
+        bool busy = (t / 1000000) % 150 >= 60 && (t / 1000000) % 150 < 100;
+        int64_t len;
+        if (busy) {
+            // 30 .. 400 ms, most of them short
+            double u = uniform();
+            len = (int64_t)(30000 * (1 + 12.3 * u * u * u));
+            t += 300000 + rnd() % 1500000;
+        } else {
+            len = 5000 + rnd() % 35000;
+            t += 2000000 + rnd() % 4000000;
+        }
+        stalls[num_stalls++] = (stall_t) {
+            .at_us = t, .for_us = len,
+        };
+        t += len;
+    }
+}
+
+static uint32_t sim_underruns;
+
+static uint32_t get_underruns(void *ctx) {
+    return sim_underruns;
+}
+
+typedef struct {
+    uint32_t underruns;
+    int64_t silence_us;
+    double mean_latency_ms;
+    int64_t max_latency_us;
+    adaptive_buffer_stats_t ab;
+    int busy_target;        // target at the end of the last busy phase
+    int quiet_target;       // target at the end of the run, after a quiet phase
+} result_t;
+
+/**
+ * @brief Run the ten minutes with a fixed depth, or with ab when depth is 0
+ */
+static void run(int depth, adaptive_buffer_handle_t ab, result_t *res) {
+    sim_underruns = 0;
+    int64_t start = esp_timer_get_time();
+    int fill = 0;
+    int64_t dma_end = start;        // when the DMA plays out, DMA_US ahead at most
+    int64_t decoded_at = start + DECODE_US;
+    bool starved = true;            // nothing played yet
+    int stall = 0;
+    int64_t latency_sum = 0;
+    int64_t samples = 0;
+    int64_t silence = 0;
+    *res = (result_t) {0};
+    for (int64_t ms = 0; ms < RUN_S * 1000LL; ms++) {
+        int64_t now = start + ms * 1000;
+        int64_t since = now - start;
+        while (stall < num_stalls && stalls[stall].at_us + stalls[stall].for_us <= since) {
+            stall++;
+        }
+        bool stalled = stall < num_stalls && since >= stalls[stall].at_us;
+        if (stalled) {
+            // the decoder waits for input, it decodes as soon as it has it
+            decoded_at = now + DECODE_US;
+        } else if (now >= decoded_at) {
+            int target = ab ? adaptive_buffer_sample(ab, fill) : depth;
+            if (fill == 0 || fill + FRAME_BYTES <= target) {
+                fill += FRAME_BYTES;
+                decoded_at = now + DECODE_US;
+            }
+        }
+        // the writer tops the DMA up whenever a read fits
+        while (dma_end - now <= DMA_US - (int64_t)I2S_READ * 1000000 / BYTE_RATE && fill > 0) {
+            int n = fill < I2S_READ ? fill : I2S_READ;
+            fill -= n;
+            if (dma_end < now) {
+                dma_end = now;
+            }
+            dma_end += (int64_t)n * 1000000 / BYTE_RATE;
+            starved = false;
+        }
+        if (dma_end <= now) {
+            if (!starved) {
+                sim_underruns++;
+                starved = true;
+            }
+            silence += 1000;
+        }
+        int64_t queued = (int64_t)fill * 1000000 / BYTE_RATE + (dma_end > now ? dma_end - now : 0);
+        latency_sum += queued;
+        samples++;
+        if (queued > res->max_latency_us) {
+            res->max_latency_us = queued;
+        }
+        if (ab && since % 150000000 == 100000000 - 1000) {
+            res->busy_target = adaptive_buffer_get_target(ab);
+        }
+        esp_timer_host_advance(1000);
+    }
+    res->underruns = sim_underruns;
+    res->silence_us = silence;
+    res->mean_latency_ms = latency_sum / 1000.0 / samples;
+    if (ab) {
+        adaptive_buffer_get_stats(ab, &res->ab);
+        res->quiet_target = adaptive_buffer_get_target(ab);
+    }
+}
+
+static void print_row(const char *what, const result_t *r) {
+    printf("%-24s %9u %11.1f %13.1f %12.1f\n", what, r->underruns, r->silence_us / 1000.0, r->mean_latency_ms,
+           r->max_latency_us / 1000.0);
+}
+
+int main(int argc, char *argv[]) {
+    esp_log_level_set("*", ESP_LOG_ERROR);
+    make_stalls();
+    int busy = 0;
+    for (int i = 0; i < num_stalls; i++) {
+        busy += stalls[i].for_us > 70000;
+    }
+    printf("%d s, %d input stalls, %d of them longer than the DMA covers\n\n", RUN_S, num_stalls, busy);
+    printf("%-24s %9s %11s %13s %12s\n", "decoder buffer", "underruns", "silence ms", "mean latency", "max latency");
+
+    static const int depths[] = {8 * 1024, 16 * 1024, 24 * 1024, 32 * 1024, 48 * 1024, 64 * 1024, MAX_BYTES};
+    const int num_depths = sizeof(depths) / sizeof(depths[0]);
+    result_t fixed[sizeof(depths) / sizeof(depths[0])];
+    for (int i = 0; i < num_depths; i++) {
+        char what[32];
+        snprintf(what, sizeof(what), "fixed %d KiB", depths[i] / 1024);
+        run(depths[i], NULL, &fixed[i]);
+        print_row(what, &fixed[i]);
+    }
+
+    static const int quiet_s[] = {5, 20, 60};
+    const int def = 1;      // ADAPTIVE_BUFFER_CFG_DEFAULT()
+    result_t adaptive[sizeof(quiet_s) / sizeof(quiet_s[0])];
+    int ret = 0;
+    for (int q = 0; q < (int)(sizeof(quiet_s) / sizeof(quiet_s[0])); q++) {
+        adaptive_buffer_cfg_t cfg = ADAPTIVE_BUFFER_CFG_DEFAULT();
+        cfg.max_bytes = MAX_BYTES;
+        cfg.quiet_ms = quiet_s[q] * 1000;
+        cfg.underruns = get_underruns;
+        adaptive_buffer_handle_t ab = adaptive_buffer_create(&cfg);
+        char what[32];
+        snprintf(what, sizeof(what), "adaptive, %d s quiet", quiet_s[q]);
+        run(0, ab, &adaptive[q]);
+        print_row(what, &adaptive[q]);
+        const adaptive_buffer_stats_t *st = &adaptive[q].ab;
+        printf("    target %d KiB after the last busy phase, %d KiB at the end, peak %d KiB, "
+               "%u grows, %u shrinks, %u underrun and %u near underrun windows\n",
+               adaptive[q].busy_target / 1024, adaptive[q].quiet_target / 1024, st->target_peak / 1024, st->grows,
+               st->shrinks, st->underruns, st->near_underruns);
+        if (st->target_peak > cfg.max_bytes || adaptive[q].quiet_target < cfg.min_bytes) {
+            fprintf(stderr, "%s: target out of bounds\n", what);
+            ret = 1;
+        }
+        if (adaptive[q].busy_target <= cfg.min_bytes || adaptive[q].quiet_target >= adaptive[q].busy_target) {
+            fprintf(stderr, "%s: the target did not follow the busy and quiet phases\n", what);
+            ret = 1;
+        }
+        adaptive_buffer_destroy(ab);
+    }
+
+    const result_t *a = &adaptive[def];
+    if (a->underruns >= fixed[0].underruns || a->mean_latency_ms >= fixed[num_depths - 1].mean_latency_ms) {
+        fprintf(stderr, "adaptive: no better than the smallest or the largest fixed depth\n");
+        ret = 1;
+    }
+    for (int i = 0; i < num_depths; i++) {
+        if (fixed[i].underruns < a->underruns && fixed[i].mean_latency_ms < a->mean_latency_ms) {
+            fprintf(stderr, "adaptive: fixed %d KiB has fewer underruns and less latency\n", depths[i] / 1024);
+            ret = 1;
+        }
+    }
+    return ret;
+}
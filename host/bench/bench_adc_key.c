@@ -0,0 +1,382 @@
+/* ADC key press latency, misreads and sample rate of adc_key_classifier
+
+   The keys of the board are a resistor ladder on one ADC1 channel. A trace
+   of what the channel reads, 1 ms per sample, is drawn from a fixed seed:
+   idle near 3.1 V, presses of each key at the middle of its band off by
+   resistor tolerance, contact bounce and an RC edge on press and release,
+   noise, and a spike now and then; short taps, holds and long presses. The
+   classifier samples it as periph_adc_key does, at the period it asks for.
+   For comparison a fixed poller reads it every 20 ms and takes a key after
+   three equal polls, without filter or hysteresis.
+
+   For each the table shows presses found, wrong keys, missed and spurious
+   presses, the mean and worst latency from the contact to the press event
+   and from the release to the release event, and samples per second.
+
+   Checks, exit status 1 if any fails:
+   - the classifier finds every press with the right key and nothing else,
+     every long press and no other;
+   - its worst press latency is within idle_sample_ms + press_ms + the
+     bounce + three samples, its worst release latency likewise with
+     release_ms;
+   - it samples less often than a fixed rate at sample_ms would, and its
+     mean press latency is below the poller's.
+
+   Usage: bench_adc_key [-w trace.txt | trace.txt]
+     -w writes the drawn trace; a trace file replaces it: "<ms> <mV>" lines,
+     and "# press <key> <down ms> <up ms>" lines for what was pressed.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "esp_log.h"
+#include "adc_key_classifier.h"
+#include "bench_clock.h"
+
+#define TRACE_MS        (180 * 1000)
+#define MAX_PRESSES     1024
+#define IDLE_MV         3120
+#define NOISE_MV        12
+#define TOLERANCE_MV    60
+#define BOUNCE_MAX_MS   6
+#define POLL_MS         20
+#define POLL_EQUAL      3
+#define MATCH_MS        200     // an event this long after the release still belongs to the press
+
+typedef struct {
+    int key;
+    int down_ms;
+    int up_ms;
+} press_t;
+
+typedef struct {
+    int found;
+    int wrong;
+    int missed;
+    int spurious;
+    int long_found;
+    int long_wrong;
+    int64_t press_sum;
+    int press_max;
+    int64_t release_sum;
+    int release_max;
+    int releases;
+    int samples;
+} result_t;
+
+typedef struct {
+    int ms;
+    adc_key_event_t event;
+    int key;
+} event_t;
+
+static int16_t *trace;
+static int trace_ms;
+static press_t presses[MAX_PRESSES];
+static int num_presses;
+static event_t events[4 * MAX_PRESSES + 64];
+static int num_events;
+
+static uint32_t seed = 12345;
+
+static uint32_t rnd(void) {
+    seed = seed * 1103515245 + 12345;
+    return seed >> 8;
+}
+
+static int rnd_range(int lo, int hi) {
+    return lo + (int)(rnd() % (uint32_t)(hi - lo + 1));
+}
+
+static int noise(void) {
+    // four uniforms, near enough to a normal
+    int n = 0;
+    for (int i = 0; i < 4; i++) {
+        n += rnd_range(-NOISE_MV, NOISE_MV);
+    }
+    return n / 2;
+}
+
+/**
+ * @brief Contact bounce then an RC edge from the trace's value at t towards target
+ * @return the ms after t the edge took to land
+ */
+static int edge(int t, int from, int target) {
+    int bounce = rnd_range(1, BOUNCE_MAX_MS);
+    int v = from;
+    int i = 0;
+    for (; i < bounce && t + i < trace_ms; i++) {
+        trace[t + i] = (rnd() & 1) ? target : from;
+    }
+    v = trace[t + i - 1];
+    for (; i < bounce + 12 && t + i < trace_ms; i++) {
+        v += (target - v) * 2 / 5;
+        trace[t + i] = v;
+    }
+    return i;
+}
+
+static void draw_trace(const adc_key_classifier_cfg_t *cfg) {
+    trace_ms = TRACE_MS;
+    for (int t = 0; t < trace_ms; t++) {
+        trace[t] = IDLE_MV;
+    }
+    int t = 500;
+    while (num_presses < MAX_PRESSES) {
+        int key = rnd_range(0, cfg->num_keys - 1);
+        int kind = rnd_range(0, 99);
+        int hold = kind < 70 ? rnd_range(60, 400) : kind < 85 ? rnd_range(400, 1500) : rnd_range(2300, 4000);
+        if (t + hold + 1000 >= trace_ms) {
+            break;
+        }
+        int level = (cfg->levels[key] + cfg->levels[key + 1]) / 2 + rnd_range(-TOLERANCE_MV, TOLERANCE_MV);
+        int n = edge(t, IDLE_MV, level);
+        for (int i = n; i < hold; i++) {
+            trace[t + i] = level;
+        }
+        edge(t + hold, level, IDLE_MV);
+        presses[num_presses++] = (press_t) {key, t, t + hold};
+        t += hold + rnd_range(150, 800);
+    }
+    for (int i = 0; i < trace_ms; i++) {
+        trace[i] += noise();
+        if (rnd_range(0, 399) == 0) {
+            trace[i] += (rnd() & 1 ? 1 : -1) * rnd_range(200, 500);
+        }
+    }
+}
+
+static int load_trace(const char *path) {
+    FILE *f = fopen(path, "r");
+    if (!f) {
+        fprintf(stderr, "cannot open %s\n", path);
+        return -1;
+    }
+    char line[128];
+    trace_ms = 0;
+    while (fgets(line, sizeof(line), f)) {
+        press_t p;
+        int ms, mv;
+        if (sscanf(line, "# press %d %d %d", &p.key, &p.down_ms, &p.up_ms) == 3 && num_presses < MAX_PRESSES) {
+            presses[num_presses++] = p;
+        } else if (line[0] != '#' && sscanf(line, "%d %d", &ms, &mv) == 2 && ms >= 0 && ms < TRACE_MS) {
+            // gaps keep the value before them
+            for (int t = trace_ms; t < ms; t++) {
+                trace[t] = t ? trace[t - 1] : IDLE_MV;
+            }
+            trace[ms] = mv;
+            trace_ms = ms + 1 > trace_ms ? ms + 1 : trace_ms;
+        }
+    }
+    fclose(f);
+    return trace_ms ? 0 : -1;
+}
+
+static int save_trace(const char *path) {
+    FILE *f = fopen(path, "w");
+    if (!f) {
+        fprintf(stderr, "cannot write %s\n", path);
+        return -1;
+    }
+    for (int i = 0; i < num_presses; i++) {
+        fprintf(f, "# press %d %d %d\n", presses[i].key, presses[i].down_ms, presses[i].up_ms);
+    }
+    for (int t = 0; t < trace_ms; t++) {
+        fprintf(f, "%d %d\n", t, trace[t]);
+    }
+    fclose(f);
+    return 0;
+}
+
+static void add_event(int ms, adc_key_event_t event, int key) {
+    if (num_events < sizeof(events) / sizeof(events[0])) {
+        events[num_events++] = (event_t) {ms, event, key};
+    }
+}
+
+static void run_classifier(adc_key_classifier_handle_t cls, result_t *r, double *ns_per_sample) {
+    num_events = 0;
+    uint64_t t0 = bench_now_ns();
+    for (int t = 0; t < trace_ms; t += adc_key_classifier_period_ms(cls)) {
+        int key = ADC_KEY_NONE;
+        adc_key_event_t event = adc_key_classifier_feed(cls, t, trace[t], &key);
+        if (event != ADC_KEY_EVENT_NONE) {
+            add_event(t, event, key);
+        }
+        r->samples++;
+    }
+    *ns_per_sample = (double)(bench_now_ns() - t0) / r->samples;
+}
+
+/**
+ * @brief The fixed poller: the key of the band a poll reads, no hysteresis, after POLL_EQUAL equal polls
+ */
+static void run_poller(const adc_key_classifier_cfg_t *cfg, result_t *r) {
+    num_events = 0;
+    int key = ADC_KEY_NONE;
+    int last = ADC_KEY_NONE;
+    int equal = 0;
+    for (int t = 0; t < trace_ms; t += POLL_MS) {
+        int read = ADC_KEY_NONE;
+        for (int i = 0; i < cfg->num_keys; i++) {
+            if (trace[t] >= cfg->levels[i] && trace[t] < cfg->levels[i + 1]) {
+                read = i;
+            }
+        }
+        equal = read == last ? equal + 1 : 1;
+        last = read;
+        if (equal == POLL_EQUAL && read != key) {
+            if (key != ADC_KEY_NONE) {
+                add_event(t, ADC_KEY_EVENT_RELEASED, key);
+            }
+            if (read != ADC_KEY_NONE) {
+                add_event(t, ADC_KEY_EVENT_PRESSED, read);
+            }
+            key = read;
+        }
+        r->samples++;
+    }
+}
+
+/**
+ * @brief Match the events to the presses
+ */
+static void score(const adc_key_classifier_cfg_t *cfg, result_t *r) {
+    int e = 0;
+    for (int p = 0; p < num_presses; p++) {
+        const press_t *pr = &presses[p];
+        int next_down = p + 1 < num_presses ? presses[p + 1].down_ms : trace_ms;
+        int end = pr->up_ms + MATCH_MS < next_down ? pr->up_ms + MATCH_MS : next_down;
+        // events before this press that no earlier press took
+        for (; e < num_events && events[e].ms < pr->down_ms; e++) {
+            if (events[e].event == ADC_KEY_EVENT_PRESSED) {
+                r->spurious++;
+            }
+        }
+        bool pressed = false, long_pressed = false;
+        for (; e < num_events && events[e].ms < end; e++) {
+            const event_t *ev = &events[e];
+            if (ev->event == ADC_KEY_EVENT_PRESSED) {
+                if (pressed) {
+                    r->spurious++;
+                    continue;
+                }
+                pressed = true;
+                if (ev->key != pr->key) {
+                    r->wrong++;
+                    continue;
+                }
+                r->found++;
+                int latency = ev->ms - pr->down_ms;
+                r->press_sum += latency;
+                r->press_max = latency > r->press_max ? latency : r->press_max;
+            } else if (ev->event == ADC_KEY_EVENT_LONG_PRESSED) {
+                long_pressed = true;
+            } else {
+                int latency = ev->ms - pr->up_ms;
+                r->releases++;
+                r->release_sum += latency;
+                r->release_max = latency > r->release_max ? latency : r->release_max;
+            }
+        }
+        if (!pressed) {
+            r->missed++;
+        }
+        // a hold within 100 ms of long_press_ms may go either way
+        int hold = pr->up_ms - pr->down_ms;
+        if (hold > cfg->long_press_ms + 100) {
+            r->long_found += long_pressed;
+            r->long_wrong += !long_pressed;
+        } else if (hold < cfg->long_press_ms - 100) {
+            r->long_wrong += long_pressed;
+        }
+    }
+    for (; e < num_events; e++) {
+        if (events[e].event == ADC_KEY_EVENT_PRESSED) {
+            r->spurious++;
+        }
+    }
+}
+
+static void print_result(const char *name, const result_t *r) {
+    printf("%-12s %5d %5d %6d %8d %6.1f %5d %6.1f %5d %8.1f\n", name, r->found, r->wrong, r->missed, r->spurious,
+           r->found ? (double)r->press_sum / r->found : 0, r->press_max,
+           r->releases ? (double)r->release_sum / r->releases : 0, r->release_max, r->samples * 1000.0 / trace_ms);
+}
+
+int main(int argc, char *argv[]) {
+    esp_log_level_set("*", ESP_LOG_ERROR);
+    adc_key_classifier_cfg_t cfg = ADC_KEY_CLASSIFIER_CFG_DEFAULT();
+    trace = calloc(TRACE_MS, sizeof(int16_t));
+    if (!trace) {
+        return 1;
+    }
+    const char *write_path = NULL;
+    if (argc > 2 && !strcmp(argv[1], "-w")) {
+        write_path = argv[2];
+    } else if (argc > 1) {
+        if (load_trace(argv[1]) != 0) {
+            return 1;
+        }
+    }
+    if (!trace_ms) {
+        draw_trace(&cfg);
+    }
+    if (write_path && save_trace(write_path) != 0) {
+        return 1;
+    }
+    int longs = 0;
+    for (int i = 0; i < num_presses; i++) {
+        longs += presses[i].up_ms - presses[i].down_ms > cfg.long_press_ms;
+    }
+    printf("%d s of ADC samples, %d presses, %d of them long\n", trace_ms / 1000, num_presses, longs);
+    printf("%-12s %5s %5s %6s %8s %6s %5s %6s %5s %8s\n", "", "found", "wrong", "missed", "spurious", "press",
+           "max", "rel", "max", "samples/s");
+
+    adc_key_classifier_handle_t cls = adc_key_classifier_create(&cfg);
+    if (!cls) {
+        return 1;
+    }
+    result_t classified = {0};
+    double ns_per_sample;
+    run_classifier(cls, &classified, &ns_per_sample);
+    score(&cfg, &classified);
+    adc_key_classifier_destroy(cls);
+    print_result("classifier", &classified);
+
+    result_t polled = {0};
+    run_poller(&cfg, &polled);
+    score(&cfg, &polled);
+    print_result("poll 20 ms", &polled);
+    printf("classifier: %d of %d long presses, %d wrong; %.0f ns per sample\n", classified.long_found, longs,
+           classified.long_wrong, ns_per_sample);
+
+    int failed = 0;
+    if (classified.found != num_presses || classified.wrong || classified.missed || classified.spurious ||
+        classified.long_wrong) {
+        fprintf(stderr, "classifier: %d of %d presses, %d wrong, %d missed, %d spurious, %d long presses wrong\n",
+                classified.found, num_presses, classified.wrong, classified.missed, classified.spurious,
+                classified.long_wrong);
+        failed = 1;
+    }
+    int press_bound = cfg.idle_sample_ms + cfg.press_ms + BOUNCE_MAX_MS + 3 * cfg.sample_ms;
+    int release_bound = cfg.idle_sample_ms + cfg.release_ms + BOUNCE_MAX_MS + 3 * cfg.sample_ms;
+    if (classified.press_max > press_bound || classified.release_max > release_bound) {
+        fprintf(stderr, "classifier: press latency up to %d ms, release %d ms, at most %d and %d expected\n",
+                classified.press_max, classified.release_max, press_bound, release_bound);
+        failed = 1;
+    }
+    if (classified.samples * cfg.sample_ms >= trace_ms) {
+        fprintf(stderr, "classifier: %d samples, a fixed %d ms rate takes %d\n", classified.samples, cfg.sample_ms,
+                trace_ms / cfg.sample_ms);
+        failed = 1;
+    }
+    if (classified.press_sum * polled.found >= polled.press_sum * classified.found) {
+        fprintf(stderr, "classifier: mean press latency not below the poller's\n");
+        failed = 1;
+    }
+    free(trace);
+    printf("%s\n", failed ? "FAILED" : "OK");
+    return failed;
+}
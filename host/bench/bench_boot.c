@@ -0,0 +1,214 @@
+/* Boot to first audio with the storage partition erased at every boot, and with the fast boot
+
+   storage_boot runs as in init_fatfs() and worker(), on the simulated clock,
+   against a model of the 1 MB storage partition on the board's flash. The
+   model charges the flash times of what each step does:
+   - erase: 16 64 KiB block erases, as esp_partition_erase_range() does on
+     the block-aligned partition;
+   - mount: wear levelling state and FAT boot sector, FAT and root directory
+     read; a partition without a file system is formatted instead, wear
+     levelling state and FAT written sector by sector (FORMAT_SECTORS);
+   - validate: the root directory read, and the probe file written (its
+     directory, FAT and data sectors) and read back;
+   - seed (PLAY_FROM_STORAGE): the asset written, sector by sector.
+   A written sector is erased and programmed. The player's first audio comes
+   FIRST_FRAME_US after the mount, one mp3 frame decoded; the worker
+   validates 5 s after the mount.
+
+   Scenarios: a sound file system, a blank partition (first boot), a file
+   system that mounts but fails validation, and one that does not mount.
+
+   Checks, exit status 1 if any fails:
+   - with a sound file system the fast boot has audio 10 times sooner than
+     the erasing boot, and erases nothing;
+   - every scenario ends validated with a sound, seeded file system; only
+     the one that fails validation is repaired, once.
+
+   Usage: bench_boot
+*/
+
+#include <stdio.h>
+#include <stdbool.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "music_assets.h"
+#include "storage_boot.h"
+
+#define PARTITION_SIZE      (1024 * 1024)
+#define SECTOR_SIZE         4096
+#define BLOCK_SIZE          (64 * 1024)
+/* typical ESP32 QIO flash, as FLASH_LATENCY_MODEL_DEFAULT(), and 150 ms for a 64 KiB block erase */
+#define SECTOR_ERASE_US     45000
+#define BLOCK_ERASE_US      150000
+#define PROGRAM_US_PER_KIB  2800
+#define READ_US_PER_KIB     50
+#define MOUNT_READ_SECTORS  8       // wear levelling state, boot sector, FAT, root directory
+#define FORMAT_SECTORS      10      // wear levelling state and config, boot sector, two FATs, root directory
+#define ROOT_DIR_SECTORS    4
+#define PROBE_SECTORS       3       // directory entry, FAT, data
+#define FIRST_FRAME_US      8000
+#define VALIDATE_AFTER_MS   5000
+#define SEED_ASSET          2
+
+typedef enum {
+    FS_BLANK,
+    FS_SOUND,
+    FS_CORRUPT,             // mounts, fails validation
+    FS_UNMOUNTABLE,
+} fs_state_t;
+
+typedef struct {
+    fs_state_t state;
+    bool mounted;
+    bool seeded;
+    int sectors_erased;
+    int sectors_written;
+} flash_model_t;
+
+static void read_sectors(int n) {
+    esp_timer_host_advance((int64_t)n * SECTOR_SIZE / 1024 * READ_US_PER_KIB);
+}
+
+static void write_sectors(flash_model_t *f, int n) {
+    f->sectors_erased += n;
+    f->sectors_written += n;
+    esp_timer_host_advance((int64_t)n * (SECTOR_ERASE_US + SECTOR_SIZE / 1024 * PROGRAM_US_PER_KIB));
+}
+
+static esp_err_t model_mount(void *ctx) {
+    flash_model_t *f = (flash_model_t *)ctx;
+    read_sectors(MOUNT_READ_SECTORS);
+    if (f->state == FS_BLANK || f->state == FS_UNMOUNTABLE) {
+        // format_if_mount_failed
+        write_sectors(f, FORMAT_SECTORS);
+        f->state = FS_SOUND;
+        f->seeded = false;
+    }
+    f->mounted = true;
+    return ESP_OK;
+}
+
+static esp_err_t model_unmount(void *ctx) {
+    ((flash_model_t *)ctx)->mounted = false;
+    return ESP_OK;
+}
+
+static esp_err_t model_erase(void *ctx) {
+    flash_model_t *f = (flash_model_t *)ctx;
+    if (f->mounted) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    f->sectors_erased += PARTITION_SIZE / SECTOR_SIZE;
+    esp_timer_host_advance((int64_t)PARTITION_SIZE / BLOCK_SIZE * BLOCK_ERASE_US);
+    f->state = FS_BLANK;
+    f->seeded = false;
+    return ESP_OK;
+}
+
+static esp_err_t model_validate(void *ctx) {
+    flash_model_t *f = (flash_model_t *)ctx;
+    read_sectors(ROOT_DIR_SECTORS);
+    write_sectors(f, PROBE_SECTORS);
+    read_sectors(1);
+    return f->mounted && f->state == FS_SOUND ? ESP_OK : ESP_FAIL;
+}
+
+static esp_err_t model_seed(void *ctx) {
+    flash_model_t *f = (flash_model_t *)ctx;
+    if (!f->seeded) {
+        const embed_asset_t *asset = &music_assets[SEED_ASSET];
+        int size = asset->end - asset->start;
+        write_sectors(f, (size + SECTOR_SIZE - 1) / SECTOR_SIZE + 2);
+        f->seeded = true;
+    }
+    return ESP_OK;
+}
+
+typedef struct {
+    const char *name;
+    fs_state_t state;
+    bool fast;
+    bool seed;
+} scenario_t;
+
+typedef struct {
+    storage_boot_stats_t stats;
+    flash_model_t flash;
+    esp_err_t mount_err;
+    esp_err_t validate_err;
+} outcome_t;
+
+static void run(const scenario_t *sc, outcome_t *out) {
+    flash_model_t *f = &out->flash;
+    *f = (flash_model_t) {
+        .state = sc->state,
+        .seeded = sc->state == FS_SOUND || sc->state == FS_CORRUPT,
+    };
+    // each boot starts at 0, with nothing of the one before
+    esp_timer_host_advance(-esp_timer_get_time());
+    storage_boot_reset();
+    storage_boot_cfg_t cfg = {
+        .fast = sc->fast,
+        .mount = model_mount,
+        .unmount = model_unmount,
+        .erase = model_erase,
+        .validate = model_validate,
+        .seed = sc->seed ? model_seed : NULL,
+        .ctx = f,
+    };
+    out->mount_err = storage_boot_mount(&cfg);
+    esp_timer_host_advance(FIRST_FRAME_US);
+    storage_boot_first_audio();
+    esp_timer_host_advance(VALIDATE_AFTER_MS * 1000LL);
+    out->validate_err = storage_boot_validate();
+    storage_boot_get_stats(&out->stats);
+}
+
+int main(int argc, char *argv[]) {
+    esp_log_level_set("*", ESP_LOG_ERROR);
+    static const scenario_t scenarios[] = {
+        {"erase, sound fs", FS_SOUND, false, false},
+        {"fast, sound fs", FS_SOUND, true, false},
+        {"fast, blank", FS_BLANK, true, false},
+        {"fast, fails check", FS_CORRUPT, true, false},
+        {"fast, unmountable", FS_UNMOUNTABLE, true, false},
+        {"erase, seeded", FS_SOUND, false, true},
+        {"fast, seeded", FS_SOUND, true, true},
+        {"fast, seeded, fails", FS_CORRUPT, true, true},
+    };
+    const int n = sizeof(scenarios) / sizeof(scenarios[0]);
+    outcome_t out[sizeof(scenarios) / sizeof(scenarios[0])];
+    int failed = 0;
+
+    printf("%-22s %8s %9s %8s %10s %7s %7s %7s\n", "boot", "mount_ms", "audio_ms", "erase_ms", "valid_ms",
+           "repairs", "erased", "written");
+    for (int i = 0; i < n; i++) {
+        const scenario_t *sc = &scenarios[i];
+        outcome_t *o = &out[i];
+        run(sc, o);
+        const storage_boot_stats_t *s = &o->stats;
+        printf("%-22s %8d %9d %8d %10d %7u %7d %7d\n", sc->name, (int)(s->mounted_us / 1000),
+               (int)(s->first_audio_us / 1000), (int)(s->erase_us / 1000), (int)(s->validated_us / 1000), s->repairs,
+               o->flash.sectors_erased, o->flash.sectors_written);
+        bool sound = o->flash.state == FS_SOUND && o->flash.mounted && (o->flash.seeded || !sc->seed);
+        unsigned want_repairs = sc->fast && sc->state == FS_CORRUPT;
+        if (o->mount_err != ESP_OK || o->validate_err != ESP_OK || !s->validated_us || !sound ||
+            s->repairs != want_repairs) {
+            fprintf(stderr, "%s: mount %d, validation %d, %s, %u repairs, %u expected\n", sc->name, o->mount_err,
+                    o->validate_err, sound ? "sound" : "not sound", s->repairs, want_repairs);
+            failed = 1;
+        }
+    }
+    for (int i = 0; i + 1 < n; i += 5) {
+        // the erasing boot and the fast one of the same partition
+        const outcome_t *erase = &out[i], *fast = &out[i + 1];
+        if (fast->stats.erase_us || fast->stats.first_audio_us * 10 > erase->stats.first_audio_us) {
+            fprintf(stderr, "%s: audio at %d ms, erased %d ms; %s: %d ms\n", scenarios[i + 1].name,
+                    (int)(fast->stats.first_audio_us / 1000), (int)(fast->stats.erase_us / 1000), scenarios[i].name,
+                    (int)(erase->stats.first_audio_us / 1000));
+            failed = 1;
+        }
+    }
+    printf("%s\n", failed ? "FAILED" : "OK");
+    return failed;
+}
@@ -0,0 +1,302 @@
+/* Boot to first audio with the init steps one after another, and as a graph on both cores
+
+   The steps and dependencies are the player's boot_steps (app_main), each
+   a model of what it takes on the ESP32 at 240 MHz:
+
+   nvs        nvs_flash_init(), its pages read                    25 ms
+   placement  the task plan read from NVS                          2 ms
+   fatfs      storage_boot_mount(), as bench_boot has it: a sound file
+              system mounts in 1 ms, a blank partition formats in
+              563 ms, the erasing boot takes 2963 ms
+   fat_check  the FAT worker created                               1 ms
+   board      audio_board_init(), the codec over I2C              40 ms
+   pipeline   playlist, i2s, decoder chain, latency trace         35 ms
+   resume     the position read from NVS and the playlist seeked   3 ms
+   keys       the peripheral set and the ADC keys                 12 ms
+   play       audio_pipeline_run()                                 5 ms
+
+   First audio comes FIRST_AUDIO_MS after the play step, one mp3 frame
+   decoded. A scheduler on the simulated clock runs the graph through
+   boot_graph_take() and boot_graph_done() as the runner tasks do: on one
+   core the steps run in table order, which is the old app_main; on two
+   cores a free core takes the first ready step.
+
+   Checks, exit status 1 if any fails:
+   - every step starts after the steps it depends on end, is ready when the
+     last of them ends, and a core runs one step at a time;
+   - on two cores first audio comes before the FAT FS is mounted whenever
+     the mount takes longer than the audio steps, and never later than on
+     one core;
+   - a failed step skips the steps that depend on it and only them;
+   - without runner tasks boot_graph_start() runs every step in table
+     order; a table with a dependency on a later step is refused.
+
+   Usage: bench_boot_graph
+*/
+
+#include <stdio.h>
+#include <stdbool.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "boot_graph.h"
+
+#define FIRST_AUDIO_MS  8
+
+enum {
+    STEP_NVS,
+    STEP_PLACEMENT,
+    STEP_FATFS,
+    STEP_FAT_CHECK,
+    STEP_BOARD,
+    STEP_PIPELINE,
+    STEP_RESUME,
+    STEP_KEYS,
+    STEP_PLAY,
+    NUM_STEPS,
+};
+
+static esp_err_t step_fn(void *ctx) {
+    return ESP_OK;
+}
+
+static const boot_step_t steps[NUM_STEPS] = {
+    [STEP_NVS] = {"nvs", step_fn, 0, BOOT_GRAPH_ANY_CORE},
+    [STEP_PLACEMENT] = {"placement", step_fn, BOOT_GRAPH_DEP(STEP_NVS), BOOT_GRAPH_ANY_CORE},
+    [STEP_FATFS] = {"fatfs", step_fn, 0, BOOT_GRAPH_ANY_CORE},
+    [STEP_FAT_CHECK] = {"fat_check", step_fn, BOOT_GRAPH_DEP(STEP_FATFS) | BOOT_GRAPH_DEP(STEP_PLACEMENT),
+                        BOOT_GRAPH_ANY_CORE},
+    [STEP_BOARD] = {"board", step_fn, 0, BOOT_GRAPH_ANY_CORE},
+    [STEP_PIPELINE] = {"pipeline", step_fn, BOOT_GRAPH_DEP(STEP_PLACEMENT), BOOT_GRAPH_ANY_CORE},
+    [STEP_RESUME] = {"resume", step_fn, BOOT_GRAPH_DEP(STEP_NVS) | BOOT_GRAPH_DEP(STEP_PIPELINE),
+                     BOOT_GRAPH_ANY_CORE},
+    [STEP_KEYS] = {"keys", step_fn, 0, BOOT_GRAPH_ANY_CORE},
+    [STEP_PLAY] = {"play", step_fn, BOOT_GRAPH_DEP(STEP_BOARD) | BOOT_GRAPH_DEP(STEP_PIPELINE) |
+                   BOOT_GRAPH_DEP(STEP_RESUME), BOOT_GRAPH_ANY_CORE},
+};
+
+static const int step_ms[NUM_STEPS] = {
+    [STEP_NVS] = 25,
+    [STEP_PLACEMENT] = 2,
+    [STEP_FATFS] = 1,
+    [STEP_FAT_CHECK] = 1,
+    [STEP_BOARD] = 40,
+    [STEP_PIPELINE] = 35,
+    [STEP_RESUME] = 3,
+    [STEP_KEYS] = 12,
+    [STEP_PLAY] = 5,
+};
+
+typedef struct {
+    const char *name;
+    int fatfs_ms;
+} scenario_t;
+
+typedef struct {
+    boot_step_time_t times[NUM_STEPS];
+    int first_audio_ms;
+    int fatfs_ms;
+    int all_ms;
+} outcome_t;
+
+static void set_clock(int64_t us) {
+    esp_timer_host_advance(us - esp_timer_get_time());
+}
+
+/**
+ * @brief Run the graph on the simulated clock, a step fails if fail is its index
+ */
+static boot_graph_handle_t simulate(int cores, int fatfs_ms, int fail, outcome_t *out) {
+    boot_graph_cfg_t cfg = BOOT_GRAPH_CFG_DEFAULT();
+    cfg.steps = steps;
+    cfg.num_steps = NUM_STEPS;
+    cfg.cores = cores;
+    set_clock(0);
+    boot_graph_handle_t graph = boot_graph_create(&cfg);
+    if (!graph) {
+        return NULL;
+    }
+    int running[BOOT_GRAPH_MAX_CORES];
+    int64_t ends[BOOT_GRAPH_MAX_CORES];
+    for (int c = 0; c < cores; c++) {
+        running[c] = -1;
+    }
+    int64_t now = 0;
+    while (!boot_graph_finished(graph)) {
+        for (int c = 0; c < cores; c++) {
+            if (running[c] < 0 && (running[c] = boot_graph_take(graph, c)) >= 0) {
+                int ms = running[c] == STEP_FATFS ? fatfs_ms : step_ms[running[c]];
+                ends[c] = now + ms * 1000LL;
+            }
+        }
+        int next = -1;
+        for (int c = 0; c < cores; c++) {
+            if (running[c] >= 0 && (next < 0 || ends[c] < ends[next])) {
+                next = c;
+            }
+        }
+        if (next < 0) {
+            // skipped steps end at once, the loop takes again
+            continue;
+        }
+        now = ends[next];
+        set_clock(now);
+        boot_graph_done(graph, running[next], running[next] == fail ? ESP_FAIL : ESP_OK);
+        running[next] = -1;
+    }
+    out->all_ms = 0;
+    for (int i = 0; i < NUM_STEPS; i++) {
+        boot_graph_get_time(graph, i, &out->times[i]);
+        int end_ms = (int)(out->times[i].end_us / 1000);
+        out->all_ms = end_ms > out->all_ms ? end_ms : out->all_ms;
+    }
+    out->first_audio_ms = (int)(out->times[STEP_PLAY].end_us / 1000) + FIRST_AUDIO_MS;
+    out->fatfs_ms = (int)(out->times[STEP_FATFS].end_us / 1000);
+    return graph;
+}
+
+/**
+ * @brief Dependencies and cores of a simulated run
+ */
+static bool consistent(const char *name, const outcome_t *o) {
+    bool ok = true;
+    for (int i = 0; i < NUM_STEPS; i++) {
+        const boot_step_time_t *t = &o->times[i];
+        int64_t ready = 0;
+        for (int d = 0; d < NUM_STEPS; d++) {
+            if (steps[i].deps & BOOT_GRAPH_DEP(d)) {
+                ready = o->times[d].end_us > ready ? o->times[d].end_us : ready;
+            }
+        }
+        if (t->start_us < ready || t->end_us < t->start_us || t->ready_us / 1000 != ready / 1000) {
+            fprintf(stderr, "%s: %s ready %d start %d end %d ms, its dependencies end at %d ms\n", name,
+                    steps[i].name, (int)(t->ready_us / 1000), (int)(t->start_us / 1000), (int)(t->end_us / 1000),
+                    (int)(ready / 1000));
+            ok = false;
+        }
+        for (int j = 0; j < i; j++) {
+            const boot_step_time_t *u = &o->times[j];
+            if (t->core >= 0 && t->core == u->core && t->start_us < u->end_us && u->start_us < t->end_us
+                && t->end_us > t->start_us && u->end_us > u->start_us) {
+                fprintf(stderr, "%s: %s and %s overlap on core %d\n", name, steps[i].name, steps[j].name, t->core);
+                ok = false;
+            }
+        }
+    }
+    return ok;
+}
+
+static int inline_order[NUM_STEPS];
+static int inline_runs;
+
+static esp_err_t inline_fn(void *ctx) {
+    // the step's index is its ms on the clock
+    int step = (int)(esp_timer_get_time() / 1000);
+    if (inline_runs < NUM_STEPS) {
+        inline_order[inline_runs++] = step;
+    }
+    esp_timer_host_advance(1000);
+    return ESP_OK;
+}
+
+/**
+ * @brief boot_graph_start() without runner tasks, and a table that is refused
+ */
+static bool check_inline(void) {
+    boot_step_t table[NUM_STEPS];
+    for (int i = 0; i < NUM_STEPS; i++) {
+        table[i] = steps[i];
+        table[i].fn = inline_fn;
+    }
+    boot_graph_cfg_t cfg = BOOT_GRAPH_CFG_DEFAULT();
+    cfg.steps = table;
+    cfg.num_steps = NUM_STEPS;
+    cfg.task_stack = 0;
+    set_clock(0);
+    boot_graph_handle_t graph = boot_graph_create(&cfg);
+    bool ok = graph && boot_graph_start(graph) == ESP_OK && boot_graph_finished(graph)
+              && boot_graph_wait(graph, BOOT_GRAPH_DEP(NUM_STEPS) - 1, 0) == ESP_OK && inline_runs == NUM_STEPS;
+    for (int i = 0; ok && i < NUM_STEPS; i++) {
+        ok = inline_order[i] == i;
+    }
+    boot_graph_destroy(graph);
+    if (!ok) {
+        fprintf(stderr, "without runners: %d of %d steps run, not in table order\n", inline_runs, NUM_STEPS);
+    }
+    table[STEP_NVS].deps = BOOT_GRAPH_DEP(STEP_PLAY);
+    esp_log_level_set("*", ESP_LOG_NONE);
+    graph = boot_graph_create(&cfg);
+    esp_log_level_set("*", ESP_LOG_ERROR);
+    if (graph) {
+        fprintf(stderr, "a dependency on a later step was taken\n");
+        boot_graph_destroy(graph);
+        ok = false;
+    }
+    return ok;
+}
+
+int main(int argc, char *argv[]) {
+    esp_log_level_set("*", ESP_LOG_ERROR);
+    static const scenario_t scenarios[] = {
+        {"fast, sound fs", 1},
+        {"fast, blank", 563},
+        {"erasing boot", 2963},
+    };
+    const int n = sizeof(scenarios) / sizeof(scenarios[0]);
+    int audio_path_ms = step_ms[STEP_NVS] + step_ms[STEP_PLACEMENT] + step_ms[STEP_PIPELINE] + step_ms[STEP_RESUME]
+                        + step_ms[STEP_PLAY];
+    int failed = 0;
+
+    printf("%-16s %5s %8s %8s %8s\n", "boot", "cores", "audio_ms", "fatfs_ms", "all_ms");
+    for (int i = 0; i < n; i++) {
+        outcome_t out[2];
+        for (int cores = 1; cores <= 2; cores++) {
+            outcome_t *o = &out[cores - 1];
+            boot_graph_handle_t graph = simulate(cores, scenarios[i].fatfs_ms, -1, o);
+            if (!graph) {
+                return 1;
+            }
+            printf("%-16s %5d %8d %8d %8d\n", scenarios[i].name, cores, o->first_audio_ms, o->fatfs_ms, o->all_ms);
+            if (!consistent(scenarios[i].name, o)) {
+                failed = 1;
+            }
+            if (cores == 2 && i == n - 1) {
+                esp_log_level_set("*", ESP_LOG_INFO);
+                boot_graph_report(graph);
+                esp_log_level_set("*", ESP_LOG_ERROR);
+            }
+            boot_graph_destroy(graph);
+        }
+        if (out[1].first_audio_ms > out[0].first_audio_ms
+            || (scenarios[i].fatfs_ms > audio_path_ms && out[1].first_audio_ms >= out[1].fatfs_ms)) {
+            fprintf(stderr, "%s: first audio at %d ms on two cores, %d on one, FAT FS mounted at %d ms\n",
+                    scenarios[i].name, out[1].first_audio_ms, out[0].first_audio_ms, out[1].fatfs_ms);
+            failed = 1;
+        }
+    }
+
+    // the mount fails: the FAT worker is skipped, the player is not
+    outcome_t o;
+    boot_graph_handle_t graph = simulate(2, scenarios[1].fatfs_ms, STEP_FATFS, &o);
+    if (!graph) {
+        return 1;
+    }
+    for (int i = 0; i < NUM_STEPS; i++) {
+        esp_err_t want = i == STEP_FATFS ? ESP_FAIL : i == STEP_FAT_CHECK ? ESP_ERR_INVALID_STATE : ESP_OK;
+        if (o.times[i].err != want) {
+            fprintf(stderr, "fatfs failed: %s ended %s\n", steps[i].name, esp_err_to_name(o.times[i].err));
+            failed = 1;
+        }
+    }
+    if (boot_graph_wait(graph, BOOT_GRAPH_DEP(STEP_PLAY) | BOOT_GRAPH_DEP(STEP_KEYS), 0) != ESP_OK
+        || boot_graph_wait(graph, BOOT_GRAPH_DEP(STEP_FAT_CHECK), 0) == ESP_OK) {
+        fprintf(stderr, "fatfs failed: waits on play and on the FAT worker\n");
+        failed = 1;
+    }
+    boot_graph_destroy(graph);
+
+    if (!check_inline()) {
+        failed = 1;
+    }
+    printf("%s\n", failed ? "FAILED" : "OK");
+    return failed;
+}
@@ -0,0 +1,257 @@
+/* I2C traffic of the codec driver, on the mock bus
+
+   new_codec.c runs as on target, through audio_hal, on a mock I2C bus that
+   holds the chip's registers and counts transactions, registers and bytes.
+   For each step of a play session (init, start, volume and mute changes,
+   the software volume listener, stop) the table shows what the driver asked
+   for, what went on the bus, and the bus time at 100 kHz. "asked" is what a
+   driver without the shadow sends, one transaction per register.
+
+   Checks, exit status 1 if any fails:
+   - a call that changes nothing puts nothing on the bus;
+   - a volume step is one transaction of at most two registers, a mute one
+     transaction of one register, and with the listener a volume step costs
+     nothing;
+   - nothing is ever read back, the shadow knows every register;
+   - a failed transaction is retried by the next call, and the chip ends up
+     with the registers the driver's state calls for;
+   - on a board without the chip (the mock NACKs everything) the board and
+     audio_hal still come up, and volume and mute reach the listener.
+
+   Usage: bench_codec_i2c
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include "esp_log.h"
+#include "board.h"
+#include "new_codec.h"
+#include "new_codec_i2c.h"
+#include "i2c_mock.h"
+
+/* ES8388 registers the checks look at */
+#define REG_DACPOWER        0x04
+#define REG_DACCONTROL3     0x19
+#define REG_DACCONTROL4     0x1a
+#define REG_DACCONTROL5     0x1b
+#define DACCONTROL3_MUTE    0x04
+#define DAC_OUTPUTS_ALL     0x3c
+
+typedef struct {
+    codec_regmap_stats_t regmap;
+    i2c_mock_stats_t bus;
+} snapshot_t;
+
+static audio_hal_handle_t hal;
+static int failed;
+
+static void snapshot(snapshot_t *s) {
+    memset(s, 0, sizeof(*s));
+    new_codec_get_bus_stats(&s->regmap);
+    i2c_mock_get_stats(&s->bus);
+}
+
+/**
+ * @brief Print the traffic since *from and check it against the most allowed, -1 for no limit
+ */
+static void report(const char *step, int calls, const snapshot_t *from, int max_transactions, int max_regs) {
+    snapshot_t to;
+    snapshot(&to);
+    int asked = to.regmap.staged - from->regmap.staged;
+    i2c_mock_stats_t bus = {
+        .transactions = to.bus.transactions - from->bus.transactions,
+        .reg_writes = to.bus.reg_writes - from->bus.reg_writes,
+        .reg_reads = to.bus.reg_reads - from->bus.reg_reads,
+        .bytes = to.bus.bytes - from->bus.bytes,
+    };
+    i2c_mock_stats_t naive = {.bytes = asked * 3};
+    printf("%-28s %5d %6d %8.0f %6d %5d %6d %8.0f\n", step, calls, asked, i2c_mock_bus_us(&naive), bus.transactions,
+           bus.reg_writes, bus.bytes, i2c_mock_bus_us(&bus));
+    if ((max_transactions >= 0 && bus.transactions > max_transactions) || (max_regs >= 0 && bus.reg_writes > max_regs)) {
+        fprintf(stderr, "%s: %d transactions of %d registers, at most %d of %d expected\n", step, bus.transactions,
+                bus.reg_writes, max_transactions, max_regs);
+        failed = 1;
+    }
+    if (bus.reg_reads) {
+        fprintf(stderr, "%s: %d registers read back\n", step, bus.reg_reads);
+        failed = 1;
+    }
+}
+
+static void expect_reg(const char *what, uint8_t reg, uint8_t mask, uint8_t want) {
+    uint8_t got = i2c_mock_reg(reg);
+    if ((got & mask) != (want & mask)) {
+        fprintf(stderr, "%s: register 0x%02x is 0x%02x, expected 0x%02x (mask 0x%02x)\n", what, reg, got, want, mask);
+        failed = 1;
+    }
+}
+
+/**
+ * @brief DAC attenuation in 0.5 dB steps new_codec writes for a volume
+ */
+static uint8_t dac_att(int volume) {
+    return volume <= 0 ? 0xc0 : (100 - volume) * 100 / 99;
+}
+
+static int volume_seen = -1;
+static bool mute_seen;
+
+static void on_volume(int volume, bool mute, void *ctx) {
+    volume_seen = volume;
+    mute_seen = mute;
+}
+
+int main(int argc, char *argv[]) {
+    esp_log_level_set("*", ESP_LOG_ERROR);
+    snapshot_t s;
+
+    printf("ES8388 at 0x%02x, %d kHz\n", NEW_CODEC_I2C_ADDR, NEW_CODEC_I2C_SPEED / 1000);
+    printf("%-28s %5s %6s %8s %6s %5s %6s %8s\n", "step", "calls", "asked", "asked_us", "trans", "regs", "bytes",
+           "bus_us");
+
+    // the shadow starts unknown, so init writes everything
+    i2c_mock_reset_stats();
+    snapshot(&s);
+    audio_board_handle_t board = audio_board_init();
+    if (!board) {
+        fprintf(stderr, "codec init failed\n");
+        return 1;
+    }
+    hal = board->audio_hal;
+    report("init, iface, volume 70", 3, &s, 2, -1);
+
+    snapshot(&s);
+    audio_hal_ctrl_codec(hal, AUDIO_HAL_CODEC_MODE_BOTH, AUDIO_HAL_CTRL_START);
+    report("start", 1, &s, 1, -1);
+    expect_reg("started", REG_DACPOWER, 0xff, DAC_OUTPUTS_ALL);
+    expect_reg("started", REG_DACCONTROL3, DACCONTROL3_MUTE, 0);
+
+    snapshot(&s);
+    audio_hal_ctrl_codec(hal, AUDIO_HAL_CODEC_MODE_BOTH, AUDIO_HAL_CTRL_START);
+    audio_hal_set_volume(hal, 70);
+    audio_hal_set_mute(hal, false);
+    audio_hal_codec_i2s_iface_t iface = {
+        .mode = AUDIO_HAL_MODE_SLAVE,
+        .fmt = AUDIO_HAL_I2S_NORMAL,
+        .samples = AUDIO_HAL_48K_SAMPLES,
+        .bits = AUDIO_HAL_BIT_LENGTH_16BITS,
+    };
+    new_codec_config_i2s(AUDIO_HAL_CODEC_MODE_BOTH, &iface);
+    report("unchanged start/vol/mute/iface", 4, &s, 0, 0);
+
+    // Vol+/Vol- as the touch pads step it
+    snapshot(&s);
+    int calls = 0;
+    for (int v = 70; v >= 0; v -= 10, calls++) {
+        audio_hal_set_volume(hal, v);
+    }
+    for (int v = 0; v <= 100; v += 10, calls++) {
+        audio_hal_set_volume(hal, v);
+    }
+    report("volume steps of 10", calls, &s, calls, calls * 2);
+    expect_reg("volume 100", REG_DACCONTROL4, 0xff, dac_att(100));
+    snapshot(&s);
+    audio_hal_set_volume(hal, 60);
+    report("one volume step", 1, &s, 1, 2);
+    expect_reg("volume 60", REG_DACCONTROL4, 0xff, dac_att(60));
+    expect_reg("volume 60", REG_DACCONTROL5, 0xff, dac_att(60));
+
+    snapshot(&s);
+    audio_hal_set_mute(hal, true);
+    report("mute", 1, &s, 1, 1);
+    expect_reg("muted", REG_DACCONTROL3, DACCONTROL3_MUTE, DACCONTROL3_MUTE);
+    snapshot(&s);
+    audio_hal_set_mute(hal, true);
+    report("mute again", 1, &s, 0, 0);
+    snapshot(&s);
+    audio_hal_set_mute(hal, false);
+    report("unmute", 1, &s, 1, 1);
+
+    // software volume: the DAC goes to 0 dB once, then volume is free
+    snapshot(&s);
+    new_codec_set_volume_cb(on_volume, NULL);
+    report("set volume listener", 1, &s, 1, 2);
+    expect_reg("listener", REG_DACCONTROL4, 0xff, 0);
+    snapshot(&s);
+    calls = 0;
+    for (int v = 0; v <= 100; v += 10, calls++) {
+        audio_hal_set_volume(hal, v);
+    }
+    audio_hal_set_mute(hal, true);
+    audio_hal_set_mute(hal, false);
+    calls += 2;
+    report("volume/mute with listener", calls, &s, 0, 0);
+    if (volume_seen != 100 || mute_seen) {
+        fprintf(stderr, "listener last got volume %d%s\n", volume_seen, mute_seen ? " muted" : "");
+        failed = 1;
+    }
+    snapshot(&s);
+    new_codec_set_volume_cb(NULL, NULL);
+    audio_hal_set_volume(hal, 40);
+    report("remove listener, volume 40", 2, &s, 2, 2);
+
+    // a lost transaction leaves the change staged, the next call sends it; it logs one error
+    snapshot(&s);
+    i2c_mock_fail_next(1);
+    esp_err_t ret = audio_hal_set_volume(hal, 20);
+    uint8_t before = i2c_mock_reg(REG_DACCONTROL4);
+    esp_err_t retry = audio_hal_set_volume(hal, 20);
+    report("volume 20, bus error, retry", 2, &s, 1, 2);
+    if (ret == ESP_OK || retry != ESP_OK || before != dac_att(40)) {
+        fprintf(stderr, "bus error: first call %d, retry %d, DAC at 0x%02x before the retry\n", ret, retry, before);
+        failed = 1;
+    }
+    expect_reg("volume 20", REG_DACCONTROL4, 0xff, dac_att(20));
+    expect_reg("volume 20", REG_DACCONTROL5, 0xff, dac_att(20));
+
+    snapshot(&s);
+    audio_hal_ctrl_codec(hal, AUDIO_HAL_CODEC_MODE_BOTH, AUDIO_HAL_CTRL_STOP);
+    report("stop", 1, &s, 1, -1);
+    expect_reg("stopped", REG_DACCONTROL3, DACCONTROL3_MUTE, DACCONTROL3_MUTE);
+    expect_reg("stopped", REG_DACPOWER, 0xff, 0xc0);
+
+    // stopped already, deinit has nothing left to write
+    snapshot(&s);
+    codec_regmap_stats_t total = s.regmap;
+    audio_board_deinit(board);
+    i2c_mock_stats_t after;
+    i2c_mock_get_stats(&after);
+    if (after.transactions != s.bus.transactions) {
+        fprintf(stderr, "deinit after stop: %d transactions\n", after.transactions - s.bus.transactions);
+        failed = 1;
+    }
+    printf("\nsession: %u register writes asked for, %u skipped, %u written in %u transactions\n",
+           (unsigned)total.staged, (unsigned)total.skipped, (unsigned)total.written, (unsigned)total.transactions);
+
+    // a codec-less board: init finds nothing, Vol+/Vol- and mute still go to the software volume
+    i2c_mock_set_absent(true);
+    i2c_mock_reset_stats();
+    board = audio_board_init();
+    if (!board || !board->audio_hal || new_codec_initialized()) {
+        fprintf(stderr, "no codec: board %s, audio_hal %s, codec %s\n", board ? "up" : "NULL",
+                board && board->audio_hal ? "up" : "NULL", new_codec_initialized() ? "initialized" : "absent");
+        return 1;
+    }
+    hal = board->audio_hal;
+    new_codec_set_volume_cb(on_volume, NULL);
+    ret = audio_hal_ctrl_codec(hal, AUDIO_HAL_CODEC_MODE_BOTH, AUDIO_HAL_CTRL_START);
+    ret |= audio_hal_set_volume(hal, 30);
+    ret |= audio_hal_set_mute(hal, true);
+    int seen = volume_seen;
+    bool muted = mute_seen;
+    ret |= audio_hal_set_mute(hal, false);
+    ret |= audio_hal_ctrl_codec(hal, AUDIO_HAL_CODEC_MODE_BOTH, AUDIO_HAL_CTRL_STOP);
+    new_codec_set_volume_cb(NULL, NULL);
+    ret |= audio_board_deinit(board);
+    i2c_mock_get_stats(&after);
+    printf("no codec: init NACKed %d times, listener got volume %d%s, calls %s\n", after.failures, seen,
+           muted ? " muted" : "", ret == ESP_OK ? "ok" : "failed");
+    if (ret != ESP_OK || seen != 30 || !muted || mute_seen || after.transactions) {
+        fprintf(stderr, "no codec: calls %s, listener got volume %d%s then%s, %d transactions\n",
+                ret == ESP_OK ? "ok" : "failed", seen, muted ? " muted" : "", mute_seen ? " muted" : " unmuted",
+                after.transactions);
+        failed = 1;
+    }
+    i2c_mock_set_absent(false);
+    return failed;
+}
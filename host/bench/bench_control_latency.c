@@ -0,0 +1,300 @@
+/* Control latency of the player commands, from the event to the first PCM of the new state at the sink
+
+   Drives the app_main pipeline (playlist -> mp3 decoder -> resampler ->
+   gain -> sink, SOFT_VOLUME) through rounds of play, pause, resume, volume
+   and next, traced by latency_trace exactly as the event loop of app_main
+   does, [Mode] flushing the resampler's input as on_mode() does. The sink
+   advances the simulated esp_timer clock by the duration of the audio it
+   consumes, so queued audio takes as long to drain as on the board while
+   decoding runs at host speed, and the elements are stepped ahead of the
+   sink so that the ring buffers stay full as they do behind a DMA-bound i2s
+   writer. The decoder output buffer is ADAPTIVE_BUFFER_MAX, the depth the
+   adaptive buffer of app_main grows to, and the decoder keeps it full.
+
+   Exit status 1 if a command stalls, or if next takes longer than
+   NEXT_MAX_MS: a skip may only wait for what is behind the resampler.
+
+   Usage: bench_control_latency [rounds]
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "audio_common.h"
+#include "board.h"
+#include "pcm_sink.h"
+#include "mp3_decoder.h"
+#include "music_assets.h"
+#include "player_pipeline.h"
+#include "playlist.h"
+#include "latency_trace.h"
+#include "new_codec.h"
+#include "resample.h"
+#include "sw_gain.h"
+
+#define OUTPUT_RATE     44100
+#define PLAY_MS         300
+#define PAUSED_MS       100
+#define MAX_STEPS       1000000
+#define NEXT_MAX_MS     250
+#define ADAPTIVE_BUFFER_MAX (96 * 1024)
+
+typedef struct {
+    latency_trace_handle_t lt;
+    int64_t resume_at;      // as skip_resume_at of app_main
+} bench_ctx_t;
+
+static void on_track(playlist_handle_t pl, int index, const mp3_frame_info_t *info, bool requested, void *ctx) {
+    bench_ctx_t *bench = (bench_ctx_t *)ctx;
+    latency_trace_track_changed(bench->lt);
+    if (requested) {
+        bench->resume_at = playlist_get_pcm_pos(pl);
+    }
+}
+
+typedef struct {
+    bench_ctx_t *bench;
+    player_pipeline_t *player;
+} output_ctx_t;
+
+/**
+ * @brief on_decoder_output() of app_main without the PCM cache
+ */
+static void on_decoder_output(void *ctx, int64_t pos, const char *buf, int len) {
+    output_ctx_t *out = (output_ctx_t *)ctx;
+    audio_element_handle_t rsp = out->player->resampler;
+    audio_element_info_t info = {0};
+    audio_element_getinfo(out->player->mp3_decoder, &info);
+    if (out->bench->resume_at >= 0 && pos + len > out->bench->resume_at) {
+        int old = out->bench->resume_at > pos ? (int)(out->bench->resume_at - pos) : 0;
+        if (old > 0) {
+            resample_input_written(rsp, info.sample_rates, info.channels, old);
+        }
+        resample_input_resume(rsp);
+        out->bench->resume_at = -1;
+        len -= old;
+    }
+    resample_input_written(rsp, info.sample_rates, info.channels, len);
+}
+
+static void on_codec_volume(int volume, bool mute, void *ctx) {
+    sw_gain_set_volume((audio_element_handle_t)ctx, volume, mute);
+}
+
+static void on_gain_applied(void *ctx) {
+    latency_trace_gain_applied((latency_trace_handle_t)ctx);
+}
+
+static int64_t playlist_source_pos(void *ctx) {
+    return playlist_get_pcm_pos((playlist_handle_t)ctx);
+}
+
+/**
+ * @brief One pipeline step in the order of the board
+ *
+ * There the i2s writer is held back by DMA, so the decoder keeps the ring
+ * buffer full and every queued byte is played before new PCM; the host
+ * pipeline step would drain the ring buffer first instead.
+ */
+static int step(player_pipeline_t *player) {
+    int progress = 0;
+    for (int more = 1; more;) {
+        more = audio_element_host_step(player->mp3_decoder);
+        more |= audio_element_host_step(player->resampler);
+        more |= audio_element_host_step(player->gain);
+        progress += more;
+    }
+    return progress + audio_element_host_step(player->sink);
+}
+
+static int play_for(player_pipeline_t *player, int ms) {
+    int64_t until = esp_timer_get_time() + ms * 1000LL;
+    for (int i = 0; esp_timer_get_time() < until; i++) {
+        if (i == MAX_STEPS || !step(player)) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static int wait_done(player_pipeline_t *player, latency_trace_handle_t lt, latency_cmd_t cmd, uint32_t count) {
+    latency_stats_t stats;
+    for (int i = 0; i < MAX_STEPS; i++) {
+        latency_trace_get_stats(lt, cmd, &stats);
+        if (stats.count > count) {
+            return 0;
+        }
+        if (!step(player)) {
+            break;
+        }
+    }
+    fprintf(stderr, "%s did not complete\n", latency_trace_cmd_name(cmd));
+    return -1;
+}
+
+static uint32_t done_count(latency_trace_handle_t lt, latency_cmd_t cmd) {
+    latency_stats_t stats;
+    latency_trace_get_stats(lt, cmd, &stats);
+    return stats.count;
+}
+
+static int round_trip(player_pipeline_t *player, playlist_handle_t playlist, latency_trace_handle_t lt,
+                      audio_board_handle_t board, int round) {
+    uint32_t n;
+
+    // [Play] from the init state, after [Set] stopped the previous round
+    if (round > 0) {
+        latency_trace_detach(lt);
+        audio_pipeline_stop(player->pipeline);
+        audio_pipeline_wait_for_stop(player->pipeline);
+        audio_pipeline_terminate(player->pipeline);
+        audio_pipeline_reset_ringbuffer(player->pipeline);
+        audio_pipeline_reset_elements(player->pipeline);
+        latency_trace_attach(lt, player->mp3_decoder, player->resampler);
+    }
+    n = done_count(lt, LATENCY_CMD_PLAY);
+    latency_trace_begin(lt, LATENCY_CMD_PLAY);
+    audio_pipeline_run(player->pipeline);
+    latency_trace_api_done(lt);
+    if (wait_done(player, lt, LATENCY_CMD_PLAY, n) || play_for(player, PLAY_MS)) {
+        return -1;
+    }
+
+    latency_trace_begin(lt, LATENCY_CMD_PAUSE);
+    audio_pipeline_pause(player->pipeline);
+    latency_trace_api_done(lt);
+    esp_timer_host_advance(PAUSED_MS * 1000LL);
+
+    n = done_count(lt, LATENCY_CMD_RESUME);
+    latency_trace_begin(lt, LATENCY_CMD_RESUME);
+    audio_pipeline_resume(player->pipeline);
+    latency_trace_api_done(lt);
+    if (wait_done(player, lt, LATENCY_CMD_RESUME, n) || play_for(player, PLAY_MS)) {
+        return -1;
+    }
+
+    n = done_count(lt, LATENCY_CMD_VOLUME);
+    latency_trace_begin(lt, LATENCY_CMD_VOLUME);
+    audio_hal_set_volume(board->audio_hal, 50 + (round % 5) * 10);
+    latency_trace_api_done(lt);
+    if (wait_done(player, lt, LATENCY_CMD_VOLUME, n) || play_for(player, PLAY_MS)) {
+        return -1;
+    }
+
+    n = done_count(lt, LATENCY_CMD_NEXT);
+    latency_trace_begin(lt, LATENCY_CMD_NEXT);
+    resample_input_flush(player->resampler);
+    playlist_skip(playlist);
+    latency_trace_api_done(lt);
+    if (wait_done(player, lt, LATENCY_CMD_NEXT, n) || play_for(player, PLAY_MS)) {
+        return -1;
+    }
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+    int rounds = argc > 1 ? atoi(argv[1]) : 20;
+    if (rounds <= 0) {
+        fprintf(stderr, "usage: %s [rounds]\n", argv[0]);
+        return 2;
+    }
+    esp_log_level_set("*", ESP_LOG_ERROR);
+
+    audio_board_handle_t board = audio_board_init();
+    audio_hal_ctrl_codec(board->audio_hal, AUDIO_HAL_CODEC_MODE_BOTH, AUDIO_HAL_CTRL_START);
+
+    bench_ctx_t bench = {0};
+    bench.lt = latency_trace_create();
+    pcm_sink_cfg_t sink_cfg = PCM_SINK_CFG_DEFAULT();
+    sink_cfg.realtime = true;
+    audio_element_handle_t sink = pcm_sink_init(&sink_cfg);
+    bench.resume_at = -1;
+    playlist_cfg_t playlist_cfg = PLAYLIST_CFG_DEFAULT();
+    playlist_cfg.on_track = on_track;
+    playlist_cfg.cb_ctx = &bench;
+    playlist_handle_t playlist = playlist_create(music_assets, music_assets_count, &playlist_cfg);
+    if (!bench.lt || !sink || !playlist) {
+        return 1;
+    }
+
+    player_pipeline_t player;
+    player_pipeline_cfg_t player_cfg = PLAYER_PIPELINE_CFG_DEFAULT();
+    player_cfg.read_cb = playlist_read_cb;
+    player_cfg.read_ctx = playlist;
+    player_cfg.output_rate = OUTPUT_RATE;
+    player_cfg.soft_volume = true;
+    player_cfg.mp3_out_rb_size = ADAPTIVE_BUFFER_MAX;
+    if (player_pipeline_create(&player, &player_cfg, sink) != ESP_OK
+        || latency_trace_attach(bench.lt, player.mp3_decoder, player.resampler) != ESP_OK) {
+        return 1;
+    }
+    audio_element_set_music_info(sink, OUTPUT_RATE, 2, 16);
+    latency_trace_watch_ringbuf(bench.lt, audio_element_get_output_ringbuf(player.resampler), player.resampler);
+    latency_trace_watch_ringbuf(bench.lt, audio_element_get_output_ringbuf(player.gain), player.gain);
+    latency_trace_set_source(bench.lt, playlist_source_pos, playlist);
+    output_ctx_t out = {&bench, &player};
+    latency_trace_set_output_cb(bench.lt, on_decoder_output, &out);
+    new_codec_set_volume_cb(on_codec_volume, player.gain);
+    latency_trace_set_volume_end(bench.lt, LATENCY_POINT_GAIN);
+    sw_gain_set_applied_cb(player.gain, on_gain_applied, bench.lt);
+
+    int ret = 0;
+    for (int r = 0; r < rounds; r++) {
+        if (round_trip(&player, playlist, bench.lt, board, r) != 0) {
+            ret = 1;
+            break;
+        }
+    }
+
+    printf("decoder backend: %s, %d rounds\n", mp3_decoder_host_backend(), rounds);
+    printf("%-7s %5s %5s %9s %9s %9s   %9s %9s %9s %9s\n", "cmd", "n", "drop", "min_ms", "avg_ms", "max_ms",
+           "api_ms", "dec_ms", "i2s_ms", "gain_ms");
+    for (int cmd = 0; cmd < LATENCY_CMD_MAX; cmd++) {
+        latency_stats_t s;
+        latency_trace_get_stats(bench.lt, cmd, &s);
+        if (!s.count) {
+            continue;
+        }
+        printf("%-7s %5u %5u %9.3f %9.3f %9.3f  ", latency_trace_cmd_name(cmd), s.count, s.dropped,
+               s.min_us / 1e3, s.sum_us / 1e3 / s.count, s.max_us / 1e3);
+        for (int p = LATENCY_POINT_API; p < LATENCY_POINT_MAX; p++) {
+            if (s.point_count[p]) {
+                printf(" %9.3f", s.point_sum_us[p] / 1e3 / s.point_count[p]);
+            } else {
+                printf(" %9s", "-");
+            }
+        }
+        printf("\n");
+    }
+    printf("\nhistogram (count per bucket, upper bound in ms)\n%-7s", "cmd");
+    for (int i = 0; i < LATENCY_HIST_BUCKETS - 1; i++) {
+        printf(" %5d", latency_trace_bucket_ms[i]);
+    }
+    printf(" %5s\n", "more");
+    for (int cmd = 0; cmd < LATENCY_CMD_MAX; cmd++) {
+        latency_stats_t s;
+        latency_trace_get_stats(bench.lt, cmd, &s);
+        printf("%-7s", latency_trace_cmd_name(cmd));
+        for (int i = 0; i < LATENCY_HIST_BUCKETS; i++) {
+            printf(" %5u", s.hist[i]);
+        }
+        printf("\n");
+    }
+
+    latency_stats_t next;
+    latency_trace_get_stats(bench.lt, LATENCY_CMD_NEXT, &next);
+    if (next.max_us > NEXT_MAX_MS * 1000LL) {
+        fprintf(stderr, "next took up to %.3f ms, more than %d ms\n", next.max_us / 1e3, NEXT_MAX_MS);
+        ret = 1;
+    }
+
+    new_codec_set_volume_cb(NULL, NULL);
+    latency_trace_detach(bench.lt);
+    player_pipeline_stop(&player);
+    player_pipeline_destroy(&player);
+    playlist_destroy(playlist);
+    latency_trace_destroy(bench.lt);
+    audio_board_deinit(board);
+    return ret;
+}
@@ -0,0 +1,439 @@
+/* mp3 decode throughput and memory against a stored baseline
+
+   Decodes each embedded asset, and long files made by repeating the 22.05
+   and 44.1 kHz assets, through player_pipeline_create() with a null sink:
+   the decode path of app_main without the resampler and the i2s stream. For
+   each it reports frames/s and realtime factor (best of -r runs), the
+   audio_malloc() calls to set the pipeline up and per run, the peak of what
+   they hold, and the process's peak RSS at the end.
+
+   Throughput is also given as frames/cal: frames decoded in the time a
+   fixed calibration loop takes on the same machine (fixed-point
+   multiply-accumulate over a block of samples, best of -r runs), which
+   carries over between machines where frames/s does not.
+
+   The results are compared with the baseline file, one line per decoder
+   backend and input:
+
+     <backend> <input> <frames/cal> <setup allocs> <allocs per run> <peak bytes>
+
+   Exit status 1 when frames/cal drops by more than -s percent, or
+   allocations or peak bytes grow by more than -t percent, against it, or
+   when the pipeline leaks. Only libmpg123 has its throughput checked: the
+   stand-in decoder only walks frames, its lines have "-" for frames/cal and
+   only check allocations and memory. Inputs without a baseline line for this
+   backend are only reported; -w writes the results as the new baseline.
+
+   Usage: bench_decode [-r runs] [-t percent] [-s percent] [-b baseline] [-w]
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include "esp_log.h"
+#include "audio_mem.h"
+#include "pcm_sink.h"
+#include "mp3_decoder.h"
+#include "mp3_frame.h"
+#include "embed_stream.h"
+#include "music_assets.h"
+#include "player_pipeline.h"
+#include "bench_clock.h"
+
+#ifndef BENCH_DECODE_BASELINE
+#define BENCH_DECODE_BASELINE "decode_baseline.txt"
+#endif
+
+#define LONG_REPEAT     16
+#define MAX_INPUTS      8
+#define MAX_BASELINES   32
+#define CAL_SAMPLES     4096
+#define CAL_TAPS        32
+#define CAL_PASSES      256
+
+typedef struct {
+    char name[48];
+    embed_asset_t asset;
+    uint8_t *owned;             // repeated copy, NULL for the embedded assets
+} input_t;
+
+typedef struct {
+    int sample_rate;
+    int channels;
+    int64_t pcm_bytes;          // of one run
+    uint64_t best_ns;
+    double frames_per_s;
+    double frames_per_cal;
+    double rtf;
+    size_t setup_allocs;
+    size_t run_allocs;
+    size_t peak_bytes;
+    long leaked_bytes;
+} decode_result_t;
+
+typedef struct {
+    char backend[32];
+    char input[48];
+    double frames_per_cal;      // 0 for no throughput line
+    size_t setup_allocs;
+    size_t run_allocs;
+    size_t peak_bytes;
+} baseline_t;
+
+static input_t inputs[MAX_INPUTS];
+static int num_inputs;
+static baseline_t baselines[MAX_BASELINES];
+static int num_baselines;
+
+/**
+ * @brief The asset n times over, the ID3v2 tag only at the start
+ */
+static int add_repeated(const embed_asset_t *asset, int n) {
+    int len = asset->end - asset->start;
+    int tag = mp3_id3v2_size(asset->start, len);
+    int body = len - tag;
+    uint8_t *buf = malloc(tag + (size_t)body * n);
+    if (!buf) {
+        return -1;
+    }
+    memcpy(buf, asset->start, len);
+    for (int i = 1; i < n; i++) {
+        memcpy(buf + tag + (size_t)body * i, asset->start + tag, body);
+    }
+    input_t *in = &inputs[num_inputs++];
+    snprintf(in->name, sizeof(in->name), "long-%dx-%s", n, asset->name);
+    in->owned = buf;
+    in->asset = (embed_asset_t) {
+        .name = in->name, .start = buf, .end = buf + tag + (size_t)body * n, .index = NULL,
+    };
+    return 0;
+}
+
+static int play(player_pipeline_t *player, audio_event_iface_handle_t evt, embed_stream_handle_t stream,
+                const input_t *in, decode_result_t *res) {
+    embed_stream_set_asset(stream, &in->asset);
+    audio_pipeline_reset_ringbuffer(player->pipeline);
+    audio_pipeline_reset_elements(player->pipeline);
+    audio_pipeline_change_state(player->pipeline, AEL_STATE_INIT);
+    int64_t bytes0 = pcm_sink_get_bytes(player->sink);
+
+    uint64_t t0 = bench_now_ns();
+    audio_pipeline_run(player->pipeline);
+    while (1) {
+        audio_event_iface_msg_t msg;
+        if (audio_event_iface_listen(evt, &msg, portMAX_DELAY) != ESP_OK) {
+            fprintf(stderr, "%s: pipeline stalled\n", in->name);
+            return -1;
+        }
+        if (msg.source_type != AUDIO_ELEMENT_TYPE_ELEMENT) {
+            continue;
+        }
+        if (msg.source == (void *)player->mp3_decoder && msg.cmd == AEL_MSG_CMD_REPORT_MUSIC_INFO) {
+            audio_element_info_t music_info = {0};
+            audio_element_getinfo(player->mp3_decoder, &music_info);
+            audio_element_setinfo(player->sink, &music_info);
+            res->sample_rate = music_info.sample_rates;
+            res->channels = music_info.channels;
+            continue;
+        }
+        if (msg.cmd == AEL_MSG_CMD_REPORT_STATUS && (int)(intptr_t)msg.data == AEL_STATUS_STATE_FINISHED) {
+            if (msg.source == (void *)player->sink) {
+                break;
+            }
+        } else if (msg.cmd == AEL_MSG_CMD_REPORT_STATUS && (int)(intptr_t)msg.data == AEL_STATUS_ERROR_PROCESS) {
+            fprintf(stderr, "%s: element error\n", in->name);
+            return -1;
+        }
+    }
+    uint64_t ns = bench_now_ns() - t0;
+    if (!res->best_ns || ns < res->best_ns) {
+        res->best_ns = ns;
+    }
+    res->pcm_bytes = pcm_sink_get_bytes(player->sink) - bytes0;
+    return 0;
+}
+
+/**
+ * @brief Set a pipeline up for one input, decode it runs times, tear it down
+ */
+static int measure(const input_t *in, int runs, decode_result_t *res) {
+    audio_mem_host_stats_t m0, m1, m2, m3;
+    audio_mem_host_get_stats(&m0);
+    audio_mem_host_reset_peak();
+
+    embed_stream_handle_t stream = embed_stream_create();
+    pcm_sink_cfg_t sink_cfg = PCM_SINK_CFG_DEFAULT();
+    audio_element_handle_t sink = pcm_sink_init(&sink_cfg);
+    player_pipeline_t player;
+    player_pipeline_cfg_t player_cfg = PLAYER_PIPELINE_CFG_DEFAULT();
+    player_cfg.read_cb = embed_stream_read_cb;
+    player_cfg.read_ctx = stream;
+    if (!stream || !sink || player_pipeline_create(&player, &player_cfg, sink) != ESP_OK) {
+        fprintf(stderr, "%s: pipeline not created\n", in->name);
+        return -1;
+    }
+    audio_event_iface_cfg_t evt_cfg = AUDIO_EVENT_IFACE_DEFAULT_CFG();
+    audio_event_iface_handle_t evt = audio_event_iface_init(&evt_cfg);
+    player_pipeline_set_listener(&player, evt);
+    audio_mem_host_get_stats(&m1);
+
+    int ret = 0;
+    for (int r = 0; r < runs && ret == 0; r++) {
+        ret = play(&player, evt, stream, in, res);
+    }
+    audio_mem_host_get_stats(&m2);
+
+    player_pipeline_stop(&player);
+    audio_event_iface_destroy(evt);
+    player_pipeline_destroy(&player);
+    embed_stream_destroy(stream);
+    audio_mem_host_get_stats(&m3);
+    if (ret || !res->sample_rate || !res->best_ns) {
+        return -1;
+    }
+
+    int samples_per_frame = res->sample_rate >= 32000 ? 1152 : 576;
+    double frames = (double)res->pcm_bytes / (samples_per_frame * res->channels * 2);
+    double audio_s = (double)res->pcm_bytes / (res->sample_rate * res->channels * 2);
+    res->frames_per_s = frames / (res->best_ns / 1e9);
+    res->rtf = res->best_ns / 1e9 / audio_s;
+    res->setup_allocs = (m1.allocs - m0.allocs) + (m3.allocs - m2.allocs);
+    res->run_allocs = (m2.allocs - m1.allocs) / runs;
+    res->peak_bytes = m3.peak - m0.in_use;
+    res->leaked_bytes = (long)(m3.in_use - m0.in_use);
+    return 0;
+}
+
+/**
+ * @brief Best time of the calibration loop, ns
+ */
+static uint64_t calibrate(int runs) {
+    static int16_t in[CAL_SAMPLES + CAL_TAPS];
+    static int16_t taps[CAL_TAPS];
+    uint32_t seed = 1;
+    for (int i = 0; i < CAL_SAMPLES + CAL_TAPS; i++) {
+        seed = seed * 1103515245 + 12345;
+        in[i] = (int16_t)(seed >> 16);
+    }
+    for (int i = 0; i < CAL_TAPS; i++) {
+        taps[i] = (int16_t)((i + 1) * 997);
+    }
+    uint64_t best = 0;
+    for (int r = 0; r < runs; r++) {
+        uint64_t t0 = bench_now_ns();
+        for (int p = 0; p < CAL_PASSES; p++) {
+            for (int i = 0; i < CAL_SAMPLES; i++) {
+                int64_t acc = 0;
+                for (int k = 0; k < CAL_TAPS; k++) {
+                    acc += (int32_t)in[i + k] * taps[k];
+                }
+                // fed back: the passes depend on each other and the work cannot be left out
+                in[i] = (int16_t)(acc >> 15);
+            }
+        }
+        uint64_t ns = bench_now_ns() - t0;
+        best = !best || ns < best ? ns : best;
+    }
+    return best;
+}
+
+static bool throughput_checked(const char *backend) {
+    return !strcmp(backend, "libmpg123");
+}
+
+static void backend_key(char *key, int size) {
+    // "libmpg123", "frame-walk (silence)": the first word
+    snprintf(key, size, "%s", mp3_decoder_host_backend());
+    key[strcspn(key, " ")] = '\0';
+}
+
+static int load_baseline(const char *path) {
+    FILE *fp = fopen(path, "r");
+    if (!fp) {
+        return -1;
+    }
+    char line[256];
+    while (fgets(line, sizeof(line), fp) && num_baselines < MAX_BASELINES) {
+        baseline_t *b = &baselines[num_baselines];
+        char speed[32];
+        if (line[0] == '#' || sscanf(line, "%31s %47s %31s %zu %zu %zu", b->backend, b->input, speed,
+                                     &b->setup_allocs, &b->run_allocs, &b->peak_bytes) != 6) {
+            continue;
+        }
+        b->frames_per_cal = strcmp(speed, "-") ? atof(speed) : 0;
+        num_baselines++;
+    }
+    fclose(fp);
+    return 0;
+}
+
+static const baseline_t *find_baseline(const char *backend, const char *input) {
+    for (int i = 0; i < num_baselines; i++) {
+        if (!strcmp(baselines[i].backend, backend) && !strcmp(baselines[i].input, input)) {
+            return &baselines[i];
+        }
+    }
+    return NULL;
+}
+
+static void format_speed(char *buf, int size, double frames_per_cal) {
+    if (frames_per_cal > 0) {
+        snprintf(buf, size, "%.2f", frames_per_cal);
+    } else {
+        snprintf(buf, size, "-");
+    }
+}
+
+/**
+ * @brief Keep the other backends' lines, replace this one's
+ */
+static int write_baseline(const char *path, const char *backend, const decode_result_t *res) {
+    FILE *fp = fopen(path, "w");
+    if (!fp) {
+        return -1;
+    }
+    fprintf(fp, "# bench_decode baseline, written by bench_decode -w\n");
+    fprintf(fp, "# backend input frames/cal setup_allocs allocs_per_run peak_bytes\n");
+    fprintf(fp, "# frames/cal is only checked for libmpg123, \"-\" for none\n");
+    char speed[32];
+    for (int i = 0; i < num_baselines; i++) {
+        const baseline_t *b = &baselines[i];
+        if (strcmp(b->backend, backend)) {
+            format_speed(speed, sizeof(speed), b->frames_per_cal);
+            fprintf(fp, "%s %s %s %zu %zu %zu\n", b->backend, b->input, speed, b->setup_allocs, b->run_allocs,
+                    b->peak_bytes);
+        }
+    }
+    for (int i = 0; i < num_inputs; i++) {
+        format_speed(speed, sizeof(speed), throughput_checked(backend) ? res[i].frames_per_cal : 0);
+        fprintf(fp, "%s %s %s %zu %zu %zu\n", backend, inputs[i].name, speed, res[i].setup_allocs,
+                res[i].run_allocs, res[i].peak_bytes);
+    }
+    return fclose(fp);
+}
+
+static bool worse(double got, double base, double pct, bool higher_is_better) {
+    return higher_is_better ? got < base * (1 - pct / 100) : got > base * (1 + pct / 100);
+}
+
+int main(int argc, char *argv[]) {
+    int runs = 5;
+    double tolerance = 15;
+    double speed_tolerance = 25;
+    const char *baseline_path = BENCH_DECODE_BASELINE;
+    bool write = false;
+    int opt;
+    while ((opt = getopt(argc, argv, "r:t:s:b:w")) != -1) {
+        switch (opt) {
+        case 'r':
+            runs = atoi(optarg);
+            break;
+        case 't':
+            tolerance = atof(optarg);
+            break;
+        case 's':
+            speed_tolerance = atof(optarg);
+            break;
+        case 'b':
+            baseline_path = optarg;
+            break;
+        case 'w':
+            write = true;
+            break;
+        default:
+            fprintf(stderr, "usage: %s [-r runs] [-t percent] [-s percent] [-b baseline] [-w]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (runs < 1 || tolerance < 0 || speed_tolerance < 0) {
+        fprintf(stderr, "runs must be at least 1, percent at least 0\n");
+        return 2;
+    }
+    esp_log_level_set("*", ESP_LOG_ERROR);
+
+    for (int i = 0; i < music_assets_count && num_inputs < MAX_INPUTS; i++) {
+        inputs[num_inputs].asset = music_assets[i];
+        snprintf(inputs[num_inputs].name, sizeof(inputs[num_inputs].name), "%s", music_assets[i].name);
+        num_inputs++;
+    }
+    for (int i = 1; i < music_assets_count && num_inputs < MAX_INPUTS; i++) {
+        if (add_repeated(&music_assets[i], LONG_REPEAT) != 0) {
+            return 1;
+        }
+    }
+
+    char backend[32];
+    backend_key(backend, sizeof(backend));
+    bool have_baseline = load_baseline(baseline_path) == 0;
+    uint64_t cal_ns = calibrate(runs);
+    printf("decoder backend: %s, best of %d runs, baseline %s%s\n", mp3_decoder_host_backend(), runs, baseline_path,
+           have_baseline ? "" : " (none)");
+    printf("calibration loop %.3f ms, throughput %s\n", cal_ns / 1e6,
+           throughput_checked(backend) ? "checked" : "not checked: the stand-in decoder only walks frames");
+    printf("%-34s %6s %8s %10s %10s %8s %6s %5s %9s %9s\n", "input", "rate", "audio_s", "frames/s", "frames/cal",
+           "RTF", "setup", "/run", "peak KiB", "baseline");
+
+    decode_result_t res[MAX_INPUTS] = {0};
+    int ret = 0;
+    for (int i = 0; i < num_inputs; i++) {
+        decode_result_t *r = &res[i];
+        if (measure(&inputs[i], runs, r) != 0) {
+            ret = 1;
+            continue;
+        }
+        r->frames_per_cal = r->frames_per_s * cal_ns / 1e9;
+        double audio_s = (double)r->pcm_bytes / (r->sample_rate * r->channels * 2);
+        const baseline_t *b = find_baseline(backend, inputs[i].name);
+        char verdict[64] = "-";
+        if (b) {
+            verdict[0] = '\0';
+            if (throughput_checked(backend) && b->frames_per_cal > 0
+                && worse(r->frames_per_cal, b->frames_per_cal, speed_tolerance, true)) {
+                strcat(verdict, "speed ");
+            }
+            if (worse(r->setup_allocs, b->setup_allocs, tolerance, false) ||
+                    worse(r->run_allocs, b->run_allocs, tolerance, false)) {
+                strcat(verdict, "allocs ");
+            }
+            if (worse(r->peak_bytes, b->peak_bytes, tolerance, false)) {
+                strcat(verdict, "memory ");
+            }
+            if (!verdict[0]) {
+                strcpy(verdict, "ok");
+            } else if (!write) {
+                ret = 1;
+            }
+        }
+        printf("%-34s %6d %8.2f %10.0f %10.2f %8.5f %6zu %5zu %9.1f %9s\n", inputs[i].name, r->sample_rate,
+               audio_s, r->frames_per_s, r->frames_per_cal, r->rtf, r->setup_allocs, r->run_allocs,
+               r->peak_bytes / 1024.0, verdict);
+        if (b && strcmp(verdict, "ok")) {
+            fprintf(stderr, "%s: %.2f frames/cal, %zu + %zu allocs, %zu bytes peak; baseline %.2f, %zu + %zu, %zu\n",
+                    inputs[i].name, r->frames_per_cal, r->setup_allocs, r->run_allocs, r->peak_bytes,
+                    b->frames_per_cal, b->setup_allocs, b->run_allocs, b->peak_bytes);
+        }
+        if (r->leaked_bytes) {
+            fprintf(stderr, "%s: %ld bytes not released by player_pipeline_destroy()\n", inputs[i].name,
+                    r->leaked_bytes);
+            ret = 1;
+        }
+    }
+    struct rusage ru;
+    getrusage(RUSAGE_SELF, &ru);
+    printf("process peak RSS %ld KiB\n", ru.ru_maxrss);
+
+    if (write) {
+        if (ret == 0 && write_baseline(baseline_path, backend, res) == 0) {
+            printf("baseline written to %s\n", baseline_path);
+        } else {
+            fprintf(stderr, "baseline not written\n");
+            ret = 1;
+        }
+    }
+    for (int i = 0; i < num_inputs; i++) {
+        free(inputs[i].owned);
+    }
+    return ret;
+}
@@ -0,0 +1,129 @@
+/* Copy vs. zero-copy consumption of the embedded mp3 assets
+
+   Walks every frame header of each asset, once through embed_stream_read_cb()
+   into a decoder-sized input buffer (the memcpy path the decoder uses) and
+   once straight off embed_stream_peek() slices.
+
+   Usage: bench_embed_read [passes]
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "embed_stream.h"
+#include "music_assets.h"
+#include "mp3_frame.h"
+#include "bench_clock.h"
+
+#define INPUT_BUF_SIZE  2048    /* mp3 decoder input buffer size */
+
+typedef struct {
+    int frames;
+    uint64_t bytes;
+    uint64_t ns;
+    uint64_t cycles;
+    uint32_t checksum;          /* keeps the walk from being optimised out */
+} walk_result_t;
+
+static void start_stream(embed_stream_handle_t stream, const embed_asset_t *asset) {
+    const uint8_t *data;
+    embed_stream_set_asset(stream, asset);
+    embed_stream_peek(stream, &data, 0);
+    embed_stream_advance(stream, mp3_id3v2_size(data, embed_stream_size(stream)));
+}
+
+static void walk_copy(embed_stream_handle_t stream, const embed_asset_t *asset, walk_result_t *res) {
+    static uint8_t buf[INPUT_BUF_SIZE + MP3_FRAME_MAX_BYTES];
+    int fill = 0;
+    start_stream(stream, asset);
+
+    uint64_t t0 = bench_now_ns(), c0 = bench_cycles();
+    while (1) {
+        int n = embed_stream_read_cb(NULL, (char *)buf + fill, INPUT_BUF_SIZE, 0, stream);
+        if (n > 0) {
+            fill += n;
+            res->bytes += n;
+        }
+        int off = 0;
+        mp3_frame_info_t info;
+        while (fill - off >= MP3_FRAME_HEADER_SIZE) {
+            int size = mp3_frame_parse_header(buf + off, &info);
+            if (size == 0) {
+                off++;
+                continue;
+            }
+            if (off + size > fill && n > 0) {
+                break;
+            }
+            res->checksum += buf[off + 2] ^ buf[off + size - 1 < fill ? off + size - 1 : fill - 1];
+            res->frames++;
+            off += size;
+        }
+        memmove(buf, buf + off, fill - off);
+        fill -= off;
+        if (n <= 0) {
+            break;
+        }
+    }
+    res->ns += bench_now_ns() - t0;
+    res->cycles += bench_cycles() - c0;
+}
+
+static void walk_zero_copy(embed_stream_handle_t stream, const embed_asset_t *asset, walk_result_t *res) {
+    start_stream(stream, asset);
+
+    uint64_t t0 = bench_now_ns(), c0 = bench_cycles();
+    const uint8_t *data;
+    int len = embed_stream_peek(stream, &data, 0);
+    res->bytes += len;
+    int off = 0;
+    mp3_frame_info_t info;
+    while (len - off >= MP3_FRAME_HEADER_SIZE) {
+        int size = mp3_frame_parse_header(data + off, &info);
+        if (size == 0) {
+            off++;
+            continue;
+        }
+        int last = off + size - 1 < len ? off + size - 1 : len - 1;
+        res->checksum += data[off + 2] ^ data[last];
+        res->frames++;
+        off += size;
+    }
+    embed_stream_advance(stream, len);
+    res->ns += bench_now_ns() - t0;
+    res->cycles += bench_cycles() - c0;
+}
+
+static void report(const char *name, const char *mode, const walk_result_t *res) {
+    printf("%-26s %-10s %8d %10.1f %12.1f\n", name, mode, res->frames,
+           res->bytes * 1e3 / res->ns, (double)res->cycles / res->frames);
+}
+
+int main(int argc, char *argv[]) {
+    int passes = argc > 1 ? atoi(argv[1]) : 200;
+    embed_stream_handle_t stream = embed_stream_create();
+    if (!stream || passes <= 0) {
+        return 1;
+    }
+
+    printf("%-26s %-10s %8s %10s %12s\n", "asset", "mode", "frames", "MB/s", "cycles/frame");
+    for (int i = 0; i < music_assets_count; i++) {
+        walk_result_t copy = {0}, zero = {0};
+        for (int p = 0; p < passes; p++) {
+            walk_copy(stream, &music_assets[i], &copy);
+            walk_zero_copy(stream, &music_assets[i], &zero);
+        }
+        copy.frames /= passes;
+        zero.frames /= passes;
+        copy.cycles /= passes;
+        zero.cycles /= passes;
+        report(music_assets[i].name, "copy", &copy);
+        report(music_assets[i].name, "zero-copy", &zero);
+        if (copy.checksum != zero.checksum) {
+            fprintf(stderr, "checksum mismatch on %s\n", music_assets[i].name);
+            return 1;
+        }
+    }
+    embed_stream_destroy(stream);
+    return 0;
+}
@@ -0,0 +1,393 @@
+/* The FAT worker's check: the 2 s write/read probe against fat_verifier
+
+   A model of the 1 MB storage partition, 250 sectors of 4 KiB in RAM, holds
+   a FAT12 volume: boot sector, two FATs of one sector, one root directory
+   sector, then the clusters of test.txt, of an app file and of a track.
+   Time is the simulated clock.
+
+   - probe: what isFATFSCorrupted() costs the flash every 2 s; FatFs reads
+     the FAT (following test.txt's chain) and the directory, writes the data
+     sector, both FATs and the directory, and reads the data back. Any read
+     or write error, an invalid chain or data that does not read back is
+     detected.
+   - verifier: fat_verifier ticks every 500 ms at the player's budget while
+     the app rewrites its file every 60 s, as FatFs through storage_diskio
+     (write_begin, erase, a tick, program, write_end). A verifier read of the
+     app's data sector sometimes has the app write it meanwhile.
+
+   Each fault is injected at 300 s, once the first sweep knows every
+   sector: read errors, write errors, programs that do not land (the sector
+   stays erased), a FAT entry out of range, the boot sector damaged, a bit
+   flipped in a track.
+
+   Checks, exit status 1 if any fails:
+   - the verifier detects every fault the probe detects, and every other
+     one, within a sweep plus 60 s;
+   - an hour without faults raises none, reads stay within the budget and
+     the read-backs of the app's writes slow the sweep by less than 10 %;
+   - the verifier writes nothing, the probe writes thousands of sectors an hour.
+
+   Usage: bench_fat_verifier
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "fat_verifier.h"
+
+#define SECTOR_SIZE         4096
+#define NUM_SECTORS         250
+#define FAT_SECTOR          1           // FAT1; FAT2 is 2
+#define ROOT_SECTOR         3
+#define DATA_START          4
+#define CLUSTERS            (NUM_SECTORS - DATA_START)
+#define PROBE_CLUSTER       2
+#define APP_CLUSTER         10
+#define TRACK_FIRST         20
+#define TRACK_LAST          200
+#define CLUSTER_SECTOR(c)   (DATA_START + (c) - 2)
+#define PROBE_PERIOD_MS     2000
+#define TICK_MS             500
+#define APP_PERIOD_MS       60000
+#define BUDGET              (16 * 1024)
+#define INJECT_S            300
+#define RUN_S               600
+#define CLEAN_RUN_S         3600
+
+typedef enum {
+    FAULT_NONE,
+    FAULT_READ_ERROR,       // reads of the sector fail
+    FAULT_WRITE_ERROR,      // every program fails
+    FAULT_LOST_PROGRAM,     // the erase lands, the program does not
+    FAULT_FAT_ENTRY,        // test.txt's FAT entry out of range
+    FAULT_BOOT,             // boot sector signature gone
+    FAULT_BIT_FLIP,         // one bit of the sector at rest
+} fault_t;
+
+typedef struct {
+    const char *name;
+    fault_t fault;
+    uint32_t sector;
+} scenario_t;
+
+typedef struct {
+    uint8_t img[NUM_SECTORS][SECTOR_SIZE];
+    fault_t fault;
+    uint32_t fault_sector;
+    uint32_t reads;
+    uint32_t writes;        // sectors programmed
+    uint32_t app_writes;    // of them by the app
+    uint32_t app_seq;
+    bool race;              // have the app write its data sector during a verifier read of it
+    fat_verifier_handle_t ver;
+} flash_model_t;
+
+static flash_model_t flash;
+
+static void fat12_set(uint8_t *fat, uint32_t c, uint32_t v) {
+    uint8_t *p = fat + c + c / 2;
+    if (c & 1) {
+        p[0] = (p[0] & 0x0F) | ((v << 4) & 0xF0);
+        p[1] = v >> 4;
+    } else {
+        p[0] = v;
+        p[1] = (p[1] & 0xF0) | ((v >> 8) & 0x0F);
+    }
+}
+
+static uint32_t fat12_get(const uint8_t *fat, uint32_t c) {
+    const uint8_t *p = fat + c + c / 2;
+    return (c & 1) ? (p[0] >> 4) | (p[1] << 4) : p[0] | ((p[1] & 0x0F) << 8);
+}
+
+static void format(flash_model_t *f) {
+    memset(f, 0, sizeof(*f));
+    uint8_t *b = f->img[0];
+    b[0] = 0xEB, b[1] = 0x3C, b[2] = 0x90;
+    memcpy(b + 3, "MSDOS5.0", 8);
+    b[11] = SECTOR_SIZE & 0xFF, b[12] = SECTOR_SIZE >> 8;
+    b[13] = 1;                                  // sectors per cluster
+    b[14] = 1;                                  // reserved
+    b[16] = 2;                                  // FATs
+    b[17] = SECTOR_SIZE / 32 & 0xFF, b[18] = SECTOR_SIZE / 32 >> 8;
+    b[19] = NUM_SECTORS & 0xFF, b[20] = NUM_SECTORS >> 8;
+    b[21] = 0xF8;
+    b[22] = 1;                                  // sectors per FAT
+    memcpy(b + 54, "FAT12   ", 8);
+    b[510] = 0x55, b[511] = 0xAA;
+    uint8_t *fat = f->img[FAT_SECTOR];
+    fat12_set(fat, 0, 0xFF8);
+    fat12_set(fat, 1, 0xFFF);
+    fat12_set(fat, PROBE_CLUSTER, 0xFFF);
+    fat12_set(fat, APP_CLUSTER, 0xFFF);
+    for (uint32_t c = TRACK_FIRST; c < TRACK_LAST; c++) {
+        fat12_set(fat, c, c + 1);
+    }
+    fat12_set(fat, TRACK_LAST, 0xFFF);
+    memcpy(f->img[FAT_SECTOR + 1], fat, SECTOR_SIZE);
+    memcpy(f->img[ROOT_SECTOR], "TEST    TXTAPP     DATMUSIC   MP3", 33);
+    uint32_t x = 12345;
+    for (uint32_t c = TRACK_FIRST; c <= TRACK_LAST; c++) {
+        for (int i = 0; i < SECTOR_SIZE; i++) {
+            x = x * 1103515245 + 12345;
+            f->img[CLUSTER_SECTOR(c)][i] = x >> 16;
+        }
+    }
+    memset(f->img[CLUSTER_SECTOR(PROBE_CLUSTER)], 0xFF, SECTOR_SIZE);
+    memcpy(f->img[CLUSTER_SECTOR(PROBE_CLUSTER)], "hello world", 11);
+}
+
+static esp_err_t model_read(flash_model_t *f, uint32_t sector, void *buf) {
+    f->reads++;
+    if (f->fault == FAULT_READ_ERROR && sector == f->fault_sector) {
+        return ESP_FAIL;
+    }
+    memcpy(buf, f->img[sector], SECTOR_SIZE);
+    return ESP_OK;
+}
+
+static void model_erase(flash_model_t *f, uint32_t sector) {
+    memset(f->img[sector], 0xFF, SECTOR_SIZE);
+}
+
+static esp_err_t model_program(flash_model_t *f, uint32_t sector, const void *buf) {
+    f->writes++;
+    if (f->fault == FAULT_WRITE_ERROR) {
+        return ESP_FAIL;
+    }
+    if (f->fault != FAULT_LOST_PROGRAM) {
+        memcpy(f->img[sector], buf, SECTOR_SIZE);
+    }
+    return ESP_OK;
+}
+
+static void inject(flash_model_t *f, const scenario_t *sc) {
+    f->fault = sc->fault;
+    f->fault_sector = sc->sector;
+    switch (sc->fault) {
+    case FAULT_FAT_ENTRY:
+        fat12_set(f->img[FAT_SECTOR], PROBE_CLUSTER, CLUSTERS + 40);
+        break;
+    case FAULT_BOOT:
+        f->img[0][510] = 0;
+        break;
+    case FAULT_BIT_FLIP:
+        f->img[sc->sector][1000] ^= 0x10;
+        break;
+    default:
+        break;
+    }
+}
+
+/**
+ * @brief isFATFSCorrupted() as it reaches the flash, uncached; false if it fails
+ */
+static bool probe(flash_model_t *f) {
+    static uint8_t fat[SECTOR_SIZE], root[SECTOR_SIZE], data[SECTOR_SIZE];
+    // fopen("wb"): the directory entry, then the chain of test.txt is freed and a cluster allocated
+    if (model_read(f, ROOT_SECTOR, root) != ESP_OK || model_read(f, FAT_SECTOR, fat) != ESP_OK) {
+        return false;
+    }
+    uint32_t next = fat12_get(fat, PROBE_CLUSTER);
+    if (next == 1 || (next >= CLUSTERS + 2 && next < 0xFF7)) {
+        return false;
+    }
+    fat12_set(fat, PROBE_CLUSTER, 0xFFF);
+    memset(data, 0xFF, SECTOR_SIZE);
+    memcpy(data, "hello world", 11);
+    // fwrite + fclose: data, both FATs, directory
+    const uint32_t sectors[] = {CLUSTER_SECTOR(PROBE_CLUSTER), FAT_SECTOR, FAT_SECTOR + 1, ROOT_SECTOR};
+    const uint8_t *bufs[] = {data, fat, fat, root};
+    for (int i = 0; i < 4; i++) {
+        model_erase(f, sectors[i]);
+        if (model_program(f, sectors[i], bufs[i]) != ESP_OK) {
+            return false;
+        }
+    }
+    // fopen("r") + fread
+    uint8_t back[SECTOR_SIZE];
+    return model_read(f, CLUSTER_SECTOR(PROBE_CLUSTER), back) == ESP_OK && !memcmp(back, "hello world", 11);
+}
+
+/**
+ * @brief One sector written as storage_diskio's flash_write does, the verifier ticking between erase and program
+ */
+static void app_write_sector(flash_model_t *f, uint32_t sector, const uint8_t *buf, bool tick) {
+    f->app_writes++;
+    fat_verifier_write_begin(f->ver, sector, 1);
+    model_erase(f, sector);
+    if (tick) {
+        fat_verifier_tick(f->ver);
+    }
+    esp_err_t err = model_program(f, sector, buf);
+    fat_verifier_write_end(f->ver, sector, buf, 1, err);
+}
+
+/**
+ * @brief The app rewrites its file: data, both FATs, directory
+ */
+static void app_update(flash_model_t *f, bool tick) {
+    static uint8_t data[SECTOR_SIZE], fat[SECTOR_SIZE], root[SECTOR_SIZE];
+    f->app_seq++;
+    for (int i = 0; i < SECTOR_SIZE; i++) {
+        data[i] = f->app_seq * 7 + i;
+    }
+    app_write_sector(f, CLUSTER_SECTOR(APP_CLUSTER), data, tick);
+    if (model_read(f, FAT_SECTOR, fat) == ESP_OK) {
+        fat12_set(fat, APP_CLUSTER, 0xFFF);
+        app_write_sector(f, FAT_SECTOR, fat, false);
+        app_write_sector(f, FAT_SECTOR + 1, fat, false);
+    }
+    if (model_read(f, ROOT_SECTOR, root) == ESP_OK) {
+        root[40] = f->app_seq;
+        app_write_sector(f, ROOT_SECTOR, root, false);
+    }
+}
+
+static esp_err_t verifier_read(void *ctx, uint32_t sector, void *buf, size_t count) {
+    flash_model_t *f = (flash_model_t *)ctx;
+    for (size_t i = 0; i < count; i++) {
+        esp_err_t err = model_read(f, sector + i, (uint8_t *)buf + i * SECTOR_SIZE);
+        if (err != ESP_OK) {
+            return err;
+        }
+    }
+    if (f->race && sector == CLUSTER_SECTOR(APP_CLUSTER)) {
+        // the FAT worker was preempted mid-read, the app wrote the sector meanwhile
+        f->race = false;
+        app_update(f, false);
+    }
+    return ESP_OK;
+}
+
+typedef struct {
+    int64_t probe_detect_us;        // 0: not detected
+    int64_t verify_detect_us;
+    esp_err_t verify_err;
+    uint32_t probe_writes;
+    uint32_t verify_writes;         // of them the app's
+    uint32_t app_writes;
+    uint32_t verify_reads;
+    fat_verifier_stats_t stats;
+} outcome_t;
+
+static void run_probe(const scenario_t *sc, int run_s, outcome_t *out) {
+    format(&flash);
+    esp_timer_host_advance(-esp_timer_get_time());
+    for (int64_t t = 0; t < run_s * 1000000LL; t += PROBE_PERIOD_MS * 1000) {
+        esp_timer_host_advance(t - esp_timer_get_time());
+        if (sc && t >= INJECT_S * 1000000LL && flash.fault == FAULT_NONE) {
+            inject(&flash, sc);
+        }
+        if (!probe(&flash)) {
+            out->probe_detect_us = t;
+            break;
+        }
+    }
+    out->probe_writes = flash.writes;
+}
+
+static void run_verifier(const scenario_t *sc, int run_s, outcome_t *out) {
+    format(&flash);
+    esp_timer_host_advance(-esp_timer_get_time());
+    fat_verifier_cfg_t cfg = FAT_VERIFIER_CFG_DEFAULT();
+    cfg.sector_size = SECTOR_SIZE;
+    cfg.num_sectors = NUM_SECTORS;
+    cfg.budget_bytes_per_s = BUDGET;
+    cfg.read = verifier_read;
+    cfg.ctx = &flash;
+    flash.ver = fat_verifier_create(&cfg);
+    int64_t next_app = APP_PERIOD_MS * 1000LL;
+    for (int64_t t = 0; t < run_s * 1000000LL; t += TICK_MS * 1000) {
+        esp_timer_host_advance(t - esp_timer_get_time());
+        if (sc && t >= INJECT_S * 1000000LL && flash.fault == FAULT_NONE) {
+            inject(&flash, sc);
+        }
+        if (t >= next_app) {
+            next_app += APP_PERIOD_MS * 1000LL;
+            app_update(&flash, true);
+            flash.race = true;
+        }
+        esp_err_t err = fat_verifier_tick(flash.ver);
+        if (err != ESP_OK) {
+            out->verify_err = err;
+            out->verify_detect_us = t;
+            break;
+        }
+    }
+    fat_verifier_get_stats(flash.ver, &out->stats);
+    out->verify_writes = flash.writes;
+    out->app_writes = flash.app_writes;
+    out->verify_reads = flash.reads;
+    fat_verifier_destroy(flash.ver);
+}
+
+int main(int argc, char *argv[]) {
+    esp_log_level_set("*", ESP_LOG_NONE);
+    static const scenario_t scenarios[] = {
+        {"read error, FAT", FAULT_READ_ERROR, FAT_SECTOR},
+        {"read error, root dir", FAULT_READ_ERROR, ROOT_SECTOR},
+        {"write error", FAULT_WRITE_ERROR, 0},
+        {"programs lost", FAULT_LOST_PROGRAM, 0},
+        {"FAT entry corrupt", FAULT_FAT_ENTRY, FAT_SECTOR},
+        {"boot sector corrupt", FAULT_BOOT, 0},
+        {"bit flip in a track", FAULT_BIT_FLIP, CLUSTER_SECTOR(100)},
+        {"read error, track", FAULT_READ_ERROR, CLUSTER_SECTOR(150)},
+    };
+    const int n = sizeof(scenarios) / sizeof(scenarios[0]);
+    const int64_t sweep_us = (int64_t)NUM_SECTORS * SECTOR_SIZE * 1000000LL / BUDGET;
+    const int64_t bound_us = sweep_us + APP_PERIOD_MS * 1000LL;
+    int failed = 0;
+
+    printf("%-22s %9s %12s %-22s\n", "fault", "probe_s", "verifier_s", "verifier");
+    for (int i = 0; i < n; i++) {
+        const scenario_t *sc = &scenarios[i];
+        outcome_t o = {0};
+        run_probe(sc, RUN_S, &o);
+        run_verifier(sc, RUN_S, &o);
+        int64_t late = o.verify_detect_us - INJECT_S * 1000000LL;
+        printf("%-22s %9s %12.1f %-22s\n", sc->name,
+               o.probe_detect_us ? "detected" : "-", o.verify_detect_us ? late / 1e6 : -1.0,
+               o.verify_detect_us ? esp_err_to_name(o.verify_err) : "not detected");
+        if (o.probe_detect_us && o.probe_detect_us < INJECT_S * 1000000LL) {
+            fprintf(stderr, "%s: the probe failed before the fault\n", sc->name);
+            failed = 1;
+        }
+        if (!o.verify_detect_us || late < 0 || late > bound_us) {
+            fprintf(stderr, "%s: verifier %s, %d ms after the fault, bound %d ms\n", sc->name,
+                    o.verify_detect_us ? "detected" : "did not detect", (int)(late / 1000), (int)(bound_us / 1000));
+            failed = 1;
+        }
+    }
+
+    // an hour of each without faults
+    outcome_t o = {0};
+    run_probe(NULL, CLEAN_RUN_S, &o);
+    run_verifier(NULL, CLEAN_RUN_S, &o);
+    uint32_t check_writes = o.verify_writes - o.app_writes;
+    const fat_verifier_stats_t *s = &o.stats;
+    printf("\nclean hour, sectors written for the check: probe %u, verifier %u (the app wrote %u)\n",
+           o.probe_writes, check_writes, o.app_writes);
+    printf("verifier: %u passes, %u sectors read (%d KiB/s, budget %d), %u written read back, %u reads raced\n",
+           s->passes, s->sectors_read, (int)((int64_t)s->sectors_read * SECTOR_SIZE / 1024 / CLEAN_RUN_S),
+           BUDGET / 1024, s->readbacks, s->raced);
+    if (o.probe_detect_us || o.verify_detect_us) {
+        fprintf(stderr, "clean hour: probe %s, verifier %s\n", o.probe_detect_us ? "failed" : "passed",
+                o.verify_detect_us ? esp_err_to_name(o.verify_err) : "passed");
+        failed = 1;
+    }
+    if (check_writes || o.probe_writes < 1000) {
+        fprintf(stderr, "verifier wrote %u sectors, probe %u\n", check_writes, o.probe_writes);
+        failed = 1;
+    }
+    if ((int64_t)s->sectors_read * SECTOR_SIZE > (int64_t)BUDGET * CLEAN_RUN_S + 2 * SECTOR_SIZE
+        || s->passes < CLEAN_RUN_S * 1000000LL * 9 / 10 / sweep_us || !s->raced || !s->readbacks) {
+        fprintf(stderr, "verifier: %u sectors read in %d s, %u passes, %u raced, %u read back\n", s->sectors_read,
+                CLEAN_RUN_S, s->passes, s->raced, s->readbacks);
+        failed = 1;
+    }
+    printf("%s\n", failed ? "FAILED" : "OK");
+    return failed;
+}
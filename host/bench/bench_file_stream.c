@@ -0,0 +1,181 @@
+/* Playback from a file through file_stream, against a storage that stalls
+
+   Writes an embedded asset to a temporary file and plays it through the
+   app_main pipeline (file_stream -> mp3 decoder -> sink) for several
+   read-ahead depths. The reader task is simulated on the host thread: each
+   4 KiB chunk takes READ_MS of simulated time, and every STALL_EVERY chunks
+   the storage stalls for STALL_MS, as when the reader queues behind a write
+   back of the whole sector cache in the flash arbiter (32 sectors of erase,
+   program and recovery pause) or FatFs walks a long directory. The mp3
+   decoder's own input buffer adds to the read-ahead. The
+   sink advances the simulated clock as i2s DMA would; when it runs dry the
+   clock jumps to the next chunk and the gap is counted.
+
+   Usage: bench_file_stream [asset_index]
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "audio_common.h"
+#include "pcm_sink.h"
+#include "mp3_decoder.h"
+#include "mp3_frame.h"
+#include "music_assets.h"
+#include "player_pipeline.h"
+#include "file_stream.h"
+
+#define READ_MS         2
+#define OPEN_MS         50
+#define STALL_EVERY     32
+#define STALL_MS        3000
+#define DEFAULT_DEPTH   16
+#define MAX_STEPS       10000000
+
+typedef struct {
+    int depth;
+    file_stream_stats_t stats;
+    uint32_t gaps;          // times the sink ran dry before the end
+    int64_t gap_us;
+    int64_t pcm_bytes;
+} result_t;
+
+/**
+ * @brief The reader task: one chunk per READ_MS, a stall every STALL_EVERY chunks
+ */
+typedef struct {
+    file_stream_handle_t stream;
+    int64_t ready_us;       // the chunk in flight is read by then
+    uint32_t chunks;
+    bool done;
+} reader_sim_t;
+
+static void reader_run(reader_sim_t *r) {
+    while (!r->done && esp_timer_get_time() >= r->ready_us) {
+        int ret = file_stream_fill(r->stream, 0);
+        if (ret == 0) {
+            // buffer full, the task blocks in rb_write
+            return;
+        }
+        if (ret < 0) {
+            r->done = true;
+            return;
+        }
+        // the next read starts once this chunk is queued
+        r->chunks++;
+        r->ready_us = esp_timer_get_time() + (r->chunks % STALL_EVERY ? READ_MS : STALL_MS) * 1000LL;
+    }
+}
+
+static int play(const char *path, const mp3_frame_info_t *info, result_t *res) {
+    file_stream_cfg_t fs_cfg = FILE_STREAM_CFG_DEFAULT();
+    fs_cfg.depth = res->depth;
+    fs_cfg.task_stack = 0;
+    file_stream_handle_t stream = file_stream_create(&fs_cfg);
+    pcm_sink_cfg_t sink_cfg = PCM_SINK_CFG_DEFAULT();
+    sink_cfg.realtime = true;
+    audio_element_handle_t sink = pcm_sink_init(&sink_cfg);
+    if (!stream || !sink) {
+        return -1;
+    }
+    audio_element_set_music_info(sink, info->sample_rate, info->channels, 16);
+
+    player_pipeline_t player;
+    player_pipeline_cfg_t player_cfg = PLAYER_PIPELINE_CFG_DEFAULT();
+    player_cfg.read_cb = file_stream_read_cb;
+    player_cfg.read_ctx = stream;
+    if (player_pipeline_create(&player, &player_cfg, sink) != ESP_OK) {
+        return -1;
+    }
+    file_stream_open(stream, path);
+    reader_sim_t reader = {.stream = stream, .ready_us = esp_timer_get_time() + OPEN_MS * 1000LL};
+    audio_pipeline_run(player.pipeline);
+
+    int ret = -1;
+    bool started = false;
+    for (int i = 0; i < MAX_STEPS; i++) {
+        reader_run(&reader);
+        while (audio_element_host_step(player.mp3_decoder)) {
+        }
+        if (audio_element_host_step(player.sink)) {
+            started = true;
+            continue;
+        }
+        if (audio_element_get_state(player.sink) == AEL_STATE_FINISHED) {
+            ret = 0;
+            break;
+        }
+        if (reader.done && audio_element_get_state(player.mp3_decoder) != AEL_STATE_RUNNING) {
+            continue;
+        }
+        // nothing to play until the next chunk arrives
+        int64_t wait = reader.ready_us - esp_timer_get_time();
+        if (wait < 1000) {
+            wait = 1000;
+        }
+        if (started) {
+            res->gaps++;
+            res->gap_us += wait;
+        }
+        esp_timer_host_advance(wait);
+    }
+    file_stream_get_stats(stream, &res->stats);
+    res->pcm_bytes = pcm_sink_get_bytes(sink);
+    player_pipeline_stop(&player);
+    player_pipeline_destroy(&player);
+    file_stream_destroy(stream);
+    return ret;
+}
+
+int main(int argc, char *argv[]) {
+    int index = argc > 1 ? atoi(argv[1]) : music_assets_count - 1;
+    if (index < 0 || index >= music_assets_count) {
+        fprintf(stderr, "usage: %s [asset_index 0..%d]\n", argv[0], music_assets_count - 1);
+        return 2;
+    }
+    esp_log_level_set("*", ESP_LOG_ERROR);
+
+    const embed_asset_t *asset = &music_assets[index];
+    int len = asset->end - asset->start;
+    int tag = mp3_id3v2_size(asset->start, len);
+    mp3_frame_info_t info;
+    if (tag >= len || mp3_frame_sync(asset->start + tag, len - tag, &info) < 0) {
+        fprintf(stderr, "%s: no mp3 frame\n", asset->name);
+        return 1;
+    }
+    char path[] = "/tmp/bench_file_stream_XXXXXX";
+    int fd = mkstemp(path);
+    if (fd < 0 || write(fd, asset->start, len) != len) {
+        perror(path);
+        return 1;
+    }
+    close(fd);
+
+    printf("%s, %d bytes; reads %d ms per 4 KiB, %d ms stall every %d chunks\n", asset->name, len, READ_MS,
+           STALL_MS, STALL_EVERY);
+    printf("%6s %8s %9s %7s %10s %7s %9s %9s\n", "depth", "ahead_kb", "ahead_ms", "chunks", "src_underr", "gaps",
+           "gap_ms", "min_kb");
+    const int depths[] = {1, 2, 4, 8, DEFAULT_DEPTH, 32};
+    int ret = 0;
+    for (int i = 0; i < sizeof(depths) / sizeof(depths[0]); i++) {
+        result_t res = {.depth = depths[i]};
+        if (play(path, &info, &res) != 0) {
+            fprintf(stderr, "depth %d: playback did not finish\n", res.depth);
+            ret = 1;
+            break;
+        }
+        // read-ahead in audio time at the file's average bit rate
+        double duration_ms = res.pcm_bytes * 1000.0 / (info.sample_rate * info.channels * 2);
+        printf("%6d %8d %9.0f %7u %10u %7u %9.1f %9.1f\n", res.depth, res.stats.depth / 1024,
+               res.stats.depth * duration_ms / len, res.stats.chunks, res.stats.underruns, res.gaps,
+               res.gap_us / 1e3, res.stats.min_level / 1024.0);
+        if (res.depth == DEFAULT_DEPTH && res.gaps) {
+            fprintf(stderr, "default read-ahead of %d chunks did not cover the stalls\n", DEFAULT_DEPTH);
+            ret = 1;
+        }
+    }
+    unlink(path);
+    return ret;
+}
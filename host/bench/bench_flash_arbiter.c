@@ -0,0 +1,297 @@
+/* FAT flash I/O against a simulated i2s consumer, with and without the flash arbiter
+
+   Replays the sector traffic of the worker's FAT check (isFATFSCorrupted:
+   directory and FAT reads, erase + program of the data, FAT and directory
+   sectors, read back) plus a multi-sector write, on a simulated flash whose
+   operations block the CPU with the cache disabled. Meanwhile a simulated
+   i2s stream plays 44.1 kHz stereo from its DMA buffers; the i2s task refills
+   DMA from the ring buffer and the decoder refills the ring buffer, but only
+   while no flash operation is in progress, as on the board where a flash
+   operation stalls both cores; both tasks outrank the worker and run as soon
+   as an operation completes.
+
+   Scenarios: ADF's default DMA (3 x 300) and the app's DMA (6 x 512) with
+   direct flash access, then the app's DMA through flash_arbiter with the
+   same headroom estimate app_main uses. Exits nonzero if the arbitrated run
+   underruns or a window outlasts its headroom.
+
+   Usage: bench_flash_arbiter [checks]
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "flash_arbiter.h"
+
+#define SECTOR_SIZE     4096
+#define SAMPLE_RATE     44100
+#define FRAME_BYTES     4
+#define RB_SIZE         (8 * 1024)      // player_pipeline's decoder -> i2s ring buffer
+#define DECODE_SPEED    5               // decoder throughput, multiple of real time
+#define CHECK_GAP_MS    2000            // worker's delay between FAT checks
+#define SIM_STEP_US     500
+
+typedef struct {
+    const char *name;
+    int dma_buf_count;
+    int dma_buf_len;
+    bool arbitrated;
+} scenario_t;
+
+/**
+ * @brief i2s DMA, ring buffer and decoder, advanced lazily to the simulated clock
+ */
+typedef struct {
+    int dma_buf_count;
+    int dma_buf_len;
+    double dma_frames;          // queued in DMA
+    double rb_frames;           // queued in the ring buffer
+    int64_t t_us;               // time the state refers to
+    int64_t underrun_us;
+    uint32_t underruns;         // separate stalls
+    bool starved;
+} i2s_sim_t;
+
+/**
+ * @brief Flash whose operations stall the CPU, erases vary by +-10 %
+ */
+typedef struct {
+    i2s_sim_t *i2s;
+    uint32_t seed;
+    int64_t worst_us;           // longest cache-disabled operation
+    uint8_t data[64 * SECTOR_SIZE];
+} flash_sim_t;
+
+/**
+ * @brief The i2s task moves the ring buffer into free DMA buffers
+ *
+ * It outranks the worker, so it does so as soon as the cache is back.
+ */
+static void i2s_sim_refill(i2s_sim_t *s) {
+    double move = s->dma_buf_count * s->dma_buf_len - s->dma_frames;
+    if (move > s->rb_frames) {
+        move = s->rb_frames;
+    }
+    s->dma_frames += move;
+    s->rb_frames -= move;
+}
+
+static void i2s_sim_run(i2s_sim_t *s, int64_t until, bool blocked) {
+    double rb_cap = RB_SIZE / FRAME_BYTES;
+    if (!blocked) {
+        i2s_sim_refill(s);
+    }
+    while (s->t_us < until) {
+        int64_t dt = until - s->t_us < SIM_STEP_US ? until - s->t_us : SIM_STEP_US;
+        double played = dt * (double)SAMPLE_RATE / 1e6;
+        if (!blocked) {
+            // the decoder fills the ring buffer at decode speed
+            s->rb_frames += played * DECODE_SPEED;
+            if (s->rb_frames > rb_cap) {
+                s->rb_frames = rb_cap;
+            }
+            i2s_sim_refill(s);
+        }
+        s->dma_frames -= played;
+        if (s->dma_frames < 0) {
+            s->underrun_us += (int64_t)(-s->dma_frames * 1e6 / SAMPLE_RATE);
+            s->dma_frames = 0;
+            if (!s->starved) {
+                s->underruns++;
+            }
+            s->starved = true;
+        } else {
+            s->starved = false;
+        }
+        s->t_us += dt;
+    }
+}
+
+/**
+ * @brief app_main's i2s_headroom_us(), on the simulated ring buffer
+ */
+static int64_t sim_headroom_us(void *ctx) {
+    i2s_sim_t *s = (i2s_sim_t *)ctx;
+    i2s_sim_run(s, esp_timer_get_time(), false);
+    int64_t queued = (int64_t)s->rb_frames;
+    int64_t frames = (s->dma_buf_count - 2) * s->dma_buf_len + (queued < s->dma_buf_len ? queued : s->dma_buf_len);
+    return frames * 1000000 / SAMPLE_RATE;
+}
+
+static int64_t flash_latency_us(flash_sim_t *f, flash_op_t op, size_t size) {
+    f->seed = f->seed * 1103515245 + 12345;
+    int jitter = (int)((f->seed >> 16) % 201) - 100;    // -100..100 per mille
+    switch (op) {
+    case FLASH_OP_READ:
+        return 20 + (int64_t)size * 50 / 1024;
+    case FLASH_OP_WRITE:
+        return 20 + (int64_t)size * 2800 / 1024;
+    default:
+        return 20 + (int64_t)(size / SECTOR_SIZE) * 45000 * (1000 + jitter) / 1000;
+    }
+}
+
+static esp_err_t flash_io(flash_op_t op, size_t addr, void *buf, size_t size, void *ctx) {
+    flash_sim_t *f = (flash_sim_t *)ctx;
+    if (addr + size > sizeof(f->data)) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    int64_t us = flash_latency_us(f, op, size);
+    i2s_sim_run(f->i2s, esp_timer_get_time(), false);
+    i2s_sim_run(f->i2s, f->i2s->t_us + us, true);
+    esp_timer_host_advance(us);
+    if (us > f->worst_us) {
+        f->worst_us = us;
+    }
+    switch (op) {
+    case FLASH_OP_READ:
+        memcpy(buf, f->data + addr, size);
+        break;
+    case FLASH_OP_WRITE:
+        memcpy(f->data + addr, buf, size);
+        break;
+    default:
+        memset(f->data + addr, 0xff, size);
+        break;
+    }
+    return ESP_OK;
+}
+
+typedef struct {
+    flash_arbiter_handle_t arb;
+    flash_sim_t *flash;
+} disk_t;
+
+static esp_err_t disk_read(disk_t *d, int sector, void *buf, int count) {
+    size_t addr = sector * SECTOR_SIZE, size = count * SECTOR_SIZE;
+    if (d->arb) {
+        return flash_arbiter_run(d->arb, FLASH_OP_READ, addr, buf, size, flash_io, d->flash);
+    }
+    return flash_io(FLASH_OP_READ, addr, buf, size, d->flash);
+}
+
+/**
+ * @brief What storage_diskio's write does: erase, then program
+ */
+static esp_err_t disk_write(disk_t *d, int sector, void *buf, int count) {
+    size_t addr = sector * SECTOR_SIZE, size = count * SECTOR_SIZE;
+    esp_err_t err;
+    if (d->arb) {
+        err = flash_arbiter_run(d->arb, FLASH_OP_ERASE, addr, NULL, size, flash_io, d->flash);
+        return err ? err : flash_arbiter_run(d->arb, FLASH_OP_WRITE, addr, buf, size, flash_io, d->flash);
+    }
+    err = flash_io(FLASH_OP_ERASE, addr, NULL, size, d->flash);
+    return err ? err : flash_io(FLASH_OP_WRITE, addr, buf, size, d->flash);
+}
+
+/**
+ * @brief Sector traffic of one FAT check, plus a 16 KiB append and a 32 KiB read
+ */
+static esp_err_t fat_check(disk_t *d, int n) {
+    static uint8_t buf[8 * SECTOR_SIZE];
+    const int fat = 1, dir = 2, data = 8;
+    esp_err_t err = ESP_OK;
+    // fopen("wb"): directory and FAT lookup; fwrite + fclose: data, FAT, directory entry
+    err |= disk_read(d, dir, buf, 1);
+    err |= disk_read(d, fat, buf, 1);
+    snprintf((char *)buf, SECTOR_SIZE, "hello world %d", n);
+    err |= disk_write(d, data, buf, 1);
+    err |= disk_write(d, fat, buf, 1);
+    err |= disk_write(d, dir, buf, 1);
+    // fopen("r") + fread
+    err |= disk_read(d, dir, buf, 1);
+    err |= disk_read(d, data, buf, 1);
+    // a log append and a bulk read
+    err |= disk_write(d, 16 + (n % 8) * 4, buf, 4);
+    err |= disk_read(d, 16, buf, 8);
+    return err;
+}
+
+static int run(const scenario_t *sc, int checks, flash_arbiter_stats_t *stats, i2s_sim_t *i2s_out,
+               int64_t *worst_us) {
+    static flash_sim_t flash;
+    i2s_sim_t i2s = {
+        .dma_buf_count = sc->dma_buf_count,
+        .dma_buf_len = sc->dma_buf_len,
+        .dma_frames = sc->dma_buf_count * sc->dma_buf_len,
+        .rb_frames = RB_SIZE / FRAME_BYTES,
+        .t_us = esp_timer_get_time(),
+    };
+    memset(&flash, 0, sizeof(flash));
+    flash.i2s = &i2s;
+    flash.seed = 1;
+
+    disk_t disk = {.flash = &flash};
+    if (sc->arbitrated) {
+        flash_arbiter_cfg_t cfg = FLASH_ARBITER_CFG_DEFAULT();
+        cfg.unit_size = SECTOR_SIZE;
+        cfg.headroom = sim_headroom_us;
+        cfg.headroom_ctx = &i2s;
+        disk.arb = flash_arbiter_create(&cfg);
+        if (!disk.arb) {
+            return -1;
+        }
+    }
+    int ret = 0;
+    for (int n = 0; n < checks && ret == 0; n++) {
+        if (fat_check(&disk, n) != ESP_OK) {
+            ret = -1;
+        }
+        vTaskDelay(pdMS_TO_TICKS(CHECK_GAP_MS));
+        i2s_sim_run(&i2s, esp_timer_get_time(), false);
+    }
+    memset(stats, 0, sizeof(*stats));
+    if (disk.arb) {
+        flash_arbiter_get_stats(disk.arb, stats);
+        flash_arbiter_destroy(disk.arb);
+    }
+    *i2s_out = i2s;
+    *worst_us = flash.worst_us;
+    return ret;
+}
+
+int main(int argc, char *argv[]) {
+    int checks = argc > 1 ? atoi(argv[1]) : 100;
+    if (checks <= 0) {
+        fprintf(stderr, "usage: %s [checks]\n", argv[0]);
+        return 2;
+    }
+    esp_log_level_set("*", ESP_LOG_ERROR);
+
+    const scenario_t scenarios[] = {
+        {"adf-dma direct", 3, 300, false},
+        {"app-dma direct", 6, 512, false},
+        {"app-dma arbiter", 6, 512, true},
+    };
+    int ret = 0;
+    printf("%d FAT checks, %d Hz stereo, decoder %dx real time\n", checks, SAMPLE_RATE, DECODE_SPEED);
+    printf("%-16s %7s %9s %10s %12s %7s %9s %7s %9s\n", "scenario", "dma_ms", "underruns", "gap_ms",
+           "worst_off_ms", "waits", "wait_ms", "forced", "overruns");
+    for (int i = 0; i < sizeof(scenarios) / sizeof(scenarios[0]); i++) {
+        const scenario_t *sc = &scenarios[i];
+        flash_arbiter_stats_t stats;
+        i2s_sim_t i2s;
+        int64_t worst_us;
+        if (run(sc, checks, &stats, &i2s, &worst_us) != 0) {
+            fprintf(stderr, "%s: flash I/O failed\n", sc->name);
+            return 1;
+        }
+        printf("%-16s %7.1f %9u %10.1f %12.1f ", sc->name,
+               sc->dma_buf_count * sc->dma_buf_len * 1e3 / SAMPLE_RATE, i2s.underruns, i2s.underrun_us / 1e3,
+               worst_us / 1e3);
+        if (sc->arbitrated) {
+            printf("%7u %9.1f %7u %9u\n", stats.waits, stats.wait_us / 1e3, stats.forced, stats.overruns);
+            if (i2s.underruns || stats.overruns) {
+                fprintf(stderr, "%s: audio underran with the arbiter\n", sc->name);
+                ret = 1;
+            }
+        } else {
+            printf("%7s %9s %7s %9s\n", "-", "-", "-", "-");
+        }
+    }
+    return ret;
+}
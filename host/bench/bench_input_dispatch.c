@@ -0,0 +1,378 @@
+/* Key events to codec updates, the old if/else chain against input_dispatch
+
+   Replays a recorded stream of touch pad events (bench/input_events.txt) on
+   the simulated clock, twice, with the real new_codec driver on the mock
+   I2C bus behind audio_hal:
+   - chain: what app_main did before, one audio_hal_set_volume() for every
+     Vol+/Vol- tap, every Play tap toggles, long presses are ignored;
+   - dispatch: the bindings app_main builds with player_input_bindings(),
+     coalesced volume bursts (the first press at once, the rest together),
+     debounced Play and Mode, and a held Vol+/Vol- stepping until its long
+     release. Volume actions are timed from the first press they stand for.
+   The stream's "expect" lines state what the dispatch run must show by
+   their time: volume, hal_volume (audio_hal_set_volume() calls), play,
+   mode, quit.
+
+   Checks, exit status 1 if any fails:
+   - every expect line of the stream holds;
+   - the first Vol+/Vol- press after INPUT_COALESCE_MS without one acts
+     from input_dispatch_event(), not after the window;
+   - the dispatcher makes fewer audio_hal_set_volume() calls and I2C
+     transactions than the chain;
+   - nothing is left pending once the stream ends.
+
+   Usage: bench_input_dispatch [events.txt]
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "board.h"
+#include "i2c_mock.h"
+#include "input_dispatch.h"
+
+#ifndef BENCH_INPUT_EVENTS
+#define BENCH_INPUT_EVENTS "input_events.txt"
+#endif
+
+#define MAX_EVENTS          256
+
+/* esp_peripherals' ids and commands; tap, press and the ADC button press share a value, as do the long ones */
+#define PERIPH_ID_BUTTON    0x20001
+#define PERIPH_ID_TOUCH     0x20002
+#define PERIPH_ID_ADC_BTN   0x2000c
+#define CMD_PRESS           1
+#define CMD_RELEASE         2
+#define CMD_LONG_PRESS      3
+#define CMD_LONG_RELEASE    4
+
+/* as app_main */
+#define INPUT_VOLUME_STEP   10
+#define INPUT_COALESCE_MS   200
+#define INPUT_REPEAT_MS     300
+#define INPUT_DEBOUNCE_MS   250
+
+typedef enum {
+    EXPECT_NONE,
+    EXPECT_VOLUME,
+    EXPECT_HAL_VOLUME,
+    EXPECT_PLAY,
+    EXPECT_MODE,
+    EXPECT_QUIT,
+} expect_t;
+
+typedef struct {
+    int ms;
+    int source;
+    int cmd;
+    int key;
+    expect_t expect;
+    int value;
+} event_t;
+
+typedef struct {
+    audio_hal_handle_t hal;
+    input_dispatch_handle_t disp;
+    int volume;
+    int hal_calls;
+    int plays;
+    int modes;
+    bool quit;
+    int volume_actions;
+    int64_t delay_sum_us;   // volume actions, from the first press they stand for
+    int64_t delay_max_us;
+} player_t;
+
+typedef struct {
+    const char *name;
+    int value;
+} name_value_t;
+
+static const name_value_t sources[] = {{"touch", PERIPH_ID_TOUCH}, {"button", PERIPH_ID_BUTTON}, {"adc", PERIPH_ID_ADC_BTN}},
+  cmds[] = {{"tap", CMD_PRESS}, {"press", CMD_PRESS}, {"release", CMD_RELEASE}, {"long_tap", CMD_LONG_PRESS},
+            {"long_press", CMD_LONG_PRESS}, {"long_release", CMD_LONG_RELEASE}},
+  expects[] = {{"volume", EXPECT_VOLUME}, {"hal_volume", EXPECT_HAL_VOLUME}, {"play", EXPECT_PLAY},
+               {"mode", EXPECT_MODE}, {"quit", EXPECT_QUIT}};
+
+#define LOOKUP(table, name) lookup(table, sizeof(table) / sizeof(table[0]), name)
+
+static int lookup(const name_value_t *t, int n, const char *name) {
+    for (int i = 0; i < n; i++) {
+        if (!strcmp(t[i].name, name)) {
+            return t[i].value;
+        }
+    }
+    return -1;
+}
+
+static int key_id(const char *name) {
+    if (!strcmp(name, "play")) {
+        return get_input_play_id();
+    } else if (!strcmp(name, "set")) {
+        return get_input_set_id();
+    } else if (!strcmp(name, "mode")) {
+        return get_input_mode_id();
+    } else if (!strcmp(name, "vol+")) {
+        return get_input_volup_id();
+    } else if (!strcmp(name, "vol-")) {
+        return get_input_voldown_id();
+    } else if (!strcmp(name, "mute")) {
+        return get_input_mute_id();
+    }
+    return -1;
+}
+
+static int load_events(const char *path, event_t *ev, int max) {
+    FILE *f = fopen(path, "r");
+    if (!f) {
+        fprintf(stderr, "cannot open %s\n", path);
+        return -1;
+    }
+    char line[256];
+    int n = 0;
+    for (int lineno = 1; fgets(line, sizeof(line), f); lineno++) {
+        char a[32], b[32], c[32];
+        int ms;
+        if (line[0] == '#' || sscanf(line, "%d %31s %31s %31s", &ms, a, b, c) != 4) {
+            continue;
+        }
+        if (n == max) {
+            fprintf(stderr, "%s: more than %d events\n", path, max);
+            break;
+        }
+        event_t *e = &ev[n];
+        memset(e, 0, sizeof(*e));
+        e->ms = ms;
+        if (!strcmp(a, "expect")) {
+            e->expect = LOOKUP(expects, b);
+            e->value = atoi(c);
+        } else {
+            e->source = LOOKUP(sources, a);
+            e->cmd = LOOKUP(cmds, b);
+            e->key = key_id(c);
+        }
+        if (e->expect < 0 || e->source < 0 || e->cmd < 0 || e->key < 0) {
+            fprintf(stderr, "%s:%d: cannot parse %s", path, lineno, line);
+            fclose(f);
+            return -1;
+        }
+        n++;
+    }
+    fclose(f);
+    return n;
+}
+
+static void set_volume(player_t *p, int volume) {
+    volume = volume < 0 ? 0 : volume > 100 ? 100 : volume;
+    if (volume != p->volume) {
+        p->volume = volume;
+        p->hal_calls++;
+        audio_hal_set_volume(p->hal, volume);
+    }
+}
+
+static void on_play(void *ctx, int arg, int count) {
+    ((player_t *)ctx)->plays++;
+}
+
+static void on_set(void *ctx, int arg, int count) {
+    ((player_t *)ctx)->quit = true;
+}
+
+static void on_mode(void *ctx, int arg, int count) {
+    ((player_t *)ctx)->modes++;
+}
+
+static void on_volume(void *ctx, int arg, int count) {
+    player_t *p = (player_t *)ctx;
+    int64_t delay = esp_timer_get_time() - input_dispatch_get_action_since(p->disp);
+    p->volume_actions++;
+    p->delay_sum_us += delay;
+    p->delay_max_us = delay > p->delay_max_us ? delay : p->delay_max_us;
+    set_volume(p, p->volume + arg);
+}
+
+/**
+ * @brief The bindings of app_main's player_input_bindings(), for the touch pads only
+ */
+static int player_input_bindings(input_binding_t *b) {
+    int src = PERIPH_ID_TOUCH;
+    const input_binding_t keys[] = {
+        {src, CMD_PRESS, get_input_play_id(), on_play, 0, INPUT_DEBOUNCE_MS},
+        {src, CMD_PRESS, get_input_set_id(), on_set, 0},
+        {src, CMD_PRESS, get_input_mode_id(), on_mode, 0, INPUT_DEBOUNCE_MS},
+        {src, CMD_PRESS, get_input_volup_id(), on_volume, INPUT_VOLUME_STEP, 0, INPUT_COALESCE_MS},
+        {src, CMD_PRESS, get_input_voldown_id(), on_volume, -INPUT_VOLUME_STEP, 0, INPUT_COALESCE_MS},
+        {src, CMD_LONG_PRESS, get_input_volup_id(), on_volume, INPUT_VOLUME_STEP, 0, INPUT_COALESCE_MS,
+         INPUT_REPEAT_MS, CMD_LONG_RELEASE},
+        {src, CMD_LONG_PRESS, get_input_voldown_id(), on_volume, -INPUT_VOLUME_STEP, 0, INPUT_COALESCE_MS,
+         INPUT_REPEAT_MS, CMD_LONG_RELEASE},
+    };
+    memcpy(b, keys, sizeof(keys));
+    return sizeof(keys) / sizeof(keys[0]);
+}
+
+/**
+ * @brief The old event loop: every press acts at once
+ */
+static void chain_event(player_t *p, const event_t *e) {
+    if (e->cmd != CMD_PRESS) {
+        return;
+    }
+    if (e->key == get_input_play_id()) {
+        p->plays++;
+    } else if (e->key == get_input_set_id()) {
+        p->quit = true;
+    } else if (e->key == get_input_mode_id()) {
+        p->modes++;
+    } else if (e->key == get_input_volup_id() || e->key == get_input_voldown_id()) {
+        // it called audio_hal_set_volume() at 100 and at 0 too
+        int volume = p->volume + (e->key == get_input_volup_id() ? INPUT_VOLUME_STEP : -INPUT_VOLUME_STEP);
+        p->volume = volume < 0 ? 0 : volume > 100 ? 100 : volume;
+        p->hal_calls++;
+        audio_hal_set_volume(p->hal, p->volume);
+    }
+}
+
+static int check(const player_t *p, const event_t *e) {
+    static const char *names[] = {"", "volume", "hal_volume", "play", "mode", "quit"};
+    int got = e->expect == EXPECT_VOLUME ? p->volume
+              : e->expect == EXPECT_HAL_VOLUME ? p->hal_calls
+              : e->expect == EXPECT_PLAY ? p->plays
+              : e->expect == EXPECT_MODE ? p->modes
+              : p->quit;
+    if (got != e->value) {
+        fprintf(stderr, "at %d ms: %s is %d, expected %d\n", e->ms, names[e->expect], got, e->value);
+        return 1;
+    }
+    return 0;
+}
+
+static void advance_to(int64_t t0, int ms) {
+    int64_t now = esp_timer_get_time();
+    int64_t at = t0 + ms * 1000LL;
+    if (at > now) {
+        esp_timer_host_advance(at - now);
+    }
+}
+
+/**
+ * @brief Replay the stream; with disp, as the dispatch loop of app_main waits for events and deadlines
+ * @return checks failed
+ */
+static int replay(player_t *p, input_dispatch_handle_t disp, const event_t *ev, int n) {
+    int64_t t0 = esp_timer_get_time();
+    int failed = 0;
+    int last_volume_ms = -INPUT_COALESCE_MS;
+    for (int i = 0; i < n;) {
+        if (disp && !p->quit) {
+            int wait_ms = input_dispatch_poll(disp);
+            int64_t now_ms = (esp_timer_get_time() - t0) / 1000;
+            if (wait_ms >= 0 && now_ms + wait_ms < ev[i].ms) {
+                advance_to(t0, now_ms + wait_ms);
+                continue;
+            }
+        }
+        advance_to(t0, ev[i].ms);
+        const event_t *e = &ev[i++];
+        if (e->expect == EXPECT_NONE) {
+            // the loop is left at once on [Set]
+            if (p->quit) {
+                continue;
+            }
+            if (disp) {
+                bool volume = (e->cmd == CMD_PRESS || e->cmd == CMD_LONG_PRESS)
+                              && (e->key == get_input_volup_id() || e->key == get_input_voldown_id());
+                bool first = volume && e->ms - last_volume_ms >= INPUT_COALESCE_MS;
+                int actions = p->volume_actions;
+                input_dispatch_event(disp, e->source, e->cmd, e->key);
+                if (first && p->volume_actions == actions) {
+                    fprintf(stderr, "at %d ms: the first press of a volume burst did not act at once\n", e->ms);
+                    failed++;
+                }
+                last_volume_ms = volume ? e->ms : last_volume_ms;
+            } else {
+                chain_event(p, e);
+            }
+        } else if (disp) {
+            input_dispatch_poll(disp);
+            failed += check(p, e);
+        }
+    }
+    if (disp && input_dispatch_poll(disp) >= 0) {
+        fprintf(stderr, "actions still pending after the stream\n");
+        failed++;
+    }
+    return failed;
+}
+
+int main(int argc, char *argv[]) {
+    esp_log_level_set("*", ESP_LOG_ERROR);
+    const char *path = argc > 1 ? argv[1] : BENCH_INPUT_EVENTS;
+    static event_t ev[MAX_EVENTS];
+    int n = load_events(path, ev, MAX_EVENTS);
+    if (n <= 0) {
+        return 1;
+    }
+    audio_board_handle_t board = audio_board_init();
+    if (!board) {
+        fprintf(stderr, "codec init failed\n");
+        return 1;
+    }
+    audio_hal_ctrl_codec(board->audio_hal, AUDIO_HAL_CODEC_MODE_BOTH, AUDIO_HAL_CTRL_START);
+    int start_volume;
+    audio_hal_get_volume(board->audio_hal, &start_volume);
+
+    player_t chain = {.hal = board->audio_hal, .volume = start_volume};
+    i2c_mock_reset_stats();
+    replay(&chain, NULL, ev, n);
+    i2c_mock_stats_t chain_bus;
+    i2c_mock_get_stats(&chain_bus);
+
+    audio_hal_set_volume(board->audio_hal, start_volume);
+    player_t dispatch = {.hal = board->audio_hal, .volume = start_volume};
+    input_binding_t bindings[INPUT_DISPATCH_MAX_BINDINGS];
+    input_dispatch_cfg_t cfg = {
+        .bindings = bindings,
+        .num_bindings = player_input_bindings(bindings),
+        .ctx = &dispatch,
+    };
+    input_dispatch_handle_t disp = input_dispatch_create(&cfg);
+    if (!disp) {
+        return 1;
+    }
+    dispatch.disp = disp;
+    i2c_mock_reset_stats();
+    int failed = replay(&dispatch, disp, ev, n);
+    i2c_mock_stats_t dispatch_bus;
+    i2c_mock_get_stats(&dispatch_bus);
+    input_dispatch_stats_t stats;
+    input_dispatch_get_stats(disp, &stats);
+    input_dispatch_destroy(disp);
+
+    int events = 0;
+    for (int i = 0; i < n; i++) {
+        events += ev[i].expect == EXPECT_NONE;
+    }
+    printf("%d key events from %s\n", events, path);
+    printf("%-10s %8s %10s %8s %6s %6s %6s\n", "", "volume", "set_volume", "i2c_txn", "bus_us", "plays", "modes");
+    printf("%-10s %8d %10d %8d %6.0f %6d %6d\n", "chain", chain.volume, chain.hal_calls, chain_bus.transactions,
+           i2c_mock_bus_us(&chain_bus), chain.plays, chain.modes);
+    printf("%-10s %8d %10d %8d %6.0f %6d %6d\n", "dispatch", dispatch.volume, dispatch.hal_calls,
+           dispatch_bus.transactions, i2c_mock_bus_us(&dispatch_bus), dispatch.plays, dispatch.modes);
+    printf("dispatch: %u actions, %u coalesced, %u debounced, %u repeats, %u unbound\n", stats.actions,
+           stats.coalesced, stats.debounced, stats.repeats, stats.unbound);
+    printf("volume: %d actions, %.1f ms avg and %.1f ms max from the first press each stands for\n",
+           dispatch.volume_actions, dispatch.volume_actions ? dispatch.delay_sum_us / 1e3 / dispatch.volume_actions : 0,
+           dispatch.delay_max_us / 1e3);
+
+    if (dispatch.hal_calls >= chain.hal_calls || dispatch_bus.transactions >= chain_bus.transactions) {
+        fprintf(stderr, "dispatch: %d set_volume calls and %d transactions, chain %d and %d\n", dispatch.hal_calls,
+                dispatch_bus.transactions, chain.hal_calls, chain_bus.transactions);
+        failed++;
+    }
+    printf("%s\n", failed ? "FAILED" : "OK");
+    return failed ? 1 : 0;
+}
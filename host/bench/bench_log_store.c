@@ -0,0 +1,304 @@
+/* Play log records through log_store on a simulated raw partition, and power cut at random points
+
+   The flash model is the 64 KiB playlog partition as NOR flash: a program
+   can only clear bits, an erase sets a 4 KiB sector to 0xFF. A sector
+   erase takes 45 ms, programming 2.8 ms per KiB and reading 50 us per KiB,
+   on the simulated clock. Records are 8 bytes, as play_log_track_t.
+
+   - append: records/s of the host CPU and flash bytes programmed, sectors
+     erased and flash time per record, the RAM batch of 4 pages as the app
+     has it, one page per batch, and a sync after every record; against a
+     model of appending each record to a file through FAT (fopen("a"),
+     fwrite, fclose: the data and directory sectors erased and written,
+     the FAT sector for every new cluster).
+   - read back: records/s of the iterator over the full log.
+   - power loss: 300 power cuts at a random flash operation, which is left
+     half done (a program stops part way, an erase leaves part of the
+     sector). The partition starts as random bytes, a foreign one. After
+     each cut the log is opened again.
+
+   Checks, exit status 1 if any fails:
+   - after every cut the records read back are whole and consecutive, and
+     include every record synced before it;
+   - batched, a record costs no more flash bytes than its share of a page;
+   - the iterator returns the newest records, consecutive, after wrapping.
+
+   Usage: bench_log_store [records]
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "log_store.h"
+#include "bench_clock.h"
+
+#define PARTITION_SIZE      (64 * 1024)
+#define SECTOR_SIZE         4096
+#define PAGE_SIZE           256
+#define RECORD_LEN          8
+#define ERASE_US            45000
+#define PROGRAM_US_PER_KIB  2800
+#define READ_US_PER_KIB     50
+#define CUTS                300
+
+typedef struct {
+    uint8_t data[PARTITION_SIZE];
+    uint64_t programmed;
+    uint32_t erases;
+    int64_t busy_us;
+    uint32_t ops;
+    uint32_t cut_at_op;     // 0: no power cut
+    bool dead;
+    uint32_t seed;
+} flash_sim_t;
+
+static flash_sim_t flash;
+
+static uint32_t rnd(uint32_t *seed) {
+    *seed = *seed * 1103515245 + 12345;
+    return *seed >> 8;
+}
+
+static void busy(flash_sim_t *f, int64_t us) {
+    f->busy_us += us;
+    esp_timer_host_advance(us);
+}
+
+static esp_err_t flash_io(flash_op_t op, size_t addr, void *buf, size_t size, void *ctx) {
+    flash_sim_t *f = (flash_sim_t *)ctx;
+    if (addr + size > PARTITION_SIZE) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    if (f->dead) {
+        return ESP_FAIL;
+    }
+    if (op == FLASH_OP_READ) {
+        busy(f, 20 + (int64_t)size * READ_US_PER_KIB / 1024);
+        memcpy(buf, f->data + addr, size);
+        return ESP_OK;
+    }
+    size_t len = size;
+    bool cut = f->cut_at_op && ++f->ops == f->cut_at_op;
+    if (cut) {
+        // the power goes part way through
+        len = rnd(&f->seed) % size;
+        f->dead = true;
+    }
+    if (op == FLASH_OP_ERASE) {
+        memset(f->data + addr, 0xFF, len);
+        f->erases++;
+        busy(f, ERASE_US);
+    } else {
+        const uint8_t *src = (const uint8_t *)buf;
+        for (size_t i = 0; i < len; i++) {
+            f->data[addr + i] &= src[i];
+        }
+        f->programmed += len;
+        busy(f, 20 + (int64_t)size * PROGRAM_US_PER_KIB / 1024);
+    }
+    return cut ? ESP_FAIL : ESP_OK;
+}
+
+static log_store_handle_t open_log(int batch_pages) {
+    log_store_cfg_t cfg = LOG_STORE_CFG_DEFAULT();
+    cfg.size = PARTITION_SIZE;
+    cfg.sector_size = SECTOR_SIZE;
+    cfg.page_size = PAGE_SIZE;
+    cfg.batch_pages = batch_pages;
+    cfg.io = flash_io;
+    cfg.io_ctx = &flash;
+    return log_store_open(&cfg);
+}
+
+/**
+ * @brief Record n: its serial and a frame derived from it
+ */
+static void make_record(uint32_t n, uint8_t *rec) {
+    uint32_t frame = n * 2654435761u;
+    memcpy(rec, &n, 4);
+    memcpy(rec + 4, &frame, 4);
+}
+
+static uint8_t record_type(uint32_t n) {
+    return 1 + n % 3;
+}
+
+typedef struct {
+    uint32_t count;
+    uint32_t first;
+    uint32_t last;
+    bool broken;            // a record that is not one written, or out of order
+} readback_t;
+
+static readback_t read_back(log_store_handle_t ls) {
+    readback_t rb = {0};
+    log_store_iter_handle_t it = log_store_iter_create(ls);
+    log_record_t rec;
+    while (it && log_store_iter_next(it, &rec) == ESP_OK) {
+        uint32_t n;
+        uint8_t want[RECORD_LEN];
+        if (rec.len != RECORD_LEN) {
+            rb.broken = true;
+            break;
+        }
+        memcpy(&n, rec.data, 4);
+        make_record(n, want);
+        if (rec.type != record_type(n) || memcmp(rec.data, want, RECORD_LEN) || (rb.count && n != rb.last + 1)) {
+            rb.broken = true;
+            break;
+        }
+        if (!rb.count) {
+            rb.first = n;
+        }
+        rb.last = n;
+        rb.count++;
+    }
+    log_store_iter_destroy(it);
+    return rb;
+}
+
+typedef struct {
+    const char *name;
+    int batch_pages;
+    bool sync_each;
+} append_mode_t;
+
+static int bench_append(const append_mode_t *m, int records, bool *failed) {
+    memset(&flash, 0, sizeof(flash));
+    memset(flash.data, 0xFF, sizeof(flash.data));
+    flash.seed = 1;
+    log_store_handle_t ls = open_log(m->batch_pages);
+    if (!ls) {
+        *failed = true;
+        return -1;
+    }
+    uint8_t rec[RECORD_LEN];
+    uint64_t t0 = bench_now_ns();
+    for (int n = 0; n < records; n++) {
+        make_record(n, rec);
+        if (log_store_append(ls, record_type(n), rec, RECORD_LEN) != ESP_OK
+            || (m->sync_each && log_store_sync(ls) != ESP_OK)) {
+            *failed = true;
+        }
+    }
+    log_store_sync(ls);
+    uint64_t ns = bench_now_ns() - t0;
+    double per_page = (PAGE_SIZE - 12) / (2 + RECORD_LEN);
+    double bytes = (double)flash.programmed / records;
+    printf("%-22s %12.0f %10.1f %12.2f %12.1f\n", m->name, records * 1e9 / (ns ? ns : 1), bytes,
+           flash.erases * 1000.0 / records, flash.busy_us / (double)records);
+    if (!m->sync_each && bytes > (double)PAGE_SIZE / (int)per_page * 1.02) {
+        fprintf(stderr, "%s: %.1f flash bytes a record, a page holds %d records\n", m->name, bytes, (int)per_page);
+        *failed = true;
+    }
+    // the log wrapped many times: the newest records, consecutive, up to the last
+    uint64_t r0 = bench_now_ns();
+    readback_t rb = read_back(ls);
+    uint64_t rns = bench_now_ns() - r0;
+    if (rb.broken || rb.last != records - 1 || rb.count < PARTITION_SIZE / PAGE_SIZE / 2) {
+        fprintf(stderr, "%s: read back %u records %u..%u%s\n", m->name, rb.count, rb.first, rb.last,
+                rb.broken ? ", broken" : "");
+        *failed = true;
+    }
+    log_store_close(ls);
+    return (int)(rb.count * 1e9 / (rns ? rns : 1));
+}
+
+static void bench_power_loss(bool *failed) {
+    flash_sim_t *f = &flash;
+    memset(f, 0, sizeof(*f));
+    f->seed = 7;
+    for (int i = 0; i < PARTITION_SIZE; i++) {
+        f->data[i] = rnd(&f->seed);
+    }
+    uint32_t next = 0, synced = 0, lost = 0, torn = 0, recovered_max = 0;
+    bool any_synced = false;
+    int violations = 0;
+    for (int cut = 0; cut <= CUTS; cut++) {
+        f->dead = false;
+        f->cut_at_op = 0;
+        log_store_handle_t ls = open_log(4);
+        if (!ls) {
+            fprintf(stderr, "power loss: open failed after cut %d\n", cut);
+            *failed = true;
+            return;
+        }
+        log_store_stats_t s;
+        log_store_get_stats(ls, &s);
+        torn += s.torn;
+        readback_t rb = read_back(ls);
+        if (rb.broken || (any_synced && (!rb.count || rb.last < synced))) {
+            fprintf(stderr, "cut %d: read back %u records %u..%u%s, %u synced\n", cut, rb.count, rb.first, rb.last,
+                    rb.broken ? ", broken" : "", synced);
+            violations++;
+        }
+        if (rb.count) {
+            lost += next - 1 - rb.last;
+            next = rb.last + 1;
+            recovered_max = rb.count > recovered_max ? rb.count : recovered_max;
+        } else {
+            next = 0;
+        }
+        if (cut == CUTS) {
+            log_store_close(ls);
+            break;
+        }
+        // run until the power goes, syncing now and then
+        f->ops = 0;
+        f->cut_at_op = 1 + rnd(&f->seed) % 40;
+        uint8_t rec[RECORD_LEN];
+        while (!f->dead) {
+            make_record(next, rec);
+            if (log_store_append(ls, record_type(next), rec, RECORD_LEN) != ESP_OK) {
+                break;
+            }
+            next++;
+            if (rnd(&f->seed) % 50 == 0 && log_store_sync(ls) == ESP_OK) {
+                synced = next - 1;
+                any_synced = true;
+            }
+        }
+        log_store_close(ls);
+    }
+    printf("\n%d power cuts: %d violations, %u torn pages skipped over the opens, %u unsynced records lost, up to %u records "
+           "held\n", CUTS, violations, torn, lost, recovered_max);
+    if (violations) {
+        *failed = true;
+    }
+}
+
+int main(int argc, char *argv[]) {
+    int records = argc > 1 ? atoi(argv[1]) : 200000;
+    if (records <= 0) {
+        fprintf(stderr, "usage: %s [records]\n", argv[0]);
+        return 2;
+    }
+    esp_log_level_set("*", ESP_LOG_NONE);
+    static const append_mode_t modes[] = {
+        {"batch of 4 pages", 4, false},
+        {"batch of 1 page", 1, false},
+        {"sync every record", 1, true},
+    };
+    bool failed = false;
+
+    printf("%d records of %d bytes, %d KiB partition\n", records, RECORD_LEN, PARTITION_SIZE / 1024);
+    printf("%-22s %12s %10s %12s %12s\n", "append", "records/s", "bytes/rec", "erases/1000", "flash_us/rec");
+    int read_rate = 0;
+    for (int i = 0; i < sizeof(modes) / sizeof(modes[0]); i++) {
+        int rate = bench_append(&modes[i], i == 2 ? records / 10 : records, &failed);
+        read_rate = i == 0 ? rate : read_rate;
+    }
+    // fopen("a"), fwrite, fclose: data and directory sector, FAT sector once per 4 KiB cluster
+    double fat_bytes = 2 * SECTOR_SIZE + (double)SECTOR_SIZE * RECORD_LEN / SECTOR_SIZE;
+    double fat_erases = 2 + (double)RECORD_LEN / SECTOR_SIZE;
+    printf("%-22s %12s %10.1f %12.2f %12.1f\n", "FAT append (model)", "-", fat_bytes, fat_erases * 1000,
+           fat_erases * ERASE_US + fat_bytes * PROGRAM_US_PER_KIB / 1024);
+    printf("\nread back: %d records/s\n", read_rate);
+
+    bench_power_loss(&failed);
+    printf("%s\n", failed ? "FAILED" : "OK");
+    return failed;
+}
@@ -0,0 +1,217 @@
+/* Memory placement of the player pipeline
+
+   player_pipeline_create() builds playlist -> mp3 -> resampler -> gain ->
+   sink under a placement policy, the sink created in the "i2s" scope as
+   app_main creates the i2s stream. The host heap has one region, so what is
+   checked is the attribution: every element's output ring buffer, work
+   memory and task stack is counted, and only, in the region its rule asks
+   for. The same report app_main logs once playing is printed.
+
+   Checks, exit status 1 if any fails:
+   - without a policy nothing is tracked;
+   - the ring buffers land with the element they are the output of, also
+     when an element in between has no rule;
+   - work memory and stacks are where the rules ask, stacks at their size;
+   - everything but the stacks is released by player_pipeline_destroy().
+
+   Usage: bench_mem_placement
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include "esp_log.h"
+#include "mp3_decoder.h"
+#include "pcm_sink.h"
+#include "music_assets.h"
+#include "player_pipeline.h"
+#include "playlist.h"
+#include "resample.h"
+#include "sw_gain.h"
+#include "mem_placement.h"
+
+#define RATE            44100
+#define SINK_STACK      (3 * 1024)
+
+static const char *region_name[MEM_REGION_MAX] = {"any", "internal", "dma", "psram"};
+static const char *kind_name[MEM_KIND_MAX] = {"ringbuf", "work", "stack"};
+
+static const mem_placement_rule_t all_rules[] = {
+    {.tag = "mp3", .ringbuf = MEM_REGION_PSRAM, .work = MEM_REGION_INTERNAL, .stack = MEM_REGION_INTERNAL},
+    {.tag = "resample", .ringbuf = MEM_REGION_DMA, .work = MEM_REGION_PSRAM, .stack = MEM_REGION_PSRAM},
+    {.tag = "gain", .ringbuf = MEM_REGION_INTERNAL, .work = MEM_REGION_PSRAM, .stack = MEM_REGION_ANY},
+    {.tag = "i2s", .ringbuf = MEM_REGION_ANY, .work = MEM_REGION_DMA, .stack = MEM_REGION_INTERNAL},
+};
+
+// the resampler has no rule, the gain still gets its own ring buffer
+static const mem_placement_rule_t gap_rules[] = {
+    {.tag = "mp3", .ringbuf = MEM_REGION_PSRAM, .work = MEM_REGION_INTERNAL, .stack = MEM_REGION_INTERNAL},
+    {.tag = "gain", .ringbuf = MEM_REGION_DMA, .work = MEM_REGION_INTERNAL, .stack = MEM_REGION_PSRAM},
+};
+
+static int failed;
+
+typedef struct {
+    player_pipeline_t player;
+    playlist_handle_t playlist;
+} session_t;
+
+static int create(session_t *s) {
+    playlist_cfg_t playlist_cfg = PLAYLIST_CFG_DEFAULT();
+    s->playlist = playlist_create(music_assets, music_assets_count, &playlist_cfg);
+    // as app_main does for the i2s stream
+    mem_placement_stack_in_ext("i2s", SINK_STACK, false);
+    mem_placement_begin("i2s", MEM_KIND_WORK);
+    pcm_sink_cfg_t sink_cfg = PCM_SINK_CFG_DEFAULT();
+    audio_element_handle_t sink = pcm_sink_init(&sink_cfg);
+    mem_placement_end();
+    player_pipeline_cfg_t player_cfg = PLAYER_PIPELINE_CFG_DEFAULT();
+    player_cfg.read_cb = playlist_read_cb;
+    player_cfg.read_ctx = s->playlist;
+    player_cfg.output_rate = RATE;
+    player_cfg.soft_volume = true;
+    if (!s->playlist || player_pipeline_create(&s->player, &player_cfg, sink) != ESP_OK) {
+        fprintf(stderr, "pipeline not created\n");
+        return -1;
+    }
+    return 0;
+}
+
+static void destroy(session_t *s) {
+    player_pipeline_stop(&s->player);
+    player_pipeline_destroy(&s->player);
+    playlist_destroy(s->playlist);
+}
+
+static mem_region_t rule_region(const mem_placement_rule_t *rule, mem_kind_t kind) {
+    switch (kind) {
+        case MEM_KIND_RINGBUF:
+            return rule->ringbuf;
+        case MEM_KIND_STACK:
+            return rule->stack;
+        default:
+            return rule->work;
+    }
+}
+
+/**
+ * @brief Print the usage of each rule's element and check it landed as the rule asks
+ *
+ * @param stacks Task stack of each rule, 0 for none
+ * @param ringbufs Whether each rule's element has an output ring buffer
+ */
+static void check(const char *what, const mem_placement_rule_t *rules, int n, const int *stacks,
+                  const bool *ringbufs) {
+    printf("%s\n%-10s %-8s %-9s %9s %9s %9s\n", what, "element", "kind", "wanted", "internal", "dma", "psram");
+    for (int r = 0; r < n; r++) {
+        mem_placement_usage_t u;
+        if (mem_placement_get_usage(rules[r].tag, &u) != ESP_OK) {
+            fprintf(stderr, "%s: no usage for %s\n", what, rules[r].tag);
+            failed = 1;
+            continue;
+        }
+        for (int k = 0; k < MEM_KIND_MAX; k++) {
+            mem_region_t want = rule_region(&rules[r], k);
+            // with MEM_REGION_ANY audio_malloc() decides, internal on the host
+            mem_region_t land = want == MEM_REGION_ANY ? MEM_REGION_INTERNAL : want;
+            if (k == MEM_KIND_STACK && want == MEM_REGION_ANY) {
+                // the element's default config, stack_in_ext
+                land = MEM_REGION_PSRAM;
+            }
+            printf("%-10s %-8s %-9s %9u %9u %9u\n", rules[r].tag, kind_name[k], region_name[want],
+                   (unsigned)(u.bytes[k][MEM_REGION_INTERNAL] + u.bytes[k][MEM_REGION_ANY]),
+                   (unsigned)u.bytes[k][MEM_REGION_DMA], (unsigned)u.bytes[k][MEM_REGION_PSRAM]);
+            for (int g = 0; g < MEM_REGION_MAX; g++) {
+                if (g != land && g != want && u.bytes[k][g]) {
+                    fprintf(stderr, "%s: %s %s has %u bytes in %s, wanted %s\n", what, rules[r].tag, kind_name[k],
+                            (unsigned)u.bytes[k][g], region_name[g], region_name[want]);
+                    failed = 1;
+                }
+            }
+            size_t got = u.bytes[k][land] + (want != land ? u.bytes[k][want] : 0);
+            bool ok;
+            if (k == MEM_KIND_RINGBUF) {
+                ok = ringbufs[r] ? got >= DEFAULT_PIPELINE_RINGBUF_SIZE : got == 0;
+            } else if (k == MEM_KIND_STACK) {
+                ok = got == (size_t)stacks[r];
+            } else {
+                ok = got > 0;
+            }
+            if (!ok) {
+                fprintf(stderr, "%s: %s %s is %u bytes in %s\n", what, rules[r].tag, kind_name[k], (unsigned)got,
+                        region_name[land]);
+                failed = 1;
+            }
+        }
+        if (u.fallbacks) {
+            fprintf(stderr, "%s: %s had %d fallbacks\n", what, rules[r].tag, u.fallbacks);
+            failed = 1;
+        }
+    }
+}
+
+/**
+ * @brief After destroy only the recorded stacks may be left
+ */
+static void check_released(const char *what, const mem_placement_rule_t *rules, int n) {
+    for (int r = 0; r < n; r++) {
+        mem_placement_usage_t u;
+        mem_placement_get_usage(rules[r].tag, &u);
+        for (int k = 0; k < MEM_KIND_MAX; k++) {
+            for (int g = 0; g < MEM_REGION_MAX; g++) {
+                if (k != MEM_KIND_STACK && u.bytes[k][g]) {
+                    fprintf(stderr, "%s: %s %s still holds %u bytes in %s\n", what, rules[r].tag, kind_name[k],
+                            (unsigned)u.bytes[k][g], region_name[g]);
+                    failed = 1;
+                }
+            }
+        }
+    }
+}
+
+int main(int argc, char *argv[]) {
+    esp_log_level_set("*", ESP_LOG_ERROR);
+    session_t s;
+
+    // no policy: passthrough
+    mem_placement_init(NULL, 0);
+    if (create(&s) != 0) {
+        return 1;
+    }
+    mem_placement_usage_t u;
+    if (mem_placement_get_usage("mp3", &u) != ESP_ERR_NOT_FOUND) {
+        fprintf(stderr, "usage tracked without a policy\n");
+        failed = 1;
+    }
+    destroy(&s);
+
+    int n = sizeof(all_rules) / sizeof(all_rules[0]);
+    mem_placement_init(all_rules, n);
+    if (create(&s) != 0) {
+        return 1;
+    }
+    int stacks[] = {MP3_DECODER_TASK_STACK_SIZE, RESAMPLE_TASK_STACK_SIZE, SW_GAIN_TASK_STACK_SIZE, SINK_STACK};
+    bool ringbufs[] = {true, true, true, false};
+    check("every element with a rule", all_rules, n, stacks, ringbufs);
+    // the report app_main logs
+    fflush(stdout);
+    esp_log_level_set("*", ESP_LOG_INFO);
+    mem_placement_report();
+    esp_log_level_set("*", ESP_LOG_ERROR);
+    destroy(&s);
+    check_released("every element with a rule, destroyed", all_rules, n);
+    printf("\n");
+
+    n = sizeof(gap_rules) / sizeof(gap_rules[0]);
+    mem_placement_init(gap_rules, n);
+    if (create(&s) != 0) {
+        return 1;
+    }
+    int gap_stacks[] = {MP3_DECODER_TASK_STACK_SIZE, SW_GAIN_TASK_STACK_SIZE};
+    bool gap_ringbufs[] = {true, true};
+    check("resampler without a rule", gap_rules, n, gap_stacks, gap_ringbufs);
+    destroy(&s);
+    check_released("resampler without a rule, destroyed", gap_rules, n);
+
+    mem_placement_init(NULL, 0);
+    return failed;
+}
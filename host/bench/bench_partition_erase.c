@@ -0,0 +1,301 @@
+/* Erase of the 1 MB storage partition while audio plays: one blocking erase against partition_erase
+
+   A simulated flash holds the partition; a sector erase takes 45 ms and a
+   64 KiB block erase 150 ms, +-10 %, with the cache disabled, as
+   esp_partition_erase_range() erases blocks where it can. Meanwhile a
+   simulated i2s stream plays 44.1 kHz stereo from the app's DMA buffers
+   (6 x 512 frames), refilled by the i2s task from the ring buffer and the
+   decoder, which run only while no flash operation is in progress (see
+   bench_flash_arbiter).
+
+   Scenarios:
+   - blocking: eraseFATPartition() as it was, the whole partition in one
+     esp_partition_erase_range(), block after block;
+   - chunked, playing: partition_erase through the app's flash_arbiter with
+     the i2s headroom;
+   - chunked, idle: the same with no audio, the arbiter's idle windows are
+     whole blocks.
+
+   Checks, exit status 1 if any fails:
+   - every scenario leaves the whole partition erased;
+   - chunked while playing, audio never underruns and no window outlasts
+     its headroom;
+   - chunked and idle takes no longer than the blocking erase, +1 %;
+   - the ETA reported at 25, 50 and 75 % is within 15 % of the erase time
+     off the time the rest actually took.
+
+   Usage: bench_partition_erase
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "flash_arbiter.h"
+#include "partition_erase.h"
+
+#define PARTITION_SIZE  (1024 * 1024)
+#define SECTOR_SIZE     4096
+#define BLOCK_SIZE      (64 * 1024)
+#define SECTOR_ERASE_US 45000
+#define BLOCK_ERASE_US  150000
+#define SAMPLE_RATE     44100
+#define FRAME_BYTES     4
+#define RB_SIZE         (8 * 1024)      // player_pipeline's decoder -> i2s ring buffer
+#define DECODE_SPEED    5               // decoder throughput, multiple of real time
+#define DMA_BUF_COUNT   6
+#define DMA_BUF_LEN     512
+#define SIM_STEP_US     500
+
+/**
+ * @brief i2s DMA, ring buffer and decoder, advanced lazily to the simulated clock
+ */
+typedef struct {
+    bool playing;
+    double dma_frames;
+    double rb_frames;
+    int64_t t_us;
+    int64_t underrun_us;
+    uint32_t underruns;
+    bool starved;
+} i2s_sim_t;
+
+typedef struct {
+    i2s_sim_t *i2s;
+    uint32_t seed;
+    uint32_t ops;
+    int64_t worst_us;
+    uint8_t data[PARTITION_SIZE];
+} flash_sim_t;
+
+static void i2s_sim_refill(i2s_sim_t *s) {
+    double move = DMA_BUF_COUNT * DMA_BUF_LEN - s->dma_frames;
+    if (move > s->rb_frames) {
+        move = s->rb_frames;
+    }
+    s->dma_frames += move;
+    s->rb_frames -= move;
+}
+
+static void i2s_sim_run(i2s_sim_t *s, int64_t until, bool blocked) {
+    double rb_cap = RB_SIZE / FRAME_BYTES;
+    if (!s->playing) {
+        s->t_us = until;
+        return;
+    }
+    if (!blocked) {
+        i2s_sim_refill(s);
+    }
+    while (s->t_us < until) {
+        int64_t dt = until - s->t_us < SIM_STEP_US ? until - s->t_us : SIM_STEP_US;
+        double played = dt * (double)SAMPLE_RATE / 1e6;
+        if (!blocked) {
+            s->rb_frames += played * DECODE_SPEED;
+            if (s->rb_frames > rb_cap) {
+                s->rb_frames = rb_cap;
+            }
+            i2s_sim_refill(s);
+        }
+        s->dma_frames -= played;
+        if (s->dma_frames < 0) {
+            s->underrun_us += (int64_t)(-s->dma_frames * 1e6 / SAMPLE_RATE);
+            s->dma_frames = 0;
+            if (!s->starved) {
+                s->underruns++;
+            }
+            s->starved = true;
+        } else {
+            s->starved = false;
+        }
+        s->t_us += dt;
+    }
+}
+
+/**
+ * @brief app_main's i2s_headroom_us(), on the simulated ring buffer
+ */
+static int64_t sim_headroom_us(void *ctx) {
+    i2s_sim_t *s = (i2s_sim_t *)ctx;
+    i2s_sim_run(s, esp_timer_get_time(), false);
+    int64_t queued = (int64_t)s->rb_frames;
+    int64_t frames = (DMA_BUF_COUNT - 2) * DMA_BUF_LEN + (queued < DMA_BUF_LEN ? queued : DMA_BUF_LEN);
+    return frames * 1000000 / SAMPLE_RATE;
+}
+
+static int64_t jitter(flash_sim_t *f, int64_t us) {
+    f->seed = f->seed * 1103515245 + 12345;
+    return us * (1000 + (int)((f->seed >> 16) % 201) - 100) / 1000;
+}
+
+/**
+ * @brief esp_partition_erase_range(): blocks where aligned, sectors elsewhere, each with the cache disabled
+ */
+static esp_err_t flash_erase(flash_op_t op, size_t addr, void *buf, size_t size, void *ctx) {
+    flash_sim_t *f = (flash_sim_t *)ctx;
+    if (op != FLASH_OP_ERASE || addr + size > PARTITION_SIZE || addr % SECTOR_SIZE || size % SECTOR_SIZE) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    for (size_t at = addr; at < addr + size;) {
+        size_t len = at % BLOCK_SIZE == 0 && addr + size - at >= BLOCK_SIZE ? BLOCK_SIZE : SECTOR_SIZE;
+        int64_t us = jitter(f, len == BLOCK_SIZE ? BLOCK_ERASE_US : SECTOR_ERASE_US);
+        i2s_sim_run(f->i2s, esp_timer_get_time(), false);
+        i2s_sim_run(f->i2s, f->i2s->t_us + us, true);
+        esp_timer_host_advance(us);
+        if (us > f->worst_us) {
+            f->worst_us = us;
+        }
+        memset(f->data + at, 0xFF, len);
+        f->ops++;
+        at += len;
+    }
+    return ESP_OK;
+}
+
+#define ETA_POINTS 3
+
+typedef struct {
+    int64_t start_us;
+    int64_t at_us[ETA_POINTS];      // at 25, 50 and 75 %
+    int64_t eta_us[ETA_POINTS];
+} eta_log_t;
+
+static void on_progress(const partition_erase_progress_t *p, void *ctx) {
+    eta_log_t *log = (eta_log_t *)ctx;
+    for (int i = 0; i < ETA_POINTS; i++) {
+        if (!log->at_us[i] && p->done * 4 >= p->total * (i + 1)) {
+            log->at_us[i] = esp_timer_get_time();
+            log->eta_us[i] = p->eta_us;
+        }
+    }
+}
+
+typedef enum {
+    ERASE_BLOCKING,
+    ERASE_CHUNKED,
+} method_t;
+
+typedef struct {
+    const char *name;
+    method_t method;
+    bool playing;
+} scenario_t;
+
+typedef struct {
+    esp_err_t err;
+    int64_t us;
+    bool erased;
+    uint32_t ops;
+    int64_t worst_us;
+    i2s_sim_t i2s;
+    flash_arbiter_stats_t stats;
+    eta_log_t eta;
+} outcome_t;
+
+static void run(const scenario_t *sc, outcome_t *out) {
+    static flash_sim_t flash;
+    memset(&flash, 0, sizeof(flash));
+    memset(out, 0, sizeof(*out));
+    i2s_sim_t *i2s = &out->i2s;
+    *i2s = (i2s_sim_t) {
+        .playing = sc->playing,
+        .dma_frames = DMA_BUF_COUNT * DMA_BUF_LEN,
+        .rb_frames = RB_SIZE / FRAME_BYTES,
+        .t_us = esp_timer_get_time(),
+    };
+    flash.i2s = i2s;
+    flash.seed = 1;
+    memset(flash.data, 0x5A, sizeof(flash.data));
+
+    int64_t t0 = esp_timer_get_time();
+    if (sc->method == ERASE_BLOCKING) {
+        out->err = flash_erase(FLASH_OP_ERASE, 0, NULL, PARTITION_SIZE, &flash);
+    } else {
+        // as app_main creates it
+        flash_arbiter_cfg_t arb_cfg = FLASH_ARBITER_CFG_DEFAULT();
+        arb_cfg.unit_size = SECTOR_SIZE;
+        arb_cfg.idle_window_size = BLOCK_SIZE;
+        if (sc->playing) {
+            arb_cfg.headroom = sim_headroom_us;
+            arb_cfg.headroom_ctx = i2s;
+        }
+        flash_arbiter_handle_t arb = flash_arbiter_create(&arb_cfg);
+        partition_erase_cfg_t cfg = PARTITION_ERASE_CFG_DEFAULT();
+        cfg.arb = arb;
+        cfg.size = PARTITION_SIZE;
+        cfg.io = flash_erase;
+        cfg.io_ctx = &flash;
+        cfg.progress = on_progress;
+        cfg.progress_ctx = &out->eta;
+        partition_erase_handle_t pe = partition_erase_create(&cfg);
+        out->err = pe ? partition_erase_run(pe) : ESP_ERR_NO_MEM;
+        partition_erase_destroy(pe);
+        flash_arbiter_get_stats(arb, &out->stats);
+        flash_arbiter_destroy(arb);
+    }
+    out->us = esp_timer_get_time() - t0;
+    out->eta.start_us = t0;
+    // playback goes on after the erase
+    i2s_sim_run(i2s, esp_timer_get_time(), false);
+    out->erased = true;
+    for (int i = 0; i < PARTITION_SIZE; i++) {
+        out->erased &= flash.data[i] == 0xFF;
+    }
+    out->ops = flash.ops;
+    out->worst_us = flash.worst_us;
+}
+
+int main(int argc, char *argv[]) {
+    esp_log_level_set("*", ESP_LOG_ERROR);
+    static const scenario_t scenarios[] = {
+        {"blocking, playing", ERASE_BLOCKING, true},
+        {"chunked, playing", ERASE_CHUNKED, true},
+        {"blocking, idle", ERASE_BLOCKING, false},
+        {"chunked, idle", ERASE_CHUNKED, false},
+    };
+    const int n = sizeof(scenarios) / sizeof(scenarios[0]);
+    outcome_t out[sizeof(scenarios) / sizeof(scenarios[0])];
+    int failed = 0;
+
+    printf("%d KiB partition, %d Hz stereo, DMA %d x %d frames (%.1f ms)\n", PARTITION_SIZE / 1024, SAMPLE_RATE,
+           DMA_BUF_COUNT, DMA_BUF_LEN, DMA_BUF_COUNT * DMA_BUF_LEN * 1e3 / SAMPLE_RATE);
+    printf("%-18s %8s %6s %11s %9s %10s %8s %15s\n", "erase", "ms", "erases", "worst_off", "underruns", "silence_ms",
+           "waits", "eta_err 25/50/75");
+    for (int i = 0; i < n; i++) {
+        const scenario_t *sc = &scenarios[i];
+        outcome_t *o = &out[i];
+        run(sc, o);
+        printf("%-18s %8d %6u %11.1f %9u %10.1f %8u", sc->name, (int)(o->us / 1000), o->ops, o->worst_us / 1e3,
+               o->i2s.underruns, o->i2s.underrun_us / 1e3, o->stats.waits);
+        int64_t end_us = o->eta.start_us + o->us;
+        for (int k = 0; k < ETA_POINTS && sc->method == ERASE_CHUNKED; k++) {
+            int64_t err_us = o->eta.eta_us[k] - (end_us - o->eta.at_us[k]);
+            int pct = (int)(err_us * 100 / o->us);
+            printf("%s%d%%", k ? "/" : "   ", pct);
+            if (!o->eta.at_us[k] || pct > 15 || pct < -15) {
+                fprintf(stderr, "%s: ETA at %d%% off by %d ms of %d ms\n", sc->name, (k + 1) * 25,
+                        (int)(err_us / 1000), (int)(o->us / 1000));
+                failed = 1;
+            }
+        }
+        printf("\n");
+        if (o->err != ESP_OK || !o->erased) {
+            fprintf(stderr, "%s: %s, partition %s\n", sc->name, esp_err_to_name(o->err),
+                    o->erased ? "erased" : "not erased");
+            failed = 1;
+        }
+        if (sc->method == ERASE_CHUNKED && sc->playing && (o->i2s.underruns || o->stats.overruns)) {
+            fprintf(stderr, "%s: %u underruns, %u windows outlasted their headroom\n", sc->name, o->i2s.underruns,
+                    o->stats.overruns);
+            failed = 1;
+        }
+    }
+    if (out[3].us * 100 > out[2].us * 101) {
+        fprintf(stderr, "idle: chunked %d ms, blocking %d ms\n", (int)(out[3].us / 1000), (int)(out[2].us / 1000));
+        failed = 1;
+    }
+    printf("%s\n", failed ? "FAILED" : "OK");
+    return failed;
+}
@@ -0,0 +1,285 @@
+/* Decoder time saved by replaying cached PCM, and hit ratio per cache budget
+
+   Runs the playlist -> mp3 -> sink pipeline of app_main, with the latency
+   trace passing the decoder output to the PCM cache as app_main does, over
+   two track tables played once through:
+
+   loop   : the 8 kHz asset 20 times, a short loop
+   rotate : the three assets 5 times over
+   switch : the 8 kHz asset 10 times, then the 22 kHz one 10 times
+
+   with no cache and with a range of byte budgets, caching tracks of up to
+   2 MB. The decoder task's time is measured around its element steps,
+   replays included, and compared with the uncached run: the difference is
+   the decoder time the replays saved (saved_ms), and bypass% is the share
+   of the PCM that never went through the decoder. est_saved_ms is what the
+   cache itself reports, pcm_cache_stats_t.saved_us, timed from the decoder
+   output while recording. Times are host wall-clock; the stand-in decoder
+   (no libmpg123) only walks frames, so it is charged
+   STANDIN_DECODE_US_PER_KB of simulated time per KB of PCM it is handed.
+   The sink step's time is kept off the simulated clock, as the i2s writer
+   has a task of its own.
+
+   Checks, exit status 1 if any fails:
+   - every run hands out the same PCM as the uncached one and plays at
+     least as much of it;
+   - a loop that fits the budget only decodes its first pass; after the
+     switch the 22 kHz asset is kept too, evicting the 8 kHz one if it must;
+   - a larger budget never hits less often than a smaller one: a drop with
+     evictions is the policy thrashing, tracks evicting each other in turn;
+   - with hits, est_saved_ms is within SAVED_TOLERANCE_PCT of saved_ms.
+
+   Usage: bench_pcm_cache
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "audio_common.h"
+#include "pcm_sink.h"
+#include "mp3_decoder.h"
+#include "music_assets.h"
+#include "player_pipeline.h"
+#include "playlist.h"
+#include "latency_trace.h"
+#include "pcm_cache.h"
+#include "bench_clock.h"
+
+#define LOOP_PASSES     20
+#define ROTATE_PASSES   5
+#define SWITCH_PASSES   10
+#define MAX_TRACKS      32          // of the longest table
+
+#define MAX_TRACK_BYTES (2 * 1024 * 1024)
+// decoder time the stand-in is charged per KB of PCM of the frames it is handed: about an ESP32 decoding
+// 44.1 kHz stereo with 9% of a core
+#define STANDIN_DECODE_US_PER_KB    500
+#define SAVED_TOLERANCE_PCT         25      // of the cache's own estimate of the time saved from the measured
+
+typedef struct {
+    int64_t pcm_bytes;              // played by the sink
+    int64_t source_bytes;           // handed out by the playlist, replays included
+    double decoder_ms;
+    pcm_cache_stats_t cache;
+} run_result_t;
+
+typedef struct {
+    playlist_handle_t playlist;
+    pcm_cache_handle_t cache;
+    latency_trace_handle_t lt;
+    int us_per_kb;                  // charged to the decoder, 0 for none
+    int64_t charged_us;
+} source_ctx_t;
+
+static int64_t source_pos(void *ctx) {
+    return playlist_get_pcm_pos((playlist_handle_t)ctx);
+}
+
+/**
+ * @brief playlist_read_cb(), charging the stand-in decoder for the frames it is handed, replays excepted
+ */
+static int source_read_cb(audio_element_handle_t el, char *buf, int len, TickType_t wait_time, void *ctx) {
+    source_ctx_t *src = (source_ctx_t *)ctx;
+    pcm_cache_stats_t s0 = {0}, s1 = {0};
+    if (src->cache) {
+        pcm_cache_get_stats(src->cache, &s0);
+    }
+    int64_t pos = playlist_get_pcm_pos(src->playlist);
+    int ret = playlist_read_cb(el, buf, len, wait_time, src->playlist);
+    if (src->cache) {
+        pcm_cache_get_stats(src->cache, &s1);
+    }
+    int64_t frames = playlist_get_pcm_pos(src->playlist) - pos - (int64_t)(s1.replay_bytes - s0.replay_bytes);
+    int64_t us = frames * src->us_per_kb / 1024;
+    esp_timer_host_advance(us);
+    src->charged_us += us;
+    return ret;
+}
+
+/**
+ * @brief on_decoder_output() of app_main, the cache part
+ */
+static void on_decoder_output(void *ctx, int64_t pos, const char *buf, int len) {
+    source_ctx_t *src = (source_ctx_t *)ctx;
+    pcm_cache_decoder_output(src->cache, pos, buf, len, latency_trace_get_write_wait_us(src->lt));
+}
+
+/**
+ * @brief Play a track table once through, budget 0 for no cache
+ */
+static int run(const embed_asset_t *tracks, int num_tracks, size_t budget, run_result_t *res) {
+    pcm_cache_handle_t cache = NULL;
+    if (budget > 0) {
+        pcm_cache_cfg_t cache_cfg = PCM_CACHE_CFG_DEFAULT();
+        cache_cfg.budget_bytes = budget;
+        cache_cfg.max_track_bytes = MAX_TRACK_BYTES;
+        cache = pcm_cache_create(&cache_cfg);
+        if (!cache) {
+            return -1;
+        }
+    }
+    playlist_cfg_t playlist_cfg = PLAYLIST_CFG_DEFAULT();
+    playlist_cfg.loop = false;
+    playlist_cfg.pcm_cache = cache;
+    playlist_handle_t playlist = playlist_create(tracks, num_tracks, &playlist_cfg);
+    pcm_sink_cfg_t sink_cfg = PCM_SINK_CFG_DEFAULT();
+    player_pipeline_t player;
+    player_pipeline_cfg_t player_cfg = PLAYER_PIPELINE_CFG_DEFAULT();
+    latency_trace_handle_t lt = latency_trace_create();
+    // libmpg123 takes its own time
+    source_ctx_t src = {
+        .playlist = playlist,
+        .cache = cache,
+        .lt = lt,
+        .us_per_kb = strcmp(mp3_decoder_host_backend(), "libmpg123") ? STANDIN_DECODE_US_PER_KB : 0,
+    };
+    player_cfg.read_cb = source_read_cb;
+    player_cfg.read_ctx = &src;
+    if (!playlist || !lt || player_pipeline_create(&player, &player_cfg, pcm_sink_init(&sink_cfg)) != ESP_OK
+        || latency_trace_attach(lt, player.mp3_decoder, player.sink) != ESP_OK) {
+        return -1;
+    }
+    latency_trace_set_source(lt, source_pos, playlist);
+    if (cache) {
+        latency_trace_set_output_cb(lt, on_decoder_output, &src);
+    }
+
+    audio_pipeline_run(player.pipeline);
+    uint64_t decoder_ns = 0;
+    int idle = 0;
+    while (audio_element_get_state(player.sink) == AEL_STATE_RUNNING && idle < 1000) {
+        uint64_t t0 = bench_now_ns();
+        int progress = audio_element_host_step(player.mp3_decoder);
+        decoder_ns += bench_now_ns() - t0;
+        // the i2s writer runs in a task of its own: its time is not the decoder's, keep it off the cache's clock
+        t0 = bench_now_ns();
+        progress |= audio_element_host_step(player.sink);
+        esp_timer_host_advance(-(int64_t)((bench_now_ns() - t0) / 1000));
+        // a replay writes PCM and then reports no input, which the host step counts as idle
+        idle = progress ? 0 : idle + 1;
+    }
+    int ret = audio_element_get_state(player.sink) == AEL_STATE_FINISHED ? 0 : -1;
+    res->pcm_bytes = pcm_sink_get_bytes(player.sink);
+    res->source_bytes = playlist_get_pcm_pos(playlist);
+    res->decoder_ms = decoder_ns / 1e6 + src.charged_us / 1e3;
+    if (cache) {
+        pcm_cache_get_stats(cache, &res->cache);
+    }
+
+    latency_trace_detach(lt);
+    player_pipeline_stop(&player);
+    player_pipeline_destroy(&player);
+    playlist_destroy(playlist);
+    latency_trace_destroy(lt);
+    pcm_cache_destroy(cache);
+    return ret;
+}
+
+static int64_t track_pcm(const embed_asset_t *track) {
+    const mp3_index_t *index = track->index;
+    return (int64_t)index->frame_count * index->frame_samples * index->channels * 2;
+}
+
+/**
+ * @param min_hits Hits at least once the budget holds every track of the table, -1 for no check
+ */
+static int bench_table(const char *name, const embed_asset_t *tracks, int num_tracks, const size_t *budgets,
+                       int num_budgets, int min_hits) {
+    int64_t largest = 0;
+    for (int i = 0; i < num_tracks; i++) {
+        largest = track_pcm(&tracks[i]) > largest ? track_pcm(&tracks[i]) : largest;
+    }
+    run_result_t base = {0};
+    if (run(tracks, num_tracks, 0, &base) != 0) {
+        fprintf(stderr, "%s: uncached run stalled\n", name);
+        return -1;
+    }
+    printf("%-7s %7s %8s %5s %6s %5s %8s %9s %8s %8s %11s %10s %9s %12s\n", name, "budget", "pcm_mb", "hits",
+           "misses", "hit%", "bypass%", "evictions", "declined", "used_kb", "decoder_ms", "cpu_saved%", "saved_ms",
+           "est_saved_ms");
+    printf("%-7s %7s %8.2f %5s %6d %5s %8s %9s %8s %8s %11.2f %10s %9s %12s\n", "", "off", base.pcm_bytes / 1048576.0,
+           "-", num_tracks, "-", "-", "-", "-", "-", base.decoder_ms, "-", "-", "-");
+    int ret = 0;
+    double best_hit = 0;
+    size_t best_budget = 0;
+    for (int b = 0; b < num_budgets; b++) {
+        run_result_t res = {0};
+        if (run(tracks, num_tracks, budgets[b], &res) != 0) {
+            fprintf(stderr, "%s: run with a %u KB budget stalled\n", name, (unsigned)(budgets[b] / 1024));
+            return -1;
+        }
+        const pcm_cache_stats_t *s = &res.cache;
+        uint32_t starts = s->hits + s->misses;
+        double saved = base.decoder_ms - res.decoder_ms;
+        double hit = starts ? s->hits * 100.0 / starts : 0.0;
+        double est = s->saved_us / 1000.0;
+        printf("%-7s %6uk %8.2f %5u %6u %5.1f %8.1f %9u %8u %8u %11.2f %10.1f %9.2f %12.2f\n", "",
+               (unsigned)(budgets[b] / 1024), res.pcm_bytes / 1048576.0, s->hits, s->misses, hit,
+               s->replay_bytes * 100.0 / res.source_bytes, s->evictions, s->declined,
+               (unsigned)(s->used_bytes / 1024), res.decoder_ms, saved * 100 / base.decoder_ms, saved, est);
+        if (hit < best_hit) {
+            fprintf(stderr, "%s: %.1f%% hits with a %u KB budget, %.1f%% with %u KB: %u evictions, the tracks thrash\n",
+                    name, hit, (unsigned)(budgets[b] / 1024), best_hit, (unsigned)(best_budget / 1024), s->evictions);
+            ret = -1;
+        } else {
+            best_hit = hit;
+            best_budget = budgets[b];
+        }
+        // the stand-in decoder drops a frame where the format changes, a replay does not
+        if (res.source_bytes != base.source_bytes || res.pcm_bytes < base.pcm_bytes
+            || res.pcm_bytes > res.source_bytes) {
+            fprintf(stderr, "%s: %lld of %lld bytes of PCM played with the cache, %lld of %lld without\n", name,
+                    (long long)res.pcm_bytes, (long long)res.source_bytes, (long long)base.pcm_bytes,
+                    (long long)base.source_bytes);
+            ret = -1;
+        }
+        if (s->hits && (est < saved * (100 - SAVED_TOLERANCE_PCT) / 100
+                        || est > saved * (100 + SAVED_TOLERANCE_PCT) / 100)) {
+            fprintf(stderr, "%s: the cache estimates %.2f ms saved with a %u KB budget, %.2f ms measured\n", name, est,
+                    (unsigned)(budgets[b] / 1024), saved);
+            ret = -1;
+        }
+        if (min_hits >= 0 && budgets[b] >= largest && s->hits < min_hits) {
+            fprintf(stderr, "%s: %u of %d passes replayed with a %u KB budget\n", name, s->hits, min_hits,
+                    (unsigned)(budgets[b] / 1024));
+            ret = -1;
+        }
+    }
+    return ret;
+}
+
+int main(int argc, char *argv[]) {
+    esp_log_level_set("*", ESP_LOG_ERROR);
+
+    static embed_asset_t tracks[MAX_TRACKS];
+    const size_t budgets[] = {256 * 1024, 1024 * 1024, 2048 * 1024, 4096 * 1024, 8192 * 1024};
+    int num_budgets = sizeof(budgets) / sizeof(budgets[0]);
+
+    printf("decoder backend: %s\n", mp3_decoder_host_backend());
+    for (int i = 0; i < music_assets_count; i++) {
+        printf("%s: %lld bytes of PCM\n", music_assets[i].name, (long long)track_pcm(&music_assets[i]));
+    }
+    for (int i = 0; i < LOOP_PASSES; i++) {
+        tracks[i] = music_assets[0];
+    }
+    int ret = 0;
+    if (bench_table("loop", tracks, LOOP_PASSES, budgets, num_budgets, LOOP_PASSES - 1) != 0) {
+        ret = 1;
+    }
+    for (int i = 0; i < ROTATE_PASSES * music_assets_count; i++) {
+        tracks[i] = music_assets[i % music_assets_count];
+    }
+    if (bench_table("rotate", tracks, ROTATE_PASSES * music_assets_count, budgets, num_budgets, -1) != 0) {
+        ret = 1;
+    }
+    for (int i = 0; i < 2 * SWITCH_PASSES; i++) {
+        tracks[i] = music_assets[i / SWITCH_PASSES];
+    }
+    // the 22 kHz asset misses twice when it has to evict: once declined, then recorded
+    if (bench_table("switch", tracks, 2 * SWITCH_PASSES, budgets, num_budgets, 2 * SWITCH_PASSES - 3) != 0) {
+        ret = 1;
+    }
+    return ret;
+}
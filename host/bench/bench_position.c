@@ -0,0 +1,188 @@
+/* NVS endurance of playback position checkpoints
+
+   Plays the embedded track table in a loop for a number of simulated hours,
+   pausing for a minute every 15 minutes, with the event loop passing every
+   second, and checkpoints the position on the host model of the 24 KB nvs
+   partition (host/include/nvs.h). The partition also holds PHY calibration
+   data, which page compaction has to move along. Modes:
+
+   blob @1s : the obvious implementation, a {track, byte offset, ms} blob
+              written and committed on every pass
+   u64 @Ns  : play_position, one packed u64 at most every N seconds and on
+              pause
+
+   After every pass the stored record is read back as it would be after a
+   reset, and the playback lost behind it is measured. The default mode must
+   lose no more than its interval plus one pass, and last at least
+   MIN_YEARS of continuous playback before the most erased page reaches
+   ERASE_CYCLES.
+
+   Usage: bench_position [hours]
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "nvs.h"
+#include "music_assets.h"
+#include "play_position.h"
+
+#define PARTITION_SIZE      0x6000
+#define PHY_CAL_BYTES       1904
+#define STEP_MS             1000
+#define PAUSE_EVERY_MS      (15 * 60 * 1000)
+#define PAUSE_MS            (60 * 1000)
+#define ERASE_CYCLES        100000
+#define MIN_YEARS           5
+#define DEFAULT_INTERVAL_MS 5000
+
+typedef struct {
+    const char *name;
+    int interval_ms;        // 0 for the blob
+} pos_mode_t;
+
+typedef struct {
+    uint32_t writes;
+    int64_t max_lost_ms;
+    nvs_host_stats_t nvs;
+} result_t;
+
+typedef struct {
+    int track;
+    uint32_t offset;
+    uint32_t ms;
+} blob_pos_t;
+
+/**
+ * @brief Track, frame and byte offset at a time on the looped playlist
+ */
+static void locate(int64_t t_ms, int *track, uint32_t *frame, uint32_t *offset, uint32_t *track_ms) {
+    int64_t total = 0;
+    for (int i = 0; i < music_assets_count; i++) {
+        total += mp3_index_duration_ms(music_assets[i].index);
+    }
+    t_ms %= total;
+    int i = 0;
+    while (t_ms >= mp3_index_duration_ms(music_assets[i].index)) {
+        t_ms -= mp3_index_duration_ms(music_assets[i].index);
+        i++;
+    }
+    const mp3_index_t *index = music_assets[i].index;
+    *track = i;
+    *frame = mp3_index_frame_at(index, t_ms);
+    *offset = mp3_index_offset(index, *frame);
+    *track_ms = t_ms;
+}
+
+static int run(const pos_mode_t *mode, int hours, result_t *res) {
+    nvs_host_format(PARTITION_SIZE);
+    static uint8_t phy_cal[PHY_CAL_BYTES];
+    nvs_handle_t phy;
+    if (nvs_open("phy", NVS_READWRITE, &phy) != ESP_OK || nvs_set_blob(phy, "cal_data", phy_cal, sizeof(phy_cal))
+        || nvs_set_u32(phy, "cal_version", 1)) {
+        return -1;
+    }
+
+    play_position_cfg_t cfg = PLAY_POSITION_CFG_DEFAULT();
+    cfg.interval_ms = mode->interval_ms;
+    play_position_handle_t pos = play_position_create(&cfg, music_assets, music_assets_count);
+    nvs_handle_t nvs;
+    if (!pos || nvs_open(cfg.nvs_namespace, NVS_READWRITE, &nvs) != ESP_OK) {
+        return -1;
+    }
+    int64_t play_ms = 0;            // position on the looped playlist
+    int64_t stored_ms = 0;          // position the last write recorded
+    uint32_t last_writes = 0;
+    int stored_track = -1;
+    uint32_t stored_frame = 0;
+    int64_t end = hours * 3600000LL;
+    for (int64_t t = 0; t < end; t += STEP_MS) {
+        bool paused = t % PAUSE_EVERY_MS >= PAUSE_EVERY_MS - PAUSE_MS;
+        bool pausing = t % PAUSE_EVERY_MS == PAUSE_EVERY_MS - PAUSE_MS;
+        int track;
+        uint32_t frame, offset, track_ms;
+        locate(play_ms, &track, &frame, &offset, &track_ms);
+        if (mode->interval_ms == 0) {
+            blob_pos_t b = {track, offset, track_ms};
+            if (nvs_set_blob(nvs, "pos", &b, sizeof(b)) != ESP_OK || nvs_commit(nvs) != ESP_OK) {
+                return -1;
+            }
+            res->writes++;
+            stored_ms = play_ms;
+        } else {
+            if (play_position_update(pos, track, frame, pausing) != ESP_OK) {
+                return -1;
+            }
+            play_position_stats_t s;
+            play_position_get_stats(pos, &s);
+            if (s.writes != last_writes) {
+                last_writes = s.writes;
+                stored_ms = play_ms;
+                stored_track = track;
+                stored_frame = frame;
+            }
+            res->writes = s.writes;
+            // what a reset now would resume from
+            int rt;
+            uint32_t rf;
+            if (play_position_load(pos, &rt, &rf) != ESP_OK || rt != stored_track || rf != stored_frame) {
+                fprintf(stderr, "%s: checkpoint lost at %lld ms\n", mode->name, (long long)t);
+                return -1;
+            }
+        }
+        if (play_ms - stored_ms > res->max_lost_ms) {
+            res->max_lost_ms = play_ms - stored_ms;
+        }
+        if (!paused) {
+            play_ms += STEP_MS;
+        }
+        esp_timer_host_advance(STEP_MS * 1000LL);
+    }
+    nvs_host_get_stats(&res->nvs);
+    play_position_destroy(pos);
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+    int hours = argc > 1 ? atoi(argv[1]) : 24;
+    if (hours <= 0) {
+        fprintf(stderr, "usage: %s [hours]\n", argv[0]);
+        return 2;
+    }
+    esp_log_level_set("*", ESP_LOG_ERROR);
+
+    const pos_mode_t modes[] = {
+        {"blob @1s", 0},
+        {"u64 @1s", 1000},
+        {"u64 @5s", DEFAULT_INTERVAL_MS},
+        {"u64 @30s", 30000},
+    };
+    printf("%d h of playback, %d KB nvs partition, event loop every %d ms\n", hours, PARTITION_SIZE / 1024, STEP_MS);
+    printf("%-10s %8s %9s %9s %9s %10s %9s %8s\n", "mode", "writes/h", "programs/h", "kb/h", "erases/h",
+           "worst_pg/h", "years", "lost_ms");
+    int ret = 0;
+    for (int i = 0; i < sizeof(modes) / sizeof(modes[0]); i++) {
+        result_t res = {0};
+        if (run(&modes[i], hours, &res) != 0) {
+            fprintf(stderr, "%s failed\n", modes[i].name);
+            return 1;
+        }
+        double worst_per_h = (double)res.nvs.max_page_erases / hours;
+        double years = worst_per_h > 0 ? ERASE_CYCLES / worst_per_h / (24 * 365) : 1e9;
+        printf("%-10s %8.0f %9.0f %9.1f %9.2f %10.3f %9.1f %8lld\n", modes[i].name, (double)res.writes / hours,
+               (double)res.nvs.programs / hours, res.nvs.program_bytes / 1024.0 / hours,
+               (double)res.nvs.erases / hours, worst_per_h, years, (long long)res.max_lost_ms);
+        if (modes[i].interval_ms == DEFAULT_INTERVAL_MS) {
+            if (res.max_lost_ms > DEFAULT_INTERVAL_MS + STEP_MS) {
+                fprintf(stderr, "%s: up to %lld ms of playback lost\n", modes[i].name, (long long)res.max_lost_ms);
+                ret = 1;
+            }
+            if (years < MIN_YEARS) {
+                fprintf(stderr, "%s: nvs worn out after %.1f years\n", modes[i].name, years);
+                ret = 1;
+            }
+        }
+    }
+    return ret;
+}
@@ -0,0 +1,293 @@
+/* Cost and accuracy of the polyphase resampler, and fixed-rate output of the pipeline
+
+   For every input rate, resampled to 44.1 kHz stereo:
+
+   - a 1 kHz sine at -6 dBFS goes through the filter, and the output is fit
+     to a 1 kHz sine at the output rate: the gain must be within 0.5 dB and
+     the rest, aliases and quantisation, at least MIN_SNR_DB below it;
+   - ten seconds of input are timed with the cycle counter; cycles per
+     output frame (both channels) is the figure to compare with the target's
+     RESAMPLE_BENCH log, cpu% the share of one host core real time takes.
+
+   Then the three assets play through playlist -> mp3 -> resampler -> sink,
+   as app_main links them, once decoded and once with the 8 kHz asset
+   replayed from the PCM cache in between. The sink must get stereo at
+   44.1 kHz, as many frames as the decoder output per format converts to.
+
+   Usage: bench_resample
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "esp_log.h"
+#include "audio_common.h"
+#include "pcm_sink.h"
+#include "mp3_decoder.h"
+#include "music_assets.h"
+#include "player_pipeline.h"
+#include "playlist.h"
+#include "latency_trace.h"
+#include "pcm_cache.h"
+#include "resample.h"
+#include "bench_clock.h"
+
+#define OUT_RATE        44100
+#define TONE_HZ         1000
+#define TONE_AMPLITUDE  16384
+#define MIN_SNR_DB      60
+#define MAX_GAIN_DB     0.5
+#define TIMED_SECONDS   10
+#define MAX_SEGMENTS    16
+
+static int16_t in_buf[RESAMPLE_MAX_BLOCK * 2];
+static int16_t out_buf[RESAMPLE_MAX_BLOCK * 2 * (OUT_RATE / 8000 + 2)];
+
+/**
+ * @brief Fit the tone to the output, returning its gain in dB and the SNR of the rest
+ */
+static int check_tone(int in_rate, double *gain_db, double *snr_db) {
+    resample_filter_handle_t f = resample_filter_create(in_rate, OUT_RATE);
+    if (!f) {
+        return -1;
+    }
+    int total_in = in_rate * 2;
+    int out_len = 0;
+    static int16_t tone_out[OUT_RATE * 3];
+    for (int done = 0; done < total_in; done += RESAMPLE_MAX_BLOCK) {
+        for (int i = 0; i < RESAMPLE_MAX_BLOCK; i++) {
+            int16_t v = lrint(TONE_AMPLITUDE * sin(2 * M_PI * TONE_HZ * (done + i) / in_rate));
+            in_buf[2 * i] = v;
+            in_buf[2 * i + 1] = -v;
+        }
+        int n = resample_filter_run(f, in_buf, RESAMPLE_MAX_BLOCK, 2, out_buf);
+        for (int i = 0; i < n && out_len < OUT_RATE * 3; i++) {
+            // left, and the inverted right, must match but for rounding
+            if (abs(out_buf[2 * i] + out_buf[2 * i + 1]) > 1) {
+                fprintf(stderr, "%d Hz: channels differ at output frame %d\n", in_rate, out_len);
+                resample_filter_destroy(f);
+                return -1;
+            }
+            tone_out[out_len++] = out_buf[2 * i];
+        }
+    }
+    resample_filter_destroy(f);
+
+    // least squares fit of a sin + b cos over the middle, past the filter's start-up
+    int from = out_len / 4, to = out_len * 3 / 4;
+    double ss = 0, cc = 0, sc = 0, ys = 0, yc = 0;
+    for (int i = from; i < to; i++) {
+        double w = 2 * M_PI * TONE_HZ * i / OUT_RATE;
+        double s = sin(w), c = cos(w);
+        ss += s * s;
+        cc += c * c;
+        sc += s * c;
+        ys += tone_out[i] * s;
+        yc += tone_out[i] * c;
+    }
+    double det = ss * cc - sc * sc;
+    double a = (ys * cc - yc * sc) / det;
+    double b = (yc * ss - ys * sc) / det;
+    double signal = 0, noise = 0;
+    for (int i = from; i < to; i++) {
+        double w = 2 * M_PI * TONE_HZ * i / OUT_RATE;
+        double fit = a * sin(w) + b * cos(w);
+        signal += fit * fit;
+        noise += (tone_out[i] - fit) * (tone_out[i] - fit);
+    }
+    *gain_db = 20 * log10(sqrt(a * a + b * b) / TONE_AMPLITUDE);
+    *snr_db = 10 * log10(signal / (noise > 0 ? noise : 1e-9));
+    return 0;
+}
+
+/**
+ * @brief Cycles per stereo output frame over TIMED_SECONDS of input
+ */
+static int time_filter(int in_rate, double *cycles, double *cpu) {
+    resample_filter_handle_t f = resample_filter_create(in_rate, OUT_RATE);
+    if (!f) {
+        return -1;
+    }
+    for (int i = 0; i < RESAMPLE_MAX_BLOCK * 2; i++) {
+        in_buf[i] = (i * 997) & 0x3fff;
+    }
+    int64_t frames = 0;
+    uint64_t ns = bench_now_ns();
+    uint64_t c0 = bench_cycles();
+    for (int done = 0; done < in_rate * TIMED_SECONDS; done += RESAMPLE_MAX_BLOCK) {
+        frames += resample_filter_run(f, in_buf, RESAMPLE_MAX_BLOCK, 2, out_buf);
+    }
+    uint64_t c1 = bench_cycles();
+    ns = bench_now_ns() - ns;
+    resample_filter_destroy(f);
+    *cycles = (double)(c1 - c0) / frames;
+    *cpu = ns / 1e9 / ((double)frames / OUT_RATE) * 100;
+    return 0;
+}
+
+typedef struct {
+    player_pipeline_t *player;
+    pcm_cache_handle_t cache;
+    latency_trace_handle_t lt;
+    int segments;
+    int rate[MAX_SEGMENTS];
+    int channels[MAX_SEGMENTS];
+    int64_t bytes[MAX_SEGMENTS];
+} output_log_t;
+
+/**
+ * @brief on_decoder_output() of app_main, also logging the decoder output per format
+ */
+static void on_decoder_output(void *ctx, int64_t pos, const char *buf, int len) {
+    output_log_t *log = (output_log_t *)ctx;
+    if (log->cache) {
+        pcm_cache_decoder_output(log->cache, pos, buf, len, latency_trace_get_write_wait_us(log->lt));
+    }
+    audio_element_info_t info = {0};
+    audio_element_getinfo(log->player->mp3_decoder, &info);
+    resample_input_written(log->player->resampler, info.sample_rates, info.channels, len);
+    int s = log->segments - 1;
+    if (s < 0 || info.sample_rates != log->rate[s] || info.channels != log->channels[s]) {
+        if (log->segments == MAX_SEGMENTS) {
+            return;
+        }
+        s = log->segments++;
+        log->rate[s] = info.sample_rates;
+        log->channels[s] = info.channels;
+    }
+    log->bytes[s] += len;
+}
+
+static int64_t source_pos(void *ctx) {
+    return playlist_get_pcm_pos((playlist_handle_t)ctx);
+}
+
+/**
+ * @brief Play a track table through the resampler, with or without a PCM cache
+ */
+static int play(const char *name, const embed_asset_t *tracks, int num_tracks, bool cached) {
+    pcm_cache_handle_t cache = NULL;
+    if (cached) {
+        pcm_cache_cfg_t cache_cfg = PCM_CACHE_CFG_DEFAULT();
+        cache = pcm_cache_create(&cache_cfg);
+    }
+    playlist_cfg_t playlist_cfg = PLAYLIST_CFG_DEFAULT();
+    playlist_cfg.loop = false;
+    playlist_cfg.pcm_cache = cache;
+    playlist_handle_t playlist = playlist_create(tracks, num_tracks, &playlist_cfg);
+    pcm_sink_cfg_t sink_cfg = PCM_SINK_CFG_DEFAULT();
+    player_pipeline_t player;
+    player_pipeline_cfg_t player_cfg = PLAYER_PIPELINE_CFG_DEFAULT();
+    player_cfg.read_cb = playlist_read_cb;
+    player_cfg.read_ctx = playlist;
+    player_cfg.output_rate = OUT_RATE;
+    latency_trace_handle_t lt = latency_trace_create();
+    if (!playlist || !lt || (cached && !cache)
+        || player_pipeline_create(&player, &player_cfg, pcm_sink_init(&sink_cfg)) != ESP_OK
+        || latency_trace_attach(lt, player.mp3_decoder, player.resampler) != ESP_OK) {
+        return -1;
+    }
+    static output_log_t log;
+    memset(&log, 0, sizeof(log));
+    log.player = &player;
+    log.cache = cache;
+    log.lt = lt;
+    latency_trace_set_source(lt, source_pos, playlist);
+    latency_trace_set_output_cb(lt, on_decoder_output, &log);
+
+    audio_pipeline_run(player.pipeline);
+    uint64_t resample_ns = 0;
+    int idle = 0;
+    while (audio_element_get_state(player.sink) == AEL_STATE_RUNNING && idle < 1000) {
+        int progress = audio_element_host_step(player.sink);
+        uint64_t t0 = bench_now_ns();
+        progress |= audio_element_host_step(player.resampler);
+        resample_ns += bench_now_ns() - t0;
+        progress |= audio_element_host_step(player.mp3_decoder);
+        idle = progress ? 0 : idle + 1;
+    }
+    int ret = audio_element_get_state(player.sink) == AEL_STATE_FINISHED ? 0 : -1;
+    if (ret != 0) {
+        fprintf(stderr, "%s: pipeline stalled\n", name);
+    }
+    audio_element_info_t sink_info = {0};
+    audio_element_getinfo(player.resampler, &sink_info);
+    int64_t out_frames = pcm_sink_get_bytes(player.sink) / 4;
+    double expect = 0;
+    for (int s = 0; s < log.segments; s++) {
+        expect += (double)log.bytes[s] / (log.channels[s] * 2) * OUT_RATE / log.rate[s];
+    }
+    // each format change flushes the filter, RESAMPLE_TAPS / 2 input frames
+    double slack = log.segments * (RESAMPLE_TAPS / 2.0 * OUT_RATE / 8000 + 2);
+    pcm_cache_stats_t cs = {0};
+    if (cache) {
+        pcm_cache_get_stats(cache, &cs);
+    }
+    printf("%-8s %8d %9lld %11.0f %12.1f %5u\n", name, log.segments, (long long)out_frames, expect,
+           resample_ns / 1e6 / (out_frames / (double)OUT_RATE), cs.hits);
+    if (sink_info.sample_rates != OUT_RATE || sink_info.channels != 2 || fabs(out_frames - expect) > slack) {
+        fprintf(stderr, "%s: %lld frames at %d Hz, %d channels out, expected %.0f at %d Hz stereo\n", name,
+                (long long)out_frames, sink_info.sample_rates, sink_info.channels, expect, OUT_RATE);
+        ret = -1;
+    }
+    if (cached && cs.hits == 0) {
+        fprintf(stderr, "%s: nothing replayed\n", name);
+        ret = -1;
+    }
+
+    latency_trace_detach(lt);
+    player_pipeline_stop(&player);
+    player_pipeline_destroy(&player);
+    playlist_destroy(playlist);
+    latency_trace_destroy(lt);
+    pcm_cache_destroy(cache);
+    return ret;
+}
+
+int main(int argc, char *argv[]) {
+    esp_log_level_set("*", ESP_LOG_ERROR);
+
+    const int rates[] = {8000, 11025, 16000, 22050, 32000, 48000};
+    int ret = 0;
+    printf("to %d Hz stereo, %d taps, %d kHz tone\n", OUT_RATE, RESAMPLE_TAPS, TONE_HZ / 1000);
+    printf("%-8s %8s %8s %8s %15s %6s\n", "in_hz", "coef_b", "gain_db", "snr_db", "cycles/frame", "cpu%");
+    for (int r = 0; r < sizeof(rates) / sizeof(rates[0]); r++) {
+        double gain, snr, cycles, cpu;
+        if (check_tone(rates[r], &gain, &snr) != 0 || time_filter(rates[r], &cycles, &cpu) != 0) {
+            fprintf(stderr, "%d Hz: no filter\n", rates[r]);
+            return 1;
+        }
+        int g = rates[r];
+        for (int b = OUT_RATE; b; ) {
+            int t = g % b;
+            g = b;
+            b = t;
+        }
+        printf("%-8d %8d %8.3f %8.1f %15.1f %6.3f\n", rates[r], (int)(OUT_RATE / g * RESAMPLE_TAPS * sizeof(int16_t)),
+               gain, snr, cycles, cpu);
+        if (fabs(gain) > MAX_GAIN_DB || snr < MIN_SNR_DB) {
+            fprintf(stderr, "%d Hz: tone at %.2f dB gain, %.1f dB SNR\n", rates[r], gain, snr);
+            ret = 1;
+        }
+    }
+
+    printf("\ndecoder backend: %s\n", mp3_decoder_host_backend());
+    printf("%-8s %8s %9s %11s %12s %5s\n", "run", "formats", "out_frames", "expected", "resample_ms/s", "hits");
+    static embed_asset_t tracks[5];
+    for (int i = 0; i < music_assets_count; i++) {
+        tracks[i] = music_assets[i];
+    }
+    if (play("decoded", tracks, music_assets_count, false) != 0) {
+        ret = 1;
+    }
+    // 8 kHz, 22.05 kHz, the 8 kHz replayed, 44.1 kHz, the 8 kHz replayed again
+    const int order[] = {0, 1, 0, 2, 0};
+    for (int i = 0; i < 5; i++) {
+        tracks[i] = music_assets[order[i]];
+    }
+    if (play("cached", tracks, 5, true) != 0) {
+        ret = 1;
+    }
+    return ret;
+}
@@ -0,0 +1,229 @@
+/* Flash erase/program operations of the worker's FAT check, write-through vs. the PSRAM write-back cache
+
+   Replays the sector traffic FatFs generates for one isFATFSCorrupted()
+   round (fopen "wb" truncates and reallocates the file, fclose writes the
+   data, FAT and directory sectors, then the file is read back) every 2 s of
+   simulated time, through sector_cache over an in-memory flash that counts
+   operations. The flush task of storage_diskio is stood in by calling
+   sector_cache_flush_expired() every half interval. After a final sync the
+   flash image must equal what the file system wrote.
+
+   write-back synced is the drive as mounted: fclose() reaches CTRL_SYNC,
+   which syncs the cache. After every fclose the flash image must equal what
+   the file system wrote, and the sectors must have reached flash in the
+   order they were last written. write-back unsynced holds the writes until
+   the flush task, as for a file that is never synced, and must cut the flash
+   operations MIN_REDUCTION times.
+
+   Usage: bench_sector_cache [checks] [flush_interval_ms]
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "sector_cache.h"
+
+#define SECTOR_SIZE     4096
+#define SECTORS         16
+#define CHECK_GAP_MS    2000
+#define MIN_REDUCTION   10
+
+typedef struct {
+    uint8_t data[SECTORS][SECTOR_SIZE];
+    uint32_t reads;
+    uint32_t erases;
+    uint32_t log[SECTORS * 4];              // sectors written since the last sync, in order
+    int log_len;
+} flash_t;
+
+typedef struct {
+    sector_cache_handle_t cache;
+    uint8_t shadow[SECTORS][SECTOR_SIZE];   // what the file system wrote
+    uint32_t stamp[SECTORS];                // of the last write
+    uint32_t clock;
+    flash_t *flash;
+    bool sync;                              // fclose syncs
+} disk_t;
+
+static esp_err_t flash_read(void *ctx, uint32_t sector, void *buf, size_t count) {
+    flash_t *f = (flash_t *)ctx;
+    if (sector + count > SECTORS) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    memcpy(buf, f->data[sector], count * SECTOR_SIZE);
+    f->reads += count;
+    return ESP_OK;
+}
+
+static esp_err_t flash_write(void *ctx, uint32_t sector, const void *buf, size_t count) {
+    flash_t *f = (flash_t *)ctx;
+    if (sector + count > SECTORS) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    memcpy(f->data[sector], buf, count * SECTOR_SIZE);
+    f->erases += count;
+    for (size_t i = 0; i < count && f->log_len < SECTORS * 4; i++) {
+        f->log[f->log_len++] = sector + i;
+    }
+    return ESP_OK;
+}
+
+static esp_err_t disk_read(disk_t *d, uint32_t sector, uint8_t *buf) {
+    esp_err_t err = sector_cache_read(d->cache, sector, buf, 1);
+    if (err == ESP_OK && memcmp(buf, d->shadow[sector], SECTOR_SIZE)) {
+        fprintf(stderr, "sector %u read back wrong data\n", sector);
+        return ESP_FAIL;
+    }
+    return err;
+}
+
+static esp_err_t disk_update(disk_t *d, uint32_t sector, uint8_t *buf, int n, int offset) {
+    buf[offset] = (uint8_t)n;
+    buf[offset + 1] = (uint8_t)(n >> 8);
+    memcpy(d->shadow[sector], buf, SECTOR_SIZE);
+    d->stamp[sector] = ++d->clock;
+    return sector_cache_write(d->cache, sector, buf, 1);
+}
+
+/**
+ * @brief fclose(): CTRL_SYNC syncs the cache, everything written is on flash, in write order
+ */
+static esp_err_t disk_close(disk_t *d) {
+    flash_t *f = d->flash;
+    if (!d->sync) {
+        return ESP_OK;
+    }
+    f->log_len = 0;
+    esp_err_t err = sector_cache_sync(d->cache);
+    if (err != ESP_OK) {
+        return err;
+    }
+    if (memcmp(f->data, d->shadow, sizeof(d->shadow))) {
+        fprintf(stderr, "flash image differs from the file system's after fclose\n");
+        return ESP_FAIL;
+    }
+    for (int i = 1; i < f->log_len; i++) {
+        if (d->stamp[f->log[i]] < d->stamp[f->log[i - 1]]) {
+            fprintf(stderr, "sector %u reached flash before sector %u, written after it\n", f->log[i - 1], f->log[i]);
+            return ESP_FAIL;
+        }
+    }
+    return ESP_OK;
+}
+
+/**
+ * @brief FatFs sector traffic of one round of isFATFSCorrupted()
+ */
+static esp_err_t fat_check(disk_t *d, int n) {
+    static uint8_t buf[SECTOR_SIZE];
+    const uint32_t fat = 1, dir = 2, data = 4 + n % 2;
+    esp_err_t err = ESP_OK;
+    // fopen("wb"): find the entry, truncate: free the cluster chain
+    err |= disk_read(d, dir, buf);
+    err |= disk_read(d, fat, buf);
+    err |= disk_update(d, fat, buf, n, 0);
+    err |= disk_read(d, dir, buf);
+    err |= disk_update(d, dir, buf, n, 32);
+    // fwrite + fclose: allocate a cluster, write the data, update the entry
+    err |= disk_read(d, fat, buf);
+    err |= disk_update(d, fat, buf, n, 2);
+    err |= disk_read(d, data, buf);
+    err |= disk_update(d, data, buf, n, 0);
+    err |= disk_read(d, dir, buf);
+    err |= disk_update(d, dir, buf, n, 34);
+    err |= disk_close(d);
+    // fopen("r") + fread
+    err |= disk_read(d, dir, buf);
+    err |= disk_read(d, data, buf);
+    return err;
+}
+
+static int run(int checks, int interval_ms, bool sync, flash_t *flash, sector_cache_stats_t *stats) {
+    static disk_t disk;
+    memset(flash, 0, sizeof(*flash));
+    memset(&disk, 0, sizeof(disk));
+    disk.flash = flash;
+    disk.sync = sync;
+
+    sector_cache_cfg_t cfg = SECTOR_CACHE_CFG_DEFAULT();
+    cfg.sector_size = SECTOR_SIZE;
+    cfg.flush_interval_ms = interval_ms;
+    cfg.read = flash_read;
+    cfg.write = flash_write;
+    cfg.ctx = flash;
+    disk.cache = sector_cache_create(&cfg);
+    if (!disk.cache) {
+        return -1;
+    }
+    int ret = 0;
+    int64_t next_flush = esp_timer_get_time();
+    for (int n = 0; n < checks && ret == 0; n++) {
+        if (fat_check(&disk, n) != ESP_OK) {
+            ret = -1;
+        }
+        vTaskDelay(pdMS_TO_TICKS(CHECK_GAP_MS));
+        while (interval_ms > 0 && esp_timer_get_time() >= next_flush) {
+            sector_cache_flush_expired(disk.cache);
+            next_flush += interval_ms * 1000LL / 2;
+        }
+    }
+    if (ret == 0 && sector_cache_sync(disk.cache) != ESP_OK) {
+        ret = -1;
+    }
+    if (ret == 0 && memcmp(flash->data, disk.shadow, sizeof(disk.shadow))) {
+        fprintf(stderr, "flash image differs from the file system's after sync\n");
+        ret = -1;
+    }
+    sector_cache_get_stats(disk.cache, stats);
+    sector_cache_destroy(disk.cache);
+    return ret;
+}
+
+int main(int argc, char *argv[]) {
+    int checks = argc > 1 ? atoi(argv[1]) : 300;
+    int interval_ms = argc > 2 ? atoi(argv[2]) : 30000;
+    if (checks <= 0 || interval_ms < 0) {
+        fprintf(stderr, "usage: %s [checks] [flush_interval_ms]\n", argv[0]);
+        return 2;
+    }
+    esp_log_level_set("*", ESP_LOG_ERROR);
+
+    const struct {
+        const char *name;
+        int interval_ms;
+        bool sync;
+    } modes[] = {
+        {"write-through", 0, true},
+        {"wb synced", interval_ms, true},
+        {"wb unsynced", interval_ms, false},
+    };
+    uint32_t erases[3];
+    printf("%d FAT checks every %d ms, flush interval %d ms\n", checks, CHECK_GAP_MS, interval_ms);
+    printf("%-14s %7s %7s %7s %7s %7s %7s %7s %7s\n", "mode", "writes", "w_hits", "r_hits", "r_miss",
+           "flushes", "evict", "saved", "erases");
+    for (int i = 0; i < 3; i++) {
+        static flash_t flash;
+        sector_cache_stats_t s;
+        if (run(checks, modes[i].interval_ms, modes[i].sync, &flash, &s) != 0) {
+            fprintf(stderr, "%s failed\n", modes[i].name);
+            return 1;
+        }
+        erases[i] = flash.erases;
+        printf("%-14s %7u %7u %7u %7u %7u %7u %7u %7u\n", modes[i].name, s.writes, s.write_hits, s.read_hits,
+               s.read_misses, s.flushes, s.evictions, s.erases_saved, flash.erases);
+    }
+    printf("flash erase/program operations cut %.1fx synced at fclose\n",
+           erases[1] ? (double)erases[0] / erases[1] : erases[0]);
+    double reduction = erases[2] ? (double)erases[0] / erases[2] : erases[0];
+    printf("flash erase/program operations cut %.1fx unsynced\n", reduction);
+    if (interval_ms >= MIN_REDUCTION * CHECK_GAP_MS && reduction < MIN_REDUCTION) {
+        fprintf(stderr, "expected at least %dx fewer flash operations\n", MIN_REDUCTION);
+        return 1;
+    }
+    return 0;
+}
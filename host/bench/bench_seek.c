@@ -0,0 +1,233 @@
+/* Seek through the build-time frame index vs. scanning frame headers
+
+   For every embedded asset:
+
+   - walks the frames at run time the way the playlist does and checks the
+     generated index has the same offsets;
+   - times a scan seek, following frame headers from the first frame to the
+     target as a player without an index has to, at 10%, 50% and 90% of the
+     track;
+   - times playlist_seek() plus the decoder read that applies it, at random
+     times, and checks the read continues exactly at the frame playing at
+     that time and that playlist_get_time_ms() reports it. The slowest seek
+     must take less than one frame duration;
+   - seeks to the middle and reads to the end: the frames handed out must be
+     the second half of the track.
+
+   Times are host wall-clock.
+
+   Usage: bench_seek [seeks]
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "esp_log.h"
+#include "audio_common.h"
+#include "mp3_frame.h"
+#include "mp3_index.h"
+#include "music_assets.h"
+#include "playlist.h"
+#include "bench_clock.h"
+
+#define READ_LEN    (2 * MP3_FRAME_MAX_BYTES)
+
+/**
+ * @brief Offset of frame n by following headers from the first frame, -1 past the end
+ */
+static int scan_to(const embed_asset_t *asset, uint32_t n) {
+    const uint8_t *data = asset->start;
+    int len = asset->end - data;
+    int tag = mp3_id3v2_size(data, len);
+    int pos = mp3_frame_sync(data + tag, len - tag, NULL);
+    if (pos < 0) {
+        return -1;
+    }
+    pos += tag;
+    for (uint32_t i = 0;; i++) {
+        mp3_frame_info_t info;
+        int size = len - pos >= MP3_FRAME_HEADER_SIZE ? mp3_frame_parse_header(data + pos, &info) : 0;
+        if (size == 0) {
+            int off = mp3_frame_sync(data + pos, len - pos, &info);
+            if (off < 0) {
+                return -1;
+            }
+            pos += off;
+            size = info.frame_bytes;
+        } else if (size > len - pos) {
+            return -1;
+        }
+        if (i == n) {
+            return pos;
+        }
+        pos += size;
+    }
+}
+
+static int check_index(const embed_asset_t *asset) {
+    const mp3_index_t *index = asset->index;
+    for (uint32_t i = 0; i <= index->frame_count; i++) {
+        int pos = scan_to(asset, i);
+        uint32_t expect = pos < 0 ? index->end : pos;
+        if (mp3_index_offset(index, i) != expect) {
+            fprintf(stderr, "%s: frame %u at %u in the index, %u in the file\n", asset->name, i,
+                    mp3_index_offset(index, i), expect);
+            return -1;
+        }
+        if (pos < 0) {
+            break;
+        }
+    }
+    return 0;
+}
+
+static double scan_ms(const embed_asset_t *asset, int percent) {
+    uint32_t frame = asset->index->frame_count * percent / 100;
+    uint64_t t0 = bench_now_ns();
+    volatile int pos = scan_to(asset, frame);
+    (void)pos;
+    return (bench_now_ns() - t0) / 1e6;
+}
+
+/**
+ * @brief Seek in the middle of a frame and read; the data after the frame's tail must be the target frame
+ */
+static int timed_seek(playlist_handle_t pl, int track, uint32_t ms, double *seek_ms) {
+    static char buf[READ_LEN];
+    const embed_asset_t *asset = &music_assets[track];
+    const mp3_index_t *index = asset->index;
+    // stop part way into a frame, as the decoder does; restart if the last seek ran to the end of the playlist
+    if (playlist_read_cb(NULL, buf, 100, 0, pl) <= 0
+        && (playlist_seek(pl, track, 0) != ESP_OK || playlist_read_cb(NULL, buf, 100, 0, pl) <= 0)) {
+        fprintf(stderr, "%s: no data before seeking to %u ms\n", asset->name, ms);
+        return -1;
+    }
+    int tail = -1;
+    uint64_t t0 = bench_now_ns();
+    if (playlist_seek(pl, track, ms) == ESP_OK) {
+        // the rest of the frame being read, then the frame at ms
+        const mp3_index_t *prev = music_assets[playlist_get_current(pl)].index;
+        int before = playlist_tell(pl);
+        int n = playlist_read_cb(NULL, buf, READ_LEN, 0, pl);
+        *seek_ms = (bench_now_ns() - t0) / 1e6;
+        tail = n;
+        for (uint32_t f = 0; f <= prev->frame_count; f++) {
+            if (mp3_index_offset(prev, f) >= before) {
+                tail = mp3_index_offset(prev, f) - before;
+                break;
+            }
+        }
+        if (tail > n) {
+            tail = n;
+        }
+    }
+    uint32_t frame = mp3_index_frame_at(index, ms);
+    uint32_t off = mp3_index_offset(index, frame);
+    int check = READ_LEN - tail;
+    bool at_end = check >= index->end - off;   // the read went on into the next track
+    if (at_end) {
+        check = index->end - off;
+    }
+    if (tail < 0 || (!at_end && playlist_get_current(pl) != track) || memcmp(buf + tail, asset->start + off, check)) {
+        fprintf(stderr, "%s: seek to %u ms did not continue at frame %u\n", asset->name, ms, frame);
+        return -1;
+    }
+    // the read may have gone on into the frames after the target
+    uint32_t last = frame;
+    while (last + 1 < index->frame_count && mp3_index_offset(index, last + 1) < playlist_tell(pl)) {
+        last++;
+    }
+    if (!at_end && playlist_get_time_ms(pl) != mp3_index_frame_ms(index, last)) {
+        fprintf(stderr, "%s: at %u ms after seeking to %u ms\n", asset->name, playlist_get_time_ms(pl), ms);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Seek to the middle and read to the end, counting the frames handed out
+ */
+static int seek_and_finish(playlist_handle_t pl, int track) {
+    static char buf[READ_LEN];
+    const mp3_index_t *index = music_assets[track].index;
+    uint32_t half = mp3_index_duration_ms(index) / 2;
+    // from the start, the last seek may have run to the end of the playlist
+    if (playlist_seek(pl, track, 0) != ESP_OK || playlist_read_cb(NULL, buf, 100, 0, pl) <= 0) {
+        fprintf(stderr, "%s: no data after seeking to the start\n", music_assets[track].name);
+        return -1;
+    }
+    // the frame being read was counted when it started
+    int64_t start = playlist_get_pcm_pos(pl);
+    int64_t end = start;
+    if (playlist_seek(pl, track, half) != ESP_OK) {
+        return -1;
+    }
+    // byte by byte, to stop before the first frame of the next track is counted
+    while (playlist_read_cb(NULL, buf, 1, 0, pl) > 0 && playlist_get_current(pl) == track) {
+        end = playlist_get_pcm_pos(pl);
+    }
+    int64_t frames = (end - start) / (index->frame_samples * index->channels * 2);
+    int64_t expect = index->frame_count - mp3_index_frame_at(index, half);
+    if (frames != expect) {
+        fprintf(stderr, "%s: %lld frames after seeking to %u ms, expected %lld\n", music_assets[track].name,
+                (long long)frames, half, (long long)expect);
+        return -1;
+    }
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+    int seeks = argc > 1 ? atoi(argv[1]) : 1000;
+    if (seeks <= 0) {
+        fprintf(stderr, "usage: %s [seeks]\n", argv[0]);
+        return 2;
+    }
+    esp_log_level_set("*", ESP_LOG_ERROR);
+    srand(1);
+
+    playlist_cfg_t cfg = PLAYLIST_CFG_DEFAULT();
+    cfg.loop = false;
+    playlist_handle_t pl = playlist_create(music_assets, music_assets_count, &cfg);
+    if (!pl) {
+        return 1;
+    }
+    printf("%d seeks per asset\n", seeks);
+    printf("%-26s %6s %7s %8s %9s %9s %9s %9s %9s\n", "asset", "frames", "idx_b", "frame_ms", "scan10_ms",
+           "scan50_ms", "scan90_ms", "seek_ms", "max_ms");
+    int ret = 0;
+    for (int t = 0; t < music_assets_count && ret == 0; t++) {
+        const embed_asset_t *asset = &music_assets[t];
+        const mp3_index_t *index = asset->index;
+        if (!index || check_index(asset) != 0) {
+            fprintf(stderr, "%s: no valid frame index\n", asset->name);
+            ret = 1;
+            break;
+        }
+        double frame_ms = index->frame_samples * 1000.0 / index->sample_rate;
+        double total = 0, max = 0;
+        for (int i = 0; i < seeks; i++) {
+            double ms = 0;
+            if (timed_seek(pl, t, rand() % mp3_index_duration_ms(index), &ms) != 0) {
+                ret = 1;
+                break;
+            }
+            total += ms;
+            if (ms > max) {
+                max = ms;
+            }
+        }
+        if (ret == 0 && seek_and_finish(pl, t) != 0) {
+            ret = 1;
+        }
+        int index_bytes = index->frame_count * 2 + (index->frame_count + MP3_INDEX_BLOCK_FRAMES - 1)
+                          / MP3_INDEX_BLOCK_FRAMES * 4;
+        printf("%-26s %6u %7d %8.1f %9.4f %9.4f %9.4f %9.4f %9.4f\n", asset->name, index->frame_count, index_bytes,
+               frame_ms, scan_ms(asset, 10), scan_ms(asset, 50), scan_ms(asset, 90), total / seeks, max);
+        if (max >= frame_ms) {
+            fprintf(stderr, "%s: slowest seek %.3f ms, longer than a frame (%.1f ms)\n", asset->name, max, frame_ms);
+            ret = 1;
+        }
+    }
+    playlist_destroy(pl);
+    return ret;
+}
@@ -0,0 +1,291 @@
+/* Cost and smoothness of the software gain stage
+
+   The Q15 kernel of sw_gain.c is timed with the cycle counter on a block of
+   stereo PCM: at unity (a no-op), at a steady gain, and while ramping.
+   Cycles per sample (one channel) is the figure to compare with the target.
+
+   Then a gain element runs on full-scale DC, read in blocks of varying size,
+   while the volume is changed through audio_hal_set_volume() and the stub
+   codec's volume callback, as app_main does with SOFT_VOLUME: steps up and
+   down, a change in the middle of a ramp, mute and unmute. No two
+   consecutive output samples may differ by more than a ramp of full scale
+   over ramp_ms moves per frame, the output must settle on each volume's
+   gain, and left and right must stay equal.
+
+   Last, the assets play through playlist -> mp3 -> resampler -> gain -> sink,
+   as player_pipeline links them with soft_volume, to the end.
+
+   Usage: bench_sw_gain
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "esp_log.h"
+#include "audio_common.h"
+#include "board.h"
+#include "new_codec.h"
+#include "pcm_sink.h"
+#include "music_assets.h"
+#include "player_pipeline.h"
+#include "playlist.h"
+#include "latency_trace.h"
+#include "resample.h"
+#include "sw_gain.h"
+#include "bench_clock.h"
+
+#define RATE            44100
+#define RAMP_MS         20
+#define TIMED_FRAMES    1024
+#define TIMED_BLOCKS    20000
+#define DC              32767
+#define MAX_OUT_FRAMES  (RATE * 2)
+
+static int16_t timed_buf[TIMED_FRAMES * 2];
+
+typedef enum {
+    KERNEL_UNITY,
+    KERNEL_STEADY,
+    KERNEL_RAMP,
+} kernel_t;
+
+static double time_kernel(kernel_t kernel) {
+    for (int i = 0; i < TIMED_FRAMES * 2; i++) {
+        timed_buf[i] = (i * 997) & 0x7fff;
+    }
+    sw_gain_ramp_t r;
+    sw_gain_ramp_init(&r, kernel == KERNEL_UNITY ? SW_GAIN_UNITY : sw_gain_volume_to_q15(70));
+    uint64_t c0 = bench_cycles();
+    for (int b = 0; b < TIMED_BLOCKS; b++) {
+        if (kernel == KERNEL_RAMP) {
+            sw_gain_ramp_set(&r, b & 1 ? SW_GAIN_UNITY : sw_gain_volume_to_q15(30), TIMED_FRAMES);
+        }
+        sw_gain_apply(&r, timed_buf, TIMED_FRAMES, 2);
+    }
+    uint64_t c1 = bench_cycles();
+    return (double)(c1 - c0) / ((double)TIMED_BLOCKS * TIMED_FRAMES * 2);
+}
+
+typedef struct {
+    int16_t pcm[MAX_OUT_FRAMES * 2];
+    int frames;
+    int read_calls;
+} capture_t;
+
+static int dc_read(audio_element_handle_t el, char *buf, int len, TickType_t wait, void *ctx) {
+    capture_t *cap = (capture_t *)ctx;
+    // 64 to 1021 frames, not a divisor of the ramp
+    int frames = 64 + (cap->read_calls++ * 389) % 958;
+    if (frames * 4 > len) {
+        frames = len / 4;
+    }
+    for (int i = 0; i < frames * 2; i++) {
+        ((int16_t *)buf)[i] = DC;
+    }
+    return frames * 4;
+}
+
+static int capture_write(audio_element_handle_t el, char *buf, int len, TickType_t wait, void *ctx) {
+    capture_t *cap = (capture_t *)ctx;
+    int frames = len / 4;
+    if (cap->frames + frames > MAX_OUT_FRAMES) {
+        frames = MAX_OUT_FRAMES - cap->frames;
+    }
+    memcpy(&cap->pcm[cap->frames * 2], buf, frames * 4);
+    cap->frames += frames;
+    return len;
+}
+
+static void on_codec_volume(int volume, bool mute, void *ctx) {
+    sw_gain_set_volume((audio_element_handle_t)ctx, volume, mute);
+}
+
+/**
+ * @brief Output DC of a volume, as the steady kernel rounds it
+ */
+static int settled(int volume, bool mute) {
+    int32_t q = mute ? 0 : sw_gain_volume_to_q15(volume);
+    return (DC * q + (1 << 14)) >> 15;
+}
+
+static int check_ramps(void) {
+    static capture_t cap;
+    memset(&cap, 0, sizeof(cap));
+    audio_board_handle_t board = audio_board_init();
+    audio_hal_set_volume(board->audio_hal, 100);
+    audio_hal_set_mute(board->audio_hal, false);
+
+    sw_gain_cfg_t cfg = SW_GAIN_CFG_DEFAULT();
+    cfg.sample_rate = RATE;
+    cfg.ramp_ms = RAMP_MS;
+    audio_element_handle_t el = sw_gain_init(&cfg);
+    if (!el) {
+        return -1;
+    }
+    audio_element_set_read_cb(el, dc_read, &cap);
+    audio_element_set_write_cb(el, capture_write, &cap);
+    new_codec_set_volume_cb(on_codec_volume, el);
+    audio_element_run(el);
+
+    // volume (-1 mute, -2 unmute) and the output frame it is set at
+    const struct {
+        int at;
+        int volume;
+    } script[] = {
+        {4000, 50},
+        {10000, 100},
+        {10300, 10},        // in the middle of the ramp up
+        {20000, -1},
+        {26000, 0},         // while muted, no change
+        {30000, 70},
+        {36000, -2},
+        {42000, 100},
+        {48000, 1},
+        {54000, 100},
+    };
+    int n_script = sizeof(script) / sizeof(script[0]);
+    int next = 0;
+    int marks[16] = {0};
+    while (cap.frames < MAX_OUT_FRAMES - 1024) {
+        while (next < n_script && cap.frames >= script[next].at) {
+            if (script[next].volume == -1) {
+                audio_hal_set_mute(board->audio_hal, true);
+            } else if (script[next].volume == -2) {
+                audio_hal_set_mute(board->audio_hal, false);
+            } else {
+                audio_hal_set_volume(board->audio_hal, script[next].volume);
+            }
+            marks[next++] = cap.frames;
+        }
+        if (audio_element_host_step(el) <= 0) {
+            break;
+        }
+    }
+    new_codec_set_volume_cb(NULL, NULL);
+    audio_element_stop(el);
+    audio_element_deinit(el);
+    audio_board_deinit(board);
+
+    int ramp_frames = RATE * RAMP_MS / 1000;
+    int max_jump = (DC + ramp_frames - 1) / ramp_frames + 1;
+    int worst = 0, worst_at = 0;
+    for (int f = 0; f < cap.frames; f++) {
+        if (cap.pcm[2 * f] != cap.pcm[2 * f + 1]) {
+            fprintf(stderr, "left %d, right %d at frame %d\n", cap.pcm[2 * f], cap.pcm[2 * f + 1], f);
+            return -1;
+        }
+        int d = f ? abs(cap.pcm[2 * f] - cap.pcm[2 * f - 2]) : 0;
+        if (d > worst) {
+            worst = d;
+            worst_at = f;
+        }
+    }
+    printf("%d ms ramps (%d frames), %d frames out, largest step %d at frame %d, limit %d\n", RAMP_MS,
+           ramp_frames, cap.frames, worst, worst_at, max_jump);
+    if (worst > max_jump) {
+        fprintf(stderr, "discontinuity of %d at frame %d\n", worst, worst_at);
+        return -1;
+    }
+    // where every change has settled, the level must be exact
+    int volume = 100;
+    bool mute = false;
+    for (int s = 0; s < n_script; s++) {
+        if (script[s].volume == -1 || script[s].volume == -2) {
+            mute = script[s].volume == -1;
+        } else {
+            volume = script[s].volume;
+        }
+        int end = s + 1 < n_script ? marks[s + 1] : cap.frames;
+        // the change lands with the next block read, a ramp later it is done
+        int check = marks[s] + 1024 + ramp_frames;
+        if (check >= end) {
+            continue;
+        }
+        int want = settled(volume, mute);
+        printf("  frame %6d: volume %3d%s -> %5d\n", marks[s], volume, mute ? " muted" : "", cap.pcm[2 * check]);
+        for (int f = check; f < end; f++) {
+            if (cap.pcm[2 * f] != want) {
+                fprintf(stderr, "volume %d%s: %d at frame %d, expected %d\n", volume, mute ? " muted" : "",
+                        cap.pcm[2 * f], f, want);
+                return -1;
+            }
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief on_decoder_output() of app_main without the PCM cache
+ */
+static void on_decoder_output(void *ctx, int64_t pos, const char *buf, int len) {
+    player_pipeline_t *pp = (player_pipeline_t *)ctx;
+    audio_element_info_t info = {0};
+    audio_element_getinfo(pp->mp3_decoder, &info);
+    resample_input_written(pp->resampler, info.sample_rates, info.channels, len);
+}
+
+static int play_soft_volume(void) {
+    playlist_cfg_t playlist_cfg = PLAYLIST_CFG_DEFAULT();
+    playlist_cfg.loop = false;
+    playlist_handle_t playlist = playlist_create(music_assets, music_assets_count, &playlist_cfg);
+    pcm_sink_cfg_t sink_cfg = PCM_SINK_CFG_DEFAULT();
+    player_pipeline_t player;
+    player_pipeline_cfg_t player_cfg = PLAYER_PIPELINE_CFG_DEFAULT();
+    player_cfg.read_cb = playlist_read_cb;
+    player_cfg.read_ctx = playlist;
+    player_cfg.output_rate = RATE;
+    player_cfg.soft_volume = true;
+    latency_trace_handle_t lt = latency_trace_create();
+    if (!playlist || !lt || player_pipeline_create(&player, &player_cfg, pcm_sink_init(&sink_cfg)) != ESP_OK
+        || !player.gain || latency_trace_attach(lt, player.mp3_decoder, player.resampler) != ESP_OK) {
+        fprintf(stderr, "soft_volume pipeline not created\n");
+        return -1;
+    }
+    latency_trace_set_output_cb(lt, on_decoder_output, &player);
+    sw_gain_set_volume(player.gain, 60, false);
+
+    audio_pipeline_run(player.pipeline);
+    int idle = 0;
+    while (audio_element_get_state(player.sink) == AEL_STATE_RUNNING && idle < 1000) {
+        int progress = audio_element_host_step(player.sink);
+        progress |= audio_element_host_step(player.gain);
+        progress |= audio_element_host_step(player.resampler);
+        progress |= audio_element_host_step(player.mp3_decoder);
+        idle = progress ? 0 : idle + 1;
+    }
+    int ret = audio_element_get_state(player.sink) == AEL_STATE_FINISHED ? 0 : -1;
+    audio_element_info_t info = {0};
+    audio_element_getinfo(player.gain, &info);
+    printf("pipeline with soft_volume: %lld frames at %d Hz, %s\n", (long long)pcm_sink_get_bytes(player.sink) / 4,
+           info.sample_rates, ret == 0 ? "finished" : "stalled");
+    if (pcm_sink_get_bytes(player.sink) == 0) {
+        ret = -1;
+    }
+
+    latency_trace_detach(lt);
+    player_pipeline_stop(&player);
+    player_pipeline_destroy(&player);
+    playlist_destroy(playlist);
+    latency_trace_destroy(lt);
+    return ret;
+}
+
+int main(int argc, char *argv[]) {
+    esp_log_level_set("*", ESP_LOG_ERROR);
+
+    printf("Q15 gain, %d frame stereo blocks\n", TIMED_FRAMES);
+    printf("%-8s %14s\n", "kernel", "cycles/sample");
+    printf("%-8s %14.2f\n", "unity", time_kernel(KERNEL_UNITY));
+    printf("%-8s %14.2f\n", "steady", time_kernel(KERNEL_STEADY));
+    printf("%-8s %14.2f\n", "ramp", time_kernel(KERNEL_RAMP));
+    printf("\n");
+
+    int ret = 0;
+    if (check_ramps() != 0) {
+        ret = 1;
+    }
+    if (play_soft_volume() != 0) {
+        ret = 1;
+    }
+    return ret;
+}
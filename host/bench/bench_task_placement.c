@@ -0,0 +1,416 @@
+/* Core contention of the player's tasks, the fixed placement vs. the one planned from a profile
+
+   A two-core fixed-priority preemptive scheduler, FreeRTOS style: the
+   highest priority ready task runs, equal priorities take turns at every
+   10 ms tick, unpinned tasks run on whichever core is free. The tasks are
+   periodic models of the player's, cost per job as measured on the ESP32
+   at 240 MHz playing the 44.1 kHz asset with the FAT check running:
+
+   mp3, resample, gain  one job per 1152-sample frame (26 ms), priority 5
+   i2s                  one job per DMA buffer (11.6 ms), priority 23
+   FATFS                the FAT check every 2 s, priority 4
+   storage_flush        the sector cache flush, unpinned, priority 2
+   telemetry            one record period (100 ms), priority 2
+   esp_timer, main      not in the placement table, core 0
+
+   The fixed placement is the one the player had: decoder chain, i2s and FAT
+   worker all on core 0, telemetry on core 1. task_profiler samples the
+   simulated run every 10 ms as its task would uxTaskGetSystemState();
+   task_placement_plan() takes its loads, and the planned placement runs
+   again. Per task the share of its core, the time it waited ready but not
+   running, and its job response times are printed.
+
+   Checks, exit status 1 if any fails:
+   - the profiled run time of each task and busy time of each core match
+     the simulated ones; the ready samples of every task that waited for 5%
+     of the run or more match its simulated wait within 25%;
+   - the planned placement lowers the busiest core's load, and the mp3 and
+     FAT worker worst response times and mp3 wait;
+   - planning again from the planned run moves nothing;
+   - the plan survives task_placement_save() and task_placement_restore(),
+     and a table with other tasks does not take it.
+
+   Usage: bench_task_placement [seconds]
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "esp_log.h"
+#include "nvs.h"
+#include "task_placement.h"
+#include "task_profiler.h"
+
+#define STEP_US         50
+#define TICK_US         10000
+#define SAMPLE_US       10000
+#define NVS_NAMESPACE   "player"
+
+typedef struct {
+    const char *name;
+    bool in_table;
+    int prio;
+    int period_us;
+    int exec_us;
+    int jitter_us;          // exec_us +- this, uniform
+    int offset_us;          // first release
+} model_t;
+
+static const model_t models[] = {
+    {"mp3", true, 5, 26122, 6500, 1500, 0},
+    {"resample", true, 5, 26122, 2900, 400, 1500},
+    {"gain", true, 5, 26122, 600, 100, 2500},
+    {"i2s", true, 23, 11610, 400, 100, 300},
+    {"FATFS", true, 4, 2000000, 25000, 5000, 5000000},
+    {"storage_flush", true, 2, 1000000, 300, 100, 700000},
+    {"telemetry", true, 2, 100000, 800, 200, 50000},
+    {"esp_timer", false, 22, 10000, 150, 50, 0},
+    {"main", false, 1, 100000, 200, 50, 20000},
+};
+
+#define NUM_MODELS  (sizeof(models) / sizeof(models[0]))
+
+// the player's table before it was planned; file_stream does not run with the embedded playlist
+static const task_placement_t fixed_table[] = {
+    {"mp3", TASK_CLASS_AUDIO, 0, 5, 5 * 1024, false},
+    {"resample", TASK_CLASS_AUDIO, 0, 5, 3 * 1024, true},
+    {"gain", TASK_CLASS_AUDIO, 0, 5, 2 * 1024, true},
+    {"i2s", TASK_CLASS_AUDIO, 0, 23, 3 * 1024, false},
+    {"FATFS", TASK_CLASS_STORAGE, 0, 4, 2048, false},
+    {"file_stream", TASK_CLASS_STORAGE, 0, 4, 3072, false},
+    {"storage_flush", TASK_CLASS_STORAGE, TASK_PLACEMENT_ANY_CORE, 2, 3072, false},
+    {"telemetry", TASK_CLASS_BACKGROUND, 1, 2, 2048, false},
+};
+
+#define NUM_TABLE   (sizeof(fixed_table) / sizeof(fixed_table[0]))
+
+typedef struct {
+    int core;               // TASK_PLACEMENT_ANY_CORE if unpinned
+    int64_t next_release;
+    int64_t job_release;    // of the oldest unfinished job
+    int remaining;
+    int64_t run_us;
+    int64_t wait_us;
+    uint32_t jobs;
+    int64_t response_sum;
+    int64_t worst_us;
+    uint32_t overruns;      // released again before the last job was done
+} sim_task_t;
+
+typedef struct {
+    sim_task_t task[NUM_MODELS];
+    int64_t idle_us[TASK_PLACEMENT_NUM_CORES];
+    int64_t elapsed;
+} sim_result_t;
+
+static uint32_t seed;
+
+static uint32_t rnd(void) {
+    seed = seed * 1103515245 + 12345;
+    return seed >> 8;
+}
+
+static int exec_us(const model_t *m) {
+    return m->exec_us - m->jitter_us + (int)(rnd() % (2 * m->jitter_us + 1));
+}
+
+static int table_core(const task_placement_t *table, const char *name) {
+    for (int i = 0; i < (int)NUM_TABLE; i++) {
+        if (!strcmp(table[i].name, name)) {
+            return table[i].core;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Whether task i can run on core, next[0] being what core 0 took already when core is 1
+ */
+static bool eligible(const sim_result_t *res, int i, int core, const int next[TASK_PLACEMENT_NUM_CORES]) {
+    const sim_task_t *t = &res->task[i];
+    if (t->remaining <= 0 || (core > 0 && next[0] == i)) {
+        return false;
+    }
+    return t->core == TASK_PLACEMENT_ANY_CORE || t->core == core;
+}
+
+/**
+ * @brief Run the models for run_s with the cores of table, feeding prof a sample every SAMPLE_US
+ */
+static void simulate(const task_placement_t *table, int run_s, task_profiler_handle_t prof, sim_result_t *res) {
+    memset(res, 0, sizeof(*res));
+    seed = 2024;
+    for (int i = 0; i < (int)NUM_MODELS; i++) {
+        sim_task_t *t = &res->task[i];
+        t->core = models[i].in_table ? table_core(table, models[i].name) : 0;
+        t->next_release = models[i].offset_us;
+    }
+    int running[TASK_PLACEMENT_NUM_CORES] = {-1, -1};
+    int next[TASK_PLACEMENT_NUM_CORES] = {-1, -1};
+    int last[TASK_PLACEMENT_NUM_CORES] = {-1, -1};          // round robin position per core
+    int64_t end = (int64_t)run_s * 1000000;
+    for (int64_t now = 0; now < end; now += STEP_US) {
+        for (int i = 0; i < (int)NUM_MODELS; i++) {
+            sim_task_t *t = &res->task[i];
+            if (now >= t->next_release) {
+                if (t->remaining > 0) {
+                    t->overruns++;
+                } else {
+                    t->job_release = t->next_release;
+                }
+                t->remaining += exec_us(&models[i]);
+                t->next_release += models[i].period_us;
+            }
+        }
+        bool tick = now % TICK_US == 0;
+        for (int c = 0; c < TASK_PLACEMENT_NUM_CORES; c++) {
+            int best_prio = -1;
+            for (int i = 0; i < (int)NUM_MODELS; i++) {
+                if (eligible(res, i, c, next) && models[i].prio > best_prio) {
+                    best_prio = models[i].prio;
+                }
+            }
+            next[c] = -1;
+            if (best_prio < 0) {
+                continue;
+            }
+            int cur = running[c];
+            bool others = false;
+            for (int i = 0; i < (int)NUM_MODELS; i++) {
+                others |= i != cur && models[i].prio == best_prio && eligible(res, i, c, next);
+            }
+            // the running task keeps the core unless outranked, or its slice ends with an equal one waiting
+            if (cur >= 0 && models[cur].prio == best_prio && eligible(res, cur, c, next) && !(tick && others)) {
+                next[c] = cur;
+                continue;
+            }
+            for (int k = 1; k <= (int)NUM_MODELS; k++) {
+                int i = (last[c] + k + (int)NUM_MODELS) % (int)NUM_MODELS;
+                if (models[i].prio == best_prio && eligible(res, i, c, next)) {
+                    next[c] = i;
+                    break;
+                }
+            }
+        }
+        if (prof && now % SAMPLE_US == SAMPLE_US / 2) {
+            task_profiler_snapshot_t snap[NUM_MODELS + TASK_PLACEMENT_NUM_CORES];
+            int n = 0;
+            for (int i = 0; i < (int)NUM_MODELS; i++) {
+                const sim_task_t *t = &res->task[i];
+                snap[n++] = (task_profiler_snapshot_t) {
+                    .name = models[i].name,
+                    .core = t->core,
+                    .runtime = (uint32_t)t->run_us,
+                    .ready = t->remaining > 0 && next[0] != i && next[1] != i,
+                };
+            }
+            static const char *idle_name[] = {"IDLE0", "IDLE1"};
+            for (int c = 0; c < TASK_PLACEMENT_NUM_CORES; c++) {
+                snap[n++] = (task_profiler_snapshot_t) {
+                    .name = idle_name[c], .core = c, .runtime = (uint32_t)res->idle_us[c], .idle = true,
+                };
+            }
+            task_profiler_sample(prof, snap, n, now);
+        }
+        for (int c = 0; c < TASK_PLACEMENT_NUM_CORES; c++) {
+            running[c] = next[c];
+            if (next[c] < 0) {
+                res->idle_us[c] += STEP_US;
+                continue;
+            }
+            last[c] = next[c];
+            sim_task_t *t = &res->task[next[c]];
+            t->run_us += STEP_US;
+            t->remaining -= STEP_US;
+            if (t->remaining <= 0) {
+                int64_t response = now + STEP_US - t->job_release;
+                t->jobs++;
+                t->response_sum += response;
+                if (response > t->worst_us) {
+                    t->worst_us = response;
+                }
+                t->remaining = 0;
+                t->job_release = t->next_release;
+            }
+        }
+        for (int i = 0; i < (int)NUM_MODELS; i++) {
+            if (res->task[i].remaining > 0 && next[0] != i && next[1] != i) {
+                res->task[i].wait_us += STEP_US;
+            }
+        }
+    }
+    res->elapsed = end;
+}
+
+static int core_load(const sim_result_t *r, int core) {
+    return (int)((r->elapsed - r->idle_us[core]) * 1000 / r->elapsed);
+}
+
+static int find_model(const char *name) {
+    for (int i = 0; i < (int)NUM_MODELS; i++) {
+        if (!strcmp(models[i].name, name)) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static void print_run(const char *what, const sim_result_t *r) {
+    printf("%s: core 0 %.1f%% busy, core 1 %.1f%% busy\n", what, core_load(r, 0) / 10.0, core_load(r, 1) / 10.0);
+    printf("  %-14s %4s %7s %10s %12s %12s %8s\n", "task", "core", "cpu %", "waited ms", "mean resp ms", "worst resp ms",
+           "overruns");
+    for (int i = 0; i < (int)NUM_MODELS; i++) {
+        const sim_task_t *t = &r->task[i];
+        char core[4] = "any";
+        if (t->core != TASK_PLACEMENT_ANY_CORE) {
+            snprintf(core, sizeof(core), "%d", t->core);
+        }
+        printf("  %-14s %4s %7.1f %10.1f %12.2f %12.2f %8u\n", models[i].name, core, t->run_us * 100.0 / r->elapsed,
+               t->wait_us / 1000.0, t->jobs ? t->response_sum / 1000.0 / t->jobs : 0, t->worst_us / 1000.0,
+               t->overruns);
+    }
+}
+
+/**
+ * @brief The profile against the simulated run it sampled
+ */
+static int check_profile(task_profiler_handle_t prof, const sim_result_t *r) {
+    int ret = 0;
+    for (int i = 0; i < (int)NUM_MODELS; i++) {
+        task_profiler_task_t pt;
+        if (task_profiler_get_task(prof, models[i].name, &pt) != ESP_OK) {
+            fprintf(stderr, "%s: not profiled\n", models[i].name);
+            ret = 1;
+            continue;
+        }
+        // the profile starts at the first sample, half a period in
+        int64_t diff = (int64_t)pt.runtime_us - r->task[i].run_us;
+        if (llabs(diff) > 2 * SAMPLE_US) {
+            fprintf(stderr, "%s: profiled %llu us of run time, simulated %lld\n", models[i].name,
+                    (unsigned long long)pt.runtime_us, (long long)r->task[i].run_us);
+            ret = 1;
+        }
+    }
+    for (int c = 0; c < TASK_PLACEMENT_NUM_CORES; c++) {
+        if (abs(task_profiler_core_permille(prof, c) - core_load(r, c)) > 1) {
+            fprintf(stderr, "core %d: profiled %d permille busy, simulated %d\n", c, task_profiler_core_permille(prof, c),
+                    core_load(r, c));
+            ret = 1;
+        }
+    }
+    // a sample every SAMPLE_US only sees waits long against it
+    for (int i = 0; i < (int)NUM_MODELS; i++) {
+        task_profiler_task_t pt;
+        task_profiler_get_task(prof, models[i].name, &pt);
+        double sampled = (double)pt.preempted * SAMPLE_US;
+        const sim_task_t *t = &r->task[i];
+        if (t->wait_us * 20 < r->elapsed) {
+            continue;
+        }
+        printf("  %s found ready in %u of %u samples: ~%.0f ms waited, simulated %.0f ms\n", models[i].name,
+               pt.preempted, pt.samples, sampled / 1000, t->wait_us / 1000.0);
+        if (sampled < t->wait_us * 0.75 || sampled > t->wait_us * 1.25) {
+            fprintf(stderr, "%s: ready samples off the simulated wait by more than 25%%\n", models[i].name);
+            ret = 1;
+        }
+    }
+    return ret;
+}
+
+int main(int argc, char *argv[]) {
+    int run_s = argc > 1 ? atoi(argv[1]) : 120;
+    if (run_s <= 0) {
+        fprintf(stderr, "usage: %s [seconds]\n", argv[0]);
+        return 2;
+    }
+    esp_log_level_set("*", ESP_LOG_ERROR);
+    int ret = 0;
+    static sim_result_t fixed, planned, again;
+    task_placement_t table[NUM_TABLE];
+    memcpy(table, fixed_table, sizeof(table));
+    if (task_placement_init(table, NUM_TABLE) != ESP_OK) {
+        return 1;
+    }
+    task_profiler_cfg_t prof_cfg = TASK_PROFILER_CFG_DEFAULT();
+    task_profiler_handle_t prof = task_profiler_create(&prof_cfg);
+
+    simulate(table, run_s, prof, &fixed);
+    print_run("fixed placement", &fixed);
+    ret |= check_profile(prof, &fixed);
+
+    task_load_t loads[TASK_PROFILER_MAX_TASKS];
+    int other[TASK_PLACEMENT_NUM_CORES];
+    int n = task_profiler_get_loads(prof, loads, TASK_PROFILER_MAX_TASKS, other);
+    int moved = task_placement_plan(loads, n, other);
+    printf("\nplanned from the profile, %d tasks moved, %d.%d%% and %d.%d%% of the cores outside the table\n", moved,
+           other[0] / 10, other[0] % 10, other[1] / 10, other[1] % 10);
+    for (int i = 0; i < (int)NUM_TABLE; i++) {
+        if (table[i].core != fixed_table[i].core) {
+            printf("  %-14s core %d -> %d\n", table[i].name, fixed_table[i].core, table[i].core);
+        }
+    }
+    printf("\n");
+
+    task_profiler_reset(prof);
+    simulate(table, run_s, prof, &planned);
+    print_run("planned placement", &planned);
+    ret |= check_profile(prof, &planned);
+
+    int busiest_fixed = core_load(&fixed, 0) > core_load(&fixed, 1) ? core_load(&fixed, 0) : core_load(&fixed, 1);
+    int busiest_planned = core_load(&planned, 0) > core_load(&planned, 1) ? core_load(&planned, 0)
+                          : core_load(&planned, 1);
+    int mp3 = find_model("mp3");
+    int fat = find_model("FATFS");
+    if (moved == 0 || busiest_planned >= busiest_fixed) {
+        fprintf(stderr, "planned: the busiest core is no less busy\n");
+        ret = 1;
+    }
+    if (planned.task[mp3].worst_us >= fixed.task[mp3].worst_us || planned.task[mp3].wait_us >= fixed.task[mp3].wait_us) {
+        fprintf(stderr, "planned: mp3 waits no less\n");
+        ret = 1;
+    }
+    if (planned.task[fat].worst_us >= fixed.task[fat].worst_us) {
+        fprintf(stderr, "planned: the FAT worker waits no less\n");
+        ret = 1;
+    }
+
+    n = task_profiler_get_loads(prof, loads, TASK_PROFILER_MAX_TASKS, other);
+    task_placement_t replan[NUM_TABLE];
+    memcpy(replan, table, sizeof(replan));
+    task_placement_init(replan, NUM_TABLE);
+    if (task_placement_plan(loads, n, other) != 0) {
+        fprintf(stderr, "planning again from the planned run moves tasks\n");
+        ret = 1;
+    }
+    // what the player does for the next boot, on the host model of NVS
+    task_placement_init(table, NUM_TABLE);
+    nvs_host_format(0x6000);
+    if (task_placement_save(NVS_NAMESPACE, NULL) != ESP_OK) {
+        fprintf(stderr, "task_placement_save() failed\n");
+        ret = 1;
+    }
+    task_placement_t boot[NUM_TABLE];
+    memcpy(boot, fixed_table, sizeof(boot));
+    task_placement_init(boot, NUM_TABLE);
+    if (task_placement_restore(NVS_NAMESPACE) != ESP_OK || memcmp(boot, table, sizeof(boot))) {
+        fprintf(stderr, "the restored placement is not the saved one\n");
+        ret = 1;
+    }
+    task_placement_t other_tasks[NUM_TABLE - 1];
+    memcpy(other_tasks, fixed_table, sizeof(other_tasks));
+    task_placement_init(other_tasks, NUM_TABLE - 1);
+    if (task_placement_restore(NVS_NAMESPACE) != ESP_ERR_NOT_FOUND
+        || memcmp(other_tasks, fixed_table, sizeof(other_tasks))) {
+        fprintf(stderr, "a table with other tasks took the saved placement\n");
+        ret = 1;
+    }
+
+    // the planned run again without the profiler, it must not change what it measures
+    simulate(table, run_s, NULL, &again);
+    if (memcmp(&again, &planned, sizeof(again))) {
+        fprintf(stderr, "the profiler changed the simulated run\n");
+        ret = 1;
+    }
+    task_profiler_destroy(prof);
+    return ret;
+}
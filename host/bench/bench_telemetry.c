@@ -0,0 +1,382 @@
+/* Cost and accuracy of the pipeline telemetry
+
+   Overhead: the hooks on the audio path (the decoder's read callback, its
+   output observer, the i2s writer's input tap) and the periodic flush are
+   timed with the cycle counter, and weighted by how often they run when
+   playing 44.1 kHz stereo mp3: one decoder output and read per 1152-frame
+   mp3 frame, one i2s read per 3600 bytes, one flush per period. The total
+   must stay under 1% of a 240 MHz core. Host cycles stand in for ESP32
+   ones; the margin is wide enough for the difference.
+
+   Underruns: an i2s writer is simulated on the clock, reading 3600 bytes
+   whenever its DMA has room and polling every ms while the ring buffer is
+   empty, fed by a decoder that stalls for a while now and then, as it does
+   on a FAT or flash stall. The underruns and gaps the tap counts must match
+   the ones the simulated DMA actually had.
+
+   Decode time: decoder outputs are driven with known decode, input wait and
+   output wait times; the decode times in the FRAMES records must be the
+   known ones.
+
+   Every record of the stream is parsed back and its checksum checked. With
+   a file argument the stream is also written there, for
+   tools/telemetry_decode.py.
+
+   Usage: bench_telemetry [capture.bin]
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "ringbuf.h"
+#include "pcm_sink.h"
+#include "telemetry.h"
+#include "bench_clock.h"
+
+#define RATE            44100
+#define FRAME_BYTES     4
+#define MP3_FRAME_PCM   (1152 * FRAME_BYTES)
+#define I2S_READ        3600
+#define DMA_BUF_COUNT   6
+#define DMA_BUF_LEN     512
+#define DMA_US          ((int64_t)DMA_BUF_COUNT * DMA_BUF_LEN * 1000000 / RATE)
+#define RB_SIZE         (8 * 1024)
+#define PERIOD_MS       100
+#define CORE_HZ         240000000.0
+#define TIMED_CALLS     200000
+#define CAPTURE_MAX     (1024 * 1024)
+
+static uint8_t capture[CAPTURE_MAX];
+static int captured;
+
+static int capture_out(void *ctx, const uint8_t *buf, int len) {
+    if (captured + len > CAPTURE_MAX) {
+        return 0;
+    }
+    memcpy(&capture[captured], buf, len);
+    captured += len;
+    return len;
+}
+
+static int null_out(void *ctx, const uint8_t *buf, int len) {
+    return len;
+}
+
+static int64_t source_wait_us;
+
+static int sim_source(audio_element_handle_t el, char *buf, int len, TickType_t wait, void *ctx) {
+    esp_timer_host_advance(source_wait_us);
+    return len;
+}
+
+static int64_t us_of(int bytes) {
+    return (int64_t)bytes * 1000000 / (RATE * FRAME_BYTES);
+}
+
+static audio_element_handle_t make_writer(ringbuf_handle_t rb) {
+    pcm_sink_cfg_t cfg = PCM_SINK_CFG_DEFAULT();
+    audio_element_handle_t el = pcm_sink_init(&cfg);
+    audio_element_set_music_info(el, RATE, 2, 16);
+    audio_element_set_input_ringbuf(el, rb);
+    return el;
+}
+
+/**
+ * @brief Cycles per call of each hook, and the share of a core they take together when playing
+ */
+static int check_overhead(void) {
+    telemetry_cfg_t cfg = TELEMETRY_CFG_DEFAULT();
+    cfg.task_stack = 0;
+    cfg.dma_us = DMA_US;
+    cfg.out = null_out;
+    telemetry_handle_t tm = telemetry_create(&cfg);
+    ringbuf_handle_t rb = rb_create(RB_SIZE, 1);
+    ringbuf_handle_t rb2 = rb_create(RB_SIZE, 1);
+    audio_element_handle_t writer = make_writer(rb);
+    telemetry_watch_ringbuf(tm, rb);
+    telemetry_watch_ringbuf(tm, rb2);
+    telemetry_attach(tm, writer);
+    telemetry_set_source(tm, sim_source, NULL);
+    source_wait_us = 0;
+    static char pcm[MP3_FRAME_PCM];
+
+    uint64_t c0 = bench_cycles();
+    for (int i = 0; i < TIMED_CALLS; i++) {
+        telemetry_read_cb(NULL, pcm, 512, 0, tm);
+    }
+    uint64_t c1 = bench_cycles();
+    for (int i = 0; i < TIMED_CALLS; i++) {
+        telemetry_decoder_output(tm, 0);
+        if ((i & 63) == 63) {
+            telemetry_flush(tm);
+        }
+    }
+    uint64_t c2 = bench_cycles();
+    uint64_t write_cycles = 0;
+    for (int i = 0; i < TIMED_CALLS; i++) {
+        uint64_t w0 = bench_cycles();
+        rb_write(rb, pcm, I2S_READ, 0);
+        write_cycles += bench_cycles() - w0;
+        audio_element_input(writer, pcm, I2S_READ);
+    }
+    uint64_t c3 = bench_cycles();
+    // the tap costs what it adds to the plain ring buffer read
+    telemetry_detach(tm);
+    for (int i = 0; i < TIMED_CALLS; i++) {
+        rb_write(rb, pcm, I2S_READ, 0);
+        audio_element_input(writer, pcm, I2S_READ);
+    }
+    uint64_t c4 = bench_cycles();
+    for (int i = 0; i < 64; i++) {
+        telemetry_decoder_output(tm, 0);
+    }
+    uint64_t f0 = bench_cycles();
+    telemetry_flush(tm);
+    uint64_t f1 = bench_cycles();
+    telemetry_flush(tm);
+    uint64_t f2 = bench_cycles();
+
+    double source_cost = (double)(c1 - c0) / TIMED_CALLS;
+    double output_cost = (double)(c2 - c1) / TIMED_CALLS;
+    double tap_cost = ((double)(c3 - c2) - (double)(c4 - c3)) / TIMED_CALLS;
+    if (tap_cost < 0) {
+        tap_cost = 0;
+    }
+    double flush_cost = (double)(f1 - f0 > f2 - f1 ? f1 - f0 : f2 - f1);
+    double mp3_frames = RATE / 1152.0;
+    double reads = RATE * FRAME_BYTES / (double)I2S_READ;
+    double flushes = 1000.0 / PERIOD_MS;
+    double per_s = source_cost * mp3_frames + output_cost * mp3_frames + tap_cost * reads + flush_cost * flushes;
+    double share = per_s / CORE_HZ * 100;
+    printf("%-22s %10s %10s %12s\n", "hook", "cycles", "calls/s", "cycles/s");
+    printf("%-22s %10.0f %10.1f %12.0f\n", "decoder read", source_cost, mp3_frames, source_cost * mp3_frames);
+    printf("%-22s %10.0f %10.1f %12.0f\n", "decoder output", output_cost, mp3_frames, output_cost * mp3_frames);
+    printf("%-22s %10.0f %10.1f %12.0f\n", "i2s input tap", tap_cost, reads, tap_cost * reads);
+    printf("%-22s %10.0f %10.1f %12.0f\n", "flush", flush_cost, flushes, flush_cost * flushes);
+    printf("total %.0f cycles/s, %.4f%% of a 240 MHz core (limit 1%%)\n\n", per_s, share);
+
+    telemetry_destroy(tm);
+    audio_element_deinit(writer);
+    rb_destroy(rb);
+    rb_destroy(rb2);
+    return share < 1.0 ? 0 : -1;
+}
+
+typedef struct {
+    int64_t at_ms;
+    int64_t for_ms;
+} stall_t;
+
+/**
+ * @brief Simulated writer against what the tap counts
+ */
+static int check_underruns(void) {
+    static const stall_t stalls[] = {
+        {1000, 30},     // the buffers cover it
+        {2500, 100},    // just about
+        {4000, 300},
+        {6000, 150},
+        {8000, 1000},
+    };
+    const int n_stalls = sizeof(stalls) / sizeof(stalls[0]);
+    const int64_t run_us = 10000000;
+
+    telemetry_cfg_t cfg = TELEMETRY_CFG_DEFAULT();
+    cfg.task_stack = 0;
+    cfg.dma_us = DMA_US;
+    cfg.period_ms = PERIOD_MS;
+    cfg.out = capture_out;
+    telemetry_handle_t tm = telemetry_create(&cfg);
+    ringbuf_handle_t rb = rb_create(RB_SIZE, 1);
+    audio_element_handle_t writer = make_writer(rb);
+    telemetry_watch_ringbuf(tm, rb);
+    telemetry_attach(tm, writer);
+
+    static char pcm[MP3_FRAME_PCM];
+    int64_t start = esp_timer_get_time();
+    int64_t writer_at = start;       // when the writer comes for input next
+    int64_t dma_end = 0;             // when the simulated DMA runs dry
+    int64_t next_flush = start + PERIOD_MS * 1000;
+    int truth = 0;
+    int64_t truth_us = 0;
+    int64_t now;
+    while ((now = esp_timer_get_time()) - start < run_us) {
+        int64_t t_ms = (now - start) / 1000;
+        bool stalled = false;
+        for (int s = 0; s < n_stalls; s++) {
+            stalled |= t_ms >= stalls[s].at_ms && t_ms < stalls[s].at_ms + stalls[s].for_ms;
+        }
+        // the decoder runs ahead until the buffer is full
+        while (!stalled && rb_bytes_available(rb) >= MP3_FRAME_PCM) {
+            rb_write(rb, pcm, MP3_FRAME_PCM, 0);
+        }
+        if (now >= writer_at) {
+            int n = audio_element_input(writer, pcm, I2S_READ);
+            if (n > 0) {
+                int64_t t = esp_timer_get_time();
+                if (dma_end && t > dma_end) {
+                    truth++;
+                    truth_us += t - dma_end;
+                }
+                dma_end = (dma_end > t ? dma_end : t) + us_of(n);
+                // i2s_write() returns once the block fits in the DMA
+                writer_at = dma_end - DMA_US;
+            } else {
+                writer_at = now + 1000;
+            }
+        }
+        if (now >= next_flush) {
+            telemetry_flush(tm);
+            next_flush += PERIOD_MS * 1000;
+        }
+        int64_t next = writer_at < next_flush ? writer_at : next_flush;
+        // one ms steps at most, so the decoder sees the stalls begin and end
+        int64_t step = next - esp_timer_get_time();
+        esp_timer_host_advance(step < 1 ? 1 : step > 1000 ? 1000 : step);
+    }
+    telemetry_flush(tm);
+    telemetry_stats_t st;
+    telemetry_get_stats(tm, &st);
+    telemetry_detach(tm);
+    telemetry_destroy(tm);
+    audio_element_deinit(writer);
+    rb_destroy(rb);
+
+    printf("%d stalls in %lld s, DMA %lld us, ring buffer %d bytes (%lld us)\n", n_stalls,
+           (long long)(run_us / 1000000), (long long)DMA_US, RB_SIZE, (long long)us_of(RB_SIZE));
+    printf("underruns: simulated DMA %d (%.1f ms), telemetry %u (%.1f ms)\n\n", truth, truth_us / 1000.0,
+           st.underruns, st.underrun_us / 1000.0);
+    // polling at 1 ms: each gap may be off by that much
+    if ((int)st.underruns != truth || llabs(st.underrun_us - truth_us) > 1000LL * (truth + 1)) {
+        fprintf(stderr, "telemetry counted %u underruns, %lld us; the DMA had %d, %lld us\n", st.underruns,
+                (long long)st.underrun_us, truth, (long long)truth_us);
+        return -1;
+    }
+    return truth > 0 ? 0 : -1;
+}
+
+#define DECODE_FRAMES   500
+
+static uint16_t decode_truth[DECODE_FRAMES];
+
+/**
+ * @brief Known decode times in, FRAMES records out
+ */
+static int drive_decoder(void) {
+    telemetry_cfg_t cfg = TELEMETRY_CFG_DEFAULT();
+    cfg.task_stack = 0;
+    cfg.dma_us = DMA_US;
+    cfg.out = capture_out;
+    telemetry_handle_t tm = telemetry_create(&cfg);
+    telemetry_set_source(tm, sim_source, NULL);
+    static char buf[512];
+    int64_t next_flush = esp_timer_get_time() + PERIOD_MS * 1000;
+    // the first output only starts the clock
+    telemetry_decoder_output(tm, 0);
+    for (int f = 0; f < DECODE_FRAMES; f++) {
+        int64_t decode = 4000 + (f * 7919) % 9000;
+        int64_t write_wait = (f % 3) * 10000;
+        source_wait_us = (f % 5) ? 0 : 20000;
+        decode_truth[f] = decode;
+        telemetry_read_cb(NULL, buf, sizeof(buf), 0, tm);
+        esp_timer_host_advance(decode);
+        esp_timer_host_advance(write_wait);
+        telemetry_decoder_output(tm, write_wait);
+        if (esp_timer_get_time() >= next_flush) {
+            telemetry_flush(tm);
+            next_flush += PERIOD_MS * 1000;
+        }
+    }
+    telemetry_flush(tm);
+    telemetry_destroy(tm);
+    return 0;
+}
+
+static uint32_t get_u16(const uint8_t *p) {
+    return p[0] | p[1] << 8;
+}
+
+static uint32_t get_u32(const uint8_t *p) {
+    return p[0] | p[1] << 8 | p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+/**
+ * @brief Parse the capture of drive_decoder() and compare the decode times
+ */
+static int check_stream(int from) {
+    int records[TELEMETRY_REC_UNDERRUN + 1] = {0};
+    int frames = 0, bad = 0;
+    int64_t worst = 0;
+    for (int i = from; i < captured;) {
+        if (capture[i] != TELEMETRY_SYNC || i + 4 > captured || i + 4 + capture[i + 2] > captured) {
+            fprintf(stderr, "stream out of sync at byte %d\n", i);
+            return -1;
+        }
+        uint8_t type = capture[i + 1];
+        int len = capture[i + 2];
+        const uint8_t *p = &capture[i + 3];
+        uint8_t sum = type + len;
+        for (int k = 0; k < len; k++) {
+            sum += p[k];
+        }
+        if (sum != p[len] || type < TELEMETRY_REC_HELLO || type > TELEMETRY_REC_UNDERRUN) {
+            fprintf(stderr, "bad record at byte %d\n", i);
+            return -1;
+        }
+        records[type]++;
+        if (type == TELEMETRY_REC_FRAMES) {
+            uint32_t first = get_u32(p);
+            int n = p[4];
+            for (int k = 0; k < n; k++) {
+                uint32_t f = first + k;
+                int64_t diff = f < DECODE_FRAMES ? (int64_t)get_u16(&p[5 + 2 * k]) - decode_truth[f] : 1000000;
+                if (llabs(diff) > llabs(worst)) {
+                    worst = diff;
+                }
+                // host time passes between the simulated steps
+                bad += llabs(diff) > 200;
+            }
+            frames += n;
+        }
+        i += len + 4;
+    }
+    printf("decode times: %d hello, %d sample, %d frames records, %d of %d frames, worst error %lld us\n",
+           records[TELEMETRY_REC_HELLO], records[TELEMETRY_REC_SAMPLE], records[TELEMETRY_REC_FRAMES], frames,
+           DECODE_FRAMES, (long long)worst);
+    if (frames != DECODE_FRAMES || bad || !records[TELEMETRY_REC_HELLO]) {
+        fprintf(stderr, "%d decode times off by more than 200 us\n", bad);
+        return -1;
+    }
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+    esp_log_level_set("*", ESP_LOG_ERROR);
+    int ret = 0;
+    if (check_overhead() != 0) {
+        fprintf(stderr, "telemetry over 1%% of a core\n");
+        ret = 1;
+    }
+    if (check_underruns() != 0) {
+        ret = 1;
+    }
+    int from = captured;
+    drive_decoder();
+    if (check_stream(from) != 0) {
+        ret = 1;
+    }
+    printf("stream: %d bytes\n", captured);
+    if (argc > 1) {
+        FILE *fp = fopen(argv[1], "wb");
+        if (!fp || fwrite(capture, 1, captured, fp) != (size_t)captured) {
+            fprintf(stderr, "failed to write %s\n", argv[1]);
+            ret = 1;
+        }
+        if (fp) {
+            fclose(fp);
+        }
+    }
+    return ret;
+}
@@ -0,0 +1,297 @@
+/* Track switch silence at the output: pipeline restart vs. gapless playlist
+
+   Runs the mp3 decoder of app_main with the bench as its i2s writer: every
+   DMA period it reads DMA_FRAMES frames from the decoder output and plays
+   silence for what is not there, an underrun, as the i2s driver does. The
+   DMA clock is simulated; the decoder is charged the host time it takes and
+   may only run as far ahead of the DMA as one period, then waits for room.
+   Every sample the decoder writes gets its low bit set, so decoded audio is
+   never zero and every zero sample the DMA plays is silence.
+
+   restart  : the old [mode] handler, stop / wait_for_stop / terminate /
+              reset_ringbuffer / reset_elements / set asset / run, to the
+              next track. The PCM queued for the i2s writer is discarded.
+   gapless  : the playlist playing a track to its end: it is sought to
+              TAIL_MS before the end and the next track follows on its own.
+
+   For each switch:
+   - cut_ms: old track PCM decoded but never played;
+   - gap_ms: silence played between the last frame of the old track and
+     the first frame of the new one.
+   Both at the old track's rate. Exit status 1 if a gapless switch plays
+   more than GAP_MAX_MS of silence or cuts anything.
+
+   Usage: bench_track_switch [switches]
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include "esp_log.h"
+#include "audio_common.h"
+#include "pcm_sink.h"
+#include "mp3_decoder.h"
+#include "ringbuf.h"
+#include "embed_stream.h"
+#include "music_assets.h"
+#include "mp3_index.h"
+#include "player_pipeline.h"
+#include "playlist.h"
+#include "bench_clock.h"
+
+#define DMA_FRAMES                  512
+#define FRAME_BYTES                 4           // the assets are all 16 bit stereo
+#define PLAY_BEFORE_SWITCH_MS       500
+#define TAIL_MS                     300
+#define GAP_MAX_MS                  1.0
+#define MAX_TICKS                   100000
+
+typedef struct {
+    audio_element_handle_t decoder;
+    ringbuf_handle_t rb;
+    int64_t written;        // bytes the decoder wrote
+    int64_t played;         // of them, bytes the DMA read or that were discarded
+    uint64_t dma_ns;        // simulated time: the DMA
+    uint64_t cpu_ns;        // simulated time: the decoder, its host time
+    int rate;               // of the DMA
+    // the switch being measured
+    int64_t new_start;      // first byte of the new track, -1 while not known
+    int64_t old_end;        // end of the last old track byte played
+    int64_t zeros;          // silent frames since then
+    int64_t gap_frames;     // -1 until the new track plays
+} sim_t;
+
+typedef struct {
+    double gap_ms;
+    double cut_ms;
+} switch_result_t;
+
+static int decoder_out_tap(audio_element_handle_t el, char *buf, int len, TickType_t wait_time, void *ctx) {
+    sim_t *sim = (sim_t *)ctx;
+    int16_t *s = (int16_t *)buf;
+    for (int i = 0; i < len / 2; i++) {
+        s[i] |= 1;
+    }
+    int n = rb_write(audio_element_get_output_ringbuf(el), buf, len, wait_time);
+    if (n > 0) {
+        sim->written += n;
+    }
+    return n;
+}
+
+static void on_track(playlist_handle_t pl, int index, const mp3_frame_info_t *info, bool requested, void *ctx) {
+    ((sim_t *)ctx)->new_start = playlist_get_pcm_pos(pl);
+}
+
+static void measure(sim_t *sim) {
+    sim->new_start = -1;
+    sim->old_end = sim->played;
+    sim->zeros = 0;
+    sim->gap_frames = -1;
+}
+
+/**
+ * @brief One DMA period: the decoder runs up to its end, then the DMA plays it
+ */
+static void tick(sim_t *sim) {
+    uint64_t period_ns = DMA_FRAMES * 1000000000ULL / sim->rate;
+    while (sim->cpu_ns < sim->dma_ns + period_ns) {
+        uint64_t t0 = bench_now_ns();
+        int progress = audio_element_host_step(sim->decoder);
+        sim->cpu_ns += bench_now_ns() - t0;
+        if (!progress) {
+            // blocked on a full ring buffer until the DMA takes some
+            sim->cpu_ns = sim->dma_ns + period_ns;
+        }
+    }
+
+    int16_t buf[DMA_FRAMES * 2];
+    int n = rb_read(sim->rb, (char *)buf, sizeof(buf), 0);
+    n = n > 0 ? n : 0;
+    memset((char *)buf + n, 0, sizeof(buf) - n);
+    for (int f = 0; f < DMA_FRAMES; f++) {
+        int64_t at = sim->played + f * FRAME_BYTES;
+        if (!buf[2 * f] && !buf[2 * f + 1]) {
+            sim->zeros++;
+        } else if (sim->new_start < 0 || at < sim->new_start) {
+            sim->old_end = at + FRAME_BYTES;
+            sim->zeros = 0;
+        } else if (sim->gap_frames < 0) {
+            sim->gap_frames = sim->zeros;
+        }
+    }
+    sim->played += n;
+    sim->dma_ns += period_ns;
+}
+
+static int play_for(sim_t *sim, int ms) {
+    uint64_t until = sim->dma_ns + ms * 1000000ULL;
+    while (sim->dma_ns < until) {
+        tick(sim);
+    }
+    return 0;
+}
+
+static int play_until_new(sim_t *sim) {
+    for (int i = 0; sim->gap_frames < 0; i++) {
+        if (i == MAX_TICKS) {
+            return -1;
+        }
+        tick(sim);
+    }
+    return 0;
+}
+
+static void result(sim_t *sim, int old_rate, switch_result_t *res) {
+    res->gap_ms = sim->gap_frames * 1000.0 / old_rate;
+    res->cut_ms = (sim->new_start - sim->old_end) / FRAME_BYTES * 1000.0 / old_rate;
+}
+
+static int track_rate(audio_element_handle_t decoder) {
+    audio_element_info_t info = {0};
+    audio_element_getinfo(decoder, &info);
+    return info.sample_rates > 0 ? info.sample_rates : 44100;
+}
+
+static int setup(sim_t *sim, player_pipeline_t *player, player_pipeline_cfg_t *player_cfg) {
+    pcm_sink_cfg_t sink_cfg = PCM_SINK_CFG_DEFAULT();
+    if (player_pipeline_create(player, player_cfg, pcm_sink_init(&sink_cfg)) != ESP_OK) {
+        return -1;
+    }
+    memset(sim, 0, sizeof(*sim));
+    sim->decoder = player->mp3_decoder;
+    sim->rb = audio_element_get_output_ringbuf(player->mp3_decoder);
+    sim->rate = 44100;
+    measure(sim);
+    audio_element_set_write_cb(player->mp3_decoder, decoder_out_tap, sim);
+    return 0;
+}
+
+static int bench_restart(int switches, switch_result_t *res) {
+    embed_stream_handle_t stream = embed_stream_create();
+    player_pipeline_t player;
+    player_pipeline_cfg_t player_cfg = PLAYER_PIPELINE_CFG_DEFAULT();
+    player_cfg.read_cb = embed_stream_read_cb;
+    player_cfg.read_ctx = stream;
+    sim_t sim;
+    if (!stream || setup(&sim, &player, &player_cfg) != 0) {
+        return -1;
+    }
+
+    int index = 0;
+    embed_stream_set_asset(stream, &music_assets[index]);
+    audio_pipeline_run(player.pipeline);
+    int ret = 0;
+    for (int i = 0; i < switches && ret == 0; i++) {
+        play_for(&sim, PLAY_BEFORE_SWITCH_MS);
+        sim.rate = track_rate(player.mp3_decoder);
+        int old_rate = sim.rate;
+        index = (index + 1) % music_assets_count;
+        measure(&sim);
+
+        uint64_t t0 = bench_now_ns();
+        audio_pipeline_stop(player.pipeline);
+        audio_pipeline_wait_for_stop(player.pipeline);
+        audio_pipeline_terminate(player.pipeline);
+        audio_pipeline_reset_ringbuffer(player.pipeline);
+        audio_pipeline_reset_elements(player.pipeline);
+        embed_stream_set_asset(stream, &music_assets[index]);
+        audio_pipeline_run(player.pipeline);
+        // what was queued is gone; the DMA plays on while this runs
+        sim.cpu_ns = (sim.cpu_ns > sim.dma_ns ? sim.cpu_ns : sim.dma_ns) + bench_now_ns() - t0;
+        sim.played = sim.written;
+        sim.new_start = sim.written;
+        ret = play_until_new(&sim);
+        result(&sim, old_rate, &res[i]);
+        sim.rate = track_rate(player.mp3_decoder);
+    }
+    player_pipeline_stop(&player);
+    player_pipeline_destroy(&player);
+    embed_stream_destroy(stream);
+    return ret;
+}
+
+static int bench_gapless(int switches, switch_result_t *res) {
+    sim_t sim;
+    playlist_cfg_t playlist_cfg = PLAYLIST_CFG_DEFAULT();
+    playlist_cfg.on_track = on_track;
+    playlist_cfg.cb_ctx = &sim;
+    playlist_handle_t playlist = playlist_create(music_assets, music_assets_count, &playlist_cfg);
+    player_pipeline_t player;
+    player_pipeline_cfg_t player_cfg = PLAYER_PIPELINE_CFG_DEFAULT();
+    player_cfg.read_cb = playlist_read_cb;
+    player_cfg.read_ctx = playlist;
+    if (!playlist || setup(&sim, &player, &player_cfg) != 0) {
+        return -1;
+    }
+
+    audio_pipeline_run(player.pipeline);
+    int ret = 0;
+    for (int i = 0; i < switches && ret == 0; i++) {
+        play_for(&sim, PLAY_BEFORE_SWITCH_MS);
+        sim.rate = track_rate(player.mp3_decoder);
+        int old_rate = sim.rate;
+        int index = playlist_get_current(playlist);
+        const mp3_index_t *frames = music_assets[index].index;
+        measure(&sim);
+
+        playlist_seek(playlist, index, mp3_index_frame_ms(frames, frames->frame_count) - TAIL_MS);
+        ret = play_until_new(&sim);
+        result(&sim, old_rate, &res[i]);
+        sim.rate = track_rate(player.mp3_decoder);
+    }
+    player_pipeline_stop(&player);
+    player_pipeline_destroy(&player);
+    playlist_destroy(playlist);
+    return ret;
+}
+
+typedef struct {
+    double gap_avg, gap_max, cut_avg, cut_max;
+} summary_t;
+
+static summary_t report(const char *name, const switch_result_t *res, int n) {
+    summary_t s = {0};
+    for (int i = 0; i < n; i++) {
+        s.gap_avg += res[i].gap_ms / n;
+        s.cut_avg += res[i].cut_ms / n;
+        s.gap_max = res[i].gap_ms > s.gap_max ? res[i].gap_ms : s.gap_max;
+        s.cut_max = res[i].cut_ms > s.cut_max ? res[i].cut_ms : s.cut_max;
+    }
+    printf("%-8s %8d %12.3f %12.3f %12.3f %12.3f\n", name, n, s.gap_avg, s.gap_max, s.cut_avg, s.cut_max);
+    return s;
+}
+
+int main(int argc, char *argv[]) {
+    int switches = argc > 1 ? atoi(argv[1]) : 30;
+    if (switches <= 0) {
+        fprintf(stderr, "usage: %s [switches]\n", argv[0]);
+        return 2;
+    }
+    esp_log_level_set("*", ESP_LOG_ERROR);
+
+    switch_result_t *restart = calloc(switches, sizeof(switch_result_t));
+    switch_result_t *gapless = calloc(switches, sizeof(switch_result_t));
+    if (!restart || !gapless) {
+        return 1;
+    }
+    if (bench_restart(switches, restart) != 0 || bench_gapless(switches, gapless) != 0) {
+        fprintf(stderr, "pipeline stalled\n");
+        return 1;
+    }
+
+    printf("decoder backend: %s, %d frame DMA periods\n", mp3_decoder_host_backend(), DMA_FRAMES);
+    printf("%-8s %8s %12s %12s %12s %12s\n", "switch", "count", "gap_avg_ms", "gap_max_ms", "cut_avg_ms",
+           "cut_max_ms");
+    report("restart", restart, switches);
+    summary_t s = report("gapless", gapless, switches);
+    free(restart);
+    free(gapless);
+    if (s.gap_max > GAP_MAX_MS || s.cut_max > 0) {
+        fprintf(stderr, "gapless switch plays %.3f ms of silence and cuts %.3f ms, at most %.1f ms and none\n",
+                s.gap_max, s.cut_max, GAP_MAX_MS);
+        return 1;
+    }
+    return 0;
+}
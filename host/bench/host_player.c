@@ -0,0 +1,151 @@
+/* Host run of the mp3 -> sink pipeline built by player_pipeline_create()
+
+   Plays the embedded assets through the same pipeline construction as
+   app_main, with a PCM file or null sink in place of the i2s stream writer
+   and the stub codec in place of AUDIO_NEW_CODEC_DEFAULT_HANDLE, and reports
+   decode throughput and realtime factor.
+
+   Usage: host_player [-o out.pcm] [-r repeat] [asset_index ...]
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "esp_log.h"
+#include "audio_common.h"
+#include "board.h"
+#include "pcm_sink.h"
+#include "mp3_decoder.h"
+#include "embed_stream.h"
+#include "music_assets.h"
+#include "player_pipeline.h"
+#include "bench_clock.h"
+
+typedef struct {
+    int sample_rate;
+    int channels;
+    int64_t pcm_bytes;
+    uint64_t ns;
+} play_result_t;
+
+static int play_asset(player_pipeline_t *player, audio_event_iface_handle_t evt,
+                      embed_stream_handle_t stream, const embed_asset_t *asset, play_result_t *res) {
+    embed_stream_set_asset(stream, asset);
+    audio_pipeline_reset_ringbuffer(player->pipeline);
+    audio_pipeline_reset_elements(player->pipeline);
+    audio_pipeline_change_state(player->pipeline, AEL_STATE_INIT);
+    int64_t bytes0 = pcm_sink_get_bytes(player->sink);
+
+    uint64_t t0 = bench_now_ns();
+    audio_pipeline_run(player->pipeline);
+    while (1) {
+        audio_event_iface_msg_t msg;
+        if (audio_event_iface_listen(evt, &msg, portMAX_DELAY) != ESP_OK) {
+            fprintf(stderr, "%s: pipeline stalled\n", asset->name);
+            return -1;
+        }
+        if (msg.source_type != AUDIO_ELEMENT_TYPE_ELEMENT) {
+            continue;
+        }
+        if (msg.source == (void *)player->mp3_decoder && msg.cmd == AEL_MSG_CMD_REPORT_MUSIC_INFO) {
+            audio_element_info_t music_info = {0};
+            audio_element_getinfo(player->mp3_decoder, &music_info);
+            audio_element_setinfo(player->sink, &music_info);
+            res->sample_rate = music_info.sample_rates;
+            res->channels = music_info.channels;
+            continue;
+        }
+        if (msg.cmd == AEL_MSG_CMD_REPORT_STATUS && (int)(intptr_t)msg.data == AEL_STATUS_STATE_FINISHED) {
+            if (msg.source == (void *)player->sink) {
+                break;
+            }
+        } else if (msg.cmd == AEL_MSG_CMD_REPORT_STATUS && (int)(intptr_t)msg.data == AEL_STATUS_ERROR_PROCESS) {
+            fprintf(stderr, "%s: element error\n", asset->name);
+            return -1;
+        }
+    }
+    res->ns += bench_now_ns() - t0;
+    res->pcm_bytes += pcm_sink_get_bytes(player->sink) - bytes0;
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+    const char *out_path = NULL;
+    int repeat = 5;
+    int opt;
+    while ((opt = getopt(argc, argv, "o:r:")) != -1) {
+        switch (opt) {
+        case 'o':
+            out_path = optarg;
+            break;
+        case 'r':
+            repeat = atoi(optarg);
+            break;
+        default:
+            fprintf(stderr, "usage: %s [-o out.pcm] [-r repeat] [asset_index ...]\n", argv[0]);
+            return 2;
+        }
+    }
+    esp_log_level_set("*", ESP_LOG_WARN);
+
+    audio_board_handle_t board_handle = audio_board_init();
+    audio_hal_ctrl_codec(board_handle->audio_hal, AUDIO_HAL_CODEC_MODE_BOTH, AUDIO_HAL_CTRL_START);
+
+    embed_stream_handle_t stream = embed_stream_create();
+    pcm_sink_cfg_t sink_cfg = PCM_SINK_CFG_DEFAULT();
+    sink_cfg.path = out_path;
+    audio_element_handle_t sink = pcm_sink_init(&sink_cfg);
+    if (!stream || !sink) {
+        return 1;
+    }
+
+    player_pipeline_t player;
+    player_pipeline_cfg_t player_cfg = PLAYER_PIPELINE_CFG_DEFAULT();
+    player_cfg.read_cb = embed_stream_read_cb;
+    player_cfg.read_ctx = stream;
+    if (player_pipeline_create(&player, &player_cfg, sink) != ESP_OK) {
+        return 1;
+    }
+    audio_event_iface_cfg_t evt_cfg = AUDIO_EVENT_IFACE_DEFAULT_CFG();
+    audio_event_iface_handle_t evt = audio_event_iface_init(&evt_cfg);
+    player_pipeline_set_listener(&player, evt);
+
+    printf("decoder backend: %s, sink: %s\n", mp3_decoder_host_backend(), out_path ? out_path : "null");
+    printf("%-26s %6s %3s %10s %10s %10s %8s\n", "asset", "rate", "ch", "audio_s", "decode_ms", "frames/s", "RTF");
+    int first = optind < argc ? optind : 0;
+    int count = optind < argc ? argc - optind : music_assets_count;
+    int ret = 0;
+    for (int i = 0; i < count; i++) {
+        int idx = optind < argc ? atoi(argv[first + i]) : i;
+        if (idx < 0 || idx >= music_assets_count) {
+            fprintf(stderr, "no asset %d\n", idx);
+            ret = 2;
+            break;
+        }
+        play_result_t res = {0};
+        for (int r = 0; r < repeat; r++) {
+            if (play_asset(&player, evt, stream, &music_assets[idx], &res) != 0) {
+                ret = 1;
+                break;
+            }
+        }
+        if (ret || !res.sample_rate) {
+            ret = 1;
+            break;
+        }
+        int samples_per_frame = res.sample_rate >= 32000 ? 1152 : 576;
+        double audio_s = (double)res.pcm_bytes / (res.sample_rate * res.channels * 2);
+        double decode_s = res.ns / 1e9;
+        double frames = (double)res.pcm_bytes / (samples_per_frame * res.channels * 2);
+        printf("%-26s %6d %3d %10.2f %10.2f %10.0f %8.5f\n", music_assets[idx].name, res.sample_rate,
+               res.channels, audio_s / repeat, decode_s * 1e3 / repeat, frames / decode_s, decode_s / audio_s);
+    }
+
+    player_pipeline_stop(&player);
+    audio_event_iface_destroy(evt);
+    player_pipeline_destroy(&player);
+    embed_stream_destroy(stream);
+    audio_board_deinit(board_handle);
+    return ret;
+}
@@ -0,0 +1,34 @@
+/* Host stand-in for ADF audio_error.h */
+
+#ifndef _HOST_AUDIO_ERROR_H_
+#define _HOST_AUDIO_ERROR_H_
+
+#include "esp_err.h"
+#include "esp_log.h"
+
+#define ESP_ERR_ADF_BASE                0x80000
+#define ESP_ERR_ADF_NO_ERROR            ESP_OK
+#define ESP_ERR_ADF_NO_FAIL             ESP_FAIL
+#define ESP_ERR_ADF_UNKNOWN             ESP_ERR_ADF_BASE + 0
+#define ESP_ERR_ADF_ALREADY_EXISTS      ESP_ERR_ADF_BASE + 1
+#define ESP_ERR_ADF_MEMORY_LACK         ESP_ERR_ADF_BASE + 2
+#define ESP_ERR_ADF_INVALID_URI         ESP_ERR_ADF_BASE + 3
+#define ESP_ERR_ADF_INVALID_PATH        ESP_ERR_ADF_BASE + 4
+#define ESP_ERR_ADF_INVALID_PARAMETER   ESP_ERR_ADF_BASE + 5
+#define ESP_ERR_ADF_NOT_READY           ESP_ERR_ADF_BASE + 6
+#define ESP_ERR_ADF_NOT_SUPPORT         ESP_ERR_ADF_BASE + 7
+#define ESP_ERR_ADF_NOT_FOUND           ESP_ERR_ADF_BASE + 8
+#define ESP_ERR_ADF_TIMEOUT             ESP_ERR_ADF_BASE + 9
+#define ESP_ERR_ADF_INITIALIZED         ESP_ERR_ADF_BASE + 10
+#define ESP_ERR_ADF_UNINITIALIZED       ESP_ERR_ADF_BASE + 11
+
+#define AUDIO_CHECK(TAG, a, action, msg) if (!(a)) {                    \
+        ESP_LOGE(TAG, "%s:%d (%s): %s", __FILE__, __LINE__, __FUNCTION__, msg); \
+        action;                                                         \
+        }
+
+#define AUDIO_MEM_CHECK(TAG, a, action)  AUDIO_CHECK(TAG, a, action, "Memory exhausted")
+#define AUDIO_NULL_CHECK(TAG, a, action) AUDIO_CHECK(TAG, a, action, "Got NULL Pointer")
+#define AUDIO_ERROR(TAG, str) ESP_LOGE(TAG, "%s:%d (%s): %s", __FILE__, __LINE__, __FUNCTION__, str)
+
+#endif
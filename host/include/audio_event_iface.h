@@ -0,0 +1,66 @@
+/* Host stand-in for ADF audio_event_iface.h
+ *
+ * Listening never blocks: when the queue is empty the pipelines attached to
+ * the interface are pumped until they post a message or stop making progress,
+ * in which case listen returns ESP_FAIL as it would on a timeout.
+ */
+
+#ifndef _HOST_AUDIO_EVENT_IFACE_H_
+#define _HOST_AUDIO_EVENT_IFACE_H_
+
+#include <stdbool.h>
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+
+typedef struct audio_event_iface_msg {
+    int cmd;
+    void *data;
+    int data_len;
+    void *source;
+    int source_type;
+    bool need_free_data;
+} audio_event_iface_msg_t;
+
+typedef struct audio_event_iface *audio_event_iface_handle_t;
+
+typedef struct {
+    int internal_queue_size;
+    int external_queue_size;
+    int queue_set_size;
+    void *on_cmd;
+    void *context;
+    TickType_t wait_time;
+    int type;
+} audio_event_iface_cfg_t;
+
+#define DEFAULT_AUDIO_EVENT_IFACE_SIZE  (5)
+
+#define AUDIO_EVENT_IFACE_DEFAULT_CFG() {                   \
+    .internal_queue_size = DEFAULT_AUDIO_EVENT_IFACE_SIZE,  \
+    .external_queue_size = DEFAULT_AUDIO_EVENT_IFACE_SIZE,  \
+    .queue_set_size = DEFAULT_AUDIO_EVENT_IFACE_SIZE,       \
+    .on_cmd = NULL,                                         \
+    .context = NULL,                                        \
+    .wait_time = portMAX_DELAY,                             \
+    .type = 0,                                              \
+}
+
+audio_event_iface_handle_t audio_event_iface_init(audio_event_iface_cfg_t *config);
+esp_err_t audio_event_iface_destroy(audio_event_iface_handle_t evt);
+esp_err_t audio_event_iface_set_listener(audio_event_iface_handle_t evt, audio_event_iface_handle_t listener);
+esp_err_t audio_event_iface_remove_listener(audio_event_iface_handle_t listen, audio_event_iface_handle_t evt);
+esp_err_t audio_event_iface_cmd(audio_event_iface_handle_t evt, audio_event_iface_msg_t *msg);
+esp_err_t audio_event_iface_sendout(audio_event_iface_handle_t evt, audio_event_iface_msg_t *msg);
+esp_err_t audio_event_iface_listen(audio_event_iface_handle_t evt, audio_event_iface_msg_t *msg, TickType_t wait_time);
+
+/**
+ * @brief Host only: pump callback run by listen while the queue is empty
+ *
+ * @return Number of elements that made progress
+ */
+typedef int (*audio_event_iface_pump_t)(void *ctx);
+
+esp_err_t audio_event_iface_host_add_pump(audio_event_iface_handle_t evt, audio_event_iface_pump_t pump, void *ctx);
+esp_err_t audio_event_iface_host_remove_pump(audio_event_iface_handle_t evt, void *ctx);
+
+#endif
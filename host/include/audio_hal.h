@@ -0,0 +1,100 @@
+/* Host stand-in for ADF audio_hal.h */
+
+#ifndef _HOST_AUDIO_HAL_H_
+#define _HOST_AUDIO_HAL_H_
+
+#include <stdbool.h>
+#include "esp_err.h"
+
+#define AUDIO_HAL_VOL_DEFAULT 70
+
+typedef enum {
+    AUDIO_HAL_CODEC_MODE_ENCODE = 1,
+    AUDIO_HAL_CODEC_MODE_DECODE,
+    AUDIO_HAL_CODEC_MODE_BOTH,
+    AUDIO_HAL_CODEC_MODE_LINE_IN,
+} audio_hal_codec_mode_t;
+
+typedef enum {
+    AUDIO_HAL_ADC_INPUT_LINE1 = 0x00,
+    AUDIO_HAL_ADC_INPUT_LINE2,
+    AUDIO_HAL_ADC_INPUT_ALL,
+    AUDIO_HAL_ADC_INPUT_DIFFERENCE,
+} audio_hal_adc_input_t;
+
+typedef enum {
+    AUDIO_HAL_DAC_OUTPUT_LINE1 = 0x00,
+    AUDIO_HAL_DAC_OUTPUT_LINE2,
+    AUDIO_HAL_DAC_OUTPUT_ALL,
+} audio_hal_dac_output_t;
+
+typedef enum {
+    AUDIO_HAL_CTRL_STOP  = 0x00,
+    AUDIO_HAL_CTRL_START = 0x01,
+} audio_hal_ctrl_t;
+
+typedef enum {
+    AUDIO_HAL_MODE_SLAVE = 0x00,
+    AUDIO_HAL_MODE_MASTER = 0x01,
+} audio_hal_iface_mode_t;
+
+typedef enum {
+    AUDIO_HAL_08K_SAMPLES,
+    AUDIO_HAL_11K_SAMPLES,
+    AUDIO_HAL_16K_SAMPLES,
+    AUDIO_HAL_22K_SAMPLES,
+    AUDIO_HAL_24K_SAMPLES,
+    AUDIO_HAL_32K_SAMPLES,
+    AUDIO_HAL_44K_SAMPLES,
+    AUDIO_HAL_48K_SAMPLES,
+} audio_hal_iface_samples_t;
+
+typedef enum {
+    AUDIO_HAL_BIT_LENGTH_16BITS = 1,
+    AUDIO_HAL_BIT_LENGTH_24BITS,
+    AUDIO_HAL_BIT_LENGTH_32BITS,
+} audio_hal_iface_bits_t;
+
+typedef enum {
+    AUDIO_HAL_I2S_NORMAL = 0,
+    AUDIO_HAL_I2S_LEFT,
+    AUDIO_HAL_I2S_RIGHT,
+    AUDIO_HAL_I2S_DSP,
+} audio_hal_iface_format_t;
+
+typedef struct {
+    audio_hal_iface_mode_t mode;
+    audio_hal_iface_format_t fmt;
+    audio_hal_iface_samples_t samples;
+    audio_hal_iface_bits_t bits;
+} audio_hal_codec_i2s_iface_t;
+
+typedef struct {
+    audio_hal_adc_input_t adc_input;
+    audio_hal_dac_output_t dac_output;
+    audio_hal_codec_mode_t codec_mode;
+    audio_hal_codec_i2s_iface_t i2s_iface;
+} audio_hal_codec_config_t;
+
+typedef struct audio_hal {
+    esp_err_t (*audio_codec_initialize)(audio_hal_codec_config_t *codec_cfg);
+    esp_err_t (*audio_codec_deinitialize)(void);
+    esp_err_t (*audio_codec_ctrl)(audio_hal_codec_mode_t mode, audio_hal_ctrl_t ctrl_state);
+    esp_err_t (*audio_codec_config_iface)(audio_hal_codec_mode_t mode, audio_hal_codec_i2s_iface_t *iface);
+    esp_err_t (*audio_codec_set_mute)(bool mute);
+    esp_err_t (*audio_codec_set_volume)(int volume);
+    esp_err_t (*audio_codec_get_volume)(int *volume);
+    void *audio_hal_lock;
+    void *handle;
+} audio_hal_func_t;
+
+typedef struct audio_hal *audio_hal_handle_t;
+
+audio_hal_handle_t audio_hal_init(audio_hal_codec_config_t *audio_hal_conf, audio_hal_func_t *audio_hal_func);
+esp_err_t audio_hal_deinit(audio_hal_handle_t audio_hal);
+esp_err_t audio_hal_ctrl_codec(audio_hal_handle_t audio_hal, audio_hal_codec_mode_t mode, audio_hal_ctrl_t audio_hal_ctrl);
+esp_err_t audio_hal_set_mute(audio_hal_handle_t audio_hal, bool mute);
+esp_err_t audio_hal_set_volume(audio_hal_handle_t audio_hal, int volume);
+esp_err_t audio_hal_get_volume(audio_hal_handle_t audio_hal, int *volume);
+
+#endif
@@ -0,0 +1,41 @@
+/* Host stand-in for ADF audio_mem.h */
+
+#ifndef _HOST_AUDIO_MEM_H_
+#define _HOST_AUDIO_MEM_H_
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <assert.h>
+
+void *audio_malloc(size_t size);
+void *audio_calloc(size_t nmemb, size_t size);
+void *audio_realloc(void *ptr, size_t size);
+void audio_free(void *ptr);
+
+/**
+ * @brief Host only: what went through audio_malloc() and friends, sizes as malloc_usable_size()
+ */
+typedef struct {
+    size_t allocs;      /*!< Successful allocations, a realloc counts as one */
+    size_t frees;
+    size_t in_use;      /*!< Bytes allocated now */
+    size_t peak;        /*!< Most bytes allocated at once since start or the last reset */
+} audio_mem_host_stats_t;
+
+void audio_mem_host_get_stats(audio_mem_host_stats_t *stats);
+
+/**
+ * @brief Host only: restart the peak from what is allocated now
+ */
+void audio_mem_host_reset_peak(void);
+
+/**
+ * @brief Host: as with CONFIG_SPIRAM_BOOT_INIT and CONFIG_SPIRAM_ALLOW_STACK_EXTERNAL_MEMORY
+ */
+static inline bool audio_mem_spiram_stack_is_enabled(void) {
+    return true;
+}
+
+#define mem_assert(x) assert(x)
+
+#endif
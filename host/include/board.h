@@ -0,0 +1,36 @@
+/* Host stand-in for the board component: stub codec and the board's button ids */
+
+#ifndef _HOST_AUDIO_BOARD_H_
+#define _HOST_AUDIO_BOARD_H_
+
+#include <stdint.h>
+#include "audio_hal.h"
+
+#define BUTTON_VOLUP_ID           0
+#define BUTTON_VOLDOWN_ID         1
+#define BUTTON_MUTE_ID            2
+#define BUTTON_SET_ID             3
+#define BUTTON_MODE_ID            4
+#define BUTTON_PLAY_ID            5
+
+struct audio_board_handle {
+    audio_hal_handle_t audio_hal;
+    audio_hal_handle_t adc_hal;
+};
+
+typedef struct audio_board_handle *audio_board_handle_t;
+
+extern audio_hal_func_t AUDIO_NEW_CODEC_DEFAULT_HANDLE;
+
+audio_board_handle_t audio_board_init(void);
+audio_board_handle_t audio_board_get_handle(void);
+esp_err_t audio_board_deinit(audio_board_handle_t audio_board);
+
+int8_t get_input_volup_id(void);
+int8_t get_input_voldown_id(void);
+int8_t get_input_mute_id(void);
+int8_t get_input_set_id(void);
+int8_t get_input_mode_id(void);
+int8_t get_input_play_id(void);
+
+#endif
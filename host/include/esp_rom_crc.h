@@ -0,0 +1,13 @@
+/* Host stand-in for the ROM CRC functions the player code uses */
+
+#ifndef _HOST_ESP_ROM_CRC_H_
+#define _HOST_ESP_ROM_CRC_H_
+
+#include <stdint.h>
+
+/**
+ * @brief CRC-32 as the ROM's: crc of the data before, 0 to start; esp_rom_crc32_le(0, buf, len) is zlib's crc32()
+ */
+uint32_t esp_rom_crc32_le(uint32_t crc, const uint8_t *buf, uint32_t len);
+
+#endif
@@ -0,0 +1,21 @@
+/* Host stand-in for esp_timer.h
+ *
+ * esp_timer_get_time() is a simulated clock: monotonic host time plus the
+ * time a sink has spent "playing" audio (see pcm_sink_cfg_t.realtime), so
+ * buffered audio takes as long to drain as on the board even though the host
+ * pipeline runs much faster than real time.
+ */
+
+#ifndef _HOST_ESP_TIMER_H_
+#define _HOST_ESP_TIMER_H_
+
+#include <stdint.h>
+
+int64_t esp_timer_get_time(void);
+
+/**
+ * @brief Host only: move the clock forward, as a blocking write to i2s DMA would
+ */
+void esp_timer_host_advance(int64_t us);
+
+#endif
@@ -0,0 +1,40 @@
+/* Host stand-in for the FreeRTOS event groups the player code uses */
+
+#ifndef _HOST_FREERTOS_EVENT_GROUPS_H_
+#define _HOST_FREERTOS_EVENT_GROUPS_H_
+
+#include <stdlib.h>
+#include "freertos/FreeRTOS.h"
+
+typedef uint32_t EventBits_t;
+typedef EventBits_t *EventGroupHandle_t;
+
+static inline EventGroupHandle_t xEventGroupCreate(void) {
+    return (EventGroupHandle_t)calloc(1, sizeof(EventBits_t));
+}
+
+static inline void vEventGroupDelete(EventGroupHandle_t group) {
+    free(group);
+}
+
+static inline EventBits_t xEventGroupSetBits(EventGroupHandle_t group, const EventBits_t bits) {
+    return *group |= bits;
+}
+
+static inline EventBits_t xEventGroupGetBits(EventGroupHandle_t group) {
+    return *group;
+}
+
+/**
+ * @brief Host: nothing else runs to set the bits, the wait returns what is set at once
+ */
+static inline EventBits_t xEventGroupWaitBits(EventGroupHandle_t group, const EventBits_t bits,
+                                              const BaseType_t clear, const BaseType_t all, TickType_t ticks) {
+    EventBits_t set = *group;
+    if (clear && (all ? (set & bits) == bits : (set & bits))) {
+        *group &= ~bits;
+    }
+    return set;
+}
+
+#endif
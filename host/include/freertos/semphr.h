@@ -0,0 +1,30 @@
+/* Host stand-in for the FreeRTOS semaphores the player code uses */
+
+#ifndef _HOST_FREERTOS_SEMPHR_H_
+#define _HOST_FREERTOS_SEMPHR_H_
+
+#include "freertos/FreeRTOS.h"
+
+// one thread, nothing to exclude; the handle only has to be non-NULL
+typedef void *SemaphoreHandle_t;
+
+static inline SemaphoreHandle_t xSemaphoreCreateMutex(void) {
+    return (SemaphoreHandle_t)1;
+}
+
+static inline SemaphoreHandle_t xSemaphoreCreateBinary(void) {
+    return (SemaphoreHandle_t)1;
+}
+
+static inline void vSemaphoreDelete(SemaphoreHandle_t sem) {
+}
+
+static inline BaseType_t xSemaphoreTake(SemaphoreHandle_t sem, TickType_t ticks) {
+    return pdTRUE;
+}
+
+static inline BaseType_t xSemaphoreGive(SemaphoreHandle_t sem) {
+    return pdTRUE;
+}
+
+#endif
@@ -0,0 +1,43 @@
+/* Host stand-in for the FreeRTOS task functions the player code uses */
+
+#ifndef _HOST_FREERTOS_TASK_H_
+#define _HOST_FREERTOS_TASK_H_
+
+#include "freertos/FreeRTOS.h"
+
+typedef void *TaskHandle_t;
+typedef void (*TaskFunction_t)(void *);
+
+#define tskNO_AFFINITY      0x7FFFFFFF
+
+/**
+ * @brief Host: nothing else runs on the host thread, so a delay only moves the simulated esp_timer clock
+ */
+void vTaskDelay(const TickType_t ticks);
+
+/**
+ * @brief Host: there are no tasks, code with an optional task runs its loop body from the caller instead
+ */
+static inline BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char *name, uint32_t stack, void *arg,
+                                                 UBaseType_t prio, TaskHandle_t *handle, BaseType_t core) {
+    return pdFAIL;
+}
+
+static inline void vTaskDelete(TaskHandle_t task) {
+}
+
+/**
+ * @brief Host: the one thread, a handle that is never NULL
+ */
+static inline TaskHandle_t xTaskGetCurrentTaskHandle(void) {
+    return (TaskHandle_t)1;
+}
+
+/**
+ * @brief Host: the thread is no element task
+ */
+static inline char *pcTaskGetTaskName(TaskHandle_t task) {
+    return NULL;
+}
+
+#endif
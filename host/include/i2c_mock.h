@@ -0,0 +1,46 @@
+/* Mock I2C bus in place of my_codec_driver/new_codec_i2c.c: a register file that counts its traffic */
+
+#ifndef _HOST_I2C_MOCK_H_
+#define _HOST_I2C_MOCK_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+typedef struct {
+    int transactions;   /*!< Write transactions, i2c_master_cmd_begin() calls on target */
+    int reg_writes;     /*!< Registers written */
+    int reg_reads;      /*!< Registers read, one transaction each */
+    int bytes;          /*!< Bytes on the wire, address bytes included */
+    int failures;       /*!< Transactions failed by i2c_mock_fail_next() or NACKed with no chip */
+} i2c_mock_stats_t;
+
+/**
+ * @brief Bus time of the traffic in microseconds, at NEW_CODEC_I2C_SPEED with 9 clocks per byte
+ */
+double i2c_mock_bus_us(const i2c_mock_stats_t *stats);
+
+void i2c_mock_get_stats(i2c_mock_stats_t *stats);
+void i2c_mock_reset_stats(void);
+
+/**
+ * @brief Register as the chip holds it
+ */
+uint8_t i2c_mock_reg(uint8_t reg);
+
+/**
+ * @brief Set a register behind the driver's back, like a reset of the chip
+ */
+void i2c_mock_set_reg(uint8_t reg, uint8_t val);
+
+/**
+ * @brief Fail the next n transactions, nothing of them reaches the registers
+ */
+void i2c_mock_fail_next(int n);
+
+/**
+ * @brief No chip on the bus: every transaction is NACKed, until set back
+ */
+void i2c_mock_set_absent(bool no_chip);
+
+#endif
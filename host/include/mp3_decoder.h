@@ -0,0 +1,42 @@
+/* Host stand-in for ADF mp3_decoder.h
+ *
+ * Decodes with libmpg123 when the host build finds it. Without it the element
+ * still walks every frame and outputs the same amount of (silent) PCM, which
+ * exercises the pipeline but not the decoder arithmetic.
+ */
+
+#ifndef _HOST_MP3_DECODER_H_
+#define _HOST_MP3_DECODER_H_
+
+#include <stdbool.h>
+#include "audio_element.h"
+
+typedef struct {
+    int   out_rb_size;
+    int   task_stack;
+    int   task_core;
+    int   task_prio;
+    bool  stack_in_ext;
+} mp3_decoder_cfg_t;
+
+#define MP3_DECODER_TASK_STACK_SIZE     (5 * 1024)
+#define MP3_DECODER_TASK_CORE           (0)
+#define MP3_DECODER_TASK_PRIO           (5)
+#define MP3_DECODER_RINGBUFFER_SIZE     (2 * 1024)
+
+#define DEFAULT_MP3_DECODER_CONFIG() {                  \
+    .out_rb_size        = MP3_DECODER_RINGBUFFER_SIZE,  \
+    .task_stack         = MP3_DECODER_TASK_STACK_SIZE,  \
+    .task_core          = MP3_DECODER_TASK_CORE,        \
+    .task_prio          = MP3_DECODER_TASK_PRIO,        \
+    .stack_in_ext       = true,                         \
+}
+
+audio_element_handle_t mp3_decoder_init(mp3_decoder_cfg_t *config);
+
+/**
+ * @brief Host only: name of the decoding backend
+ */
+const char *mp3_decoder_host_backend(void);
+
+#endif
@@ -0,0 +1,61 @@
+/* Host stand-in for nvs.h
+ *
+ * A model of the ESP-IDF NVS page layout rather than a key-value map: 4 KiB
+ * pages of 126 32-byte entries, items appended to the active page and old
+ * versions only marked erased, a full page compacted into the reserved free
+ * page and erased when the free pages run out. It counts the flash program
+ * and erase operations that causes, for endurance estimates.
+ */
+
+#ifndef _HOST_NVS_H_
+#define _HOST_NVS_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+
+#define ESP_ERR_NVS_BASE                0x1100
+#define ESP_ERR_NVS_NOT_INITIALIZED     (ESP_ERR_NVS_BASE + 0x01)
+#define ESP_ERR_NVS_NOT_FOUND           (ESP_ERR_NVS_BASE + 0x02)
+#define ESP_ERR_NVS_INVALID_HANDLE      (ESP_ERR_NVS_BASE + 0x07)
+#define ESP_ERR_NVS_NOT_ENOUGH_SPACE    (ESP_ERR_NVS_BASE + 0x05)
+#define ESP_ERR_NVS_INVALID_LENGTH      (ESP_ERR_NVS_BASE + 0x0c)
+#define ESP_ERR_NVS_NO_FREE_PAGES       (ESP_ERR_NVS_BASE + 0x0d)
+
+typedef uint32_t nvs_handle_t;
+
+typedef enum {
+    NVS_READONLY,
+    NVS_READWRITE,
+} nvs_open_mode_t;
+
+esp_err_t nvs_open(const char *name, nvs_open_mode_t open_mode, nvs_handle_t *out_handle);
+void nvs_close(nvs_handle_t handle);
+esp_err_t nvs_set_u32(nvs_handle_t handle, const char *key, uint32_t value);
+esp_err_t nvs_get_u32(nvs_handle_t handle, const char *key, uint32_t *out_value);
+esp_err_t nvs_set_u64(nvs_handle_t handle, const char *key, uint64_t value);
+esp_err_t nvs_get_u64(nvs_handle_t handle, const char *key, uint64_t *out_value);
+esp_err_t nvs_set_blob(nvs_handle_t handle, const char *key, const void *value, size_t length);
+esp_err_t nvs_get_blob(nvs_handle_t handle, const char *key, void *out_value, size_t *length);
+esp_err_t nvs_commit(nvs_handle_t handle);
+
+/**
+ * @brief Host only: flash operations caused by NVS since nvs_host_format()
+ */
+typedef struct {
+    uint32_t programs;          /*!< Program operations: entries, entry state bitmaps, page headers */
+    uint64_t program_bytes;
+    uint32_t erases;            /*!< Page (sector) erases */
+    uint32_t max_page_erases;   /*!< Erases of the most erased page */
+    uint32_t items_moved;       /*!< Items copied by page compaction */
+    int      pages;
+} nvs_host_stats_t;
+
+/**
+ * @brief Host only: an empty partition of size bytes, as nvs_flash_erase() + nvs_flash_init()
+ */
+esp_err_t nvs_host_format(size_t size);
+
+void nvs_host_get_stats(nvs_host_stats_t *stats);
+
+#endif
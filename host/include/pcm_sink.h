@@ -0,0 +1,28 @@
+/* PCM file / null sink, takes the place of the i2s stream writer on the host */
+
+#ifndef _HOST_PCM_SINK_H_
+#define _HOST_PCM_SINK_H_
+
+#include <stdbool.h>
+#include "audio_element.h"
+
+typedef struct {
+    const char *path;   /*!< Raw PCM output file, NULL for a null sink */
+    int buffer_len;     /*!< Bytes taken from the input per process call */
+    bool realtime;      /*!< Advance the esp_timer clock by the duration of the audio consumed, like i2s DMA */
+} pcm_sink_cfg_t;
+
+#define PCM_SINK_CFG_DEFAULT() {    \
+    .path = NULL,                   \
+    .buffer_len = 3600,             \
+    .realtime = false,              \
+}
+
+audio_element_handle_t pcm_sink_init(const pcm_sink_cfg_t *config);
+
+/**
+ * @brief Total PCM bytes consumed by the sink
+ */
+int64_t pcm_sink_get_bytes(audio_element_handle_t el);
+
+#endif
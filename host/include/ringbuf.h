@@ -0,0 +1,32 @@
+/* Host stand-in for ADF ringbuf.h
+ *
+ * The host pipeline is pumped from a single thread, so reads and writes never
+ * block: a read on an empty buffer returns RB_TIMEOUT (or RB_DONE once the
+ * writer has finished) and a write stores what fits.
+ */
+
+#ifndef _HOST_RINGBUF_H_
+#define _HOST_RINGBUF_H_
+
+#include "freertos/FreeRTOS.h"
+
+#define RB_OK           (0)
+#define RB_FAIL         (-1)
+#define RB_DONE         (-2)
+#define RB_ABORT        (-3)
+#define RB_TIMEOUT      (-4)
+
+typedef struct ringbuf *ringbuf_handle_t;
+
+ringbuf_handle_t rb_create(int block_size, int n_blocks);
+int rb_destroy(ringbuf_handle_t rb);
+int rb_reset(ringbuf_handle_t rb);
+int rb_bytes_available(ringbuf_handle_t rb);
+int rb_bytes_filled(ringbuf_handle_t rb);
+int rb_get_size(ringbuf_handle_t rb);
+int rb_read(ringbuf_handle_t rb, char *buf, int len, TickType_t ticks_to_wait);
+int rb_write(ringbuf_handle_t rb, char *buf, int len, TickType_t ticks_to_wait);
+int rb_done_write(ringbuf_handle_t rb);
+int rb_abort(ringbuf_handle_t rb);
+
+#endif
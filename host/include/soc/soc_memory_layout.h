@@ -0,0 +1,15 @@
+/* Host stand-in for IDF soc/soc_memory_layout.h */
+
+#ifndef _HOST_SOC_MEMORY_LAYOUT_H_
+#define _HOST_SOC_MEMORY_LAYOUT_H_
+
+#include <stdbool.h>
+
+/**
+ * @brief Host: there is no external RAM
+ */
+static inline bool esp_ptr_external_ram(const void *p) {
+    return false;
+}
+
+#endif
@@ -0,0 +1,313 @@
+/* Host stand-in for the ADF audio element, stepped by the host pipeline */
+
+#include <string.h>
+#include "esp_log.h"
+#include "audio_mem.h"
+#include "audio_error.h"
+#include "audio_element.h"
+
+static const char *TAG = "AUDIO_ELEMENT";
+
+struct audio_element {
+    el_io_func open;
+    process_func process;
+    el_io_func close;
+    el_io_func destroy;
+    stream_func read_cb;
+    void *read_ctx;
+    stream_func write_cb;
+    void *write_ctx;
+    ringbuf_handle_t in_rb;
+    ringbuf_handle_t out_rb;
+    char *buf;
+    int buf_size;
+    int out_chunk;
+    void *data;
+    char *tag;
+    bool is_open;
+    audio_element_state_t state;
+    audio_element_info_t info;
+    audio_event_iface_handle_t listener;
+};
+
+audio_element_handle_t audio_element_init(audio_element_cfg_t *config) {
+    audio_element_handle_t el = audio_calloc(1, sizeof(struct audio_element));
+    AUDIO_MEM_CHECK(TAG, el, return NULL);
+    el->open = config->open;
+    el->process = config->process;
+    el->close = config->close;
+    el->destroy = config->destroy;
+    el->read_cb = config->read;
+    el->write_cb = config->write;
+    el->data = config->data;
+    el->buf_size = config->buffer_len > 0 ? config->buffer_len : DEFAULT_ELEMENT_BUFFER_LENGTH;
+    el->out_chunk = el->buf_size;
+    el->buf = audio_malloc(el->buf_size);
+    AUDIO_MEM_CHECK(TAG, el->buf, {
+        audio_free(el);
+        return NULL;
+    });
+    el->tag = config->tag ? strdup(config->tag) : NULL;
+    el->state = AEL_STATE_INIT;
+    el->info.sample_rates = 44100;
+    el->info.channels = 2;
+    el->info.bits = 16;
+    return el;
+}
+
+esp_err_t audio_element_deinit(audio_element_handle_t el) {
+    if (!el) {
+        return ESP_FAIL;
+    }
+    if (el->is_open && el->close) {
+        el->close(el);
+    }
+    if (el->destroy) {
+        el->destroy(el);
+    }
+    audio_free(el->buf);
+    free(el->tag);
+    audio_free(el);
+    return ESP_OK;
+}
+
+esp_err_t audio_element_setdata(audio_element_handle_t el, void *data) {
+    el->data = data;
+    return ESP_OK;
+}
+
+void *audio_element_getdata(audio_element_handle_t el) {
+    return el->data;
+}
+
+esp_err_t audio_element_set_tag(audio_element_handle_t el, const char *tag) {
+    free(el->tag);
+    el->tag = tag ? strdup(tag) : NULL;
+    return ESP_OK;
+}
+
+char *audio_element_get_tag(audio_element_handle_t el) {
+    return el->tag;
+}
+
+esp_err_t audio_element_setinfo(audio_element_handle_t el, audio_element_info_t *info) {
+    el->info = *info;
+    return ESP_OK;
+}
+
+esp_err_t audio_element_getinfo(audio_element_handle_t el, audio_element_info_t *info) {
+    *info = el->info;
+    return ESP_OK;
+}
+
+esp_err_t audio_element_set_music_info(audio_element_handle_t el, int sample_rates, int channels, int bits) {
+    el->info.sample_rates = sample_rates;
+    el->info.channels = channels;
+    el->info.bits = bits;
+    return ESP_OK;
+}
+
+static esp_err_t send_msg(audio_element_handle_t el, int cmd, void *data) {
+    if (!el->listener) {
+        return ESP_OK;
+    }
+    audio_event_iface_msg_t msg = {
+        .cmd = cmd,
+        .data = data,
+        .source = el,
+        .source_type = AUDIO_ELEMENT_TYPE_ELEMENT,
+    };
+    return audio_event_iface_cmd(el->listener, &msg);
+}
+
+esp_err_t audio_element_report_info(audio_element_handle_t el) {
+    return send_msg(el, AEL_MSG_CMD_REPORT_MUSIC_INFO, NULL);
+}
+
+esp_err_t audio_element_report_status(audio_element_handle_t el, audio_element_status_t status) {
+    return send_msg(el, AEL_MSG_CMD_REPORT_STATUS, (void *)(intptr_t)status);
+}
+
+esp_err_t audio_element_update_byte_pos(audio_element_handle_t el, int pos) {
+    el->info.byte_pos += pos;
+    return ESP_OK;
+}
+
+audio_element_state_t audio_element_get_state(audio_element_handle_t el) {
+    return el->state;
+}
+
+esp_err_t audio_element_run(audio_element_handle_t el) {
+    if (el->state != AEL_STATE_RUNNING && el->state != AEL_STATE_PAUSED) {
+        el->state = AEL_STATE_RUNNING;
+        audio_element_report_status(el, AEL_STATUS_STATE_RUNNING);
+    }
+    return ESP_OK;
+}
+
+esp_err_t audio_element_pause(audio_element_handle_t el) {
+    if (el->state == AEL_STATE_RUNNING) {
+        el->state = AEL_STATE_PAUSED;
+        audio_element_report_status(el, AEL_STATUS_STATE_PAUSED);
+    }
+    return ESP_OK;
+}
+
+esp_err_t audio_element_resume(audio_element_handle_t el, float wait_for_rb_threshold, TickType_t timeout) {
+    if (el->state == AEL_STATE_PAUSED) {
+        el->state = AEL_STATE_RUNNING;
+        audio_element_report_status(el, AEL_STATUS_STATE_RUNNING);
+    }
+    return ESP_OK;
+}
+
+esp_err_t audio_element_stop(audio_element_handle_t el) {
+    if (el->is_open && el->close) {
+        el->close(el);
+    }
+    el->is_open = false;
+    if (el->state == AEL_STATE_RUNNING || el->state == AEL_STATE_PAUSED) {
+        el->state = AEL_STATE_STOPPED;
+        audio_element_report_status(el, AEL_STATUS_STATE_STOPPED);
+    }
+    return ESP_OK;
+}
+
+esp_err_t audio_element_reset_state(audio_element_handle_t el) {
+    el->state = AEL_STATE_INIT;
+    el->info.byte_pos = 0;
+    return ESP_OK;
+}
+
+esp_err_t audio_element_reset_input_ringbuf(audio_element_handle_t el) {
+    return el->in_rb ? rb_reset(el->in_rb) : ESP_OK;
+}
+
+esp_err_t audio_element_reset_output_ringbuf(audio_element_handle_t el) {
+    return el->out_rb ? rb_reset(el->out_rb) : ESP_OK;
+}
+
+esp_err_t audio_element_set_read_cb(audio_element_handle_t el, stream_func fn, void *context) {
+    AUDIO_NULL_CHECK(TAG, el, return ESP_FAIL);
+    el->read_cb = fn;
+    el->read_ctx = context;
+    return ESP_OK;
+}
+
+esp_err_t audio_element_set_write_cb(audio_element_handle_t el, stream_func fn, void *context) {
+    AUDIO_NULL_CHECK(TAG, el, return ESP_FAIL);
+    el->write_cb = fn;
+    el->write_ctx = context;
+    return ESP_OK;
+}
+
+esp_err_t audio_element_set_input_ringbuf(audio_element_handle_t el, ringbuf_handle_t rb) {
+    el->in_rb = rb;
+    if (rb) {
+        el->read_cb = NULL;
+    }
+    return ESP_OK;
+}
+
+ringbuf_handle_t audio_element_get_input_ringbuf(audio_element_handle_t el) {
+    return el->in_rb;
+}
+
+esp_err_t audio_element_set_output_ringbuf(audio_element_handle_t el, ringbuf_handle_t rb) {
+    el->out_rb = rb;
+    if (rb) {
+        el->write_cb = NULL;
+    }
+    return ESP_OK;
+}
+
+ringbuf_handle_t audio_element_get_output_ringbuf(audio_element_handle_t el) {
+    return el->out_rb;
+}
+
+esp_err_t audio_element_msg_set_listener(audio_element_handle_t el, audio_event_iface_handle_t listener) {
+    el->listener = listener;
+    return ESP_OK;
+}
+
+esp_err_t audio_element_msg_remove_listener(audio_element_handle_t el, audio_event_iface_handle_t listener) {
+    el->listener = NULL;
+    return ESP_OK;
+}
+
+audio_element_err_t audio_element_input(audio_element_handle_t el, char *buffer, int wanted_size) {
+    if (el->read_cb) {
+        return el->read_cb(el, buffer, wanted_size, 0, el->read_ctx);
+    }
+    if (el->in_rb) {
+        return rb_read(el->in_rb, buffer, wanted_size, 0);
+    }
+    ESP_LOGE(TAG, "[%s] no input", el->tag);
+    return AEL_IO_FAIL;
+}
+
+audio_element_err_t audio_element_output(audio_element_handle_t el, char *buffer, int write_size) {
+    if (el->write_cb) {
+        return el->write_cb(el, buffer, write_size, 0, el->write_ctx);
+    }
+    if (el->out_rb) {
+        int n = rb_write(el->out_rb, buffer, write_size, 0);
+        if (n >= 0 && n < write_size) {
+            ESP_LOGE(TAG, "[%s] output ring buffer overflow, %d of %d bytes dropped", el->tag, write_size - n, write_size);
+        }
+        return n;
+    }
+    // no output: behave like a sink that consumed everything
+    return write_size;
+}
+
+esp_err_t audio_element_host_set_out_chunk(audio_element_handle_t el, int bytes) {
+    el->out_chunk = bytes;
+    return ESP_OK;
+}
+
+static void finish(audio_element_handle_t el, audio_element_state_t state, audio_element_status_t status) {
+    if (el->out_rb) {
+        rb_done_write(el->out_rb);
+    }
+    if (el->is_open && el->close) {
+        el->close(el);
+    }
+    el->is_open = false;
+    el->state = state;
+    audio_element_report_status(el, status);
+}
+
+int audio_element_host_step(audio_element_handle_t el) {
+    if (el->state != AEL_STATE_RUNNING) {
+        return 0;
+    }
+    if (!el->is_open) {
+        if (el->open && el->open(el) != ESP_OK) {
+            finish(el, AEL_STATE_ERROR, AEL_STATUS_ERROR_OPEN);
+            return 1;
+        }
+        el->is_open = true;
+    }
+    if (el->out_rb && rb_bytes_available(el->out_rb) < el->out_chunk) {
+        return 0;
+    }
+    int ret = el->process(el, el->buf, el->buf_size);
+    if (ret > 0) {
+        return 1;
+    }
+    switch (ret) {
+    case AEL_IO_TIMEOUT:
+        return 0;
+    case AEL_IO_OK:
+    case AEL_IO_DONE:
+        finish(el, AEL_STATE_FINISHED, AEL_STATUS_STATE_FINISHED);
+        return 1;
+    case AEL_IO_ABORT:
+        finish(el, AEL_STATE_STOPPED, AEL_STATUS_STATE_STOPPED);
+        return 1;
+    default:
+        finish(el, AEL_STATE_ERROR, AEL_STATUS_ERROR_PROCESS);
+        return 1;
+    }
+}
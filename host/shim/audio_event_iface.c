@@ -0,0 +1,98 @@
+/* Host stand-in for the ADF event interface */
+
+#include <string.h>
+#include "esp_log.h"
+#include "audio_mem.h"
+#include "audio_error.h"
+#include "audio_event_iface.h"
+
+static const char *TAG = "AUDIO_EVT";
+
+#define QUEUE_LEN   64
+#define MAX_PUMPS   4
+
+struct audio_event_iface {
+    audio_event_iface_msg_t queue[QUEUE_LEN];
+    int head;
+    int count;
+    audio_event_iface_handle_t listener;
+    struct {
+        audio_event_iface_pump_t fn;
+        void *ctx;
+    } pumps[MAX_PUMPS];
+    int num_pumps;
+};
+
+audio_event_iface_handle_t audio_event_iface_init(audio_event_iface_cfg_t *config) {
+    audio_event_iface_handle_t evt = audio_calloc(1, sizeof(struct audio_event_iface));
+    AUDIO_MEM_CHECK(TAG, evt, return NULL);
+    return evt;
+}
+
+esp_err_t audio_event_iface_destroy(audio_event_iface_handle_t evt) {
+    audio_free(evt);
+    return ESP_OK;
+}
+
+esp_err_t audio_event_iface_set_listener(audio_event_iface_handle_t evt, audio_event_iface_handle_t listener) {
+    evt->listener = listener;
+    return ESP_OK;
+}
+
+esp_err_t audio_event_iface_remove_listener(audio_event_iface_handle_t listen, audio_event_iface_handle_t evt) {
+    evt->listener = NULL;
+    return ESP_OK;
+}
+
+esp_err_t audio_event_iface_cmd(audio_event_iface_handle_t evt, audio_event_iface_msg_t *msg) {
+    if (evt->count == QUEUE_LEN) {
+        ESP_LOGW(TAG, "queue full, message dropped");
+        return ESP_FAIL;
+    }
+    evt->queue[(evt->head + evt->count) % QUEUE_LEN] = *msg;
+    evt->count++;
+    return ESP_OK;
+}
+
+esp_err_t audio_event_iface_sendout(audio_event_iface_handle_t evt, audio_event_iface_msg_t *msg) {
+    return evt->listener ? audio_event_iface_cmd(evt->listener, msg) : ESP_OK;
+}
+
+esp_err_t audio_event_iface_listen(audio_event_iface_handle_t evt, audio_event_iface_msg_t *msg, TickType_t wait_time) {
+    while (evt->count == 0 && wait_time != 0) {
+        int progress = 0;
+        for (int i = 0; i < evt->num_pumps; i++) {
+            progress += evt->pumps[i].fn(evt->pumps[i].ctx);
+        }
+        if (progress == 0) {
+            break;
+        }
+    }
+    if (evt->count == 0) {
+        return ESP_FAIL;
+    }
+    *msg = evt->queue[evt->head];
+    evt->head = (evt->head + 1) % QUEUE_LEN;
+    evt->count--;
+    return ESP_OK;
+}
+
+esp_err_t audio_event_iface_host_add_pump(audio_event_iface_handle_t evt, audio_event_iface_pump_t pump, void *ctx) {
+    if (evt->num_pumps == MAX_PUMPS) {
+        return ESP_FAIL;
+    }
+    evt->pumps[evt->num_pumps].fn = pump;
+    evt->pumps[evt->num_pumps].ctx = ctx;
+    evt->num_pumps++;
+    return ESP_OK;
+}
+
+esp_err_t audio_event_iface_host_remove_pump(audio_event_iface_handle_t evt, void *ctx) {
+    for (int i = 0; i < evt->num_pumps; i++) {
+        if (evt->pumps[i].ctx == ctx) {
+            evt->pumps[i] = evt->pumps[--evt->num_pumps];
+            return ESP_OK;
+        }
+    }
+    return ESP_FAIL;
+}
@@ -0,0 +1,206 @@
+/* Host stand-in for the ADF audio pipeline */
+
+#include <string.h>
+#include "esp_log.h"
+#include "audio_mem.h"
+#include "audio_error.h"
+#include "audio_pipeline.h"
+
+static const char *TAG = "AUDIO_PIPELINE";
+
+#define MAX_ELEMENTS 8
+
+struct audio_pipeline {
+    audio_element_handle_t registered[MAX_ELEMENTS];
+    int num_registered;
+    audio_element_handle_t linked[MAX_ELEMENTS];
+    ringbuf_handle_t rbs[MAX_ELEMENTS];
+    int num_linked;
+    int rb_size;
+    audio_element_state_t state;
+    audio_event_iface_handle_t listener;
+};
+
+audio_pipeline_handle_t audio_pipeline_init(audio_pipeline_cfg_t *config) {
+    audio_pipeline_handle_t pipeline = audio_calloc(1, sizeof(struct audio_pipeline));
+    AUDIO_MEM_CHECK(TAG, pipeline, return NULL);
+    pipeline->rb_size = config->rb_size;
+    pipeline->state = AEL_STATE_INIT;
+    return pipeline;
+}
+
+esp_err_t audio_pipeline_deinit(audio_pipeline_handle_t pipeline) {
+    audio_pipeline_terminate(pipeline);
+    audio_pipeline_unlink(pipeline);
+    for (int i = 0; i < pipeline->num_registered; i++) {
+        audio_element_deinit(pipeline->registered[i]);
+    }
+    audio_free(pipeline);
+    return ESP_OK;
+}
+
+esp_err_t audio_pipeline_register(audio_pipeline_handle_t pipeline, audio_element_handle_t el, const char *name) {
+    AUDIO_NULL_CHECK(TAG, el, return ESP_FAIL);
+    if (pipeline->num_registered == MAX_ELEMENTS) {
+        return ESP_FAIL;
+    }
+    audio_element_set_tag(el, name);
+    pipeline->registered[pipeline->num_registered++] = el;
+    return ESP_OK;
+}
+
+esp_err_t audio_pipeline_unregister(audio_pipeline_handle_t pipeline, audio_element_handle_t el) {
+    for (int i = 0; i < pipeline->num_registered; i++) {
+        if (pipeline->registered[i] == el) {
+            memmove(&pipeline->registered[i], &pipeline->registered[i + 1],
+                    (pipeline->num_registered - i - 1) * sizeof(el));
+            pipeline->num_registered--;
+            return ESP_OK;
+        }
+    }
+    return ESP_FAIL;
+}
+
+audio_element_handle_t audio_pipeline_get_el_by_tag(audio_pipeline_handle_t pipeline, const char *tag) {
+    for (int i = 0; i < pipeline->num_registered; i++) {
+        char *el_tag = audio_element_get_tag(pipeline->registered[i]);
+        if (el_tag && !strcmp(el_tag, tag)) {
+            return pipeline->registered[i];
+        }
+    }
+    return NULL;
+}
+
+esp_err_t audio_pipeline_link(audio_pipeline_handle_t pipeline, const char *link_tag[], int link_num) {
+    if (link_num > MAX_ELEMENTS) {
+        return ESP_FAIL;
+    }
+    audio_pipeline_unlink(pipeline);
+    for (int i = 0; i < link_num; i++) {
+        audio_element_handle_t el = audio_pipeline_get_el_by_tag(pipeline, link_tag[i]);
+        AUDIO_NULL_CHECK(TAG, el, return ESP_FAIL);
+        pipeline->linked[i] = el;
+        if (i > 0) {
+            ringbuf_handle_t rb = rb_create(pipeline->rb_size, 1);
+            AUDIO_MEM_CHECK(TAG, rb, return ESP_FAIL);
+            pipeline->rbs[i - 1] = rb;
+            audio_element_set_output_ringbuf(pipeline->linked[i - 1], rb);
+            audio_element_set_input_ringbuf(el, rb);
+        }
+    }
+    pipeline->num_linked = link_num;
+    return ESP_OK;
+}
+
+esp_err_t audio_pipeline_unlink(audio_pipeline_handle_t pipeline) {
+    for (int i = 0; i < pipeline->num_linked; i++) {
+        if (i > 0) {
+            audio_element_set_output_ringbuf(pipeline->linked[i - 1], NULL);
+            audio_element_set_input_ringbuf(pipeline->linked[i], NULL);
+            rb_destroy(pipeline->rbs[i - 1]);
+            pipeline->rbs[i - 1] = NULL;
+        }
+    }
+    pipeline->num_linked = 0;
+    return ESP_OK;
+}
+
+esp_err_t audio_pipeline_run(audio_pipeline_handle_t pipeline) {
+    if (pipeline->state != AEL_STATE_INIT) {
+        ESP_LOGW(TAG, "Pipeline already started, state:%d", pipeline->state);
+        return ESP_OK;
+    }
+    for (int i = 0; i < pipeline->num_linked; i++) {
+        audio_element_run(pipeline->linked[i]);
+    }
+    pipeline->state = AEL_STATE_RUNNING;
+    return ESP_OK;
+}
+
+esp_err_t audio_pipeline_stop(audio_pipeline_handle_t pipeline) {
+    for (int i = 0; i < pipeline->num_linked; i++) {
+        audio_element_stop(pipeline->linked[i]);
+    }
+    return ESP_OK;
+}
+
+esp_err_t audio_pipeline_wait_for_stop(audio_pipeline_handle_t pipeline) {
+    pipeline->state = AEL_STATE_STOPPED;
+    return ESP_OK;
+}
+
+esp_err_t audio_pipeline_terminate(audio_pipeline_handle_t pipeline) {
+    for (int i = 0; i < pipeline->num_linked; i++) {
+        audio_element_stop(pipeline->linked[i]);
+        audio_element_reset_state(pipeline->linked[i]);
+    }
+    pipeline->state = AEL_STATE_INIT;
+    return ESP_OK;
+}
+
+esp_err_t audio_pipeline_pause(audio_pipeline_handle_t pipeline) {
+    for (int i = 0; i < pipeline->num_linked; i++) {
+        audio_element_pause(pipeline->linked[i]);
+    }
+    pipeline->state = AEL_STATE_PAUSED;
+    return ESP_OK;
+}
+
+esp_err_t audio_pipeline_resume(audio_pipeline_handle_t pipeline) {
+    for (int i = 0; i < pipeline->num_linked; i++) {
+        audio_element_resume(pipeline->linked[i], 0, 0);
+    }
+    pipeline->state = AEL_STATE_RUNNING;
+    return ESP_OK;
+}
+
+esp_err_t audio_pipeline_reset_ringbuffer(audio_pipeline_handle_t pipeline) {
+    for (int i = 0; i + 1 < pipeline->num_linked; i++) {
+        rb_reset(pipeline->rbs[i]);
+    }
+    return ESP_OK;
+}
+
+esp_err_t audio_pipeline_reset_elements(audio_pipeline_handle_t pipeline) {
+    for (int i = 0; i < pipeline->num_linked; i++) {
+        audio_element_reset_state(pipeline->linked[i]);
+    }
+    return ESP_OK;
+}
+
+esp_err_t audio_pipeline_change_state(audio_pipeline_handle_t pipeline, audio_element_state_t new_state) {
+    pipeline->state = new_state;
+    return ESP_OK;
+}
+
+int audio_pipeline_host_step(audio_pipeline_handle_t pipeline) {
+    int progress = 0;
+    for (int i = pipeline->num_linked - 1; i >= 0; i--) {
+        progress += audio_element_host_step(pipeline->linked[i]);
+    }
+    return progress;
+}
+
+static int pipeline_pump(void *ctx) {
+    return audio_pipeline_host_step((audio_pipeline_handle_t)ctx);
+}
+
+esp_err_t audio_pipeline_set_listener(audio_pipeline_handle_t pipeline, audio_event_iface_handle_t evt) {
+    for (int i = 0; i < pipeline->num_registered; i++) {
+        audio_element_msg_set_listener(pipeline->registered[i], evt);
+    }
+    pipeline->listener = evt;
+    return audio_event_iface_host_add_pump(evt, pipeline_pump, pipeline);
+}
+
+esp_err_t audio_pipeline_remove_listener(audio_pipeline_handle_t pipeline) {
+    if (!pipeline->listener) {
+        return ESP_OK;
+    }
+    for (int i = 0; i < pipeline->num_registered; i++) {
+        audio_element_msg_remove_listener(pipeline->registered[i], pipeline->listener);
+    }
+    audio_event_iface_host_remove_pump(pipeline->listener, pipeline);
+    pipeline->listener = NULL;
+    return ESP_OK;
+}
@@ -0,0 +1,103 @@
+/* Host stand-in for the board and audio_hal: the codec is the real new_codec driver on the mock I2C bus */
+
+#include "audio_mem.h"
+#include "board.h"
+
+static audio_board_handle_t board_handle;
+
+audio_hal_handle_t audio_hal_init(audio_hal_codec_config_t *audio_hal_conf, audio_hal_func_t *audio_hal_func) {
+    audio_hal_handle_t hal = audio_calloc(1, sizeof(struct audio_hal));
+    if (!hal) {
+        return NULL;
+    }
+    *hal = *audio_hal_func;
+    // as ADF's audio_hal_init()
+    esp_err_t ret = hal->audio_codec_initialize(audio_hal_conf);
+    ret |= hal->audio_codec_config_iface(audio_hal_conf->codec_mode, &audio_hal_conf->i2s_iface);
+    ret |= hal->audio_codec_set_volume(AUDIO_HAL_VOL_DEFAULT);
+    if (ret != ESP_OK) {
+        audio_free(hal);
+        return NULL;
+    }
+    return hal;
+}
+
+esp_err_t audio_hal_deinit(audio_hal_handle_t audio_hal) {
+    esp_err_t ret = audio_hal->audio_codec_deinitialize();
+    audio_free(audio_hal);
+    return ret;
+}
+
+esp_err_t audio_hal_ctrl_codec(audio_hal_handle_t audio_hal, audio_hal_codec_mode_t mode, audio_hal_ctrl_t audio_hal_ctrl) {
+    return audio_hal->audio_codec_ctrl(mode, audio_hal_ctrl);
+}
+
+esp_err_t audio_hal_set_mute(audio_hal_handle_t audio_hal, bool mute) {
+    return audio_hal->audio_codec_set_mute(mute);
+}
+
+esp_err_t audio_hal_set_volume(audio_hal_handle_t audio_hal, int volume) {
+    return audio_hal->audio_codec_set_volume(volume);
+}
+
+esp_err_t audio_hal_get_volume(audio_hal_handle_t audio_hal, int *volume) {
+    return audio_hal->audio_codec_get_volume(volume);
+}
+
+audio_board_handle_t audio_board_init(void) {
+    if (board_handle) {
+        return board_handle;
+    }
+    board_handle = audio_calloc(1, sizeof(struct audio_board_handle));
+    if (!board_handle) {
+        return NULL;
+    }
+    audio_hal_codec_config_t cfg = {
+        .adc_input = AUDIO_HAL_ADC_INPUT_LINE1,
+        .dac_output = AUDIO_HAL_DAC_OUTPUT_ALL,
+        .codec_mode = AUDIO_HAL_CODEC_MODE_BOTH,
+        .i2s_iface = {
+            .mode = AUDIO_HAL_MODE_SLAVE,
+            .fmt = AUDIO_HAL_I2S_NORMAL,
+            .samples = AUDIO_HAL_48K_SAMPLES,
+            .bits = AUDIO_HAL_BIT_LENGTH_16BITS,
+        },
+    };
+    board_handle->audio_hal = audio_hal_init(&cfg, &AUDIO_NEW_CODEC_DEFAULT_HANDLE);
+    return board_handle;
+}
+
+audio_board_handle_t audio_board_get_handle(void) {
+    return board_handle;
+}
+
+esp_err_t audio_board_deinit(audio_board_handle_t audio_board) {
+    esp_err_t ret = audio_hal_deinit(audio_board->audio_hal);
+    audio_free(audio_board);
+    board_handle = NULL;
+    return ret;
+}
+
+int8_t get_input_volup_id(void) {
+    return BUTTON_VOLUP_ID;
+}
+
+int8_t get_input_voldown_id(void) {
+    return BUTTON_VOLDOWN_ID;
+}
+
+int8_t get_input_mute_id(void) {
+    return BUTTON_MUTE_ID;
+}
+
+int8_t get_input_set_id(void) {
+    return BUTTON_SET_ID;
+}
+
+int8_t get_input_mode_id(void) {
+    return BUTTON_MODE_ID;
+}
+
+int8_t get_input_play_id(void) {
+    return BUTTON_PLAY_ID;
+}
@@ -0,0 +1,148 @@
+/* Host implementations of the esp_log / esp_err / esp_timer / vTaskDelay / audio_mem helpers */
+
+#include <stdio.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <malloc.h>
+#include "esp_err.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_rom_crc.h"
+#include "freertos/task.h"
+#include "audio_mem.h"
+
+static esp_log_level_t log_level = ESP_LOG_WARN;
+
+void esp_log_level_set(const char *tag, esp_log_level_t level) {
+    // per-tag levels are not needed on the host
+    if (!strcmp(tag, "*")) {
+        log_level = level;
+    }
+}
+
+void esp_log_write(esp_log_level_t level, const char *tag, const char *format, ...) {
+    static const char letter[] = "NEWIDV";
+    if (level > log_level) {
+        return;
+    }
+    va_list args;
+    va_start(args, format);
+    fprintf(stderr, "%c (%s) ", letter[level], tag);
+    vfprintf(stderr, format, args);
+    fputc('\n', stderr);
+    va_end(args);
+}
+
+uint32_t esp_rom_crc32_le(uint32_t crc, const uint8_t *buf, uint32_t len) {
+    crc = ~crc;
+    for (uint32_t i = 0; i < len; i++) {
+        crc ^= buf[i];
+        for (int b = 0; b < 8; b++) {
+            crc = (crc >> 1) ^ (0xEDB88320 & -(crc & 1));
+        }
+    }
+    return ~crc;
+}
+
+const char *esp_err_to_name(esp_err_t code) {
+    switch (code) {
+    case ESP_OK:
+        return "ESP_OK";
+    case ESP_FAIL:
+        return "ESP_FAIL";
+    case ESP_ERR_NO_MEM:
+        return "ESP_ERR_NO_MEM";
+    case ESP_ERR_INVALID_ARG:
+        return "ESP_ERR_INVALID_ARG";
+    case ESP_ERR_INVALID_STATE:
+        return "ESP_ERR_INVALID_STATE";
+    case ESP_ERR_INVALID_SIZE:
+        return "ESP_ERR_INVALID_SIZE";
+    case ESP_ERR_NOT_FOUND:
+        return "ESP_ERR_NOT_FOUND";
+    case ESP_ERR_TIMEOUT:
+        return "ESP_ERR_TIMEOUT";
+    case ESP_ERR_INVALID_CRC:
+        return "ESP_ERR_INVALID_CRC";
+    default:
+        return "UNKNOWN ERROR";
+    }
+}
+
+void host_abort_on_error(esp_err_t rc, const char *file, int line, const char *expr) {
+    fprintf(stderr, "ESP_ERROR_CHECK failed: esp_err_t 0x%x (%s) at %s:%d\nexpression: %s\n",
+            rc, esp_err_to_name(rc), file, line, expr);
+    abort();
+}
+
+static int64_t sim_offset_us;
+
+int64_t esp_timer_get_time(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000 + sim_offset_us;
+}
+
+void esp_timer_host_advance(int64_t us) {
+    sim_offset_us += us;
+}
+
+void vTaskDelay(const TickType_t ticks) {
+    esp_timer_host_advance((int64_t)ticks * portTICK_PERIOD_MS * 1000);
+}
+
+static audio_mem_host_stats_t mem_stats;
+
+static void *counted(void *ptr) {
+    if (ptr) {
+        mem_stats.allocs++;
+        mem_stats.in_use += malloc_usable_size(ptr);
+        if (mem_stats.in_use > mem_stats.peak) {
+            mem_stats.peak = mem_stats.in_use;
+        }
+    }
+    return ptr;
+}
+
+static void uncounted(void *ptr) {
+    if (ptr) {
+        mem_stats.frees++;
+        mem_stats.in_use -= malloc_usable_size(ptr);
+    }
+}
+
+void *audio_malloc(size_t size) {
+    return counted(malloc(size));
+}
+
+void *audio_calloc(size_t nmemb, size_t size) {
+    return counted(calloc(nmemb, size));
+}
+
+void *audio_realloc(void *ptr, size_t size) {
+    size_t old = ptr ? malloc_usable_size(ptr) : 0;
+    void *p = realloc(ptr, size);
+    if (p) {
+        mem_stats.in_use -= old;
+        if (ptr) {
+            mem_stats.frees++;
+        }
+        counted(p);
+    }
+    return p;
+}
+
+void audio_free(void *ptr) {
+    uncounted(ptr);
+    free(ptr);
+}
+
+void audio_mem_host_get_stats(audio_mem_host_stats_t *stats) {
+    *stats = mem_stats;
+}
+
+void audio_mem_host_reset_peak(void) {
+    mem_stats.peak = mem_stats.in_use;
+}
@@ -0,0 +1,85 @@
+/* Mock I2C bus of the codec: the register file of the chip, its traffic counted as new_codec_i2c.c puts it on the wire */
+
+#include <stdbool.h>
+#include <string.h>
+#include "esp_log.h"
+#include "new_codec_i2c.h"
+#include "i2c_mock.h"
+
+static uint8_t regs[256];
+static i2c_mock_stats_t stats;
+static int fail_next;
+static bool absent;
+static bool bus_open;
+
+static esp_err_t mock_write(void *ctx, const uint8_t *r, const uint8_t *v, int n) {
+    if (absent || fail_next) {
+        fail_next -= fail_next > 0;
+        stats.failures++;
+        return ESP_FAIL;
+    }
+    stats.transactions++;
+    stats.reg_writes += n;
+    // a (repeated) START, address, register and value each
+    stats.bytes += n * 3;
+    for (int i = 0; i < n; i++) {
+        regs[r[i]] = v[i];
+    }
+    return ESP_OK;
+}
+
+static esp_err_t mock_read(void *ctx, uint8_t reg, uint8_t *val) {
+    if (absent || fail_next) {
+        fail_next -= fail_next > 0;
+        stats.failures++;
+        return ESP_FAIL;
+    }
+    stats.reg_reads++;
+    // address, register, address again and the value
+    stats.bytes += 4;
+    *val = regs[reg];
+    return ESP_OK;
+}
+
+esp_err_t new_codec_i2c_open(codec_bus_t *bus) {
+    if (bus_open) {
+        return ESP_FAIL;
+    }
+    bus_open = true;
+    bus->write = mock_write;
+    bus->read = mock_read;
+    bus->ctx = NULL;
+    return ESP_OK;
+}
+
+void new_codec_i2c_close(void) {
+    bus_open = false;
+}
+
+double i2c_mock_bus_us(const i2c_mock_stats_t *s) {
+    return s->bytes * 9 * 1e6 / NEW_CODEC_I2C_SPEED;
+}
+
+void i2c_mock_get_stats(i2c_mock_stats_t *s) {
+    *s = stats;
+}
+
+void i2c_mock_reset_stats(void) {
+    memset(&stats, 0, sizeof(stats));
+}
+
+uint8_t i2c_mock_reg(uint8_t reg) {
+    return regs[reg];
+}
+
+void i2c_mock_set_reg(uint8_t reg, uint8_t val) {
+    regs[reg] = val;
+}
+
+void i2c_mock_fail_next(int n) {
+    fail_next = n;
+}
+
+void i2c_mock_set_absent(bool no_chip) {
+    absent = no_chip;
+}
@@ -0,0 +1,214 @@
+/* Host stand-in for the ADF mp3 decoder element */
+
+#include <string.h>
+#include "esp_log.h"
+#include "audio_mem.h"
+#include "audio_error.h"
+#include "mp3_decoder.h"
+#include "mp3_frame.h"
+#ifdef HOST_HAVE_MPG123
+#include <mpg123.h>
+#endif
+
+static const char *TAG = "MP3_DECODER";
+
+#define IN_BUF_SIZE     (4 * MP3_FRAME_MAX_BYTES)
+#define PCM_MAX_BYTES   (MP3_FRAME_MAX_SAMPLES * 2 * sizeof(int16_t))
+
+typedef struct {
+    uint8_t in[IN_BUF_SIZE];
+    int fill;
+    int skip;
+    bool eof;
+    bool started;
+    int sample_rate;
+    int channels;
+    uint8_t pcm[2 * PCM_MAX_BYTES];
+#ifdef HOST_HAVE_MPG123
+    mpg123_handle *mh;
+#endif
+} mp3_host_t;
+
+const char *mp3_decoder_host_backend(void) {
+#ifdef HOST_HAVE_MPG123
+    return "libmpg123";
+#else
+    return "frame-walk (silence)";
+#endif
+}
+
+static esp_err_t _mp3_open(audio_element_handle_t self) {
+    mp3_host_t *mp3 = (mp3_host_t *)audio_element_getdata(self);
+    mp3->fill = 0;
+    mp3->skip = 0;
+    mp3->eof = false;
+    mp3->started = false;
+    mp3->sample_rate = 0;
+    mp3->channels = 0;
+#ifdef HOST_HAVE_MPG123
+    if (mp3->mh) {
+        mpg123_delete(mp3->mh);
+    }
+    int err;
+    mp3->mh = mpg123_new(NULL, &err);
+    AUDIO_NULL_CHECK(TAG, mp3->mh, return ESP_FAIL);
+    mpg123_param(mp3->mh, MPG123_ADD_FLAGS, MPG123_QUIET, 0);
+    const long *rates;
+    size_t num_rates;
+    mpg123_rates(&rates, &num_rates);
+    mpg123_format_none(mp3->mh);
+    for (size_t i = 0; i < num_rates; i++) {
+        mpg123_format(mp3->mh, rates[i], MPG123_MONO | MPG123_STEREO, MPG123_ENC_SIGNED_16);
+    }
+    if (mpg123_open_feed(mp3->mh) != MPG123_OK) {
+        return ESP_FAIL;
+    }
+#endif
+    return ESP_OK;
+}
+
+static esp_err_t _mp3_close(audio_element_handle_t self) {
+#ifdef HOST_HAVE_MPG123
+    mp3_host_t *mp3 = (mp3_host_t *)audio_element_getdata(self);
+    if (mp3->mh) {
+        mpg123_delete(mp3->mh);
+        mp3->mh = NULL;
+    }
+#endif
+    return ESP_OK;
+}
+
+static esp_err_t _mp3_destroy(audio_element_handle_t self) {
+    audio_free(audio_element_getdata(self));
+    return ESP_OK;
+}
+
+static int refill(audio_element_handle_t self, mp3_host_t *mp3, bool *starved) {
+    *starved = false;
+    while (!mp3->eof && mp3->fill < IN_BUF_SIZE) {
+        int r = audio_element_input(self, (char *)mp3->in + mp3->fill, IN_BUF_SIZE - mp3->fill);
+        if (r > 0) {
+            mp3->fill += r;
+            if (mp3->skip) {
+                int n = mp3->skip < mp3->fill ? mp3->skip : mp3->fill;
+                memmove(mp3->in, mp3->in + n, mp3->fill - n);
+                mp3->fill -= n;
+                mp3->skip -= n;
+            }
+        } else if (r == AEL_IO_DONE || r == AEL_IO_OK) {
+            mp3->eof = true;
+        } else if (r == AEL_IO_TIMEOUT) {
+            *starved = true;
+            break;
+        } else {
+            return r;
+        }
+    }
+    return AEL_IO_OK;
+}
+
+static int decode_frame(mp3_host_t *mp3, const uint8_t *frame, const mp3_frame_info_t *info) {
+#ifdef HOST_HAVE_MPG123
+    size_t done = 0, total = 0;
+    int ret = mpg123_decode(mp3->mh, frame, info->frame_bytes, mp3->pcm, sizeof(mp3->pcm), &done);
+    while (1) {
+        total += done;
+        if (ret == MPG123_NEW_FORMAT) {
+            long rate;
+            int channels, enc;
+            mpg123_getformat(mp3->mh, &rate, &channels, &enc);
+        } else if (ret != MPG123_OK) {
+            break;
+        }
+        ret = mpg123_decode(mp3->mh, NULL, 0, mp3->pcm + total, sizeof(mp3->pcm) - total, &done);
+    }
+    return ret == MPG123_NEED_MORE ? (int)total : AEL_PROCESS_FAIL;
+#else
+    int bytes = info->samples * info->channels * sizeof(int16_t);
+    memset(mp3->pcm, 0, bytes);
+    return bytes;
+#endif
+}
+
+static audio_element_err_t _mp3_process(audio_element_handle_t self, char *in_buffer, int in_len) {
+    mp3_host_t *mp3 = (mp3_host_t *)audio_element_getdata(self);
+    bool starved;
+    while (1) {
+        int ret = refill(self, mp3, &starved);
+        if (ret != AEL_IO_OK) {
+            return ret;
+        }
+        if (!mp3->started) {
+            if (mp3->fill < 10 && !mp3->eof) {
+                return AEL_IO_TIMEOUT;
+            }
+            mp3->started = true;
+            mp3->skip = mp3_id3v2_size(mp3->in, mp3->fill);
+            int n = mp3->skip < mp3->fill ? mp3->skip : mp3->fill;
+            memmove(mp3->in, mp3->in + n, mp3->fill - n);
+            mp3->fill -= n;
+            mp3->skip -= n;
+            continue;
+        }
+
+        mp3_frame_info_t info;
+        int off = mp3_frame_sync(mp3->in, mp3->fill, &info);
+        if (off < 0 || off + info.frame_bytes > mp3->fill) {
+            if (mp3->eof) {
+                return AEL_IO_DONE;
+            }
+            if (starved) {
+                return AEL_IO_TIMEOUT;
+            }
+            // skip garbage up to the frame, or keep only the tail in case a header straddles it
+            int drop = off > 0 ? off : mp3->fill - (MP3_FRAME_HEADER_SIZE - 1);
+            memmove(mp3->in, mp3->in + drop, mp3->fill - drop);
+            mp3->fill -= drop;
+            continue;
+        }
+
+        int bytes = decode_frame(mp3, mp3->in + off, &info);
+        int consumed = off + info.frame_bytes;
+        memmove(mp3->in, mp3->in + consumed, mp3->fill - consumed);
+        mp3->fill -= consumed;
+        if (bytes < 0) {
+            return bytes;
+        }
+        if (info.sample_rate != mp3->sample_rate || info.channels != mp3->channels) {
+            mp3->sample_rate = info.sample_rate;
+            mp3->channels = info.channels;
+            audio_element_set_music_info(self, info.sample_rate, info.channels, 16);
+            audio_element_report_info(self);
+        }
+        if (bytes == 0) {
+            // decoder is still priming
+            continue;
+        }
+        int w = audio_element_output(self, (char *)mp3->pcm, bytes);
+        return w > 0 ? w : AEL_IO_FAIL;
+    }
+}
+
+audio_element_handle_t mp3_decoder_init(mp3_decoder_cfg_t *config) {
+    mp3_host_t *mp3 = audio_calloc(1, sizeof(mp3_host_t));
+    AUDIO_MEM_CHECK(TAG, mp3, return NULL);
+#ifdef HOST_HAVE_MPG123
+    mpg123_init();
+#endif
+    audio_element_cfg_t cfg = DEFAULT_AUDIO_ELEMENT_CONFIG();
+    cfg.open = _mp3_open;
+    cfg.process = _mp3_process;
+    cfg.close = _mp3_close;
+    cfg.destroy = _mp3_destroy;
+    cfg.task_core = config->task_core;
+    cfg.out_rb_size = config->out_rb_size;
+    cfg.data = mp3;
+    cfg.tag = "mp3";
+    audio_element_handle_t el = audio_element_init(&cfg);
+    AUDIO_MEM_CHECK(TAG, el, {
+        audio_free(mp3);
+        return NULL;
+    });
+    audio_element_host_set_out_chunk(el, PCM_MAX_BYTES);
+    return el;
+}
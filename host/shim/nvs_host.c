@@ -0,0 +1,353 @@
+/* Host model of the NVS page layout, see host/include/nvs.h
+ *
+ * Follows nvs_page / nvs_pagemanager / nvs_storage of ESP-IDF v4.4:
+ * - an item takes one 32-byte entry, a blob chunk 1 + ceil(len / 32) plus a
+ *   blob index entry;
+ * - writing an item programs its entries and their state bits, erasing the
+ *   previous version programs its state bits; writing the value an item
+ *   already has is skipped;
+ * - a page whose free entries cannot hold an item is marked full and the
+ *   next free page is activated (header program). One free page is kept
+ *   back: when it is the last one, the full page with the most erased
+ *   entries is compacted into it and erased.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include "nvs.h"
+
+#define PAGE_SIZE       4096
+#define PAGE_ENTRIES    126
+#define ENTRY_SIZE      32
+#define MAX_PAGES       16
+#define MAX_ITEMS       (MAX_PAGES * PAGE_ENTRIES)
+#define MAX_NAMESPACES  16
+#define KEY_SIZE        16
+
+typedef enum {
+    ITEM_NONE,
+    ITEM_NAMESPACE,
+    ITEM_U32,
+    ITEM_U64,
+    ITEM_BLOB_DATA,
+    ITEM_BLOB_IDX,
+} item_type_t;
+
+typedef enum {
+    PAGE_EMPTY,
+    PAGE_ACTIVE,
+    PAGE_FULL,
+} page_state_t;
+
+typedef struct {
+    item_type_t type;
+    uint8_t ns;
+    char key[KEY_SIZE];
+    int page;
+    int span;
+    uint64_t value;
+    uint8_t *blob;
+    size_t len;
+} item_t;
+
+typedef struct {
+    page_state_t state;
+    int used;           // entries written or erased, the write pointer
+    int erased;
+    uint32_t erase_count;
+} page_t;
+
+static struct {
+    int num_pages;
+    int active;
+    page_t pages[MAX_PAGES];
+    item_t items[MAX_ITEMS];
+    char ns_names[MAX_NAMESPACES][KEY_SIZE];
+    int num_ns;
+    nvs_host_stats_t stats;
+} nvs;
+
+static void program(size_t bytes) {
+    nvs.stats.programs++;
+    nvs.stats.program_bytes += bytes;
+}
+
+static void write_entries(item_t *it, int page) {
+    page_t *p = &nvs.pages[page];
+    it->page = page;
+    p->used += it->span;
+    program(it->span * ENTRY_SIZE);
+    // state bitmap: 2 bits per entry
+    program(4);
+}
+
+static void erase_entries(item_t *it) {
+    nvs.pages[it->page].erased += it->span;
+    program(4);
+    free(it->blob);
+    memset(it, 0, sizeof(*it));
+}
+
+static void activate(int page) {
+    nvs.pages[page].state = PAGE_ACTIVE;
+    program(ENTRY_SIZE);
+}
+
+static int count_free(int *first) {
+    int n = 0;
+    for (int i = nvs.num_pages - 1; i >= 0; i--) {
+        if (nvs.pages[i].state == PAGE_EMPTY) {
+            *first = i;
+            n++;
+        }
+    }
+    return n;
+}
+
+/**
+ * @brief Move the live items of the full page with the most erased entries to the reserved page and erase it
+ */
+static int compact(int reserve) {
+    int victim = -1;
+    for (int i = 0; i < nvs.num_pages; i++) {
+        if (nvs.pages[i].state == PAGE_FULL && nvs.pages[i].erased > 0
+            && (victim < 0 || nvs.pages[i].erased > nvs.pages[victim].erased)) {
+            victim = i;
+        }
+    }
+    if (victim < 0) {
+        return -1;
+    }
+    activate(reserve);
+    for (int i = 0; i < MAX_ITEMS; i++) {
+        if (nvs.items[i].type != ITEM_NONE && nvs.items[i].page == victim) {
+            write_entries(&nvs.items[i], reserve);
+            nvs.stats.items_moved++;
+        }
+    }
+    page_t *p = &nvs.pages[victim];
+    p->state = PAGE_EMPTY;
+    p->used = 0;
+    p->erased = 0;
+    p->erase_count++;
+    nvs.stats.erases++;
+    if (p->erase_count > nvs.stats.max_page_erases) {
+        nvs.stats.max_page_erases = p->erase_count;
+    }
+    return reserve;
+}
+
+static int request_page(void) {
+    int first = -1;
+    int n = count_free(&first);
+    if (n == 0) {
+        return -1;
+    }
+    if (n == 1) {
+        return compact(first);
+    }
+    activate(first);
+    return first;
+}
+
+static esp_err_t alloc(int span) {
+    if (span > PAGE_ENTRIES) {
+        return ESP_ERR_NVS_INVALID_LENGTH;
+    }
+    for (int tries = 0; tries <= nvs.num_pages; tries++) {
+        if (nvs.active >= 0 && nvs.pages[nvs.active].used + span <= PAGE_ENTRIES) {
+            return ESP_OK;
+        }
+        if (nvs.active >= 0) {
+            nvs.pages[nvs.active].state = PAGE_FULL;
+            program(4);
+        }
+        nvs.active = request_page();
+        if (nvs.active < 0) {
+            return ESP_ERR_NVS_NOT_ENOUGH_SPACE;
+        }
+    }
+    return ESP_ERR_NVS_NOT_ENOUGH_SPACE;
+}
+
+static item_t *find(int ns, item_type_t type, const char *key) {
+    for (int i = 0; i < MAX_ITEMS; i++) {
+        item_t *it = &nvs.items[i];
+        if (it->type == type && it->ns == ns && !strncmp(it->key, key, KEY_SIZE)) {
+            return it;
+        }
+    }
+    return NULL;
+}
+
+static item_t *new_item(int ns, item_type_t type, const char *key, int span) {
+    for (int i = 0; i < MAX_ITEMS; i++) {
+        item_t *it = &nvs.items[i];
+        if (it->type == ITEM_NONE) {
+            it->type = type;
+            it->ns = ns;
+            strncpy(it->key, key, KEY_SIZE - 1);
+            it->span = span;
+            write_entries(it, nvs.active);
+            return it;
+        }
+    }
+    return NULL;
+}
+
+static esp_err_t set_value(nvs_handle_t handle, item_type_t type, const char *key, uint64_t value) {
+    if (handle == 0 || handle > nvs.num_ns) {
+        return ESP_ERR_NVS_INVALID_HANDLE;
+    }
+    item_t *old = find(handle, type, key);
+    if (old && old->value == value) {
+        return ESP_OK;
+    }
+    // compaction may move the old version to another page, its record stays where it is
+    esp_err_t err = alloc(1);
+    if (err != ESP_OK) {
+        return err;
+    }
+    item_t *it = new_item(handle, type, key, 1);
+    if (!it) {
+        return ESP_ERR_NVS_NOT_ENOUGH_SPACE;
+    }
+    it->value = value;
+    if (old) {
+        erase_entries(old);
+    }
+    return ESP_OK;
+}
+
+static esp_err_t get_value(nvs_handle_t handle, item_type_t type, const char *key, uint64_t *value) {
+    item_t *it = find(handle, type, key);
+    if (!it) {
+        return ESP_ERR_NVS_NOT_FOUND;
+    }
+    *value = it->value;
+    return ESP_OK;
+}
+
+esp_err_t nvs_host_format(size_t size) {
+    for (int i = 0; i < MAX_ITEMS; i++) {
+        free(nvs.items[i].blob);
+    }
+    memset(&nvs, 0, sizeof(nvs));
+    nvs.num_pages = size / PAGE_SIZE;
+    if (nvs.num_pages < 2 || nvs.num_pages > MAX_PAGES) {
+        nvs.num_pages = 0;
+        return ESP_ERR_INVALID_SIZE;
+    }
+    nvs.active = -1;
+    nvs.stats.pages = nvs.num_pages;
+    return ESP_OK;
+}
+
+void nvs_host_get_stats(nvs_host_stats_t *stats) {
+    *stats = nvs.stats;
+}
+
+esp_err_t nvs_open(const char *name, nvs_open_mode_t open_mode, nvs_handle_t *out_handle) {
+    if (nvs.num_pages == 0 && nvs_host_format(0x6000) != ESP_OK) {
+        return ESP_ERR_NVS_NOT_INITIALIZED;
+    }
+    for (int i = 0; i < nvs.num_ns; i++) {
+        if (!strncmp(nvs.ns_names[i], name, KEY_SIZE)) {
+            *out_handle = i + 1;
+            return ESP_OK;
+        }
+    }
+    if (open_mode == NVS_READONLY) {
+        return ESP_ERR_NVS_NOT_FOUND;
+    }
+    if (nvs.num_ns == MAX_NAMESPACES) {
+        return ESP_ERR_NVS_NOT_ENOUGH_SPACE;
+    }
+    // namespaces are u8 items of namespace 0
+    esp_err_t err = alloc(1);
+    if (err != ESP_OK) {
+        return err;
+    }
+    new_item(0, ITEM_NAMESPACE, name, 1)->value = nvs.num_ns + 1;
+    strncpy(nvs.ns_names[nvs.num_ns], name, KEY_SIZE - 1);
+    *out_handle = ++nvs.num_ns;
+    return ESP_OK;
+}
+
+void nvs_close(nvs_handle_t handle) {
+}
+
+esp_err_t nvs_set_u32(nvs_handle_t handle, const char *key, uint32_t value) {
+    return set_value(handle, ITEM_U32, key, value);
+}
+
+esp_err_t nvs_get_u32(nvs_handle_t handle, const char *key, uint32_t *out_value) {
+    uint64_t v;
+    esp_err_t err = get_value(handle, ITEM_U32, key, &v);
+    if (err == ESP_OK) {
+        *out_value = (uint32_t)v;
+    }
+    return err;
+}
+
+esp_err_t nvs_set_u64(nvs_handle_t handle, const char *key, uint64_t value) {
+    return set_value(handle, ITEM_U64, key, value);
+}
+
+esp_err_t nvs_get_u64(nvs_handle_t handle, const char *key, uint64_t *out_value) {
+    return get_value(handle, ITEM_U64, key, out_value);
+}
+
+esp_err_t nvs_set_blob(nvs_handle_t handle, const char *key, const void *value, size_t length) {
+    if (handle == 0 || handle > nvs.num_ns) {
+        return ESP_ERR_NVS_INVALID_HANDLE;
+    }
+    item_t *old_data = find(handle, ITEM_BLOB_DATA, key);
+    item_t *old_idx = find(handle, ITEM_BLOB_IDX, key);
+    if (old_data && old_data->len == length && !memcmp(old_data->blob, value, length)) {
+        return ESP_OK;
+    }
+    // one chunk: the chunk header and its data, then the index that points at it
+    int span = 1 + (length + ENTRY_SIZE - 1) / ENTRY_SIZE;
+    esp_err_t err = alloc(span);
+    if (err != ESP_OK) {
+        return err;
+    }
+    item_t *data = new_item(handle, ITEM_BLOB_DATA, key, span);
+    if (!data || !(data->blob = malloc(length ? length : 1))) {
+        return ESP_ERR_NO_MEM;
+    }
+    memcpy(data->blob, value, length);
+    data->len = length;
+    if ((err = alloc(1)) != ESP_OK) {
+        return err;
+    }
+    new_item(handle, ITEM_BLOB_IDX, key, 1)->value = length;
+    if (old_data) {
+        erase_entries(old_data);
+    }
+    if (old_idx) {
+        erase_entries(old_idx);
+    }
+    return ESP_OK;
+}
+
+esp_err_t nvs_get_blob(nvs_handle_t handle, const char *key, void *out_value, size_t *length) {
+    item_t *it = find(handle, ITEM_BLOB_DATA, key);
+    if (!it) {
+        return ESP_ERR_NVS_NOT_FOUND;
+    }
+    if (out_value) {
+        if (*length < it->len) {
+            return ESP_ERR_NVS_INVALID_LENGTH;
+        }
+        memcpy(out_value, it->blob, it->len);
+    }
+    *length = it->len;
+    return ESP_OK;
+}
+
+esp_err_t nvs_commit(nvs_handle_t handle) {
+    return handle == 0 || handle > nvs.num_ns ? ESP_ERR_NVS_INVALID_HANDLE : ESP_OK;
+}
@@ -0,0 +1,77 @@
+/* PCM file / null sink, takes the place of the i2s stream writer on the host */
+
+#include <stdio.h>
+#include "esp_log.h"
+#include "audio_mem.h"
+#include "audio_error.h"
+#include "esp_timer.h"
+#include "pcm_sink.h"
+
+static const char *TAG = "PCM_SINK";
+
+typedef struct {
+    FILE *fp;
+    int64_t bytes;
+    bool realtime;
+} pcm_sink_t;
+
+static audio_element_err_t _pcm_sink_process(audio_element_handle_t self, char *in_buffer, int in_len) {
+    pcm_sink_t *sink = (pcm_sink_t *)audio_element_getdata(self);
+    int r = audio_element_input(self, in_buffer, in_len);
+    if (r <= 0) {
+        return r;
+    }
+    if (sink->fp && fwrite(in_buffer, 1, r, sink->fp) != (size_t)r) {
+        ESP_LOGE(TAG, "write failed");
+        return AEL_IO_FAIL;
+    }
+    sink->bytes += r;
+    audio_element_update_byte_pos(self, r);
+    if (sink->realtime) {
+        audio_element_info_t info;
+        audio_element_getinfo(self, &info);
+        if (info.sample_rates > 0 && info.channels > 0 && info.bits > 0) {
+            esp_timer_host_advance((int64_t)r * 8000000 / (info.sample_rates * info.channels * info.bits));
+        }
+    }
+    return r;
+}
+
+static esp_err_t _pcm_sink_destroy(audio_element_handle_t self) {
+    pcm_sink_t *sink = (pcm_sink_t *)audio_element_getdata(self);
+    if (sink->fp) {
+        fclose(sink->fp);
+    }
+    audio_free(sink);
+    return ESP_OK;
+}
+
+audio_element_handle_t pcm_sink_init(const pcm_sink_cfg_t *config) {
+    pcm_sink_t *sink = audio_calloc(1, sizeof(pcm_sink_t));
+    AUDIO_MEM_CHECK(TAG, sink, return NULL);
+    if (config->path && !(sink->fp = fopen(config->path, "wb"))) {
+        ESP_LOGE(TAG, "failed to create %s", config->path);
+        audio_free(sink);
+        return NULL;
+    }
+    sink->realtime = config->realtime;
+    audio_element_cfg_t cfg = DEFAULT_AUDIO_ELEMENT_CONFIG();
+    cfg.process = _pcm_sink_process;
+    cfg.destroy = _pcm_sink_destroy;
+    cfg.buffer_len = config->buffer_len;
+    cfg.data = sink;
+    cfg.tag = "pcm_sink";
+    audio_element_handle_t el = audio_element_init(&cfg);
+    AUDIO_MEM_CHECK(TAG, el, {
+        if (sink->fp) {
+            fclose(sink->fp);
+        }
+        audio_free(sink);
+        return NULL;
+    });
+    return el;
+}
+
+int64_t pcm_sink_get_bytes(audio_element_handle_t el) {
+    return ((pcm_sink_t *)audio_element_getdata(el))->bytes;
+}
@@ -0,0 +1,107 @@
+/* Host stand-in for the ADF ring buffer, single-threaded and non-blocking */
+
+#include <string.h>
+#include <stdbool.h>
+#include "audio_mem.h"
+#include "ringbuf.h"
+
+struct ringbuf {
+    char *buf;
+    int size;
+    int rd;
+    int fill;
+    bool done;
+    bool aborted;
+};
+
+ringbuf_handle_t rb_create(int block_size, int n_blocks) {
+    ringbuf_handle_t rb = audio_calloc(1, sizeof(struct ringbuf));
+    if (!rb) {
+        return NULL;
+    }
+    rb->size = block_size * n_blocks;
+    rb->buf = audio_malloc(rb->size);
+    if (!rb->buf) {
+        audio_free(rb);
+        return NULL;
+    }
+    return rb;
+}
+
+int rb_destroy(ringbuf_handle_t rb) {
+    if (!rb) {
+        return RB_FAIL;
+    }
+    audio_free(rb->buf);
+    audio_free(rb);
+    return RB_OK;
+}
+
+int rb_reset(ringbuf_handle_t rb) {
+    rb->rd = 0;
+    rb->fill = 0;
+    rb->done = false;
+    rb->aborted = false;
+    return RB_OK;
+}
+
+int rb_bytes_available(ringbuf_handle_t rb) {
+    return rb->size - rb->fill;
+}
+
+int rb_bytes_filled(ringbuf_handle_t rb) {
+    return rb->fill;
+}
+
+int rb_get_size(ringbuf_handle_t rb) {
+    return rb->size;
+}
+
+int rb_read(ringbuf_handle_t rb, char *buf, int len, TickType_t ticks_to_wait) {
+    if (rb->aborted) {
+        return RB_ABORT;
+    }
+    if (rb->fill == 0) {
+        return rb->done ? RB_DONE : RB_TIMEOUT;
+    }
+    int n = len < rb->fill ? len : rb->fill;
+    int first = rb->size - rb->rd;
+    if (first > n) {
+        first = n;
+    }
+    memcpy(buf, rb->buf + rb->rd, first);
+    memcpy(buf + first, rb->buf, n - first);
+    rb->rd = (rb->rd + n) % rb->size;
+    rb->fill -= n;
+    return n;
+}
+
+int rb_write(ringbuf_handle_t rb, char *buf, int len, TickType_t ticks_to_wait) {
+    if (rb->aborted) {
+        return RB_ABORT;
+    }
+    int space = rb->size - rb->fill;
+    if (space == 0) {
+        return RB_TIMEOUT;
+    }
+    int n = len < space ? len : space;
+    int wr = (rb->rd + rb->fill) % rb->size;
+    int first = rb->size - wr;
+    if (first > n) {
+        first = n;
+    }
+    memcpy(rb->buf + wr, buf, first);
+    memcpy(rb->buf, buf + first, n - first);
+    rb->fill += n;
+    return n;
+}
+
+int rb_done_write(ringbuf_handle_t rb) {
+    rb->done = true;
+    return RB_OK;
+}
+
+int rb_abort(ringbuf_handle_t rb) {
+    rb->aborted = true;
+    return RB_OK;
+}
@@ -0,0 +1,167 @@
+/* Adaptive depth of the decoder output buffer, driven by measured underruns
+
+   This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#include <limits.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "audio_mem.h"
+#include "audio_error.h"
+#include "adaptive_buffer.h"
+
+static const char *TAG = "ADAPTIVE_BUFFER";
+
+struct adaptive_buffer {
+    adaptive_buffer_cfg_t cfg;
+    portMUX_TYPE lock;
+
+    // decoder task
+    int64_t window_start;           // 0 before the first sample
+    int window_min;
+    bool primed;                    // the fill reached half the target since the last change
+    int64_t quiet_since;
+    uint32_t last_underruns;
+
+    // guarded by lock
+    int target;
+    adaptive_buffer_stats_t stats;
+};
+
+static void set_target(adaptive_buffer_handle_t ab, int target, const char *why) {
+    if (target < ab->cfg.min_bytes) {
+        target = ab->cfg.min_bytes;
+    }
+    if (target > ab->cfg.max_bytes) {
+        target = ab->cfg.max_bytes;
+    }
+    if (target == ab->target) {
+        return;
+    }
+    ESP_LOGI(TAG, "target %d -> %d bytes, %s", ab->target, target, why);
+    portENTER_CRITICAL(&ab->lock);
+    if (target > ab->target) {
+        ab->stats.grows++;
+    } else {
+        ab->stats.shrinks++;
+    }
+    ab->target = target;
+    ab->stats.target = target;
+    if (target > ab->stats.target_peak) {
+        ab->stats.target_peak = target;
+    }
+    portEXIT_CRITICAL(&ab->lock);
+    // a grown target is below the fill, a shrunk one drains first: judge it once it is reached
+    ab->primed = false;
+}
+
+static void evaluate(adaptive_buffer_handle_t ab, int64_t now) {
+    uint32_t underruns = ab->cfg.underruns ? ab->cfg.underruns(ab->cfg.underruns_ctx) : 0;
+    bool underrun = underruns != ab->last_underruns;
+    bool near = ab->window_min < INT_MAX && ab->window_min < (int64_t)ab->target * ab->cfg.low_pct / 100;
+    ab->last_underruns = underruns;
+    if (underrun) {
+        portENTER_CRITICAL(&ab->lock);
+        ab->stats.underruns++;
+        portEXIT_CRITICAL(&ab->lock);
+        set_target(ab, ab->target + 2 * ab->cfg.step_bytes, "underrun");
+        ab->quiet_since = now;
+    } else if (near) {
+        portENTER_CRITICAL(&ab->lock);
+        ab->stats.near_underruns++;
+        portEXIT_CRITICAL(&ab->lock);
+        set_target(ab, ab->target + ab->cfg.step_bytes, "near underrun");
+        ab->quiet_since = now;
+    } else if (now - ab->quiet_since >= ab->cfg.quiet_ms * 1000LL) {
+        set_target(ab, ab->target - ab->cfg.step_bytes, "quiet");
+        ab->quiet_since = now;
+    }
+    ab->window_start = now;
+    ab->window_min = INT_MAX;
+}
+
+int adaptive_buffer_sample(adaptive_buffer_handle_t ab, int fill) {
+    int64_t now = esp_timer_get_time();
+    if (!ab->window_start) {
+        ab->window_start = now;
+        ab->quiet_since = now;
+        ab->last_underruns = ab->cfg.underruns ? ab->cfg.underruns(ab->cfg.underruns_ctx) : 0;
+    }
+    if (!ab->primed) {
+        // the buffer is filling up, after start or a change of target: low is expected
+        ab->primed = fill >= ab->target / 2;
+    } else if (fill < ab->window_min) {
+        ab->window_min = fill;
+    }
+    if (now - ab->window_start >= ab->cfg.window_ms * 1000LL) {
+        evaluate(ab, now);
+    }
+    return ab->target;
+}
+
+void adaptive_buffer_wait_room(adaptive_buffer_handle_t ab, ringbuf_handle_t rb, int len) {
+    int target = adaptive_buffer_sample(ab, rb_bytes_filled(rb));
+    int64_t t0 = esp_timer_get_time();
+    int64_t now = t0;
+    int fill;
+    while ((fill = rb_bytes_filled(rb)) > 0 && fill + len > target && now - t0 < ab->cfg.gate_max_ms * 1000LL) {
+        vTaskDelay(1);
+        now = esp_timer_get_time();
+    }
+    if (now != t0) {
+        portENTER_CRITICAL(&ab->lock);
+        ab->stats.gate_wait_us += now - t0;
+        portEXIT_CRITICAL(&ab->lock);
+    }
+}
+
+void adaptive_buffer_reset(adaptive_buffer_handle_t ab) {
+    // nor is the low fill seen while it emptied
+    ab->primed = false;
+    ab->window_min = INT_MAX;
+}
+
+int adaptive_buffer_get_target(adaptive_buffer_handle_t ab) {
+    portENTER_CRITICAL(&ab->lock);
+    int target = ab->target;
+    portEXIT_CRITICAL(&ab->lock);
+    return target;
+}
+
+adaptive_buffer_handle_t adaptive_buffer_create(const adaptive_buffer_cfg_t *cfg) {
+    AUDIO_NULL_CHECK(TAG, cfg, return NULL);
+    if (cfg->min_bytes <= 0 || cfg->max_bytes < cfg->min_bytes || cfg->step_bytes <= 0 || cfg->window_ms <= 0) {
+        ESP_LOGE(TAG, "invalid config, %d..%d bytes in steps of %d, %d ms windows", cfg->min_bytes, cfg->max_bytes,
+                 cfg->step_bytes, cfg->window_ms);
+        return NULL;
+    }
+    adaptive_buffer_handle_t ab = audio_calloc(1, sizeof(struct adaptive_buffer));
+    AUDIO_MEM_CHECK(TAG, ab, return NULL);
+    ab->cfg = *cfg;
+    portMUX_TYPE unlocked = portMUX_INITIALIZER_UNLOCKED;
+    ab->lock = unlocked;
+    ab->window_min = INT_MAX;
+    ab->target = cfg->min_bytes;
+    ab->stats.target = cfg->min_bytes;
+    ab->stats.target_peak = cfg->min_bytes;
+    return ab;
+}
+
+void adaptive_buffer_destroy(adaptive_buffer_handle_t ab) {
+    audio_free(ab);
+}
+
+esp_err_t adaptive_buffer_get_stats(adaptive_buffer_handle_t ab, adaptive_buffer_stats_t *stats) {
+    AUDIO_NULL_CHECK(TAG, ab, return ESP_ERR_INVALID_ARG);
+    AUDIO_NULL_CHECK(TAG, stats, return ESP_ERR_INVALID_ARG);
+    portENTER_CRITICAL(&ab->lock);
+    *stats = ab->stats;
+    portEXIT_CRITICAL(&ab->lock);
+    return ESP_OK;
+}
@@ -0,0 +1,130 @@
+/* Adaptive depth of the decoder output buffer, driven by measured underruns
+
+   This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#ifndef _ADAPTIVE_BUFFER_H_
+#define _ADAPTIVE_BUFFER_H_
+
+#include <stdint.h>
+#include "esp_err.h"
+#include "ringbuf.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Underruns of the output so far, e.g. from telemetry_get_stats()
+ */
+typedef uint32_t (*adaptive_buffer_underruns_t)(void *ctx);
+
+/**
+ * @brief Adaptive buffer configuration
+ *
+ * The ring buffer is created at max_bytes; what adapts is how much of it the
+ * decoder may fill, the target. Every window_ms the lowest fill the decoder
+ * found when it came back to write is checked: an underrun in the window grows
+ * the target by two steps, a fill below low_pct of the target (a near
+ * underrun) by one. After quiet_ms without either the target shrinks by one
+ * step, and again after every further quiet_ms, down to min_bytes.
+ */
+typedef struct {
+    int                         min_bytes;
+    int                         max_bytes;      /*!< At most the size of the ring buffer */
+    int                         step_bytes;
+    int                         window_ms;
+    int                         low_pct;        /*!< Lowest fill in a window, in percent of the target, that counts as a near underrun */
+    int                         quiet_ms;
+    int                         gate_max_ms;    /*!< Longest adaptive_buffer_wait_room() waits before writing anyway */
+    adaptive_buffer_underruns_t underruns;      /*!< NULL to go by near underruns only */
+    void                        *underruns_ctx;
+} adaptive_buffer_cfg_t;
+
+#define ADAPTIVE_BUFFER_CFG_DEFAULT() {     \
+    .min_bytes = 8 * 1024,                  \
+    .max_bytes = 96 * 1024,                 \
+    .step_bytes = 8 * 1024,                 \
+    .window_ms = 500,                       \
+    .low_pct = 25,                          \
+    .quiet_ms = 20000,                      \
+    .gate_max_ms = 100,                     \
+    .underruns = NULL,                      \
+    .underruns_ctx = NULL,                  \
+}
+
+/**
+ * @brief Totals since create
+ */
+typedef struct {
+    int      target;            /*!< Current target fill in bytes */
+    int      target_peak;
+    uint32_t grows;
+    uint32_t shrinks;
+    uint32_t underruns;         /*!< Windows with an underrun */
+    uint32_t near_underruns;    /*!< Windows with a near underrun and no underrun */
+    int64_t  gate_wait_us;      /*!< Time the decoder was held back by the target */
+} adaptive_buffer_stats_t;
+
+typedef struct adaptive_buffer *adaptive_buffer_handle_t;
+
+/**
+ * @brief Create the controller, the target starts at min_bytes
+ *
+ * @return The handle, NULL on error
+ */
+adaptive_buffer_handle_t adaptive_buffer_create(const adaptive_buffer_cfg_t *cfg);
+
+/**
+ * @brief Free the controller
+ */
+void adaptive_buffer_destroy(adaptive_buffer_handle_t ab);
+
+/**
+ * @brief Report the fill the decoder found before a write, and adapt the target
+ *
+ * @param ab   The controller
+ * @param fill Bytes in the ring buffer
+ *
+ * @return The target fill in bytes
+ */
+int adaptive_buffer_sample(adaptive_buffer_handle_t ab, int fill);
+
+/**
+ * @brief Hold the decoder until len bytes fit under the target, then let it write
+ *
+ * Samples the fill as adaptive_buffer_sample(). Waits by polling the ring
+ * buffer, at most gate_max_ms: when the output is paused or stopped nothing
+ * drains, and the write then blocks on the ring buffer itself, where the
+ * element can be paused and aborted. Runs in the decoder task, see
+ * latency_trace_set_write_gate().
+ */
+void adaptive_buffer_wait_room(adaptive_buffer_handle_t ab, ringbuf_handle_t rb, int len);
+
+/**
+ * @brief The ring buffer was emptied, e.g. by a pipeline reset or a skip: the fill is not judged until it is back up
+ *
+ * The low fill sampled in the current window is forgotten as well. Runs in
+ * the decoder task, or while the decoder is stopped.
+ */
+void adaptive_buffer_reset(adaptive_buffer_handle_t ab);
+
+/**
+ * @brief The target fill in bytes
+ */
+int adaptive_buffer_get_target(adaptive_buffer_handle_t ab);
+
+/**
+ * @brief Copy the totals
+ */
+esp_err_t adaptive_buffer_get_stats(adaptive_buffer_handle_t ab, adaptive_buffer_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,330 @@
+/* Startup as a graph of init steps: each step runs once the ones it depends on are done
+
+   This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "freertos/event_groups.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "audio_mem.h"
+#include "audio_error.h"
+#include "boot_graph.h"
+
+static const char *TAG = "BOOT_GRAPH";
+
+#define BAR_WIDTH   40
+
+typedef struct {
+    boot_graph_handle_t graph;
+    int core;
+} runner_t;
+
+struct boot_graph {
+    boot_step_t steps[BOOT_GRAPH_MAX_STEPS];
+    boot_step_time_t times[BOOT_GRAPH_MAX_STEPS];
+    boot_graph_cfg_t cfg;
+    uint32_t all;
+    uint32_t started;
+    uint32_t done;
+    uint32_t failed;            // failed or skipped
+    uint32_t skipped;
+    int64_t start_us;
+    bool running;               // boot_graph_start() called, the last step done logs the timeline
+    SemaphoreHandle_t lock;
+    EventGroupHandle_t events;  // the done bits
+    runner_t runners[BOOT_GRAPH_MAX_CORES];
+};
+
+/**
+ * @brief Mark a step done and the steps it was the last dependency of ready; call it locked
+ * @return Whether it was the last step
+ */
+static bool finish(boot_graph_handle_t graph, int step, esp_err_t err, int64_t now) {
+    uint32_t bit = BOOT_GRAPH_DEP(step);
+    graph->times[step].end_us = now;
+    graph->times[step].err = err;
+    graph->done |= bit;
+    if (err != ESP_OK) {
+        graph->failed |= bit;
+    }
+    for (int i = 0; i < graph->cfg.num_steps; i++) {
+        if ((graph->steps[i].deps & bit) && !(graph->steps[i].deps & ~graph->done)) {
+            graph->times[i].ready_us = now;
+        }
+    }
+    // set under the lock: a runner that saw the bit clear waits for it
+    xEventGroupSetBits(graph->events, bit);
+    return graph->done == graph->all;
+}
+
+boot_graph_handle_t boot_graph_create(const boot_graph_cfg_t *cfg) {
+    AUDIO_NULL_CHECK(TAG, cfg && cfg->steps, return NULL);
+    if (cfg->num_steps <= 0 || cfg->num_steps > BOOT_GRAPH_MAX_STEPS) {
+        ESP_LOGE(TAG, "%d steps, at most %d", cfg->num_steps, BOOT_GRAPH_MAX_STEPS);
+        return NULL;
+    }
+    if (cfg->cores <= 0 || cfg->cores > BOOT_GRAPH_MAX_CORES) {
+        ESP_LOGE(TAG, "%d cores, at most %d", cfg->cores, BOOT_GRAPH_MAX_CORES);
+        return NULL;
+    }
+    for (int i = 0; i < cfg->num_steps; i++) {
+        const boot_step_t *s = &cfg->steps[i];
+        // dependencies on earlier steps only, the table is in an order that runs and there is no cycle
+        if (!s->fn || (s->deps & ~(BOOT_GRAPH_DEP(i) - 1))
+            || (s->core != BOOT_GRAPH_ANY_CORE && (s->core < 0 || s->core >= cfg->cores))) {
+            ESP_LOGE(TAG, "step %d (%s): no function, a dependency not before it, or no core %d", i,
+                     s->name ? s->name : "", s->core);
+            return NULL;
+        }
+    }
+    boot_graph_handle_t graph = audio_calloc(1, sizeof(struct boot_graph));
+    AUDIO_MEM_CHECK(TAG, graph, return NULL);
+    memcpy(graph->steps, cfg->steps, cfg->num_steps * sizeof(boot_step_t));
+    graph->cfg = *cfg;
+    graph->cfg.steps = graph->steps;
+    graph->all = BOOT_GRAPH_DEP(cfg->num_steps) - 1;
+    graph->start_us = esp_timer_get_time();
+    for (int i = 0; i < cfg->num_steps; i++) {
+        graph->times[i] = (boot_step_time_t) {
+            .ready_us = graph->steps[i].deps ? -1 : graph->start_us,
+            .start_us = -1,
+            .end_us = -1,
+            .core = -1,
+            .err = ESP_OK,
+        };
+    }
+    graph->lock = xSemaphoreCreateMutex();
+    graph->events = xEventGroupCreate();
+    AUDIO_MEM_CHECK(TAG, graph->lock && graph->events, goto _fail);
+    return graph;
+
+_fail:
+    boot_graph_destroy(graph);
+    return NULL;
+}
+
+void boot_graph_destroy(boot_graph_handle_t graph) {
+    if (!graph) {
+        return;
+    }
+    if (graph->lock) {
+        vSemaphoreDelete(graph->lock);
+    }
+    if (graph->events) {
+        vEventGroupDelete(graph->events);
+    }
+    audio_free(graph);
+}
+
+int boot_graph_take(boot_graph_handle_t graph, int core) {
+    AUDIO_NULL_CHECK(TAG, graph, return -1);
+    int taken = -1;
+    bool last = false;
+    xSemaphoreTake(graph->lock, portMAX_DELAY);
+    int64_t now = esp_timer_get_time();
+    for (int i = 0; i < graph->cfg.num_steps && taken < 0; i++) {
+        const boot_step_t *s = &graph->steps[i];
+        if ((graph->started & BOOT_GRAPH_DEP(i)) || (s->deps & ~graph->done)) {
+            continue;
+        }
+        graph->started |= BOOT_GRAPH_DEP(i);
+        if (s->deps & graph->failed) {
+            // its dependents come later in the table and are skipped on in this pass
+            ESP_LOGW(TAG, "%s skipped, a step it depends on failed", s->name);
+            graph->skipped |= BOOT_GRAPH_DEP(i);
+            graph->times[i].start_us = now;
+            last = finish(graph, i, ESP_ERR_INVALID_STATE, now);
+            continue;
+        }
+        if (core != BOOT_GRAPH_ANY_CORE && s->core != BOOT_GRAPH_ANY_CORE && s->core != core) {
+            graph->started &= ~BOOT_GRAPH_DEP(i);
+            continue;
+        }
+        graph->times[i].start_us = now;
+        graph->times[i].core = core;
+        taken = i;
+    }
+    xSemaphoreGive(graph->lock);
+    if (last && graph->running) {
+        boot_graph_report(graph);
+    }
+    return taken;
+}
+
+void boot_graph_done(boot_graph_handle_t graph, int step, esp_err_t err) {
+    AUDIO_NULL_CHECK(TAG, graph && step >= 0 && step < graph->cfg.num_steps, return);
+    xSemaphoreTake(graph->lock, portMAX_DELAY);
+    bool last = finish(graph, step, err, esp_timer_get_time());
+    xSemaphoreGive(graph->lock);
+    if (last && graph->running) {
+        boot_graph_report(graph);
+    }
+}
+
+bool boot_graph_finished(boot_graph_handle_t graph) {
+    AUDIO_NULL_CHECK(TAG, graph, return false);
+    xSemaphoreTake(graph->lock, portMAX_DELAY);
+    bool finished = graph->done == graph->all;
+    xSemaphoreGive(graph->lock);
+    return finished;
+}
+
+/**
+ * @brief Take steps for the core until none is left that it may take
+ */
+static void run_steps(boot_graph_handle_t graph, int core) {
+    for (;;) {
+        int step = boot_graph_take(graph, core);
+        if (step >= 0) {
+            const boot_step_t *s = &graph->steps[step];
+            esp_err_t err = s->fn(graph->cfg.ctx);
+            if (err != ESP_OK) {
+                ESP_LOGE(TAG, "%s failed: %s", s->name, esp_err_to_name(err));
+            }
+            boot_graph_done(graph, step, err);
+            continue;
+        }
+        uint32_t left = 0;
+        bool ready = false;
+        xSemaphoreTake(graph->lock, portMAX_DELAY);
+        for (int i = 0; i < graph->cfg.num_steps; i++) {
+            int want = graph->steps[i].core;
+            if (!(graph->started & BOOT_GRAPH_DEP(i))
+                && (core == BOOT_GRAPH_ANY_CORE || want == BOOT_GRAPH_ANY_CORE || want == core)) {
+                left |= BOOT_GRAPH_DEP(i);
+                // done since the take
+                ready |= !(graph->steps[i].deps & ~graph->done);
+            }
+        }
+        uint32_t pending = graph->all & ~graph->done;
+        xSemaphoreGive(graph->lock);
+        if (!left) {
+            return;
+        }
+        if (ready) {
+            continue;
+        }
+        // a step ends, something may be ready
+        xEventGroupWaitBits(graph->events, pending, pdFALSE, pdFALSE, portMAX_DELAY);
+    }
+}
+
+static void runner_task(void *arg) {
+    runner_t *runner = (runner_t *)arg;
+    run_steps(runner->graph, runner->core);
+    vTaskDelete(NULL);
+}
+
+esp_err_t boot_graph_start(boot_graph_handle_t graph) {
+    AUDIO_NULL_CHECK(TAG, graph, return ESP_ERR_INVALID_ARG);
+    if (graph->running) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    graph->running = true;
+    graph->start_us = esp_timer_get_time();
+    for (int i = 0; i < graph->cfg.num_steps; i++) {
+        if (!graph->steps[i].deps) {
+            graph->times[i].ready_us = graph->start_us;
+        }
+    }
+    if (graph->cfg.task_stack <= 0) {
+        run_steps(graph, BOOT_GRAPH_ANY_CORE);
+        return ESP_OK;
+    }
+    for (int core = 0; core < graph->cfg.cores; core++) {
+        char name[16];
+        snprintf(name, sizeof(name), "boot%d", core);
+        graph->runners[core] = (runner_t) {graph, core};
+        if (xTaskCreatePinnedToCore(runner_task, name, graph->cfg.task_stack, &graph->runners[core],
+                                    graph->cfg.task_prio, NULL, core) != pdPASS) {
+            // the runners already started take what they may, steps pinned here never run
+            ESP_LOGE(TAG, "failed to create the runner on core %d", core);
+            return ESP_FAIL;
+        }
+    }
+    return ESP_OK;
+}
+
+esp_err_t boot_graph_wait(boot_graph_handle_t graph, uint32_t steps, TickType_t ticks) {
+    AUDIO_NULL_CHECK(TAG, graph, return ESP_ERR_INVALID_ARG);
+    steps &= graph->all;
+    EventBits_t bits = xEventGroupWaitBits(graph->events, steps, pdFALSE, pdTRUE, ticks);
+    if ((bits & steps) != steps) {
+        return ESP_ERR_TIMEOUT;
+    }
+    esp_err_t err = ESP_OK;
+    xSemaphoreTake(graph->lock, portMAX_DELAY);
+    for (int i = 0; i < graph->cfg.num_steps && err == ESP_OK; i++) {
+        if (steps & graph->failed & BOOT_GRAPH_DEP(i)) {
+            err = graph->times[i].err;
+        }
+    }
+    xSemaphoreGive(graph->lock);
+    return err;
+}
+
+void boot_graph_get_time(boot_graph_handle_t graph, int step, boot_step_time_t *time) {
+    if (graph && time && step >= 0 && step < graph->cfg.num_steps) {
+        xSemaphoreTake(graph->lock, portMAX_DELAY);
+        *time = graph->times[step];
+        xSemaphoreGive(graph->lock);
+    }
+}
+
+static int ms_of(boot_graph_handle_t graph, int64_t us) {
+    return us < 0 ? -1 : (int)((us - graph->start_us) / 1000);
+}
+
+void boot_graph_report(boot_graph_handle_t graph) {
+    AUDIO_NULL_CHECK(TAG, graph, return);
+    boot_step_time_t times[BOOT_GRAPH_MAX_STEPS];
+    xSemaphoreTake(graph->lock, portMAX_DELAY);
+    memcpy(times, graph->times, sizeof(times));
+    uint32_t skipped = graph->skipped;
+    xSemaphoreGive(graph->lock);
+
+    int64_t end_us = graph->start_us;
+    int64_t busy_us = 0;
+    for (int i = 0; i < graph->cfg.num_steps; i++) {
+        if (times[i].end_us > end_us) {
+            end_us = times[i].end_us;
+        }
+        if (times[i].start_us >= 0 && times[i].end_us >= 0) {
+            busy_us += times[i].end_us - times[i].start_us;
+        }
+    }
+    int64_t span_us = end_us - graph->start_us;
+    int64_t col_us = span_us / BAR_WIDTH + 1;
+    ESP_LOGI(TAG, "boot timeline, ms from the start, a column is %d ms: '.' ready, '#' running",
+             (int)(col_us / 1000));
+    for (int i = 0; i < graph->cfg.num_steps; i++) {
+        const boot_step_time_t *t = &times[i];
+        char bar[BAR_WIDTH + 1];
+        for (int c = 0; c < BAR_WIDTH; c++) {
+            int64_t at = graph->start_us + c * col_us;
+            bool running = t->start_us >= 0 && at + col_us > t->start_us && (t->end_us < 0 || at < t->end_us);
+            bool ready = t->ready_us >= 0 && at + col_us > t->ready_us && (t->start_us < 0 || at < t->start_us);
+            bar[c] = running ? '#' : ready ? '.' : ' ';
+        }
+        bar[BAR_WIDTH] = '\0';
+        if (skipped & BOOT_GRAPH_DEP(i)) {
+            ESP_LOGI(TAG, "  %-12s skipped", graph->steps[i].name);
+            continue;
+        }
+        ESP_LOGI(TAG, "  %-12s core %2d ready %5d start %5d end %5d %5d ms |%s|%s", graph->steps[i].name, t->core,
+                 ms_of(graph, t->ready_us), ms_of(graph, t->start_us), ms_of(graph, t->end_us),
+                 t->end_us >= 0 ? (int)((t->end_us - t->start_us) / 1000) : -1, bar,
+                 t->err == ESP_OK ? "" : " failed");
+    }
+    ESP_LOGI(TAG, "%d steps in %d ms, %d ms of work on %d cores", graph->cfg.num_steps, (int)(span_us / 1000),
+             (int)(busy_us / 1000), graph->cfg.cores);
+}
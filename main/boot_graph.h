@@ -0,0 +1,121 @@
+/* Startup as a graph of init steps: each step runs once the ones it depends on are done
+
+   This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#ifndef _BOOT_GRAPH_H_
+#define _BOOT_GRAPH_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define BOOT_GRAPH_MAX_STEPS    (24)        /*!< The bits of an event group */
+#define BOOT_GRAPH_MAX_CORES    (2)
+#define BOOT_GRAPH_ANY_CORE     (-1)
+#define BOOT_GRAPH_DEP(step)    (1UL << (step))
+
+/**
+ * @brief One init step; returns ESP_OK, or an error and the steps that depend on it are skipped
+ */
+typedef esp_err_t (*boot_step_fn_t)(void *ctx);
+
+typedef struct {
+    const char      *name;
+    boot_step_fn_t  fn;
+    uint32_t        deps;       /*!< BOOT_GRAPH_DEP() of the steps that must be done first, all before this one
+                                     in the table */
+    int             core;       /*!< Core whose runner takes it, BOOT_GRAPH_ANY_CORE for whichever is free */
+} boot_step_t;
+
+typedef struct {
+    const boot_step_t   *steps;
+    int                 num_steps;
+    void                *ctx;           /*!< Passed to the steps */
+    int                 cores;          /*!< Runner tasks, one pinned to each core from 0 */
+    int                 task_stack;     /*!< Runner task stack, deep enough for every step; 0 for no tasks:
+                                             boot_graph_start() runs the steps from the caller in table order */
+    int                 task_prio;
+} boot_graph_cfg_t;
+
+#define BOOT_GRAPH_CFG_DEFAULT() {      \
+    .cores = BOOT_GRAPH_MAX_CORES,      \
+    .task_stack = 6 * 1024,             \
+    .task_prio = 5,                     \
+}
+
+/**
+ * @brief When a step ran, us of esp_timer_get_time(); -1 until it happens
+ */
+typedef struct {
+    int64_t     ready_us;       /*!< The last of its dependencies done */
+    int64_t     start_us;
+    int64_t     end_us;
+    int         core;           /*!< Core of the runner that ran it */
+    esp_err_t   err;            /*!< ESP_ERR_INVALID_STATE if skipped for a failed dependency */
+} boot_step_time_t;
+
+typedef struct boot_graph *boot_graph_handle_t;
+
+/**
+ * @brief Create a graph, the steps are copied
+ */
+boot_graph_handle_t boot_graph_create(const boot_graph_cfg_t *cfg);
+
+/**
+ * @brief Free a graph; every step must be done, see boot_graph_wait()
+ */
+void boot_graph_destroy(boot_graph_handle_t graph);
+
+/**
+ * @brief Start the runners; they take the steps whose dependencies are done, as they come free
+ *
+ * The graph's times start here. The runner that ends the last step logs
+ * the timeline with boot_graph_report() and every runner exits.
+ */
+esp_err_t boot_graph_start(boot_graph_handle_t graph);
+
+/**
+ * @brief Wait until the steps are done
+ *
+ * @param steps BOOT_GRAPH_DEP() of the steps
+ * @return ESP_OK if all of them succeeded, ESP_ERR_TIMEOUT, or the error of one that failed
+ */
+esp_err_t boot_graph_wait(boot_graph_handle_t graph, uint32_t steps, TickType_t ticks);
+
+/**
+ * @brief What the runners do: take a ready step for a core, and mark it done
+ *
+ * boot_graph_take() marks the step started and returns its index, or -1
+ * if none is ready for the core now. Exposed for a simulated scheduler;
+ * with the runners started, only they may call these.
+ */
+int boot_graph_take(boot_graph_handle_t graph, int core);
+void boot_graph_done(boot_graph_handle_t graph, int step, esp_err_t err);
+
+/**
+ * @brief Whether every step is done
+ */
+bool boot_graph_finished(boot_graph_handle_t graph);
+
+void boot_graph_get_time(boot_graph_handle_t graph, int step, boot_step_time_t *time);
+
+/**
+ * @brief Log the timeline: per step its core, ready, start and end ms from boot_graph_start(), and a bar
+ */
+void boot_graph_report(boot_graph_handle_t graph);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -2,4 +2,19 @@
 # Main Makefile. This is basically the same as a component makefile.
 #
 
-COMPONENT_EMBED_TXTFILES := music-16b-2c-8000hz.mp3 music-16b-2c-22050hz.mp3 music-16b-2c-44100hz.mp3
+MUSIC_FILES := music-16b-2c-8000hz.mp3 music-16b-2c-22050hz.mp3 music-16b-2c-44100hz.mp3
+COMPONENT_EMBED_TXTFILES := $(MUSIC_FILES)
+
+# Frame index of every embedded asset (mp3_index_t), for seeking without scanning
+COMPONENT_OBJS := $(patsubst %.c,%.o,$(notdir $(wildcard $(COMPONENT_PATH)/*.c))) music_index.o
+COMPONENT_EXTRA_CLEAN := music_index.c
+
+# mem_placement.c places what ADF allocates for the pipeline elements
+COMPONENT_ADD_LDFLAGS := -l$(COMPONENT_NAME) -Wl,--wrap=audio_malloc,--wrap=audio_calloc,--wrap=audio_free
+
+music_index.c: $(PROJECT_PATH)/tools/gen_mp3_index.py $(addprefix $(COMPONENT_PATH)/,$(MUSIC_FILES))
+	$(PYTHON) $< -o $@ $(filter %.mp3,$^)
+
+music_index.o: music_index.c
+	$(summary) CC $(patsubst $(PWD)/%,%,$(CURDIR))/$@
+	$(CC) $(CFLAGS) $(CPPFLAGS) $(addprefix -I,$(COMPONENT_INCLUDES)) -I$(COMPONENT_PATH) -c $< -o $@
@@ -0,0 +1,89 @@
+/* Source for MP3 assets embedded in the application image
+
+   This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#include <string.h>
+#include "esp_log.h"
+#include "audio_mem.h"
+#include "audio_error.h"
+#include "embed_stream.h"
+
+static const char *TAG = "EMBED_STREAM";
+
+struct embed_stream {
+    const uint8_t *start;
+    const uint8_t *end;
+    int pos;
+};
+
+embed_stream_handle_t embed_stream_create(void) {
+    embed_stream_handle_t stream = audio_calloc(1, sizeof(struct embed_stream));
+    AUDIO_MEM_CHECK(TAG, stream, return NULL);
+    return stream;
+}
+
+void embed_stream_destroy(embed_stream_handle_t stream) {
+    audio_free(stream);
+}
+
+esp_err_t embed_stream_set_asset(embed_stream_handle_t stream, const embed_asset_t *asset) {
+    AUDIO_NULL_CHECK(TAG, stream, return ESP_ERR_INVALID_ARG);
+    AUDIO_NULL_CHECK(TAG, asset, return ESP_ERR_INVALID_ARG);
+    stream->start = asset->start;
+    stream->end = asset->end;
+    stream->pos = 0;
+    return ESP_OK;
+}
+
+int embed_stream_peek(embed_stream_handle_t stream, const uint8_t **data, int max_len) {
+    int remain = stream->end - stream->start - stream->pos;
+    if (max_len > 0 && max_len < remain) {
+        remain = max_len;
+    }
+    *data = stream->start + stream->pos;
+    return remain;
+}
+
+void embed_stream_advance(embed_stream_handle_t stream, int len) {
+    int remain = stream->end - stream->start - stream->pos;
+    stream->pos += len < remain ? len : remain;
+}
+
+esp_err_t embed_stream_seek(embed_stream_handle_t stream, int pos) {
+    AUDIO_NULL_CHECK(TAG, stream, return ESP_ERR_INVALID_ARG);
+    if (pos < 0 || pos > stream->end - stream->start) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    stream->pos = pos;
+    return ESP_OK;
+}
+
+int embed_stream_tell(embed_stream_handle_t stream) {
+    return stream->pos;
+}
+
+int embed_stream_size(embed_stream_handle_t stream) {
+    return stream->end - stream->start;
+}
+
+int embed_stream_read_cb(audio_element_handle_t el, char *buf, int len, TickType_t wait_time, void *ctx) {
+    embed_stream_handle_t stream = (embed_stream_handle_t)ctx;
+    const uint8_t *data;
+    int read_size = embed_stream_peek(stream, &data, len);
+    if (read_size == 0) {
+        return AEL_IO_DONE;
+    }
+    memcpy(buf, data, read_size);
+    stream->pos += read_size;
+    return read_size;
+}
+
+esp_err_t embed_stream_attach(embed_stream_handle_t stream, audio_element_handle_t el) {
+    AUDIO_NULL_CHECK(TAG, stream, return ESP_FAIL);
+    return audio_element_set_read_cb(el, embed_stream_read_cb, stream);
+}
@@ -0,0 +1,136 @@
+/* Source for MP3 assets embedded in the application image
+
+   This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#ifndef _EMBED_STREAM_H_
+#define _EMBED_STREAM_H_
+
+#include <stdint.h>
+#include "esp_err.h"
+#include "audio_element.h"
+#include "mp3_index.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief An asset linked into the image (e.g. by COMPONENT_EMBED_TXTFILES)
+ */
+typedef struct {
+    const char          *name;  /*!< File name of the asset */
+    const uint8_t       *start; /*!< First byte, in memory-mapped flash */
+    const uint8_t       *end;   /*!< One past the last byte */
+    const mp3_index_t   *index; /*!< Frame index generated at build time, NULL if there is none */
+} embed_asset_t;
+
+typedef struct embed_stream *embed_stream_handle_t;
+
+/**
+ * @brief Create an embedded asset source
+ *
+ * Each source keeps its own read position, so several sources can be used at
+ * the same time (e.g. one per decoder).
+ *
+ * @return The source handle, NULL on memory error
+ */
+embed_stream_handle_t embed_stream_create(void);
+
+/**
+ * @brief Destroy the source
+ *
+ * @param stream The source handle
+ */
+void embed_stream_destroy(embed_stream_handle_t stream);
+
+/**
+ * @brief Select the asset to read and rewind to its start
+ *
+ * @param stream The source handle
+ * @param asset  The asset, must stay valid while the source uses it
+ *
+ * @return
+ *     - ESP_OK
+ *     - ESP_ERR_INVALID_ARG
+ */
+esp_err_t embed_stream_set_asset(embed_stream_handle_t stream, const embed_asset_t *asset);
+
+/**
+ * @brief Get the unread part of the asset as a read-only slice, without copying
+ *
+ * The slice points straight into the mapped asset. It stays valid as long as
+ * the asset does; the position only moves with embed_stream_advance().
+ *
+ * @param stream   The source handle
+ * @param[out] data Start of the slice
+ * @param max_len  Upper bound for the slice length, <= 0 for no bound
+ *
+ * @return Length of the slice, 0 at the end of the asset
+ */
+int embed_stream_peek(embed_stream_handle_t stream, const uint8_t **data, int max_len);
+
+/**
+ * @brief Consume bytes returned by embed_stream_peek()
+ *
+ * @param stream The source handle
+ * @param len    Number of bytes consumed, clamped to the remaining size
+ */
+void embed_stream_advance(embed_stream_handle_t stream, int len);
+
+/**
+ * @brief Move the read position
+ *
+ * @param stream The source handle
+ * @param pos    New position in bytes from the start of the asset
+ *
+ * @return
+ *     - ESP_OK
+ *     - ESP_ERR_INVALID_ARG pos is outside the asset
+ */
+esp_err_t embed_stream_seek(embed_stream_handle_t stream, int pos);
+
+/**
+ * @brief Current read position in bytes from the start of the asset
+ */
+int embed_stream_tell(embed_stream_handle_t stream);
+
+/**
+ * @brief Total size of the current asset in bytes
+ */
+int embed_stream_size(embed_stream_handle_t stream);
+
+/**
+ * @brief Element read callback serving the current asset
+ *
+ * Audio element inputs are copied into the element's own buffer, so this is
+ * the single copy out of flash; use embed_stream_peek() where a consumer can
+ * work on the mapped data directly.
+ *
+ * @param ctx The source handle
+ *
+ * @return Bytes read, or AEL_IO_DONE at the end of the asset
+ */
+int embed_stream_read_cb(audio_element_handle_t el, char *buf, int len, TickType_t wait_time, void *ctx);
+
+/**
+ * @brief Feed an element (usually the mp3 decoder) from this source
+ *
+ * @param stream The source handle
+ * @param el     The element to read into
+ *
+ * @return
+ *     - ESP_OK
+ *     - ESP_FAIL
+ */
+esp_err_t embed_stream_attach(embed_stream_handle_t stream, audio_element_handle_t el);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
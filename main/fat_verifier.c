@@ -0,0 +1,321 @@
+/* Read-mostly integrity check of a FAT volume: a sector CRC table swept a budgeted slice at a time
+
+   This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_rom_crc.h"
+#include "audio_mem.h"
+#include "audio_error.h"
+#include "fat_verifier.h"
+
+static const char *TAG = "FAT_VERIFIER";
+
+#define SECTOR_KNOWN        0x01    // crc holds what the sector must read
+#define SECTOR_READBACK     0x02    // written, not read back yet
+#define SECTOR_WRITING      0x04
+
+typedef struct {
+    bool        valid;
+    uint32_t    fat_start;
+    uint32_t    fat_sectors;        // of one copy
+    uint32_t    num_fats;
+    uint32_t    clusters;
+    int         fat_bits;
+    uint8_t     media;
+} fat_layout_t;
+
+struct fat_verifier {
+    fat_verifier_cfg_t cfg;
+    uint32_t *crc;
+    uint8_t *flags;
+    uint8_t *gen;                   // bumped by every write, a read that saw it change is dropped
+    uint8_t *buf;
+    uint32_t cursor;                // next sector of the sweep
+    uint32_t readbacks_pending;
+    int64_t tokens;                 // bytes the budget allows to read now
+    int64_t last_us;
+    fat_layout_t layout;
+    esp_err_t fault;
+    fat_verifier_stats_t stats;
+    SemaphoreHandle_t lock;
+};
+
+static uint32_t le16(const uint8_t *p) {
+    return p[0] | (p[1] << 8);
+}
+
+static uint32_t le32(const uint8_t *p) {
+    return le16(p) | (le16(p + 2) << 16);
+}
+
+/**
+ * @brief The boot sector's fields, as FatFs checks them at mount
+ */
+static bool parse_boot_sector(fat_verifier_handle_t ver, const uint8_t *b, fat_layout_t *l) {
+    uint32_t bytes_per_sector = le16(b + 11);
+    uint32_t per_cluster = b[13];
+    uint32_t reserved = le16(b + 14);
+    uint32_t root_entries = le16(b + 17);
+    uint32_t total = le16(b + 19) ? le16(b + 19) : le32(b + 32);
+    uint32_t fat_size = le16(b + 22) ? le16(b + 22) : le32(b + 36);
+    *l = (fat_layout_t) {0};
+    if (b[510] != 0x55 || b[511] != 0xAA || bytes_per_sector != ver->cfg.sector_size || !per_cluster
+        || (per_cluster & (per_cluster - 1)) || !reserved || b[16] < 1 || b[16] > 2 || !fat_size
+        || total > ver->cfg.num_sectors) {
+        return false;
+    }
+    uint32_t root_sectors = (root_entries * 32 + bytes_per_sector - 1) / bytes_per_sector;
+    uint32_t data_start = reserved + b[16] * fat_size + root_sectors;
+    if (data_start >= total) {
+        return false;
+    }
+    l->valid = true;
+    l->fat_start = reserved;
+    l->fat_sectors = fat_size;
+    l->num_fats = b[16];
+    l->clusters = (total - data_start) / per_cluster;
+    l->fat_bits = l->clusters < 4085 ? 12 : l->clusters < 65525 ? 16 : 32;
+    l->media = b[21];
+    return true;
+}
+
+/**
+ * @brief Whether every FAT entry held whole in this sector of a FAT copy is free, a cluster, bad or an end of chain
+ */
+static bool check_fat_sector(const fat_layout_t *l, uint32_t sector, const uint8_t *b, size_t sector_size) {
+    uint32_t first_byte = ((sector - l->fat_start) % l->fat_sectors) * sector_size;
+    uint32_t end_byte = first_byte + sector_size;
+    uint32_t bad = l->fat_bits == 12 ? 0xFF7 : l->fat_bits == 16 ? 0xFFF7 : 0x0FFFFFF7;
+    if (!first_byte && b[0] != l->media) {
+        return false;
+    }
+    for (uint32_t c = 2; c < l->clusters + 2; c++) {
+        uint32_t at = l->fat_bits == 12 ? c + c / 2 : c * (l->fat_bits / 8);
+        uint32_t width = l->fat_bits == 12 ? 2 : l->fat_bits / 8;
+        if (at < first_byte) {
+            continue;
+        }
+        if (at + width > end_byte) {
+            break;
+        }
+        const uint8_t *p = b + (at - first_byte);
+        uint32_t v;
+        if (l->fat_bits == 12) {
+            v = (c & 1) ? (p[0] >> 4) | (p[1] << 4) : p[0] | ((p[1] & 0x0F) << 8);
+        } else if (l->fat_bits == 16) {
+            v = le16(p);
+        } else {
+            v = le32(p) & 0x0FFFFFFF;
+        }
+        if (v == 1 || (v >= l->clusters + 2 && v < bad)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static esp_err_t set_fault(fat_verifier_handle_t ver, esp_err_t err, uint32_t sector, const char *what) {
+    if (ver->fault == ESP_OK) {
+        ver->fault = err;
+        ver->stats.fault_us = esp_timer_get_time();
+        ver->stats.fault_sector = sector;
+        ESP_LOGE(TAG, "sector %u: %s", sector, what);
+    }
+    return ver->fault;
+}
+
+fat_verifier_handle_t fat_verifier_create(const fat_verifier_cfg_t *cfg) {
+    AUDIO_NULL_CHECK(TAG, cfg && cfg->read, return NULL);
+    if (cfg->sector_size < 512 || !cfg->num_sectors || cfg->budget_bytes_per_s <= 0 || cfg->max_sectors_per_tick <= 0) {
+        ESP_LOGE(TAG, "invalid config, %d sectors of %d bytes, %d bytes/s", (int)cfg->num_sectors,
+                 (int)cfg->sector_size, cfg->budget_bytes_per_s);
+        return NULL;
+    }
+    fat_verifier_handle_t ver = audio_calloc(1, sizeof(struct fat_verifier));
+    AUDIO_MEM_CHECK(TAG, ver, return NULL);
+    ver->cfg = *cfg;
+    ver->crc = audio_calloc(cfg->num_sectors, sizeof(uint32_t));
+    ver->flags = audio_calloc(cfg->num_sectors, 1);
+    ver->gen = audio_calloc(cfg->num_sectors, 1);
+    ver->buf = audio_malloc(cfg->sector_size);
+    ver->lock = xSemaphoreCreateMutex();
+    AUDIO_MEM_CHECK(TAG, ver->crc && ver->flags && ver->gen && ver->buf && ver->lock, goto _fail);
+    // the boot sector at once, the rest as the budget comes in
+    ver->tokens = cfg->sector_size;
+    ver->last_us = esp_timer_get_time();
+    return ver;
+
+_fail:
+    fat_verifier_destroy(ver);
+    return NULL;
+}
+
+void fat_verifier_destroy(fat_verifier_handle_t ver) {
+    if (!ver) {
+        return;
+    }
+    if (ver->lock) {
+        vSemaphoreDelete(ver->lock);
+    }
+    audio_free(ver->crc);
+    audio_free(ver->flags);
+    audio_free(ver->gen);
+    audio_free(ver->buf);
+    audio_free(ver);
+}
+
+/**
+ * @brief The next sector to read, locked: the lowest one waiting to be read back, else the sweep's
+ */
+static uint32_t next_sector(fat_verifier_handle_t ver) {
+    if (ver->readbacks_pending) {
+        for (uint32_t s = 0; s < ver->cfg.num_sectors; s++) {
+            if ((ver->flags[s] & (SECTOR_READBACK | SECTOR_WRITING)) == SECTOR_READBACK) {
+                return s;
+            }
+        }
+    }
+    uint32_t s = ver->cursor;
+    if (++ver->cursor == ver->cfg.num_sectors) {
+        ver->cursor = 0;
+        ver->stats.passes++;
+    }
+    return s;
+}
+
+/**
+ * @brief Compare what was read with the sector's CRC, and check the structure it holds; locked
+ */
+static esp_err_t verify(fat_verifier_handle_t ver, uint32_t s, uint32_t crc) {
+    bool readback = ver->flags[s] & SECTOR_READBACK;
+    if (readback) {
+        ver->flags[s] &= ~SECTOR_READBACK;
+        ver->readbacks_pending--;
+        ver->stats.readbacks++;
+    }
+    if ((ver->flags[s] & SECTOR_KNOWN) && ver->crc[s] != crc) {
+        ver->stats.mismatches++;
+        return set_fault(ver, ESP_ERR_INVALID_CRC, s, readback ? "the write did not land" : "changed without a write");
+    }
+    ver->crc[s] = crc;
+    ver->flags[s] |= SECTOR_KNOWN;
+    if (s == 0) {
+        if (!parse_boot_sector(ver, ver->buf, &ver->layout)) {
+            ver->stats.bad_structure++;
+            return set_fault(ver, ESP_ERR_INVALID_STATE, s, "invalid boot sector");
+        }
+    } else if (ver->layout.valid && s >= ver->layout.fat_start
+               && s < ver->layout.fat_start + ver->layout.num_fats * ver->layout.fat_sectors) {
+        if (!check_fat_sector(&ver->layout, s, ver->buf, ver->cfg.sector_size)) {
+            ver->stats.bad_structure++;
+            return set_fault(ver, ESP_ERR_INVALID_STATE, s, "FAT entry out of range");
+        }
+    }
+    return ESP_OK;
+}
+
+esp_err_t fat_verifier_tick(fat_verifier_handle_t ver) {
+    AUDIO_NULL_CHECK(TAG, ver, return ESP_ERR_INVALID_ARG);
+    if (ver->fault != ESP_OK) {
+        return ver->fault;
+    }
+    int64_t now = esp_timer_get_time();
+    int64_t cap = (int64_t)ver->cfg.max_sectors_per_tick * ver->cfg.sector_size;
+    ver->tokens += (now - ver->last_us) * ver->cfg.budget_bytes_per_s / 1000000;
+    ver->tokens = ver->tokens > cap ? cap : ver->tokens;
+    ver->last_us = now;
+    esp_err_t err = ESP_OK;
+    for (int n = 0; n < ver->cfg.max_sectors_per_tick && ver->tokens >= ver->cfg.sector_size && err == ESP_OK; n++) {
+        xSemaphoreTake(ver->lock, portMAX_DELAY);
+        uint32_t s = next_sector(ver);
+        uint8_t gen = ver->gen[s];
+        bool writing = ver->flags[s] & SECTOR_WRITING;
+        xSemaphoreGive(ver->lock);
+        if (writing) {
+            ver->stats.raced++;
+            continue;
+        }
+        esp_err_t read_err = ver->cfg.read(ver->cfg.ctx, s, ver->buf, 1);
+        ver->tokens -= ver->cfg.sector_size;
+        ver->stats.sectors_read++;
+        xSemaphoreTake(ver->lock, portMAX_DELAY);
+        if (ver->gen[s] != gen || (ver->flags[s] & SECTOR_WRITING)) {
+            // written while it was read, what was read is neither the old content nor the new
+            ver->stats.raced++;
+        } else if (read_err != ESP_OK) {
+            ver->stats.read_errors++;
+            err = set_fault(ver, ESP_FAIL, s, "read failed");
+        } else {
+            err = verify(ver, s, esp_rom_crc32_le(0, ver->buf, ver->cfg.sector_size));
+        }
+        xSemaphoreGive(ver->lock);
+    }
+    return err;
+}
+
+void fat_verifier_write_begin(fat_verifier_handle_t ver, uint32_t sector, size_t count) {
+    AUDIO_NULL_CHECK(TAG, ver, return);
+    xSemaphoreTake(ver->lock, portMAX_DELAY);
+    for (uint32_t s = sector; s < sector + count && s < ver->cfg.num_sectors; s++) {
+        ver->flags[s] |= SECTOR_WRITING;
+        ver->gen[s]++;
+    }
+    xSemaphoreGive(ver->lock);
+}
+
+void fat_verifier_write_end(fat_verifier_handle_t ver, uint32_t sector, const void *buf, size_t count,
+                            esp_err_t err) {
+    AUDIO_NULL_CHECK(TAG, ver && buf, return);
+    xSemaphoreTake(ver->lock, portMAX_DELAY);
+    for (uint32_t i = 0; i < count && sector + i < ver->cfg.num_sectors; i++) {
+        uint32_t s = sector + i;
+        ver->flags[s] &= ~SECTOR_WRITING;
+        ver->gen[s]++;
+        ver->stats.writes++;
+        if (err != ESP_OK) {
+            // unknown what the sector holds now
+            ver->flags[s] &= ~SECTOR_KNOWN;
+            continue;
+        }
+        ver->crc[s] = esp_rom_crc32_le(0, (const uint8_t *)buf + i * ver->cfg.sector_size, ver->cfg.sector_size);
+        if (!(ver->flags[s] & SECTOR_READBACK)) {
+            ver->readbacks_pending++;
+        }
+        ver->flags[s] |= SECTOR_KNOWN | SECTOR_READBACK;
+    }
+    if (err != ESP_OK) {
+        ver->stats.write_errors++;
+        set_fault(ver, ESP_FAIL, sector, "write failed");
+    }
+    xSemaphoreGive(ver->lock);
+}
+
+void fat_verifier_get_stats(fat_verifier_handle_t ver, fat_verifier_stats_t *stats) {
+    if (ver && stats) {
+        xSemaphoreTake(ver->lock, portMAX_DELAY);
+        *stats = ver->stats;
+        xSemaphoreGive(ver->lock);
+    }
+}
+
+void fat_verifier_report(fat_verifier_handle_t ver) {
+    AUDIO_NULL_CHECK(TAG, ver, return);
+    fat_verifier_stats_t s;
+    fat_verifier_get_stats(ver, &s);
+    ESP_LOGI(TAG, "%u passes, %u sectors read, %u written and %u read back, %u reads raced a write", s.passes,
+             s.sectors_read, s.writes, s.readbacks, s.raced);
+    if (ver->fault != ESP_OK) {
+        ESP_LOGI(TAG, "fault %s at sector %u, %d ms: %u read errors, %u write errors, %u mismatches, %u bad structure",
+                 esp_err_to_name(ver->fault), s.fault_sector, (int)(s.fault_us / 1000), s.read_errors,
+                 s.write_errors, s.mismatches, s.bad_structure);
+    }
+}
@@ -0,0 +1,103 @@
+/* Read-mostly integrity check of a FAT volume: a sector CRC table swept a budgeted slice at a time
+
+   This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#ifndef _FAT_VERIFIER_H_
+#define _FAT_VERIFIER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Read whole sectors from flash, past any cache in front of it
+ */
+typedef esp_err_t (*fat_verifier_read_t)(void *ctx, uint32_t sector, void *buf, size_t count);
+
+typedef struct {
+    size_t              sector_size;
+    uint32_t            num_sectors;            /*!< Sectors of the volume */
+    int                 budget_bytes_per_s;     /*!< Flash read a second on average; a tick reads what it saved up */
+    int                 max_sectors_per_tick;
+    fat_verifier_read_t read;
+    void                *ctx;                   /*!< Context of read */
+} fat_verifier_cfg_t;
+
+#define FAT_VERIFIER_CFG_DEFAULT() {    \
+    .sector_size = 4096,                \
+    .num_sectors = 0,                   \
+    .budget_bytes_per_s = 16 * 1024,    \
+    .max_sectors_per_tick = 2,          \
+    .read = NULL,                       \
+    .ctx = NULL,                        \
+}
+
+typedef struct {
+    uint32_t    passes;             /*!< Sweeps of the whole volume done */
+    uint32_t    sectors_read;
+    uint32_t    readbacks;          /*!< Written sectors read back */
+    uint32_t    raced;              /*!< Reads dropped, the sector was written meanwhile */
+    uint32_t    writes;             /*!< Sectors the file system wrote */
+    uint32_t    read_errors;
+    uint32_t    write_errors;
+    uint32_t    mismatches;         /*!< Sectors that changed without a write, or a write that did not land */
+    uint32_t    bad_structure;      /*!< Boot sector or FAT entries out of range */
+    int64_t     fault_us;           /*!< esp_timer_get_time() of the first fault, 0 for none */
+    uint32_t    fault_sector;
+} fat_verifier_stats_t;
+
+typedef struct fat_verifier *fat_verifier_handle_t;
+
+/**
+ * @brief Create a verifier; it learns the CRCs on its first sweep
+ */
+fat_verifier_handle_t fat_verifier_create(const fat_verifier_cfg_t *cfg);
+
+void fat_verifier_destroy(fat_verifier_handle_t ver);
+
+/**
+ * @brief Check the next slice: the written sectors not read back yet first, then the sweep
+ *
+ * A sector is read and its CRC compared with the one known for it. The boot
+ * sector's fields and the FAT entries are checked as the sweep reads them.
+ * Call it periodically; it reads at most max_sectors_per_tick sectors and
+ * no more than the budget saved up since the last call.
+ *
+ * @return
+ *     - ESP_OK
+ *     - ESP_FAIL a sector could not be read or written
+ *     - ESP_ERR_INVALID_CRC a sector changed without a write, or a write did not land
+ *     - ESP_ERR_INVALID_STATE the boot sector or a FAT entry is invalid
+ *     The first fault is kept, every later call returns it.
+ */
+esp_err_t fat_verifier_tick(fat_verifier_handle_t ver);
+
+/**
+ * @brief The file system is about to write sectors; reads of them in flight are dropped
+ */
+void fat_verifier_write_begin(fat_verifier_handle_t ver, uint32_t sector, size_t count);
+
+/**
+ * @brief The write is done: its CRCs are taken from buf and the sectors read back by the next ticks
+ */
+void fat_verifier_write_end(fat_verifier_handle_t ver, uint32_t sector, const void *buf, size_t count,
+                            esp_err_t err);
+
+void fat_verifier_get_stats(fat_verifier_handle_t ver, fat_verifier_stats_t *stats);
+
+void fat_verifier_report(fat_verifier_handle_t ver);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,242 @@
+/* Source for MP3 files on a mounted file system, with read-ahead
+
+   This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "audio_mem.h"
+#include "audio_error.h"
+#include "ringbuf.h"
+#include "file_stream.h"
+
+static const char *TAG = "FILE_STREAM";
+
+#define FILE_PATH_MAX   64
+
+struct file_stream {
+    file_stream_cfg_t cfg;
+    ringbuf_handle_t rb;
+    char *chunk;
+    char path[FILE_PATH_MAX];
+    FILE *fp;
+    bool eof;                   // also set while no file is open
+    volatile bool quit;
+    bool primed;                // the buffer has been full since open
+    bool starved;
+    SemaphoreHandle_t wake;     // open -> reader task
+    SemaphoreHandle_t idle;     // reader task -> open / close / destroy, given while no file is being read
+    file_stream_stats_t stats;
+};
+
+static void reader_task(void *ctx) {
+    file_stream_handle_t stream = (file_stream_handle_t)ctx;
+    while (1) {
+        xSemaphoreTake(stream->wake, portMAX_DELAY);
+        if (stream->quit) {
+            break;
+        }
+        // blocks in rb_write while the buffer is full, close aborts it
+        while (file_stream_fill(stream, portMAX_DELAY) > 0) {
+        }
+        xSemaphoreGive(stream->idle);
+    }
+    xSemaphoreGive(stream->idle);
+    vTaskDelete(NULL);
+}
+
+file_stream_handle_t file_stream_create(const file_stream_cfg_t *cfg) {
+    AUDIO_NULL_CHECK(TAG, cfg, return NULL);
+    if (cfg->chunk_size <= 0 || cfg->depth <= 0) {
+        ESP_LOGE(TAG, "invalid read-ahead, %d chunks of %d bytes", cfg->depth, cfg->chunk_size);
+        return NULL;
+    }
+    file_stream_handle_t stream = audio_calloc(1, sizeof(struct file_stream));
+    AUDIO_MEM_CHECK(TAG, stream, return NULL);
+    stream->cfg = *cfg;
+    stream->eof = true;
+    stream->rb = rb_create(cfg->chunk_size, cfg->depth);
+    stream->chunk = audio_malloc(cfg->chunk_size);
+    AUDIO_MEM_CHECK(TAG, stream->rb && stream->chunk, goto _fail);
+    if (cfg->task_stack > 0) {
+        stream->wake = xSemaphoreCreateBinary();
+        stream->idle = xSemaphoreCreateBinary();
+        AUDIO_MEM_CHECK(TAG, stream->wake && stream->idle, goto _fail);
+        xSemaphoreGive(stream->idle);
+        if (xTaskCreatePinnedToCore(reader_task, "file_stream", cfg->task_stack, stream, cfg->task_prio, NULL,
+                                    cfg->task_core) != pdPASS) {
+            ESP_LOGE(TAG, "failed to create the reader task");
+            goto _fail;
+        }
+    }
+    return stream;
+
+_fail:
+    if (stream->wake) {
+        vSemaphoreDelete(stream->wake);
+    }
+    if (stream->idle) {
+        vSemaphoreDelete(stream->idle);
+    }
+    if (stream->rb) {
+        rb_destroy(stream->rb);
+    }
+    audio_free(stream->chunk);
+    audio_free(stream);
+    return NULL;
+}
+
+void file_stream_destroy(file_stream_handle_t stream) {
+    if (!stream) {
+        return;
+    }
+    file_stream_close(stream);
+    if (stream->cfg.task_stack > 0) {
+        xSemaphoreTake(stream->idle, portMAX_DELAY);
+        stream->quit = true;
+        xSemaphoreGive(stream->wake);
+        xSemaphoreTake(stream->idle, portMAX_DELAY);
+        vSemaphoreDelete(stream->wake);
+        vSemaphoreDelete(stream->idle);
+    }
+    rb_destroy(stream->rb);
+    audio_free(stream->chunk);
+    audio_free(stream);
+}
+
+esp_err_t file_stream_close(file_stream_handle_t stream) {
+    AUDIO_NULL_CHECK(TAG, stream, return ESP_ERR_INVALID_ARG);
+    if (stream->cfg.task_stack > 0) {
+        rb_abort(stream->rb);
+        xSemaphoreTake(stream->idle, portMAX_DELAY);
+    }
+    if (stream->fp) {
+        fclose(stream->fp);
+        stream->fp = NULL;
+    }
+    stream->eof = true;
+    rb_reset(stream->rb);
+    if (stream->cfg.task_stack > 0) {
+        xSemaphoreGive(stream->idle);
+    }
+    return ESP_OK;
+}
+
+esp_err_t file_stream_open(file_stream_handle_t stream, const char *path) {
+    AUDIO_NULL_CHECK(TAG, stream, return ESP_ERR_INVALID_ARG);
+    AUDIO_NULL_CHECK(TAG, path, return ESP_ERR_INVALID_ARG);
+    if (strlen(path) >= FILE_PATH_MAX) {
+        ESP_LOGE(TAG, "path too long: %s", path);
+        return ESP_ERR_INVALID_ARG;
+    }
+    file_stream_close(stream);
+    if (stream->cfg.task_stack > 0) {
+        xSemaphoreTake(stream->idle, portMAX_DELAY);
+    }
+    strcpy(stream->path, path);
+    stream->eof = false;
+    stream->primed = false;
+    stream->starved = false;
+    memset(&stream->stats, 0, sizeof(stream->stats));
+    stream->stats.min_level = -1;
+    stream->stats.depth = rb_get_size(stream->rb);
+    if (stream->cfg.task_stack > 0) {
+        xSemaphoreGive(stream->wake);
+    }
+    return ESP_OK;
+}
+
+int file_stream_fill(file_stream_handle_t stream, TickType_t wait) {
+    if (stream->eof) {
+        return AEL_IO_DONE;
+    }
+    if (wait == 0 && rb_bytes_available(stream->rb) < stream->cfg.chunk_size) {
+        return 0;
+    }
+    int64_t t0 = esp_timer_get_time();
+    if (!stream->fp && !(stream->fp = fopen(stream->path, "rb"))) {
+        ESP_LOGE(TAG, "failed to open %s", stream->path);
+        stream->eof = true;
+        rb_done_write(stream->rb);
+        return AEL_IO_FAIL;
+    }
+    // whole chunks from chunk-aligned offsets: every read maps onto whole sectors
+    int n = fread(stream->chunk, 1, stream->cfg.chunk_size, stream->fp);
+    int64_t us = esp_timer_get_time() - t0;
+    if (us > stream->stats.max_read_us) {
+        stream->stats.max_read_us = us;
+    }
+    if (n <= 0) {
+        stream->eof = true;
+        rb_done_write(stream->rb);
+        return AEL_IO_DONE;
+    }
+    int w = rb_write(stream->rb, stream->chunk, n, wait);
+    if (w != n) {
+        // aborted by close
+        return AEL_IO_ABORT;
+    }
+    stream->stats.chunks++;
+    stream->stats.bytes += n;
+    if (rb_bytes_available(stream->rb) < stream->cfg.chunk_size) {
+        stream->primed = true;
+    }
+    if (n < stream->cfg.chunk_size) {
+        stream->eof = true;
+        rb_done_write(stream->rb);
+    }
+    return n;
+}
+
+int file_stream_read_cb(audio_element_handle_t el, char *buf, int len, TickType_t wait_time, void *ctx) {
+    file_stream_handle_t stream = (file_stream_handle_t)ctx;
+    file_stream_stats_t *s = &stream->stats;
+    int level = rb_bytes_filled(stream->rb);
+    // filling the buffer is start-up, the tail of the file is not a shortage
+    bool reading = stream->primed && !stream->eof;
+    if (reading && (s->min_level < 0 || level < s->min_level)) {
+        s->min_level = level;
+    }
+    int64_t t0 = 0;
+    if (reading && level == 0) {
+        if (!stream->starved) {
+            s->underruns++;
+        }
+        stream->starved = true;
+        t0 = esp_timer_get_time();
+    }
+    int ret = rb_read(stream->rb, buf, len, wait_time);
+    if (t0) {
+        s->underrun_us += esp_timer_get_time() - t0;
+    }
+    if (ret > 0) {
+        stream->starved = false;
+        return ret;
+    }
+    if (ret == RB_DONE) {
+        return AEL_IO_DONE;
+    }
+    return ret == RB_ABORT ? AEL_IO_ABORT : AEL_IO_TIMEOUT;
+}
+
+void file_stream_get_stats(file_stream_handle_t stream, file_stream_stats_t *stats) {
+    *stats = stream->stats;
+    stats->level = rb_bytes_filled(stream->rb);
+}
+
+void file_stream_report(file_stream_handle_t stream) {
+    file_stream_stats_t s;
+    file_stream_get_stats(stream, &s);
+    ESP_LOGI(TAG, "%s: %u chunks (%u bytes), level %d/%d min %d, underruns=%u (%d ms), slowest read %d ms",
+             stream->path, s.chunks, s.bytes, s.level, s.depth, s.min_level, s.underruns, (int)(s.underrun_us / 1000),
+             (int)(s.max_read_us / 1000));
+}
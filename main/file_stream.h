@@ -0,0 +1,122 @@
+/* Source for MP3 files on a mounted file system, with read-ahead
+
+   This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#ifndef _FILE_STREAM_H_
+#define _FILE_STREAM_H_
+
+#include <stdint.h>
+#include "esp_err.h"
+#include "audio_element.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief File source configuration
+ */
+typedef struct {
+    int chunk_size;     /*!< Bytes per read, at chunk-aligned file offsets; the WL sector / FAT cluster size */
+    int depth;          /*!< Chunks of read-ahead, the buffer is allocated with audio_malloc (PSRAM when available) */
+    int task_stack;     /*!< Reader task stack, 0 for no task: the caller runs file_stream_fill() */
+    int task_prio;
+    int task_core;
+} file_stream_cfg_t;
+
+#define FILE_STREAM_CFG_DEFAULT() {     \
+    .chunk_size = 4096,                 \
+    .depth = 16,                        \
+    .task_stack = 3072,                 \
+    .task_prio = 4,                     \
+    .task_core = 0,                     \
+}
+
+/**
+ * @brief Read-ahead counters, reset by file_stream_open()
+ */
+typedef struct {
+    uint32_t chunks;        /*!< Chunks read from the file */
+    uint32_t bytes;
+    uint32_t underruns;     /*!< Times the decoder found the buffer empty after it was first full, before the end of the file */
+    int64_t  underrun_us;   /*!< Time the decoder spent waiting on an empty buffer */
+    int64_t  max_read_us;   /*!< Slowest chunk read, file open included */
+    int      level;         /*!< Bytes buffered now */
+    int      min_level;     /*!< Lowest level seen by the decoder after it was first full, -1 before */
+    int      depth;         /*!< Buffer size in bytes */
+} file_stream_stats_t;
+
+typedef struct file_stream *file_stream_handle_t;
+
+/**
+ * @brief Create a file source and its reader task
+ *
+ * @return The source handle, NULL on error
+ */
+file_stream_handle_t file_stream_create(const file_stream_cfg_t *cfg);
+
+/**
+ * @brief Close the file, stop the reader task and free the source
+ */
+void file_stream_destroy(file_stream_handle_t stream);
+
+/**
+ * @brief Start reading a file from its beginning
+ *
+ * The file is opened by the reader task, so the directory walk does not run
+ * in the caller's or the decoder's context. A file still open is closed
+ * first. Open it before the pipeline runs, or after it finished or stopped.
+ *
+ * @param stream The source handle
+ * @param path   File path, e.g. "/storage/music.mp3"; copied
+ *
+ * @return
+ *     - ESP_OK
+ *     - ESP_ERR_INVALID_ARG
+ */
+esp_err_t file_stream_open(file_stream_handle_t stream, const char *path);
+
+/**
+ * @brief Stop reading ahead and close the file
+ */
+esp_err_t file_stream_close(file_stream_handle_t stream);
+
+/**
+ * @brief Read the next chunk into the buffer, the reader task's loop body
+ *
+ * @param stream The source handle
+ * @param wait   Ticks to wait for room in the buffer, 0 to only read when a chunk fits
+ *
+ * @return Bytes buffered, 0 if there was no room, AEL_IO_DONE at the end of the file, AEL_IO_FAIL on error
+ */
+int file_stream_fill(file_stream_handle_t stream, TickType_t wait);
+
+/**
+ * @brief Element read callback serving the file from the read-ahead buffer
+ *
+ * @param ctx The source handle
+ *
+ * @return Bytes read, AEL_IO_TIMEOUT if the buffer stayed empty, or AEL_IO_DONE at the end of the file
+ */
+int file_stream_read_cb(audio_element_handle_t el, char *buf, int len, TickType_t wait_time, void *ctx);
+
+/**
+ * @brief Copy the counters
+ */
+void file_stream_get_stats(file_stream_handle_t stream, file_stream_stats_t *stats);
+
+/**
+ * @brief Log the counters
+ */
+void file_stream_report(file_stream_handle_t stream);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
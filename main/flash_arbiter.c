@@ -0,0 +1,188 @@
+/* Scheduling of flash operations around the i2s DMA headroom
+
+   This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "audio_mem.h"
+#include "audio_error.h"
+#include "flash_arbiter.h"
+
+static const char *TAG = "FLASH_ARBITER";
+
+static const char *op_names[FLASH_OP_MAX] = {"read", "write", "erase"};
+
+struct flash_arbiter {
+    flash_arbiter_cfg_t cfg;
+    SemaphoreHandle_t lock;
+    flash_arbiter_stats_t stats;
+    int64_t ready_us;               // end of the recovery pause of the last window
+};
+
+flash_arbiter_handle_t flash_arbiter_create(const flash_arbiter_cfg_t *cfg) {
+    AUDIO_NULL_CHECK(TAG, cfg, return NULL);
+    if (cfg->unit_size == 0) {
+        ESP_LOGE(TAG, "unit size must not be 0");
+        return NULL;
+    }
+    flash_arbiter_handle_t arb = audio_calloc(1, sizeof(struct flash_arbiter));
+    AUDIO_MEM_CHECK(TAG, arb, return NULL);
+    arb->cfg = *cfg;
+    arb->lock = xSemaphoreCreateMutex();
+    AUDIO_MEM_CHECK(TAG, arb->lock, {
+        audio_free(arb);
+        return NULL;
+    });
+    return arb;
+}
+
+void flash_arbiter_destroy(flash_arbiter_handle_t arb) {
+    if (!arb) {
+        return;
+    }
+    vSemaphoreDelete(arb->lock);
+    audio_free(arb);
+}
+
+void flash_arbiter_set_headroom(flash_arbiter_handle_t arb, flash_arbiter_headroom_t fn, void *ctx) {
+    xSemaphoreTake(arb->lock, portMAX_DELAY);
+    arb->cfg.headroom = fn;
+    arb->cfg.headroom_ctx = ctx;
+    xSemaphoreGive(arb->lock);
+}
+
+int64_t flash_arbiter_estimate(flash_arbiter_handle_t arb, flash_op_t op, size_t size) {
+    int64_t per_kib = arb->cfg.model.us_per_kib[op];
+    const flash_arbiter_stats_t *s = &arb->stats;
+    if (s->bytes[op] >= 1024) {
+        // learnt cost, fixed cost included
+        int64_t learnt = s->total_us[op] * 1024 / (int64_t)s->bytes[op];
+        if (learnt > per_kib) {
+            per_kib = learnt;
+        }
+    }
+    return arb->cfg.model.op_us + per_kib * (int64_t)size / 1024;
+}
+
+static int64_t headroom(flash_arbiter_handle_t arb) {
+    return arb->cfg.headroom ? arb->cfg.headroom(arb->cfg.headroom_ctx) : -1;
+}
+
+static size_t window_size(flash_arbiter_handle_t arb, flash_op_t op, size_t remain) {
+    size_t unit = arb->cfg.unit_size;
+    size_t size = unit;
+    if (arb->cfg.idle_window_size >= unit && headroom(arb) < 0) {
+        // nothing to starve, only the other callers wait for it
+        size = arb->cfg.idle_window_size / unit * unit;
+        return size < remain ? size : remain;
+    }
+    while (size + unit <= remain && flash_arbiter_estimate(arb, op, size + unit) <= arb->cfg.max_window_us) {
+        size += unit;
+    }
+    return size;
+}
+
+/**
+ * @brief Wait until the last window's recovery pause is over and the window fits the headroom
+ *
+ * @return Headroom the window starts with, -1 if audio is idle
+ */
+static int64_t wait_for_headroom(flash_arbiter_handle_t arb, int64_t need_us) {
+    int64_t t0 = esp_timer_get_time();
+    int64_t room = headroom(arb);
+    if (room < 0 || (room >= need_us && t0 >= arb->ready_us)) {
+        return room;
+    }
+    arb->stats.waits++;
+    if (t0 < arb->ready_us) {
+        int64_t ms = (arb->ready_us - t0 + 999) / 1000;
+        vTaskDelay((ms + portTICK_PERIOD_MS - 1) / portTICK_PERIOD_MS);
+    }
+    int64_t deadline = t0 + arb->cfg.max_wait_ms * 1000LL;
+    while ((room = headroom(arb)) >= 0 && room < need_us) {
+        if (esp_timer_get_time() >= deadline) {
+            arb->stats.forced++;
+            break;
+        }
+        // one tick lets the i2s task top up the DMA buffers
+        vTaskDelay(1);
+    }
+    arb->stats.wait_us += esp_timer_get_time() - t0;
+    return room;
+}
+
+esp_err_t flash_arbiter_run(flash_arbiter_handle_t arb, flash_op_t op, size_t addr, void *buf, size_t size,
+                            flash_arbiter_io_t io, void *ctx) {
+    AUDIO_NULL_CHECK(TAG, arb, return ESP_ERR_INVALID_ARG);
+    if (op >= FLASH_OP_MAX || size % arb->cfg.unit_size) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    esp_err_t ret = ESP_OK;
+    xSemaphoreTake(arb->lock, portMAX_DELAY);
+    while (size > 0) {
+        size_t len = window_size(arb, op, size);
+        int64_t room = wait_for_headroom(arb, flash_arbiter_estimate(arb, op, len) + arb->cfg.margin_us);
+
+        int64_t t0 = esp_timer_get_time();
+        ret = io(op, addr, buf, len, ctx);
+        int64_t t1 = esp_timer_get_time();
+        int64_t us = t1 - t0;
+        arb->ready_us = t1 + us * arb->cfg.recovery_pct / 100;
+
+        flash_arbiter_stats_t *s = &arb->stats;
+        s->ops[op]++;
+        s->bytes[op] += len;
+        s->total_us[op] += us;
+        if (us > s->max_us[op]) {
+            s->max_us[op] = us;
+        }
+        if (us > s->worst_window_us) {
+            s->worst_window_us = us;
+        }
+        if (room >= 0 && us > room) {
+            s->overruns++;
+            if (us - room > s->worst_overrun_us) {
+                s->worst_overrun_us = us - room;
+            }
+        }
+        if (ret != ESP_OK) {
+            ESP_LOGE(TAG, "%s of %d bytes at 0x%x failed", op_names[op], (int)len, (int)addr);
+            break;
+        }
+        addr += len;
+        size -= len;
+        if (buf) {
+            buf = (char *)buf + len;
+        }
+    }
+    xSemaphoreGive(arb->lock);
+    return ret;
+}
+
+void flash_arbiter_get_stats(flash_arbiter_handle_t arb, flash_arbiter_stats_t *stats) {
+    xSemaphoreTake(arb->lock, portMAX_DELAY);
+    *stats = arb->stats;
+    xSemaphoreGive(arb->lock);
+}
+
+void flash_arbiter_report(flash_arbiter_handle_t arb) {
+    flash_arbiter_stats_t s;
+    flash_arbiter_get_stats(arb, &s);
+    for (int op = 0; op < FLASH_OP_MAX; op++) {
+        if (s.ops[op]) {
+            ESP_LOGI(TAG, "%-5s windows=%u bytes=%u avg=%d us max=%d us", op_names[op], s.ops[op],
+                     (unsigned)s.bytes[op], (int)(s.total_us[op] / s.ops[op]), (int)s.max_us[op]);
+        }
+    }
+    ESP_LOGI(TAG, "worst cache-disabled window %d us, waits=%u (%d ms) forced=%u overruns=%u (worst by %d us)",
+             (int)s.worst_window_us, s.waits, (int)(s.wait_us / 1000), s.forced, s.overruns,
+             (int)s.worst_overrun_us);
+}
@@ -0,0 +1,179 @@
+/* Scheduling of flash operations around the i2s DMA headroom
+
+   This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#ifndef _FLASH_ARBITER_H_
+#define _FLASH_ARBITER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Flash operations, each one runs with the cache disabled
+ */
+typedef enum {
+    FLASH_OP_READ,
+    FLASH_OP_WRITE,
+    FLASH_OP_ERASE,
+    FLASH_OP_MAX,
+} flash_op_t;
+
+/**
+ * @brief Expected duration of flash operations, used to size the windows
+ *
+ * The arbiter also learns the average cost per KiB of each operation and
+ * uses whichever of the two is larger.
+ */
+typedef struct {
+    int op_us;                          /*!< Fixed cost of any operation */
+    int us_per_kib[FLASH_OP_MAX];       /*!< Cost per KiB of each operation */
+} flash_latency_model_t;
+
+/**
+ * @brief Typical ESP32 QIO flash: ~20 MB/s reads, ~256 B page program in 0.7 ms, 4 KiB sector erase in 45 ms
+ */
+#define FLASH_LATENCY_MODEL_DEFAULT() {         \
+    .op_us = 20,                                \
+    .us_per_kib = {                             \
+        [FLASH_OP_READ] = 50,                   \
+        [FLASH_OP_WRITE] = 2800,                \
+        [FLASH_OP_ERASE] = 11250,               \
+    },                                          \
+}
+
+/**
+ * @brief Audio the i2s DMA can still play without its task, in us
+ *
+ * While the cache is disabled neither the decoder nor the i2s task run, so
+ * this is what a flash operation may take at most without an underrun.
+ *
+ * @return Headroom in us, or -1 when no audio is playing and flash is free
+ */
+typedef int64_t (*flash_arbiter_headroom_t)(void *ctx);
+
+/**
+ * @brief Performs one window of a flash operation
+ *
+ * @param op   Operation
+ * @param addr Start address, in the address space of the caller
+ * @param buf  Data for reads and writes, NULL for erases
+ * @param size Bytes, a multiple of the unit size
+ * @param ctx  Context given to flash_arbiter_run()
+ */
+typedef esp_err_t (*flash_arbiter_io_t)(flash_op_t op, size_t addr, void *buf, size_t size, void *ctx);
+
+typedef struct {
+    flash_latency_model_t    model;
+    size_t                   unit_size;     /*!< Operations are split on multiples of this, e.g. the WL sector size */
+    int                      max_window_us; /*!< Upper bound of one window, a single unit may exceed it */
+    size_t                   idle_window_size; /*!< Bytes of one window while no audio plays, e.g. a 64 KiB block erase; 0 to split as when playing */
+    int                      margin_us;     /*!< Headroom kept back in every window */
+    int                      recovery_pct;  /*!< Pause after a window, in percent of its duration, for the decoder to catch up */
+    int                      max_wait_ms;   /*!< Run a window anyway after waiting this long for headroom */
+    flash_arbiter_headroom_t headroom;      /*!< Headroom provider, NULL until audio is set up */
+    void                     *headroom_ctx;
+} flash_arbiter_cfg_t;
+
+#define FLASH_ARBITER_CFG_DEFAULT() {               \
+    .model = FLASH_LATENCY_MODEL_DEFAULT(),         \
+    .unit_size = 4096,                              \
+    .max_window_us = 10000,                         \
+    .idle_window_size = 0,                          \
+    .margin_us = 2000,                              \
+    .recovery_pct = 100,                            \
+    .max_wait_ms = 1000,                            \
+    .headroom = NULL,                               \
+    .headroom_ctx = NULL,                           \
+}
+
+/**
+ * @brief Arbiter counters
+ */
+typedef struct {
+    uint32_t ops[FLASH_OP_MAX];         /*!< Windows run per operation */
+    int64_t  total_us[FLASH_OP_MAX];    /*!< Cache-disabled time per operation */
+    int64_t  max_us[FLASH_OP_MAX];      /*!< Longest window per operation */
+    uint64_t bytes[FLASH_OP_MAX];
+    uint32_t waits;                     /*!< Windows that waited for recovery or headroom */
+    int64_t  wait_us;                   /*!< Total time spent waiting */
+    uint32_t forced;                    /*!< Windows run after max_wait_ms without enough headroom */
+    uint32_t overruns;                  /*!< Windows that took longer than the headroom they started with */
+    int64_t  worst_window_us;           /*!< Worst-case cache-disabled duration */
+    int64_t  worst_overrun_us;          /*!< Largest amount by which a window outlasted its headroom */
+} flash_arbiter_stats_t;
+
+typedef struct flash_arbiter *flash_arbiter_handle_t;
+
+/**
+ * @brief Create an arbiter
+ *
+ * @return The arbiter, NULL on error
+ */
+flash_arbiter_handle_t flash_arbiter_create(const flash_arbiter_cfg_t *cfg);
+
+/**
+ * @brief Destroy the arbiter
+ */
+void flash_arbiter_destroy(flash_arbiter_handle_t arb);
+
+/**
+ * @brief Set the headroom provider, e.g. once the i2s stream exists
+ */
+void flash_arbiter_set_headroom(flash_arbiter_handle_t arb, flash_arbiter_headroom_t fn, void *ctx);
+
+/**
+ * @brief Run a flash operation in bounded windows
+ *
+ * The operation is split into windows whose expected duration fits
+ * max_window_us, and each window starts only when the headroom covers its
+ * expected duration plus the margin and the recovery pause of the previous
+ * window has passed, so the decoder and the i2s task get to refill the ring
+ * buffer and DMA between windows. While no audio plays a window is
+ * idle_window_size bytes, if set. Operations of all callers are serialised.
+ *
+ * @param arb  The arbiter
+ * @param op   Operation
+ * @param addr Start address
+ * @param buf  Data for reads and writes, NULL for erases
+ * @param size Bytes, a multiple of unit_size
+ * @param io   Performs the windows
+ * @param ctx  Context of io
+ *
+ * @return
+ *     - ESP_OK
+ *     - ESP_ERR_INVALID_SIZE size is not a multiple of unit_size
+ *     - the first error returned by io
+ */
+esp_err_t flash_arbiter_run(flash_arbiter_handle_t arb, flash_op_t op, size_t addr, void *buf, size_t size,
+                            flash_arbiter_io_t io, void *ctx);
+
+/**
+ * @brief Expected duration of one window, in us
+ */
+int64_t flash_arbiter_estimate(flash_arbiter_handle_t arb, flash_op_t op, size_t size);
+
+/**
+ * @brief Copy the counters
+ */
+void flash_arbiter_get_stats(flash_arbiter_handle_t arb, flash_arbiter_stats_t *stats);
+
+/**
+ * @brief Log the counters and the worst-case cache-disabled duration
+ */
+void flash_arbiter_report(flash_arbiter_handle_t arb);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
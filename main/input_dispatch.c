@@ -0,0 +1,209 @@
+/* Table-driven dispatch of input events with debounce, coalescing and repeat
+
+   This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#include <string.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "audio_mem.h"
+#include "audio_error.h"
+#include "input_dispatch.h"
+
+static const char *TAG = "INPUT_DISPATCH";
+
+typedef struct {
+    input_action_t action;      // NULL if the slot is free
+    int arg;
+    int count;                  // 0: only the burst's first event, which acted at once
+    int64_t first_us;           // first event summed
+    int64_t due_us;
+    int64_t max_due_us;         // a burst that never pauses acts here
+} pending_t;
+
+typedef struct {
+    int64_t last_us;            // last event taken, -1 for none
+    bool repeating;
+    int source_type;            // of the event that started the repeat
+    int id;
+    int64_t next_repeat_us;
+} binding_state_t;
+
+struct input_dispatch {
+    input_binding_t bindings[INPUT_DISPATCH_MAX_BINDINGS];
+    binding_state_t state[INPUT_DISPATCH_MAX_BINDINGS];
+    int num_bindings;
+    void *ctx;
+    pending_t pending[INPUT_DISPATCH_MAX_BINDINGS];
+    int64_t action_since;       // of the action running
+    input_dispatch_stats_t stats;
+};
+
+static bool matches(int want, int got) {
+    return want == INPUT_DISPATCH_ANY || want == got;
+}
+
+static void run(input_dispatch_handle_t disp, input_action_t action, int arg, int count, int64_t since) {
+    disp->stats.actions++;
+    disp->action_since = since;
+    action(disp->ctx, arg, count);
+}
+
+/**
+ * @brief Free a pending slot, running what was summed in it
+ */
+static void flush(input_dispatch_handle_t disp, pending_t *p) {
+    pending_t due = *p;
+    p->action = NULL;
+    if (due.count) {
+        run(disp, due.action, due.arg, due.count, due.first_us);
+    }
+}
+
+/**
+ * @brief Act on an event binding b took, or add it to the pending action
+ */
+static void take(input_dispatch_handle_t disp, int b, int64_t now) {
+    const input_binding_t *bind = &disp->bindings[b];
+    if (bind->coalesce_ms <= 0) {
+        run(disp, bind->action, bind->arg, 1, now);
+        return;
+    }
+    pending_t *free_slot = NULL;
+    for (int i = 0; i < disp->num_bindings; i++) {
+        pending_t *p = &disp->pending[i];
+        if (p->action == bind->action && now < p->due_us) {
+            if (!p->count) {
+                p->first_us = now;
+            }
+            p->arg += bind->arg;
+            p->count++;
+            p->due_us = now + bind->coalesce_ms * 1000LL;
+            if (p->due_us > p->max_due_us) {
+                p->due_us = p->max_due_us;
+            }
+            disp->stats.coalesced++;
+            return;
+        }
+        if (p->action == bind->action) {
+            // the burst ended and was not polled yet: it acts first
+            flush(disp, p);
+        }
+        if (!p->action && !free_slot) {
+            free_slot = p;
+        }
+    }
+    // the first event of a burst acts at once, the slot sums the ones that follow; one slot per binding, there is
+    // always a free one
+    *free_slot = (pending_t) {
+        .action = bind->action,
+        .due_us = now + bind->coalesce_ms * 1000LL,
+        .max_due_us = now + bind->coalesce_ms * 1000LL * INPUT_DISPATCH_COALESCE_SPAN,
+    };
+    run(disp, bind->action, bind->arg, 1, now);
+}
+
+input_dispatch_handle_t input_dispatch_create(const input_dispatch_cfg_t *cfg) {
+    AUDIO_NULL_CHECK(TAG, cfg && (cfg->bindings || !cfg->num_bindings), return NULL);
+    if (cfg->num_bindings < 0 || cfg->num_bindings > INPUT_DISPATCH_MAX_BINDINGS) {
+        ESP_LOGE(TAG, "%d bindings, at most %d", cfg->num_bindings, INPUT_DISPATCH_MAX_BINDINGS);
+        return NULL;
+    }
+    for (int i = 0; i < cfg->num_bindings; i++) {
+        if (!cfg->bindings[i].action) {
+            ESP_LOGE(TAG, "binding %d has no action", i);
+            return NULL;
+        }
+    }
+    input_dispatch_handle_t disp = audio_calloc(1, sizeof(struct input_dispatch));
+    AUDIO_MEM_CHECK(TAG, disp, return NULL);
+    memcpy(disp->bindings, cfg->bindings, cfg->num_bindings * sizeof(input_binding_t));
+    disp->num_bindings = cfg->num_bindings;
+    disp->ctx = cfg->ctx;
+    for (int i = 0; i < disp->num_bindings; i++) {
+        disp->state[i].last_us = -1;
+    }
+    return disp;
+}
+
+void input_dispatch_destroy(input_dispatch_handle_t disp) {
+    audio_free(disp);
+}
+
+bool input_dispatch_event(input_dispatch_handle_t disp, int source_type, int cmd, int id) {
+    AUDIO_NULL_CHECK(TAG, disp, return false);
+    int64_t now = esp_timer_get_time();
+    disp->stats.events++;
+    // any event of the held button ends its repeat: the release, or a press if the release got lost
+    for (int i = 0; i < disp->num_bindings; i++) {
+        binding_state_t *st = &disp->state[i];
+        if (st->repeating && st->source_type == source_type && st->id == id) {
+            st->repeating = false;
+        }
+    }
+    for (int i = 0; i < disp->num_bindings; i++) {
+        const input_binding_t *bind = &disp->bindings[i];
+        if (!matches(bind->source_type, source_type) || bind->cmd != cmd || !matches(bind->id, id)) {
+            continue;
+        }
+        binding_state_t *st = &disp->state[i];
+        if (st->last_us >= 0 && now - st->last_us < bind->debounce_ms * 1000LL) {
+            disp->stats.debounced++;
+            return true;
+        }
+        st->last_us = now;
+        take(disp, i, now);
+        if (bind->repeat_ms > 0) {
+            st->repeating = true;
+            st->source_type = source_type;
+            st->id = id;
+            st->next_repeat_us = now + bind->repeat_ms * 1000LL;
+        }
+        return true;
+    }
+    disp->stats.unbound++;
+    return false;
+}
+
+int input_dispatch_poll(input_dispatch_handle_t disp) {
+    AUDIO_NULL_CHECK(TAG, disp, return -1);
+    int64_t now = esp_timer_get_time();
+    for (int i = 0; i < disp->num_bindings; i++) {
+        binding_state_t *st = &disp->state[i];
+        if (st->repeating && now >= st->next_repeat_us) {
+            disp->stats.repeats++;
+            st->last_us = now;
+            st->next_repeat_us = now + disp->bindings[i].repeat_ms * 1000LL;
+            take(disp, i, now);
+        }
+    }
+    int64_t next = -1;
+    for (int i = 0; i < disp->num_bindings; i++) {
+        pending_t *p = &disp->pending[i];
+        if (p->action && now >= p->due_us) {
+            flush(disp, p);
+        }
+        // a burst of one needs no wakeup, its slot is freed by the next event or poll
+        if (p->action && p->count && (next < 0 || p->due_us < next)) {
+            next = p->due_us;
+        }
+        if (disp->state[i].repeating && (next < 0 || disp->state[i].next_repeat_us < next)) {
+            next = disp->state[i].next_repeat_us;
+        }
+    }
+    return next < 0 ? -1 : (int)((next - now + 999) / 1000);
+}
+
+int64_t input_dispatch_get_action_since(input_dispatch_handle_t disp) {
+    return disp ? disp->action_since : 0;
+}
+
+void input_dispatch_get_stats(input_dispatch_handle_t disp, input_dispatch_stats_t *stats) {
+    if (disp && stats) {
+        *stats = disp->stats;
+    }
+}
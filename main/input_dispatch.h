@@ -0,0 +1,108 @@
+/* Table-driven dispatch of input events with debounce, coalescing and repeat
+
+   This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#ifndef _INPUT_DISPATCH_H_
+#define _INPUT_DISPATCH_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define INPUT_DISPATCH_ANY              (-1)
+#define INPUT_DISPATCH_MAX_BINDINGS     (32)
+#define INPUT_DISPATCH_COALESCE_SPAN    (4)     /*!< A burst that never pauses still acts every this many windows */
+
+/**
+ * @brief What a binding does
+ *
+ * @param ctx   Context of the dispatcher
+ * @param arg   The binding's arg; for coalesced events the sum of theirs
+ * @param count Events it stands for
+ */
+typedef void (*input_action_t)(void *ctx, int arg, int count);
+
+/**
+ * @brief One entry of the table, keyed on the event's (source_type, cmd, id)
+ *
+ * The first binding that matches an event takes it.
+ */
+typedef struct {
+    int             source_type;    /*!< msg.source_type, INPUT_DISPATCH_ANY for any */
+    int             cmd;            /*!< msg.cmd */
+    int             id;             /*!< msg.data, the button id; INPUT_DISPATCH_ANY for any */
+    input_action_t  action;
+    int             arg;
+    int             debounce_ms;    /*!< Drop events closer than this to the last one the binding took */
+    int             coalesce_ms;    /*!< > 0: the first event of a burst acts at once, the ones that follow it
+                                         within coalesce_ms of each other act once, coalesce_ms after the last.
+                                         Pending events of all bindings with the same action are summed together */
+    int             repeat_ms;      /*!< > 0: take the event again every repeat_ms while the button is held */
+    int             stop_cmd;       /*!< cmd that ends the repeat, e.g. the long release; any other event of
+                                         the same source and id ends it too */
+} input_binding_t;
+
+typedef struct {
+    const input_binding_t   *bindings;
+    int                     num_bindings;
+    void                    *ctx;           /*!< Passed to the actions */
+} input_dispatch_cfg_t;
+
+typedef struct {
+    uint32_t events;        /*!< input_dispatch_event() calls */
+    uint32_t unbound;       /*!< Events no binding took */
+    uint32_t debounced;     /*!< Events dropped by debounce */
+    uint32_t coalesced;     /*!< Events added to a pending action */
+    uint32_t repeats;       /*!< Events taken again by a repeat */
+    uint32_t actions;       /*!< Actions run */
+} input_dispatch_stats_t;
+
+typedef struct input_dispatch *input_dispatch_handle_t;
+
+/**
+ * @brief Create a dispatcher, the bindings are copied
+ */
+input_dispatch_handle_t input_dispatch_create(const input_dispatch_cfg_t *cfg);
+
+void input_dispatch_destroy(input_dispatch_handle_t disp);
+
+/**
+ * @brief Take one event
+ *
+ * Actions without coalesce_ms run from here, in the caller's task.
+ *
+ * @return Whether a binding took it, debounced events included
+ */
+bool input_dispatch_event(input_dispatch_handle_t disp, int source_type, int cmd, int id);
+
+/**
+ * @brief Run the coalesced actions and repeats that are due
+ *
+ * Call it from the loop that calls input_dispatch_event(), at the latest
+ * after the time it returns.
+ *
+ * @return ms until the next one is due, -1 if nothing is pending
+ */
+int input_dispatch_poll(input_dispatch_handle_t disp);
+
+/**
+ * @brief While an action runs: esp_timer time of the first event it stands for, e.g. to trace its latency from there
+ */
+int64_t input_dispatch_get_action_since(input_dispatch_handle_t disp);
+
+void input_dispatch_get_stats(input_dispatch_handle_t disp, input_dispatch_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
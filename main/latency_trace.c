@@ -0,0 +1,382 @@
+/* Control latency tracing, from a button event to the first PCM of the new state at the i2s writer
+
+   This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include "freertos/FreeRTOS.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "audio_mem.h"
+#include "audio_error.h"
+#include "ringbuf.h"
+#include "latency_trace.h"
+
+static const char *TAG = "LATENCY_TRACE";
+
+#define POINT_BIT(p)    (1U << (p))
+
+const int latency_trace_bucket_ms[LATENCY_HIST_BUCKETS - 1] = {
+    1, 2, 5, 10, 20, 50, 100, 200, 500, 1000, 2000
+};
+
+static const char *cmd_names[LATENCY_CMD_MAX] = {
+    "play", "pause", "resume", "next", "volume"
+};
+
+struct latency_trace {
+    portMUX_TYPE lock;
+    audio_element_handle_t decoder;
+    audio_element_handle_t i2s;
+    ringbuf_handle_t rb;                    // NULL while detached
+    ringbuf_handle_t watch[LATENCY_TRACE_MAX_RB];       // between the reader and i2s
+    audio_element_handle_t watch_el[LATENCY_TRACE_MAX_RB];
+    int num_watch;
+    latency_source_pos_t source_pos;
+    void *source_ctx;
+    int64_t source_base;                    // source position at decoder output 0
+    int64_t dec_bytes;                      // total written by the decoder
+    latency_output_cb_t output_cb;
+    void *output_ctx;
+    latency_write_gate_t write_gate;
+    void *gate_ctx;
+    int64_t write_wait_us;                  // how long the last block waited for room, decoder task only
+    latency_point_t volume_end;
+
+    // command in flight, all guarded by lock
+    int active;                             // latency_cmd_t, -1 if none
+    latency_point_t end;
+    int64_t t[LATENCY_POINT_MAX];
+    uint32_t points;
+    bool decoder_armed;                     // decoder output from dec_from on is the new state
+    int64_t dec_from;
+    int64_t i2s_from;                       // i2s read count where the new state starts, -1 if not known yet
+    int64_t i2s_bytes;                      // total read by the i2s writer
+
+    latency_stats_t stats[LATENCY_CMD_MAX];
+};
+
+static int bucket_of(int64_t us) {
+    int i = 0;
+    while (i < LATENCY_HIST_BUCKETS - 1 && us > latency_trace_bucket_ms[i] * 1000LL) {
+        i++;
+    }
+    return i;
+}
+
+static void complete_locked(latency_trace_handle_t lt) {
+    latency_stats_t *s = &lt->stats[lt->active];
+    int64_t us = lt->t[lt->end] - lt->t[LATENCY_POINT_EVENT];
+    if (s->count == 0 || us < s->min_us) {
+        s->min_us = us;
+    }
+    if (us > s->max_us) {
+        s->max_us = us;
+    }
+    s->sum_us += us;
+    s->count++;
+    s->hist[bucket_of(us)]++;
+    for (int p = 0; p < LATENCY_POINT_MAX; p++) {
+        if (lt->points & POINT_BIT(p)) {
+            s->point_count[p]++;
+            s->point_sum_us[p] += lt->t[p] - lt->t[LATENCY_POINT_EVENT];
+        }
+    }
+    lt->active = -1;
+    lt->decoder_armed = false;
+    lt->i2s_from = -1;
+}
+
+static void mark_locked(latency_trace_handle_t lt, latency_point_t point, int64_t now) {
+    if (lt->active < 0 || (lt->points & POINT_BIT(point))) {
+        return;
+    }
+    lt->t[point] = now;
+    lt->points |= POINT_BIT(point);
+    if (point == lt->end) {
+        complete_locked(lt);
+    }
+}
+
+/**
+ * @brief Time len bytes of the decoder's output play for, the i2s writer is paced by DMA
+ */
+static int64_t pcm_us(audio_element_handle_t el, int64_t len) {
+    audio_element_info_t info;
+    audio_element_getinfo(el, &info);
+    int64_t rate = (int64_t)info.sample_rates * info.channels * info.bits / 8;
+    return rate > 0 ? len * 1000000 / rate : 0;
+}
+
+static int decoder_out_tap(audio_element_handle_t el, char *buf, int len, TickType_t wait_time, void *ctx) {
+    latency_trace_handle_t lt = (latency_trace_handle_t)ctx;
+    // the decoder task is the only writer of dec_bytes
+    if (lt->decoder_armed && lt->dec_bytes + len > lt->dec_from) {
+        int64_t now = esp_timer_get_time();
+        // PCM already queued plays first; exact to within one i2s read
+        int queued = rb_bytes_filled(lt->rb);
+        portENTER_CRITICAL(&lt->lock);
+        if (lt->decoder_armed) {
+            int64_t skip = lt->dec_from > lt->dec_bytes ? lt->dec_from - lt->dec_bytes : 0;
+            lt->decoder_armed = false;
+            if (lt->i2s_from < 0) {
+                lt->i2s_from = lt->i2s_bytes + queued + skip;
+            }
+            mark_locked(lt, LATENCY_POINT_DECODER, now);
+        }
+        portEXIT_CRITICAL(&lt->lock);
+    }
+    int64_t pos = lt->source_base + lt->dec_bytes;
+    lt->dec_bytes += len;
+    int64_t t0 = esp_timer_get_time();
+    if (lt->write_gate) {
+        lt->write_gate(lt->gate_ctx, lt->rb, len);
+    }
+    int n = rb_write(lt->rb, buf, len, wait_time);
+    lt->write_wait_us = esp_timer_get_time() - t0;
+    if (n > 0 && lt->output_cb) {
+        lt->output_cb(lt->output_ctx, pos, buf, n);
+    }
+    return n;
+}
+
+/**
+ * @brief Time the PCM queued behind the reader plays for before what it reads now reaches i2s
+ */
+static int64_t downstream_us(latency_trace_handle_t lt) {
+    int64_t us = 0;
+    for (int i = 0; i < lt->num_watch; i++) {
+        us += pcm_us(lt->watch_el[i], rb_bytes_filled(lt->watch[i]));
+    }
+    return us;
+}
+
+static int i2s_in_tap(audio_element_handle_t el, char *buf, int len, TickType_t wait_time, void *ctx) {
+    latency_trace_handle_t lt = (latency_trace_handle_t)ctx;
+    int n = rb_read(lt->rb, buf, len, wait_time);
+    if (n > 0) {
+        int64_t now = esp_timer_get_time();
+        // sampled outside the lock, the ring buffers take their own
+        int64_t behind = downstream_us(lt);
+        portENTER_CRITICAL(&lt->lock);
+        if (lt->i2s_from >= 0 && lt->i2s_bytes + n > lt->i2s_from) {
+            // the part of this read before the new state is written out first, after what is queued behind the reader
+            int64_t ahead = lt->i2s_from > lt->i2s_bytes ? lt->i2s_from - lt->i2s_bytes : 0;
+            mark_locked(lt, LATENCY_POINT_I2S, now + pcm_us(lt->decoder, ahead) + behind);
+        }
+        lt->i2s_bytes += n;
+        portEXIT_CRITICAL(&lt->lock);
+    }
+    return n;
+}
+
+latency_trace_handle_t latency_trace_create(void) {
+    latency_trace_handle_t lt = audio_calloc(1, sizeof(struct latency_trace));
+    AUDIO_MEM_CHECK(TAG, lt, return NULL);
+    portMUX_TYPE unlocked = portMUX_INITIALIZER_UNLOCKED;
+    lt->lock = unlocked;
+    lt->active = -1;
+    lt->i2s_from = -1;
+    lt->volume_end = LATENCY_POINT_API;
+    return lt;
+}
+
+void latency_trace_destroy(latency_trace_handle_t lt) {
+    audio_free(lt);
+}
+
+esp_err_t latency_trace_attach(latency_trace_handle_t lt, audio_element_handle_t decoder, audio_element_handle_t i2s) {
+    AUDIO_NULL_CHECK(TAG, lt, return ESP_FAIL);
+    ringbuf_handle_t rb = audio_element_get_output_ringbuf(decoder);
+    if (!rb || rb != audio_element_get_input_ringbuf(i2s)) {
+        ESP_LOGE(TAG, "decoder and i2s writer are not linked by a ring buffer");
+        return ESP_FAIL;
+    }
+    lt->decoder = decoder;
+    lt->i2s = i2s;
+    lt->rb = rb;
+    if (lt->source_pos) {
+        lt->source_base = lt->source_pos(lt->source_ctx) - lt->dec_bytes;
+    }
+    audio_element_set_write_cb(decoder, decoder_out_tap, lt);
+    audio_element_set_read_cb(i2s, i2s_in_tap, lt);
+    return ESP_OK;
+}
+
+esp_err_t latency_trace_watch_ringbuf(latency_trace_handle_t lt, ringbuf_handle_t rb, audio_element_handle_t el) {
+    AUDIO_NULL_CHECK(TAG, lt, return ESP_ERR_INVALID_ARG);
+    AUDIO_NULL_CHECK(TAG, rb, return ESP_ERR_INVALID_ARG);
+    AUDIO_NULL_CHECK(TAG, el, return ESP_ERR_INVALID_ARG);
+    if (lt->num_watch >= LATENCY_TRACE_MAX_RB) {
+        ESP_LOGE(TAG, "at most %d ring buffers", LATENCY_TRACE_MAX_RB);
+        return ESP_ERR_INVALID_ARG;
+    }
+    lt->watch[lt->num_watch] = rb;
+    lt->watch_el[lt->num_watch] = el;
+    lt->num_watch++;
+    return ESP_OK;
+}
+
+void latency_trace_set_source(latency_trace_handle_t lt, latency_source_pos_t fn, void *ctx) {
+    lt->source_pos = fn;
+    lt->source_ctx = ctx;
+    lt->source_base = fn ? fn(ctx) - lt->dec_bytes : 0;
+}
+
+void latency_trace_set_output_cb(latency_trace_handle_t lt, latency_output_cb_t fn, void *ctx) {
+    lt->output_cb = fn;
+    lt->output_ctx = ctx;
+}
+
+void latency_trace_set_write_gate(latency_trace_handle_t lt, latency_write_gate_t fn, void *ctx) {
+    lt->write_gate = fn;
+    lt->gate_ctx = ctx;
+}
+
+int64_t latency_trace_get_write_wait_us(latency_trace_handle_t lt) {
+    return lt->write_wait_us;
+}
+
+esp_err_t latency_trace_detach(latency_trace_handle_t lt) {
+    AUDIO_NULL_CHECK(TAG, lt, return ESP_FAIL);
+    if (!lt->rb) {
+        return ESP_OK;
+    }
+    audio_element_set_output_ringbuf(lt->decoder, lt->rb);
+    audio_element_set_input_ringbuf(lt->i2s, lt->rb);
+    lt->rb = NULL;
+    return ESP_OK;
+}
+
+void latency_trace_begin(latency_trace_handle_t lt, latency_cmd_t cmd) {
+    latency_trace_begin_at(lt, cmd, esp_timer_get_time());
+}
+
+void latency_trace_begin_at(latency_trace_handle_t lt, latency_cmd_t cmd, int64_t now) {
+    portENTER_CRITICAL(&lt->lock);
+    if (lt->active >= 0) {
+        lt->stats[lt->active].dropped++;
+    }
+    lt->active = cmd;
+    lt->t[LATENCY_POINT_EVENT] = now;
+    lt->points = POINT_BIT(LATENCY_POINT_EVENT);
+    switch (cmd) {
+    case LATENCY_CMD_PAUSE:
+    case LATENCY_CMD_VOLUME:
+        lt->end = cmd == LATENCY_CMD_VOLUME ? lt->volume_end : LATENCY_POINT_API;
+        lt->decoder_armed = false;
+        lt->i2s_from = -1;
+        break;
+    case LATENCY_CMD_NEXT:
+        // the new track starts where the decoder output is after latency_trace_track_changed()
+        lt->end = LATENCY_POINT_I2S;
+        lt->decoder_armed = false;
+        lt->i2s_from = -1;
+        break;
+    default:
+        // anything the i2s writer reads from now on is the new state
+        lt->end = LATENCY_POINT_I2S;
+        lt->decoder_armed = true;
+        lt->dec_from = 0;
+        lt->i2s_from = lt->i2s_bytes;
+        break;
+    }
+    portEXIT_CRITICAL(&lt->lock);
+}
+
+void latency_trace_api_done(latency_trace_handle_t lt) {
+    int64_t now = esp_timer_get_time();
+    portENTER_CRITICAL(&lt->lock);
+    mark_locked(lt, LATENCY_POINT_API, now);
+    portEXIT_CRITICAL(&lt->lock);
+}
+
+esp_err_t latency_trace_set_volume_end(latency_trace_handle_t lt, latency_point_t point) {
+    AUDIO_NULL_CHECK(TAG, lt, return ESP_ERR_INVALID_ARG);
+    if (point != LATENCY_POINT_API && point != LATENCY_POINT_GAIN) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    lt->volume_end = point;
+    return ESP_OK;
+}
+
+void latency_trace_gain_applied(latency_trace_handle_t lt) {
+    int64_t now = esp_timer_get_time();
+    portENTER_CRITICAL(&lt->lock);
+    if (lt->active == LATENCY_CMD_VOLUME) {
+        mark_locked(lt, LATENCY_POINT_GAIN, now);
+    }
+    portEXIT_CRITICAL(&lt->lock);
+}
+
+void latency_trace_track_changed(latency_trace_handle_t lt) {
+    // called in the decoder task, which is what moves source_pos and dec_bytes
+    int64_t from = lt->source_pos ? lt->source_pos(lt->source_ctx) - lt->source_base : lt->dec_bytes;
+    portENTER_CRITICAL(&lt->lock);
+    if (lt->active == LATENCY_CMD_NEXT && !(lt->points & POINT_BIT(LATENCY_POINT_DECODER))) {
+        lt->decoder_armed = true;
+        lt->dec_from = from;
+    }
+    portEXIT_CRITICAL(&lt->lock);
+}
+
+esp_err_t latency_trace_get_stats(latency_trace_handle_t lt, latency_cmd_t cmd, latency_stats_t *stats) {
+    AUDIO_NULL_CHECK(TAG, lt, return ESP_ERR_INVALID_ARG);
+    if (cmd < 0 || cmd >= LATENCY_CMD_MAX) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    portENTER_CRITICAL(&lt->lock);
+    *stats = lt->stats[cmd];
+    portEXIT_CRITICAL(&lt->lock);
+    return ESP_OK;
+}
+
+void latency_trace_reset_stats(latency_trace_handle_t lt) {
+    portENTER_CRITICAL(&lt->lock);
+    memset(lt->stats, 0, sizeof(lt->stats));
+    portEXIT_CRITICAL(&lt->lock);
+}
+
+static double point_avg_ms(const latency_stats_t *s, latency_point_t p) {
+    return s->point_count[p] ? s->point_sum_us[p] / 1000.0 / s->point_count[p] : 0;
+}
+
+void latency_trace_report(latency_trace_handle_t lt) {
+    for (int cmd = 0; cmd < LATENCY_CMD_MAX; cmd++) {
+        latency_stats_t s;
+        if (latency_trace_get_stats(lt, cmd, &s) != ESP_OK) {
+            continue;
+        }
+        if (s.count == 0) {
+            if (s.dropped) {
+                ESP_LOGI(TAG, "%-6s none completed, %u dropped", cmd_names[cmd], s.dropped);
+            }
+            continue;
+        }
+        ESP_LOGI(TAG, "%-6s n=%u dropped=%u min=%.2f avg=%.2f max=%.2f ms (api %.2f, decoder %.2f, i2s %.2f, gain %.2f)",
+                 cmd_names[cmd], s.count, s.dropped, s.min_us / 1000.0, s.sum_us / 1000.0 / s.count,
+                 s.max_us / 1000.0, point_avg_ms(&s, LATENCY_POINT_API), point_avg_ms(&s, LATENCY_POINT_DECODER),
+                 point_avg_ms(&s, LATENCY_POINT_I2S), point_avg_ms(&s, LATENCY_POINT_GAIN));
+
+        char line[160];
+        int len = 0;
+        for (int i = 0; i < LATENCY_HIST_BUCKETS && len < (int)sizeof(line); i++) {
+            if (i < LATENCY_HIST_BUCKETS - 1) {
+                len += snprintf(line + len, sizeof(line) - len, " <=%d:%u", latency_trace_bucket_ms[i], s.hist[i]);
+            } else {
+                len += snprintf(line + len, sizeof(line) - len, " >%d:%u", latency_trace_bucket_ms[i - 1], s.hist[i]);
+            }
+        }
+        ESP_LOGI(TAG, "%-6s ms%s", cmd_names[cmd], line);
+    }
+}
+
+const char *latency_trace_cmd_name(latency_cmd_t cmd) {
+    return cmd >= 0 && cmd < LATENCY_CMD_MAX ? cmd_names[cmd] : "?";
+}
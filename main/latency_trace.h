@@ -0,0 +1,270 @@
+/* Control latency tracing, from a button event to the first PCM of the new state at the i2s writer
+
+   This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#ifndef _LATENCY_TRACE_H_
+#define _LATENCY_TRACE_H_
+
+#include <stdint.h>
+#include "esp_err.h"
+#include "audio_element.h"
+#include "ringbuf.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Traced player commands
+ */
+typedef enum {
+    LATENCY_CMD_PLAY,       /*!< Run from the init or finished state, ends at the first PCM read by the i2s writer */
+    LATENCY_CMD_PAUSE,      /*!< Ends when audio_pipeline_pause() returns */
+    LATENCY_CMD_RESUME,     /*!< Ends at the first PCM read by the i2s writer */
+    LATENCY_CMD_NEXT,       /*!< Ends at the first PCM of the new track read by the i2s writer */
+    LATENCY_CMD_VOLUME,     /*!< Ends when the codec volume is set, or the software gain applies it, see latency_trace_set_volume_end() */
+    LATENCY_CMD_MAX,
+} latency_cmd_t;
+
+/**
+ * @brief Trace points of a command, timestamps are relative to LATENCY_POINT_EVENT
+ */
+typedef enum {
+    LATENCY_POINT_EVENT,    /*!< The event loop received the input event */
+    LATENCY_POINT_API,      /*!< The pipeline / playlist / codec call returned */
+    LATENCY_POINT_DECODER,  /*!< The decoder wrote its first PCM of the new state */
+    LATENCY_POINT_I2S,      /*!< The i2s writer read the first PCM of the new state */
+    LATENCY_POINT_GAIN,     /*!< The software gain applied the new volume to a block, see latency_trace_gain_applied() */
+    LATENCY_POINT_MAX,
+} latency_point_t;
+
+#define LATENCY_HIST_BUCKETS    (12)
+#define LATENCY_TRACE_MAX_RB    (3)
+
+/**
+ * @brief Latency statistics of one command
+ */
+typedef struct {
+    uint32_t count;                                 /*!< Completed traces */
+    uint32_t dropped;                               /*!< Traces superseded by the next command before completing */
+    int64_t  min_us;
+    int64_t  max_us;
+    int64_t  sum_us;
+    uint32_t point_count[LATENCY_POINT_MAX];        /*!< Completed traces that reached each point */
+    int64_t  point_sum_us[LATENCY_POINT_MAX];       /*!< Sum of event-to-point times */
+    uint32_t hist[LATENCY_HIST_BUCKETS];            /*!< Counts per bucket, see latency_trace_bucket_ms */
+} latency_stats_t;
+
+/**
+ * @brief Upper bound of each histogram bucket in ms, the last bucket is unbounded
+ */
+extern const int latency_trace_bucket_ms[LATENCY_HIST_BUCKETS - 1];
+
+typedef struct latency_trace *latency_trace_handle_t;
+
+/**
+ * @brief Decoder source position: bytes of PCM the input handed to the decoder so far decodes to
+ */
+typedef int64_t (*latency_source_pos_t)(void *ctx);
+
+/**
+ * @brief Decoder output observer
+ *
+ * @param ctx User context
+ * @param pos Source position of buf[0], see latency_trace_set_source()
+ * @param buf PCM the decoder just queued for the i2s writer
+ * @param len Bytes queued
+ */
+typedef void (*latency_output_cb_t)(void *ctx, int64_t pos, const char *buf, int len);
+
+/**
+ * @brief Decoder write gate, called before each block is queued
+ *
+ * @param ctx User context
+ * @param rb  The ring buffer the block goes to
+ * @param len Bytes about to be queued
+ */
+typedef void (*latency_write_gate_t)(void *ctx, ringbuf_handle_t rb, int len);
+
+/**
+ * @brief Create a tracer
+ *
+ * Timestamps come from esp_timer_get_time(); the host build substitutes a
+ * simulated clock that also advances with the audio consumed by its sink.
+ *
+ * @return The tracer, NULL on memory error
+ */
+latency_trace_handle_t latency_trace_create(void);
+
+/**
+ * @brief Destroy the tracer, detach it first
+ */
+void latency_trace_destroy(latency_trace_handle_t lt);
+
+/**
+ * @brief Tap the ring buffer between the decoder and the i2s writer
+ *
+ * Replaces the decoder's output and the i2s writer's input by callbacks that
+ * timestamp the PCM passing through and then access the linked ring buffer
+ * themselves. Call it after the pipeline is linked, and detach before the
+ * pipeline is stopped, terminated or has its ring buffers reset: the element
+ * functions that abort or reset ring buffers only act on ring buffer I/O.
+ * With a resampler in front of the i2s writer, attach to the resampler: the
+ * ring buffer then still holds the decoder's output. LATENCY_POINT_I2S is
+ * when the resampler reads the new state plus the time what is queued in the
+ * ring buffers behind it plays for, see latency_trace_watch_ringbuf().
+ *
+ * @param lt      The tracer
+ * @param decoder The element writing the ring buffer
+ * @param i2s     The element reading the ring buffer, the i2s writer or the resampler in front of it
+ *
+ * @return
+ *     - ESP_OK
+ *     - ESP_FAIL The elements are not linked by a ring buffer
+ */
+esp_err_t latency_trace_attach(latency_trace_handle_t lt, audio_element_handle_t decoder, audio_element_handle_t i2s);
+
+/**
+ * @brief Count a ring buffer between the traced reader and the i2s writer; at most LATENCY_TRACE_MAX_RB
+ *
+ * When the reader (e.g. a resampler) reads the new state, the PCM queued in
+ * these ring buffers plays first: LATENCY_POINT_I2S is moved later by its
+ * duration, in the format el writes, so it stays the time the new state
+ * reaches the i2s writer. Watch them in any order before tracing.
+ *
+ * @param lt The tracer
+ * @param rb The ring buffer
+ * @param el The element writing it, whose music info is the PCM format in it
+ *
+ * @return
+ *     - ESP_OK
+ *     - ESP_ERR_INVALID_ARG
+ */
+esp_err_t latency_trace_watch_ringbuf(latency_trace_handle_t lt, ringbuf_handle_t rb, audio_element_handle_t el);
+
+/**
+ * @brief Locate track changes in the decoder output from the source position
+ *
+ * Without a source the first decoder output after latency_trace_track_changed()
+ * is taken as the new track, which is early by whatever the decoder still
+ * buffers of the old one. The position is sampled at every attach, when the
+ * decoder is expected to be empty, so attach after resetting the pipeline.
+ *
+ * @param lt  The tracer
+ * @param fn  Source position, e.g. playlist_get_pcm_pos(); NULL to disable
+ * @param ctx Context of fn
+ */
+void latency_trace_set_source(latency_trace_handle_t lt, latency_source_pos_t fn, void *ctx);
+
+/**
+ * @brief Pass the decoder output on to another consumer, e.g. pcm_cache_decoder_output()
+ *
+ * The tracer owns the decoder's write callback, so anything else that needs
+ * to see the PCM hooks in here. The observer runs in the decoder task after
+ * each block has been queued, so time spent blocked on a full ring buffer is
+ * not between two calls.
+ *
+ * @param lt  The tracer
+ * @param fn  Observer, NULL to remove it
+ * @param ctx Context of fn
+ */
+void latency_trace_set_output_cb(latency_trace_handle_t lt, latency_output_cb_t fn, void *ctx);
+
+/**
+ * @brief Hold the decoder back before it queues a block, e.g. adaptive_buffer_wait_room()
+ *
+ * The gate runs in the decoder task; the time it takes counts as waiting
+ * for room, see latency_trace_get_write_wait_us().
+ *
+ * @param lt  The tracer
+ * @param fn  Gate, NULL to remove it
+ * @param ctx Context of fn
+ */
+void latency_trace_set_write_gate(latency_trace_handle_t lt, latency_write_gate_t fn, void *ctx);
+
+/**
+ * @brief Time the block just passed to the output observer spent in the gate and rb_write(), waiting for room
+ *
+ * Only meaningful from within the observer, which runs in the decoder task.
+ */
+int64_t latency_trace_get_write_wait_us(latency_trace_handle_t lt);
+
+/**
+ * @brief Give the ring buffer back to the elements
+ */
+esp_err_t latency_trace_detach(latency_trace_handle_t lt);
+
+/**
+ * @brief Start tracing a command, call it as soon as the event is received
+ *
+ * A command still in flight is counted as dropped.
+ */
+void latency_trace_begin(latency_trace_handle_t lt, latency_cmd_t cmd);
+
+/**
+ * @brief Start tracing a command whose event was received at event_us (esp_timer time), e.g. one an input
+ *        dispatcher held back to coalesce it with the ones after
+ */
+void latency_trace_begin_at(latency_trace_handle_t lt, latency_cmd_t cmd, int64_t event_us);
+
+/**
+ * @brief Mark LATENCY_POINT_API for the command in flight, after the call that carries it out
+ */
+void latency_trace_api_done(latency_trace_handle_t lt);
+
+/**
+ * @brief Where a volume command ends: LATENCY_POINT_API (the default) for the codec, LATENCY_POINT_GAIN for a software gain
+ *
+ * @return
+ *     - ESP_OK
+ *     - ESP_ERR_INVALID_ARG
+ */
+esp_err_t latency_trace_set_volume_end(latency_trace_handle_t lt, latency_point_t point);
+
+/**
+ * @brief Mark LATENCY_POINT_GAIN, from the gain element's task when it applies a new volume (sw_gain_set_applied_cb())
+ */
+void latency_trace_gain_applied(latency_trace_handle_t lt);
+
+/**
+ * @brief Tell the tracer that the decoder input moved to a new track
+ *
+ * Called from the decoder's read context (e.g. a playlist track callback),
+ * before the first byte of the new track is handed to the decoder.
+ */
+void latency_trace_track_changed(latency_trace_handle_t lt);
+
+/**
+ * @brief Copy the statistics of a command
+ *
+ * @return
+ *     - ESP_OK
+ *     - ESP_ERR_INVALID_ARG
+ */
+esp_err_t latency_trace_get_stats(latency_trace_handle_t lt, latency_cmd_t cmd, latency_stats_t *stats);
+
+/**
+ * @brief Clear all statistics
+ */
+void latency_trace_reset_stats(latency_trace_handle_t lt);
+
+/**
+ * @brief Log the statistics and histograms of all commands
+ */
+void latency_trace_report(latency_trace_handle_t lt);
+
+/**
+ * @brief Name of a command
+ */
+const char *latency_trace_cmd_name(latency_cmd_t cmd);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,437 @@
+/* Append-only record log on a raw flash partition: batched in RAM, written in whole pages, CRC framed
+
+   This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_rom_crc.h"
+#include "audio_mem.h"
+#include "audio_error.h"
+#include "log_store.h"
+
+static const char *TAG = "LOG_STORE";
+
+#define PAGE_MAGIC      0x474C      // "LG"
+#define RECORD_HEADER   2           // type, len
+#define NO_PAGE         UINT32_MAX
+
+/**
+ * @brief Head of every page; a page is programmed once, erased pages read 0xFF
+ */
+typedef struct {
+    uint32_t seq;
+    uint16_t used;                  // bytes of records after the header
+    uint16_t magic;
+    uint32_t crc;                   // of seq, used and magic, and the records
+} page_header_t;
+
+struct log_store {
+    log_store_cfg_t cfg;
+    SemaphoreHandle_t lock;
+    uint32_t num_pages;
+    uint32_t pages_per_sector;
+    uint8_t *batch;                 // batch_pages pages, the closed ones first, then the open one
+    int batch_used;                 // closed pages
+    size_t fill;                    // bytes of records in the open page, 0 if none is open
+    uint32_t wr_page;               // where the next page is programmed
+    uint32_t seq;                   // of the next page closed
+    uint32_t head_page;             // newest page on flash, NO_PAGE if none
+    int64_t pending_us;             // oldest batched record, 0 if none
+    log_store_stats_t stats;
+};
+
+struct log_store_iter {
+    log_store_handle_t ls;
+    uint8_t *buf;                   // one sector
+    uint32_t sector;
+    uint32_t sectors_left;
+    bool loaded;
+    uint32_t page;
+    size_t used;                    // of the current page, 0 if it has no records to return
+    size_t off;
+    bool any;
+    uint32_t last_seq;
+};
+
+typedef struct {
+    log_store_handle_t ls;
+    size_t addr;
+    size_t size;
+} io_window_t;
+
+static esp_err_t run_window(flash_op_t op, size_t addr, void *buf, size_t size, void *ctx) {
+    io_window_t *w = (io_window_t *)ctx;
+    return w->ls->cfg.io(op, w->addr, buf, w->size, w->ls->cfg.io_ctx);
+}
+
+/**
+ * @brief One flash operation of at most a sector; through the arbiter it runs in one window sized for a sector
+ */
+static esp_err_t flash_io(log_store_handle_t ls, flash_op_t op, size_t addr, void *buf, size_t size) {
+    if (!ls->cfg.arbiter) {
+        return ls->cfg.io(op, addr, buf, size, ls->cfg.io_ctx);
+    }
+    io_window_t w = {ls, addr, size};
+    return flash_arbiter_run(ls->cfg.arbiter, op, addr, buf, ls->cfg.sector_size, run_window, &w);
+}
+
+static bool seq_newer(uint32_t a, uint32_t b) {
+    return (int32_t)(a - b) > 0;
+}
+
+static bool page_erased(const uint8_t *page, size_t size) {
+    for (size_t i = 0; i < size; i++) {
+        if (page[i] != 0xFF) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static uint32_t page_crc(const uint8_t *page, size_t used) {
+    uint32_t crc = esp_rom_crc32_le(0, page, offsetof(page_header_t, crc));
+    return esp_rom_crc32_le(crc, page + sizeof(page_header_t), used);
+}
+
+/**
+ * @brief Whether the page holds records that passed their CRC; hdr is filled in either way
+ */
+static bool page_valid(const uint8_t *page, size_t page_size, page_header_t *hdr) {
+    memcpy(hdr, page, sizeof(*hdr));
+    return hdr->magic == PAGE_MAGIC && hdr->used <= page_size - sizeof(page_header_t)
+           && hdr->crc == page_crc(page, hdr->used);
+}
+
+size_t log_store_max_record(log_store_handle_t ls) {
+    size_t max = ls->cfg.page_size - sizeof(page_header_t) - RECORD_HEADER;
+    return max < UINT8_MAX ? max : UINT8_MAX;
+}
+
+/**
+ * @brief Find the newest page and the first page after it that can be programmed
+ */
+static esp_err_t scan(log_store_handle_t ls, uint8_t *buf) {
+    size_t ps = ls->cfg.page_size;
+    uint32_t num_sectors = ls->num_pages / ls->pages_per_sector;
+    uint32_t head_seq = 0;
+    for (uint32_t s = 0; s < num_sectors; s++) {
+        esp_err_t err = flash_io(ls, FLASH_OP_READ, s * ls->cfg.sector_size, buf, ls->cfg.sector_size);
+        if (err != ESP_OK) {
+            return err;
+        }
+        for (uint32_t p = 0; p < ls->pages_per_sector; p++) {
+            page_header_t hdr;
+            const uint8_t *page = buf + p * ps;
+            if (page_valid(page, ps, &hdr)) {
+                if (ls->head_page == NO_PAGE || seq_newer(hdr.seq, head_seq)) {
+                    ls->head_page = s * ls->pages_per_sector + p;
+                    head_seq = hdr.seq;
+                }
+            } else if (!page_erased(page, ps)) {
+                ls->stats.torn++;
+            }
+        }
+    }
+    if (ls->head_page == NO_PAGE) {
+        // a blank or foreign partition, sector 0 is erased before the first page
+        ls->wr_page = 0;
+        ls->seq = 1;
+        return ESP_OK;
+    }
+    ls->seq = head_seq + 1;
+    // the pages after the newest one that a power loss left half programmed are skipped
+    uint32_t s = ls->head_page / ls->pages_per_sector;
+    esp_err_t err = flash_io(ls, FLASH_OP_READ, s * ls->cfg.sector_size, buf, ls->cfg.sector_size);
+    if (err != ESP_OK) {
+        return err;
+    }
+    uint32_t first = ls->head_page % ls->pages_per_sector + 1;
+    uint32_t p = ls->pages_per_sector;
+    while (p > first && page_erased(buf + (p - 1) * ps, ps)) {
+        p--;
+    }
+    ls->wr_page = p < ls->pages_per_sector ? s * ls->pages_per_sector + p
+                                           : (s + 1) % num_sectors * ls->pages_per_sector;
+    return ESP_OK;
+}
+
+log_store_handle_t log_store_open(const log_store_cfg_t *cfg) {
+    AUDIO_NULL_CHECK(TAG, cfg && cfg->io, return NULL);
+    if (cfg->page_size <= sizeof(page_header_t) + RECORD_HEADER || cfg->sector_size % cfg->page_size
+        || !cfg->size || cfg->size % cfg->sector_size || cfg->batch_pages <= 0) {
+        ESP_LOGE(TAG, "invalid config, %d bytes, sectors of %d, pages of %d", (int)cfg->size, (int)cfg->sector_size,
+                 (int)cfg->page_size);
+        return NULL;
+    }
+    log_store_handle_t ls = audio_calloc(1, sizeof(struct log_store));
+    AUDIO_MEM_CHECK(TAG, ls, return NULL);
+    uint8_t *buf = NULL;
+    ls->cfg = *cfg;
+    ls->num_pages = cfg->size / cfg->page_size;
+    ls->pages_per_sector = cfg->sector_size / cfg->page_size;
+    ls->head_page = NO_PAGE;
+    ls->batch = audio_malloc(cfg->batch_pages * cfg->page_size);
+    ls->lock = xSemaphoreCreateMutex();
+    buf = audio_malloc(cfg->sector_size);
+    AUDIO_MEM_CHECK(TAG, ls->batch && ls->lock && buf, goto _fail);
+    esp_err_t err = scan(ls, buf);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "failed to read the partition, %s", esp_err_to_name(err));
+        goto _fail;
+    }
+    audio_free(buf);
+    ESP_LOGI(TAG, "%d KiB, next page %u seq %u, %u torn pages", (int)(cfg->size / 1024), ls->wr_page, ls->seq,
+             ls->stats.torn);
+    return ls;
+
+_fail:
+    audio_free(buf);
+    log_store_close(ls);
+    return NULL;
+}
+
+void log_store_close(log_store_handle_t ls) {
+    if (!ls) {
+        return;
+    }
+    if (ls->lock) {
+        vSemaphoreDelete(ls->lock);
+    }
+    audio_free(ls->batch);
+    audio_free(ls);
+}
+
+static void close_page(log_store_handle_t ls) {
+    uint8_t *page = ls->batch + ls->batch_used * ls->cfg.page_size;
+    page_header_t hdr = {
+        .seq = ls->seq++,
+        .used = ls->fill,
+        .magic = PAGE_MAGIC,
+    };
+    memcpy(page, &hdr, sizeof(hdr));
+    hdr.crc = page_crc(page, ls->fill);
+    memcpy(page, &hdr, sizeof(hdr));
+    ls->batch_used++;
+    ls->fill = 0;
+}
+
+/**
+ * @brief Program the closed pages, erasing each sector as the log enters it; locked, no page open
+ */
+static esp_err_t write_batch(log_store_handle_t ls) {
+    size_t ps = ls->cfg.page_size;
+    int done = 0;
+    esp_err_t err = ESP_OK;
+    while (done < ls->batch_used) {
+        uint32_t in_sector = ls->wr_page % ls->pages_per_sector;
+        if (in_sector == 0) {
+            err = flash_io(ls, FLASH_OP_ERASE, ls->wr_page * ps, NULL, ls->cfg.sector_size);
+            if (err != ESP_OK) {
+                break;
+            }
+            ls->stats.erases++;
+        }
+        int n = ls->batch_used - done;
+        n = n < ls->pages_per_sector - in_sector ? n : ls->pages_per_sector - in_sector;
+        err = flash_io(ls, FLASH_OP_WRITE, ls->wr_page * ps, ls->batch + done * ps, n * ps);
+        if (err != ESP_OK) {
+            // what the pages hold now is unknown, they fail their CRC; the batch goes to the next ones
+            ls->wr_page = (ls->wr_page + n) % ls->num_pages;
+            break;
+        }
+        ls->head_page = ls->wr_page + n - 1;
+        ls->wr_page = (ls->wr_page + n) % ls->num_pages;
+        ls->stats.pages += n;
+        ls->stats.flash_bytes += n * ps;
+        done += n;
+    }
+    if (done) {
+        memmove(ls->batch, ls->batch + done * ps, (ls->batch_used - done) * ps);
+        ls->batch_used -= done;
+    }
+    ls->stats.flushes++;
+    if (err != ESP_OK) {
+        ls->stats.errors++;
+        ESP_LOGW(TAG, "failed to write %d pages, %s", ls->batch_used, esp_err_to_name(err));
+    }
+    return err;
+}
+
+esp_err_t log_store_append(log_store_handle_t ls, uint8_t type, const void *data, size_t len) {
+    AUDIO_NULL_CHECK(TAG, ls && (data || !len), return ESP_ERR_INVALID_ARG);
+    if (len > log_store_max_record(ls)) {
+        ls->stats.rejected++;
+        return ESP_ERR_INVALID_SIZE;
+    }
+    esp_err_t err = ESP_OK;
+    size_t ps = ls->cfg.page_size;
+    xSemaphoreTake(ls->lock, portMAX_DELAY);
+    if (ls->fill && sizeof(page_header_t) + ls->fill + RECORD_HEADER + len > ps) {
+        close_page(ls);
+    }
+    if (!ls->fill && ls->batch_used == ls->cfg.batch_pages) {
+        // the last write of a full batch failed
+        err = write_batch(ls);
+    }
+    if (ls->batch_used < ls->cfg.batch_pages) {
+        uint8_t *page = ls->batch + ls->batch_used * ps;
+        if (!ls->fill) {
+            memset(page, 0xFF, ps);
+        }
+        uint8_t *rec = page + sizeof(page_header_t) + ls->fill;
+        rec[0] = type;
+        rec[1] = len;
+        memcpy(rec + RECORD_HEADER, data, len);
+        ls->fill += RECORD_HEADER + len;
+        ls->stats.records++;
+        ls->stats.record_bytes += len;
+        if (!ls->pending_us) {
+            ls->pending_us = esp_timer_get_time();
+        }
+        err = ESP_OK;
+        if (sizeof(page_header_t) + ls->fill + RECORD_HEADER > ps) {
+            close_page(ls);
+        }
+        if (ls->batch_used == ls->cfg.batch_pages) {
+            err = write_batch(ls);
+        }
+    }
+    xSemaphoreGive(ls->lock);
+    return err;
+}
+
+static esp_err_t sync_locked(log_store_handle_t ls) {
+    if (ls->fill) {
+        close_page(ls);
+    }
+    esp_err_t err = ls->batch_used ? write_batch(ls) : ESP_OK;
+    if (err == ESP_OK) {
+        ls->pending_us = 0;
+    }
+    return err;
+}
+
+esp_err_t log_store_sync(log_store_handle_t ls) {
+    AUDIO_NULL_CHECK(TAG, ls, return ESP_ERR_INVALID_ARG);
+    xSemaphoreTake(ls->lock, portMAX_DELAY);
+    esp_err_t err = sync_locked(ls);
+    xSemaphoreGive(ls->lock);
+    return err;
+}
+
+esp_err_t log_store_flush_expired(log_store_handle_t ls) {
+    AUDIO_NULL_CHECK(TAG, ls, return ESP_ERR_INVALID_ARG);
+    esp_err_t err = ESP_OK;
+    xSemaphoreTake(ls->lock, portMAX_DELAY);
+    if (ls->pending_us && esp_timer_get_time() - ls->pending_us >= ls->cfg.flush_interval_ms * 1000LL) {
+        err = sync_locked(ls);
+    }
+    xSemaphoreGive(ls->lock);
+    return err;
+}
+
+log_store_iter_handle_t log_store_iter_create(log_store_handle_t ls) {
+    AUDIO_NULL_CHECK(TAG, ls, return NULL);
+    log_store_iter_handle_t it = audio_calloc(1, sizeof(struct log_store_iter));
+    AUDIO_MEM_CHECK(TAG, it, return NULL);
+    it->buf = audio_malloc(ls->cfg.sector_size);
+    AUDIO_MEM_CHECK(TAG, it->buf, {
+        audio_free(it);
+        return NULL;
+    });
+    it->ls = ls;
+    uint32_t num_sectors = ls->num_pages / ls->pages_per_sector;
+    xSemaphoreTake(ls->lock, portMAX_DELAY);
+    // the sector after the newest page's holds the oldest records
+    it->sector = ls->head_page == NO_PAGE ? 0 : (ls->head_page / ls->pages_per_sector + 1) % num_sectors;
+    it->sectors_left = ls->head_page == NO_PAGE ? 0 : num_sectors;
+    xSemaphoreGive(ls->lock);
+    return it;
+}
+
+void log_store_iter_destroy(log_store_iter_handle_t it) {
+    if (it) {
+        audio_free(it->buf);
+        audio_free(it);
+    }
+}
+
+esp_err_t log_store_iter_next(log_store_iter_handle_t it, log_record_t *rec) {
+    AUDIO_NULL_CHECK(TAG, it && rec, return ESP_ERR_INVALID_ARG);
+    log_store_handle_t ls = it->ls;
+    size_t ps = ls->cfg.page_size;
+    for (;;) {
+        if (!it->loaded) {
+            if (!it->sectors_left) {
+                return ESP_ERR_NOT_FOUND;
+            }
+            esp_err_t err = flash_io(ls, FLASH_OP_READ, it->sector * ls->cfg.sector_size, it->buf,
+                                     ls->cfg.sector_size);
+            if (err != ESP_OK) {
+                return err;
+            }
+            it->loaded = true;
+            it->page = 0;
+            it->used = 0;
+            it->off = 0;
+        }
+        while (it->page < ls->pages_per_sector) {
+            const uint8_t *page = it->buf + it->page * ps;
+            if (!it->used) {
+                page_header_t hdr;
+                // a page written again after a failed write, or overtaken by the log since, is skipped
+                if (page_valid(page, ps, &hdr) && hdr.used && (!it->any || seq_newer(hdr.seq, it->last_seq))) {
+                    it->used = hdr.used;
+                    it->off = 0;
+                    it->any = true;
+                    it->last_seq = hdr.seq;
+                } else {
+                    it->page++;
+                    continue;
+                }
+            }
+            const uint8_t *r = page + sizeof(page_header_t) + it->off;
+            if (it->off + RECORD_HEADER <= it->used && it->off + RECORD_HEADER + r[1] <= it->used) {
+                rec->type = r[0];
+                rec->len = r[1];
+                rec->data = r + RECORD_HEADER;
+                rec->page_seq = it->last_seq;
+                it->off += RECORD_HEADER + r[1];
+                return ESP_OK;
+            }
+            it->page++;
+            it->used = 0;
+        }
+        it->loaded = false;
+        it->sector = (it->sector + 1) % (ls->num_pages / ls->pages_per_sector);
+        it->sectors_left--;
+    }
+}
+
+void log_store_get_stats(log_store_handle_t ls, log_store_stats_t *stats) {
+    if (ls && stats) {
+        xSemaphoreTake(ls->lock, portMAX_DELAY);
+        *stats = ls->stats;
+        xSemaphoreGive(ls->lock);
+    }
+}
+
+void log_store_report(log_store_handle_t ls) {
+    AUDIO_NULL_CHECK(TAG, ls, return);
+    log_store_stats_t s;
+    log_store_get_stats(ls, &s);
+    ESP_LOGI(TAG, "%u records (%u bytes), %u pages in %u flushes, %u sectors erased, %d flash bytes a record",
+             s.records, s.record_bytes, s.pages, s.flushes, s.erases,
+             s.records ? (int)(s.flash_bytes / s.records) : 0);
+    if (s.rejected || s.errors || s.torn) {
+        ESP_LOGI(TAG, "%u too long, %u write errors, %u torn pages at open", s.rejected, s.errors, s.torn);
+    }
+}
@@ -0,0 +1,140 @@
+/* Append-only record log on a raw flash partition: batched in RAM, written in whole pages, CRC framed
+
+   This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#ifndef _LOG_STORE_H_
+#define _LOG_STORE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "flash_arbiter.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    size_t                  size;               /*!< Bytes of the partition, a multiple of sector_size */
+    size_t                  sector_size;        /*!< Erase unit, a multiple of the arbiter's unit size */
+    size_t                  page_size;          /*!< Program unit, records never span pages */
+    int                     batch_pages;        /*!< Pages held in RAM before they are written */
+    int                     flush_interval_ms;  /*!< Age at which log_store_flush_expired() writes a partial batch */
+    flash_arbiter_handle_t  arbiter;            /*!< Schedules the flash I/O around i2s DMA, NULL to access it directly */
+    flash_arbiter_io_t      io;                 /*!< Reads, programs and erases the partition, addresses from 0 */
+    void                    *io_ctx;
+} log_store_cfg_t;
+
+#define LOG_STORE_CFG_DEFAULT() {       \
+    .size = 0,                          \
+    .sector_size = 4096,                \
+    .page_size = 256,                   \
+    .batch_pages = 4,                   \
+    .flush_interval_ms = 60000,         \
+    .arbiter = NULL,                    \
+    .io = NULL,                         \
+    .io_ctx = NULL,                     \
+}
+
+/**
+ * @brief A record as the iterator returns it
+ */
+typedef struct {
+    uint8_t         type;
+    uint8_t         len;
+    const uint8_t   *data;      /*!< Valid until the next call on the iterator */
+    uint32_t        page_seq;   /*!< Sequence number of the page that holds it, grows with every page written */
+} log_record_t;
+
+typedef struct {
+    uint32_t    records;            /*!< Appended */
+    uint32_t    record_bytes;       /*!< Payload appended */
+    uint32_t    rejected;           /*!< Appends too long for a page */
+    uint32_t    flushes;
+    uint32_t    pages;              /*!< Pages programmed */
+    uint32_t    erases;             /*!< Sectors erased, the oldest records in them are gone */
+    uint64_t    flash_bytes;        /*!< Bytes programmed */
+    uint32_t    torn;               /*!< Pages that failed their CRC at open, cut off by a power loss */
+    uint32_t    errors;
+} log_store_stats_t;
+
+typedef struct log_store *log_store_handle_t;
+typedef struct log_store_iter *log_store_iter_handle_t;
+
+/**
+ * @brief Open the log on the partition, finding where it ends; a blank or foreign partition is an empty log
+ *
+ * Every sector is read once. Pages a power loss cut off fail their CRC and
+ * are skipped, the log goes on after them.
+ *
+ * @return The log, NULL on error
+ */
+log_store_handle_t log_store_open(const log_store_cfg_t *cfg);
+
+/**
+ * @brief Free the log, records still batched are lost: sync first
+ */
+void log_store_close(log_store_handle_t ls);
+
+/**
+ * @brief Append a record to the batch, the batch is written when batch_pages are full
+ *
+ * Once the partition is full the sector holding the oldest records is
+ * erased for the new ones.
+ *
+ * @return
+ *     - ESP_OK
+ *     - ESP_ERR_INVALID_SIZE the record does not fit a page
+ *     - the error of a batch write, the batch is kept and written again with the next one
+ */
+esp_err_t log_store_append(log_store_handle_t ls, uint8_t type, const void *data, size_t len);
+
+/**
+ * @brief Write the batch if its oldest record is flush_interval_ms old; cheap otherwise, call it periodically
+ */
+esp_err_t log_store_flush_expired(log_store_handle_t ls);
+
+/**
+ * @brief Write the batch now; a partly filled page is written as it is, the next record starts a new one
+ */
+esp_err_t log_store_sync(log_store_handle_t ls);
+
+/**
+ * @brief Largest record payload
+ */
+size_t log_store_max_record(log_store_handle_t ls);
+
+/**
+ * @brief Iterate the records on flash from the oldest to the newest; the batch is not included, sync first
+ *
+ * The iterator reads a sector at a time. Records appended while it runs may
+ * or may not be returned, records are never returned twice or torn.
+ *
+ * @return The iterator, NULL on error
+ */
+log_store_iter_handle_t log_store_iter_create(log_store_handle_t ls);
+
+/**
+ * @return
+ *     - ESP_OK rec is the next record
+ *     - ESP_ERR_NOT_FOUND no more records
+ *     - the error of a flash read
+ */
+esp_err_t log_store_iter_next(log_store_iter_handle_t it, log_record_t *rec);
+
+void log_store_iter_destroy(log_store_iter_handle_t it);
+
+void log_store_get_stats(log_store_handle_t ls, log_store_stats_t *stats);
+
+void log_store_report(log_store_handle_t ls);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,269 @@
+/* Memory placement policy: which RAM each pipeline element's buffers and task stack land in
+
+   This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_heap_caps.h"
+#include "soc/soc_memory_layout.h"
+#include "audio_mem.h"
+#include "mem_placement.h"
+
+static const char *TAG = "MEM_PLACEMENT";
+
+static const char *region_name[MEM_REGION_MAX] = {"any", "internal", "dma", "psram"};
+static const char *kind_name[MEM_KIND_MAX] = {"ringbuf", "work", "stack"};
+
+typedef struct {
+    void *ptr;
+    size_t size;
+    uint8_t rule;
+    uint8_t kind;
+    uint8_t region;
+} tracked_t;
+
+static const mem_placement_rule_t *rules;
+static int num_rules;
+static mem_placement_usage_t usage[MEM_PLACEMENT_MAX_RULES];
+static tracked_t tracked[MEM_PLACEMENT_MAX_ALLOCS];
+static int untracked;
+static portMUX_TYPE lock = portMUX_INITIALIZER_UNLOCKED;
+
+// the scope of one task, set and cleared by that task only
+static TaskHandle_t scope_task;
+static int scope_rule = -1;
+static mem_kind_t scope_kind;
+static int link_rules[MEM_PLACEMENT_MAX_RULES];
+static int link_num;
+static int link_next;
+
+void *__real_audio_malloc(size_t size);
+void *__real_audio_calloc(size_t nmemb, size_t size);
+void __real_audio_free(void *ptr);
+
+static int find_rule(const char *tag) {
+    if (!tag) {
+        return -1;
+    }
+    for (int i = 0; i < num_rules; i++) {
+        if (!strcmp(rules[i].tag, tag)) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/**
+ * @brief Rule and kind of an allocation by the calling task, -1 if it is none of ours
+ */
+static int owner(size_t size, mem_kind_t *kind) {
+    if (!num_rules) {
+        return -1;
+    }
+    TaskHandle_t self = xTaskGetCurrentTaskHandle();
+    if (self == scope_task) {
+        if (link_num) {
+            if (link_next >= link_num) {
+                return -1;
+            }
+            *kind = MEM_KIND_RINGBUF;
+            int rule = link_rules[link_next];
+            if (size >= MEM_PLACEMENT_RB_MIN) {
+                link_next++;
+            }
+            return rule;
+        }
+        *kind = scope_kind;
+        return scope_rule;
+    }
+    // an element task, named after its tag
+    *kind = MEM_KIND_WORK;
+    return find_rule(pcTaskGetTaskName(NULL));
+}
+
+static uint32_t region_caps(mem_region_t region) {
+    switch (region) {
+        case MEM_REGION_INTERNAL:
+            return MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT;
+        case MEM_REGION_DMA:
+            return MALLOC_CAP_DMA | MALLOC_CAP_8BIT;
+        case MEM_REGION_PSRAM:
+            return MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT;
+        default:
+            return 0;
+    }
+}
+
+static mem_region_t wanted(int rule, mem_kind_t kind) {
+    switch (kind) {
+        case MEM_KIND_RINGBUF:
+            return rules[rule].ringbuf;
+        case MEM_KIND_STACK:
+            return rules[rule].stack;
+        default:
+            return rules[rule].work;
+    }
+}
+
+static void *placed_alloc(size_t size, bool zero) {
+    mem_kind_t kind;
+    int rule = owner(size, &kind);
+    if (rule < 0) {
+        return zero ? __real_audio_calloc(1, size) : __real_audio_malloc(size);
+    }
+    mem_region_t want = wanted(rule, kind);
+    void *p = NULL;
+    if (want != MEM_REGION_ANY) {
+        p = zero ? heap_caps_calloc(1, size, region_caps(want)) : heap_caps_malloc(size, region_caps(want));
+    }
+    bool fallback = false;
+    mem_region_t got = want;
+    if (!p) {
+        fallback = want != MEM_REGION_ANY;
+        p = zero ? __real_audio_calloc(1, size) : __real_audio_malloc(size);
+        if (!p) {
+            return NULL;
+        }
+        got = esp_ptr_external_ram(p) ? MEM_REGION_PSRAM : MEM_REGION_INTERNAL;
+    }
+    portENTER_CRITICAL(&lock);
+    usage[rule].bytes[kind][got] += size;
+    usage[rule].fallbacks += fallback;
+    int i = 0;
+    while (i < MEM_PLACEMENT_MAX_ALLOCS && tracked[i].ptr) {
+        i++;
+    }
+    if (i < MEM_PLACEMENT_MAX_ALLOCS) {
+        tracked[i] = (tracked_t) {
+            .ptr = p, .size = size, .rule = rule, .kind = kind, .region = got,
+        };
+    } else {
+        // its free will not show in the report
+        untracked++;
+    }
+    portEXIT_CRITICAL(&lock);
+    return p;
+}
+
+void *__wrap_audio_malloc(size_t size) {
+    return placed_alloc(size, false);
+}
+
+void *__wrap_audio_calloc(size_t nmemb, size_t size) {
+    return placed_alloc(nmemb * size, true);
+}
+
+void __wrap_audio_free(void *ptr) {
+    if (ptr && num_rules) {
+        portENTER_CRITICAL(&lock);
+        for (int i = 0; i < MEM_PLACEMENT_MAX_ALLOCS; i++) {
+            if (tracked[i].ptr == ptr) {
+                usage[tracked[i].rule].bytes[tracked[i].kind][tracked[i].region] -= tracked[i].size;
+                tracked[i].ptr = NULL;
+                break;
+            }
+        }
+        portEXIT_CRITICAL(&lock);
+    }
+    __real_audio_free(ptr);
+}
+
+esp_err_t mem_placement_init(const mem_placement_rule_t *r, int n) {
+    if (n < 0 || n > MEM_PLACEMENT_MAX_RULES || (n && !r)) {
+        ESP_LOGE(TAG, "%d rules, at most %d", n, MEM_PLACEMENT_MAX_RULES);
+        return ESP_ERR_INVALID_ARG;
+    }
+    portENTER_CRITICAL(&lock);
+    rules = r;
+    num_rules = n;
+    memset(usage, 0, sizeof(usage));
+    memset(tracked, 0, sizeof(tracked));
+    untracked = 0;
+    portEXIT_CRITICAL(&lock);
+    return ESP_OK;
+}
+
+bool mem_placement_stack_in_ext(const char *tag, int stack_size, bool dflt) {
+    int rule = find_rule(tag);
+    if (rule < 0) {
+        return dflt;
+    }
+    bool ext = rules[rule].stack == MEM_REGION_ANY ? dflt : rules[rule].stack == MEM_REGION_PSRAM;
+    // audio_thread_create() only honours it with stacks in PSRAM enabled
+    ext = ext && audio_mem_spiram_stack_is_enabled();
+    portENTER_CRITICAL(&lock);
+    memset(usage[rule].bytes[MEM_KIND_STACK], 0, sizeof(usage[rule].bytes[MEM_KIND_STACK]));
+    usage[rule].bytes[MEM_KIND_STACK][ext ? MEM_REGION_PSRAM : MEM_REGION_INTERNAL] = stack_size;
+    portEXIT_CRITICAL(&lock);
+    return ext;
+}
+
+void mem_placement_begin(const char *tag, mem_kind_t kind) {
+    scope_rule = find_rule(tag);
+    scope_kind = kind;
+    link_num = 0;
+    scope_task = xTaskGetCurrentTaskHandle();
+}
+
+void mem_placement_begin_link(const char *const *tags, int num_tags) {
+    link_num = 0;
+    link_next = 0;
+    for (int i = 0; i < num_tags && link_num < MEM_PLACEMENT_MAX_RULES; i++) {
+        // no rule, no tracking: the ring buffer is placed by audio_malloc()
+        link_rules[link_num++] = find_rule(tags[i]);
+    }
+    scope_rule = -1;
+    scope_task = xTaskGetCurrentTaskHandle();
+}
+
+void mem_placement_end(void) {
+    scope_task = NULL;
+    scope_rule = -1;
+    link_num = 0;
+}
+
+esp_err_t mem_placement_get_usage(const char *tag, mem_placement_usage_t *u) {
+    int rule = find_rule(tag);
+    if (rule < 0 || !u) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    portENTER_CRITICAL(&lock);
+    *u = usage[rule];
+    portEXIT_CRITICAL(&lock);
+    return ESP_OK;
+}
+
+void mem_placement_report(void) {
+    size_t total[MEM_REGION_MAX] = {0};
+    ESP_LOGI(TAG, "%-10s %-8s %-9s %9s %9s %9s", "element", "kind", "wanted", "internal", "dma", "psram");
+    for (int r = 0; r < num_rules; r++) {
+        portENTER_CRITICAL(&lock);
+        mem_placement_usage_t u = usage[r];
+        portEXIT_CRITICAL(&lock);
+        for (int k = 0; k < MEM_KIND_MAX; k++) {
+            ESP_LOGI(TAG, "%-10s %-8s %-9s %9u %9u %9u", rules[r].tag, kind_name[k], region_name[wanted(r, k)],
+                     (unsigned)(u.bytes[k][MEM_REGION_INTERNAL] + u.bytes[k][MEM_REGION_ANY]),
+                     (unsigned)u.bytes[k][MEM_REGION_DMA], (unsigned)u.bytes[k][MEM_REGION_PSRAM]);
+            for (int g = 0; g < MEM_REGION_MAX; g++) {
+                total[g] += u.bytes[k][g];
+            }
+        }
+        if (u.fallbacks) {
+            ESP_LOGW(TAG, "%-10s %d allocations did not fit where wanted", rules[r].tag, u.fallbacks);
+        }
+    }
+    ESP_LOGI(TAG, "%-10s %-8s %-9s %9u %9u %9u", "total", "", "", (unsigned)(total[MEM_REGION_INTERNAL] + total[MEM_REGION_ANY]),
+             (unsigned)total[MEM_REGION_DMA], (unsigned)total[MEM_REGION_PSRAM]);
+    ESP_LOGI(TAG, "%-10s %-8s %-9s %9u %9u %9u", "heap free", "", "", (unsigned)heap_caps_get_free_size(MALLOC_CAP_INTERNAL),
+             (unsigned)heap_caps_get_free_size(MALLOC_CAP_DMA), (unsigned)heap_caps_get_free_size(MALLOC_CAP_SPIRAM));
+    if (untracked) {
+        ESP_LOGW(TAG, "%d allocations over MEM_PLACEMENT_MAX_ALLOCS, their frees are not counted", untracked);
+    }
+}
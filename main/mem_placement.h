@@ -0,0 +1,118 @@
+/* Memory placement policy: which RAM each pipeline element's buffers and task stack land in
+
+   This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#ifndef _MEM_PLACEMENT_H_
+#define _MEM_PLACEMENT_H_
+
+#include <stddef.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define MEM_PLACEMENT_MAX_RULES     (8)
+#define MEM_PLACEMENT_MAX_ALLOCS    (96)    /*!< Live allocations tracked for the report */
+#define MEM_PLACEMENT_RB_MIN        (1024)  /*!< Smallest ring buffer, see mem_placement_begin_link() */
+
+typedef enum {
+    MEM_REGION_ANY = 0,     /*!< Where audio_malloc() puts it: PSRAM when CONFIG_SPIRAM_BOOT_INIT, else internal */
+    MEM_REGION_INTERNAL,    /*!< Internal DRAM */
+    MEM_REGION_DMA,         /*!< DMA-capable internal DRAM */
+    MEM_REGION_PSRAM,       /*!< External PSRAM */
+    MEM_REGION_MAX,
+} mem_region_t;
+
+typedef enum {
+    MEM_KIND_RINGBUF = 0,   /*!< The element's output ring buffer */
+    MEM_KIND_WORK,          /*!< Everything else it allocates: the element, its buffer, decoder state */
+    MEM_KIND_STACK,         /*!< Its task stack */
+    MEM_KIND_MAX,
+} mem_kind_t;
+
+/**
+ * @brief Placement of one element, by the tag it is registered to the pipeline with
+ */
+typedef struct {
+    const char   *tag;
+    mem_region_t ringbuf;
+    mem_region_t work;
+    mem_region_t stack;     /*!< INTERNAL or DMA keep it internal, PSRAM needs CONFIG_SPIRAM_ALLOW_STACK_EXTERNAL_MEMORY */
+} mem_placement_rule_t;
+
+/**
+ * @brief Bytes an element holds, by kind and by the region they actually landed in
+ */
+typedef struct {
+    size_t bytes[MEM_KIND_MAX][MEM_REGION_MAX];
+    int    fallbacks;       /*!< Allocations the wanted region had no room for, placed by audio_malloc() instead */
+} mem_placement_usage_t;
+
+/**
+ * @brief Set the policy, before any of the elements is created
+ *
+ * audio_malloc(), audio_calloc() and audio_free() are wrapped at link time
+ * (-Wl,--wrap), so the allocations ADF itself makes for an element follow
+ * the rule: ring buffers created by audio_pipeline_link() and everything
+ * the element allocates inside a mem_placement_begin() scope or from its
+ * own task, which ADF names after the tag. Allocations outside both pass
+ * through untouched. The rules are not copied.
+ *
+ * @return ESP_OK, ESP_ERR_INVALID_ARG for more than MEM_PLACEMENT_MAX_RULES
+ */
+esp_err_t mem_placement_init(const mem_placement_rule_t *rules, int num_rules);
+
+/**
+ * @brief The stack_in_ext to configure an element with, recording its stack for the report
+ *
+ * @param tag        Element tag
+ * @param stack_size Its task_stack
+ * @param dflt       stack_in_ext of its default config, used without a rule or for MEM_REGION_ANY
+ */
+bool mem_placement_stack_in_ext(const char *tag, int stack_size, bool dflt);
+
+/**
+ * @brief Allocations of the calling task belong to tag, as kind, until mem_placement_end()
+ *
+ * Wrap the element's *_init() in it. One scope at a time, from one task.
+ */
+void mem_placement_begin(const char *tag, mem_kind_t kind);
+
+/**
+ * @brief Allocations of the calling task are the ring buffers audio_pipeline_link() creates for tags
+ *
+ * The output ring buffer of tags[i] is the i-th allocation of at least
+ * MEM_PLACEMENT_RB_MIN bytes; the bookkeeping allocated just before each
+ * goes with it.
+ */
+void mem_placement_begin_link(const char *const *tags, int num_tags);
+
+/**
+ * @brief End the scope
+ */
+void mem_placement_end(void);
+
+/**
+ * @brief What an element holds now
+ *
+ * @return ESP_OK, ESP_ERR_NOT_FOUND without a rule for tag
+ */
+esp_err_t mem_placement_get_usage(const char *tag, mem_placement_usage_t *usage);
+
+/**
+ * @brief Log bytes per region per element and kind, with the free heap of each region
+ */
+void mem_placement_report(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
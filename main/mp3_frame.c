@@ -0,0 +1,109 @@
+/* MP3 frame header parsing
+
+   This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#include <stddef.h>
+#include "mp3_frame.h"
+
+static const uint16_t bitrate_v1_l3[16] = {
+    0, 32, 40, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320, 0
+};
+
+static const uint16_t bitrate_v2_l3[16] = {
+    0, 8, 16, 24, 32, 40, 48, 56, 64, 80, 96, 112, 128, 144, 160, 0
+};
+
+static const uint16_t sample_rates[3][3] = {
+    {44100, 48000, 32000},  // MPEG1
+    {22050, 24000, 16000},  // MPEG2
+    {11025, 12000, 8000},   // MPEG2.5
+};
+
+int mp3_frame_parse_header(const uint8_t *hdr, mp3_frame_info_t *info) {
+    if (hdr[0] != 0xFF || (hdr[1] & 0xE0) != 0xE0) {
+        return 0;
+    }
+    int version_bits = (hdr[1] >> 3) & 0x03;
+    int layer_bits = (hdr[1] >> 1) & 0x03;
+    int bitrate_idx = (hdr[2] >> 4) & 0x0F;
+    int rate_idx = (hdr[2] >> 2) & 0x03;
+    int padding = (hdr[2] >> 1) & 0x01;
+    int mode = (hdr[3] >> 6) & 0x03;
+
+    // layer III only, no free format
+    if (version_bits == 1 || layer_bits != 1 || bitrate_idx == 0 || bitrate_idx == 15 || rate_idx == 3) {
+        return 0;
+    }
+
+    int version, row;
+    switch (version_bits) {
+    case 3:
+        version = 10;
+        row = 0;
+        break;
+    case 2:
+        version = 20;
+        row = 1;
+        break;
+    default:
+        version = 25;
+        row = 2;
+        break;
+    }
+    int bitrate = (version == 10 ? bitrate_v1_l3 : bitrate_v2_l3)[bitrate_idx];
+    int sample_rate = sample_rates[row][rate_idx];
+    int samples = version == 10 ? 1152 : 576;
+    int frame_bytes = (samples / 8) * bitrate * 1000 / sample_rate + padding;
+
+    if (info) {
+        info->version = version;
+        info->bitrate_kbps = bitrate;
+        info->sample_rate = sample_rate;
+        info->channels = mode == 3 ? 1 : 2;
+        info->samples = samples;
+        info->frame_bytes = frame_bytes;
+    }
+    return frame_bytes;
+}
+
+int mp3_frame_sync(const uint8_t *buf, int len, mp3_frame_info_t *info) {
+    mp3_frame_info_t cur, next;
+    for (int i = 0; i + MP3_FRAME_HEADER_SIZE <= len; i++) {
+        if (buf[i] != 0xFF) {
+            continue;
+        }
+        int size = mp3_frame_parse_header(buf + i, &cur);
+        if (size == 0) {
+            continue;
+        }
+        // confirm with the following header, it must agree on version and rate
+        if (i + size + MP3_FRAME_HEADER_SIZE <= len) {
+            if (!mp3_frame_parse_header(buf + i + size, &next)
+                || next.version != cur.version || next.sample_rate != cur.sample_rate) {
+                continue;
+            }
+        } else if (i + size != len) {
+            continue;
+        }
+        if (info) {
+            *info = cur;
+        }
+        return i;
+    }
+    return -1;
+}
+
+int mp3_id3v2_size(const uint8_t *buf, int len) {
+    if (len < 10 || buf[0] != 'I' || buf[1] != 'D' || buf[2] != '3') {
+        return 0;
+    }
+    // syncsafe integer, 7 bits per byte
+    int size = ((buf[6] & 0x7F) << 21) | ((buf[7] & 0x7F) << 14) | ((buf[8] & 0x7F) << 7) | (buf[9] & 0x7F);
+    int footer = (buf[5] & 0x10) ? 10 : 0;
+    return 10 + size + footer;
+}
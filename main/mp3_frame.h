@@ -0,0 +1,74 @@
+/* MP3 frame header parsing
+
+   This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#ifndef _MP3_FRAME_H_
+#define _MP3_FRAME_H_
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define MP3_FRAME_HEADER_SIZE   4
+#define MP3_FRAME_MAX_BYTES     1441    /* MPEG1 layer III, 320 kbps, 32 kHz, padded */
+#define MP3_FRAME_MAX_SAMPLES   1152    /* samples per channel per frame */
+
+/**
+ * @brief Decoded MPEG audio layer III frame header
+ */
+typedef struct {
+    int version;        /*!< 10 = MPEG1, 20 = MPEG2, 25 = MPEG2.5 */
+    int bitrate_kbps;   /*!< Bit rate in kbit/s */
+    int sample_rate;    /*!< Sample rate in Hz */
+    int channels;       /*!< 1 or 2 */
+    int samples;        /*!< Samples per channel in this frame */
+    int frame_bytes;    /*!< Size of the frame including the header */
+} mp3_frame_info_t;
+
+/**
+ * @brief Parse a 4-byte layer III frame header
+ *
+ * @param hdr   Pointer to at least MP3_FRAME_HEADER_SIZE bytes
+ * @param info  Parsed header, may be NULL
+ *
+ * @return Frame size in bytes, or 0 if hdr is not a valid layer III header
+ */
+int mp3_frame_parse_header(const uint8_t *hdr, mp3_frame_info_t *info);
+
+/**
+ * @brief Find the next frame header in a buffer
+ *
+ * A candidate is only accepted if the following frame header is also valid
+ * (or the candidate frame ends exactly at the end of the buffer), which keeps
+ * false syncs inside the audio payload from being reported.
+ *
+ * @param buf   Data to search
+ * @param len   Length of buf
+ * @param info  Header of the frame found, may be NULL
+ *
+ * @return Offset of the frame in buf, or -1 if none was found
+ */
+int mp3_frame_sync(const uint8_t *buf, int len, mp3_frame_info_t *info);
+
+/**
+ * @brief Size of the ID3v2 tag at the start of a file
+ *
+ * @param buf   Start of the file
+ * @param len   Length of buf
+ *
+ * @return Tag size in bytes including header and footer, 0 if there is no tag
+ */
+int mp3_id3v2_size(const uint8_t *buf, int len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
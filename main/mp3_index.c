@@ -0,0 +1,32 @@
+/* Frame index of an mp3 asset, generated at build time
+
+   This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#include "mp3_index.h"
+
+uint32_t mp3_index_offset(const mp3_index_t *index, uint32_t frame) {
+    if (frame >= index->frame_count) {
+        return index->end;
+    }
+    return index->base[frame / MP3_INDEX_BLOCK_FRAMES] + index->rel[frame];
+}
+
+uint32_t mp3_index_frame_at(const mp3_index_t *index, uint32_t ms) {
+    uint64_t frame = (uint64_t)ms * index->sample_rate / (1000ULL * index->frame_samples);
+    return frame < index->frame_count ? (uint32_t)frame : index->frame_count;
+}
+
+uint32_t mp3_index_frame_ms(const mp3_index_t *index, uint32_t frame) {
+    // rounded up, so the time is inside the frame and mp3_index_frame_at() maps it back to it
+    uint64_t samples = (uint64_t)frame * index->frame_samples * 1000;
+    return (samples + index->sample_rate - 1) / index->sample_rate;
+}
+
+uint32_t mp3_index_duration_ms(const mp3_index_t *index) {
+    return mp3_index_frame_ms(index, index->frame_count);
+}
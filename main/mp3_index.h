@@ -0,0 +1,73 @@
+/* Frame index of an mp3 asset, generated at build time
+
+   This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#ifndef _MP3_INDEX_H_
+#define _MP3_INDEX_H_
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Frames per base offset; a block of 32 frames of at most MP3_FRAME_MAX_BYTES
+ * keeps every relative offset within 16 bits
+ */
+#define MP3_INDEX_BLOCK_FRAMES  32
+
+/**
+ * @brief Offsets of all frames of an asset, from tools/gen_mp3_index.py
+ *
+ * All frames of an indexed asset have the same duration, so the frame playing
+ * at a given time is a division, and its offset two table reads.
+ */
+typedef struct mp3_index {
+    uint32_t        sample_rate;
+    uint16_t        frame_samples;  /*!< Samples per channel per frame */
+    uint8_t         channels;
+    uint32_t        frame_count;
+    uint32_t        end;            /*!< End of the last whole frame */
+    const uint32_t  *base;          /*!< Offset of every MP3_INDEX_BLOCK_FRAMES-th frame */
+    const uint16_t  *rel;           /*!< Offset of every frame from the base of its block */
+} mp3_index_t;
+
+/**
+ * @brief Offset of a frame from the start of the asset
+ *
+ * @param index The index
+ * @param frame Frame number, frame_count or above for the end of the audio
+ */
+uint32_t mp3_index_offset(const mp3_index_t *index, uint32_t frame);
+
+/**
+ * @brief Frame playing at a time
+ *
+ * @param index The index
+ * @param ms    Time from the start of the asset
+ *
+ * @return Frame number, frame_count if ms is at or past the end
+ */
+uint32_t mp3_index_frame_at(const mp3_index_t *index, uint32_t ms);
+
+/**
+ * @brief Start time of a frame in ms, rounded up: mp3_index_frame_at() of it is the frame again
+ */
+uint32_t mp3_index_frame_ms(const mp3_index_t *index, uint32_t frame);
+
+/**
+ * @brief Playing time of the asset in ms
+ */
+uint32_t mp3_index_duration_ms(const mp3_index_t *index);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,35 @@
+/* MP3 assets embedded in the application image
+
+   This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#include "music_assets.h"
+
+// low rate mp3 audio
+extern const uint8_t lr_mp3_start[] asm("_binary_music_16b_2c_8000hz_mp3_start");
+extern const uint8_t lr_mp3_end[] asm("_binary_music_16b_2c_8000hz_mp3_end");
+
+// medium rate mp3 audio
+extern const uint8_t mr_mp3_start[] asm("_binary_music_16b_2c_22050hz_mp3_start");
+extern const uint8_t mr_mp3_end[] asm("_binary_music_16b_2c_22050hz_mp3_end");
+
+// high rate mp3 audio
+extern const uint8_t hr_mp3_start[] asm("_binary_music_16b_2c_44100hz_mp3_start");
+extern const uint8_t hr_mp3_end[] asm("_binary_music_16b_2c_44100hz_mp3_end");
+
+// frame indexes, generated from the same files by tools/gen_mp3_index.py
+extern const mp3_index_t music_16b_2c_8000hz_mp3_index;
+extern const mp3_index_t music_16b_2c_22050hz_mp3_index;
+extern const mp3_index_t music_16b_2c_44100hz_mp3_index;
+
+const embed_asset_t music_assets[] = {
+    {"music-16b-2c-8000hz.mp3", lr_mp3_start, lr_mp3_end, &music_16b_2c_8000hz_mp3_index},
+    {"music-16b-2c-22050hz.mp3", mr_mp3_start, mr_mp3_end, &music_16b_2c_22050hz_mp3_index},
+    {"music-16b-2c-44100hz.mp3", hr_mp3_start, hr_mp3_end, &music_16b_2c_44100hz_mp3_index},
+};
+
+const int music_assets_count = sizeof(music_assets) / sizeof(music_assets[0]);
@@ -0,0 +1,29 @@
+/* MP3 assets embedded in the application image
+
+   This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#ifndef _MUSIC_ASSETS_H_
+#define _MUSIC_ASSETS_H_
+
+#include "embed_stream.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Assets listed in COMPONENT_EMBED_TXTFILES, lowest sample rate first
+ */
+extern const embed_asset_t music_assets[];
+extern const int music_assets_count;
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,107 @@
+/* Erase of a whole partition in chunks through the flash arbiter, with progress and an ETA
+
+   This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "audio_mem.h"
+#include "audio_error.h"
+#include "partition_erase.h"
+
+static const char *TAG = "PARTITION_ERASE";
+
+struct partition_erase {
+    partition_erase_cfg_t cfg;
+    size_t done;
+    int64_t start_us;               // 0 until the first step
+    int64_t end_us;
+};
+
+partition_erase_handle_t partition_erase_create(const partition_erase_cfg_t *cfg) {
+    AUDIO_NULL_CHECK(TAG, cfg && cfg->arb && cfg->io, return NULL);
+    if (!cfg->size || !cfg->chunk_size) {
+        ESP_LOGE(TAG, "invalid config, %d bytes in chunks of %d", (int)cfg->size, (int)cfg->chunk_size);
+        return NULL;
+    }
+    partition_erase_handle_t pe = audio_calloc(1, sizeof(struct partition_erase));
+    AUDIO_MEM_CHECK(TAG, pe, return NULL);
+    pe->cfg = *cfg;
+    return pe;
+}
+
+void partition_erase_destroy(partition_erase_handle_t pe) {
+    audio_free(pe);
+}
+
+bool partition_erase_done(partition_erase_handle_t pe) {
+    return pe && pe->done >= pe->cfg.size;
+}
+
+void partition_erase_get_progress(partition_erase_handle_t pe, partition_erase_progress_t *progress) {
+    AUDIO_NULL_CHECK(TAG, pe && progress, return);
+    int64_t now = pe->end_us ? pe->end_us : esp_timer_get_time();
+    size_t remain = pe->cfg.size - pe->done;
+    progress->done = pe->done;
+    progress->total = pe->cfg.size;
+    progress->elapsed_us = pe->start_us ? now - pe->start_us : 0;
+    if (!remain) {
+        progress->eta_us = 0;
+    } else if (pe->done) {
+        progress->eta_us = progress->elapsed_us * (int64_t)remain / (int64_t)pe->done;
+    } else {
+        // nothing measured yet, the arbiter's model without the waits
+        progress->eta_us = flash_arbiter_estimate(pe->cfg.arb, FLASH_OP_ERASE, remain);
+    }
+}
+
+esp_err_t partition_erase_step(partition_erase_handle_t pe) {
+    AUDIO_NULL_CHECK(TAG, pe, return ESP_ERR_INVALID_ARG);
+    if (partition_erase_done(pe)) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (!pe->start_us) {
+        pe->start_us = esp_timer_get_time();
+    }
+    size_t len = pe->cfg.size - pe->done;
+    len = len < pe->cfg.chunk_size ? len : pe->cfg.chunk_size;
+    esp_err_t err = flash_arbiter_run(pe->cfg.arb, FLASH_OP_ERASE, pe->done, NULL, len, pe->cfg.io, pe->cfg.io_ctx);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "erase of %d bytes at 0x%x failed, %s", (int)len, (int)pe->done, esp_err_to_name(err));
+        return err;
+    }
+    pe->done += len;
+    if (partition_erase_done(pe)) {
+        pe->end_us = esp_timer_get_time();
+    }
+    if (pe->cfg.progress) {
+        partition_erase_progress_t progress;
+        partition_erase_get_progress(pe, &progress);
+        pe->cfg.progress(&progress, pe->cfg.progress_ctx);
+    }
+    return ESP_OK;
+}
+
+esp_err_t partition_erase_run(partition_erase_handle_t pe) {
+    AUDIO_NULL_CHECK(TAG, pe, return ESP_ERR_INVALID_ARG);
+    int logged = pe->done * 10 / pe->cfg.size;
+    while (!partition_erase_done(pe)) {
+        esp_err_t err = partition_erase_step(pe);
+        if (err != ESP_OK) {
+            return err;
+        }
+        int tenth = pe->done * 10 / pe->cfg.size;
+        if (tenth > logged) {
+            logged = tenth;
+            partition_erase_progress_t p;
+            partition_erase_get_progress(pe, &p);
+            ESP_LOGI(TAG, "%3d%%, %d of %d KiB in %d ms, %d ms to go", tenth * 10, (int)(p.done / 1024),
+                     (int)(p.total / 1024), (int)(p.elapsed_us / 1000), (int)(p.eta_us / 1000));
+        }
+    }
+    return ESP_OK;
+}
@@ -0,0 +1,97 @@
+/* Erase of a whole partition in chunks through the flash arbiter, with progress and an ETA
+
+   This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#ifndef _PARTITION_ERASE_H_
+#define _PARTITION_ERASE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "flash_arbiter.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    size_t      done;               /*!< Bytes erased */
+    size_t      total;
+    int64_t     elapsed_us;
+    int64_t     eta_us;             /*!< Time still needed at the rate so far, 0 when done */
+} partition_erase_progress_t;
+
+/**
+ * @brief Called after every chunk, from the task that erases
+ */
+typedef void (*partition_erase_progress_cb_t)(const partition_erase_progress_t *progress, void *ctx);
+
+typedef struct {
+    flash_arbiter_handle_t       arb;
+    size_t                       size;          /*!< Bytes from address 0, a multiple of the arbiter's unit size */
+    size_t                       chunk_size;    /*!< Bytes per step, a multiple of the arbiter's unit size */
+    flash_arbiter_io_t           io;            /*!< Erases, e.g. esp_partition_erase_range() */
+    void                         *io_ctx;
+    partition_erase_progress_cb_t progress;     /*!< NULL for none */
+    void                         *progress_ctx;
+} partition_erase_cfg_t;
+
+#define PARTITION_ERASE_CFG_DEFAULT() { \
+    .arb = NULL,                        \
+    .size = 0,                          \
+    .chunk_size = 64 * 1024,            \
+    .io = NULL,                         \
+    .io_ctx = NULL,                     \
+    .progress = NULL,                   \
+    .progress_ctx = NULL,               \
+}
+
+typedef struct partition_erase *partition_erase_handle_t;
+
+/**
+ * @brief Prepare an erase, nothing is erased yet
+ *
+ * @return The erase, NULL on error
+ */
+partition_erase_handle_t partition_erase_create(const partition_erase_cfg_t *cfg);
+
+void partition_erase_destroy(partition_erase_handle_t pe);
+
+/**
+ * @brief Erase the next chunk
+ *
+ * The chunk runs through flash_arbiter_run(): while audio plays it is split
+ * into windows that fit the i2s headroom, each one waiting for the headroom
+ * and followed by a recovery pause; while none plays, into the arbiter's
+ * idle windows, whole 64 KiB blocks where it has them.
+ *
+ * @return
+ *     - ESP_OK
+ *     - ESP_ERR_INVALID_STATE all erased already
+ *     - the error of the arbiter or io, the chunk is erased again by the next call
+ */
+esp_err_t partition_erase_step(partition_erase_handle_t pe);
+
+/**
+ * @brief Whether the whole size is erased
+ */
+bool partition_erase_done(partition_erase_handle_t pe);
+
+/**
+ * @brief Step to the end, logging every 10 %
+ */
+esp_err_t partition_erase_run(partition_erase_handle_t pe);
+
+void partition_erase_get_progress(partition_erase_handle_t pe, partition_erase_progress_t *progress);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,366 @@
+/* Decoded PCM of short tracks kept in PSRAM, replayed without the mp3 decoder
+
+   This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#include <string.h>
+#include <stdbool.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "audio_mem.h"
+#include "audio_error.h"
+#include "pcm_cache.h"
+
+static const char *TAG = "PCM_CACHE";
+
+typedef struct {
+    const embed_asset_t *track;     // NULL for a free entry
+    char *pcm;
+    int len;                        // PCM of the whole track
+    int filled;                     // recorded so far, len once complete
+    int64_t start;                  // source position of pcm[0] while recording
+    int sample_rate;
+    int channels;
+    int bytes_per_sec;
+    uint32_t last_used;             // LRU clock
+    int64_t decode_us;              // decoder time the recording took
+} pcm_entry_t;
+
+#define MISS_HISTORY    8
+
+typedef struct {
+    const uint8_t *start;           // of the track's data, NULL for none
+    uint32_t at;                    // LRU clock of the miss
+} miss_t;
+
+struct pcm_cache {
+    pcm_cache_cfg_t cfg;
+    pcm_entry_t *entries;
+    uint32_t clock;
+    miss_t misses[MISS_HISTORY];    // recent misses that were not recorded
+    int64_t out_pos;                // source position after the last decoder output
+    int64_t out_us;                 // when the last decoder output was queued, 0 before
+    pcm_entry_t *replay;            // track being replayed, NULL if none
+    int replay_off;
+    int64_t replay_at;              // source position the replay starts at
+    int64_t wait_pos;               // out_pos at the last replay call that waited, -1 if none
+    bool replaying;                 // the output being observed is the replay's own
+    audio_element_handle_t replay_el;   // decoder whose music info the replay set, NULL if none
+    audio_element_info_t decoder_info;  // its music info before
+    pcm_cache_stats_t stats;
+};
+
+static bool recording(const pcm_entry_t *e) {
+    return e->track && e->filled < e->len;
+}
+
+/**
+ * @brief The replay is over, the decoder's music info is its own again
+ */
+static void end_replay(pcm_cache_handle_t cache) {
+    if (cache->replay_el) {
+        audio_element_info_t *info = &cache->decoder_info;
+        audio_element_set_music_info(cache->replay_el, info->sample_rates, info->channels, info->bits);
+        cache->replay_el = NULL;
+    }
+    cache->replay = NULL;
+}
+
+static void release(pcm_cache_handle_t cache, pcm_entry_t *e) {
+    if (e == cache->replay) {
+        end_replay(cache);
+    }
+    audio_free(e->pcm);
+    cache->stats.used_bytes -= e->len;
+    cache->stats.entries--;
+    memset(e, 0, sizeof(*e));
+}
+
+/**
+ * @brief Least recently used complete track not being replayed, NULL if there is none
+ */
+static pcm_entry_t *lru_victim(pcm_cache_handle_t cache) {
+    pcm_entry_t *victim = NULL;
+    for (int i = 0; i < cache->cfg.max_entries; i++) {
+        pcm_entry_t *e = &cache->entries[i];
+        if (e->track && !recording(e) && e != cache->replay && (!victim || e->last_used < victim->last_used)) {
+            victim = e;
+        }
+    }
+    return victim;
+}
+
+/**
+ * @brief Whether len bytes and an entry can be had, evicting only tracks not played since a clock
+ */
+static bool room_for(pcm_cache_handle_t cache, int len, uint32_t since) {
+    size_t room = cache->cfg.budget_bytes - cache->stats.used_bytes;
+    bool slot = false;
+    for (int i = 0; i < cache->cfg.max_entries; i++) {
+        pcm_entry_t *e = &cache->entries[i];
+        if (!e->track || (!recording(e) && e != cache->replay && e->last_used < since)) {
+            room += e->len;
+            slot = true;
+        }
+    }
+    return slot && room >= len;
+}
+
+/**
+ * @brief The previous miss of a track that was not recorded, its clock is the miss now
+ *
+ * @return Clock of the previous miss, 0 if none is remembered
+ */
+static uint32_t note_miss(pcm_cache_handle_t cache, const embed_asset_t *track) {
+    miss_t *m = &cache->misses[0];
+    for (int i = 0; i < MISS_HISTORY; i++) {
+        if (cache->misses[i].start == track->start) {
+            m = &cache->misses[i];
+            break;
+        }
+        if (cache->misses[i].at < m->at) {
+            m = &cache->misses[i];
+        }
+    }
+    uint32_t prev = m->start == track->start ? m->at : 0;
+    m->start = track->start;
+    m->at = ++cache->clock;
+    return prev;
+}
+
+/**
+ * @brief A free entry with len bytes of PCM allocated, evicting tracks as needed
+ */
+static pcm_entry_t *make_room(pcm_cache_handle_t cache, int len) {
+    pcm_entry_t *slot = NULL;
+    while (1) {
+        for (int i = 0; i < cache->cfg.max_entries && !slot; i++) {
+            if (!cache->entries[i].track) {
+                slot = &cache->entries[i];
+            }
+        }
+        if (slot && cache->stats.used_bytes + len <= cache->cfg.budget_bytes) {
+            break;
+        }
+        pcm_entry_t *victim = lru_victim(cache);
+        if (!victim) {
+            return NULL;
+        }
+        ESP_LOGD(TAG, "evict %s, %d bytes", victim->track->name, victim->len);
+        release(cache, victim);
+        cache->stats.evictions++;
+    }
+    slot->pcm = audio_malloc(len);
+    if (!slot->pcm) {
+        ESP_LOGW(TAG, "no memory for %d bytes of PCM", len);
+        return NULL;
+    }
+    return slot;
+}
+
+pcm_cache_handle_t pcm_cache_create(const pcm_cache_cfg_t *cfg) {
+    AUDIO_NULL_CHECK(TAG, cfg, return NULL);
+    if (cfg->max_entries <= 0 || cfg->chunk_bytes <= 0) {
+        ESP_LOGE(TAG, "invalid cache, %d entries, %d byte chunks", cfg->max_entries, cfg->chunk_bytes);
+        return NULL;
+    }
+    pcm_cache_handle_t cache = audio_calloc(1, sizeof(struct pcm_cache));
+    AUDIO_MEM_CHECK(TAG, cache, return NULL);
+    cache->entries = audio_calloc(cfg->max_entries, sizeof(pcm_entry_t));
+    AUDIO_MEM_CHECK(TAG, cache->entries, {
+        audio_free(cache);
+        return NULL;
+    });
+    cache->cfg = *cfg;
+    cache->wait_pos = -1;
+    return cache;
+}
+
+void pcm_cache_destroy(pcm_cache_handle_t cache) {
+    if (!cache) {
+        return;
+    }
+    for (int i = 0; i < cache->cfg.max_entries; i++) {
+        audio_free(cache->entries[i].pcm);
+    }
+    audio_free(cache->entries);
+    audio_free(cache);
+}
+
+int pcm_cache_begin(pcm_cache_handle_t cache, const embed_asset_t *track, int64_t pos) {
+    AUDIO_NULL_CHECK(TAG, cache && track, return 0);
+    pcm_cache_cancel(cache, pos);
+    for (int i = 0; i < cache->cfg.max_entries; i++) {
+        pcm_entry_t *e = &cache->entries[i];
+        // by data, the same asset may be in a track table more than once
+        if (!e->track || e->track->start != track->start) {
+            continue;
+        }
+        // a recording still here was all handed out before pos (e.g. a short loop), it completes before the replay
+        e->last_used = ++cache->clock;
+        cache->replay = e;
+        cache->replay_off = 0;
+        cache->replay_at = pos;
+        cache->wait_pos = -1;
+        cache->stats.hits++;
+        ESP_LOGD(TAG, "replay %s, %d bytes", track->name, e->len);
+        return e->len;
+    }
+    cache->stats.misses++;
+
+    const mp3_index_t *index = track->index;
+    if (!index) {
+        return 0;
+    }
+    int64_t len = (int64_t)index->frame_count * index->frame_samples * index->channels * sizeof(int16_t);
+    if (len == 0 || len > cache->cfg.max_track_bytes || len > cache->cfg.budget_bytes) {
+        return 0;
+    }
+    uint32_t prev_miss = note_miss(cache, track);
+    if (!room_for(cache, len, prev_miss)) {
+        // everything it would evict was played since it last missed: they take turns, keep what is here
+        ESP_LOGD(TAG, "decline %s, %d bytes", track->name, (int)len);
+        cache->stats.declined++;
+        return 0;
+    }
+    pcm_entry_t *e = make_room(cache, len);
+    if (!e) {
+        cache->stats.dropped++;
+        return 0;
+    }
+    e->track = track;
+    e->len = len;
+    e->filled = 0;
+    e->start = pos;
+    e->sample_rate = index->sample_rate;
+    e->channels = index->channels;
+    e->bytes_per_sec = index->sample_rate * index->channels * sizeof(int16_t);
+    e->decode_us = 0;
+    cache->stats.used_bytes += len;
+    cache->stats.entries++;
+    ESP_LOGD(TAG, "record %s, %d bytes", track->name, e->len);
+    return 0;
+}
+
+int pcm_cache_replay(pcm_cache_handle_t cache, audio_element_handle_t el) {
+    AUDIO_NULL_CHECK(TAG, el, return AEL_IO_FAIL);
+    pcm_entry_t *e = cache->replay;
+    if (!e) {
+        return 0;
+    }
+    if (cache->replay_off == 0) {
+        if (cache->out_pos < cache->replay_at && cache->out_pos != cache->wait_pos) {
+            // the decoder is still writing out frames handed to it before the track
+            cache->wait_pos = cache->out_pos;
+            return AEL_IO_TIMEOUT;
+        }
+        if (recording(e)) {
+            // the decoder is done and part of the track never came out, the caller decodes it instead
+            release(cache, e);
+            cache->stats.dropped++;
+            cache->stats.hits--;
+            cache->stats.misses++;
+            return 0;
+        }
+        if (!cache->replay_el) {
+            // the decoder's output path tells the format of what it writes by its music info
+            cache->replay_el = el;
+            audio_element_getinfo(el, &cache->decoder_info);
+            audio_element_set_music_info(el, e->sample_rate, e->channels, 16);
+        }
+    }
+    if (cache->replay_off >= e->len) {
+        cache->stats.saved_us += e->decode_us;
+        end_replay(cache);
+        return 0;
+    }
+    int n = e->len - cache->replay_off;
+    if (n > cache->cfg.chunk_bytes) {
+        n = cache->cfg.chunk_bytes;
+    }
+    cache->replaying = true;
+    int w = audio_element_output(el, e->pcm + cache->replay_off, n);
+    cache->replaying = false;
+    if (w <= 0) {
+        return w == 0 ? AEL_IO_TIMEOUT : w;
+    }
+    cache->replay_off += w;
+    cache->stats.replay_bytes += w;
+    return w;
+}
+
+void pcm_cache_cancel(pcm_cache_handle_t cache, int64_t pos) {
+    if (cache->replay && cache->replay_off < cache->replay->len) {
+        ESP_LOGD(TAG, "replay of %s stopped at %d of %d bytes", cache->replay->track->name, cache->replay_off,
+                 cache->replay->len);
+    }
+    end_replay(cache);
+    for (int i = 0; i < cache->cfg.max_entries; i++) {
+        pcm_entry_t *e = &cache->entries[i];
+        // a track all handed out before pos is still being written out by the decoder, keep recording it
+        if (recording(e) && e->start + e->len > pos) {
+            release(cache, e);
+            cache->stats.dropped++;
+        }
+    }
+}
+
+void pcm_cache_decoder_output(pcm_cache_handle_t cache, int64_t pos, const char *buf, int len, int64_t wait_us) {
+    // the decoder took the time since the last block was handled here, less the wait for room to queue this one;
+    // recording it is not decoder time a replay saves
+    int64_t us = cache->out_us ? esp_timer_get_time() - cache->out_us - wait_us : 0;
+    us = us > 0 ? us : 0;
+    cache->out_pos = pos + len;
+    if (cache->replaying) {
+        cache->out_us = esp_timer_get_time();
+        return;
+    }
+    for (int i = 0; i < cache->cfg.max_entries; i++) {
+        pcm_entry_t *e = &cache->entries[i];
+        if (!recording(e) || pos + len <= e->start + e->filled) {
+            continue;
+        }
+        int64_t from = e->start + e->filled;
+        if (pos > from) {
+            // part of the track never came out, e.g. the pipeline was reset
+            release(cache, e);
+            cache->stats.dropped++;
+            continue;
+        }
+        int64_t to = pos + len < e->start + e->len ? pos + len : e->start + e->len;
+        memcpy(e->pcm + e->filled, buf + (from - pos), to - from);
+        e->filled += to - from;
+        // more than the block plays for is a pause or a stall
+        int64_t max_us = e->bytes_per_sec ? (to - from) * 1000000LL / e->bytes_per_sec : 0;
+        e->decode_us += us * (to - from) / len < max_us ? us * (to - from) / len : max_us;
+        if (e->filled == e->len) {
+            e->last_used = ++cache->clock;
+            cache->stats.stored++;
+            cache->stats.decode_us += e->decode_us;
+            cache->stats.decode_bytes += e->len;
+            ESP_LOGD(TAG, "stored %s, %d bytes, decoded in %d ms", e->track->name, e->len,
+                     (int)(e->decode_us / 1000));
+        }
+    }
+    cache->out_us = esp_timer_get_time();
+}
+
+void pcm_cache_get_stats(pcm_cache_handle_t cache, pcm_cache_stats_t *stats) {
+    *stats = cache->stats;
+}
+
+void pcm_cache_report(pcm_cache_handle_t cache) {
+    pcm_cache_stats_t s;
+    pcm_cache_get_stats(cache, &s);
+    uint32_t starts = s.hits + s.misses;
+    ESP_LOGI(TAG, "hits=%u misses=%u (%.1f%% hit), stored=%u dropped=%u evictions=%u declined=%u, %u tracks in "
+             "%u/%u bytes", s.hits, s.misses, starts ? s.hits * 100.0 / starts : 0.0, s.stored, s.dropped, s.evictions,
+             s.declined, s.entries, (unsigned)s.used_bytes, (unsigned)cache->cfg.budget_bytes);
+    ESP_LOGI(TAG, "replayed %llu bytes, decoder time saved %d ms (%.1f ms per replay, decoding costs %.1f us per KB)",
+             (unsigned long long)s.replay_bytes, (int)(s.saved_us / 1000), s.hits ? s.saved_us / 1000.0 / s.hits : 0.0,
+             s.decode_bytes ? s.decode_us * 1024.0 / s.decode_bytes : 0.0);
+}
@@ -0,0 +1,148 @@
+/* Decoded PCM of short tracks kept in PSRAM, replayed without the mp3 decoder
+
+   This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#ifndef _PCM_CACHE_H_
+#define _PCM_CACHE_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "audio_element.h"
+#include "embed_stream.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief PCM cache configuration
+ */
+typedef struct {
+    size_t budget_bytes;        /*!< PCM kept at most, least recently played tracks evicted first (pcm_cache_begin()) */
+    size_t max_track_bytes;     /*!< Only tracks decoding to at most this much are kept: prompts and loops */
+    int    max_entries;         /*!< Tracks kept at most */
+    int    chunk_bytes;         /*!< PCM written to the decoder output per replay call */
+} pcm_cache_cfg_t;
+
+#define PCM_CACHE_CFG_DEFAULT() {       \
+    .budget_bytes = 1024 * 1024,        \
+    .max_track_bytes = 1024 * 1024,     \
+    .max_entries = 8,                   \
+    .chunk_bytes = 4096,                \
+}
+
+/**
+ * @brief Cache counters
+ */
+typedef struct {
+    uint32_t hits;          /*!< Tracks replayed from the cache */
+    uint32_t misses;        /*!< Tracks started from their first frame and decoded */
+    uint32_t stored;        /*!< Tracks recorded in full */
+    uint32_t dropped;       /*!< Recordings given up: the track was left early, or no room */
+    uint32_t evictions;
+    uint32_t declined;      /*!< Misses not recorded: it would have evicted a track played since their previous miss */
+    uint64_t replay_bytes;  /*!< PCM replayed */
+    int64_t  saved_us;      /*!< Decoder time the replays did not spend, as measured while recording */
+    int64_t  decode_us;     /*!< Decoder time spent on the recorded tracks */
+    uint64_t decode_bytes;  /*!< PCM of the recorded tracks */
+    size_t   used_bytes;    /*!< Allocated for tracks now */
+    int      entries;       /*!< Tracks kept now, complete or recording */
+} pcm_cache_stats_t;
+
+typedef struct pcm_cache *pcm_cache_handle_t;
+
+/**
+ * @brief Create an empty cache
+ *
+ * Track PCM is allocated with audio_malloc(), so it goes to PSRAM when the
+ * board has it. A track is recorded from the decoder output the first time
+ * it plays from its first frame, and replayed from then on.
+ *
+ * @return The cache, NULL on error
+ */
+pcm_cache_handle_t pcm_cache_create(const pcm_cache_cfg_t *cfg);
+
+/**
+ * @brief Free the cache and all track PCM
+ */
+void pcm_cache_destroy(pcm_cache_handle_t cache);
+
+/**
+ * @brief A track starts from its first frame at source position pos
+ *
+ * Called in the decoder's read context before the first frame is handed
+ * out. On a hit the caller hands out none of the track's frames and calls
+ * pcm_cache_replay() instead until it returns 0. On a miss a track with a
+ * frame index that fits max_track_bytes is recorded as the decoder output
+ * reaches pos. It evicts others only if none of them was played since the
+ * track's previous miss: tracks taking turns in a budget too small for them
+ * all do not evict each other on every start, the first ones kept hit.
+ *
+ * @param cache The cache
+ * @param track The track
+ * @param pos   Source position of the track's first frame, as the decoder output is located
+ *              (latency_trace_set_source())
+ *
+ * @return Bytes to replay on a hit, 0 on a miss
+ */
+int pcm_cache_begin(pcm_cache_handle_t cache, const embed_asset_t *track, int64_t pos);
+
+/**
+ * @brief Write the next chunk of the track being replayed to the decoder's output
+ *
+ * Called from the decoder's read callback instead of handing it data. The
+ * replay waits until the decoder has written out everything it was handed
+ * before the track, i.e. its output reached the track's position or it asked
+ * for data twice without writing anything, so the track plays in order.
+ * While it replays, the decoder's music info is the track's format, so
+ * observers of the decoder output see the same as when it was decoded.
+ *
+ * @param cache The cache
+ * @param el    The decoder
+ *
+ * @return Bytes written, AEL_IO_TIMEOUT while waiting for the decoder, or the error of the write;
+ *         0 when the replay ended: complete, or short if the track was lost (a recording that never
+ *         finished), and the caller decodes the rest
+ */
+int pcm_cache_replay(pcm_cache_handle_t cache, audio_element_handle_t el);
+
+/**
+ * @brief The source moves away at pos: stop a replay, give up recordings that need PCM from pos on
+ */
+void pcm_cache_cancel(pcm_cache_handle_t cache, int64_t pos);
+
+/**
+ * @brief Record tracks from the decoder output, from a latency_trace_set_output_cb() observer
+ *
+ * The decoder time of a block is taken as the time since the previous one
+ * was queued, less wait_us.
+ *
+ * @param cache   The cache
+ * @param pos     Source position of buf[0]
+ * @param buf     PCM the decoder queued
+ * @param len     Bytes in buf
+ * @param wait_us How long the decoder waited for room to queue it, latency_trace_get_write_wait_us()
+ */
+void pcm_cache_decoder_output(pcm_cache_handle_t cache, int64_t pos, const char *buf, int len, int64_t wait_us);
+
+/**
+ * @brief Copy the counters
+ */
+void pcm_cache_get_stats(pcm_cache_handle_t cache, pcm_cache_stats_t *stats);
+
+/**
+ * @brief Log the counters, hit ratio and decoder time saved per replay
+ */
+void pcm_cache_report(pcm_cache_handle_t cache);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -10,6 +10,8 @@
 */
 
 #include <string.h>
+#include <dirent.h>
+#include <sys/stat.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 
@@ -26,10 +28,36 @@
 #include "periph_adc_button.h"
 #include "periph_button.h"
 #include "board.h"
+#include "music_assets.h"
+#include "playlist.h"
+#include "latency_trace.h"
+#include "player_pipeline.h"
+#include "flash_arbiter.h"
+#include "storage_diskio.h"
+#include "file_stream.h"
+#include "play_position.h"
+#include "pcm_cache.h"
+#include "resample.h"
+#include "sw_gain.h"
+#include "new_codec.h"
+#include "mem_placement.h"
+#include "telemetry.h"
+#include "telemetry_uart.h"
+#include "adaptive_buffer.h"
+#include "task_placement.h"
+#include "task_profiler.h"
+#include "input_dispatch.h"
+#include "storage_boot.h"
+#include "boot_graph.h"
+#include "partition_erase.h"
+#include "log_store.h"
 
 #include "nvs_flash.h"
 #include "esp_vfs_fat.h"
 #include "esp_flash_partitions.h"
+#include "esp_heap_caps.h"
+#include "esp_timer.h"
+#include "hal/cpu_hal.h"
 
 static const char *TAG = "PLAY_FLASH_MP3_CONTROL";
 
@@ -43,61 +71,247 @@ static const char *TEST_DATA = "hello world";
 static const char *TASK_NAME = "FATFS";
 #define TASK_STACK_SIZE 2048
 #define TASK_PRIORITY 4
-#define MP3_DECODER_CORE 0
+// FAT sectors cached in PSRAM, and how long a dirty one may wait before it is written to flash
+#define STORAGE_CACHE_SECTORS 32
+#define STORAGE_FLUSH_INTERVAL_MS 30000
+// the FAT worker reads two sectors every tick and CRCs them, a sweep of the 1 MB partition takes about a minute
+#define VERIFY_TICK_MS 500
+#define VERIFY_BUDGET_BYTES_PER_S (16 * 1024)
+// without audio the arbiter runs flash operations in windows of up to a 64 KiB block, an erase of the storage
+// partition erases whole blocks then
+#define STORAGE_ERASE_BLOCK (64 * 1024)
+// 1: play STORAGE_MP3_FILE from /storage through file_stream instead of the embedded playlist
+#define PLAY_FROM_STORAGE 0
+#define STORAGE_SEED_ASSET 2
+static const char *STORAGE_MP3_FILE = "/storage/music.mp3";
+// 1: mount the FAT FS that is on the partition and validate it from the FAT worker once playing, erasing and
+// formatting it only if that fails; 0: erase and format the 1 MB partition at every boot, seconds before audio
+#define FAST_BOOT 1
+// the event loop wakes at least this often to checkpoint the playlist position in NVS
+#define POSITION_CHECKPOINT_MS 5000
+// decoded PCM of tracks up to 1 MB (the 8 kHz asset) is kept in PSRAM and replayed without decoding, 0 to disable
+#define PCM_CACHE_BUDGET (1024 * 1024)
+// every track is resampled to this rate, the i2s clock is set once at boot and never retuned between tracks
+#define OUTPUT_SAMPLE_RATE 44100
+// log the resampler's CPU cycles per output frame for each input rate at boot
+#define RESAMPLE_BENCH 0
+// the volume is applied to the PCM with a ramp in front of i2s, the codec driver has no volume of its own
+#define SOFT_VOLUME 1
+// 1: place each element's ring buffer, work memory and task stack by mem_rules, and report it once playing
+#define MEM_PLACEMENT 1
+// 1: ring buffer fill, i2s underruns and mp3 decode time per frame as a binary stream on a second UART,
+// read it with tools/telemetry_decode.py; TX pin and baud rate for a USB serial adapter
+#define TELEMETRY 1
+#define TELEMETRY_UART_NUM 1
+#define TELEMETRY_TX_PIN 22
+#define TELEMETRY_BAUD 921600
+// 1: the decoder output ring buffer is created at ADAPTIVE_BUFFER_MAX (PSRAM by mem_rules), the decoder fills it up
+// to a target that grows after underruns and near underruns and shrinks back when quiet
+#define ADAPTIVE_BUFFER 1
+#define ADAPTIVE_BUFFER_MAX (96 * 1024)
+// 1: profile the tasks for TASK_PROFILE_MS of playback, then plan their cores from it for the next boot; needs
+// CONFIG_FREERTOS_USE_TRACE_FACILITY and CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS
+#define TASK_PROFILE 1
+#define TASK_PROFILE_MS 60000
+#define TASK_PLACEMENT_NAMESPACE "player"
+// the first Vol+/Vol- press of a burst acts at once, the rest are one volume update INPUT_COALESCE_MS after the
+// last of them; a held key steps every INPUT_REPEAT_MS; Play and Mode drop a second press within
+// INPUT_DEBOUNCE_MS, a bouncing key would undo the first
+#define INPUT_VOLUME_STEP 10
+#define INPUT_COALESCE_MS 200
+#define INPUT_REPEAT_MS 300
+#define INPUT_DEBOUNCE_MS 250
+// DMA has to cover a 4 KiB sector erase (~45 ms) with the cache disabled: 6 x 512 frames = 70 ms at 44.1 kHz
+#define I2S_DMA_BUF_COUNT 6
+#define I2S_DMA_BUF_LEN 512
+// the i2s ISR runs while the cache is disabled, its driver state must not land in PSRAM
+#define I2S_DRIVER_ALWAYSINTERNAL 16384
+// 1: plays, skips and errors are appended to the raw "playlog" partition (partitions.csv); a batch of 4 pages in RAM
+// is written when full or a minute after its first record, play counts are tallied from it at boot
+#define PLAY_LOG 1
+#define PLAY_LOG_SUBTYPE 0x40
+static const char *PLAY_LOG_PARTITION = "playlog";
 
-static struct marker {
-    int pos;
-    const uint8_t *start;
-    const uint8_t *end;
-} file_marker;
+// play_log record types
+enum {
+    PLAY_LOG_PLAY = 1,      // play_log_track_t, a track started
+    PLAY_LOG_SKIP,          // play_log_track_t, [Mode] left it at frame
+    PLAY_LOG_ERROR,         // play_log_error_t
+};
 
-// low rate mp3 audio
-extern const uint8_t lr_mp3_start[] asm("_binary_music_16b_2c_8000hz_mp3_start");
-extern const uint8_t lr_mp3_end[] asm("_binary_music_16b_2c_8000hz_mp3_end");
+typedef struct {
+    uint32_t track;
+    uint32_t frame;
+} play_log_track_t;
 
-// medium rate mp3 audio
-extern const uint8_t mr_mp3_start[] asm("_binary_music_16b_2c_22050hz_mp3_start");
-extern const uint8_t mr_mp3_end[] asm("_binary_music_16b_2c_22050hz_mp3_end");
+typedef struct {
+    int32_t err;
+    uint32_t where;         // e.g. the FAT sector
+} play_log_error_t;
 
-// high rate mp3 audio
-extern const uint8_t hr_mp3_start[] asm("_binary_music_16b_2c_44100hz_mp3_start");
-extern const uint8_t hr_mp3_end[] asm("_binary_music_16b_2c_44100hz_mp3_end");
+static latency_trace_handle_t latency_trace;
+static telemetry_handle_t telemetry;
+static adaptive_buffer_handle_t adaptive_buffer;
+static pcm_cache_handle_t pcm_cache;
+static flash_arbiter_handle_t flash_arbiter;
+static log_store_handle_t play_log;         // set by the boot_log step, read by other tasks (atomics)
+static wl_handle_t storage_wl = WL_INVALID_HANDLE;
+static ringbuf_handle_t i2s_input_rb;
+static int64_t skip_resume_at = -1;     // decoder task: playlist PCM position the resampler plays again from
 
-static void set_next_file_marker() {
-    static int idx = 0;
+static int64_t playlist_source_pos(void *ctx) {
+    return playlist_get_pcm_pos((playlist_handle_t)ctx);
+}
 
-    switch (idx) {
-    case 0:
-        file_marker.start = lr_mp3_start;
-        file_marker.end = lr_mp3_end;
-        break;
-    case 1:
-        file_marker.start = mr_mp3_start;
-        file_marker.end = mr_mp3_end;
-        break;
-    case 2:
-        file_marker.start = hr_mp3_start;
-        file_marker.end = hr_mp3_end;
-        break;
-    default:
-        ESP_LOGE(TAG, "[ * ] Not supported index = %d", idx);
+/**
+ * @brief Decoder output observer, runs in the mp3 decoder task after every block it queues
+ * - ctx is the player pipeline.
+ * - The PCM cache records tracks from it; the resampler learns the format of every block, replays included.
+ * - After a skip, the resampler drops its input up to the first block of the new track.
+ */
+static void on_decoder_output(void *ctx, int64_t pos, const char *buf, int len) {
+    player_pipeline_t *pp = (player_pipeline_t *)ctx;
+    storage_boot_first_audio();
+    if (pcm_cache) {
+        pcm_cache_decoder_output(pcm_cache, pos, buf, len, latency_trace_get_write_wait_us(latency_trace));
+    }
+    audio_element_info_t info = {0};
+    audio_element_getinfo(pp->mp3_decoder, &info);
+    if (skip_resume_at >= 0 && pos + len > skip_resume_at) {
+        // the skipped-to track starts in this block: what is before it is still dropped
+        int old = skip_resume_at > pos ? (int)(skip_resume_at - pos) : 0;
+        if (old > 0) {
+            resample_input_written(pp->resampler, info.sample_rates, info.channels, old);
+        }
+        resample_input_resume(pp->resampler);
+        skip_resume_at = -1;
+        if (adaptive_buffer) {
+            // the resampler emptied the buffer dropping the old track, that was no near underrun
+            adaptive_buffer_reset(adaptive_buffer);
+        }
+        len -= old;
+    }
+    resample_input_written(pp->resampler, info.sample_rates, info.channels, len);
+    if (telemetry) {
+        telemetry_decoder_output(telemetry, latency_trace_get_write_wait_us(latency_trace));
+    }
+}
+
+static uint32_t telemetry_underruns(void *ctx) {
+    telemetry_stats_t stats = {0};
+    telemetry_get_stats((telemetry_handle_t)ctx, &stats);
+    return stats.underruns;
+}
+
+static void adaptive_write_gate(void *ctx, ringbuf_handle_t rb, int len) {
+    adaptive_buffer_wait_room((adaptive_buffer_handle_t)ctx, rb, len);
+}
+
+#if SOFT_VOLUME
+/**
+ * @brief Codec driver volume listener, audio_hal_set_volume() lands here; ctx is the gain element
+ */
+static void on_codec_volume(int volume, bool mute, void *ctx) {
+    sw_gain_set_volume((audio_element_handle_t)ctx, volume, mute);
+}
+
+/**
+ * @brief The gain element applied a new volume, in its task; ctx is the latency trace
+ */
+static void on_gain_applied(void *ctx) {
+    latency_trace_gain_applied((latency_trace_handle_t)ctx);
+}
+#endif
+
+#if RESAMPLE_BENCH
+/**
+ * @brief CPU cycles per stereo output frame of the resampler, for the track rates and a few others
+ */
+static void resample_benchmark(void) {
+    static const int rates[] = {8000, 11025, 16000, 22050, 32000, 48000};
+    int16_t *in = audio_calloc(RESAMPLE_MAX_BLOCK * 2, sizeof(int16_t));
+    int16_t *out = audio_calloc(RESAMPLE_MAX_BLOCK * 14, sizeof(int16_t));
+    mem_assert(in && out);
+    for (int i = 0; i < RESAMPLE_MAX_BLOCK * 2; i++) {
+        in[i] = (i * 997) & 0x3fff;
+    }
+    for (int r = 0; r < sizeof(rates) / sizeof(rates[0]); r++) {
+        resample_filter_handle_t f = resample_filter_create(rates[r], OUTPUT_SAMPLE_RATE);
+        if (!f) {
+            continue;
+        }
+        uint32_t frames = 0;
+        uint32_t t0 = cpu_hal_get_cycle_count();
+        // one second of input
+        for (int done = 0; done < rates[r]; done += RESAMPLE_MAX_BLOCK) {
+            frames += resample_filter_run(f, in, RESAMPLE_MAX_BLOCK, 2, out);
+        }
+        uint32_t cycles = cpu_hal_get_cycle_count() - t0;
+        ESP_LOGI(TAG, ">>> resample %5d -> %d Hz: %.1f cycles per output frame", rates[r], OUTPUT_SAMPLE_RATE,
+                 (double)cycles / frames);
+        resample_filter_destroy(f);
     }
-    if (++idx > 2) {
-        idx = 0;
+    audio_free(in);
+    audio_free(out);
+}
+#endif
+
+/**
+ * @brief Checkpoint the playlist position, nothing is written unless it moved and the interval passed or force is set
+ * - Track and frame are advanced by the decoder task; a checkpoint that reads them across a track change is
+ *   corrected by the next one.
+ */
+static void checkpoint_position(play_position_handle_t pos, playlist_handle_t pl, bool force) {
+    int track = playlist_get_current(pl);
+    if (pos && track >= 0) {
+        play_position_update(pos, track, playlist_get_frame(pl), force);
     }
-    file_marker.pos = 0;
 }
 
-int mp3_music_read_cb(audio_element_handle_t el, char *buf, int len, TickType_t wait_time, void *ctx) {
-    int read_size = file_marker.end - file_marker.start - file_marker.pos;
-    if (read_size == 0) {
-        return AEL_IO_DONE;
-    } else if (len < read_size) {
-        read_size = len;
+/**
+ * @brief Track change, runs in the mp3 decoder task when the first frame of a track is read
+ * - The decoder is not restarted between tracks, so the event loop is told the new track here.
+ * - ctx points to the event interface of app_main.
+ */
+static void on_track_changed(playlist_handle_t pl, int index, const mp3_frame_info_t *info, bool requested,
+                             void *ctx) {
+    latency_trace_track_changed(latency_trace);
+    if (requested) {
+        // [Mode] flushed the resampler's input, it plays again from this track's first byte
+        skip_resume_at = playlist_get_pcm_pos(pl);
     }
-    memcpy(buf, file_marker.start + file_marker.pos, read_size);
-    file_marker.pos += read_size;
-    return read_size;
+
+    audio_event_iface_msg_t msg = {
+        .cmd = index,
+        .source = (void *)pl,
+        .source_type = AUDIO_ELEMENT_TYPE_PLAYER,
+        .data = (void *)(intptr_t)info->sample_rate,
+        .data_len = info->channels,
+    };
+    audio_event_iface_cmd(*(audio_event_iface_handle_t *)ctx, &msg);
+}
+
+/**
+ * @brief Audio the i2s DMA plays on its own while a flash operation disables the cache
+ * - ctx is the i2s stream writer.
+ * - One DMA buffer is being played and may be nearly done, the others are full as long as the
+ *   ring buffer in front of the writer holds at least one more.
+ * - Returns -1 while the writer is not running, flash operations are free then.
+ */
+static int64_t i2s_headroom_us(void *ctx) {
+    audio_element_handle_t i2s = (audio_element_handle_t)ctx;
+    if (audio_element_get_state(i2s) != AEL_STATE_RUNNING) {
+        return -1;
+    }
+    audio_element_info_t info = {0};
+    audio_element_getinfo(i2s, &info);
+    int frame_bytes = info.channels * info.bits / 8;
+    if (frame_bytes <= 0 || info.sample_rates <= 0) {
+        return -1;
+    }
+    int64_t queued = rb_bytes_filled(i2s_input_rb) / frame_bytes;
+    int64_t frames = (I2S_DMA_BUF_COUNT - 2) * I2S_DMA_BUF_LEN + (queued < I2S_DMA_BUF_LEN ? queued : I2S_DMA_BUF_LEN);
+    return frames * 1000000 / info.sample_rates;
 }
 
 /**
@@ -202,6 +416,27 @@ uint8_t isFATFSCorrupted() {
     return isTestPass;
 }
 
+/**
+ * @brief Copy an embedded asset to /storage
+ * @return ESP_OK, ESP_FAIL if the file could not be written
+ */
+esp_err_t copyAssetToStorage(const embed_asset_t *asset, const char *path) {
+    FILE *fp = fopen(path, "wb");
+    if (!fp) {
+        ESP_LOGE(TAG, "failed to create file %s", path);
+        return ESP_FAIL;
+    }
+    size_t size = asset->end - asset->start;
+    size_t written = fwrite(asset->start, 1, size, fp);
+    fclose(fp);
+    if (written != size) {
+        ESP_LOGE(TAG, "failed to write %s, %d of %d bytes", path, (int)written, (int)size);
+        return ESP_FAIL;
+    }
+    ESP_LOGI(TAG, ">>> copied %s to %s, %d bytes", asset->name, path, (int)size);
+    return ESP_OK;
+}
+
 /**
  * @brief Mount FAT FS
  * @return wl_handle_t
@@ -220,6 +455,12 @@ wl_handle_t mountFATFS() {
         ESP_LOGE(TAG, "failed to mount FATFS");
     ESP_ERROR_CHECK(err);
     ESP_LOGI(TAG, ">>> mounted FAT FS");
+
+    // from here on FAT sectors are cached in PSRAM and flash I/O is scheduled around the i2s DMA headroom
+    sector_cache_cfg_t cacheConfig = SECTOR_CACHE_CFG_DEFAULT();
+    cacheConfig.slots = STORAGE_CACHE_SECTORS;
+    cacheConfig.flush_interval_ms = STORAGE_FLUSH_INTERVAL_MS;
+    ESP_ERROR_CHECK(storage_diskio_attach(wearCtx, flash_arbiter, &cacheConfig));
     return wearCtx;
 }
 
@@ -227,6 +468,8 @@ wl_handle_t mountFATFS() {
  * @brief Unmount FAT FS
  */
 void unmountFATFS(wl_handle_t wearCtx) {
+    // dirty cached sectors are written back here
+    storage_diskio_detach(wearCtx);
     esp_err_t err = esp_vfs_fat_spiflash_unmount(FATFS_MOUNT_DIR, wearCtx);
     if (err == ESP_ERR_INVALID_STATE)
         ESP_LOGE(TAG, "failed to unmount FATFS (ESP_ERR_INVALID_STATE), partition=%s", FATFS_PARTITION);
@@ -236,53 +479,182 @@ void unmountFATFS(wl_handle_t wearCtx) {
     ESP_LOGI(TAG, ">>> un-mounted FAT FS");
 }
 
-void eraseFATPartition() {
-    // find the storage partition
-    esp_partition_iterator_t it;
-    if (!(it = esp_partition_find(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_DATA_FAT, FATFS_PARTITION))) {
-        ESP_LOGE(TAG, ">>> partition not found, partition=%s", FATFS_PARTITION);
-        ESP_ERROR_CHECK(-1);
+/**
+ * @brief flash_arbiter_io_t of a raw partition, ctx is the esp_partition_t
+ */
+static esp_err_t partition_io(flash_op_t op, size_t addr, void *buf, size_t size, void *ctx) {
+    const esp_partition_t *part = (const esp_partition_t *)ctx;
+    switch (op) {
+    case FLASH_OP_READ:
+        return esp_partition_read(part, addr, buf, size);
+    case FLASH_OP_WRITE:
+        return esp_partition_write(part, addr, buf, size);
+    case FLASH_OP_ERASE:
+        return esp_partition_erase_range(part, addr, size);
+    default:
+        return ESP_ERR_INVALID_ARG;
     }
-    const esp_partition_t *FATPart = esp_partition_get(it);
-    esp_partition_iterator_release(it);
+}
 
-    // erase the partition
-    esp_err_t err;
+/**
+ * @brief play_log once boot_log has opened it, NULL before or without one
+ */
+static log_store_handle_t play_log_get(void) {
+    return __atomic_load_n(&play_log, __ATOMIC_ACQUIRE);
+}
+
+/**
+ * @brief Append a record to play_log, nothing without one
+ */
+static void play_log_append(uint8_t type, const void *rec, size_t len) {
+    log_store_handle_t log = play_log_get();
+    if (log) {
+        log_store_append(log, type, rec, len);
+    }
+}
+
+/**
+ * @brief Erase the storage partition, a chunk at a time through flash_arbiter
+ * - While audio plays each sector waits for the i2s headroom, playback goes on; the erase takes longer.
+ * - Otherwise 64 KiB blocks one after another, as esp_partition_erase_range() of the whole partition.
+ */
+esp_err_t eraseFATPartition() {
+    const esp_partition_t *FATPart =
+        esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_DATA_FAT, FATFS_PARTITION);
+    if (!FATPart) {
+        ESP_LOGE(TAG, ">>> partition not found, partition=%s", FATFS_PARTITION);
+        return ESP_ERR_NOT_FOUND;
+    }
+    partition_erase_cfg_t eraseConfig = PARTITION_ERASE_CFG_DEFAULT();
+    eraseConfig.arb = flash_arbiter;
+    eraseConfig.size = FATPart->size;
+    eraseConfig.io = partition_io;
+    eraseConfig.io_ctx = (void *)FATPart;
+    partition_erase_handle_t erase = partition_erase_create(&eraseConfig);
+    if (!erase) {
+        return ESP_ERR_NO_MEM;
+    }
     ESP_LOGI(TAG, "Erasing partition=%s....", FATFS_PARTITION);
-    if ((err = esp_partition_erase_range(FATPart, 0, FATPart->size))) {
-        ESP_LOGE(TAG, "esp_partition_erase_range() failed, err=%s", esp_err_to_name(err));
-        ESP_ERROR_CHECK(-1);
+    esp_err_t err = partition_erase_run(erase);
+    partition_erase_destroy(erase);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "erase of partition=%s failed, err=%s", FATFS_PARTITION, esp_err_to_name(err));
+        return err;
     }
     ESP_LOGI(TAG, "Erase partition OK, partition=%s", FATFS_PARTITION);
+    return ESP_OK;
+}
+
+static esp_err_t storage_mount(void *ctx) {
+    storage_wl = mountFATFS();
+    return ESP_OK;
+}
+
+static esp_err_t storage_unmount(void *ctx) {
+    unmountFATFS(storage_wl);
+    storage_wl = WL_INVALID_HANDLE;
+    return ESP_OK;
+}
+
+static esp_err_t storage_erase(void *ctx) {
+    return eraseFATPartition();
 }
 
 /**
- * @brief Init and mount FAT FS.
- * Before test, partition is erased.  This makes sure partition is clean and formatted before mount.
+ * @brief Whether the mounted FAT FS is sound: the root directory reads to its end and a file writes and reads back
  */
-void init_fatfs() {
-    // erase partition
-    eraseFATPartition();
+static esp_err_t storage_validate(void *ctx) {
+    DIR *dir = opendir(FATFS_MOUNT_DIR);
+    if (!dir) {
+        ESP_LOGE(TAG, "cannot open %s", FATFS_MOUNT_DIR);
+        return ESP_FAIL;
+    }
+    int entries = 0;
+    while (readdir(dir)) {
+        entries++;
+    }
+    closedir(dir);
+    ESP_LOGI(TAG, ">>> %s: %d entries", FATFS_MOUNT_DIR, entries);
+    return isFATFSCorrupted() ? ESP_OK : ESP_FAIL;
+}
 
-    // mount the FAT FS
-    wl_handle_t wearCtx = mountFATFS();
+#if PLAY_FROM_STORAGE
+/**
+ * @brief Copy the asset to STORAGE_MP3_FILE unless it is there already
+ */
+static esp_err_t storage_seed(void *ctx) {
+    const embed_asset_t *asset = &music_assets[STORAGE_SEED_ASSET];
+    struct stat st;
+    if (stat(STORAGE_MP3_FILE, &st) == 0 && st.st_size == asset->end - asset->start) {
+        return ESP_OK;
+    }
+    esp_err_t err = copyAssetToStorage(asset, STORAGE_MP3_FILE);
+    return err == ESP_OK ? storage_diskio_sync(storage_wl) : err;
+}
+#endif
+
+/**
+ * @brief Init and mount FAT FS.
+ * - FAST_BOOT mounts what is on the partition, worker() validates it later.
+ * - Otherwise the partition is erased first, it is clean and formatted at mount.
+ * - A boot step, audio from the embedded assets does not wait for it; flash_arbiter is created before.
+ */
+esp_err_t init_fatfs() {
+    storage_boot_cfg_t boot_cfg = {
+        .fast = FAST_BOOT,
+        .mount = storage_mount,
+        .unmount = storage_unmount,
+        .erase = storage_erase,
+        .validate = storage_validate,
+#if PLAY_FROM_STORAGE
+        .seed = storage_seed,
+#endif
+    };
+    return storage_boot_mount(&boot_cfg);
 }
 
 /**
  * @brief Task worker function to check FAT FS periodically
+ * - Once, a file written and read back after the boot validation.
+ * - Then the verifier reads a slice of the partition every tick, within VERIFY_BUDGET_BYTES_PER_S, and writes nothing.
  */
 void worker(void *ctx) {
     // wait for 5 sec before running FAT FS check
     ESP_LOGI(TAG, ">>> worker waiting to start..., priority=%d", uxTaskPriorityGet(NULL));
     vTaskDelay(5000 / portTICK_PERIOD_MS);
-    const uint16_t delayMs = 2000;
     ESP_LOGI(TAG, ">>> worker started");
-    while (1) {
-        if (!isFATFSCorrupted()) {
-            ESP_LOGE(TAG, ">>> stopped checking FAT FS");
+    // the fast boot left the FAT FS unchecked, nothing else writes to it yet
+    if (storage_boot_validate() != ESP_OK) {
+        ESP_LOGE(TAG, ">>> FAT FS could not be repaired");
+        foreverLoop();
+    }
+    storage_boot_report();
+    fat_verifier_cfg_t verifyConfig = FAT_VERIFIER_CFG_DEFAULT();
+    verifyConfig.budget_bytes_per_s = VERIFY_BUDGET_BYTES_PER_S;
+    ESP_ERROR_CHECK(storage_diskio_attach_verifier(storage_wl, &verifyConfig));
+    fat_verifier_handle_t verifier = storage_diskio_get_verifier(storage_wl);
+    for (uint32_t n = 1;; n++) {
+        esp_err_t err = fat_verifier_tick(verifier);
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, ">>> FAT FS check failed, err=%s; stopped checking FAT FS", esp_err_to_name(err));
+            fat_verifier_stats_t verifyStats;
+            fat_verifier_get_stats(verifier, &verifyStats);
+            play_log_error_t rec = {.err = err, .where = verifyStats.fault_sector};
+            play_log_append(PLAY_LOG_ERROR, &rec, sizeof(rec));
+            log_store_handle_t log = play_log_get();
+            if (log) {
+                log_store_sync(log);
+            }
+            fat_verifier_report(verifier);
+            flash_arbiter_report(flash_arbiter);
             foreverLoop();
         }
-        vTaskDelay(delayMs / portTICK_PERIOD_MS);
+        if (n % (20000 / VERIFY_TICK_MS) == 0) {
+            fat_verifier_report(verifier);
+            sector_cache_report(storage_diskio_get_cache(storage_wl));
+            flash_arbiter_report(flash_arbiter);
+        }
+        vTaskDelay(VERIFY_TICK_MS / portTICK_PERIOD_MS);
     }
 }
 
@@ -292,86 +664,658 @@ void worker(void *ctx) {
  */
 void createTaskCheckFATFS() {
     TaskHandle_t taskCtx;
-    const uint8_t cpuId = 0;
-    if (xTaskCreatePinnedToCore(worker, TASK_NAME, TASK_STACK_SIZE, NULL, TASK_PRIORITY, &taskCtx, cpuId) != pdPASS) {
+    int cpuId = 0;
+    int priority = TASK_PRIORITY;
+    int stackSize = TASK_STACK_SIZE;
+    task_placement_apply(TASK_NAME, &cpuId, &priority, &stackSize, NULL);
+    if (xTaskCreatePinnedToCore(worker, TASK_NAME, stackSize, NULL, priority, &taskCtx, cpuId) != pdPASS) {
         ESP_LOGE(TAG, ">>> failed creating task");
         foreverLoop();
     }
 }
 
-void app_main(void) {
-    audio_pipeline_handle_t pipeline;
-    audio_element_handle_t i2s_stream_writer, mp3_decoder;
+#if MEM_PLACEMENT
+// decoder state and i2s stay internal, the streamed ring buffers go to PSRAM; stacks are placed by task_table
+static const mem_placement_rule_t mem_rules[] = {
+    {.tag = "mp3", .ringbuf = MEM_REGION_PSRAM, .work = MEM_REGION_INTERNAL, .stack = MEM_REGION_ANY},
+    {.tag = "resample", .ringbuf = MEM_REGION_PSRAM, .work = MEM_REGION_INTERNAL, .stack = MEM_REGION_ANY},
+    {.tag = "gain", .ringbuf = MEM_REGION_PSRAM, .work = MEM_REGION_INTERNAL, .stack = MEM_REGION_ANY},
+    {.tag = "i2s", .ringbuf = MEM_REGION_ANY, .work = MEM_REGION_INTERNAL, .stack = MEM_REGION_ANY},
+};
+#endif
 
-    printConfig();
+// Every task the player spawns. The cores are what host/bench/bench_task_placement plans from a profile of the
+// old placement, decoder chain, i2s and FAT worker all on core 0: the decoder alone on core 1. With TASK_PROFILE a
+// plan from this board's own profile replaces them from the next boot on. The short stacks of the PCM stages go to
+// PSRAM, the decoder's and the i2s writer's stay internal.
+static task_placement_t task_table[] = {
+    {.name = "mp3", .cls = TASK_CLASS_AUDIO, .core = 1, .prio = 5, .stack = 5 * 1024, .stack_in_ext = false},
+    {.name = "resample", .cls = TASK_CLASS_AUDIO, .core = 0, .prio = 5, .stack = 3 * 1024, .stack_in_ext = true},
+    {.name = "gain", .cls = TASK_CLASS_AUDIO, .core = 0, .prio = 5, .stack = 2 * 1024, .stack_in_ext = true},
+    {.name = "i2s", .cls = TASK_CLASS_AUDIO, .core = 0, .prio = 23, .stack = 3 * 1024, .stack_in_ext = false},
+    {.name = "FATFS", .cls = TASK_CLASS_STORAGE, .core = 0, .prio = TASK_PRIORITY, .stack = TASK_STACK_SIZE},
+    {.name = "file_stream", .cls = TASK_CLASS_STORAGE, .core = 0, .prio = 4, .stack = 3072},
+    {.name = "storage_flush", .cls = TASK_CLASS_STORAGE, .core = TASK_PLACEMENT_ANY_CORE, .prio = 2, .stack = 3072},
+    {.name = "telemetry", .cls = TASK_CLASS_BACKGROUND, .core = 0, .prio = 2, .stack = 2048},
+};
+
+/**
+ * @brief Plan the cores of task_table from the profile, and keep the plan for the next boot if it moved any
+ * - Pinned tasks cannot move while they run.
+ */
+static void plan_task_placement(task_profiler_handle_t prof) {
+    task_load_t loads[TASK_PROFILER_MAX_TASKS];
+    int other[TASK_PLACEMENT_NUM_CORES];
+    task_profiler_stop(prof);
+    task_profiler_report(prof);
+    int n = task_profiler_get_loads(prof, loads, TASK_PROFILER_MAX_TASKS, other);
+    int moved = task_placement_plan(loads, n, other);
+    ESP_LOGI(TAG, "[ * ] Task placement: %d tasks moved for the next boot", moved);
+    if (moved) {
+        task_placement_report();
+        task_placement_save(TASK_PLACEMENT_NAMESPACE, flash_arbiter);
+    }
+}
+
+/**
+ * @brief What the input actions work on, the context of the dispatcher
+ */
+typedef struct {
+    player_pipeline_t       *player;
+    playlist_handle_t       playlist;
+    play_position_handle_t  position;
+    file_stream_handle_t    file_stream;
+    audio_board_handle_t    board;
+    input_dispatch_handle_t input;
+    int                     volume;
+    bool                    quit;
+} player_ctrl_t;
+
+/**
+ * @brief [Play]: start, pause and resume, and rewind a finished pipeline
+ */
+static void on_play(void *ctx, int arg, int count) {
+    player_ctrl_t *ctrl = (player_ctrl_t *)ctx;
+    player_pipeline_t *player = ctrl->player;
+    ESP_LOGI(TAG, "[ * ] [Play] touch tap event");
+    audio_element_state_t el_state = audio_element_get_state(player->sink);
+    switch (el_state) {
+    case AEL_STATE_INIT:
+        ESP_LOGI(TAG, "[ * ] Starting audio pipeline");
+        latency_trace_begin(latency_trace, LATENCY_CMD_PLAY);
+        audio_pipeline_run(player->pipeline);
+        latency_trace_api_done(latency_trace);
+        break;
+    case AEL_STATE_RUNNING:
+        ESP_LOGI(TAG, "[ * ] Pausing audio pipeline");
+        latency_trace_begin(latency_trace, LATENCY_CMD_PAUSE);
+        audio_pipeline_pause(player->pipeline);
+        latency_trace_api_done(latency_trace);
+        checkpoint_position(ctrl->position, ctrl->playlist, true);
+        break;
+    case AEL_STATE_PAUSED:
+        ESP_LOGI(TAG, "[ * ] Resuming audio pipeline");
+        latency_trace_begin(latency_trace, LATENCY_CMD_RESUME);
+        audio_pipeline_resume(player->pipeline);
+        latency_trace_api_done(latency_trace);
+        break;
+    case AEL_STATE_FINISHED:
+        ESP_LOGI(TAG, "[ * ] Rewinding audio pipeline");
+        latency_trace_begin(latency_trace, LATENCY_CMD_PLAY);
+        // ring buffers are only reset through ring buffer I/O, lift the taps meanwhile
+        latency_trace_detach(latency_trace);
+        if (telemetry) {
+            telemetry_detach(telemetry);
+        }
+        audio_pipeline_reset_ringbuffer(player->pipeline);
+        audio_pipeline_reset_elements(player->pipeline);
+        latency_trace_attach(latency_trace, player->mp3_decoder, player->resampler);
+        if (adaptive_buffer) {
+            adaptive_buffer_reset(adaptive_buffer);
+        }
+        if (telemetry) {
+            telemetry_attach(telemetry, player->sink);
+        }
+        audio_pipeline_change_state(player->pipeline, AEL_STATE_INIT);
+        if (ctrl->file_stream) {
+            file_stream_report(ctrl->file_stream);
+            file_stream_open(ctrl->file_stream, STORAGE_MP3_FILE);
+        } else {
+            playlist_skip(ctrl->playlist);
+        }
+        audio_pipeline_run(player->pipeline);
+        latency_trace_api_done(latency_trace);
+        break;
+    default:
+        ESP_LOGI(TAG, "[ * ] Not supported state %d", el_state);
+    }
+}
+
+/**
+ * @brief [Set]: leave the event loop and stop
+ */
+static void on_set(void *ctx, int arg, int count) {
+    ESP_LOGI(TAG, "[ * ] [Set] touch tap event");
+    ESP_LOGI(TAG, "[ * ] Stopping audio pipeline");
+    ((player_ctrl_t *)ctx)->quit = true;
+}
+
+/**
+ * @brief [Mode]: the next track
+ */
+static void on_mode(void *ctx, int arg, int count) {
+    player_ctrl_t *ctrl = (player_ctrl_t *)ctx;
+    ESP_LOGI(TAG, "[ * ] [mode] tap event");
+    if (ctrl->file_stream) {
+        ESP_LOGI(TAG, "[ * ] Playing %s, no next track", STORAGE_MP3_FILE);
+        return;
+    }
+    play_log_track_t rec = {.track = playlist_get_current(ctrl->playlist), .frame = playlist_get_frame(ctrl->playlist)};
+    play_log_append(PLAY_LOG_SKIP, &rec, sizeof(rec));
+    // switches at the next frame boundary, the pipeline keeps running; the old track's PCM queued in front of
+    // the resampler is dropped, only what is behind it still plays
+    latency_trace_begin(latency_trace, LATENCY_CMD_NEXT);
+    resample_input_flush(ctrl->player->resampler);
+    playlist_skip(ctrl->playlist);
+    latency_trace_api_done(latency_trace);
+}
+
+/**
+ * @brief [Vol+] and [Vol-], coalesced: the first press of a burst at once, then arg is the sum of the steps of the
+ *        presses after it, one codec update for all of them
+ */
+static void on_volume(void *ctx, int arg, int count) {
+    player_ctrl_t *ctrl = (player_ctrl_t *)ctx;
+    int volume = ctrl->volume + arg;
+    volume = volume < 0 ? 0 : volume > 100 ? 100 : volume;
+    if (volume != ctrl->volume) {
+        ctrl->volume = volume;
+        // from the first press it stands for, not from the end of the coalescing window
+        latency_trace_begin_at(latency_trace, LATENCY_CMD_VOLUME, input_dispatch_get_action_since(ctrl->input));
+        audio_hal_set_volume(ctrl->board->audio_hal, volume);
+        latency_trace_api_done(latency_trace);
+    }
+    ESP_LOGI(TAG, "[ * ] Volume set to %d %% (%d presses)", volume, count);
+}
+
+/**
+ * @brief Bind the keys for each source the board's keys report from; returns the number of bindings
+ * - Touch pads tap, buttons and ADC buttons press: the commands differ, the key ids are the board's.
+ * - A long press of Vol+/Vol- steps on until its long release.
+ */
+static int player_input_bindings(input_binding_t *b, int max) {
+    static const struct {
+        int source;
+        int press;
+        int long_press;
+        int long_release;
+    } sources[] = {
+        {PERIPH_ID_TOUCH, PERIPH_TOUCH_TAP, PERIPH_TOUCH_LONG_TAP, PERIPH_TOUCH_LONG_RELEASE},
+        {PERIPH_ID_BUTTON, PERIPH_BUTTON_PRESSED, PERIPH_BUTTON_LONG_PRESSED, PERIPH_BUTTON_LONG_RELEASE},
+        {PERIPH_ID_ADC_BTN, PERIPH_ADC_BUTTON_PRESSED, PERIPH_ADC_BUTTON_LONG_PRESSED, PERIPH_ADC_BUTTON_LONG_RELEASE},
+    };
+    int n = 0;
+    for (int i = 0; i < sizeof(sources) / sizeof(sources[0]); i++) {
+        int src = sources[i].source;
+        const input_binding_t keys[] = {
+            {src, sources[i].press, get_input_play_id(), on_play, 0, INPUT_DEBOUNCE_MS},
+            {src, sources[i].press, get_input_set_id(), on_set, 0},
+            {src, sources[i].press, get_input_mode_id(), on_mode, 0, INPUT_DEBOUNCE_MS},
+            {src, sources[i].press, get_input_volup_id(), on_volume, INPUT_VOLUME_STEP, 0, INPUT_COALESCE_MS},
+            {src, sources[i].press, get_input_voldown_id(), on_volume, -INPUT_VOLUME_STEP, 0, INPUT_COALESCE_MS},
+            {src, sources[i].long_press, get_input_volup_id(), on_volume, INPUT_VOLUME_STEP, 0, INPUT_COALESCE_MS,
+             INPUT_REPEAT_MS, sources[i].long_release},
+            {src, sources[i].long_press, get_input_voldown_id(), on_volume, -INPUT_VOLUME_STEP, 0, INPUT_COALESCE_MS,
+             INPUT_REPEAT_MS, sources[i].long_release},
+        };
+        for (int k = 0; k < sizeof(keys) / sizeof(keys[0]) && n < max; k++) {
+            b[n++] = keys[k];
+        }
+    }
+    return n;
+}
+
+/**
+ * @brief What the boot steps bring up, the context of the boot graph
+ */
+typedef struct {
+    player_pipeline_t           player;
+    playlist_handle_t           playlist;
+    play_position_handle_t      position;
+    file_stream_handle_t        file_stream;
+    audio_board_handle_t        board;
+    esp_periph_set_handle_t     set;
+    audio_element_handle_t      i2s_stream_writer;
+    audio_event_iface_handle_t  evt;
+} player_boot_t;
+
+static esp_err_t boot_nvs(void *ctx) {
     init_nvs();
-    init_fatfs();
-    createTaskCheckFATFS();
+    return ESP_OK;
+}
 
-    esp_log_level_set("*", ESP_LOG_WARN);
-    esp_log_level_set(TAG, ESP_LOG_INFO);
+static esp_err_t boot_placement(void *ctx) {
+    if (task_placement_restore(TASK_PLACEMENT_NAMESPACE) == ESP_OK) {
+        ESP_LOGI(TAG, ">>> task placement planned on a previous boot");
+    }
+    return ESP_OK;
+}
 
-    ESP_LOGI(TAG, "[ 0 ] program started");
+static esp_err_t boot_fatfs(void *ctx) {
+    return init_fatfs();
+}
 
+static esp_err_t boot_fat_check(void *ctx) {
+    createTaskCheckFATFS();
+    return ESP_OK;
+}
+
+static esp_err_t boot_board(void *ctx) {
+    player_boot_t *boot = (player_boot_t *)ctx;
     ESP_LOGI(TAG, "[ 1 ] Start audio codec chip");
-    audio_board_handle_t board_handle = audio_board_init();
-    audio_hal_ctrl_codec(board_handle->audio_hal, AUDIO_HAL_CODEC_MODE_BOTH, AUDIO_HAL_CTRL_START);
+    boot->board = audio_board_init();
+    AUDIO_NULL_CHECK(TAG, boot->board, return ESP_FAIL);
+    audio_hal_ctrl_codec(boot->board->audio_hal, AUDIO_HAL_CODEC_MODE_BOTH, AUDIO_HAL_CTRL_START);
+    return ESP_OK;
+}
 
-    int player_volume;
-    audio_hal_get_volume(board_handle->audio_hal, &player_volume);
+static esp_err_t boot_pipeline(void *ctx) {
+    player_boot_t *boot = (player_boot_t *)ctx;
+    audio_element_handle_t i2s_stream_writer, mp3_decoder;
 
     ESP_LOGI(TAG, "[ 2 ] Create audio pipeline, add all elements to pipeline, and subscribe pipeline event");
-    audio_pipeline_cfg_t pipeline_cfg = DEFAULT_AUDIO_PIPELINE_CONFIG();
-    pipeline = audio_pipeline_init(&pipeline_cfg);
-    mem_assert(pipeline);
+#if MEM_PLACEMENT
+    ESP_ERROR_CHECK(mem_placement_init(mem_rules, sizeof(mem_rules) / sizeof(mem_rules[0])));
+#endif
+    playlist_cfg_t playlist_cfg = PLAYLIST_CFG_DEFAULT();
+    playlist_cfg.on_track = on_track_changed;
+    playlist_cfg.cb_ctx = &boot->evt;
+#if PCM_CACHE_BUDGET
+    pcm_cache_cfg_t pcm_cache_cfg = PCM_CACHE_CFG_DEFAULT();
+    pcm_cache_cfg.budget_bytes = PCM_CACHE_BUDGET;
+    pcm_cache_cfg.max_track_bytes = PCM_CACHE_BUDGET;
+    pcm_cache = pcm_cache_create(&pcm_cache_cfg);
+    playlist_cfg.pcm_cache = pcm_cache;
+#endif
+    boot->playlist = playlist_create(music_assets, music_assets_count, &playlist_cfg);
+    mem_assert(boot->playlist);
 
-    ESP_LOGI(TAG, "[2.1] Create mp3 decoder to decode mp3 file and set custom read callback");
-    mp3_decoder_cfg_t mp3_cfg = DEFAULT_MP3_DECODER_CONFIG();
-    mp3_cfg.task_core = MP3_DECODER_CORE;
-    mp3_decoder = mp3_decoder_init(&mp3_cfg);
-    audio_element_set_read_cb(mp3_decoder, mp3_music_read_cb, NULL);
+#if PLAY_FROM_STORAGE
+    file_stream_cfg_t file_cfg = FILE_STREAM_CFG_DEFAULT();
+    task_placement_apply("file_stream", &file_cfg.task_core, &file_cfg.task_prio, &file_cfg.task_stack, NULL);
+    boot->file_stream = file_stream_create(&file_cfg);
+    mem_assert(boot->file_stream);
+#endif
 
-    ESP_LOGI(TAG, "[2.2] Create i2s stream to write data to codec chip");
+    ESP_LOGI(TAG, "[2.1] Create i2s stream to write data to codec chip");
     i2s_stream_cfg_t i2s_cfg = I2S_STREAM_CFG_DEFAULT();
     i2s_cfg.type = AUDIO_STREAM_WRITER;
+    i2s_cfg.i2s_config.dma_buf_count = I2S_DMA_BUF_COUNT;
+    i2s_cfg.i2s_config.dma_buf_len = I2S_DMA_BUF_LEN;
+    // the resampler feeds 16 bit stereo at one rate, the clock is set here once
+    i2s_cfg.i2s_config.sample_rate = OUTPUT_SAMPLE_RATE;
+    i2s_cfg.i2s_config.bits_per_sample = I2S_BITS_PER_SAMPLE_16BIT;
+    i2s_cfg.i2s_config.channel_format = I2S_CHANNEL_FMT_RIGHT_LEFT;
+    task_placement_apply("i2s", &i2s_cfg.task_core, &i2s_cfg.task_prio, &i2s_cfg.task_stack, &i2s_cfg.stack_in_ext);
+    i2s_cfg.stack_in_ext = mem_placement_stack_in_ext("i2s", i2s_cfg.task_stack, i2s_cfg.stack_in_ext);
+    mem_placement_begin("i2s", MEM_KIND_WORK);
+#if CONFIG_SPIRAM_USE_MALLOC
+    // CONFIG_SPIRAM_MALLOC_ALWAYSINTERNAL=50 would put the driver object the IRAM ISR reads in PSRAM
+    heap_caps_malloc_extmem_enable(I2S_DRIVER_ALWAYSINTERNAL);
+    i2s_stream_writer = i2s_stream_init(&i2s_cfg);
+    heap_caps_malloc_extmem_enable(CONFIG_SPIRAM_MALLOC_ALWAYSINTERNAL);
+#else
     i2s_stream_writer = i2s_stream_init(&i2s_cfg);
+#endif
+    mem_placement_end();
+    mem_assert(i2s_stream_writer);
+    audio_element_set_music_info(i2s_stream_writer, OUTPUT_SAMPLE_RATE, 2, 16);
+    boot->i2s_stream_writer = i2s_stream_writer;
 
-    ESP_LOGI(TAG, "[2.3] Register all elements to audio pipeline");
-    audio_pipeline_register(pipeline, mp3_decoder, "mp3");
-    audio_pipeline_register(pipeline, i2s_stream_writer, "i2s");
+#if TELEMETRY
+    if (telemetry_uart_open(TELEMETRY_UART_NUM, TELEMETRY_TX_PIN, TELEMETRY_BAUD) == ESP_OK) {
+        telemetry_cfg_t telemetry_cfg = TELEMETRY_CFG_DEFAULT();
+        // the writer comes back for input with all of the DMA queued
+        telemetry_cfg.dma_us = (int64_t)I2S_DMA_BUF_COUNT * I2S_DMA_BUF_LEN * 1000000 / OUTPUT_SAMPLE_RATE;
+        telemetry_cfg.out = telemetry_uart_write;
+        telemetry_cfg.out_ctx = (void *)(intptr_t)TELEMETRY_UART_NUM;
+        task_placement_apply("telemetry", &telemetry_cfg.task_core, &telemetry_cfg.task_prio, &telemetry_cfg.task_stack,
+                             NULL);
+        telemetry = telemetry_create(&telemetry_cfg);
+    }
+#endif
+#if ADAPTIVE_BUFFER
+    adaptive_buffer_cfg_t adaptive_cfg = ADAPTIVE_BUFFER_CFG_DEFAULT();
+    adaptive_cfg.max_bytes = ADAPTIVE_BUFFER_MAX;
+    if (telemetry) {
+        // without it the target still follows the near underruns
+        adaptive_cfg.underruns = telemetry_underruns;
+        adaptive_cfg.underruns_ctx = telemetry;
+    }
+    adaptive_buffer = adaptive_buffer_create(&adaptive_cfg);
+#endif
+
+    ESP_LOGI(TAG, "[2.2] Create mp3 decoder and link [playlist]-->mp3_decoder-->resampler-->gain-->i2s_stream-->[codec_chip]");
+    player_pipeline_cfg_t player_cfg = PLAYER_PIPELINE_CFG_DEFAULT();
+    player_cfg.output_rate = OUTPUT_SAMPLE_RATE;
+    player_cfg.soft_volume = SOFT_VOLUME;
+    if (adaptive_buffer) {
+        player_cfg.mp3_out_rb_size = ADAPTIVE_BUFFER_MAX;
+    }
+    if (boot->file_stream) {
+        // the reader task opens the file and reads ahead in sector-sized chunks
+        player_cfg.read_cb = file_stream_read_cb;
+        player_cfg.read_ctx = boot->file_stream;
+    } else {
+        player_cfg.read_cb = playlist_read_cb;
+        player_cfg.read_ctx = boot->playlist;
+    }
+    if (telemetry) {
+        // time the decoder waits for its input is taken out of the decode time
+        telemetry_set_source(telemetry, player_cfg.read_cb, player_cfg.read_ctx);
+        player_cfg.read_cb = telemetry_read_cb;
+        player_cfg.read_ctx = telemetry;
+    }
+    ESP_ERROR_CHECK(player_pipeline_create(&boot->player, &player_cfg, i2s_stream_writer));
+    mp3_decoder = boot->player.mp3_decoder;
+    // the last element's output, the latency trace taps the ring buffer in front of the resampler
+    i2s_input_rb = audio_element_get_input_ringbuf(i2s_stream_writer);
+    if (telemetry) {
+        // the decoder's output and the i2s writer's input, before the taps take them over
+        telemetry_watch_ringbuf(telemetry, audio_element_get_output_ringbuf(mp3_decoder));
+        telemetry_watch_ringbuf(telemetry, i2s_input_rb);
+        ESP_ERROR_CHECK(telemetry_attach(telemetry, i2s_stream_writer));
+    }
+    flash_arbiter_set_headroom(flash_arbiter, i2s_headroom_us, i2s_stream_writer);
 
-    ESP_LOGI(TAG, "[2.4] Link it together [mp3_music_read_cb]-->mp3_decoder-->i2s_stream-->[codec_chip]");
-    const char *link_tag[2] = {"mp3", "i2s"};
-    audio_pipeline_link(pipeline, &link_tag[0], 2);
+    ESP_LOGI(TAG, "[2.3] Trace control latency between mp3_decoder and the resampler in front of i2s_stream");
+    latency_trace = latency_trace_create();
+    mem_assert(latency_trace);
+    ESP_ERROR_CHECK(latency_trace_attach(latency_trace, mp3_decoder, boot->player.resampler));
+    // what is queued behind the resampler plays first: I2S is when the new state reaches i2s_stream
+    latency_trace_watch_ringbuf(latency_trace, audio_element_get_output_ringbuf(boot->player.resampler),
+                                boot->player.resampler);
+    if (boot->player.gain) {
+        latency_trace_watch_ringbuf(latency_trace, i2s_input_rb, boot->player.gain);
+    }
+#if SOFT_VOLUME
+    // the codec's DAC stays put, a volume command is done when the gain applies it
+    latency_trace_set_volume_end(latency_trace, LATENCY_POINT_GAIN);
+    sw_gain_set_applied_cb(boot->player.gain, on_gain_applied, latency_trace);
+#endif
+    if (!boot->file_stream) {
+        latency_trace_set_source(latency_trace, playlist_source_pos, boot->playlist);
+    }
+    // tracks are recorded from the decoder output the trace taps, and the resampler follows its format
+    latency_trace_set_output_cb(latency_trace, on_decoder_output, &boot->player);
+    if (adaptive_buffer) {
+        latency_trace_set_write_gate(latency_trace, adaptive_write_gate, adaptive_buffer);
+    }
 
+    ESP_LOGI(TAG, "[4.1] Listening event from all elements of pipeline");
+    player_pipeline_set_listener(&boot->player, boot->evt);
+    return ESP_OK;
+}
+
+/**
+ * @brief Seek the playlist to the last checkpoint, NVS writes go through the arbiter like /storage
+ */
+static esp_err_t boot_resume(void *ctx) {
+    player_boot_t *boot = (player_boot_t *)ctx;
+    if (boot->file_stream) {
+        return ESP_OK;
+    }
+    play_position_cfg_t position_cfg = PLAY_POSITION_CFG_DEFAULT();
+    position_cfg.interval_ms = POSITION_CHECKPOINT_MS;
+    position_cfg.arbiter = flash_arbiter;
+    boot->position = play_position_create(&position_cfg, music_assets, music_assets_count);
+    int track;
+    uint32_t frame;
+    if (boot->position && play_position_load(boot->position, &track, &frame) == ESP_OK) {
+        const mp3_index_t *index = music_assets[track].index;
+        uint32_t ms = index ? mp3_index_frame_ms(index, frame) : 0;
+        ESP_LOGI(TAG, "[2.0] Resume track %d (%s) at %u ms", track, music_assets[track].name, ms);
+        playlist_seek(boot->playlist, track, ms);
+    }
+    return ESP_OK;
+}
+
+/**
+ * @brief Open play_log and log the play counts in it
+ */
+static esp_err_t boot_log(void *ctx) {
+#if PLAY_LOG
+    const esp_partition_t *part = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, PLAY_LOG_SUBTYPE,
+                                                           PLAY_LOG_PARTITION);
+    if (!part) {
+        ESP_LOGW(TAG, "no %s partition, plays are not logged", PLAY_LOG_PARTITION);
+        return ESP_OK;
+    }
+    log_store_cfg_t log_cfg = LOG_STORE_CFG_DEFAULT();
+    log_cfg.size = part->size;
+    log_cfg.arbiter = flash_arbiter;
+    log_cfg.io = partition_io;
+    log_cfg.io_ctx = (void *)part;
+    log_store_handle_t log = log_store_open(&log_cfg);
+    AUDIO_NULL_CHECK(TAG, log, return ESP_FAIL);
+    uint32_t plays[music_assets_count];
+    uint32_t skips[music_assets_count];
+    uint32_t errors = 0;
+    memset(plays, 0, sizeof(plays));
+    memset(skips, 0, sizeof(skips));
+    log_store_iter_handle_t it = log_store_iter_create(log);
+    log_record_t rec;
+    while (it && log_store_iter_next(it, &rec) == ESP_OK) {
+        play_log_track_t t;
+        if ((rec.type == PLAY_LOG_PLAY || rec.type == PLAY_LOG_SKIP) && rec.len == sizeof(t)) {
+            memcpy(&t, rec.data, sizeof(t));
+            if (t.track < music_assets_count) {
+                (rec.type == PLAY_LOG_PLAY ? plays : skips)[t.track]++;
+            }
+        } else if (rec.type == PLAY_LOG_ERROR) {
+            errors++;
+        }
+    }
+    log_store_iter_destroy(it);
+    for (int i = 0; i < music_assets_count; i++) {
+        ESP_LOGI(TAG, "[2.1] %s: played %u times, skipped %u", music_assets[i].name, plays[i], skips[i]);
+    }
+    ESP_LOGI(TAG, "[2.1] %u errors logged", errors);
+    // the boot_log step runs in a boot graph task while the event loop and the FAT worker may already read it
+    __atomic_store_n(&play_log, log, __ATOMIC_RELEASE);
+#endif
+    return ESP_OK;
+}
+
+static esp_err_t boot_keys(void *ctx) {
+    player_boot_t *boot = (player_boot_t *)ctx;
     ESP_LOGI(TAG, "[ 3 ] Initialize peripherals");
     esp_periph_config_t periph_cfg = DEFAULT_ESP_PERIPH_SET_CONFIG();
-    esp_periph_set_handle_t set = esp_periph_set_init(&periph_cfg);
+    boot->set = esp_periph_set_init(&periph_cfg);
+    AUDIO_NULL_CHECK(TAG, boot->set, return ESP_FAIL);
 
     ESP_LOGI(TAG, "[3.1] Initialize keys on board");
-    audio_board_key_init(set);
+    audio_board_key_init(boot->set);
 
+    ESP_LOGI(TAG, "[4.2] Listening event from peripherals");
+    audio_event_iface_set_listener(esp_periph_set_get_event_iface(boot->set), boot->evt);
+    return ESP_OK;
+}
+
+static esp_err_t boot_play(void *ctx) {
+    player_boot_t *boot = (player_boot_t *)ctx;
+#if SOFT_VOLUME
+    // called back at once with the codec's current volume, and on every audio_hal_set_volume() after
+    ESP_ERROR_CHECK(new_codec_set_volume_cb(on_codec_volume, boot->player.gain));
+#endif
+    ESP_LOGI(TAG, "[ 5.1 ] Start audio_pipeline");
+    if (boot->file_stream) {
+        file_stream_open(boot->file_stream, STORAGE_MP3_FILE);
+    }
+    return audio_pipeline_run(boot->player.pipeline);
+}
+
+enum {
+    STEP_NVS,
+    STEP_PLACEMENT,
+    STEP_FATFS,
+    STEP_FAT_CHECK,
+    STEP_BOARD,
+    STEP_PIPELINE,
+    STEP_RESUME,
+    STEP_KEYS,
+    STEP_LOG,
+    STEP_PLAY,
+    NUM_BOOT_STEPS,
+};
+
+// The audio from the embedded assets waits for NVS, it holds the task placement and the position to resume at,
+// not for the FAT FS: mounting, and with FAST_BOOT 0 erasing, runs on the other core meanwhile. The codec is
+// started before the pipeline runs.
+static const boot_step_t boot_steps[NUM_BOOT_STEPS] = {
+    [STEP_NVS] = {"nvs", boot_nvs, 0, BOOT_GRAPH_ANY_CORE},
+    [STEP_PLACEMENT] = {"placement", boot_placement, BOOT_GRAPH_DEP(STEP_NVS), BOOT_GRAPH_ANY_CORE},
+    [STEP_FATFS] = {"fatfs", boot_fatfs, 0, BOOT_GRAPH_ANY_CORE},
+    [STEP_FAT_CHECK] = {"fat_check", boot_fat_check, BOOT_GRAPH_DEP(STEP_FATFS) | BOOT_GRAPH_DEP(STEP_PLACEMENT),
+                        BOOT_GRAPH_ANY_CORE},
+    [STEP_BOARD] = {"board", boot_board, 0, BOOT_GRAPH_ANY_CORE},
+    [STEP_PIPELINE] = {"pipeline", boot_pipeline, BOOT_GRAPH_DEP(STEP_PLACEMENT), BOOT_GRAPH_ANY_CORE},
+    [STEP_RESUME] = {"resume", boot_resume, BOOT_GRAPH_DEP(STEP_NVS) | BOOT_GRAPH_DEP(STEP_PIPELINE),
+                     BOOT_GRAPH_ANY_CORE},
+    [STEP_KEYS] = {"keys", boot_keys, 0, BOOT_GRAPH_ANY_CORE},
+    [STEP_LOG] = {"log", boot_log, 0, BOOT_GRAPH_ANY_CORE},
+    [STEP_PLAY] = {"play", boot_play, BOOT_GRAPH_DEP(STEP_BOARD) | BOOT_GRAPH_DEP(STEP_PIPELINE) |
+                   BOOT_GRAPH_DEP(STEP_RESUME)
+#if PLAY_FROM_STORAGE
+                   | BOOT_GRAPH_DEP(STEP_FATFS)
+#endif
+                   , BOOT_GRAPH_ANY_CORE},
+};
+
+void app_main(void) {
+    player_boot_t boot = {0};
+    playlist_handle_t playlist;
+    play_position_handle_t position;
+    file_stream_handle_t file_stream;
+    audio_event_iface_handle_t evt;
+    audio_pipeline_handle_t pipeline;
+    audio_element_handle_t mp3_decoder;
+
+    printConfig();
+    esp_log_level_set("*", ESP_LOG_WARN);
+    esp_log_level_set(TAG, ESP_LOG_INFO);
+    esp_log_level_set("BOOT_GRAPH", ESP_LOG_INFO);
+    esp_log_level_set("STORAGE_BOOT", ESP_LOG_INFO);
+    esp_log_level_set("LATENCY_TRACE", ESP_LOG_INFO);
+    esp_log_level_set("FLASH_ARBITER", ESP_LOG_INFO);
+    esp_log_level_set("SECTOR_CACHE", ESP_LOG_INFO);
+    esp_log_level_set("PLAY_POSITION", ESP_LOG_INFO);
+    esp_log_level_set("LOG_STORE", ESP_LOG_INFO);
+    esp_log_level_set("PCM_CACHE", ESP_LOG_INFO);
+    esp_log_level_set("RESAMPLE", ESP_LOG_INFO);
+    esp_log_level_set("SW_GAIN", ESP_LOG_INFO);
+    esp_log_level_set("MEM_PLACEMENT", ESP_LOG_INFO);
+    esp_log_level_set("ADAPTIVE_BUFFER", ESP_LOG_INFO);
+    esp_log_level_set("TASK_PLACEMENT", ESP_LOG_INFO);
+    esp_log_level_set("TASK_PROFILER", ESP_LOG_INFO);
+
+#if RESAMPLE_BENCH
+    resample_benchmark();
+#endif
+
+    ESP_LOGI(TAG, "[ 0 ] program started");
+    ESP_ERROR_CHECK(task_placement_init(task_table, sizeof(task_table) / sizeof(task_table[0])));
+    // NVS position checkpoints and the FAT FS both write through it
+    flash_arbiter_cfg_t arbiter_cfg = FLASH_ARBITER_CFG_DEFAULT();
+    arbiter_cfg.unit_size = CONFIG_WL_SECTOR_SIZE;
+    arbiter_cfg.idle_window_size = STORAGE_ERASE_BLOCK;
+    flash_arbiter = flash_arbiter_create(&arbiter_cfg);
+    mem_assert(flash_arbiter);
     ESP_LOGI(TAG, "[ 4 ] Set up  event listener");
     audio_event_iface_cfg_t evt_cfg = AUDIO_EVENT_IFACE_DEFAULT_CFG();
-    audio_event_iface_handle_t evt = audio_event_iface_init(&evt_cfg);
+    boot.evt = audio_event_iface_init(&evt_cfg);
+    mem_assert(boot.evt);
 
-    ESP_LOGI(TAG, "[4.1] Listening event from all elements of pipeline");
-    audio_pipeline_set_listener(pipeline, evt);
+    // the steps run on both cores as their dependencies are done, the timeline is logged when the last one ends
+    boot_graph_cfg_t graph_cfg = BOOT_GRAPH_CFG_DEFAULT();
+    graph_cfg.steps = boot_steps;
+    graph_cfg.num_steps = NUM_BOOT_STEPS;
+    graph_cfg.ctx = &boot;
+    boot_graph_handle_t graph = boot_graph_create(&graph_cfg);
+    mem_assert(graph);
+    // play may reach its first audio before fatfs mounts
+    storage_boot_reset();
+    ESP_ERROR_CHECK(boot_graph_start(graph));
+    ESP_ERROR_CHECK(boot_graph_wait(graph, BOOT_GRAPH_DEP(STEP_PLAY) | BOOT_GRAPH_DEP(STEP_KEYS) | BOOT_GRAPH_DEP(STEP_LOG),
+                                    portMAX_DELAY));
+    playlist = boot.playlist;
+    position = boot.position;
+    file_stream = boot.file_stream;
+    evt = boot.evt;
+    pipeline = boot.player.pipeline;
+    mp3_decoder = boot.player.mp3_decoder;
+#if MEM_PLACEMENT
+    bool mem_reported = false;
+#endif
 
-    ESP_LOGI(TAG, "[4.2] Listening event from peripherals");
-    audio_event_iface_set_listener(esp_periph_set_get_event_iface(set), evt);
+    player_ctrl_t ctrl = {
+        .player = &boot.player,
+        .board = boot.board,
+    };
+    audio_hal_get_volume(boot.board->audio_hal, &ctrl.volume);
 
     ESP_LOGW(TAG, "[ 5 ] Tap touch buttons to control music player:");
     ESP_LOGW(TAG, "      [Play] to start, pause and resume, [Set] to stop.");
-    ESP_LOGW(TAG, "      [Vol-] or [Vol+] to adjust volume.");
+    ESP_LOGW(TAG, "      [Vol-] or [Vol+] to adjust volume, hold to keep stepping.");
+    ESP_LOGW(TAG, "      [Mode] to skip to the next track.");
 
-    ESP_LOGI(TAG, "[ 5.1 ] Start audio_pipeline");
-    set_next_file_marker();
-    audio_pipeline_run(pipeline);
+    task_profiler_handle_t profiler = NULL;
+#if TASK_PROFILE
+    task_profiler_cfg_t profiler_cfg = TASK_PROFILER_CFG_DEFAULT();
+    profiler = task_profiler_create(&profiler_cfg);
+    if (profiler && task_profiler_start(profiler) != ESP_OK) {
+        task_profiler_destroy(profiler);
+        profiler = NULL;
+    }
+    int64_t profile_until = esp_timer_get_time() + TASK_PROFILE_MS * 1000LL;
+#endif
 
-    while (1) {
+    input_binding_t bindings[INPUT_DISPATCH_MAX_BINDINGS];
+    input_dispatch_cfg_t input_cfg = {
+        .bindings = bindings,
+        .num_bindings = player_input_bindings(bindings, INPUT_DISPATCH_MAX_BINDINGS),
+        .ctx = &ctrl,
+    };
+    ctrl.playlist = playlist;
+    ctrl.position = position;
+    ctrl.file_stream = file_stream;
+    input_dispatch_handle_t input = input_dispatch_create(&input_cfg);
+    mem_assert(input);
+    ctrl.input = input;
+
+    while (!ctrl.quit) {
+        // coalesced volume updates and key repeats are due from the dispatcher, it decides how long to wait
+        int wait_ms = input_dispatch_poll(input);
+        if (ctrl.quit) {
+            break;
+        }
+        if (wait_ms < 0 || wait_ms > POSITION_CHECKPOINT_MS) {
+            wait_ms = POSITION_CHECKPOINT_MS;
+        }
         audio_event_iface_msg_t msg;
-        esp_err_t ret = audio_event_iface_listen(evt, &msg, portMAX_DELAY);
+        esp_err_t ret = audio_event_iface_listen(evt, &msg, pdMS_TO_TICKS(wait_ms + portTICK_PERIOD_MS - 1));
+        checkpoint_position(position, playlist, false);
+        log_store_handle_t log = play_log_get();
+        if (log) {
+            log_store_flush_expired(log);
+        }
+#if TASK_PROFILE
+        if (profiler && esp_timer_get_time() >= profile_until) {
+            plan_task_placement(profiler);
+            task_profiler_destroy(profiler);
+            profiler = NULL;
+        }
+#endif
         if (ret != ESP_OK) {
             continue;
         }
@@ -381,87 +1325,91 @@ void app_main(void) {
             audio_element_getinfo(mp3_decoder, &music_info);
             ESP_LOGI(TAG, "[ * ] Receive music info from mp3 decoder, sample_rates=%d, bits=%d, ch=%d",
                      music_info.sample_rates, music_info.bits, music_info.channels);
-            audio_element_setinfo(i2s_stream_writer, &music_info);
-            i2s_stream_set_clk(i2s_stream_writer, music_info.sample_rates, music_info.bits, music_info.channels);
+#if MEM_PLACEMENT
+            // the decoder has opened by now, everything the elements allocate is in place
+            if (!mem_reported) {
+                mem_placement_report();
+                mem_reported = true;
+            }
+#endif
             continue;
         }
 
-        if ((msg.source_type == PERIPH_ID_TOUCH || msg.source_type == PERIPH_ID_BUTTON || msg.source_type == PERIPH_ID_ADC_BTN) && (msg.cmd == PERIPH_TOUCH_TAP || msg.cmd == PERIPH_BUTTON_PRESSED || msg.cmd == PERIPH_ADC_BUTTON_PRESSED)) {
-            if ((int)msg.data == get_input_play_id()) {
-                ESP_LOGI(TAG, "[ * ] [Play] touch tap event");
-                audio_element_state_t el_state = audio_element_get_state(i2s_stream_writer);
-                switch (el_state) {
-                case AEL_STATE_INIT:
-                    ESP_LOGI(TAG, "[ * ] Starting audio pipeline");
-                    audio_pipeline_run(pipeline);
-                    break;
-                case AEL_STATE_RUNNING:
-                    ESP_LOGI(TAG, "[ * ] Pausing audio pipeline");
-                    audio_pipeline_pause(pipeline);
-                    break;
-                case AEL_STATE_PAUSED:
-                    ESP_LOGI(TAG, "[ * ] Resuming audio pipeline");
-                    audio_pipeline_resume(pipeline);
-                    break;
-                case AEL_STATE_FINISHED:
-                    ESP_LOGI(TAG, "[ * ] Rewinding audio pipeline");
-                    audio_pipeline_reset_ringbuffer(pipeline);
-                    audio_pipeline_reset_elements(pipeline);
-                    audio_pipeline_change_state(pipeline, AEL_STATE_INIT);
-                    set_next_file_marker();
-                    audio_pipeline_run(pipeline);
-                    break;
-                default:
-                    ESP_LOGI(TAG, "[ * ] Not supported state %d", el_state);
-                }
-            } else if ((int)msg.data == get_input_set_id()) {
-                ESP_LOGI(TAG, "[ * ] [Set] touch tap event");
-                ESP_LOGI(TAG, "[ * ] Stopping audio pipeline");
-                break;
-            } else if ((int)msg.data == get_input_mode_id()) {
-                ESP_LOGI(TAG, "[ * ] [mode] tap event");
-                audio_pipeline_stop(pipeline);
-                audio_pipeline_wait_for_stop(pipeline);
-                audio_pipeline_terminate(pipeline);
-                audio_pipeline_reset_ringbuffer(pipeline);
-                audio_pipeline_reset_elements(pipeline);
-                set_next_file_marker();
-                audio_pipeline_run(pipeline);
-            } else if ((int)msg.data == get_input_volup_id()) {
-                ESP_LOGI(TAG, "[ * ] [Vol+] touch tap event");
-                player_volume += 10;
-                if (player_volume > 100) {
-                    player_volume = 100;
-                }
-                audio_hal_set_volume(board_handle->audio_hal, player_volume);
-                ESP_LOGI(TAG, "[ * ] Volume set to %d %%", player_volume);
-            } else if ((int)msg.data == get_input_voldown_id()) {
-                ESP_LOGI(TAG, "[ * ] [Vol-] touch tap event");
-                player_volume -= 10;
-                if (player_volume < 0) {
-                    player_volume = 0;
-                }
-                audio_hal_set_volume(board_handle->audio_hal, player_volume);
-                ESP_LOGI(TAG, "[ * ] Volume set to %d %%", player_volume);
-            }
+        if (msg.source_type == AUDIO_ELEMENT_TYPE_PLAYER && msg.source == (void *)playlist) {
+            // the resampler switches at the track's first sample, i2s keeps its clock
+            ESP_LOGI(TAG, "[ * ] Track %d (%s), sample_rates=%d, ch=%d", msg.cmd, music_assets[msg.cmd].name,
+                     (int)(intptr_t)msg.data, msg.data_len);
+            play_log_track_t rec = {.track = msg.cmd, .frame = playlist_get_frame(playlist)};
+            play_log_append(PLAY_LOG_PLAY, &rec, sizeof(rec));
+            continue;
+        }
+
+        if (msg.source_type == PERIPH_ID_TOUCH || msg.source_type == PERIPH_ID_BUTTON || msg.source_type == PERIPH_ID_ADC_BTN) {
+            input_dispatch_event(input, msg.source_type, msg.cmd, (int)msg.data);
         }
     }
 
     ESP_LOGI(TAG, "[ 6 ] Stop audio_pipeline");
-    audio_pipeline_stop(pipeline);
-    audio_pipeline_wait_for_stop(pipeline);
-    audio_pipeline_terminate(pipeline);
-    audio_pipeline_unregister(pipeline, mp3_decoder);
-    audio_pipeline_unregister(pipeline, i2s_stream_writer);
-
-    /* Terminate the pipeline before removing the listener */
-    audio_pipeline_remove_listener(pipeline);
+    // the storage steps may still be running, they work on boot
+    boot_graph_wait(graph, BOOT_GRAPH_DEP(NUM_BOOT_STEPS) - 1, portMAX_DELAY);
+    boot_graph_destroy(graph);
+    checkpoint_position(position, playlist, true);
+    if (position) {
+        play_position_report(position);
+    }
+    log_store_handle_t log = play_log_get();
+    if (log) {
+        log_store_sync(log);
+        log_store_report(log);
+    }
+    latency_trace_report(latency_trace);
+    input_dispatch_stats_t input_stats;
+    input_dispatch_get_stats(input, &input_stats);
+    ESP_LOGI(TAG, "input: %u events, %u actions, %u coalesced, %u debounced, %u repeats", input_stats.events,
+             input_stats.actions, input_stats.coalesced, input_stats.debounced, input_stats.repeats);
+    input_dispatch_destroy(input);
+    if (pcm_cache) {
+        pcm_cache_report(pcm_cache);
+    }
+    if (file_stream) {
+        file_stream_report(file_stream);
+    }
+    flash_arbiter_report(flash_arbiter);
+    if (adaptive_buffer) {
+        adaptive_buffer_stats_t ab_stats;
+        adaptive_buffer_get_stats(adaptive_buffer, &ab_stats);
+        ESP_LOGI(TAG, "decoder buffer target %d bytes, peak %d, %u grows, %u shrinks, held back %lld ms",
+                 ab_stats.target, ab_stats.target_peak, ab_stats.grows, ab_stats.shrinks,
+                 ab_stats.gate_wait_us / 1000);
+    }
+    if (profiler) {
+        task_profiler_stop(profiler);
+        task_profiler_report(profiler);
+        task_profiler_destroy(profiler);
+    }
+    latency_trace_detach(latency_trace);
+    if (telemetry) {
+        telemetry_detach(telemetry);
+    }
+    flash_arbiter_set_headroom(flash_arbiter, NULL, NULL);
+    player_pipeline_stop(&boot.player);
 
     /* Make sure audio_pipeline_remove_listener is called before destroying event_iface */
     audio_event_iface_destroy(evt);
 
     /* Release all resources */
-    audio_pipeline_deinit(pipeline);
-    audio_element_deinit(i2s_stream_writer);
-    audio_element_deinit(mp3_decoder);
+    player_pipeline_destroy(&boot.player);
+    playlist_destroy(playlist);
+    pcm_cache_destroy(pcm_cache);
+    play_position_destroy(position);
+    // play_log stays open, as flash_arbiter: the FAT worker runs on and may log an error after [Set]
+    file_stream_destroy(file_stream);
+    latency_trace_destroy(latency_trace);
+    adaptive_buffer_destroy(adaptive_buffer);
+    adaptive_buffer = NULL;
+    if (telemetry) {
+        telemetry_destroy(telemetry);
+        telemetry = NULL;
+        telemetry_uart_close(TELEMETRY_UART_NUM);
+    }
 }
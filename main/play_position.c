@@ -0,0 +1,151 @@
+/* Playback position checkpoints in NVS, for resuming after a reset
+
+   This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "nvs.h"
+#include "audio_mem.h"
+#include "audio_error.h"
+#include "play_position.h"
+
+static const char *TAG = "PLAY_POSITION";
+
+// record: version 63..56, tag 47..32, track 31..24, frame 23..0
+#define RECORD_VERSION      1ULL
+#define RECORD_MAX_FRAME    0xFFFFFF
+// an NVS write may erase a page on the way: schedule it as a sector erase
+#define NVS_SECTOR_SIZE     4096
+
+struct play_position {
+    play_position_cfg_t cfg;
+    const embed_asset_t *tracks;
+    int num_tracks;
+    nvs_handle_t nvs;
+    uint64_t stored;        // record on flash, 0 if none
+    int64_t stored_us;
+    play_position_stats_t stats;
+};
+
+/**
+ * @brief 16-bit FNV-1a of the track's name and size
+ */
+static uint16_t track_tag(const embed_asset_t *track) {
+    uint32_t h = 2166136261u;
+    for (const char *c = track->name; *c; c++) {
+        h = (h ^ (uint8_t)*c) * 16777619u;
+    }
+    uint32_t size = track->end - track->start;
+    for (int i = 0; i < 4; i++) {
+        h = (h ^ ((size >> (8 * i)) & 0xFF)) * 16777619u;
+    }
+    return (uint16_t)(h ^ (h >> 16));
+}
+
+static uint64_t pack(play_position_handle_t pos, int track, uint32_t frame) {
+    if (frame > RECORD_MAX_FRAME) {
+        frame = RECORD_MAX_FRAME;
+    }
+    return RECORD_VERSION << 56 | (uint64_t)track_tag(&pos->tracks[track]) << 32 | (uint64_t)track << 24 | frame;
+}
+
+static esp_err_t write_record(flash_op_t op, size_t addr, void *buf, size_t size, void *ctx) {
+    play_position_handle_t pos = (play_position_handle_t)ctx;
+    esp_err_t err = nvs_set_u64(pos->nvs, pos->cfg.key, *(uint64_t *)buf);
+    return err == ESP_OK ? nvs_commit(pos->nvs) : err;
+}
+
+play_position_handle_t play_position_create(const play_position_cfg_t *cfg, const embed_asset_t *tracks,
+                                            int num_tracks) {
+    AUDIO_NULL_CHECK(TAG, cfg && tracks, return NULL);
+    if (num_tracks <= 0 || num_tracks > 256) {
+        ESP_LOGE(TAG, "%d tracks do not fit the record", num_tracks);
+        return NULL;
+    }
+    play_position_handle_t pos = audio_calloc(1, sizeof(struct play_position));
+    AUDIO_MEM_CHECK(TAG, pos, return NULL);
+    pos->cfg = *cfg;
+    pos->tracks = tracks;
+    pos->num_tracks = num_tracks;
+    esp_err_t err = nvs_open(cfg->nvs_namespace, NVS_READWRITE, &pos->nvs);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "nvs_open(%s) failed, %s", cfg->nvs_namespace, esp_err_to_name(err));
+        audio_free(pos);
+        return NULL;
+    }
+    return pos;
+}
+
+void play_position_destroy(play_position_handle_t pos) {
+    if (!pos) {
+        return;
+    }
+    nvs_close(pos->nvs);
+    audio_free(pos);
+}
+
+esp_err_t play_position_load(play_position_handle_t pos, int *track, uint32_t *frame) {
+    AUDIO_NULL_CHECK(TAG, pos && track && frame, return ESP_ERR_INVALID_ARG);
+    uint64_t rec;
+    if (nvs_get_u64(pos->nvs, pos->cfg.key, &rec) != ESP_OK) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    // stored either way: rewriting it would only cost an entry
+    pos->stored = rec;
+    int t = (rec >> 24) & 0xFF;
+    if (rec >> 56 != RECORD_VERSION || t >= pos->num_tracks || ((rec >> 32) & 0xFFFF) != track_tag(&pos->tracks[t])) {
+        ESP_LOGW(TAG, "record %016llx does not match the track table", (unsigned long long)rec);
+        return ESP_ERR_NOT_FOUND;
+    }
+    *track = t;
+    *frame = rec & RECORD_MAX_FRAME;
+    return ESP_OK;
+}
+
+esp_err_t play_position_update(play_position_handle_t pos, int track, uint32_t frame, bool force) {
+    AUDIO_NULL_CHECK(TAG, pos, return ESP_ERR_INVALID_ARG);
+    if (track < 0 || track >= pos->num_tracks) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    pos->stats.updates++;
+    uint64_t rec = pack(pos, track, frame);
+    if (rec == pos->stored) {
+        pos->stats.unchanged++;
+        return ESP_OK;
+    }
+    int64_t now = esp_timer_get_time();
+    if (!force && pos->stored_us && now - pos->stored_us < pos->cfg.interval_ms * 1000LL) {
+        pos->stats.deferred++;
+        return ESP_OK;
+    }
+    esp_err_t err;
+    if (pos->cfg.arbiter) {
+        err = flash_arbiter_run(pos->cfg.arbiter, FLASH_OP_ERASE, 0, &rec, NVS_SECTOR_SIZE, write_record, pos);
+    } else {
+        err = write_record(FLASH_OP_WRITE, 0, &rec, sizeof(rec), pos);
+    }
+    if (err != ESP_OK) {
+        pos->stats.failures++;
+        ESP_LOGW(TAG, "checkpoint failed, %s", esp_err_to_name(err));
+        return err;
+    }
+    pos->stored = rec;
+    pos->stored_us = now;
+    pos->stats.writes++;
+    return ESP_OK;
+}
+
+void play_position_get_stats(play_position_handle_t pos, play_position_stats_t *stats) {
+    *stats = pos->stats;
+}
+
+void play_position_report(play_position_handle_t pos) {
+    play_position_stats_t *s = &pos->stats;
+    ESP_LOGI(TAG, "%u updates: %u written, %u unchanged, %u deferred, %u failed", s->updates, s->writes, s->unchanged,
+             s->deferred, s->failures);
+}
@@ -0,0 +1,124 @@
+/* Playback position checkpoints in NVS, for resuming after a reset
+
+   This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#ifndef _PLAY_POSITION_H_
+#define _PLAY_POSITION_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "embed_stream.h"
+#include "flash_arbiter.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Checkpoint configuration
+ */
+typedef struct {
+    const char             *nvs_namespace;
+    const char             *key;
+    int                    interval_ms;    /*!< Least time between two checkpoints of a moving position */
+    flash_arbiter_handle_t arbiter;        /*!< Schedules the NVS writes around i2s DMA, NULL to write directly */
+} play_position_cfg_t;
+
+#define PLAY_POSITION_CFG_DEFAULT() {   \
+    .nvs_namespace = "player",          \
+    .key = "pos",                       \
+    .interval_ms = 5000,                \
+    .arbiter = NULL,                    \
+}
+
+/**
+ * @brief Checkpoint counters
+ */
+typedef struct {
+    uint32_t updates;       /*!< play_position_update() calls */
+    uint32_t writes;        /*!< Records written to NVS */
+    uint32_t unchanged;     /*!< Updates with the position already on flash */
+    uint32_t deferred;      /*!< Updates within interval_ms of the last write */
+    uint32_t failures;
+} play_position_stats_t;
+
+typedef struct play_position *play_position_handle_t;
+
+/**
+ * @brief Open the position record of a track table
+ *
+ * The position is one packed u64 NVS item: track, frame number and a tag
+ * of the track's name and size, so a record never resumes into a different
+ * file after the track table changed. NVS appends every new version of an
+ * item as one 32-byte entry and marks the previous one erased; a 4 KiB
+ * page is only erased once it is full and its space is needed, so a
+ * checkpoint costs one entry and 1/126 of a page erase, spread over all
+ * pages of the partition. Writing the position already stored costs nothing.
+ *
+ * @param cfg        Configuration
+ * @param tracks     Track table, must stay valid while the handle exists
+ * @param num_tracks Entries in tracks, at most 256
+ *
+ * @return The handle, NULL if NVS could not be opened
+ */
+play_position_handle_t play_position_create(const play_position_cfg_t *cfg, const embed_asset_t *tracks,
+                                            int num_tracks);
+
+/**
+ * @brief Close the record
+ */
+void play_position_destroy(play_position_handle_t pos);
+
+/**
+ * @brief Read the last checkpoint
+ *
+ * @param pos        The handle
+ * @param[out] track Track to resume
+ * @param[out] frame Frame to resume at, from the first frame of the track
+ *
+ * @return
+ *     - ESP_OK
+ *     - ESP_ERR_NOT_FOUND no record, or one that does not match the track table
+ */
+esp_err_t play_position_load(play_position_handle_t pos, int *track, uint32_t *frame);
+
+/**
+ * @brief Checkpoint the position
+ *
+ * Cheap enough to call on every pass of an event loop: nothing is written
+ * while the position equals the stored one or the last write is less than
+ * interval_ms old, unless force is set (pause, stop, shutdown).
+ *
+ * @param pos   The handle
+ * @param track Current track
+ * @param frame Current frame in the track
+ * @param force Write now regardless of interval_ms
+ *
+ * @return
+ *     - ESP_OK
+ *     - ESP_ERR_INVALID_ARG
+ *     - the NVS error of the write
+ */
+esp_err_t play_position_update(play_position_handle_t pos, int track, uint32_t frame, bool force);
+
+/**
+ * @brief Copy the counters
+ */
+void play_position_get_stats(play_position_handle_t pos, play_position_stats_t *stats);
+
+/**
+ * @brief Log the counters
+ */
+void play_position_report(play_position_handle_t pos);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
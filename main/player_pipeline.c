@@ -0,0 +1,150 @@
+/* Construction of the mp3 playback pipeline
+
+   This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#include <string.h>
+#include "esp_log.h"
+#include "audio_mem.h"
+#include "audio_error.h"
+#include "mp3_decoder.h"
+#include "resample.h"
+#include "sw_gain.h"
+#include "mem_placement.h"
+#include "task_placement.h"
+#include "player_pipeline.h"
+
+static const char *TAG = "PLAYER_PIPELINE";
+
+esp_err_t player_pipeline_create(player_pipeline_t *pp, const player_pipeline_cfg_t *cfg, audio_element_handle_t sink) {
+    AUDIO_NULL_CHECK(TAG, pp, return ESP_FAIL);
+    AUDIO_NULL_CHECK(TAG, sink, return ESP_FAIL);
+    memset(pp, 0, sizeof(*pp));
+    if (cfg->soft_volume && !cfg->output_rate) {
+        ESP_LOGE(TAG, "software volume needs a fixed output_rate");
+        return ESP_FAIL;
+    }
+
+    audio_pipeline_cfg_t pipeline_cfg = DEFAULT_AUDIO_PIPELINE_CONFIG();
+    pp->pipeline = audio_pipeline_init(&pipeline_cfg);
+    AUDIO_MEM_CHECK(TAG, pp->pipeline, return ESP_FAIL);
+
+    ESP_LOGI(TAG, "Create mp3 decoder to decode mp3 file and set custom read callback");
+    mp3_decoder_cfg_t mp3_cfg = DEFAULT_MP3_DECODER_CONFIG();
+    mp3_cfg.task_core = cfg->mp3_task_core;
+    task_placement_apply("mp3", &mp3_cfg.task_core, &mp3_cfg.task_prio, &mp3_cfg.task_stack, &mp3_cfg.stack_in_ext);
+    if (cfg->mp3_out_rb_size > 0) {
+        // audio_pipeline_link() sizes each ring buffer by the element writing it
+        mp3_cfg.out_rb_size = cfg->mp3_out_rb_size;
+    }
+    mp3_cfg.stack_in_ext = mem_placement_stack_in_ext("mp3", mp3_cfg.task_stack, mp3_cfg.stack_in_ext);
+    mem_placement_begin("mp3", MEM_KIND_WORK);
+    pp->mp3_decoder = mp3_decoder_init(&mp3_cfg);
+    mem_placement_end();
+    AUDIO_MEM_CHECK(TAG, pp->mp3_decoder, goto _fail);
+    if (cfg->read_cb) {
+        audio_element_set_read_cb(pp->mp3_decoder, cfg->read_cb, cfg->read_ctx);
+    }
+    if (cfg->output_rate) {
+        ESP_LOGI(TAG, "Create resampler to %d Hz stereo", cfg->output_rate);
+        resample_cfg_t rsp_cfg = RESAMPLE_CFG_DEFAULT();
+        rsp_cfg.out_rate = cfg->output_rate;
+        rsp_cfg.task_core = cfg->mp3_task_core;
+        task_placement_apply("resample", &rsp_cfg.task_core, &rsp_cfg.task_prio, &rsp_cfg.task_stack,
+                             &rsp_cfg.stack_in_ext);
+        rsp_cfg.stack_in_ext = mem_placement_stack_in_ext("resample", rsp_cfg.task_stack, rsp_cfg.stack_in_ext);
+        mem_placement_begin("resample", MEM_KIND_WORK);
+        pp->resampler = resample_init(&rsp_cfg);
+        mem_placement_end();
+        AUDIO_MEM_CHECK(TAG, pp->resampler, goto _fail);
+    }
+    if (cfg->soft_volume) {
+        ESP_LOGI(TAG, "Create software gain");
+        sw_gain_cfg_t gain_cfg = SW_GAIN_CFG_DEFAULT();
+        gain_cfg.sample_rate = cfg->output_rate;
+        gain_cfg.task_core = cfg->mp3_task_core;
+        task_placement_apply("gain", &gain_cfg.task_core, &gain_cfg.task_prio, &gain_cfg.task_stack,
+                             &gain_cfg.stack_in_ext);
+        gain_cfg.stack_in_ext = mem_placement_stack_in_ext("gain", gain_cfg.task_stack, gain_cfg.stack_in_ext);
+        mem_placement_begin("gain", MEM_KIND_WORK);
+        pp->gain = sw_gain_init(&gain_cfg);
+        mem_placement_end();
+        AUDIO_MEM_CHECK(TAG, pp->gain, goto _fail);
+    }
+    pp->sink = sink;
+
+    ESP_LOGI(TAG, "Register all elements to audio pipeline");
+    const char *link_tag[4];
+    int links = 0;
+    audio_pipeline_register(pp->pipeline, pp->mp3_decoder, "mp3");
+    link_tag[links++] = "mp3";
+    if (pp->resampler) {
+        audio_pipeline_register(pp->pipeline, pp->resampler, "resample");
+        link_tag[links++] = "resample";
+    }
+    if (pp->gain) {
+        audio_pipeline_register(pp->pipeline, pp->gain, "gain");
+        link_tag[links++] = "gain";
+    }
+    audio_pipeline_register(pp->pipeline, pp->sink, "i2s");
+    link_tag[links++] = "i2s";
+
+    ESP_LOGI(TAG, "Link it together [read_cb]-->mp3_decoder-->%s%ssink", pp->resampler ? "resampler-->" : "",
+             pp->gain ? "gain-->" : "");
+    // the ring buffers it creates are the outputs of link_tag[0..links-2]
+    mem_placement_begin_link(&link_tag[0], links - 1);
+    audio_pipeline_link(pp->pipeline, &link_tag[0], links);
+    mem_placement_end();
+    return ESP_OK;
+
+_fail:
+    if (pp->resampler) {
+        audio_element_deinit(pp->resampler);
+        pp->resampler = NULL;
+    }
+    if (pp->mp3_decoder) {
+        audio_element_deinit(pp->mp3_decoder);
+        pp->mp3_decoder = NULL;
+    }
+    audio_pipeline_deinit(pp->pipeline);
+    pp->pipeline = NULL;
+    return ESP_FAIL;
+}
+
+esp_err_t player_pipeline_set_listener(player_pipeline_t *pp, audio_event_iface_handle_t evt) {
+    return audio_pipeline_set_listener(pp->pipeline, evt);
+}
+
+esp_err_t player_pipeline_stop(player_pipeline_t *pp) {
+    audio_pipeline_stop(pp->pipeline);
+    audio_pipeline_wait_for_stop(pp->pipeline);
+    audio_pipeline_terminate(pp->pipeline);
+    audio_pipeline_unregister(pp->pipeline, pp->mp3_decoder);
+    if (pp->resampler) {
+        audio_pipeline_unregister(pp->pipeline, pp->resampler);
+    }
+    if (pp->gain) {
+        audio_pipeline_unregister(pp->pipeline, pp->gain);
+    }
+    audio_pipeline_unregister(pp->pipeline, pp->sink);
+
+    /* Terminate the pipeline before removing the listener */
+    return audio_pipeline_remove_listener(pp->pipeline);
+}
+
+void player_pipeline_destroy(player_pipeline_t *pp) {
+    audio_pipeline_deinit(pp->pipeline);
+    audio_element_deinit(pp->sink);
+    if (pp->gain) {
+        audio_element_deinit(pp->gain);
+    }
+    if (pp->resampler) {
+        audio_element_deinit(pp->resampler);
+    }
+    audio_element_deinit(pp->mp3_decoder);
+    memset(pp, 0, sizeof(*pp));
+}
@@ -0,0 +1,95 @@
+/* Construction of the mp3 playback pipeline
+
+   This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#ifndef _PLAYER_PIPELINE_H_
+#define _PLAYER_PIPELINE_H_
+
+#include "esp_err.h"
+#include "audio_element.h"
+#include "audio_pipeline.h"
+#include "audio_event_iface.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Player pipeline configuration
+ */
+typedef struct {
+    int         mp3_task_core;      /*!< Core of the mp3, resample and gain tasks the task placement table has not */
+    int         mp3_out_rb_size;    /*!< Ring buffer after the decoder, 0 for the decoder's default */
+    stream_func read_cb;            /*!< Callback feeding the mp3 decoder */
+    void        *read_ctx;          /*!< Context of read_cb */
+    int         output_rate;        /*!< Resample to this rate in front of the sink, 0 to feed it the decoder output */
+    bool        soft_volume;        /*!< Apply the volume in a gain element in front of the sink, needs output_rate */
+} player_pipeline_cfg_t;
+
+#define PLAYER_PIPELINE_CFG_DEFAULT() {     \
+    .mp3_task_core = 0,                     \
+    .mp3_out_rb_size = 0,                   \
+    .read_cb = NULL,                        \
+    .read_ctx = NULL,                       \
+    .output_rate = 0,                       \
+    .soft_volume = false,                   \
+}
+
+/**
+ * @brief The pipeline [read_cb]-->mp3_decoder-->[resampler]-->[gain]-->sink
+ */
+typedef struct {
+    audio_pipeline_handle_t pipeline;
+    audio_element_handle_t  mp3_decoder;
+    audio_element_handle_t  resampler;      /*!< NULL without an output_rate */
+    audio_element_handle_t  gain;           /*!< NULL without soft_volume, see sw_gain_set_volume() */
+    audio_element_handle_t  sink;
+} player_pipeline_t;
+
+/**
+ * @brief Create the decoder, register it and the sink, and link them
+ *
+ * The sink is created by the caller: the i2s stream writer on target,
+ * a PCM file or null sink in the host build. With an output_rate a
+ * resampler (resample.h) goes in between and the sink always gets stereo
+ * at that rate; the decoder's output path has to report the format of
+ * its PCM with resample_input_written(). With soft_volume a gain element
+ * (sw_gain.h) goes in front of the sink.
+ *
+ * @param pp   Pipeline to fill in
+ * @param cfg  Configuration
+ * @param sink Output element, owned by the pipeline from now on
+ *
+ * @return
+ *     - ESP_OK
+ *     - ESP_FAIL
+ */
+esp_err_t player_pipeline_create(player_pipeline_t *pp, const player_pipeline_cfg_t *cfg, audio_element_handle_t sink);
+
+/**
+ * @brief Forward pipeline events to the listener
+ */
+esp_err_t player_pipeline_set_listener(player_pipeline_t *pp, audio_event_iface_handle_t evt);
+
+/**
+ * @brief Stop the pipeline and detach it from its listener
+ *
+ * Call this before destroying the listening event interface.
+ */
+esp_err_t player_pipeline_stop(player_pipeline_t *pp);
+
+/**
+ * @brief Release the pipeline and its elements
+ */
+void player_pipeline_destroy(player_pipeline_t *pp);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
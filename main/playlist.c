@@ -0,0 +1,339 @@
+/* Gapless playlist feeding a single mp3 decoder
+
+   This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#include <string.h>
+#include "esp_log.h"
+#include "audio_mem.h"
+#include "audio_error.h"
+#include "playlist.h"
+
+static const char *TAG = "PLAYLIST";
+
+struct playlist {
+    const embed_asset_t *tracks;
+    int num_tracks;
+    bool loop;
+    playlist_track_cb_t on_track;
+    void *cb_ctx;
+    pcm_cache_handle_t pcm_cache;
+    embed_stream_handle_t cur;      // feeds the decoder
+    embed_stream_handle_t next;     // pre-rolled on the first frame of next_index
+    int current;
+    int next_index;
+    mp3_frame_info_t info;          // first frame of the current track
+    mp3_frame_info_t next_info;
+    int frame_end;                  // end of the frame being handed out from cur
+    uint32_t frame;                 // number of the next frame of the current track
+    int64_t pcm_pos;                // PCM bytes the frames handed out so far decode to
+    int pending;                    // requested track, -1 if none; set by any task, taken by the reader (atomics)
+    volatile int32_t seek_ms;       // requested time in the current (or pending) track, -1 if none
+    bool cache_checked;             // the cache has seen the current track start from its first frame
+    bool replay;                    // the current track comes from the cache, its frames are not handed out
+    int replay_bytes;               // PCM of the current track replayed so far
+};
+
+/**
+ * @brief Position a stream on the first frame of a track
+ */
+static bool preroll(embed_stream_handle_t stream, const embed_asset_t *track, mp3_frame_info_t *info) {
+    const uint8_t *data;
+    embed_stream_set_asset(stream, track);
+    int len = embed_stream_peek(stream, &data, 0);
+    int tag = mp3_id3v2_size(data, len);
+    if (tag >= len) {
+        return false;
+    }
+    int off = mp3_frame_sync(data + tag, len - tag, info);
+    if (off < 0) {
+        return false;
+    }
+    embed_stream_advance(stream, tag + off);
+    return true;
+}
+
+static int following(playlist_handle_t pl, int index) {
+    if (++index < pl->num_tracks) {
+        return index;
+    }
+    return pl->loop ? 0 : -1;
+}
+
+static bool switch_to(playlist_handle_t pl, int index, bool requested) {
+    mp3_frame_info_t info;
+    if (index == pl->next_index) {
+        embed_stream_handle_t tmp = pl->cur;
+        pl->cur = pl->next;
+        pl->next = tmp;
+        info = pl->next_info;
+    } else if (!preroll(pl->cur, &pl->tracks[index], &info)) {
+        ESP_LOGE(TAG, "no mp3 frames in track %d (%s)", index, pl->tracks[index].name);
+        return false;
+    }
+    if (pl->pcm_cache) {
+        pcm_cache_cancel(pl->pcm_cache, pl->pcm_pos);
+    }
+    pl->current = index;
+    pl->info = info;
+    pl->frame_end = embed_stream_tell(pl->cur);
+    pl->frame = 0;
+    pl->cache_checked = false;
+    pl->replay = false;
+    ESP_LOGI(TAG, "track %d (%s), %d Hz, %d ch", index, pl->tracks[index].name, info.sample_rate, info.channels);
+    if (pl->on_track) {
+        pl->on_track(pl, index, &info, requested, pl->cb_ctx);
+    }
+
+    // pre-roll the track after this one so the switch at its end is a pointer swap
+    int next = following(pl, index);
+    if (next >= 0 && preroll(pl->next, &pl->tracks[next], &pl->next_info)) {
+        pl->next_index = next;
+    } else {
+        pl->next_index = -1;
+    }
+    return true;
+}
+
+/**
+ * @brief Find the frame starting at the read position, skipping anything that is not a frame
+ *
+ * @return false at the end of the track's audio data
+ */
+static bool next_frame(playlist_handle_t pl) {
+    const uint8_t *data;
+    int len = embed_stream_peek(pl->cur, &data, 0);
+    mp3_frame_info_t info;
+    int size = len >= MP3_FRAME_HEADER_SIZE ? mp3_frame_parse_header(data, &info) : 0;
+    if (size == 0) {
+        int off = mp3_frame_sync(data, len, &info);
+        if (off < 0) {
+            return false;
+        }
+        embed_stream_advance(pl->cur, off);
+        size = info.frame_bytes;
+    } else if (size > len) {
+        // truncated last frame
+        return false;
+    }
+    pl->frame_end = embed_stream_tell(pl->cur) + size;
+    pl->frame++;
+    pl->pcm_pos += info.samples * info.channels * sizeof(int16_t);
+    return true;
+}
+
+/**
+ * @brief Move the read position of the current track to the frame playing at ms
+ */
+static void seek_to(playlist_handle_t pl, uint32_t ms) {
+    const mp3_index_t *index = pl->tracks[pl->current].index;
+    if (!index) {
+        return;
+    }
+    // a frame at or past the end positions on the end, and the next track follows
+    uint32_t frame = mp3_index_frame_at(index, ms);
+    embed_stream_seek(pl->cur, mp3_index_offset(index, frame));
+    pl->frame_end = embed_stream_tell(pl->cur);
+    pl->frame = frame;
+    if (pl->pcm_cache) {
+        pcm_cache_cancel(pl->pcm_cache, pl->pcm_pos);
+    }
+    pl->cache_checked = false;
+    pl->replay = false;
+    ESP_LOGD(TAG, "track %d: frame %u at %u ms", pl->current, frame, mp3_index_frame_ms(index, frame));
+}
+
+playlist_handle_t playlist_create(const embed_asset_t *tracks, int num_tracks, const playlist_cfg_t *cfg) {
+    AUDIO_NULL_CHECK(TAG, tracks, return NULL);
+    if (num_tracks <= 0) {
+        ESP_LOGE(TAG, "empty track table");
+        return NULL;
+    }
+    playlist_handle_t pl = audio_calloc(1, sizeof(struct playlist));
+    AUDIO_MEM_CHECK(TAG, pl, return NULL);
+    pl->cur = embed_stream_create();
+    pl->next = embed_stream_create();
+    AUDIO_MEM_CHECK(TAG, pl->cur && pl->next, {
+        playlist_destroy(pl);
+        return NULL;
+    });
+    pl->tracks = tracks;
+    pl->num_tracks = num_tracks;
+    pl->loop = cfg->loop;
+    pl->on_track = cfg->on_track;
+    pl->cb_ctx = cfg->cb_ctx;
+    pl->pcm_cache = cfg->pcm_cache;
+    pl->current = -1;
+    pl->next_index = -1;
+    pl->pending = 0;
+    pl->seek_ms = -1;
+    return pl;
+}
+
+void playlist_destroy(playlist_handle_t pl) {
+    if (!pl) {
+        return;
+    }
+    embed_stream_destroy(pl->cur);
+    embed_stream_destroy(pl->next);
+    audio_free(pl);
+}
+
+/**
+ * @brief Set the request unless the reader took or replaced the one it was made from
+ */
+static bool request(playlist_handle_t pl, int *from, int index) {
+    return __atomic_compare_exchange_n(&pl->pending, from, index, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+}
+
+esp_err_t playlist_skip(playlist_handle_t pl) {
+    AUDIO_NULL_CHECK(TAG, pl, return ESP_FAIL);
+    int req = __atomic_load_n(&pl->pending, __ATOMIC_ACQUIRE);
+    int base, next;
+    do {
+        // the reader clears the request only once current is the track it asked for
+        base = req >= 0 ? req : pl->current;
+        next = base + 1 < pl->num_tracks ? base + 1 : 0;
+    } while (!request(pl, &req, next));
+    return ESP_OK;
+}
+
+esp_err_t playlist_select(playlist_handle_t pl, int index) {
+    AUDIO_NULL_CHECK(TAG, pl, return ESP_ERR_INVALID_ARG);
+    if (index < 0 || index >= pl->num_tracks) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    __atomic_store_n(&pl->pending, index, __ATOMIC_RELEASE);
+    return ESP_OK;
+}
+
+esp_err_t playlist_seek(playlist_handle_t pl, int index, uint32_t ms) {
+    AUDIO_NULL_CHECK(TAG, pl, return ESP_ERR_INVALID_ARG);
+    int req = __atomic_load_n(&pl->pending, __ATOMIC_ACQUIRE);
+    int base = req >= 0 ? req : pl->current;
+    if (index < 0) {
+        index = base >= 0 ? base : 0;
+    }
+    if (index >= pl->num_tracks || ms > INT32_MAX) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (!pl->tracks[index].index) {
+        ESP_LOGW(TAG, "track %d (%s) has no frame index", index, pl->tracks[index].name);
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+    // the time first: the reader switches track before it applies the time
+    pl->seek_ms = ms;
+    if (index != base) {
+        __atomic_store_n(&pl->pending, index, __ATOMIC_RELEASE);
+    }
+    return ESP_OK;
+}
+
+int playlist_get_current(playlist_handle_t pl) {
+    return pl->current;
+}
+
+int64_t playlist_get_pcm_pos(playlist_handle_t pl) {
+    return pl->pcm_pos;
+}
+
+uint32_t playlist_get_frame(playlist_handle_t pl) {
+    return pl->frame > 0 ? pl->frame - 1 : 0;
+}
+
+uint32_t playlist_get_time_ms(playlist_handle_t pl) {
+    if (pl->current < 0) {
+        return 0;
+    }
+    // rounded up as mp3_index_frame_ms() does, so seeking to it lands on the same frame
+    uint64_t samples = (uint64_t)playlist_get_frame(pl) * pl->info.samples * 1000;
+    return (samples + pl->info.sample_rate - 1) / pl->info.sample_rate;
+}
+
+int playlist_tell(playlist_handle_t pl) {
+    return pl->current >= 0 ? embed_stream_tell(pl->cur) : 0;
+}
+
+int playlist_read_cb(audio_element_handle_t el, char *buf, int len, TickType_t wait_time, void *ctx) {
+    playlist_handle_t pl = (playlist_handle_t)ctx;
+    int total = 0;
+    int failed = 0;
+
+    while (total < len && failed < pl->num_tracks) {
+        int pos = playlist_tell(pl);
+        if (pl->current < 0 || pos == pl->frame_end) {
+            // frame boundary: the only place the stream may change track
+            // the request is cleared after the switch, a skip meanwhile counts from it, not from the old track
+            int req = __atomic_load_n(&pl->pending, __ATOMIC_ACQUIRE);
+            if (req >= 0) {
+                if (switch_to(pl, req, true)) {
+                    request(pl, &req, -1);
+                } else {
+                    failed++;
+                    if (request(pl, &req, following(pl, req))) {
+                        pl->seek_ms = -1;
+                    }
+                }
+                continue;
+            }
+            int32_t ms = pl->seek_ms;
+            if (ms >= 0) {
+                pl->seek_ms = -1;
+                seek_to(pl, ms);
+            }
+            if (pl->pcm_cache && pl->frame == 0 && !pl->cache_checked) {
+                pl->cache_checked = true;
+                pl->replay = pcm_cache_begin(pl->pcm_cache, &pl->tracks[pl->current], pl->pcm_pos) > 0;
+                pl->replay_bytes = 0;
+            }
+            if (pl->replay) {
+                // hand out what was read before the track first, the replay is written after it
+                if (total > 0) {
+                    break;
+                }
+                int n = pcm_cache_replay(pl->pcm_cache, el);
+                if (n != 0) {
+                    if (n > 0) {
+                        pl->pcm_pos += n;
+                        pl->replay_bytes += n;
+                    }
+                    return n > 0 ? AEL_IO_TIMEOUT : n;
+                }
+                // go on from the first frame not replayed, past the end when the whole track was
+                int frame_pcm = pl->info.samples * pl->info.channels * sizeof(int16_t);
+                const mp3_index_t *index = pl->tracks[pl->current].index;
+                uint32_t frame = (pl->replay_bytes + frame_pcm - 1) / frame_pcm;
+                pl->replay = false;
+                embed_stream_seek(pl->cur, mp3_index_offset(index, frame));
+                pl->frame_end = embed_stream_tell(pl->cur);
+                pl->frame = frame < index->frame_count ? frame : index->frame_count;
+                continue;
+            }
+            if (!next_frame(pl)) {
+                if (pl->next_index < 0) {
+                    int none = -1;
+                    if (pl->loop && failed == 0) {
+                        request(pl, &none, following(pl, pl->current));
+                        failed++;
+                        continue;
+                    }
+                    break;
+                }
+                switch_to(pl, pl->next_index, false);
+                continue;
+            }
+            pos = playlist_tell(pl);
+        }
+        const uint8_t *data;
+        int n = embed_stream_peek(pl->cur, &data, len - total < pl->frame_end - pos ? len - total : pl->frame_end - pos);
+        memcpy(buf + total, data, n);
+        embed_stream_advance(pl->cur, n);
+        total += n;
+        failed = 0;
+    }
+    return total > 0 ? total : AEL_IO_DONE;
+}
@@ -0,0 +1,161 @@
+/* Gapless playlist feeding a single mp3 decoder
+
+   This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#ifndef _PLAYLIST_H_
+#define _PLAYLIST_H_
+
+#include <stdbool.h>
+#include "esp_err.h"
+#include "audio_element.h"
+#include "embed_stream.h"
+#include "mp3_frame.h"
+#include "pcm_cache.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct playlist *playlist_handle_t;
+
+/**
+ * @brief Called from the decoder's read context when the first frame of a track is handed to the decoder
+ *
+ * @param pl        The playlist
+ * @param index     Index of the new track
+ * @param info      Header of the track's first frame
+ * @param requested The change was asked for (playlist_skip(), playlist_select()), not the end of the previous track
+ * @param ctx       User context
+ */
+typedef void (*playlist_track_cb_t)(playlist_handle_t pl, int index, const mp3_frame_info_t *info, bool requested,
+                                    void *ctx);
+
+/**
+ * @brief Playlist configuration
+ */
+typedef struct {
+    bool                loop;       /*!< Continue with the first track after the last one */
+    playlist_track_cb_t on_track;   /*!< Track change callback, may be NULL */
+    void                *cb_ctx;    /*!< Context of on_track */
+    pcm_cache_handle_t  pcm_cache;  /*!< Replays tracks it holds instead of feeding their frames, may be NULL */
+} playlist_cfg_t;
+
+#define PLAYLIST_CFG_DEFAULT() {    \
+    .loop = true,                   \
+    .on_track = NULL,               \
+    .cb_ctx = NULL,                 \
+    .pcm_cache = NULL,              \
+}
+
+/**
+ * @brief Create a playlist over a track table
+ *
+ * The decoder is fed one continuous stream of whole mp3 frames: tags and
+ * trailing bytes are stripped, and the next track is already positioned on
+ * its first frame (pre-rolled) while the current one plays, so a track change
+ * never ends the stream and never restarts the pipeline.
+ *
+ * With a PCM cache, a track played from its first frame is looked up in it:
+ * a cached track is written to the decoder output from the read callback and
+ * none of its frames reach the decoder, any other is recorded as it decodes.
+ *
+ * @param tracks     Track table, must stay valid while the playlist exists
+ * @param num_tracks Number of entries in tracks
+ * @param cfg        Configuration
+ *
+ * @return The playlist handle, NULL on error
+ */
+playlist_handle_t playlist_create(const embed_asset_t *tracks, int num_tracks, const playlist_cfg_t *cfg);
+
+/**
+ * @brief Destroy the playlist
+ */
+void playlist_destroy(playlist_handle_t pl);
+
+/**
+ * @brief Switch to the next track at the next frame boundary
+ *
+ * The playlist itself flushes nothing: PCM already decoded for the current
+ * track drains unless the on_track callback, told the change was requested,
+ * drops it (e.g. resample_input_flush()). A track that ends on its own hands
+ * over gaplessly either way.
+ *
+ * @return
+ *     - ESP_OK
+ *     - ESP_FAIL
+ */
+esp_err_t playlist_skip(playlist_handle_t pl);
+
+/**
+ * @brief Switch to a given track at the next frame boundary
+ *
+ * @return
+ *     - ESP_OK
+ *     - ESP_ERR_INVALID_ARG
+ */
+esp_err_t playlist_select(playlist_handle_t pl, int index);
+
+/**
+ * @brief Jump to a time in a track at the next frame boundary
+ *
+ * The frame playing at ms is found in the track's build-time frame index
+ * (embed_asset_t.index), so a seek costs the same at any time in any track
+ * and no frames are read to get there. As with playlist_skip(), PCM already
+ * decoded still drains. The first frame after the jump may decode with a
+ * short glitch, its bit reservoir being in frames that were not fed.
+ *
+ * @param pl    The playlist
+ * @param index Track to play, -1 for the current one
+ * @param ms    Time from the start of the track; at or past its end, the next track follows
+ *
+ * @return
+ *     - ESP_OK
+ *     - ESP_ERR_INVALID_ARG
+ *     - ESP_ERR_NOT_SUPPORTED the track has no frame index
+ */
+esp_err_t playlist_seek(playlist_handle_t pl, int index, uint32_t ms);
+
+/**
+ * @brief Index of the track currently fed to the decoder, -1 before the first read
+ */
+int playlist_get_current(playlist_handle_t pl);
+
+/**
+ * @brief Amount of 16-bit PCM the frames handed to the decoder so far decode to, in bytes
+ *
+ * PCM replayed from the cache counts as handed out. Inside the track callback this is where the new track starts in the decoder output.
+ */
+int64_t playlist_get_pcm_pos(playlist_handle_t pl);
+
+/**
+ * @brief Number of the frame last handed to the decoder, counted from the first frame of the current track
+ */
+uint32_t playlist_get_frame(playlist_handle_t pl);
+
+/**
+ * @brief Start time of the frame last handed to the decoder, in ms from the start of the current track
+ */
+uint32_t playlist_get_time_ms(playlist_handle_t pl);
+
+/**
+ * @brief Read position in the current track, in bytes from its start
+ */
+int playlist_tell(playlist_handle_t pl);
+
+/**
+ * @brief Decoder read callback, ctx is the playlist handle
+ *
+ * @return Bytes read, or AEL_IO_DONE after the last track when not looping
+ */
+int playlist_read_cb(audio_element_handle_t el, char *buf, int len, TickType_t wait_time, void *ctx);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,527 @@
+/* Fixed-rate output: polyphase resampler element between the mp3 decoder and the i2s writer
+
+   This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <math.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "audio_mem.h"
+#include "audio_error.h"
+#include "resample.h"
+
+static const char *TAG = "RESAMPLE";
+
+#define RESAMPLE_MAX_PHASES     (1024)
+#define RESAMPLE_KAISER_BETA    (6.0)   // about 63 dB of stopband with a transition of a sixth of the input rate
+#define RESAMPLE_HIST           (RESAMPLE_TAPS - 1 + RESAMPLE_MAX_BLOCK)
+#define RESAMPLE_FILTERS        (4)     // input rates kept ready
+#define RESAMPLE_FORMATS        (8)     // format changes queued ahead of the reader at most
+#define RESAMPLE_WAIT_TICKS     (10)    // for the decoder to report PCM already read
+
+struct resample_filter {
+    int in_rate;
+    int L;                              // interpolation and decimation, in_rate * L == out_rate * M
+    int M;
+    int16_t *coef;                      // L phases of RESAMPLE_TAPS, each reversed
+    int phase;                          // of the next output
+    int next;                           // index in hist of the newest input the next output needs
+    int fill;                           // input samples in hist
+    int16_t hist[2][RESAMPLE_HIST];     // planar, so the taps of an output are contiguous
+};
+
+static int gcd(int a, int b) {
+    while (b) {
+        int t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+/**
+ * @brief Zeroth order modified Bessel function, for the Kaiser window
+ */
+static double bessel_i0(double x) {
+    double sum = 1, term = 1;
+    for (int k = 1; k < 32; k++) {
+        term *= (x / (2 * k)) * (x / (2 * k));
+        sum += term;
+    }
+    return sum;
+}
+
+/**
+ * @brief Design the prototype low-pass and split it into normalised, reversed int16 phases
+ */
+static void design(resample_filter_handle_t f, int in_rate, int out_rate) {
+    int n = f->L * RESAMPLE_TAPS;
+    double center = (n - 1) / 2.0;
+    // cycles per sample at the interpolated rate in_rate * L
+    double fc = 0.5 * (in_rate < out_rate ? in_rate : out_rate) / ((double)in_rate * f->L);
+    double norm = bessel_i0(RESAMPLE_KAISER_BETA);
+    double h[RESAMPLE_TAPS];
+    for (int p = 0; p < f->L; p++) {
+        double sum = 0;
+        for (int k = 0; k < RESAMPLE_TAPS; k++) {
+            double t = p + k * f->L - center;
+            double x = 2 * fc * t;
+            double sinc = t == 0 ? 1 : sin(M_PI * x) / (M_PI * x);
+            double r = 2 * (p + k * f->L) / (double)(n - 1) - 1;
+            h[k] = 2 * fc * sinc * bessel_i0(RESAMPLE_KAISER_BETA * sqrt(1 - r * r)) / norm;
+            sum += h[k];
+        }
+        // unity DC gain per phase, the rounding error goes to the largest tap
+        int16_t *c = f->coef + p * RESAMPLE_TAPS;
+        int total = 0, largest = 0;
+        for (int k = 0; k < RESAMPLE_TAPS; k++) {
+            int16_t v = (int16_t)lrint(h[k] / sum * (1 << RESAMPLE_COEF_BITS));
+            c[RESAMPLE_TAPS - 1 - k] = v;
+            total += v;
+            if (k == 0 || abs(v) > abs(c[largest])) {
+                largest = RESAMPLE_TAPS - 1 - k;
+            }
+        }
+        c[largest] += (1 << RESAMPLE_COEF_BITS) - total;
+    }
+}
+
+resample_filter_handle_t resample_filter_create(int in_rate, int out_rate) {
+    if (in_rate <= 0 || out_rate <= 0) {
+        ESP_LOGE(TAG, "invalid rates %d to %d Hz", in_rate, out_rate);
+        return NULL;
+    }
+    int g = gcd(in_rate, out_rate);
+    if (out_rate / g > RESAMPLE_MAX_PHASES) {
+        ESP_LOGE(TAG, "%d to %d Hz needs %d phases, at most %d", in_rate, out_rate, out_rate / g,
+                 RESAMPLE_MAX_PHASES);
+        return NULL;
+    }
+    resample_filter_handle_t f = audio_calloc(1, sizeof(struct resample_filter));
+    AUDIO_MEM_CHECK(TAG, f, return NULL);
+    f->in_rate = in_rate;
+    f->L = out_rate / g;
+    f->M = in_rate / g;
+    f->coef = audio_malloc(f->L * RESAMPLE_TAPS * sizeof(int16_t));
+    AUDIO_MEM_CHECK(TAG, f->coef, {
+        audio_free(f);
+        return NULL;
+    });
+    design(f, in_rate, out_rate);
+    resample_filter_reset(f);
+    ESP_LOGD(TAG, "%d to %d Hz: %d/%d, %d bytes of coefficients", in_rate, out_rate, f->L, f->M,
+             (int)(f->L * RESAMPLE_TAPS * sizeof(int16_t)));
+    return f;
+}
+
+void resample_filter_destroy(resample_filter_handle_t f) {
+    if (!f) {
+        return;
+    }
+    audio_free(f->coef);
+    audio_free(f);
+}
+
+void resample_filter_reset(resample_filter_handle_t f) {
+    memset(f->hist, 0, sizeof(f->hist));
+    f->phase = 0;
+    f->fill = RESAMPLE_TAPS - 1;
+    f->next = RESAMPLE_TAPS - 1;
+}
+
+int resample_filter_max_out(resample_filter_handle_t f, int in_frames) {
+    return (in_frames * f->L + f->M - 1) / f->M + 1;
+}
+
+/**
+ * @brief One output sample, the loop the compiler vectorises or the LX6 runs as multiply-accumulates
+ */
+static inline int16_t dot(const int16_t *c, const int16_t *x) {
+    int32_t acc = 1 << (RESAMPLE_COEF_BITS - 1);
+    for (int k = 0; k < RESAMPLE_TAPS; k++) {
+        acc += c[k] * x[k];
+    }
+    acc >>= RESAMPLE_COEF_BITS;
+    return acc > INT16_MAX ? INT16_MAX : acc < INT16_MIN ? INT16_MIN : acc;
+}
+
+int resample_filter_run(resample_filter_handle_t f, const int16_t *in, int in_frames, int channels, int16_t *out) {
+    int16_t *x0 = f->hist[0], *x1 = f->hist[1];
+    if (in_frames > RESAMPLE_MAX_BLOCK) {
+        in_frames = RESAMPLE_MAX_BLOCK;
+    }
+    if (in) {
+        int right = channels > 1 ? 1 : 0;
+        for (int i = 0; i < in_frames; i++) {
+            x0[f->fill + i] = in[i * channels];
+            x1[f->fill + i] = in[i * channels + right];
+        }
+    } else {
+        memset(x0 + f->fill, 0, in_frames * sizeof(int16_t));
+        memset(x1 + f->fill, 0, in_frames * sizeof(int16_t));
+    }
+    f->fill += in_frames;
+
+    int n = 0;
+    while (f->next < f->fill) {
+        const int16_t *c = f->coef + f->phase * RESAMPLE_TAPS;
+        int first = f->next - (RESAMPLE_TAPS - 1);
+        out[2 * n] = dot(c, x0 + first);
+        out[2 * n + 1] = dot(c, x1 + first);
+        n++;
+        f->phase += f->M;
+        while (f->phase >= f->L) {
+            f->phase -= f->L;
+            f->next++;
+        }
+    }
+    // keep the taps of the next output
+    int drop = f->next - (RESAMPLE_TAPS - 1);
+    if (drop > f->fill) {
+        drop = f->fill;
+    }
+    memmove(x0, x0 + drop, (f->fill - drop) * sizeof(int16_t));
+    memmove(x1, x1 + drop, (f->fill - drop) * sizeof(int16_t));
+    f->fill -= drop;
+    f->next -= drop;
+    return n;
+}
+
+typedef struct {
+    int64_t at;                         // input byte the format starts at
+    int rate;
+    int channels;
+} input_format_t;
+
+typedef struct {
+    resample_cfg_t cfg;
+    resample_filter_handle_t filters[RESAMPLE_FILTERS];
+    int next_slot;                      // filter replaced when a new rate comes up
+    resample_filter_handle_t filter;    // for the current input, NULL to copy
+    int rate;                           // current input format, 0 before it is known
+    int channels;
+    bool primed;                        // the filter holds input that was not flushed out
+    int16_t *out;                       // buffer_len bytes
+    int in_off;                         // PCM read into the element buffer and not processed yet
+    int in_fill;
+    int64_t read;                       // input bytes processed
+    bool waiting;                       // warned about PCM nobody reported
+    // written in the decoder's output path
+    portMUX_TYPE lock;
+    int64_t written;
+    int64_t drop_until;                 // input before this byte is dropped, INT64_MAX while a flush waits for its end
+    int w_rate;                         // format of the last block reported
+    int w_channels;
+    input_format_t queue[RESAMPLE_FORMATS];
+    int q_head;
+    int q_count;
+    bool q_full;
+} resample_t;
+
+static int frame_bytes(resample_t *rsp) {
+    return rsp->channels * sizeof(int16_t);
+}
+
+static resample_filter_handle_t get_filter(resample_t *rsp, int rate) {
+    for (int i = 0; i < RESAMPLE_FILTERS; i++) {
+        if (rsp->filters[i] && rsp->filters[i]->in_rate == rate) {
+            return rsp->filters[i];
+        }
+    }
+    resample_filter_handle_t f = resample_filter_create(rate, rsp->cfg.out_rate);
+    if (f) {
+        resample_filter_destroy(rsp->filters[rsp->next_slot]);
+        rsp->filters[rsp->next_slot] = f;
+        rsp->next_slot = (rsp->next_slot + 1) % RESAMPLE_FILTERS;
+    }
+    return f;
+}
+
+static esp_err_t set_format(resample_t *rsp, int rate, int channels) {
+    if (rate <= 0 || channels <= 0) {
+        ESP_LOGE(TAG, "invalid input format, %d Hz, %d channels", rate, channels);
+        return ESP_FAIL;
+    }
+    resample_filter_handle_t f = NULL;
+    if (rate != rsp->cfg.out_rate) {
+        f = get_filter(rsp, rate);
+        if (!f) {
+            return ESP_FAIL;
+        }
+        resample_filter_reset(f);
+    }
+    ESP_LOGI(TAG, "input %d Hz, %d channels, %s", rate, channels, f ? "resampling" : "copying");
+    rsp->filter = f;
+    rsp->rate = rate;
+    rsp->channels = channels;
+    rsp->primed = false;
+    return ESP_OK;
+}
+
+/**
+ * @brief Flush the filter's delay line out, RESAMPLE_TAPS / 2 frames of silence
+ */
+static int flush(audio_element_handle_t self, resample_t *rsp) {
+    rsp->primed = false;
+    int n = resample_filter_run(rsp->filter, NULL, RESAMPLE_TAPS / 2, 2, rsp->out);
+    int w = n > 0 ? audio_element_output(self, (char *)rsp->out, n * 2 * sizeof(int16_t)) : 0;
+    return w != 0 ? w : AEL_IO_TIMEOUT;
+}
+
+static esp_err_t _resample_open(audio_element_handle_t self) {
+    resample_t *rsp = (resample_t *)audio_element_getdata(self);
+    rsp->in_off = rsp->in_fill = 0;
+    rsp->read = 0;
+    rsp->waiting = false;
+    if (rsp->cfg.in_rate) {
+        return set_format(rsp, rsp->cfg.in_rate, rsp->cfg.in_channels);
+    }
+    return ESP_OK;
+}
+
+static esp_err_t _resample_close(audio_element_handle_t self) {
+    resample_t *rsp = (resample_t *)audio_element_getdata(self);
+    // the decoder is stopped or done too, the next run starts counting both sides from 0
+    portENTER_CRITICAL(&rsp->lock);
+    rsp->written = 0;
+    rsp->drop_until = 0;
+    rsp->w_rate = rsp->w_channels = 0;
+    rsp->q_head = rsp->q_count = 0;
+    portEXIT_CRITICAL(&rsp->lock);
+    rsp->filter = NULL;
+    rsp->rate = rsp->channels = 0;
+    rsp->primed = false;
+    return ESP_OK;
+}
+
+static audio_element_err_t _resample_process(audio_element_handle_t self, char *in_buffer, int in_len) {
+    resample_t *rsp = (resample_t *)audio_element_getdata(self);
+    if (rsp->q_full) {
+        rsp->q_full = false;
+        ESP_LOGW(TAG, "more than %d format changes queued, some PCM plays at the wrong rate", RESAMPLE_FORMATS);
+    }
+    int pending = rsp->in_fill - rsp->in_off;
+    bool done = false;
+    // less than a stereo frame left, read on behind it
+    if (pending < 2 * (int)sizeof(int16_t)) {
+        memmove(in_buffer, in_buffer + rsp->in_off, pending);
+        rsp->in_off = 0;
+        rsp->in_fill = pending;
+        int n = audio_element_input(self, in_buffer + pending, in_len - pending);
+        if (n == AEL_IO_DONE || n == AEL_IO_OK) {
+            done = true;
+        } else if (n < 0) {
+            return n;
+        } else {
+            rsp->in_fill += n;
+            pending += n;
+        }
+    }
+    if (!rsp->cfg.in_rate) {
+        // the decoder reports a block just after queueing it, the reader may get there first
+        int64_t got = rsp->read + pending;
+        for (int i = 0;; i++) {
+            portENTER_CRITICAL(&rsp->lock);
+            bool reported = rsp->written >= got;
+            portEXIT_CRITICAL(&rsp->lock);
+            if (reported) {
+                break;
+            }
+            if (i == RESAMPLE_WAIT_TICKS) {
+                if (!rsp->waiting) {
+                    rsp->waiting = true;
+                    ESP_LOGW(TAG, "waiting for the input format, see resample_input_written()");
+                }
+                return AEL_IO_TIMEOUT;
+            }
+            vTaskDelay(1);
+        }
+
+        // a flush drops what was queued before its end, format changes in it included; nothing of it is flushed out
+        portENTER_CRITICAL(&rsp->lock);
+        int64_t drop = rsp->drop_until - rsp->read;
+        portEXIT_CRITICAL(&rsp->lock);
+        if (drop > 0) {
+            int n = drop < pending ? (int)drop : pending;
+            rsp->in_off += n;
+            rsp->read += n;
+            if (rsp->primed) {
+                resample_filter_reset(rsp->filter);
+                rsp->primed = false;
+            }
+            return n > 0 ? n : done ? AEL_IO_DONE : AEL_IO_TIMEOUT;
+        }
+
+        // format changes at or before the next byte, and where the next one starts
+        int64_t until = INT64_MAX;
+        while (1) {
+            portENTER_CRITICAL(&rsp->lock);
+            bool queued = rsp->q_count > 0;
+            input_format_t fmt = rsp->queue[rsp->q_head];
+            portEXIT_CRITICAL(&rsp->lock);
+            if (!queued || fmt.at > rsp->read) {
+                until = queued ? fmt.at : until;
+                break;
+            }
+            if (fmt.rate != rsp->rate || fmt.channels != rsp->channels) {
+                if (rsp->primed) {
+                    // the old track's tail goes out first, in a call of its own
+                    return flush(self, rsp);
+                }
+                if (set_format(rsp, fmt.rate, fmt.channels) != ESP_OK) {
+                    return AEL_IO_FAIL;
+                }
+            }
+            portENTER_CRITICAL(&rsp->lock);
+            rsp->q_head = (rsp->q_head + 1) % RESAMPLE_FORMATS;
+            rsp->q_count--;
+            portEXIT_CRITICAL(&rsp->lock);
+        }
+        if (until - rsp->read < pending) {
+            pending = until - rsp->read;
+        }
+    }
+    if (rsp->rate == 0) {
+        return done ? AEL_IO_DONE : AEL_IO_TIMEOUT;
+    }
+
+    int fb = frame_bytes(rsp);
+    int out_frames = rsp->cfg.buffer_len / (2 * sizeof(int16_t));
+    int frames = pending / fb;
+    if (frames == 0) {
+        if (done) {
+            // a partial frame at the end is dropped
+            return rsp->primed ? flush(self, rsp) : AEL_IO_DONE;
+        }
+        return AEL_IO_TIMEOUT;
+    }
+    const int16_t *in = (const int16_t *)(in_buffer + rsp->in_off);
+    int n;
+    if (rsp->filter) {
+        int max_in = (out_frames - 2) * rsp->filter->M / rsp->filter->L;
+        if (max_in > RESAMPLE_MAX_BLOCK) {
+            max_in = RESAMPLE_MAX_BLOCK;
+        }
+        if (frames > max_in) {
+            frames = max_in;
+        }
+        n = resample_filter_run(rsp->filter, in, frames, rsp->channels, rsp->out);
+        rsp->primed = true;
+    } else {
+        if (frames > out_frames) {
+            frames = out_frames;
+        }
+        if (rsp->channels == 2) {
+            memcpy(rsp->out, in, frames * fb);
+        } else {
+            for (int i = 0; i < frames; i++) {
+                rsp->out[2 * i] = in[i * rsp->channels];
+                rsp->out[2 * i + 1] = in[i * rsp->channels + (rsp->channels > 1)];
+            }
+        }
+        n = frames;
+    }
+    rsp->in_off += frames * fb;
+    rsp->read += frames * fb;
+    int w = n > 0 ? audio_element_output(self, (char *)rsp->out, n * 2 * sizeof(int16_t)) : 0;
+    if (w < 0) {
+        return w;
+    }
+    audio_element_update_byte_pos(self, w);
+    // consumed input that made no output yet is progress too
+    return w > 0 ? w : frames * fb;
+}
+
+static esp_err_t _resample_destroy(audio_element_handle_t self) {
+    resample_t *rsp = (resample_t *)audio_element_getdata(self);
+    for (int i = 0; i < RESAMPLE_FILTERS; i++) {
+        resample_filter_destroy(rsp->filters[i]);
+    }
+    audio_free(rsp->out);
+    audio_free(rsp);
+    return ESP_OK;
+}
+
+audio_element_handle_t resample_init(resample_cfg_t *config) {
+    AUDIO_NULL_CHECK(TAG, config, return NULL);
+    if (config->out_rate <= 0 || config->buffer_len < 256 || (config->in_rate && config->in_channels <= 0)) {
+        ESP_LOGE(TAG, "invalid config, %d Hz out, %d byte buffer", config->out_rate, config->buffer_len);
+        return NULL;
+    }
+    resample_t *rsp = audio_calloc(1, sizeof(resample_t));
+    AUDIO_MEM_CHECK(TAG, rsp, return NULL);
+    rsp->cfg = *config;
+    portMUX_TYPE unlocked = portMUX_INITIALIZER_UNLOCKED;
+    rsp->lock = unlocked;
+    rsp->out = audio_malloc(config->buffer_len);
+    AUDIO_MEM_CHECK(TAG, rsp->out, {
+        audio_free(rsp);
+        return NULL;
+    });
+
+    audio_element_cfg_t cfg = DEFAULT_AUDIO_ELEMENT_CONFIG();
+    cfg.open = _resample_open;
+    cfg.close = _resample_close;
+    cfg.process = _resample_process;
+    cfg.destroy = _resample_destroy;
+    cfg.buffer_len = config->buffer_len;
+    cfg.out_rb_size = config->out_rb_size;
+    cfg.task_stack = config->task_stack;
+    cfg.task_core = config->task_core;
+    cfg.task_prio = config->task_prio;
+    cfg.stack_in_ext = config->stack_in_ext;
+    cfg.data = rsp;
+    cfg.tag = "resample";
+    audio_element_handle_t el = audio_element_init(&cfg);
+    AUDIO_MEM_CHECK(TAG, el, {
+        audio_free(rsp->out);
+        audio_free(rsp);
+        return NULL;
+    });
+    audio_element_set_music_info(el, config->out_rate, 2, 16);
+    return el;
+}
+
+void resample_input_written(audio_element_handle_t el, int rate, int channels, int len) {
+    resample_t *rsp = (resample_t *)audio_element_getdata(el);
+    portENTER_CRITICAL(&rsp->lock);
+    if (rate != rsp->w_rate || channels != rsp->w_channels) {
+        if (rsp->q_count < RESAMPLE_FORMATS) {
+            input_format_t *fmt = &rsp->queue[(rsp->q_head + rsp->q_count) % RESAMPLE_FORMATS];
+            fmt->at = rsp->written;
+            fmt->rate = rate;
+            fmt->channels = channels;
+            rsp->q_count++;
+        } else {
+            rsp->q_full = true;
+        }
+        rsp->w_rate = rate;
+        rsp->w_channels = channels;
+    }
+    rsp->written += len;
+    portEXIT_CRITICAL(&rsp->lock);
+}
+
+void resample_input_flush(audio_element_handle_t el) {
+    resample_t *rsp = (resample_t *)audio_element_getdata(el);
+    portENTER_CRITICAL(&rsp->lock);
+    rsp->drop_until = INT64_MAX;
+    portEXIT_CRITICAL(&rsp->lock);
+}
+
+void resample_input_resume(audio_element_handle_t el) {
+    resample_t *rsp = (resample_t *)audio_element_getdata(el);
+    portENTER_CRITICAL(&rsp->lock);
+    if (rsp->drop_until == INT64_MAX) {
+        rsp->drop_until = rsp->written;
+    }
+    portEXIT_CRITICAL(&rsp->lock);
+}
@@ -0,0 +1,160 @@
+/* Fixed-rate output: polyphase resampler element between the mp3 decoder and the i2s writer
+
+   This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#ifndef _RESAMPLE_H_
+#define _RESAMPLE_H_
+
+#include <stdint.h>
+#include "esp_err.h"
+#include "audio_element.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define RESAMPLE_TAPS           (24)    /*!< Input samples per output sample and channel */
+#define RESAMPLE_COEF_BITS      (14)    /*!< Fractional bits of the int16 coefficients, a tap can be 1.0 */
+#define RESAMPLE_MAX_BLOCK      (512)   /*!< Input frames per resample_filter_run() call at most */
+
+typedef struct resample_filter *resample_filter_handle_t;
+
+/**
+ * @brief Create a stereo filter converting in_rate to out_rate
+ *
+ * The rate ratio is reduced to L/M and a windowed-sinc low-pass of
+ * L * RESAMPLE_TAPS taps, cut off below the lower Nyquist frequency, is
+ * split into L phases. Each phase is stored reversed and normalised to unity
+ * DC gain, so every output sample is a RESAMPLE_TAPS long dot product over
+ * contiguous int16 arrays. The coefficients take L * RESAMPLE_TAPS * 2
+ * bytes: 21 KB for 8000 to 44100 Hz, 96 bytes for 22050 to 44100 Hz.
+ *
+ * @return The filter, NULL on error or if L exceeds 1024
+ */
+resample_filter_handle_t resample_filter_create(int in_rate, int out_rate);
+
+/**
+ * @brief Free the filter
+ */
+void resample_filter_destroy(resample_filter_handle_t f);
+
+/**
+ * @brief Clear the history, for input that does not follow on from the last
+ */
+void resample_filter_reset(resample_filter_handle_t f);
+
+/**
+ * @brief Output frames resample_filter_run() produces at most for in_frames of input
+ */
+int resample_filter_max_out(resample_filter_handle_t f, int in_frames);
+
+/**
+ * @brief Resample a block of interleaved 16 bit PCM
+ *
+ * All of the input is consumed; output is delayed by RESAMPLE_TAPS / 2
+ * input samples, which RESAMPLE_TAPS / 2 frames of silence flush out.
+ *
+ * @param f         The filter
+ * @param in        Input, NULL for in_frames of silence
+ * @param in_frames Input frames, at most RESAMPLE_MAX_BLOCK
+ * @param channels  Input channels, 1 or 2; mono is duplicated
+ * @param out       Interleaved stereo output, room for resample_filter_max_out(in_frames) frames
+ *
+ * @return Output frames written
+ */
+int resample_filter_run(resample_filter_handle_t f, const int16_t *in, int in_frames, int channels, int16_t *out);
+
+/**
+ * @brief Resampler element configuration
+ */
+typedef struct {
+    int  out_rate;          /*!< Output sample rate, the i2s clock set once at boot */
+    int  in_rate;           /*!< Fixed input format, 0 to follow resample_input_written() */
+    int  in_channels;       /*!< Channels of a fixed input format */
+    int  buffer_len;        /*!< Bytes of PCM read and written per process call at most */
+    int  out_rb_size;
+    int  task_stack;
+    int  task_core;
+    int  task_prio;
+    bool stack_in_ext;
+} resample_cfg_t;
+
+#define RESAMPLE_TASK_STACK_SIZE    (3 * 1024)
+#define RESAMPLE_TASK_CORE          (0)
+#define RESAMPLE_TASK_PRIO          (5)
+#define RESAMPLE_RINGBUFFER_SIZE    (8 * 1024)
+
+#define RESAMPLE_CFG_DEFAULT() {                    \
+    .out_rate = 44100,                              \
+    .in_rate = 0,                                   \
+    .in_channels = 0,                               \
+    .buffer_len = 4096,                             \
+    .out_rb_size = RESAMPLE_RINGBUFFER_SIZE,        \
+    .task_stack = RESAMPLE_TASK_STACK_SIZE,         \
+    .task_core = RESAMPLE_TASK_CORE,                \
+    .task_prio = RESAMPLE_TASK_PRIO,                \
+    .stack_in_ext = true,                           \
+}
+
+/**
+ * @brief Create the resampler element
+ *
+ * The element reads 16 bit PCM in any rate and channel count and writes
+ * stereo at out_rate, so the i2s writer behind it keeps one clock whatever
+ * the tracks are. Input at out_rate is copied. The element's music info is
+ * the output format.
+ *
+ * With in_rate 0 the input format is located in the input stream: the
+ * decoder's output path reports every block it queues for the resampler
+ * with resample_input_written(), and a format change takes effect at the
+ * exact byte it starts at, however much PCM is queued in between. Until
+ * the first report the element waits.
+ *
+ * @return The element, NULL on error
+ */
+audio_element_handle_t resample_init(resample_cfg_t *cfg);
+
+/**
+ * @brief The decoder queued len bytes of PCM for the resampler, in the given format
+ *
+ * Called in the decoder's output path after the write, e.g. from a
+ * latency_trace_set_output_cb() observer, for every block. Counting
+ * restarts when the resampler closes, i.e. the pipeline stops or finishes.
+ *
+ * @param el       The resampler
+ * @param rate     Sample rate of the block, the decoder's music info
+ * @param channels Channels of the block
+ * @param len      Bytes written
+ */
+void resample_input_written(audio_element_handle_t el, int rate, int channels, int len);
+
+/**
+ * @brief Drop the input the decoder queued so far, and what it queues on, until resample_input_resume()
+ *
+ * For a change the listener should hear at once, e.g. a skip: the PCM
+ * queued in front of the resampler is read and dropped instead of played,
+ * however much the decoder buffered; what is behind the resampler (its
+ * output ring buffer and those further down) still plays. Any task; needs
+ * an input format located with resample_input_written().
+ */
+void resample_input_flush(audio_element_handle_t el);
+
+/**
+ * @brief End a flush: the input from the next block reported on plays
+ *
+ * Called in the decoder's output path before resample_input_written()
+ * reports the first block to play, e.g. the first PCM of the new track.
+ * Without a flush pending it does nothing.
+ */
+void resample_input_resume(audio_element_handle_t el);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,235 @@
+/* Write-back sector cache between FatFs disk I/O and wear levelling
+
+   This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "audio_mem.h"
+#include "audio_error.h"
+#include "sector_cache.h"
+
+static const char *TAG = "SECTOR_CACHE";
+
+#define NO_SECTOR   UINT32_MAX
+
+typedef struct {
+    uint32_t sector;
+    bool     dirty;
+    int64_t  dirty_since_us;
+    uint32_t used;              // LRU stamp
+    uint32_t written;           // stamp of the last write, write-back goes in this order
+    uint8_t  *data;
+} cache_slot_t;
+
+struct sector_cache {
+    sector_cache_cfg_t cfg;
+    SemaphoreHandle_t lock;
+    cache_slot_t *slots;
+    uint8_t *data;
+    uint32_t clock;
+    sector_cache_stats_t stats;
+};
+
+sector_cache_handle_t sector_cache_create(const sector_cache_cfg_t *cfg) {
+    AUDIO_NULL_CHECK(TAG, cfg && cfg->read && cfg->write, return NULL);
+    if (cfg->slots <= 0 || cfg->sector_size == 0) {
+        ESP_LOGE(TAG, "invalid geometry, %d slots of %d bytes", cfg->slots, (int)cfg->sector_size);
+        return NULL;
+    }
+    sector_cache_handle_t cache = audio_calloc(1, sizeof(struct sector_cache));
+    AUDIO_MEM_CHECK(TAG, cache, return NULL);
+    cache->cfg = *cfg;
+    cache->slots = audio_calloc(cfg->slots, sizeof(cache_slot_t));
+    cache->data = audio_malloc(cfg->slots * cfg->sector_size);
+    cache->lock = xSemaphoreCreateMutex();
+    AUDIO_MEM_CHECK(TAG, cache->slots && cache->data && cache->lock, {
+        sector_cache_destroy(cache);
+        return NULL;
+    });
+    for (int i = 0; i < cfg->slots; i++) {
+        cache->slots[i].sector = NO_SECTOR;
+        cache->slots[i].data = cache->data + i * cfg->sector_size;
+    }
+    return cache;
+}
+
+void sector_cache_destroy(sector_cache_handle_t cache) {
+    if (!cache) {
+        return;
+    }
+    if (cache->lock) {
+        vSemaphoreDelete(cache->lock);
+    }
+    audio_free(cache->data);
+    audio_free(cache->slots);
+    audio_free(cache);
+}
+
+static cache_slot_t *lookup(sector_cache_handle_t cache, uint32_t sector) {
+    for (int i = 0; i < cache->cfg.slots; i++) {
+        if (cache->slots[i].sector == sector) {
+            return &cache->slots[i];
+        }
+    }
+    return NULL;
+}
+
+static esp_err_t flush_slot(sector_cache_handle_t cache, cache_slot_t *slot) {
+    esp_err_t ret = cache->cfg.write(cache->cfg.ctx, slot->sector, slot->data, 1);
+    if (ret == ESP_OK) {
+        slot->dirty = false;
+        cache->stats.flushes++;
+    }
+    return ret;
+}
+
+/**
+ * @brief A slot for a sector not in the cache: a free one, else the least recently used
+ */
+static esp_err_t claim(sector_cache_handle_t cache, uint32_t sector, cache_slot_t **out) {
+    cache_slot_t *victim = NULL;
+    for (int i = 0; i < cache->cfg.slots; i++) {
+        cache_slot_t *slot = &cache->slots[i];
+        if (slot->sector == NO_SECTOR) {
+            victim = slot;
+            break;
+        }
+        if (!victim || slot->used < victim->used) {
+            victim = slot;
+        }
+    }
+    if (victim->sector != NO_SECTOR && victim->dirty) {
+        esp_err_t ret = flush_slot(cache, victim);
+        if (ret != ESP_OK) {
+            return ret;
+        }
+        cache->stats.evictions++;
+    }
+    victim->sector = sector;
+    victim->dirty = false;
+    *out = victim;
+    return ESP_OK;
+}
+
+esp_err_t sector_cache_read(sector_cache_handle_t cache, uint32_t sector, void *buf, size_t count) {
+    esp_err_t ret = ESP_OK;
+    size_t size = cache->cfg.sector_size;
+    xSemaphoreTake(cache->lock, portMAX_DELAY);
+    for (size_t i = 0; i < count && ret == ESP_OK; i++) {
+        uint8_t *dst = (uint8_t *)buf + i * size;
+        cache_slot_t *slot = lookup(cache, sector + i);
+        if (slot) {
+            cache->stats.read_hits++;
+        } else {
+            cache->stats.read_misses++;
+            ret = claim(cache, sector + i, &slot);
+            if (ret == ESP_OK) {
+                ret = cache->cfg.read(cache->cfg.ctx, sector + i, slot->data, 1);
+                if (ret != ESP_OK) {
+                    slot->sector = NO_SECTOR;
+                    break;
+                }
+            }
+        }
+        if (ret == ESP_OK) {
+            memcpy(dst, slot->data, size);
+            slot->used = ++cache->clock;
+        }
+    }
+    xSemaphoreGive(cache->lock);
+    return ret;
+}
+
+esp_err_t sector_cache_write(sector_cache_handle_t cache, uint32_t sector, const void *buf, size_t count) {
+    esp_err_t ret = ESP_OK;
+    size_t size = cache->cfg.sector_size;
+    xSemaphoreTake(cache->lock, portMAX_DELAY);
+    for (size_t i = 0; i < count && ret == ESP_OK; i++) {
+        cache_slot_t *slot = lookup(cache, sector + i);
+        if (slot) {
+            cache->stats.write_hits++;
+        } else {
+            // whole sectors are written, nothing to read first
+            ret = claim(cache, sector + i, &slot);
+            if (ret != ESP_OK) {
+                break;
+            }
+        }
+        cache->stats.writes++;
+        memcpy(slot->data, (const uint8_t *)buf + i * size, size);
+        slot->used = ++cache->clock;
+        slot->written = slot->used;
+        if (!slot->dirty) {
+            slot->dirty = true;
+            slot->dirty_since_us = esp_timer_get_time();
+        }
+        if (cache->cfg.flush_interval_ms == 0) {
+            ret = flush_slot(cache, slot);
+        }
+    }
+    xSemaphoreGive(cache->lock);
+    return ret;
+}
+
+/**
+ * @brief Write back dirty slots dirty since before a time, in the order they were last written
+ *
+ * FatFs writes the data, then the FAT, then the directory entry; flash sees
+ * them in that order too, so a power loss part way leaves what FatFs would.
+ */
+static esp_err_t flush_before(sector_cache_handle_t cache, int64_t before_us) {
+    while (1) {
+        cache_slot_t *next = NULL;
+        for (int i = 0; i < cache->cfg.slots; i++) {
+            cache_slot_t *slot = &cache->slots[i];
+            if (slot->dirty && slot->dirty_since_us <= before_us && (!next || slot->written < next->written)) {
+                next = slot;
+            }
+        }
+        if (!next) {
+            return ESP_OK;
+        }
+        esp_err_t ret = flush_slot(cache, next);
+        if (ret != ESP_OK) {
+            ESP_LOGE(TAG, "write back of sector %u failed (0x%x)", next->sector, ret);
+            return ret;
+        }
+    }
+}
+
+esp_err_t sector_cache_flush_expired(sector_cache_handle_t cache) {
+    xSemaphoreTake(cache->lock, portMAX_DELAY);
+    esp_err_t ret = flush_before(cache, esp_timer_get_time() - cache->cfg.flush_interval_ms * 1000LL);
+    xSemaphoreGive(cache->lock);
+    return ret;
+}
+
+esp_err_t sector_cache_sync(sector_cache_handle_t cache) {
+    xSemaphoreTake(cache->lock, portMAX_DELAY);
+    cache->stats.syncs++;
+    esp_err_t ret = flush_before(cache, INT64_MAX);
+    xSemaphoreGive(cache->lock);
+    return ret;
+}
+
+void sector_cache_get_stats(sector_cache_handle_t cache, sector_cache_stats_t *stats) {
+    xSemaphoreTake(cache->lock, portMAX_DELAY);
+    *stats = cache->stats;
+    stats->erases_saved = stats->writes > stats->flushes ? stats->writes - stats->flushes : 0;
+    xSemaphoreGive(cache->lock);
+}
+
+void sector_cache_report(sector_cache_handle_t cache) {
+    sector_cache_stats_t s;
+    sector_cache_get_stats(cache, &s);
+    ESP_LOGI(TAG, "read hits=%u misses=%u, writes=%u (hits=%u), flushes=%u evictions=%u syncs=%u, erases saved=%u",
+             s.read_hits, s.read_misses, s.writes, s.write_hits, s.flushes, s.evictions, s.syncs, s.erases_saved);
+}
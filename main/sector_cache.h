@@ -0,0 +1,117 @@
+/* Write-back sector cache between FatFs disk I/O and wear levelling
+
+   This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#ifndef _SECTOR_CACHE_H_
+#define _SECTOR_CACHE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Read whole sectors from the backing store
+ */
+typedef esp_err_t (*sector_cache_read_t)(void *ctx, uint32_t sector, void *buf, size_t count);
+
+/**
+ * @brief Write whole sectors to the backing store, erasing them first
+ */
+typedef esp_err_t (*sector_cache_write_t)(void *ctx, uint32_t sector, const void *buf, size_t count);
+
+typedef struct {
+    size_t               sector_size;
+    int                  slots;             /*!< Cached sectors, allocated with audio_malloc (PSRAM when available) */
+    int                  flush_interval_ms; /*!< Age at which dirty sectors are written back, 0 for write-through */
+    sector_cache_read_t  read;
+    sector_cache_write_t write;
+    void                 *ctx;              /*!< Context of read and write */
+} sector_cache_cfg_t;
+
+#define SECTOR_CACHE_CFG_DEFAULT() {    \
+    .sector_size = 4096,                \
+    .slots = 32,                        \
+    .flush_interval_ms = 5000,          \
+    .read = NULL,                       \
+    .write = NULL,                      \
+    .ctx = NULL,                        \
+}
+
+/**
+ * @brief Cache counters, in sectors
+ */
+typedef struct {
+    uint32_t read_hits;
+    uint32_t read_misses;
+    uint32_t write_hits;        /*!< Writes to a sector that was already cached */
+    uint32_t writes;            /*!< Sectors written by the file system */
+    uint32_t flushes;           /*!< Sectors erased and written to the backing store */
+    uint32_t evictions;         /*!< Dirty sectors written back to make room */
+    uint32_t syncs;             /*!< sector_cache_sync() calls */
+    uint32_t erases_saved;      /*!< writes - flushes: erase cycles the cache absorbed */
+} sector_cache_stats_t;
+
+typedef struct sector_cache *sector_cache_handle_t;
+
+/**
+ * @brief Create a cache
+ *
+ * @return The cache, NULL on error
+ */
+sector_cache_handle_t sector_cache_create(const sector_cache_cfg_t *cfg);
+
+/**
+ * @brief Destroy the cache, dirty sectors are lost: sync first
+ */
+void sector_cache_destroy(sector_cache_handle_t cache);
+
+/**
+ * @brief Read sectors, through the cache
+ */
+esp_err_t sector_cache_read(sector_cache_handle_t cache, uint32_t sector, void *buf, size_t count);
+
+/**
+ * @brief Write sectors into the cache
+ *
+ * They reach the backing store once they are older than flush_interval_ms
+ * (see sector_cache_flush_expired()), when their slot is needed for another
+ * sector, or at sector_cache_sync().
+ */
+esp_err_t sector_cache_write(sector_cache_handle_t cache, uint32_t sector, const void *buf, size_t count);
+
+/**
+ * @brief Write back the dirty sectors older than flush_interval_ms
+ *
+ * Call it periodically, e.g. every half interval from a low priority task.
+ */
+esp_err_t sector_cache_flush_expired(sector_cache_handle_t cache);
+
+/**
+ * @brief Write back all dirty sectors, in the order they were last written
+ */
+esp_err_t sector_cache_sync(sector_cache_handle_t cache);
+
+/**
+ * @brief Copy the counters
+ */
+void sector_cache_get_stats(sector_cache_handle_t cache, sector_cache_stats_t *stats);
+
+/**
+ * @brief Log the counters
+ */
+void sector_cache_report(sector_cache_handle_t cache);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
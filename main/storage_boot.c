@@ -0,0 +1,109 @@
+/* Boot of the storage partition: mount what is there, validate it later, repair only what fails
+
+   This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "storage_boot.h"
+
+static const char *TAG = "STORAGE_BOOT";
+
+static storage_boot_cfg_t boot;
+static storage_boot_stats_t stats;
+
+static esp_err_t erase(void) {
+    int64_t t0 = esp_timer_get_time();
+    esp_err_t err = boot.erase(boot.ctx);
+    stats.erase_us += esp_timer_get_time() - t0;
+    return err;
+}
+
+static esp_err_t mount_and_seed(void) {
+    esp_err_t err = boot.mount(boot.ctx);
+    if (err == ESP_OK && boot.seed) {
+        err = boot.seed(boot.ctx);
+    }
+    return err;
+}
+
+void storage_boot_reset(void) {
+    boot = (storage_boot_cfg_t) {0};
+    stats = (storage_boot_stats_t) {0};
+}
+
+esp_err_t storage_boot_mount(const storage_boot_cfg_t *cfg) {
+    if (!cfg || !cfg->mount || !cfg->unmount || !cfg->erase || !cfg->validate) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    boot = *cfg;
+    // the rest was cleared by storage_boot_reset(): the player may have started before the mount
+    stats.mount_start_us = esp_timer_get_time();
+    if (!boot.fast) {
+        esp_err_t err = erase();
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "erase failed, %s", esp_err_to_name(err));
+            return err;
+        }
+    }
+    esp_err_t err = mount_and_seed();
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "mount failed, %s", esp_err_to_name(err));
+        return err;
+    }
+    stats.mounted_us = esp_timer_get_time();
+    if (!boot.fast) {
+        stats.validated_us = stats.mounted_us;
+    }
+    return ESP_OK;
+}
+
+esp_err_t storage_boot_validate(void) {
+    if (!boot.mount || stats.validated_us) {
+        return ESP_OK;
+    }
+    esp_err_t err = boot.validate(boot.ctx);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "file system failed validation (%s), erasing and formatting it", esp_err_to_name(err));
+        stats.repairs++;
+        boot.unmount(boot.ctx);
+        err = erase();
+        if (err == ESP_OK) {
+            err = mount_and_seed();
+        }
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "repair failed, %s", esp_err_to_name(err));
+            return err;
+        }
+    }
+    stats.validated_us = esp_timer_get_time();
+    return ESP_OK;
+}
+
+void storage_boot_first_audio(void) {
+    if (!stats.first_audio_us) {
+        stats.first_audio_us = esp_timer_get_time();
+    }
+}
+
+void storage_boot_get_stats(storage_boot_stats_t *s) {
+    if (s) {
+        *s = stats;
+    }
+}
+
+void storage_boot_report(void) {
+    ESP_LOGI(TAG, "%s boot: storage mounted at %d ms (%d ms, %d ms erasing), first audio at %d ms",
+             boot.fast ? "fast" : "erasing", (int)(stats.mounted_us / 1000),
+             (int)((stats.mounted_us - stats.mount_start_us) / 1000), (int)(stats.erase_us / 1000),
+             (int)(stats.first_audio_us / 1000));
+    if (stats.validated_us) {
+        ESP_LOGI(TAG, "validated at %d ms, %u repairs", (int)(stats.validated_us / 1000), stats.repairs);
+    } else {
+        ESP_LOGI(TAG, "not validated yet");
+    }
+}
@@ -0,0 +1,90 @@
+/* Boot of the storage partition: mount what is there, validate it later, repair only what fails
+
+   This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#ifndef _STORAGE_BOOT_H_
+#define _STORAGE_BOOT_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief What the app does to the partition; each returns ESP_OK or an error
+ */
+typedef struct {
+    bool        fast;                       /*!< Mount the file system that is there and validate it with
+                                                 storage_boot_validate(); false erases and formats at every boot */
+    esp_err_t   (*mount)(void *ctx);        /*!< Mount, formatting a partition that holds no file system */
+    esp_err_t   (*unmount)(void *ctx);
+    esp_err_t   (*erase)(void *ctx);        /*!< Erase the whole partition, unmounted */
+    esp_err_t   (*validate)(void *ctx);     /*!< Whether the mounted file system is sound */
+    esp_err_t   (*seed)(void *ctx);         /*!< Write what the player needs that is missing, NULL for nothing */
+    void        *ctx;
+} storage_boot_cfg_t;
+
+/**
+ * @brief Milestones of the boot, us of esp_timer_get_time(), 0 until reached
+ */
+typedef struct {
+    int64_t     mount_start_us;
+    int64_t     mounted_us;                 /*!< Mounted and seeded, the player may read it */
+    int64_t     first_audio_us;             /*!< See storage_boot_first_audio() */
+    int64_t     validated_us;               /*!< Validated, repaired if it had to be */
+    int64_t     erase_us;                   /*!< Time spent erasing, at boot or in a repair */
+    uint32_t    repairs;
+} storage_boot_stats_t;
+
+/**
+ * @brief Start a boot: forget the milestones and config of the previous one
+ *
+ * Call it before the boot steps run, storage_boot_first_audio() may come
+ * before storage_boot_mount(). The milestones are zero at power on.
+ */
+void storage_boot_reset(void);
+
+/**
+ * @brief Bring up the partition as cfg says, the config is copied
+ *
+ * Fast: mount (a blank partition is formatted by it) and seed. Otherwise
+ * erase, mount and seed, the file system is fresh and needs no validation.
+ */
+esp_err_t storage_boot_mount(const storage_boot_cfg_t *cfg);
+
+/**
+ * @brief Validate the mounted file system; if it fails, unmount, erase, mount and seed it again
+ *
+ * Meant for a background task after playback has started; nothing else
+ * may use the file system meanwhile. Does nothing but return ESP_OK
+ * without fast boot, or the second time.
+ *
+ * @return ESP_OK if the file system was sound or is repaired
+ */
+esp_err_t storage_boot_validate(void);
+
+/**
+ * @brief The player has its first decoded audio, records the time once
+ */
+void storage_boot_first_audio(void);
+
+void storage_boot_get_stats(storage_boot_stats_t *stats);
+
+/**
+ * @brief Log the milestones, in ms since boot
+ */
+void storage_boot_report(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
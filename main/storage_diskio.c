@@ -0,0 +1,260 @@
+/* FatFs disk I/O for the wear-levelled /storage partition, through the sector cache and the flash arbiter
+
+   This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "diskio_impl.h"
+#include "diskio_wl.h"
+#include "storage_diskio.h"
+#include "task_placement.h"
+
+static const char *TAG = "STORAGE_DISKIO";
+
+#define FLUSH_TASK_STACK    3072
+#define FLUSH_TASK_PRIO     2
+
+typedef struct {
+    wl_handle_t wl;
+    size_t sector_size;
+    flash_arbiter_handle_t arb;
+    sector_cache_handle_t cache;
+    fat_verifier_handle_t verifier;
+    int flush_interval_ms;
+    volatile bool stop;
+    SemaphoreHandle_t flush_done;
+} storage_drive_t;
+
+static storage_drive_t drives[FF_VOLUMES];
+
+static esp_err_t wl_io(flash_op_t op, size_t addr, void *buf, size_t size, void *ctx) {
+    storage_drive_t *drv = (storage_drive_t *)ctx;
+    switch (op) {
+    case FLASH_OP_READ:
+        return wl_read(drv->wl, addr, buf, size);
+    case FLASH_OP_WRITE:
+        return wl_write(drv->wl, addr, buf, size);
+    case FLASH_OP_ERASE:
+        return wl_erase_range(drv->wl, addr, size);
+    default:
+        return ESP_ERR_INVALID_ARG;
+    }
+}
+
+static esp_err_t flash_read(void *ctx, uint32_t sector, void *buf, size_t count) {
+    storage_drive_t *drv = (storage_drive_t *)ctx;
+    return flash_arbiter_run(drv->arb, FLASH_OP_READ, sector * drv->sector_size, buf, count * drv->sector_size,
+                             wl_io, drv);
+}
+
+static esp_err_t flash_write(void *ctx, uint32_t sector, const void *buf, size_t count) {
+    storage_drive_t *drv = (storage_drive_t *)ctx;
+    size_t addr = sector * drv->sector_size;
+    size_t size = count * drv->sector_size;
+    if (drv->verifier) {
+        fat_verifier_write_begin(drv->verifier, sector, count);
+    }
+    // erase and program are separate windows, the i2s task refills DMA in between
+    esp_err_t err = flash_arbiter_run(drv->arb, FLASH_OP_ERASE, addr, NULL, size, wl_io, drv);
+    if (err == ESP_OK) {
+        err = flash_arbiter_run(drv->arb, FLASH_OP_WRITE, addr, (void *)buf, size, wl_io, drv);
+    }
+    if (drv->verifier) {
+        fat_verifier_write_end(drv->verifier, sector, buf, count, err);
+    }
+    return err;
+}
+
+static DSTATUS storage_init(unsigned char pdrv) {
+    return 0;
+}
+
+static DSTATUS storage_status(unsigned char pdrv) {
+    return 0;
+}
+
+static DRESULT storage_read(unsigned char pdrv, unsigned char *buff, uint32_t sector, unsigned count) {
+    storage_drive_t *drv = &drives[pdrv];
+    esp_err_t err = drv->cache ? sector_cache_read(drv->cache, sector, buff, count)
+                               : flash_read(drv, sector, buff, count);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "read of sector %u failed (0x%x)", sector, err);
+        return RES_ERROR;
+    }
+    return RES_OK;
+}
+
+static DRESULT storage_write(unsigned char pdrv, const unsigned char *buff, uint32_t sector, unsigned count) {
+    storage_drive_t *drv = &drives[pdrv];
+    esp_err_t err = drv->cache ? sector_cache_write(drv->cache, sector, buff, count)
+                               : flash_write(drv, sector, buff, count);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "write of sector %u failed (0x%x)", sector, err);
+        return RES_ERROR;
+    }
+    return RES_OK;
+}
+
+static DRESULT storage_ioctl(unsigned char pdrv, unsigned char cmd, void *buff) {
+    storage_drive_t *drv = &drives[pdrv];
+    switch (cmd) {
+    case CTRL_SYNC:
+        // f_sync() / fclose() end up here: the drive's dirty sectors are written back, in write order
+        if (drv->cache) {
+            esp_err_t err = sector_cache_sync(drv->cache);
+            if (err != ESP_OK) {
+                ESP_LOGE(TAG, "sync failed (0x%x)", err);
+                return RES_ERROR;
+            }
+        }
+        return RES_OK;
+    case GET_SECTOR_COUNT:
+        *((DWORD *)buff) = wl_size(drv->wl) / drv->sector_size;
+        return RES_OK;
+    case GET_SECTOR_SIZE:
+        *((WORD *)buff) = drv->sector_size;
+        return RES_OK;
+    default:
+        return RES_ERROR;
+    }
+}
+
+static void flush_task(void *ctx) {
+    storage_drive_t *drv = (storage_drive_t *)ctx;
+    TickType_t period = pdMS_TO_TICKS(drv->flush_interval_ms / 2);
+    while (!drv->stop) {
+        vTaskDelay(period ? period : 1);
+        sector_cache_flush_expired(drv->cache);
+    }
+    xSemaphoreGive(drv->flush_done);
+    vTaskDelete(NULL);
+}
+
+static storage_drive_t *find_drive(wl_handle_t wl) {
+    BYTE pdrv = ff_diskio_get_pdrv_wl(wl);
+    return pdrv == 0xff ? NULL : &drives[pdrv];
+}
+
+esp_err_t storage_diskio_attach(wl_handle_t wl, flash_arbiter_handle_t arb, const sector_cache_cfg_t *cache_cfg) {
+    static const ff_diskio_impl_t impl = {
+        .init = storage_init,
+        .status = storage_status,
+        .read = storage_read,
+        .write = storage_write,
+        .ioctl = storage_ioctl,
+    };
+    BYTE pdrv = ff_diskio_get_pdrv_wl(wl);
+    if (pdrv == 0xff) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    storage_drive_t *drv = &drives[pdrv];
+    drv->wl = wl;
+    drv->sector_size = wl_sector_size(wl);
+    drv->arb = arb;
+    drv->cache = NULL;
+    drv->verifier = NULL;
+    drv->stop = false;
+    if (cache_cfg) {
+        sector_cache_cfg_t cfg = *cache_cfg;
+        cfg.sector_size = drv->sector_size;
+        cfg.read = flash_read;
+        cfg.write = flash_write;
+        cfg.ctx = drv;
+        drv->cache = sector_cache_create(&cfg);
+        if (!drv->cache) {
+            return ESP_ERR_NO_MEM;
+        }
+        drv->flush_interval_ms = cfg.flush_interval_ms;
+        if (cfg.flush_interval_ms > 0) {
+            int core = tskNO_AFFINITY;
+            int prio = FLUSH_TASK_PRIO;
+            int stack = FLUSH_TASK_STACK;
+            task_placement_apply("storage_flush", &core, &prio, &stack, NULL);
+            drv->flush_done = xSemaphoreCreateBinary();
+            if (!drv->flush_done
+                || xTaskCreatePinnedToCore(flush_task, "storage_flush", stack, drv, prio, NULL, core) != pdPASS) {
+                ESP_LOGE(TAG, "failed to start the flush task");
+                if (drv->flush_done) {
+                    vSemaphoreDelete(drv->flush_done);
+                    drv->flush_done = NULL;
+                }
+                sector_cache_destroy(drv->cache);
+                drv->cache = NULL;
+                return ESP_FAIL;
+            }
+        }
+    }
+    ff_diskio_register(pdrv, &impl);
+    ESP_LOGI(TAG, "drive %d: %d sectors of %d bytes through the flash arbiter, %s", pdrv,
+             (int)(wl_size(wl) / drv->sector_size), (int)drv->sector_size,
+             drv->cache ? "write-back cache" : "uncached");
+    return ESP_OK;
+}
+
+esp_err_t storage_diskio_sync(wl_handle_t wl) {
+    storage_drive_t *drv = find_drive(wl);
+    if (!drv) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    return drv->cache ? sector_cache_sync(drv->cache) : ESP_OK;
+}
+
+esp_err_t storage_diskio_detach(wl_handle_t wl) {
+    storage_drive_t *drv = find_drive(wl);
+    if (!drv) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    if (drv->verifier) {
+        fat_verifier_report(drv->verifier);
+        fat_verifier_destroy(drv->verifier);
+        drv->verifier = NULL;
+    }
+    if (!drv->cache) {
+        return ESP_OK;
+    }
+    if (drv->flush_done) {
+        drv->stop = true;
+        xSemaphoreTake(drv->flush_done, portMAX_DELAY);
+        vSemaphoreDelete(drv->flush_done);
+        drv->flush_done = NULL;
+    }
+    esp_err_t err = sector_cache_sync(drv->cache);
+    sector_cache_report(drv->cache);
+    sector_cache_destroy(drv->cache);
+    drv->cache = NULL;
+    return err;
+}
+
+sector_cache_handle_t storage_diskio_get_cache(wl_handle_t wl) {
+    storage_drive_t *drv = find_drive(wl);
+    return drv ? drv->cache : NULL;
+}
+
+esp_err_t storage_diskio_attach_verifier(wl_handle_t wl, const fat_verifier_cfg_t *cfg) {
+    storage_drive_t *drv = find_drive(wl);
+    if (!drv) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    if (drv->verifier) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    fat_verifier_cfg_t ver_cfg = *cfg;
+    ver_cfg.sector_size = drv->sector_size;
+    ver_cfg.num_sectors = wl_size(drv->wl) / drv->sector_size;
+    ver_cfg.read = flash_read;
+    ver_cfg.ctx = drv;
+    drv->verifier = fat_verifier_create(&ver_cfg);
+    return drv->verifier ? ESP_OK : ESP_ERR_NO_MEM;
+}
+
+fat_verifier_handle_t storage_diskio_get_verifier(wl_handle_t wl) {
+    storage_drive_t *drv = find_drive(wl);
+    return drv ? drv->verifier : NULL;
+}
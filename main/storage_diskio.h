@@ -0,0 +1,91 @@
+/* FatFs disk I/O for the wear-levelled /storage partition, through the sector cache and the flash arbiter
+
+   This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#ifndef _STORAGE_DISKIO_H_
+#define _STORAGE_DISKIO_H_
+
+#include "esp_err.h"
+#include "wear_levelling.h"
+#include "flash_arbiter.h"
+#include "sector_cache.h"
+#include "fat_verifier.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Route the FatFs drive of a mounted wear-levelled partition through the cache and the arbiter
+ *
+ * Replaces the disk I/O that esp_vfs_fat_spiflash_mount() registered for the
+ * partition, so every sector read, erase and write of the FAT file system
+ * runs in windows scheduled by the arbiter. Unmounting unregisters it again.
+ * The unit size of the arbiter must divide the WL sector size.
+ *
+ * With a cache, sector writes are held in it and written back by a flush
+ * task once they are flush_interval_ms old, so repeated writes of the FAT,
+ * directory and data sectors cost one erase per interval. fclose(), fsync()
+ * and f_sync() write the drive's dirty sectors back (CTRL_SYNC), in the
+ * order they were written; storage_diskio_detach() before unmounting.
+ *
+ * @param wl        Handle returned by esp_vfs_fat_spiflash_mount()
+ * @param arb       The arbiter, it must outlive the mount
+ * @param cache_cfg Cache geometry and flush interval, NULL for no cache; sector_size, read, write and ctx are set here
+ *
+ * @return
+ *     - ESP_OK
+ *     - ESP_ERR_NOT_FOUND the partition is not mounted
+ *     - ESP_ERR_NO_MEM
+ *     - ESP_FAIL the flush task could not be started
+ */
+esp_err_t storage_diskio_attach(wl_handle_t wl, flash_arbiter_handle_t arb, const sector_cache_cfg_t *cache_cfg);
+
+/**
+ * @brief Write back all dirty cached sectors
+ */
+esp_err_t storage_diskio_sync(wl_handle_t wl);
+
+/**
+ * @brief Verify the drive in the background: a fat_verifier that reads flash past the cache and sees every write back
+ *
+ * Sectors are read through the arbiter like any other flash read; nothing
+ * is written for the check. Call fat_verifier_tick() on the handle from
+ * storage_diskio_get_verifier() periodically. Detaching frees it.
+ *
+ * @param wl    Handle returned by esp_vfs_fat_spiflash_mount(), attached with storage_diskio_attach()
+ * @param cfg   Budget and slice per tick; sector_size, num_sectors, read and ctx are set here
+ *
+ * @return
+ *     - ESP_OK
+ *     - ESP_ERR_NOT_FOUND the partition is not mounted
+ *     - ESP_ERR_INVALID_STATE the drive has a verifier already
+ *     - ESP_ERR_NO_MEM
+ */
+esp_err_t storage_diskio_attach_verifier(wl_handle_t wl, const fat_verifier_cfg_t *cfg);
+
+/**
+ * @brief The verifier of a drive, NULL if it has none
+ */
+fat_verifier_handle_t storage_diskio_get_verifier(wl_handle_t wl);
+
+/**
+ * @brief Stop the flush task, write back and free the cache and the verifier, before unmounting
+ */
+esp_err_t storage_diskio_detach(wl_handle_t wl);
+
+/**
+ * @brief The cache of a drive, e.g. for its counters; NULL if it has none
+ */
+sector_cache_handle_t storage_diskio_get_cache(wl_handle_t wl);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,173 @@
+/* Software volume: Q15 gain element with linear ramps between volume steps
+
+   This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#include <math.h>
+#include "esp_log.h"
+#include "audio_mem.h"
+#include "audio_error.h"
+#include "sw_gain.h"
+
+static const char *TAG = "SW_GAIN";
+
+#define GAIN_FRAC_BITS  (15)                            // Q15 as applied
+#define RAMP_BITS       (15)                            // extra fraction kept while ramping
+#define ROUND           (1 << (GAIN_FRAC_BITS - 1))
+
+typedef struct {
+    sw_gain_cfg_t cfg;
+    sw_gain_ramp_t ramp;                // element task only
+    int ramp_frames;
+    volatile int32_t target;            // Q15, set by sw_gain_set_volume(), one word
+    bool applied;                       // element task: a new target was taken, not yet reported
+    sw_gain_applied_cb_t applied_cb;
+    void *applied_ctx;
+} sw_gain_t;
+
+int32_t sw_gain_volume_to_q15(int volume) {
+    if (volume <= 0) {
+        return 0;
+    }
+    if (volume >= 100) {
+        return SW_GAIN_UNITY;
+    }
+    double db = -SW_GAIN_RANGE_DB * (100 - volume) / 99.0;
+    return (int32_t)lrint(pow(10, db / 20) * SW_GAIN_UNITY);
+}
+
+void sw_gain_ramp_init(sw_gain_ramp_t *r, int32_t gain_q15) {
+    r->target = gain_q15;
+    r->gain = gain_q15 << RAMP_BITS;
+    r->step = 0;
+    r->frames_left = 0;
+}
+
+void sw_gain_ramp_set(sw_gain_ramp_t *r, int32_t target_q15, int frames) {
+    r->target = target_q15;
+    if (frames <= 0) {
+        sw_gain_ramp_init(r, target_q15);
+        return;
+    }
+    r->step = ((target_q15 << RAMP_BITS) - r->gain) / frames;
+    r->frames_left = frames;
+}
+
+void sw_gain_apply(sw_gain_ramp_t *r, int16_t *buf, int frames, int channels) {
+    int i = 0;
+    int ramp = frames < r->frames_left ? frames : r->frames_left;
+    if (ramp > 0) {
+        int32_t g = r->gain;
+        for (int f = 0; f < ramp; f++) {
+            int32_t q = g >> RAMP_BITS;
+            for (int c = 0; c < channels; c++, i++) {
+                buf[i] = (buf[i] * q + ROUND) >> GAIN_FRAC_BITS;
+            }
+            g += r->step;
+        }
+        r->frames_left -= ramp;
+        // the last step lands on the target whatever the division left over
+        r->gain = r->frames_left ? g : r->target << RAMP_BITS;
+    }
+    int32_t q = r->gain >> RAMP_BITS;
+    if (q == SW_GAIN_UNITY) {
+        return;
+    }
+    // at most 1.0, so no saturation: the loop the compiler vectorises
+    int n = frames * channels;
+    for (; i < n; i++) {
+        buf[i] = (buf[i] * q + ROUND) >> GAIN_FRAC_BITS;
+    }
+}
+
+static esp_err_t _sw_gain_open(audio_element_handle_t self) {
+    sw_gain_t *gain = (sw_gain_t *)audio_element_getdata(self);
+    // a volume set while stopped applies at once
+    int32_t target = gain->target;
+    gain->applied = target != gain->ramp.target;
+    sw_gain_ramp_init(&gain->ramp, target);
+    return ESP_OK;
+}
+
+static audio_element_err_t _sw_gain_process(audio_element_handle_t self, char *in_buffer, int in_len) {
+    sw_gain_t *gain = (sw_gain_t *)audio_element_getdata(self);
+    int r = audio_element_input(self, in_buffer, in_len);
+    if (r <= 0) {
+        return r;
+    }
+    int32_t target = gain->target;
+    if (target != gain->ramp.target) {
+        sw_gain_ramp_set(&gain->ramp, target, gain->ramp_frames);
+        gain->applied = true;
+    }
+    // upstream writes whole frames, a partial one would pass unchanged
+    int frame_bytes = gain->cfg.channels * sizeof(int16_t);
+    sw_gain_apply(&gain->ramp, (int16_t *)in_buffer, r / frame_bytes, gain->cfg.channels);
+    if (gain->applied) {
+        gain->applied = false;
+        if (gain->applied_cb) {
+            gain->applied_cb(gain->applied_ctx);
+        }
+    }
+    int w = audio_element_output(self, in_buffer, r);
+    if (w > 0) {
+        audio_element_update_byte_pos(self, w);
+    }
+    return w;
+}
+
+static esp_err_t _sw_gain_destroy(audio_element_handle_t self) {
+    audio_free(audio_element_getdata(self));
+    return ESP_OK;
+}
+
+audio_element_handle_t sw_gain_init(sw_gain_cfg_t *config) {
+    AUDIO_NULL_CHECK(TAG, config, return NULL);
+    if (config->sample_rate <= 0 || config->channels <= 0 || config->ramp_ms < 0) {
+        ESP_LOGE(TAG, "invalid config, %d Hz, %d channels, %d ms ramps", config->sample_rate, config->channels,
+                 config->ramp_ms);
+        return NULL;
+    }
+    sw_gain_t *gain = audio_calloc(1, sizeof(sw_gain_t));
+    AUDIO_MEM_CHECK(TAG, gain, return NULL);
+    gain->cfg = *config;
+    gain->ramp_frames = config->sample_rate * config->ramp_ms / 1000;
+    gain->target = sw_gain_volume_to_q15(config->volume);
+    sw_gain_ramp_init(&gain->ramp, gain->target);
+
+    audio_element_cfg_t cfg = DEFAULT_AUDIO_ELEMENT_CONFIG();
+    cfg.open = _sw_gain_open;
+    cfg.process = _sw_gain_process;
+    cfg.destroy = _sw_gain_destroy;
+    cfg.buffer_len = config->buffer_len;
+    cfg.out_rb_size = config->out_rb_size;
+    cfg.task_stack = config->task_stack;
+    cfg.task_core = config->task_core;
+    cfg.task_prio = config->task_prio;
+    cfg.stack_in_ext = config->stack_in_ext;
+    cfg.data = gain;
+    cfg.tag = "gain";
+    audio_element_handle_t el = audio_element_init(&cfg);
+    AUDIO_MEM_CHECK(TAG, el, {
+        audio_free(gain);
+        return NULL;
+    });
+    audio_element_set_music_info(el, config->sample_rate, config->channels, 16);
+    return el;
+}
+
+void sw_gain_set_applied_cb(audio_element_handle_t el, sw_gain_applied_cb_t fn, void *ctx) {
+    sw_gain_t *gain = (sw_gain_t *)audio_element_getdata(el);
+    gain->applied_cb = fn;
+    gain->applied_ctx = ctx;
+}
+
+void sw_gain_set_volume(audio_element_handle_t el, int volume, bool mute) {
+    sw_gain_t *gain = (sw_gain_t *)audio_element_getdata(el);
+    gain->target = mute ? 0 : sw_gain_volume_to_q15(volume);
+    ESP_LOGD(TAG, "volume %d%s, gain %d/%d", volume, mute ? " (muted)" : "", (int)gain->target, SW_GAIN_UNITY);
+}
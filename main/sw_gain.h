@@ -0,0 +1,135 @@
+/* Software volume: Q15 gain element with linear ramps between volume steps
+
+   This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#ifndef _SW_GAIN_H_
+#define _SW_GAIN_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "audio_element.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SW_GAIN_UNITY       (1 << 15)   /*!< Gain of 1.0 in Q15 */
+#define SW_GAIN_RANGE_DB    (50)        /*!< Attenuation of volume 1, volume 0 is silence */
+
+/**
+ * @brief Gain ramp state, the kernel the element runs on every block
+ *
+ * The gain is kept with 15 more fractional bits than the Q15 it is applied
+ * as, so a ramp of any length moves it by the same amount every frame and
+ * lands on the target exactly.
+ */
+typedef struct {
+    int32_t gain;           /*!< Current gain, Q30 */
+    int32_t step;           /*!< Added per frame while ramping, Q30 */
+    int32_t target;         /*!< Q15 */
+    int     frames_left;    /*!< Frames until the target is reached, 0 when steady */
+} sw_gain_ramp_t;
+
+/**
+ * @brief Q15 gain of a volume: SW_GAIN_RANGE_DB over 1..100 in equal dB steps, 0 is silence
+ */
+int32_t sw_gain_volume_to_q15(int volume);
+
+/**
+ * @brief Start at a gain without ramping
+ */
+void sw_gain_ramp_init(sw_gain_ramp_t *r, int32_t gain_q15);
+
+/**
+ * @brief Ramp linearly from the current gain, wherever a previous ramp got to, to target_q15 over frames
+ */
+void sw_gain_ramp_set(sw_gain_ramp_t *r, int32_t target_q15, int frames);
+
+/**
+ * @brief Apply the gain to interleaved 16 bit PCM in place, advancing the ramp
+ *
+ * A steady gain is one multiply and shift per sample with no saturation (the
+ * gain never exceeds 1.0), unity leaves the buffer untouched.
+ */
+void sw_gain_apply(sw_gain_ramp_t *r, int16_t *buf, int frames, int channels);
+
+/**
+ * @brief Gain element configuration
+ */
+typedef struct {
+    int  sample_rate;       /*!< Of the PCM passing through, for the ramp length */
+    int  channels;
+    int  ramp_ms;           /*!< Duration of a ramp from one volume to another */
+    int  volume;            /*!< Initial volume, 0~100 */
+    int  buffer_len;
+    int  out_rb_size;
+    int  task_stack;
+    int  task_core;
+    int  task_prio;
+    bool stack_in_ext;
+} sw_gain_cfg_t;
+
+#define SW_GAIN_TASK_STACK_SIZE     (2 * 1024)
+#define SW_GAIN_TASK_CORE           (0)
+#define SW_GAIN_TASK_PRIO           (5)
+#define SW_GAIN_RINGBUFFER_SIZE     (8 * 1024)
+
+#define SW_GAIN_CFG_DEFAULT() {                     \
+    .sample_rate = 44100,                           \
+    .channels = 2,                                  \
+    .ramp_ms = 20,                                  \
+    .volume = 100,                                  \
+    .buffer_len = 2048,                             \
+    .out_rb_size = SW_GAIN_RINGBUFFER_SIZE,         \
+    .task_stack = SW_GAIN_TASK_STACK_SIZE,          \
+    .task_core = SW_GAIN_TASK_CORE,                 \
+    .task_prio = SW_GAIN_TASK_PRIO,                 \
+    .stack_in_ext = true,                           \
+}
+
+/**
+ * @brief Create the gain element, 16 bit PCM in and out
+ *
+ * @return The element, NULL on error
+ */
+audio_element_handle_t sw_gain_init(sw_gain_cfg_t *cfg);
+
+/**
+ * @brief Called in the gain element's task when it starts ramping to a new volume
+ */
+typedef void (*sw_gain_applied_cb_t)(void *ctx);
+
+/**
+ * @brief Be told when a volume set by sw_gain_set_volume() reaches the PCM, e.g. to trace its latency
+ *
+ * fn runs after the first block with the new gain is processed, before it is
+ * written out. Set it before the element runs.
+ *
+ * @param el  The gain element
+ * @param fn  Callback, NULL to remove it
+ * @param ctx Context of fn
+ */
+void sw_gain_set_applied_cb(audio_element_handle_t el, sw_gain_applied_cb_t fn, void *ctx);
+
+/**
+ * @brief Set the volume, the element ramps to it from the next block on
+ *
+ * Callable from any task, e.g. the codec driver's volume callback.
+ *
+ * @param el     The gain element
+ * @param volume 0~100
+ * @param mute   Ramp to silence, keeping the volume
+ */
+void sw_gain_set_volume(audio_element_handle_t el, int volume, bool mute);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
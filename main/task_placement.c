@@ -0,0 +1,255 @@
+/* Task placement table: core, priority, stack and stack memory of every task the player spawns
+
+   This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "nvs.h"
+#include "task_placement.h"
+
+static const char *TAG = "TASK_PLACEMENT";
+
+static const char *class_name[] = {"audio", "storage", "background"};
+
+#define RECORD_VERSION      1
+#define RECORD_KEY          "task_cores"
+// an NVS write may erase a page on the way: schedule it as a sector erase
+#define NVS_SECTOR_SIZE     4096
+
+typedef struct {
+    uint8_t  version;
+    uint8_t  num_tasks;
+    uint16_t reserved;
+    uint32_t names;         // FNV-1a of the task names, in table order
+    int8_t   core[TASK_PLACEMENT_MAX_TASKS];
+} record_t;
+
+typedef struct {
+    nvs_handle_t nvs;
+    const record_t *rec;
+} save_ctx_t;
+
+static task_placement_t *table;
+static int num_tasks;
+
+static int find_task(const char *name) {
+    if (!name) {
+        return -1;
+    }
+    for (int i = 0; i < num_tasks; i++) {
+        if (!strcmp(table[i].name, name)) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static uint32_t names_hash(void) {
+    uint32_t h = 2166136261u;
+    for (int i = 0; i < num_tasks; i++) {
+        // the terminator too, "ab" + "c" is not "a" + "bc"
+        const char *c = table[i].name;
+        do {
+            h = (h ^ (uint8_t)*c) * 16777619u;
+        } while (*c++);
+    }
+    return h;
+}
+
+static bool core_valid(int core) {
+    return core == TASK_PLACEMENT_ANY_CORE || (core >= 0 && core < TASK_PLACEMENT_NUM_CORES);
+}
+
+esp_err_t task_placement_init(task_placement_t *t, int n) {
+    if (n < 0 || n > TASK_PLACEMENT_MAX_TASKS || (n && !t)) {
+        ESP_LOGE(TAG, "%d tasks, at most %d", n, TASK_PLACEMENT_MAX_TASKS);
+        return ESP_ERR_INVALID_ARG;
+    }
+    for (int i = 0; i < n; i++) {
+        if (!t[i].name || !core_valid(t[i].core)) {
+            ESP_LOGE(TAG, "entry %d: no name or core %d", i, t[i].core);
+            return ESP_ERR_INVALID_ARG;
+        }
+    }
+    table = t;
+    num_tasks = n;
+    return ESP_OK;
+}
+
+const task_placement_t *task_placement_get(const char *name) {
+    int i = find_task(name);
+    return i < 0 ? NULL : &table[i];
+}
+
+bool task_placement_apply(const char *name, int *core, int *prio, int *stack, bool *stack_in_ext) {
+    const task_placement_t *t = task_placement_get(name);
+    if (!t) {
+        return false;
+    }
+    if (core) {
+        *core = t->core == TASK_PLACEMENT_ANY_CORE ? tskNO_AFFINITY : t->core;
+    }
+    if (prio) {
+        *prio = t->prio;
+    }
+    if (stack) {
+        *stack = t->stack;
+    }
+    if (stack_in_ext) {
+        *stack_in_ext = t->stack_in_ext;
+    }
+    return true;
+}
+
+static const task_load_t *find_load(const task_load_t *loads, int num_loads, const char *name) {
+    for (int i = 0; i < num_loads; i++) {
+        if (loads[i].name && !strcmp(loads[i].name, name)) {
+            return &loads[i];
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Whether a core holds a task of the class that should not share it with cls
+ */
+static bool class_conflict(const bool has[TASK_CLASS_BACKGROUND + 1], task_class_t cls) {
+    return (cls == TASK_CLASS_AUDIO && has[TASK_CLASS_STORAGE]) || (cls == TASK_CLASS_STORAGE && has[TASK_CLASS_AUDIO]);
+}
+
+int task_placement_plan(const task_load_t *loads, int num_loads, const int other_permille[TASK_PLACEMENT_NUM_CORES]) {
+    int load[TASK_PLACEMENT_NUM_CORES] = {0};
+    bool has[TASK_PLACEMENT_NUM_CORES][TASK_CLASS_BACKGROUND + 1] = {{false}};
+    int order[TASK_PLACEMENT_MAX_TASKS];
+    int permille[TASK_PLACEMENT_MAX_TASKS];
+    int num_order = 0;
+    for (int c = 0; c < TASK_PLACEMENT_NUM_CORES; c++) {
+        load[c] = other_permille ? other_permille[c] : 0;
+    }
+    for (int i = 0; i < num_tasks; i++) {
+        if (table[i].core == TASK_PLACEMENT_ANY_CORE) {
+            continue;
+        }
+        const task_load_t *l = find_load(loads, num_loads, table[i].name);
+        if (!l) {
+            // not running while measured, it stays
+            continue;
+        }
+        permille[i] = l->permille;
+        // insertion sort, heaviest first; ties keep the table order
+        int j = num_order;
+        while (j > 0 && permille[order[j - 1]] < permille[i]) {
+            order[j] = order[j - 1];
+            j--;
+        }
+        order[j] = i;
+        num_order++;
+    }
+    int moved = 0;
+    for (int k = 0; k < num_order; k++) {
+        task_placement_t *t = &table[order[k]];
+        int best = t->core;
+        int best_cost = 0;
+        for (int c = 0; c < TASK_PLACEMENT_NUM_CORES; c++) {
+            int cost = load[c] + permille[order[k]] + (class_conflict(has[c], t->cls) ? TASK_PLACEMENT_CLASS_PENALTY : 0);
+            // on a tie the task stays where it is
+            if (c == 0 || cost < best_cost || (cost == best_cost && c == t->core)) {
+                best = c;
+                best_cost = cost;
+            }
+        }
+        if (best != t->core) {
+            ESP_LOGI(TAG, "%s: core %d -> %d, %d.%d%% of a core", t->name, t->core, best, permille[order[k]] / 10,
+                     permille[order[k]] % 10);
+            t->core = best;
+            moved++;
+        }
+        load[best] += permille[order[k]];
+        has[best][t->cls] = true;
+    }
+    return moved;
+}
+
+esp_err_t task_placement_restore(const char *nvs_namespace) {
+    nvs_handle_t nvs;
+    esp_err_t err = nvs_open(nvs_namespace, NVS_READONLY, &nvs);
+    if (err != ESP_OK) {
+        return err == ESP_ERR_NVS_NOT_FOUND ? ESP_ERR_NOT_FOUND : err;
+    }
+    record_t rec;
+    size_t len = sizeof(rec);
+    err = nvs_get_blob(nvs, RECORD_KEY, &rec, &len);
+    nvs_close(nvs);
+    if (err != ESP_OK || len != sizeof(rec)) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    if (rec.version != RECORD_VERSION || rec.num_tasks != num_tasks || rec.names != names_hash()) {
+        ESP_LOGW(TAG, "saved placement is for another task table");
+        return ESP_ERR_NOT_FOUND;
+    }
+    for (int i = 0; i < num_tasks; i++) {
+        if (!core_valid(rec.core[i])) {
+            return ESP_ERR_NOT_FOUND;
+        }
+    }
+    for (int i = 0; i < num_tasks; i++) {
+        table[i].core = rec.core[i];
+    }
+    return ESP_OK;
+}
+
+static esp_err_t write_record(flash_op_t op, size_t addr, void *buf, size_t size, void *ctx) {
+    save_ctx_t *save = (save_ctx_t *)ctx;
+    esp_err_t err = nvs_set_blob(save->nvs, RECORD_KEY, save->rec, sizeof(record_t));
+    return err == ESP_OK ? nvs_commit(save->nvs) : err;
+}
+
+esp_err_t task_placement_save(const char *nvs_namespace, flash_arbiter_handle_t arbiter) {
+    record_t rec = {
+        .version = RECORD_VERSION,
+        .num_tasks = num_tasks,
+        .names = names_hash(),
+    };
+    for (int i = 0; i < num_tasks; i++) {
+        rec.core[i] = table[i].core;
+    }
+    save_ctx_t save = {
+        .rec = &rec,
+    };
+    esp_err_t err = nvs_open(nvs_namespace, NVS_READWRITE, &save.nvs);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "nvs_open(%s) failed, %s", nvs_namespace, esp_err_to_name(err));
+        return err;
+    }
+    if (arbiter) {
+        err = flash_arbiter_run(arbiter, FLASH_OP_ERASE, 0, &rec, NVS_SECTOR_SIZE, write_record, &save);
+    } else {
+        err = write_record(FLASH_OP_WRITE, 0, &rec, sizeof(rec), &save);
+    }
+    nvs_close(save.nvs);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "saving the placement failed, %s", esp_err_to_name(err));
+    }
+    return err;
+}
+
+void task_placement_report(void) {
+    ESP_LOGI(TAG, "%-14s %-10s %4s %4s %6s %-8s", "task", "class", "core", "prio", "stack", "stack in");
+    for (int i = 0; i < num_tasks; i++) {
+        const task_placement_t *t = &table[i];
+        char core[4] = "any";
+        if (t->core != TASK_PLACEMENT_ANY_CORE) {
+            core[0] = '0' + t->core;
+            core[1] = '\0';
+        }
+        ESP_LOGI(TAG, "%-14s %-10s %4s %4d %6d %-8s", t->name, class_name[t->cls], core, t->prio, t->stack,
+                 t->stack_in_ext ? "psram" : "internal");
+    }
+}
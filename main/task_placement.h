@@ -0,0 +1,130 @@
+/* Task placement table: core, priority, stack and stack memory of every task the player spawns
+
+   This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#ifndef _TASK_PLACEMENT_H_
+#define _TASK_PLACEMENT_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "flash_arbiter.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define TASK_PLACEMENT_MAX_TASKS    (12)
+#define TASK_PLACEMENT_NUM_CORES    (2)
+#define TASK_PLACEMENT_ANY_CORE     (-1)        /*!< Not pinned, left to the scheduler and the planner */
+
+/**
+ * @brief What a task does, the planner keeps audio and storage tasks apart where the loads allow
+ */
+typedef enum {
+    TASK_CLASS_AUDIO,           /*!< Decoder, PCM stages, i2s: late means a gap */
+    TASK_CLASS_STORAGE,         /*!< FAT and flash I/O, blocks in flash operations */
+    TASK_CLASS_BACKGROUND,
+} task_class_t;
+
+/**
+ * @brief One task
+ */
+typedef struct {
+    const char      *name;          /*!< FreeRTOS task name; the element tag for pipeline elements */
+    task_class_t    cls;
+    int             core;           /*!< 0 or 1, TASK_PLACEMENT_ANY_CORE */
+    int             prio;
+    int             stack;          /*!< Bytes */
+    bool            stack_in_ext;   /*!< Stack in PSRAM, needs CONFIG_SPIRAM_ALLOW_STACK_EXTERNAL_MEMORY */
+} task_placement_t;
+
+/**
+ * @brief Measured load of a task, see task_profiler_get_loads()
+ */
+typedef struct {
+    const char  *name;
+    int         permille;           /*!< CPU time, in thousandths of one core */
+    uint32_t    preempted;          /*!< Samples that found it ready but not running */
+} task_load_t;
+
+/**
+ * @brief Set the table the player's tasks are created from
+ *
+ * The table is used in place, task_placement_restore() and
+ * task_placement_plan() change the cores in it. NULL for none: every task
+ * keeps the placement of its module's default config.
+ *
+ * @return
+ *     - ESP_OK
+ *     - ESP_ERR_INVALID_ARG More than TASK_PLACEMENT_MAX_TASKS, a core out of range
+ */
+esp_err_t task_placement_init(task_placement_t *table, int num_tasks);
+
+/**
+ * @brief The entry of a task, NULL if the table has none
+ */
+const task_placement_t *task_placement_get(const char *name);
+
+/**
+ * @brief Overwrite a module's task config with the task's entry, if there is one
+ *
+ * Any of the pointers may be NULL. An unpinned entry sets the core to
+ * tskNO_AFFINITY.
+ *
+ * @return Whether the table has the task
+ */
+bool task_placement_apply(const char *name, int *core, int *prio, int *stack, bool *stack_in_ext);
+
+/**
+ * @brief Move pinned tasks between the cores to balance the measured loads
+ *
+ * Heaviest first, each task goes to the core with the least load so far,
+ * starting from other_permille (what runs there outside the table). A core
+ * already holding a task of the other class of audio and storage counts
+ * TASK_PLACEMENT_CLASS_PENALTY heavier. Tasks without a measurement did
+ * not run: they keep their core and count for neither load nor class.
+ *
+ * @param loads          Measurements, in any order
+ * @param num_loads      Entries in loads
+ * @param other_permille Load of each core from tasks not in the table
+ *
+ * @return Number of tasks moved
+ */
+int task_placement_plan(const task_load_t *loads, int num_loads, const int other_permille[TASK_PLACEMENT_NUM_CORES]);
+
+#define TASK_PLACEMENT_CLASS_PENALTY    (100)   /*!< In permille of a core */
+
+/**
+ * @brief Take the cores saved by task_placement_save(), if the table still has the same tasks
+ *
+ * @return
+ *     - ESP_OK
+ *     - ESP_ERR_NOT_FOUND Nothing saved, or saved for another table
+ *     - the error of nvs_open()
+ */
+esp_err_t task_placement_restore(const char *nvs_namespace);
+
+/**
+ * @brief Save the cores of the table for the next boot
+ *
+ * @param nvs_namespace NVS namespace
+ * @param arbiter       Run the NVS write in an arbiter window, NULL to write directly
+ */
+esp_err_t task_placement_save(const char *nvs_namespace, flash_arbiter_handle_t arbiter);
+
+/**
+ * @brief Log the table
+ */
+void task_placement_report(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,331 @@
+/* Per-core runtime and preemption profile of the player's tasks
+
+   This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "audio_mem.h"
+#include "audio_error.h"
+#include "task_profiler.h"
+
+static const char *TAG = "TASK_PROFILER";
+
+#define SAMPLER_ENABLED (CONFIG_FREERTOS_USE_TRACE_FACILITY && CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS)
+#define NAME_LEN        16      // CONFIG_FREERTOS_MAX_TASK_NAME_LEN
+
+typedef struct {
+    char     name[NAME_LEN];
+    int      core;
+    bool     idle;
+    uint32_t last;              // counter at the last sample
+    uint64_t runtime_us;
+    uint32_t preempted;
+    uint32_t samples;
+} slot_t;
+
+struct task_profiler {
+    task_profiler_cfg_t cfg;
+    portMUX_TYPE lock;
+    slot_t slot[TASK_PROFILER_MAX_TASKS];
+    int num_slots;
+    uint32_t untracked;         // samples of tasks that found no free slot
+    int64_t first_us;           // -1 before the first sample
+    int64_t last_us;
+
+    volatile bool quit;
+    SemaphoreHandle_t done;     // NULL while the sampling task is not running
+#if SAMPLER_ENABLED
+    TaskStatus_t status[TASK_PROFILER_MAX_TASKS];
+    task_profiler_snapshot_t snap[TASK_PROFILER_MAX_TASKS];
+#endif
+};
+
+static slot_t *find_slot_locked(task_profiler_handle_t prof, const char *name) {
+    for (int i = 0; i < prof->num_slots; i++) {
+        if (!strncmp(prof->slot[i].name, name, NAME_LEN - 1)) {
+            return &prof->slot[i];
+        }
+    }
+    return NULL;
+}
+
+static uint64_t elapsed_locked(task_profiler_handle_t prof) {
+    return prof->first_us < 0 ? 0 : prof->last_us - prof->first_us;
+}
+
+static int permille(uint64_t part, uint64_t whole) {
+    return whole ? (int)((part * 1000 + whole / 2) / whole) : 0;
+}
+
+static int core_permille_locked(task_profiler_handle_t prof, int core) {
+    uint64_t elapsed = elapsed_locked(prof);
+    for (int i = 0; i < prof->num_slots; i++) {
+        if (prof->slot[i].idle && prof->slot[i].core == core) {
+            return elapsed ? 1000 - permille(prof->slot[i].runtime_us, elapsed) : -1;
+        }
+    }
+    return -1;
+}
+
+task_profiler_handle_t task_profiler_create(const task_profiler_cfg_t *cfg) {
+    AUDIO_NULL_CHECK(TAG, cfg, return NULL);
+    if (cfg->period_ms <= 0) {
+        ESP_LOGE(TAG, "invalid sampling period %d ms", cfg->period_ms);
+        return NULL;
+    }
+    task_profiler_handle_t prof = audio_calloc(1, sizeof(struct task_profiler));
+    AUDIO_MEM_CHECK(TAG, prof, return NULL);
+    prof->cfg = *cfg;
+    portMUX_TYPE unlocked = portMUX_INITIALIZER_UNLOCKED;
+    prof->lock = unlocked;
+    prof->first_us = -1;
+    return prof;
+}
+
+void task_profiler_destroy(task_profiler_handle_t prof) {
+    if (!prof) {
+        return;
+    }
+    task_profiler_stop(prof);
+    audio_free(prof);
+}
+
+#if SAMPLER_ENABLED
+static void sample_task(void *ctx) {
+    task_profiler_handle_t prof = (task_profiler_handle_t)ctx;
+    TickType_t period = pdMS_TO_TICKS(prof->cfg.period_ms);
+    TickType_t wake = xTaskGetTickCount();
+    TaskHandle_t self = xTaskGetCurrentTaskHandle();
+    int own = xPortGetCoreID();
+    TaskHandle_t idle[TASK_PLACEMENT_NUM_CORES];
+    for (int c = 0; c < TASK_PLACEMENT_NUM_CORES; c++) {
+        idle[c] = xTaskGetIdleTaskHandleForCPU(c);
+    }
+    while (!prof->quit) {
+        vTaskDelayUntil(&wake, period ? period : 1);
+        int n = uxTaskGetSystemState(prof->status, TASK_PROFILER_MAX_TASKS, NULL);
+        int64_t now = esp_timer_get_time();
+        // reported ready while it runs there
+        TaskHandle_t other_running = xTaskGetCurrentTaskHandleForCPU(!own);
+        int preempted_here = -1;
+        for (int i = 0; i < n; i++) {
+            const TaskStatus_t *s = &prof->status[i];
+            task_profiler_snapshot_t *snap = &prof->snap[i];
+            BaseType_t affinity = xTaskGetAffinity(s->xHandle);
+            snap->name = s->pcTaskName;
+            snap->core = affinity == tskNO_AFFINITY ? TASK_PLACEMENT_ANY_CORE : affinity;
+            snap->runtime = s->ulRunTimeCounter;
+            snap->ready = s->eCurrentState == eReady && s->xHandle != other_running;
+            snap->idle = false;
+            for (int c = 0; c < TASK_PLACEMENT_NUM_CORES; c++) {
+                if (s->xHandle == idle[c]) {
+                    snap->idle = true;
+                    snap->core = c;
+                }
+            }
+            if (snap->ready && s->xHandle != self && (snap->core == own || snap->core == TASK_PLACEMENT_ANY_CORE)
+                && (preempted_here < 0 || s->uxCurrentPriority > prof->status[preempted_here].uxCurrentPriority)) {
+                preempted_here = i;
+            }
+        }
+        // what ran here until this task woke up
+        if (preempted_here >= 0) {
+            prof->snap[preempted_here].ready = false;
+        }
+        task_profiler_sample(prof, prof->snap, n, now);
+    }
+    xSemaphoreGive(prof->done);
+    vTaskDelete(NULL);
+}
+#endif
+
+esp_err_t task_profiler_start(task_profiler_handle_t prof) {
+    AUDIO_NULL_CHECK(TAG, prof, return ESP_ERR_INVALID_ARG);
+#if SAMPLER_ENABLED
+    if (prof->done) {
+        return ESP_OK;
+    }
+    prof->quit = false;
+    prof->done = xSemaphoreCreateBinary();
+    AUDIO_MEM_CHECK(TAG, prof->done, return ESP_FAIL);
+    if (xTaskCreatePinnedToCore(sample_task, "task_profiler", prof->cfg.task_stack, prof, prof->cfg.task_prio, NULL,
+                                prof->cfg.task_core) != pdPASS) {
+        ESP_LOGE(TAG, "failed to create the sampling task");
+        vSemaphoreDelete(prof->done);
+        prof->done = NULL;
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+#else
+    ESP_LOGW(TAG, "needs CONFIG_FREERTOS_USE_TRACE_FACILITY and CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS");
+    return ESP_ERR_NOT_SUPPORTED;
+#endif
+}
+
+void task_profiler_stop(task_profiler_handle_t prof) {
+    if (!prof || !prof->done) {
+        return;
+    }
+    prof->quit = true;
+    xSemaphoreTake(prof->done, portMAX_DELAY);
+    vSemaphoreDelete(prof->done);
+    prof->done = NULL;
+}
+
+esp_err_t task_profiler_sample(task_profiler_handle_t prof, const task_profiler_snapshot_t *tasks, int num_tasks,
+                               int64_t now_us) {
+    AUDIO_NULL_CHECK(TAG, prof && (tasks || !num_tasks), return ESP_ERR_INVALID_ARG);
+    portENTER_CRITICAL(&prof->lock);
+    if (prof->first_us < 0) {
+        prof->first_us = now_us;
+    }
+    prof->last_us = now_us;
+    for (int i = 0; i < num_tasks; i++) {
+        const task_profiler_snapshot_t *t = &tasks[i];
+        slot_t *s = find_slot_locked(prof, t->name);
+        if (!s) {
+            if (prof->num_slots == TASK_PROFILER_MAX_TASKS) {
+                prof->untracked++;
+                continue;
+            }
+            s = &prof->slot[prof->num_slots++];
+            strncpy(s->name, t->name, NAME_LEN - 1);
+            s->last = t->runtime;
+        }
+        // backwards: a new task under the name of one that was deleted; a wrap of the counter is a small step
+        int32_t ran = (int32_t)(t->runtime - s->last);
+        if (ran > 0) {
+            s->runtime_us += ran;
+        }
+        s->last = t->runtime;
+        s->core = t->core;
+        s->idle = t->idle;
+        s->preempted += t->ready;
+        s->samples++;
+    }
+    portEXIT_CRITICAL(&prof->lock);
+    return ESP_OK;
+}
+
+void task_profiler_reset(task_profiler_handle_t prof) {
+    if (!prof) {
+        return;
+    }
+    portENTER_CRITICAL(&prof->lock);
+    memset(prof->slot, 0, sizeof(prof->slot));
+    prof->num_slots = 0;
+    prof->untracked = 0;
+    prof->first_us = -1;
+    portEXIT_CRITICAL(&prof->lock);
+}
+
+int task_profiler_core_permille(task_profiler_handle_t prof, int core) {
+    AUDIO_NULL_CHECK(TAG, prof, return -1);
+    portENTER_CRITICAL(&prof->lock);
+    int busy = core_permille_locked(prof, core);
+    portEXIT_CRITICAL(&prof->lock);
+    return busy;
+}
+
+esp_err_t task_profiler_get_task(task_profiler_handle_t prof, const char *name, task_profiler_task_t *task) {
+    AUDIO_NULL_CHECK(TAG, prof && name && task, return ESP_ERR_INVALID_ARG);
+    portENTER_CRITICAL(&prof->lock);
+    const slot_t *s = find_slot_locked(prof, name);
+    if (s) {
+        *task = (task_profiler_task_t) {
+            .name = s->name,
+            .core = s->core,
+            .runtime_us = s->runtime_us,
+            .preempted = s->preempted,
+            .samples = s->samples,
+        };
+    }
+    portEXIT_CRITICAL(&prof->lock);
+    return s ? ESP_OK : ESP_ERR_NOT_FOUND;
+}
+
+int task_profiler_get_loads(task_profiler_handle_t prof, task_load_t *loads, int max_loads,
+                            int other_permille[TASK_PLACEMENT_NUM_CORES]) {
+    AUDIO_NULL_CHECK(TAG, prof && (loads || !max_loads), return 0);
+    int n = 0;
+    portENTER_CRITICAL(&prof->lock);
+    uint64_t elapsed = elapsed_locked(prof);
+    int other[TASK_PLACEMENT_NUM_CORES];
+    for (int c = 0; c < TASK_PLACEMENT_NUM_CORES; c++) {
+        int busy = core_permille_locked(prof, c);
+        other[c] = busy < 0 ? 0 : busy;
+    }
+    for (int i = 0; i < prof->num_slots; i++) {
+        const slot_t *s = &prof->slot[i];
+        if (s->idle) {
+            continue;
+        }
+        int load = permille(s->runtime_us, elapsed);
+        const task_placement_t *t = task_placement_get(s->name);
+        if (t && s->core != TASK_PLACEMENT_ANY_CORE) {
+            other[s->core] -= load;
+        }
+        if (n < max_loads) {
+            loads[n++] = (task_load_t) {
+                .name = s->name,
+                .permille = load,
+                .preempted = s->preempted,
+            };
+        }
+    }
+    portEXIT_CRITICAL(&prof->lock);
+    if (other_permille) {
+        for (int c = 0; c < TASK_PLACEMENT_NUM_CORES; c++) {
+            other_permille[c] = other[c] < 0 ? 0 : other[c];
+        }
+    }
+    return n;
+}
+
+void task_profiler_report(task_profiler_handle_t prof) {
+    if (!prof) {
+        return;
+    }
+    // a copy, the log must not run in the critical section
+    static slot_t slot[TASK_PROFILER_MAX_TASKS];
+    portENTER_CRITICAL(&prof->lock);
+    int num_slots = prof->num_slots;
+    memcpy(slot, prof->slot, num_slots * sizeof(slot_t));
+    uint64_t elapsed = elapsed_locked(prof);
+    uint32_t untracked = prof->untracked;
+    int busy[TASK_PLACEMENT_NUM_CORES];
+    for (int c = 0; c < TASK_PLACEMENT_NUM_CORES; c++) {
+        busy[c] = core_permille_locked(prof, c);
+    }
+    portEXIT_CRITICAL(&prof->lock);
+    ESP_LOGI(TAG, "%llu ms profiled, core 0 %d.%d%% busy, core 1 %d.%d%% busy", (unsigned long long)(elapsed / 1000),
+             busy[0] / 10, busy[0] % 10, busy[1] / 10, busy[1] % 10);
+    ESP_LOGI(TAG, "%-16s %4s %7s %9s %7s", "task", "core", "cpu %", "preempted", "ready %");
+    for (int i = 0; i < num_slots; i++) {
+        const slot_t *s = &slot[i];
+        if (s->idle) {
+            continue;
+        }
+        int load = permille(s->runtime_us, elapsed);
+        int ready = permille(s->preempted, s->samples);
+        char core[4] = "any";
+        if (s->core != TASK_PLACEMENT_ANY_CORE) {
+            core[0] = '0' + s->core;
+            core[1] = '\0';
+        }
+        ESP_LOGI(TAG, "%-16s %4s %5d.%d %9u %5d.%d", s->name, core, load / 10, load % 10, s->preempted, ready / 10,
+                 ready % 10);
+    }
+    if (untracked) {
+        ESP_LOGW(TAG, "%u task samples found no slot", untracked);
+    }
+}
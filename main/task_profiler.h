@@ -0,0 +1,141 @@
+/* Per-core runtime and preemption profile of the player's tasks
+
+   This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#ifndef _TASK_PROFILER_H_
+#define _TASK_PROFILER_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "task_placement.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define TASK_PROFILER_MAX_TASKS     (32)
+
+/**
+ * @brief One task at one sample, as uxTaskGetSystemState() has it
+ */
+typedef struct {
+    const char  *name;
+    int         core;           /*!< Core it is pinned to, TASK_PLACEMENT_ANY_CORE if none */
+    uint32_t    runtime;        /*!< Run time counter, us; it may wrap */
+    bool        ready;          /*!< Ready to run but not running: waiting for its core */
+    bool        idle;           /*!< The idle task of core */
+} task_profiler_snapshot_t;
+
+typedef struct {
+    int     period_ms;          /*!< Sampling period */
+    int     task_stack;         /*!< Sampling task, see task_profiler_start() */
+    int     task_prio;          /*!< Above the tasks it watches, or it only samples when they wait */
+    int     task_core;
+} task_profiler_cfg_t;
+
+#define TASK_PROFILER_CFG_DEFAULT() {   \
+    .period_ms = 10,                    \
+    .task_stack = 3072,                 \
+    .task_prio = 22,                    \
+    .task_core = 1,                     \
+}
+
+/**
+ * @brief What one task did since the first sample
+ */
+typedef struct {
+    const char  *name;
+    int         core;
+    uint64_t    runtime_us;
+    uint32_t    preempted;      /*!< Samples that found it ready but not running */
+    uint32_t    samples;        /*!< Samples it was seen in */
+} task_profiler_task_t;
+
+typedef struct task_profiler *task_profiler_handle_t;
+
+/**
+ * @brief Create a profiler
+ */
+task_profiler_handle_t task_profiler_create(const task_profiler_cfg_t *cfg);
+
+/**
+ * @brief Stop the sampling task and free the profiler
+ */
+void task_profiler_destroy(task_profiler_handle_t prof);
+
+/**
+ * @brief Start the sampling task
+ *
+ * On the task running on the sampler's own core the sample cannot tell
+ * whether it was preempted by the sampler or by another task: the highest
+ * priority ready task there is taken to be the one the sampler preempted.
+ *
+ * @return
+ *     - ESP_OK
+ *     - ESP_ERR_NOT_SUPPORTED Built without CONFIG_FREERTOS_USE_TRACE_FACILITY and
+ *       CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS, call task_profiler_sample() instead
+ *     - ESP_FAIL The task could not be created
+ */
+esp_err_t task_profiler_start(task_profiler_handle_t prof);
+
+/**
+ * @brief Stop the sampling task, the profile stays
+ */
+void task_profiler_stop(task_profiler_handle_t prof);
+
+/**
+ * @brief Account one sample of all tasks
+ *
+ * Run time is the difference of each task's counter to its last sample,
+ * a task's first sample only sets its counter.
+ *
+ * @param tasks     All tasks, the idle tasks among them
+ * @param num_tasks Entries in tasks
+ * @param now_us    Time of the sample, on the clock of the run time counters
+ */
+esp_err_t task_profiler_sample(task_profiler_handle_t prof, const task_profiler_snapshot_t *tasks, int num_tasks,
+                               int64_t now_us);
+
+/**
+ * @brief Forget the profile, the next sample starts a new one
+ */
+void task_profiler_reset(task_profiler_handle_t prof);
+
+/**
+ * @brief Busy time of a core since the first sample, in thousandths; -1 without its idle task
+ */
+int task_profiler_core_permille(task_profiler_handle_t prof, int core);
+
+/**
+ * @brief The profile of a task, ESP_ERR_NOT_FOUND if it was never sampled
+ */
+esp_err_t task_profiler_get_task(task_profiler_handle_t prof, const char *name, task_profiler_task_t *task);
+
+/**
+ * @brief Loads of all tasks but the idle ones, for task_placement_plan()
+ *
+ * @param[out] loads          Names point into the profiler, valid until it is reset or destroyed
+ * @param      max_loads      Entries in loads
+ * @param[out] other_permille Busy time of each core less the pinned tasks of the placement table on it
+ *
+ * @return Entries filled in
+ */
+int task_profiler_get_loads(task_profiler_handle_t prof, task_load_t *loads, int max_loads,
+                            int other_permille[TASK_PLACEMENT_NUM_CORES]);
+
+/**
+ * @brief Log per-core busy time and each task's share of a core and preemptions
+ */
+void task_profiler_report(task_profiler_handle_t prof);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
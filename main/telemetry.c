@@ -0,0 +1,412 @@
+/* Pipeline telemetry: ring buffer fill, i2s underruns and decode time per frame, as a binary stream
+
+   This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "audio_mem.h"
+#include "audio_error.h"
+#include "telemetry.h"
+
+static const char *TAG = "TELEMETRY";
+
+#define RECORD_MAX      (255 + 4)
+
+_Static_assert(5 + 2 * TELEMETRY_MAX_FRAMES <= 255, "a FRAMES record holds at most 125 decode times");
+
+typedef struct {
+    uint32_t t_ms;
+    uint32_t gap_us;
+} underrun_t;
+
+/**
+ * @brief What a period collects, guarded by lock
+ */
+typedef struct {
+    int min_fill[TELEMETRY_MAX_RB];
+    uint32_t frames;
+    uint32_t decode_min_us;
+    uint32_t decode_max_us;
+    uint32_t decode_sum_us;
+    uint16_t decode_us[TELEMETRY_MAX_FRAMES];
+    int num_decode;
+    uint32_t first_frame;
+    uint32_t frames_dropped;
+    uint32_t underruns;
+    uint32_t underrun_us;
+    underrun_t underrun[TELEMETRY_MAX_UNDERRUNS];
+    int num_underrun;
+} period_t;
+
+struct telemetry {
+    telemetry_cfg_t cfg;
+    portMUX_TYPE lock;
+    ringbuf_handle_t watch[TELEMETRY_MAX_RB];
+    int num_watch;
+
+    // decoder task
+    stream_func source;
+    void *source_ctx;
+    int64_t read_us;                // waited for input since the last output
+    int64_t last_output;            // 0 before the first
+    uint32_t frame_no;
+
+    // i2s writer task
+    audio_element_handle_t i2s;
+    ringbuf_handle_t rb;            // NULL while detached
+    int64_t dma_end;                // when the DMA plays out what it was given, 0 while stopped
+    int64_t wait_from;              // first read that found no input, -1 if the last read got some
+
+    period_t period;
+    telemetry_stats_t stats;
+
+    // flush task
+    period_t out;
+    uint32_t samples;
+    uint8_t record[RECORD_MAX];
+    volatile bool quit;
+    SemaphoreHandle_t done;
+};
+
+static void sample_fill_locked(telemetry_handle_t tm) {
+    for (int i = 0; i < tm->num_watch; i++) {
+        int fill = rb_bytes_filled(tm->watch[i]);
+        if (fill < tm->period.min_fill[i]) {
+            tm->period.min_fill[i] = fill;
+        }
+    }
+}
+
+static void reset_period_locked(telemetry_handle_t tm) {
+    memset(&tm->period, 0, sizeof(tm->period));
+    for (int i = 0; i < TELEMETRY_MAX_RB; i++) {
+        tm->period.min_fill[i] = INT32_MAX;
+    }
+    tm->period.decode_min_us = UINT32_MAX;
+    tm->period.first_frame = tm->frame_no;
+}
+
+static int64_t pcm_us(audio_element_handle_t el, int len) {
+    audio_element_info_t info = {0};
+    audio_element_getinfo(el, &info);
+    int64_t rate = (int64_t)info.sample_rates * info.channels * info.bits / 8;
+    return rate > 0 ? len * 1000000LL / rate : 0;
+}
+
+static int i2s_in_tap(audio_element_handle_t el, char *buf, int len, TickType_t wait_time, void *ctx) {
+    telemetry_handle_t tm = (telemetry_handle_t)ctx;
+    int64_t t0 = esp_timer_get_time();
+    int n = rb_read(tm->rb, buf, len, wait_time);
+    int64_t now = esp_timer_get_time();
+    if (n <= 0) {
+        if (n != RB_TIMEOUT) {
+            // end of stream or aborted: the output stops
+            tm->dma_end = 0;
+            tm->wait_from = -1;
+        } else if (tm->wait_from < 0) {
+            // a writer that polls waits from its first empty read
+            tm->wait_from = t0;
+        }
+        return n;
+    }
+    int64_t from = tm->wait_from >= 0 ? tm->wait_from : t0;
+    tm->wait_from = -1;
+    int64_t dur = pcm_us(el, n);
+    bool underrun = false;
+    int64_t gap = 0;
+    if (tm->dma_end > from) {
+        // i2s_write() returned once the last block fitted, the DMA holds at most dma_us
+        int64_t deadline = tm->dma_end < from + tm->cfg.dma_us ? tm->dma_end : from + tm->cfg.dma_us;
+        underrun = now > deadline;
+        gap = now - deadline;
+        tm->dma_end = (underrun ? now : deadline) + dur;
+    } else {
+        // started, resumed, or back from something that was not a read: nothing was waiting on the DMA
+        tm->dma_end = now + dur;
+    }
+    portENTER_CRITICAL(&tm->lock);
+    sample_fill_locked(tm);
+    if (underrun) {
+        period_t *p = &tm->period;
+        p->underruns++;
+        p->underrun_us += gap;
+        if (p->num_underrun < TELEMETRY_MAX_UNDERRUNS) {
+            p->underrun[p->num_underrun++] = (underrun_t) {
+                .t_ms = now / 1000, .gap_us = gap,
+            };
+        }
+        tm->stats.underruns++;
+        tm->stats.underrun_us += gap;
+    }
+    portEXIT_CRITICAL(&tm->lock);
+    return n;
+}
+
+int telemetry_read_cb(audio_element_handle_t el, char *buf, int len, TickType_t wait_time, void *ctx) {
+    telemetry_handle_t tm = (telemetry_handle_t)ctx;
+    int64_t t0 = esp_timer_get_time();
+    int n = tm->source(el, buf, len, wait_time, tm->source_ctx);
+    tm->read_us += esp_timer_get_time() - t0;
+    return n;
+}
+
+void telemetry_set_source(telemetry_handle_t tm, stream_func read_cb, void *ctx) {
+    tm->source = read_cb;
+    tm->source_ctx = ctx;
+}
+
+void telemetry_decoder_output(telemetry_handle_t tm, int64_t write_wait_us) {
+    int64_t now = esp_timer_get_time();
+    int64_t us = now - tm->last_output - tm->read_us - write_wait_us;
+    bool timed = tm->last_output && now - tm->last_output < TELEMETRY_IDLE_US;
+    tm->last_output = now;
+    tm->read_us = 0;
+    if (us < 0) {
+        us = 0;
+    }
+    portENTER_CRITICAL(&tm->lock);
+    sample_fill_locked(tm);
+    if (timed) {
+        period_t *p = &tm->period;
+        if (p->num_decode == 0) {
+            p->first_frame = tm->frame_no;
+        }
+        if (p->num_decode < TELEMETRY_MAX_FRAMES) {
+            p->decode_us[p->num_decode++] = us > UINT16_MAX ? UINT16_MAX : us;
+        } else {
+            p->frames_dropped++;
+            tm->stats.frames_dropped++;
+        }
+        p->frames++;
+        p->decode_sum_us += us;
+        if (us < p->decode_min_us) {
+            p->decode_min_us = us;
+        }
+        if (us > p->decode_max_us) {
+            p->decode_max_us = us;
+        }
+        tm->stats.frames++;
+        tm->stats.decode_sum_us += us;
+        if (us > tm->stats.decode_max_us) {
+            tm->stats.decode_max_us = us;
+        }
+        tm->frame_no++;
+    }
+    portEXIT_CRITICAL(&tm->lock);
+}
+
+static uint8_t *put_u8(uint8_t *p, uint32_t v) {
+    *p++ = v;
+    return p;
+}
+
+static uint8_t *put_u16(uint8_t *p, uint32_t v) {
+    if (v > UINT16_MAX) {
+        v = UINT16_MAX;
+    }
+    *p++ = v;
+    *p++ = v >> 8;
+    return p;
+}
+
+static uint8_t *put_u32(uint8_t *p, uint32_t v) {
+    for (int i = 0; i < 4; i++) {
+        *p++ = v >> (8 * i);
+    }
+    return p;
+}
+
+/**
+ * @brief Frame the payload at record + 3 and send it
+ */
+static void send(telemetry_handle_t tm, telemetry_rec_t type, const uint8_t *end) {
+    uint8_t *r = tm->record;
+    int len = end - (r + 3);
+    r[0] = TELEMETRY_SYNC;
+    r[1] = type;
+    r[2] = len;
+    uint8_t sum = 0;
+    for (int i = 1; i < len + 3; i++) {
+        sum += r[i];
+    }
+    r[len + 3] = sum;
+    int n = tm->cfg.out ? tm->cfg.out(tm->cfg.out_ctx, r, len + 4) : 0;
+    if (n < 0) {
+        n = 0;
+    }
+    portENTER_CRITICAL(&tm->lock);
+    tm->stats.records++;
+    tm->stats.bytes += n;
+    tm->stats.bytes_dropped += len + 4 - n;
+    portEXIT_CRITICAL(&tm->lock);
+}
+
+static void send_hello(telemetry_handle_t tm) {
+    uint8_t *p = tm->record + 3;
+    p = put_u8(p, TELEMETRY_VERSION);
+    p = put_u16(p, tm->cfg.period_ms);
+    p = put_u32(p, tm->cfg.dma_us);
+    p = put_u8(p, tm->num_watch);
+    for (int i = 0; i < tm->num_watch; i++) {
+        p = put_u32(p, rb_get_size(tm->watch[i]));
+    }
+    send(tm, TELEMETRY_REC_HELLO, p);
+}
+
+void telemetry_flush(telemetry_handle_t tm) {
+    // copied out, the taps wait for the copy only
+    period_t *p = &tm->out;
+    int fill[TELEMETRY_MAX_RB];
+    portENTER_CRITICAL(&tm->lock);
+    *p = tm->period;
+    reset_period_locked(tm);
+    for (int i = 0; i < tm->num_watch; i++) {
+        fill[i] = rb_bytes_filled(tm->watch[i]);
+    }
+    portEXIT_CRITICAL(&tm->lock);
+
+    if (tm->samples++ % TELEMETRY_HELLO_EVERY == 0) {
+        send_hello(tm);
+    }
+    uint8_t *r = tm->record + 3;
+    r = put_u32(r, esp_timer_get_time() / 1000);
+    r = put_u8(r, tm->num_watch);
+    for (int i = 0; i < tm->num_watch; i++) {
+        r = put_u16(r, fill[i]);
+        r = put_u16(r, p->min_fill[i] < fill[i] ? p->min_fill[i] : fill[i]);
+    }
+    r = put_u16(r, p->underruns);
+    r = put_u32(r, p->underrun_us);
+    r = put_u16(r, p->frames);
+    r = put_u16(r, p->frames ? p->decode_min_us : 0);
+    r = put_u16(r, p->decode_max_us);
+    r = put_u32(r, p->decode_sum_us);
+    r = put_u16(r, p->frames_dropped);
+    send(tm, TELEMETRY_REC_SAMPLE, r);
+
+    if (p->num_decode) {
+        r = tm->record + 3;
+        r = put_u32(r, p->first_frame);
+        r = put_u8(r, p->num_decode);
+        for (int i = 0; i < p->num_decode; i++) {
+            r = put_u16(r, p->decode_us[i]);
+        }
+        send(tm, TELEMETRY_REC_FRAMES, r);
+    }
+    for (int i = 0; i < p->num_underrun; i++) {
+        r = tm->record + 3;
+        r = put_u32(r, p->underrun[i].t_ms);
+        r = put_u32(r, p->underrun[i].gap_us);
+        send(tm, TELEMETRY_REC_UNDERRUN, r);
+    }
+}
+
+static void flush_task(void *ctx) {
+    telemetry_handle_t tm = (telemetry_handle_t)ctx;
+    while (!tm->quit) {
+        vTaskDelay(pdMS_TO_TICKS(tm->cfg.period_ms));
+        telemetry_flush(tm);
+    }
+    xSemaphoreGive(tm->done);
+    vTaskDelete(NULL);
+}
+
+telemetry_handle_t telemetry_create(const telemetry_cfg_t *cfg) {
+    AUDIO_NULL_CHECK(TAG, cfg, return NULL);
+    if (cfg->period_ms <= 0 || cfg->dma_us < 0) {
+        ESP_LOGE(TAG, "invalid config, %d ms period, %d us of DMA", cfg->period_ms, cfg->dma_us);
+        return NULL;
+    }
+    telemetry_handle_t tm = audio_calloc(1, sizeof(struct telemetry));
+    AUDIO_MEM_CHECK(TAG, tm, return NULL);
+    tm->cfg = *cfg;
+    portMUX_TYPE unlocked = portMUX_INITIALIZER_UNLOCKED;
+    tm->lock = unlocked;
+    tm->wait_from = -1;
+    reset_period_locked(tm);
+    if (cfg->task_stack > 0) {
+        tm->done = xSemaphoreCreateBinary();
+        AUDIO_MEM_CHECK(TAG, tm->done, goto _fail);
+        if (xTaskCreatePinnedToCore(flush_task, "telemetry", cfg->task_stack, tm, cfg->task_prio, NULL,
+                                    cfg->task_core) != pdPASS) {
+            ESP_LOGE(TAG, "failed to create the flush task");
+            goto _fail;
+        }
+    }
+    return tm;
+
+_fail:
+    if (tm->done) {
+        vSemaphoreDelete(tm->done);
+    }
+    audio_free(tm);
+    return NULL;
+}
+
+void telemetry_destroy(telemetry_handle_t tm) {
+    if (!tm) {
+        return;
+    }
+    if (tm->cfg.task_stack > 0) {
+        tm->quit = true;
+        xSemaphoreTake(tm->done, portMAX_DELAY);
+        vSemaphoreDelete(tm->done);
+    }
+    audio_free(tm);
+}
+
+esp_err_t telemetry_watch_ringbuf(telemetry_handle_t tm, ringbuf_handle_t rb) {
+    AUDIO_NULL_CHECK(TAG, tm, return ESP_ERR_INVALID_ARG);
+    AUDIO_NULL_CHECK(TAG, rb, return ESP_ERR_INVALID_ARG);
+    if (tm->num_watch >= TELEMETRY_MAX_RB) {
+        ESP_LOGE(TAG, "at most %d ring buffers", TELEMETRY_MAX_RB);
+        return ESP_ERR_INVALID_ARG;
+    }
+    portENTER_CRITICAL(&tm->lock);
+    tm->watch[tm->num_watch++] = rb;
+    portEXIT_CRITICAL(&tm->lock);
+    return ESP_OK;
+}
+
+esp_err_t telemetry_attach(telemetry_handle_t tm, audio_element_handle_t i2s) {
+    AUDIO_NULL_CHECK(TAG, tm, return ESP_FAIL);
+    ringbuf_handle_t rb = audio_element_get_input_ringbuf(i2s);
+    if (!rb) {
+        ESP_LOGE(TAG, "the i2s writer has no input ring buffer");
+        return ESP_FAIL;
+    }
+    tm->i2s = i2s;
+    tm->rb = rb;
+    tm->dma_end = 0;
+    tm->wait_from = -1;
+    audio_element_set_read_cb(i2s, i2s_in_tap, tm);
+    return ESP_OK;
+}
+
+esp_err_t telemetry_detach(telemetry_handle_t tm) {
+    AUDIO_NULL_CHECK(TAG, tm, return ESP_FAIL);
+    if (!tm->rb) {
+        return ESP_OK;
+    }
+    audio_element_set_input_ringbuf(tm->i2s, tm->rb);
+    tm->rb = NULL;
+    return ESP_OK;
+}
+
+esp_err_t telemetry_get_stats(telemetry_handle_t tm, telemetry_stats_t *stats) {
+    AUDIO_NULL_CHECK(TAG, tm, return ESP_ERR_INVALID_ARG);
+    AUDIO_NULL_CHECK(TAG, stats, return ESP_ERR_INVALID_ARG);
+    portENTER_CRITICAL(&tm->lock);
+    *stats = tm->stats;
+    portEXIT_CRITICAL(&tm->lock);
+    return ESP_OK;
+}
@@ -0,0 +1,184 @@
+/* Pipeline telemetry: ring buffer fill, i2s underruns and decode time per frame, as a binary stream
+
+   This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#ifndef _TELEMETRY_H_
+#define _TELEMETRY_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "audio_element.h"
+#include "ringbuf.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Stream format, little endian. Every record is
+ *
+ *   0xa5, type, len, payload[len], sum
+ *
+ * where sum is the low byte of the sum of type, len and the payload, so a
+ * reader can join at any point and skip over anything else on the line.
+ *
+ *   HELLO     version u8, period_ms u16, dma_us u32, num_rb u8, rb size u32 * num_rb
+ *   SAMPLE    t_ms u32, num_rb u8, (fill u16, min fill u16) * num_rb, underruns u16,
+ *             underrun_us u32, frames u16, decode min/max us u16, decode sum us u32,
+ *             frames dropped u16
+ *   FRAMES    first frame number u32, count u8, decode us u16 * count
+ *   UNDERRUN  t_ms u32, gap_us u32
+ *
+ * SAMPLE counts what happened since the previous SAMPLE. tools/telemetry_decode.py
+ * reads it from a serial port or a capture.
+ */
+#define TELEMETRY_SYNC              (0xa5)
+#define TELEMETRY_VERSION           (1)
+#define TELEMETRY_MAX_RB            (4)
+#define TELEMETRY_MAX_FRAMES        (64)        /*!< Decode times kept between flushes, more are counted as dropped */
+#define TELEMETRY_MAX_UNDERRUNS     (8)         /*!< UNDERRUN records kept between flushes */
+#define TELEMETRY_IDLE_US           (500000)    /*!< A gap between decoder outputs this long is a pause, not a frame */
+#define TELEMETRY_HELLO_EVERY       (50)        /*!< SAMPLE records between two HELLO */
+
+typedef enum {
+    TELEMETRY_REC_HELLO = 1,
+    TELEMETRY_REC_SAMPLE,
+    TELEMETRY_REC_FRAMES,
+    TELEMETRY_REC_UNDERRUN,
+} telemetry_rec_t;
+
+/**
+ * @brief Where the stream goes, e.g. telemetry_uart_write()
+ *
+ * @return Bytes taken, fewer are counted as dropped
+ */
+typedef int (*telemetry_out_t)(void *ctx, const uint8_t *buf, int len);
+
+/**
+ * @brief Telemetry configuration
+ */
+typedef struct {
+    int             period_ms;      /*!< One SAMPLE record per period */
+    int             dma_us;         /*!< Audio the i2s DMA buffers hold, the time the writer may wait for input without a gap */
+    telemetry_out_t out;
+    void            *out_ctx;
+    int             task_stack;     /*!< Flush task stack, 0 for no task: the caller runs telemetry_flush() */
+    int             task_prio;
+    int             task_core;
+} telemetry_cfg_t;
+
+#define TELEMETRY_CFG_DEFAULT() {       \
+    .period_ms = 100,                   \
+    .dma_us = 0,                        \
+    .out = NULL,                        \
+    .out_ctx = NULL,                    \
+    .task_stack = 2048,                 \
+    .task_prio = 2,                     \
+    .task_core = 1,                     \
+}
+
+/**
+ * @brief Totals since create
+ */
+typedef struct {
+    uint32_t frames;            /*!< Decoder outputs timed */
+    uint32_t decode_max_us;
+    uint64_t decode_sum_us;
+    uint32_t frames_dropped;    /*!< Decode times not sent, the buffer was full */
+    uint32_t underruns;
+    int64_t  underrun_us;       /*!< Silence the underruns left in the output */
+    uint32_t records;
+    uint32_t bytes;             /*!< Taken by out */
+    uint32_t bytes_dropped;     /*!< Refused by out */
+} telemetry_stats_t;
+
+typedef struct telemetry *telemetry_handle_t;
+
+/**
+ * @brief Create the telemetry and its flush task
+ *
+ * @return The handle, NULL on error
+ */
+telemetry_handle_t telemetry_create(const telemetry_cfg_t *cfg);
+
+/**
+ * @brief Stop the flush task and free the telemetry, detach it first
+ */
+void telemetry_destroy(telemetry_handle_t tm);
+
+/**
+ * @brief Sample the fill of a ring buffer, in the order added; at most TELEMETRY_MAX_RB
+ *
+ * Fills are sampled whenever the decoder writes and the i2s writer reads,
+ * so the minimum of a period catches a drain between two SAMPLE records.
+ * Add them before the first flush.
+ */
+esp_err_t telemetry_watch_ringbuf(telemetry_handle_t tm, ringbuf_handle_t rb);
+
+/**
+ * @brief Tap the i2s writer's input to count underruns
+ *
+ * Replaces its input by a callback that reads the linked ring buffer. The
+ * DMA holds dma_us of audio when the writer comes back for more; a read
+ * that had to wait longer than what is left of it is an underrun, and the
+ * overshoot is the gap in the output. Time the writer spends outside reads
+ * (paused, stopped) is not counted. Attach after the pipeline is linked,
+ * detach before it is stopped, as latency_trace_attach().
+ *
+ * @return
+ *     - ESP_OK
+ *     - ESP_FAIL The element has no input ring buffer
+ */
+esp_err_t telemetry_attach(telemetry_handle_t tm, audio_element_handle_t i2s);
+
+/**
+ * @brief Give the ring buffer back to the i2s writer
+ */
+esp_err_t telemetry_detach(telemetry_handle_t tm);
+
+/**
+ * @brief Read callback for the decoder that times the source it wraps
+ *
+ * Set it as the decoder's read_cb with the telemetry as context, see
+ * telemetry_set_source(); time the decoder waits for input is not decode time.
+ */
+int telemetry_read_cb(audio_element_handle_t el, char *buf, int len, TickType_t wait_time, void *ctx);
+
+/**
+ * @brief The read callback telemetry_read_cb() passes on to, e.g. playlist_read_cb()
+ */
+void telemetry_set_source(telemetry_handle_t tm, stream_func read_cb, void *ctx);
+
+/**
+ * @brief Time a decoder output, from the decoder's output observer
+ *
+ * The decode time of a frame is the time since the previous output, less
+ * what the decoder spent waiting for input (telemetry_read_cb()) and for
+ * room in its output (write_wait_us, latency_trace_get_write_wait_us()).
+ *
+ * @param tm            The telemetry
+ * @param write_wait_us Time this output waited for room in the ring buffer
+ */
+void telemetry_decoder_output(telemetry_handle_t tm, int64_t write_wait_us);
+
+/**
+ * @brief Send the records of the period that ended, the flush task runs it every period_ms
+ */
+void telemetry_flush(telemetry_handle_t tm);
+
+/**
+ * @brief Copy the totals
+ */
+esp_err_t telemetry_get_stats(telemetry_handle_t tm, telemetry_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,48 @@
+/* UART output of the pipeline telemetry
+
+   This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#include "esp_log.h"
+#include "driver/uart.h"
+#include "telemetry_uart.h"
+
+static const char *TAG = "TELEMETRY_UART";
+
+esp_err_t telemetry_uart_open(int uart_num, int tx_pin, int baud) {
+    uart_config_t cfg = {
+        .baud_rate = baud,
+        .data_bits = UART_DATA_8_BITS,
+        .parity = UART_PARITY_DISABLE,
+        .stop_bits = UART_STOP_BITS_1,
+        .flow_ctrl = UART_HW_FLOWCTRL_DISABLE,
+        .source_clk = UART_SCLK_APB,
+    };
+    // the driver wants an RX buffer larger than the hardware FIFO even for TX only
+    esp_err_t ret = uart_driver_install(uart_num, UART_FIFO_LEN * 2, TELEMETRY_UART_TX_BUF, 0, NULL, 0);
+    if (ret == ESP_OK) {
+        ret = uart_param_config(uart_num, &cfg);
+    }
+    if (ret == ESP_OK) {
+        ret = uart_set_pin(uart_num, tx_pin, UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE);
+    }
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "UART%d on GPIO%d: %s", uart_num, tx_pin, esp_err_to_name(ret));
+        uart_driver_delete(uart_num);
+        return ret;
+    }
+    ESP_LOGI(TAG, "UART%d TX on GPIO%d at %d baud", uart_num, tx_pin, baud);
+    return ESP_OK;
+}
+
+void telemetry_uart_close(int uart_num) {
+    uart_driver_delete(uart_num);
+}
+
+int telemetry_uart_write(void *ctx, const uint8_t *buf, int len) {
+    return uart_write_bytes((int)(intptr_t)ctx, (const char *)buf, len);
+}
@@ -0,0 +1,48 @@
+/* UART output of the pipeline telemetry
+
+   This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#ifndef _TELEMETRY_UART_H_
+#define _TELEMETRY_UART_H_
+
+#include <stdint.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define TELEMETRY_UART_TX_BUF   (2048)  /*!< Driver TX buffer, about 3 s of the stream */
+
+/**
+ * @brief Install the UART driver, TX only
+ *
+ * @param uart_num Port, not the console's
+ * @param tx_pin   TX GPIO
+ * @param baud     Baud rate
+ */
+esp_err_t telemetry_uart_open(int uart_num, int tx_pin, int baud);
+
+/**
+ * @brief Remove the driver
+ */
+void telemetry_uart_close(int uart_num);
+
+/**
+ * @brief telemetry_out_t for telemetry_cfg_t.out, ctx is the port as (void *)(intptr_t)uart_num
+ *
+ * Queues the record in the driver's TX buffer. The stream is about 1 KB/s,
+ * so it waits for room only on a line slower than 19200 baud.
+ */
+int telemetry_uart_write(void *ctx, const uint8_t *buf, int len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,187 @@
+#!/usr/bin/env python
+#
+# Frame index of the embedded mp3 assets, for seeking without scanning
+#
+# This example code is in the Public Domain (or CC0 licensed, at your option.)
+#
+# Unless required by applicable law or agreed to in writing, this
+# software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+# CONDITIONS OF ANY KIND, either express or implied.
+#
+# Walks the layer III frames of each file the way playlist.c does (skip the
+# ID3v2 tag, sync on the first frame confirmed by the next one, then follow
+# frame sizes, resyncing over junk, stop at a truncated frame) and writes one
+# mp3_index_t per file, named after the asset's embed symbol:
+#
+#   music-16b-2c-8000hz.mp3 -> const mp3_index_t music_16b_2c_8000hz_mp3_index
+#
+# Offsets are stored in two levels (see mp3_index.h): a uint32_t base for
+# every MP3_INDEX_BLOCK_FRAMES frames and a uint16_t per frame relative to it,
+# about 2 bytes per frame.
+#
+#   gen_mp3_index.py -o music_index.c music-16b-2c-8000hz.mp3 ...
+
+import argparse
+import os
+import re
+import sys
+
+BLOCK_FRAMES = 32
+HEADER_SIZE = 4
+
+BITRATE_V1_L3 = [0, 32, 40, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320, 0]
+BITRATE_V2_L3 = [0, 8, 16, 24, 32, 40, 48, 56, 64, 80, 96, 112, 128, 144, 160, 0]
+SAMPLE_RATES = [
+    [44100, 48000, 32000],  # MPEG1
+    [22050, 24000, 16000],  # MPEG2
+    [11025, 12000, 8000],   # MPEG2.5
+]
+
+
+class Frame(object):
+    def __init__(self, version, sample_rate, channels, samples, size):
+        self.version = version
+        self.sample_rate = sample_rate
+        self.channels = channels
+        self.samples = samples
+        self.size = size
+
+
+def parse_header(data, pos):
+    """mp3_frame_parse_header(), None if data[pos:] is not a layer III header"""
+    if pos + HEADER_SIZE > len(data):
+        return None
+    b1, b2, b3 = data[pos + 1], data[pos + 2], data[pos + 3]
+    if data[pos] != 0xFF or (b1 & 0xE0) != 0xE0:
+        return None
+    version_bits = (b1 >> 3) & 3
+    layer_bits = (b1 >> 1) & 3
+    bitrate_idx = (b2 >> 4) & 0xF
+    rate_idx = (b2 >> 2) & 3
+    padding = (b2 >> 1) & 1
+    mode = (b3 >> 6) & 3
+    if version_bits == 1 or layer_bits != 1 or bitrate_idx in (0, 15) or rate_idx == 3:
+        return None
+    version, row = {3: (10, 0), 2: (20, 1), 0: (25, 2)}[version_bits]
+    bitrate = (BITRATE_V1_L3 if version == 10 else BITRATE_V2_L3)[bitrate_idx]
+    sample_rate = SAMPLE_RATES[row][rate_idx]
+    samples = 1152 if version == 10 else 576
+    size = (samples // 8) * bitrate * 1000 // sample_rate + padding
+    return Frame(version, sample_rate, 1 if mode == 3 else 2, samples, size)
+
+
+def sync(data, start):
+    """mp3_frame_sync() on data[start:], returns (offset, frame) or (-1, None)"""
+    end = len(data)
+    pos = data.find(b'\xff', start)
+    while pos >= 0 and pos + HEADER_SIZE <= end:
+        cur = parse_header(data, pos)
+        if cur:
+            nxt = pos + cur.size
+            if nxt + HEADER_SIZE <= end:
+                f = parse_header(data, nxt)
+                if f and f.version == cur.version and f.sample_rate == cur.sample_rate:
+                    return pos, cur
+            elif nxt == end:
+                return pos, cur
+        pos = data.find(b'\xff', pos + 1)
+    return -1, None
+
+
+def id3v2_size(data):
+    if len(data) < 10 or data[0:3] != b'ID3':
+        return 0
+    size = ((data[6] & 0x7F) << 21) | ((data[7] & 0x7F) << 14) | ((data[8] & 0x7F) << 7) | (data[9] & 0x7F)
+    return 10 + size + (10 if data[5] & 0x10 else 0)
+
+
+def walk(path):
+    with open(path, 'rb') as f:
+        data = bytearray(f.read())
+    pos, first = sync(data, id3v2_size(data))
+    if pos < 0:
+        raise ValueError('no mp3 frames')
+    offsets = []
+    while pos + HEADER_SIZE <= len(data):
+        frame = parse_header(data, pos)
+        if not frame:
+            pos, frame = sync(data, pos)
+            if pos < 0:
+                break
+        elif pos + frame.size > len(data):
+            break
+        # seeking by time needs every frame to last as long as the first
+        if frame.sample_rate != first.sample_rate or frame.samples != first.samples:
+            raise ValueError('frame at %d: %d Hz, %d samples after %d Hz, %d samples' %
+                             (pos, frame.sample_rate, frame.samples, first.sample_rate, first.samples))
+        offsets.append(pos)
+        pos += frame.size
+    return first, offsets, pos
+
+
+def c_array(ctype, name, values, per_line):
+    lines = ['static const %s %s[] = {' % (ctype, name)]
+    for i in range(0, len(values), per_line):
+        lines.append('    ' + ' '.join('%d,' % v for v in values[i:i + per_line]))
+    lines.append('};')
+    return '\n'.join(lines)
+
+
+def index_source(path):
+    first, offsets, end = walk(path)
+    symbol = re.sub(r'[^A-Za-z0-9_]', '_', os.path.basename(path))
+    base = [offsets[i] for i in range(0, len(offsets), BLOCK_FRAMES)]
+    rel = [off - base[i // BLOCK_FRAMES] for i, off in enumerate(offsets)]
+    if max(rel) > 0xFFFF:
+        raise ValueError('a block of %d frames spans more than 64 KiB' % BLOCK_FRAMES)
+    duration_ms = len(offsets) * first.samples * 1000 // first.sample_rate
+    return '\n'.join([
+        '// %s: %d frames, %d Hz, %d ch, %d ms' % (os.path.basename(path), len(offsets), first.sample_rate,
+                                                  first.channels, duration_ms),
+        c_array('uint32_t', symbol + '_base', base, 8),
+        c_array('uint16_t', symbol + '_rel', rel, 12),
+        'const mp3_index_t %s_index = {' % symbol,
+        '    .sample_rate = %d,' % first.sample_rate,
+        '    .frame_samples = %d,' % first.samples,
+        '    .channels = %d,' % first.channels,
+        '    .frame_count = %d,' % len(offsets),
+        '    .end = %d,' % end,
+        '    .base = %s_base,' % symbol,
+        '    .rel = %s_rel,' % symbol,
+        '};',
+        '',
+    ]), len(offsets) * 2 + len(base) * 4
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Generate frame index tables for mp3 files')
+    parser.add_argument('-o', '--output', required=True, help='C file to write')
+    parser.add_argument('files', nargs='+', help='mp3 files, in embed order')
+    args = parser.parse_args()
+
+    parts = [
+        '/* Generated by tools/gen_mp3_index.py, do not edit */',
+        '',
+        '#include "mp3_index.h"',
+        '',
+        '#if MP3_INDEX_BLOCK_FRAMES != %d' % BLOCK_FRAMES,
+        '#error "gen_mp3_index.py and mp3_index.h disagree on MP3_INDEX_BLOCK_FRAMES"',
+        '#endif',
+        '',
+    ]
+    for path in args.files:
+        try:
+            source, size = index_source(path)
+        except (IOError, ValueError) as e:
+            sys.stderr.write('%s: %s\n' % (path, e))
+            return 1
+        parts.append(source)
+        print('%s: frame index %d bytes' % (os.path.basename(path), size))
+
+    with open(args.output, 'w') as f:
+        f.write('\n'.join(parts))
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,173 @@
+#!/usr/bin/env python
+#
+# Decode the pipeline telemetry stream of main/telemetry.c
+#
+# This example code is in the Public Domain (or CC0 licensed, at your option.)
+#
+# Unless required by applicable law or agreed to in writing, this
+# software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+# CONDITIONS OF ANY KIND, either express or implied.
+#
+# Reads records (see telemetry.h) from a capture file or, with pyserial, a
+# serial port; anything between records that does not check out, such as
+# boot messages on the same line, is skipped. Prints one line per SAMPLE and
+# UNDERRUN record (with -f also the decode time of every frame) and totals at
+# the end.
+#
+#   telemetry_decode.py /dev/ttyUSB1 -b 921600
+#   telemetry_decode.py capture.bin
+
+import argparse
+import struct
+import sys
+
+SYNC = 0xa5
+REC_HELLO = 1
+REC_SAMPLE = 2
+REC_FRAMES = 3
+REC_UNDERRUN = 4
+
+
+def records(chunks):
+    """Yield (type, payload) of every record whose checksum matches"""
+    buf = bytearray()
+    for chunk in chunks:
+        buf += chunk
+        i = 0
+        while True:
+            i = buf.find(bytes([SYNC]), i)
+            if i < 0:
+                i = len(buf)
+                break
+            if i + 3 > len(buf) or i + 4 + buf[i + 2] > len(buf):
+                break
+            rtype, n = buf[i + 1], buf[i + 2]
+            payload = bytes(buf[i + 3:i + 3 + n])
+            if (rtype + n + sum(payload)) & 0xff != buf[i + 3 + n] or not REC_HELLO <= rtype <= REC_UNDERRUN:
+                i += 1
+                continue
+            yield rtype, payload
+            i += n + 4
+        del buf[:i]
+
+
+def read_file(path):
+    with open(path, 'rb') as f:
+        while True:
+            chunk = f.read(4096)
+            if not chunk:
+                return
+            yield chunk
+
+
+def read_serial(port, baud):
+    import serial
+    with serial.Serial(port, baud, timeout=0.5) as s:
+        while True:
+            yield s.read(4096)
+
+
+class Decoder(object):
+    def __init__(self, show_frames):
+        self.show_frames = show_frames
+        self.sizes = []
+        self.period_ms = 0
+        self.dma_us = 0
+        self.samples = 0
+        self.frames = 0
+        self.decode_sum = 0
+        self.decode_max = 0
+        self.dropped = 0
+        self.underruns = 0
+        self.underrun_us = 0
+        self.min_fill = []
+
+    def hello(self, p):
+        version, self.period_ms, self.dma_us, n = struct.unpack_from('<BHIB', p)
+        if version != 1:
+            sys.stderr.write('telemetry version %d, this decoder knows 1\n' % version)
+        self.sizes = list(struct.unpack_from('<%dI' % n, p, 8))
+        if len(self.min_fill) != n:
+            self.min_fill = [None] * n
+        print('hello: period %d ms, DMA %.1f ms, ring buffers %s' %
+              (self.period_ms, self.dma_us / 1000.0, ' '.join(str(s) for s in self.sizes)))
+
+    def sample(self, p):
+        t_ms, n = struct.unpack_from('<IB', p)
+        fills = [struct.unpack_from('<HH', p, 5 + 4 * i) for i in range(n)]
+        under, under_us, frames, dmin, dmax, dsum, dropped = struct.unpack_from('<HIHHHIH', p, 5 + 4 * n)
+        self.samples += 1
+        self.frames += frames
+        self.decode_sum += dsum
+        self.decode_max = max(self.decode_max, dmax)
+        self.dropped += dropped
+        if len(self.min_fill) != n:
+            self.min_fill = [None] * n
+        rbs = []
+        for i, (fill, low) in enumerate(fills):
+            size = self.sizes[i] if i < len(self.sizes) else 0
+            if self.min_fill[i] is None or low < self.min_fill[i]:
+                self.min_fill[i] = low
+            if size:
+                rbs.append('rb%d %3d%% (min %3d%%)' % (i, fill * 100 // size, low * 100 // size))
+            else:
+                rbs.append('rb%d %5d (min %5d)' % (i, fill, low))
+        line = ['%9.3f' % (t_ms / 1000.0)] + rbs + ['underruns %d (%d us)' % (under, under_us)]
+        if frames:
+            line.append('decode %d frames min/mean/max %d/%d/%d us' % (frames, dmin, dsum // frames, dmax))
+        print(' '.join(line))
+
+    def frame_times(self, p):
+        first, n = struct.unpack_from('<IB', p)
+        if self.show_frames:
+            for i, us in enumerate(struct.unpack_from('<%dH' % n, p, 5)):
+                print('    frame %d: %d us' % (first + i, us))
+
+    def underrun(self, p):
+        t_ms, gap_us = struct.unpack_from('<II', p)
+        self.underruns += 1
+        self.underrun_us += gap_us
+        print('%9.3f UNDERRUN %.1f ms' % (t_ms / 1000.0, gap_us / 1000.0))
+
+    def summary(self):
+        print('%d samples, %d frames decoded, mean %d us, max %d us, %d decode times dropped' %
+              (self.samples, self.frames, self.decode_sum // self.frames if self.frames else 0, self.decode_max,
+               self.dropped))
+        print('%d underruns, %.1f ms of silence' % (self.underruns, self.underrun_us / 1000.0))
+        for i, low in enumerate(self.min_fill):
+            if low is not None:
+                print('rb%d lowest fill %d bytes' % (i, low))
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Decode the pipeline telemetry stream')
+    parser.add_argument('source', help='capture file, or serial port')
+    parser.add_argument('-b', '--baud', type=int, default=0, help='read a serial port at this baud rate')
+    parser.add_argument('-f', '--frames', action='store_true', help='print the decode time of every frame')
+    args = parser.parse_args()
+
+    if args.baud:
+        chunks = read_serial(args.source, args.baud)
+    else:
+        chunks = read_file(args.source)
+    dec = Decoder(args.frames)
+    handlers = {
+        REC_HELLO: dec.hello,
+        REC_SAMPLE: dec.sample,
+        REC_FRAMES: dec.frame_times,
+        REC_UNDERRUN: dec.underrun,
+    }
+    try:
+        for rtype, payload in records(chunks):
+            try:
+                handlers[rtype](payload)
+            except struct.error:
+                sys.stderr.write('short record of type %d\n' % rtype)
+    except KeyboardInterrupt:
+        pass
+    dec.summary()
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())